@@ -51,7 +51,7 @@ let
       fi
       
       export ARCH="$SIMULATOR_ARCH"
-      export CFLAGS="-arch $ARCH -isysroot $SDKROOT -mios-simulator-version-min=15.0 -fPIC -fobjc-arc -I$PWD/src -I$PWD/src/HIAHKernel/Public"
+      export CFLAGS="-arch $ARCH -isysroot $SDKROOT -mios-simulator-version-min=15.0 -fPIC -fobjc-arc -I$PWD/src -I$PWD/src/HIAHKernel/Public -I$PWD/src/HIAHKernel/Core/Hooks -I$PWD/src/HIAHKernel/Core/Process -I$PWD/src/HIAHKernel/Core/IPC -I$PWD/src/HIAHKernel/Core/Loader"
       export OBJCFLAGS="$CFLAGS"
       export LDFLAGS="-arch $SIMULATOR_ARCH -isysroot $SDKROOT -mios-simulator-version-min=15.0 -framework Foundation -framework UIKit"
     '';
@@ -65,6 +65,34 @@ let
       echo "Compiling HIAHHook.c..."
       $CC -c src/HIAHKernel/Core/Hooks/HIAHHook.c -o HIAHHook.o $CFLAGS -O2
       
+      # Build HIAHSymbolIndex
+      echo "Compiling HIAHSymbolIndex.c..."
+      $CC -c src/HIAHKernel/Core/Hooks/HIAHSymbolIndex.c -o HIAHSymbolIndex.o $CFLAGS -O2
+      
+      # Build HIAHExportTrie
+      echo "Compiling HIAHExportTrie.c..."
+      $CC -c src/HIAHKernel/Core/Hooks/HIAHExportTrie.c -o HIAHExportTrie.o $CFLAGS -O2
+      
+      # Build HIAHChainedFixups
+      echo "Compiling HIAHChainedFixups.c..."
+      $CC -c src/HIAHKernel/Core/Hooks/HIAHChainedFixups.c -o HIAHChainedFixups.o $CFLAGS -O2
+      
+      # Build HIAHHookTargets
+      echo "Compiling HIAHHookTargets.c..."
+      $CC -c src/HIAHKernel/Core/Hooks/HIAHHookTargets.c -o HIAHHookTargets.o $CFLAGS -O2
+      
+      # Build HIAHHookRegistry
+      echo "Compiling HIAHHookRegistry.c..."
+      $CC -c src/HIAHKernel/Core/Hooks/HIAHHookRegistry.c -o HIAHHookRegistry.o $CFLAGS -O2
+      
+      # Build HIAHHookMetrics
+      echo "Compiling HIAHHookMetrics.c..."
+      $CC -c src/HIAHKernel/Core/Hooks/HIAHHookMetrics.c -o HIAHHookMetrics.o $CFLAGS -O2
+      
+      # Build HIAHFileActions
+      echo "Compiling HIAHFileActions.c..."
+      $CC -c src/HIAHKernel/Core/Hooks/HIAHFileActions.c -o HIAHFileActions.o $CFLAGS -O2
+      
       # Build HIAHGuestHooks
       echo "Compiling HIAHGuestHooks.m..."
       $CC -c src/HIAHKernel/Core/Hooks/HIAHGuestHooks.m -o HIAHGuestHooks.o $OBJCFLAGS -O2
@@ -77,6 +105,46 @@ let
       echo "Compiling HIAHLogging.m..."
       $CC -c src/HIAHKernel/Core/Logging/HIAHLogging.m -o HIAHLogging.o $OBJCFLAGS -O2
       
+      # Build HIAHOutputRing
+      echo "Compiling HIAHOutputRing.c..."
+      $CC -c src/HIAHKernel/Core/Process/HIAHOutputRing.c -o HIAHOutputRing.o $CFLAGS -O2
+      
+      # Build HIAHOutputChannel
+      echo "Compiling HIAHOutputChannel.c..."
+      $CC -c src/HIAHKernel/Core/Process/HIAHOutputChannel.c -o HIAHOutputChannel.o $CFLAGS -O2
+      
+      # Build HIAHSpawnTrace
+      echo "Compiling HIAHSpawnTrace.c..."
+      $CC -c src/HIAHKernel/Core/Process/HIAHSpawnTrace.c -o HIAHSpawnTrace.o $CFLAGS -O2
+
+      # Build HIAHProcessTable
+      echo "Compiling HIAHProcessTable.c..."
+      $CC -c src/HIAHKernel/Core/Process/HIAHProcessTable.c -o HIAHProcessTable.o $CFLAGS -O2
+      
+      # Build HIAHChildRegistry
+      echo "Compiling HIAHChildRegistry.c..."
+      $CC -c src/HIAHKernel/Core/Process/HIAHChildRegistry.c -o HIAHChildRegistry.o $CFLAGS -O2
+
+      # Build HIAHChildWatcher
+      echo "Compiling HIAHChildWatcher.c..."
+      $CC -c src/HIAHKernel/Core/Process/HIAHChildWatcher.c -o HIAHChildWatcher.o $CFLAGS -O2
+      
+      # Build HIAHControlServer
+      echo "Compiling HIAHControlServer.c..."
+      $CC -c src/HIAHKernel/Core/IPC/HIAHControlServer.c -o HIAHControlServer.o $CFLAGS -O2
+      
+      # Build HIAHControlProtocol
+      echo "Compiling HIAHControlProtocol.c..."
+      $CC -c src/HIAHKernel/Core/IPC/HIAHControlProtocol.c -o HIAHControlProtocol.o $CFLAGS -O2
+      
+      # Build HIAHControlChannel
+      echo "Compiling HIAHControlChannel.c..."
+      $CC -c src/HIAHKernel/Core/IPC/HIAHControlChannel.c -o HIAHControlChannel.o $CFLAGS -O2
+      
+      # Build HIAHControlEnvironment
+      echo "Compiling HIAHControlEnvironment.c..."
+      $CC -c src/HIAHKernel/Core/IPC/HIAHControlEnvironment.c -o HIAHControlEnvironment.o $CFLAGS -O2
+      
       # Build HIAHKernel
       echo "Compiling HIAHKernel.m..."
       $CC -c src/HIAHKernel/Core/HIAHKernel.m -o HIAHKernel.o $OBJCFLAGS -O2
@@ -92,15 +160,39 @@ let
       # Build HIAHMachOUtils
       echo "Compiling HIAHMachOUtils.m..."
       $CC -c src/HIAHKernel/Core/Utils/HIAHMachOUtils.m -o HIAHMachOUtils.o $OBJCFLAGS -O2
+
+      # Build HIAHImagePool
+      echo "Compiling HIAHImagePool.c..."
+      $CC -c src/HIAHKernel/Core/Loader/HIAHImagePool.c -o HIAHImagePool.o $CFLAGS -O2
+
+      # Build HIAHMachOTransform
+      echo "Compiling HIAHMachOTransform.c..."
+      $CC -c src/HIAHKernel/Core/Loader/HIAHMachOTransform.c -o HIAHMachOTransform.o $CFLAGS -O2
+
+      # Build HIAHWorkerPool
+      echo "Compiling HIAHWorkerPool.c..."
+      $CC -c src/HIAHKernel/Core/Loader/HIAHWorkerPool.c -o HIAHWorkerPool.o $CFLAGS -O2
+
+      # Build HIAHMachOIndex
+      echo "Compiling HIAHMachOIndex.c..."
+      $CC -c src/HIAHKernel/Core/Loader/HIAHMachOIndex.c -o HIAHMachOIndex.o $CFLAGS -O2
+
+      # Build HIAHFileClone
+      echo "Compiling HIAHFileClone.c..."
+      $CC -c src/HIAHKernel/Core/Loader/HIAHFileClone.c -o HIAHFileClone.o $CFLAGS -O2
+
+      # Build HIAHPatchedImageCache
+      echo "Compiling HIAHPatchedImageCache.m..."
+      $CC -c src/HIAHKernel/Core/Loader/HIAHPatchedImageCache.m -o HIAHPatchedImageCache.o $OBJCFLAGS -O2
       
       # Create static library
       echo "Creating static library libHIAHKernel.a..."
-      ar rcs libHIAHKernel.a HIAHLogging.o HIAHHook.o HIAHGuestHooks.o HIAHProcess.o HIAHKernel.o HIAHDyldBypass.o HIAHBypassStatus.o HIAHMachOUtils.o
+      ar rcs libHIAHKernel.a HIAHLogging.o HIAHHook.o HIAHSymbolIndex.o HIAHExportTrie.o HIAHChainedFixups.o HIAHHookTargets.o HIAHHookRegistry.o HIAHHookMetrics.o HIAHFileActions.o HIAHGuestHooks.o HIAHProcess.o HIAHOutputRing.o HIAHOutputChannel.o HIAHSpawnTrace.o HIAHProcessTable.o HIAHChildRegistry.o HIAHChildWatcher.o HIAHControlServer.o HIAHControlProtocol.o HIAHControlChannel.o HIAHControlEnvironment.o HIAHKernel.o HIAHDyldBypass.o HIAHBypassStatus.o HIAHMachOUtils.o HIAHImagePool.o HIAHMachOTransform.o HIAHWorkerPool.o HIAHMachOIndex.o HIAHFileClone.o HIAHPatchedImageCache.o
       
       # Create dynamic library
       echo "Creating dynamic library libHIAHKernel.dylib..."
       $CC -dynamiclib -o libHIAHKernel.dylib \
-        HIAHLogging.o HIAHHook.o HIAHGuestHooks.o HIAHProcess.o HIAHKernel.o HIAHDyldBypass.o HIAHBypassStatus.o HIAHMachOUtils.o \
+        HIAHLogging.o HIAHHook.o HIAHSymbolIndex.o HIAHExportTrie.o HIAHChainedFixups.o HIAHHookTargets.o HIAHHookRegistry.o HIAHHookMetrics.o HIAHFileActions.o HIAHGuestHooks.o HIAHProcess.o HIAHOutputRing.o HIAHOutputChannel.o HIAHSpawnTrace.o HIAHProcessTable.o HIAHChildRegistry.o HIAHChildWatcher.o HIAHControlServer.o HIAHControlProtocol.o HIAHControlChannel.o HIAHControlEnvironment.o HIAHKernel.o HIAHDyldBypass.o HIAHBypassStatus.o HIAHMachOUtils.o HIAHImagePool.o HIAHMachOTransform.o HIAHWorkerPool.o HIAHMachOIndex.o HIAHFileClone.o HIAHPatchedImageCache.o \
         $LDFLAGS \
         -install_name @rpath/libHIAHKernel.dylib
       
@@ -121,6 +213,8 @@ let
       # Install headers
       cp src/HIAHKernel/Public/HIAHKernel.h $out/include/HIAHKernel/
       cp src/HIAHKernel/Public/HIAHProcess.h $out/include/HIAHKernel/
+      cp src/HIAHKernel/Core/Process/HIAHOutputRing.h $out/include/HIAHKernel/
+      cp src/HIAHKernel/Core/Process/HIAHSpawnTrace.h $out/include/HIAHKernel/
       cp src/HIAHKernel/Core/Hooks/HIAHHook.h $out/include/HIAHKernel/
       cp src/HIAHKernel/Core/Hooks/HIAHGuestHooks.h $out/include/HIAHKernel/
       cp src/HIAHKernel/Core/Hooks/HIAHDyldBypass.h $out/include/HIAHKernel/
@@ -539,7 +633,7 @@ LAUNCHER
       $CC -c src/HIAHDesktop/HIAHeDisplayMode.m -o HIAHeDisplayMode.o $HIAHFLAGS -Isrc/HIAHWindowServer -Isrc/HIAHDesktop
       
       echo "Compiling HIAHFilesystem.m..."
-      $CC -c src/HIAHDesktop/HIAHFilesystem.m -o HIAHFilesystem.o $HIAHFLAGS -Isrc/HIAHDesktop
+      $CC -c src/HIAHDesktop/HIAHFilesystem.m -o HIAHFilesystem.o $HIAHFLAGS -Isrc/HIAHDesktop -Isrc/HIAHKernel/Core/Loader
       
       echo "Compiling HIAHCarPlayController.m..."
       $CC -c src/HIAHDesktop/HIAHCarPlayController.m -o HIAHCarPlayController.o $HIAHFLAGS -Isrc/HIAHWindowServer -Isrc/HIAHDesktop
@@ -835,6 +929,190 @@ LAUNCHER
       (old.installPhase or "");
   });
 
+  # Spawn-storm benchmark for the control socket (host build, no Xcode needed)
+  spawnBench = pkgs.stdenv.mkDerivation {
+    name = "hiah-spawn-bench";
+    version = projectVersion;
+    src = hiahkernelSrc;
+
+    buildPhase = ''
+      runHook preBuild
+
+      IPC=src/HIAHKernel/Core/IPC
+      echo "Compiling hiah-spawn-bench..."
+      $CC -O2 -pthread -I$IPC -o hiah-spawn-bench \
+        src/HIAHSpawnBench/HIAHSpawnBench.c \
+        $IPC/HIAHControlServer.c $IPC/HIAHControlProtocol.c $IPC/HIAHControlChannel.c \
+        $IPC/HIAHControlEnvironment.c \
+        ${lib.optionalString pkgs.stdenv.isLinux "-ldl"}
+
+      echo "Compiling hiah-protocol-bench..."
+      $CC -O2 -pthread -I$IPC -o hiah-protocol-bench \
+        src/HIAHSpawnBench/HIAHProtocolBench.c \
+        $IPC/HIAHControlServer.c $IPC/HIAHControlProtocol.c
+
+      PROCESS=src/HIAHKernel/Core/Process
+      echo "Compiling hiah-output-bench..."
+      $CC -O2 -pthread -I$PROCESS -o hiah-output-bench \
+        src/HIAHSpawnBench/HIAHOutputBench.c \
+        $PROCESS/HIAHOutputChannel.c $PROCESS/HIAHOutputRing.c
+
+      echo "Compiling hiah-pipeline-bench..."
+      $CC -O2 -pthread -I$PROCESS -o hiah-pipeline-bench \
+        src/HIAHSpawnBench/HIAHPipelineBench.c \
+        $PROCESS/HIAHOutputChannel.c $PROCESS/HIAHOutputRing.c \
+        $PROCESS/HIAHProcessTable.c $PROCESS/HIAHSpawnTrace.c
+
+      echo "Compiling bench guest..."
+      $CC -O2 -shared -fPIC -o libhiah-bench-guest.so \
+        src/HIAHSpawnBench/HIAHSpawnBenchGuest.c
+
+      runHook postBuild
+    '';
+
+    installPhase = ''
+      runHook preInstall
+      mkdir -p $out/bin $out/lib
+      cp hiah-spawn-bench $out/bin/
+      cp hiah-protocol-bench $out/bin/
+      cp hiah-output-bench $out/bin/
+      cp hiah-pipeline-bench $out/bin/
+      cp libhiah-bench-guest.so $out/lib/
+      runHook postInstall
+    '';
+
+    meta = with lib; {
+      description = "Spawn-storm load generator for the HIAHKernel control socket";
+      homepage = "https://github.com/aspauldingcode/HIAHKernel";
+      license = licenses.mit;
+      platforms = platforms.unix;
+    };
+  };
+
+  # Guest binary preparation throughput benchmark (host build, no Xcode needed)
+  machoBench = pkgs.stdenv.mkDerivation {
+    name = "hiah-macho-bench";
+    version = projectVersion;
+    src = hiahkernelSrc;
+
+    buildPhase = ''
+      runHook preBuild
+
+      LOADER=src/HIAHKernel/Core/Loader
+      echo "Compiling hiah-macho-bench..."
+      $CC -O2 -pthread -I$LOADER -o hiah-macho-bench \
+        src/HIAHMachOBench/HIAHMachOBench.c \
+        $LOADER/HIAHMachOTransform.c $LOADER/HIAHWorkerPool.c $LOADER/HIAHFileClone.c \
+        $LOADER/HIAHMachOIndex.c
+
+      HOOKS=src/HIAHKernel/Core/Hooks
+      echo "Compiling hiah-hook-bench..."
+      $CC -O2 -I$HOOKS -I$LOADER -o hiah-hook-bench \
+        src/HIAHMachOBench/HIAHHookBench.c $HOOKS/HIAHHookTargets.c
+
+      echo "Compiling hiah-export-trie-bench..."
+      $CC -O2 -Isrc/HIAHHostTests -I$HOOKS -o hiah-export-trie-bench \
+        src/HIAHMachOBench/HIAHExportTrieBench.c $HOOKS/HIAHExportTrie.c \
+        ${lib.optionalString pkgs.stdenv.isLinux "-ldl"}
+
+      runHook postBuild
+    '';
+
+    installPhase = ''
+      runHook preInstall
+      mkdir -p $out/bin
+      cp hiah-macho-bench $out/bin/
+      cp hiah-hook-bench $out/bin/
+      cp hiah-export-trie-bench $out/bin/
+      runHook postInstall
+    '';
+
+    meta = with lib; {
+      description = "Mach-O preparation throughput benchmark for HIAHKernel";
+      homepage = "https://github.com/aspauldingcode/HIAHKernel";
+      license = licenses.mit;
+      platforms = platforms.unix;
+    };
+  };
+
+  # Host tests for the portable C parts of the kernel (host build, no Xcode needed)
+  hostTests = pkgs.stdenv.mkDerivation {
+    name = "hiah-host-tests";
+    version = projectVersion;
+    src = hiahkernelSrc;
+
+    buildPhase = ''
+      runHook preBuild
+
+      CORE=src/HIAHKernel/Core
+      TESTS=src/HIAHHostTests
+      mkdir -p tests
+
+      echo "Compiling hiah-process-table-tests..."
+      $CC -O2 -pthread -I$TESTS -I$CORE/Process -o tests/hiah-process-table-tests \
+        $TESTS/HIAHProcessTableTests.c $CORE/Process/HIAHProcessTable.c
+
+      echo "Compiling hiah-control-server-tests..."
+      $CC -O2 -pthread -I$TESTS -I$CORE/IPC -o tests/hiah-control-server-tests \
+        $TESTS/HIAHControlServerTests.c $CORE/IPC/HIAHControlServer.c $CORE/IPC/HIAHControlProtocol.c
+
+      echo "Compiling hiah-symbol-index-tests..."
+      $CC -O2 -I$TESTS -I$CORE/Hooks -I$CORE/Loader -o tests/hiah-symbol-index-tests \
+        $TESTS/HIAHSymbolIndexTests.c $CORE/Hooks/HIAHSymbolIndex.c
+
+      echo "Compiling hiah-export-trie-tests..."
+      $CC -O2 -I$TESTS -I$CORE/Hooks -o tests/hiah-export-trie-tests \
+        $TESTS/HIAHExportTrieTests.c $CORE/Hooks/HIAHExportTrie.c
+
+      echo "Compiling hiah-chained-fixups-tests..."
+      $CC -O2 -I$TESTS -I$CORE/Hooks -o tests/hiah-chained-fixups-tests \
+        $TESTS/HIAHChainedFixupsTests.c $CORE/Hooks/HIAHChainedFixups.c
+
+      echo "Compiling hiah-file-actions-tests..."
+      $CC -O2 -pthread -I$TESTS -I$CORE/Hooks -o tests/hiah-file-actions-tests \
+        $TESTS/HIAHFileActionsTests.c $CORE/Hooks/HIAHFileActions.c
+
+      echo "Compiling hiah-child-wait-tests..."
+      $CC -O2 -pthread -I$TESTS -I$CORE/Process -o tests/hiah-child-wait-tests \
+        $TESTS/HIAHChildWaitTests.c $CORE/Process/HIAHChildRegistry.c $CORE/Process/HIAHChildWatcher.c
+
+      echo "Compiling hiah-hook-registry-tests..."
+      $CC -O2 -pthread -I$TESTS -I$CORE/Hooks -I$CORE/Loader -o tests/hiah-hook-registry-tests \
+        $TESTS/HIAHHookRegistryTests.c $CORE/Hooks/HIAHHookRegistry.c $CORE/Hooks/HIAHHookTargets.c
+
+      echo "Compiling hiah-macho-transform-tests..."
+      $CC -O2 -pthread -I$TESTS -I$CORE/Loader -o tests/hiah-macho-transform-tests \
+        $TESTS/HIAHMachOTransformTests.c $CORE/Loader/HIAHMachOTransform.c $CORE/Loader/HIAHWorkerPool.c \
+        $CORE/Loader/HIAHFileClone.c
+
+      runHook postBuild
+    '';
+
+    doCheck = true;
+    checkPhase = ''
+      runHook preCheck
+      for test in tests/*; do
+        $test
+      done
+      runHook postCheck
+    '';
+
+    installPhase = ''
+      runHook preInstall
+      mkdir -p $out/bin $out/share/hiah-host-tests
+      cp tests/* $out/bin/
+      cp -r src/HIAHHostTests/Fixtures $out/share/hiah-host-tests/
+      runHook postInstall
+    '';
+
+    meta = with lib; {
+      description = "Host tests for the portable parts of HIAHKernel";
+      homepage = "https://github.com/aspauldingcode/HIAHKernel";
+      license = licenses.mit;
+      platforms = platforms.unix;
+    };
+  };
+
 in {
   ios = iosSimulator;           # hiah-kernel - Core library
   iosTopApp = iosTopApp;           # hiah-top - Process Manager
@@ -843,5 +1121,10 @@ in {
   
   # Device builds
   iosDesktopDevice = iosDesktopDevice;
+
+  # Host tools
+  spawnBench = spawnBench;         # hiah-spawn-bench - Control socket load generator
+  machoBench = machoBench;         # hiah-macho-bench - Mach-O preparation benchmark
+  hostTests = hostTests;           # hiah-host-tests - Host test programs
 }
 
@@ -398,6 +398,9 @@ ENTEOF
           hiah-desktop = hiahkernelBuildModule.iosDesktopApp;
           hiah-installer = hiahkernelBuildModule.iosInstallerApp;
           hiah-desktop-device = hiahkernelBuildModule.iosDesktopDevice;
+          hiah-spawn-bench = hiahkernelBuildModule.spawnBench;
+          hiah-macho-bench = hiahkernelBuildModule.machoBench;
+          hiah-host-tests = hiahkernelBuildModule.hostTests;
           
           # SideStore components
           em-proxy = sidestore.em-proxy;
@@ -25,6 +25,7 @@
 #import <CarPlay/CarPlay.h>
 #import <UIKit/UIKit.h>
 #import <UniformTypeIdentifiers/UniformTypeIdentifiers.h>
+#import <mach-o/loader.h>
 #import <spawn.h>
 #import <sys/stat.h>
 #import <sys/wait.h>
@@ -480,6 +481,9 @@
           if ([HIAHMachOUtils patchBinaryToDylib:execPath]) {
             NSLog(@"[Installer] Patched %@ for dynamic loading", exec);
           }
+          // Index the installed binary so the app list and launches never
+          // have to open it
+          [HIAHMachOUtils indexBinary:execPath];
         }
         [self
             showResult:YES
@@ -571,6 +575,9 @@
           if ([HIAHMachOUtils patchBinaryToDylib:execPath]) {
             NSLog(@"[Installer] Patched %@ for dynamic loading", exec);
           }
+          // Index the installed binary so the app list and launches never
+          // have to open it
+          [HIAHMachOUtils indexBinary:execPath];
         }
         NSLog(@"[Installer] .ipa installed successfully");
         [self showResult:YES
@@ -1095,17 +1102,30 @@
     NSLog(@"[Desktop] Spawning .ipa app through HIAH Kernel extension: %@",
           name);
 
+    // The Mach-O index says whether the executable can be loaded at all and
+    // whether it still needs patching, without opening it
+    NSString *sourceExecutable = [[NSBundle bundleWithPath:appPath]
+        objectForInfoDictionaryKey:@"CFBundleExecutable"]
+                                     ?: name;
+    NSDictionary *binaryInfo = [HIAHMachOUtils
+        indexedInfoForBinary:[appPath
+                                 stringByAppendingPathComponent:sourceExecutable]];
+
     // Stage app to App Group so the extension can access it
     NSString *stagedAppPath =
-        [[HIAHFilesystem shared] stageAppForExtension:appPath];
+        binaryInfo ? [[HIAHFilesystem shared] stageAppForExtension:appPath]
+                   : nil;
     if (!stagedAppPath) {
-      HIAHLogError(HIAHLogFilesystem, "Failed to stage app for extension: %s",
+      HIAHLogError(HIAHLogFilesystem,
+                   binaryInfo ? "Failed to stage app for extension: %s"
+                              : "No loadable 64-bit Mach-O in app: %s",
                    [name UTF8String]);
       UIViewController *errorVC = [[UIViewController alloc] init];
       errorVC.view.backgroundColor = [UIColor colorWithWhite:0.05 alpha:1];
       UILabel *errorLabel = [[UILabel alloc] init];
       errorLabel.text =
-          @"Failed to stage app.\nApp Group may not be configured.";
+          binaryInfo ? @"Failed to stage app.\nApp Group may not be configured."
+                     : @"App executable is not a loadable 64-bit Mach-O.";
       errorLabel.numberOfLines = 0;
       errorLabel.textAlignment = NSTextAlignmentCenter;
       errorLabel.textColor = [UIColor redColor];
@@ -1150,8 +1170,12 @@
       chmod([executablePath UTF8String], 0755);
       NSLog(@"[Desktop] Set executable permissions");
 
-      // CRITICAL: Patch to a dlopen-compatible Mach-O type (see HIAHMachOUtils)
-      if ([HIAHMachOUtils patchBinaryToDylib:executablePath]) {
+      // CRITICAL: Patch to a dlopen-compatible Mach-O type (see
+      // HIAHMachOUtils). Installs patch the binary already, so the staged
+      // clone usually needs nothing.
+      uint32_t filetype = [binaryInfo[@"filetype"] unsignedIntValue];
+      if ((filetype == MH_EXECUTE || filetype == MH_DYLIB) &&
+          [HIAHMachOUtils patchBinaryToDylib:executablePath]) {
         NSLog(@"[Desktop] Patched binary for dynamic loading: %@",
               executablePath);
       }
@@ -2136,7 +2160,9 @@
     } else if ([hit isKindOfClass:[UICollectionViewCell class]] &&
                hit.tag < d.dock.availableApps.count) {
       NSDictionary *app = d.dock.availableApps[hit.tag];
-      [d launchApp:app[@"name"] bundleID:app[@"bundleID"]];
+      if ([app[@"loadable"] boolValue]) {
+        [d launchApp:app[@"name"] bundleID:app[@"bundleID"]];
+      }
     }
   }
 }
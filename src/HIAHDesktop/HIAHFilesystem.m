@@ -11,6 +11,7 @@
 #import "HIAHFilesystem.h"
 #import "HIAHMachOUtils.h"
 #import "HIAHLogging.h"
+#import "HIAHFileClone.h"
 #import <sys/stat.h>
 
 static NSString * const kHIAHAppGroupIdentifier = @"group.com.aspauldingcode.HIAHDesktop";
@@ -183,6 +184,20 @@ static NSString * const kHIAHAppGroupIdentifier = @"group.com.aspauldingcode.HIA
     
     [fm removeItemAtPath:stagedPath error:nil];
     
+    // Clone rather than copy: the extension only patches a few header pages
+    // of the executable, so the rest can stay shared with the original
+    HIAHFileCloneStats stats;
+    char cloneError[256];
+    if (HIAHFileCloneTree(appPath.fileSystemRepresentation, stagedPath.fileSystemRepresentation, 0,
+                          &stats, cloneError, sizeof(cloneError))) {
+        HIAHLogDebug(HIAHLogFilesystem, "Staged app: %s (%llu files, %llu cloned, %llu bytes copied)",
+                     [appName UTF8String], stats.files,
+                     stats.methods[HIAHFileCloneMethodClone], stats.bytesCopied);
+        return stagedPath;
+    }
+    HIAHLogError(HIAHLogFilesystem, "Clone staging of %s failed (%s) - copying instead", [appName UTF8String], cloneError);
+    [fm removeItemAtPath:stagedPath error:nil];
+    
     NSError *error = nil;
     if ([fm copyItemAtPath:appPath toPath:stagedPath error:&error]) {
         HIAHLogDebug(HIAHLogFilesystem, "Staged app: %s", [appName UTF8String]);
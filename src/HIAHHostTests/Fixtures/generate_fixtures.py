@@ -0,0 +1,333 @@
+#!/usr/bin/env python3
+"""
+generate_fixtures.py
+HIAHKernel – House in a House Virtual Kernel (for iOS)
+
+Writes the Mach-O fixtures the host tests read. They are checked in, so the
+tests need neither this script nor an Apple toolchain; rerun it only when a
+fixture has to change, and update the tests that describe its contents.
+
+  symbols.dylib       arm64 dylib: __got and __la_symbol_ptr slots named
+                      through LC_DYSYMTAB, including local, absolute and
+                      out-of-range indirect entries
+  symbols-exec.macho  the same imports in an executable with __PAGEZERO,
+                      __TEXT at 0x100000000 and a zero-fill tail on __DATA,
+                      so __LINKEDIT's file offset differs from its address
+  chained-arm64e.dylib
+  chained-64.dylib
+  chained-64-offset.macho
+                      LC_DYLD_CHAINED_FIXUPS in pointer formats 1, 2 and 6,
+                      one import table format each, with the same imports
+                      bound from chains that mix binds and rebases
+
+Copyright (c) 2025 Alex Spaulding
+Licensed under MIT License
+"""
+
+import os
+import struct
+
+MH_MAGIC_64 = 0xFEEDFACF
+CPU_TYPE_ARM64 = 0x0100000C
+MH_EXECUTE = 0x2
+MH_DYLIB = 0x6
+LC_SEGMENT_64 = 0x19
+LC_SYMTAB = 0x2
+LC_DYSYMTAB = 0xB
+LC_DYLD_CHAINED_FIXUPS = 0x80000034
+S_REGULAR = 0x0
+S_NON_LAZY_SYMBOL_POINTERS = 0x6
+S_LAZY_SYMBOL_POINTERS = 0x7
+INDIRECT_SYMBOL_LOCAL = 0x80000000
+INDIRECT_SYMBOL_ABS = 0x40000000
+N_UNDF_EXT = 0x01
+
+DYLD_CHAINED_PTR_ARM64E = 1
+DYLD_CHAINED_PTR_64 = 2
+DYLD_CHAINED_PTR_64_OFFSET = 6
+DYLD_CHAINED_IMPORT = 1
+DYLD_CHAINED_IMPORT_ADDEND = 2
+DYLD_CHAINED_IMPORT_ADDEND64 = 3
+DYLD_CHAINED_PTR_START_NONE = 0xFFFF
+BIND_SPECIAL_DYLIB_WEAK_LOOKUP = -3
+
+PAGE = 0x1000
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def name16(name):
+    return name.encode().ljust(16, b"\0")
+
+
+class Image:
+    """A Mach-O image laid out segment by segment."""
+
+    def __init__(self, filetype):
+        self.filetype = filetype
+        self.segments = []   # (name, vmaddr, vmsize, fileoff, filesize, sections)
+        self.commands = []
+        self.file = bytearray()
+
+    def segment(self, name, vmaddr, vmsize, fileoff, filesize, sections=()):
+        self.segments.append((name, vmaddr, vmsize, fileoff, filesize, list(sections)))
+
+    def write_at(self, offset, data):
+        if len(self.file) < offset + len(data):
+            self.file.extend(b"\0" * (offset + len(data) - len(self.file)))
+        self.file[offset:offset + len(data)] = data
+
+    def build(self, extra_commands):
+        commands = bytearray()
+        ncmds = 0
+        for name, vmaddr, vmsize, fileoff, filesize, sections in self.segments:
+            commands += struct.pack("<II16sQQQQiiII", LC_SEGMENT_64, 72 + 80 * len(sections),
+                                    name16(name), vmaddr, vmsize, fileoff, filesize, 7, 3,
+                                    len(sections), 0)
+            for sectname, addr, size, offset, flags, reserved1 in sections:
+                commands += struct.pack("<16s16sQQIIIIIIII", name16(sectname), name16(name),
+                                        addr, size, offset, 3, 0, 0, flags, reserved1, 0, 0)
+            ncmds += 1
+        for command in extra_commands:
+            commands += command
+            ncmds += 1
+        header = struct.pack("<IiiIIIII", MH_MAGIC_64, CPU_TYPE_ARM64, 0, self.filetype,
+                             ncmds, len(commands), 0, 0)
+        self.write_at(0, header + commands)
+        return bytes(self.file)
+
+
+def symbols_image(filetype, text, pagezero, zerofill):
+    """
+    Imports: _posix_spawn (two slots), _waitpid, _execve. The other slots
+    are local, absolute, out of range or unnamed and must not be indexed.
+    """
+    image = Image(filetype)
+    got_file, lazy_file, linkedit_file = PAGE, 2 * PAGE, 3 * PAGE
+    got_addr = text + got_file
+    lazy_addr = text + lazy_file
+    data_vmsize = PAGE + zerofill
+    linkedit_addr = lazy_addr + data_vmsize
+
+    strings = b"\0" + b"\0".join([b"_posix_spawn", b"_waitpid", b"_execve", b"_unused"]) + b"\0"
+    def strx(name):
+        return strings.index(b"\0" + name + b"\0") + 1
+    symbols = [
+        (strx(b"_posix_spawn"), N_UNDF_EXT),
+        (strx(b"_waitpid"), N_UNDF_EXT),
+        (strx(b"_execve"), N_UNDF_EXT),
+        (strx(b"_unused"), N_UNDF_EXT),
+        (0, N_UNDF_EXT),                          # No name
+    ]
+    indirect = [
+        0,                                        # got[0]  _posix_spawn
+        INDIRECT_SYMBOL_LOCAL,                    # got[1]
+        1,                                        # got[2]  _waitpid
+        INDIRECT_SYMBOL_LOCAL | INDIRECT_SYMBOL_ABS,  # got[3]
+        0,                                        # la[0]   _posix_spawn
+        2,                                        # la[1]   _execve
+        99,                                       # la[2]   out of range
+        4,                                        # la[3]   unnamed
+    ]
+
+    if pagezero:
+        image.segment("__PAGEZERO", 0, text, 0, 0)
+    image.segment("__TEXT", text, PAGE, 0, PAGE,
+                  [("__text", text + 0x800, 0x100, 0x800, 0x80000400, 0)])
+    image.segment("__DATA_CONST", got_addr, PAGE, got_file, PAGE,
+                  [("__got", got_addr, 32, got_file, S_NON_LAZY_SYMBOL_POINTERS, 0)])
+    image.segment("__DATA", lazy_addr, data_vmsize, lazy_file, PAGE,
+                  [("__la_symbol_ptr", lazy_addr, 32, lazy_file, S_LAZY_SYMBOL_POINTERS, 4),
+                   ("__data", lazy_addr + 0x100, 32, lazy_file + 0x100, S_REGULAR, 0)])
+
+    symoff = linkedit_file
+    nlist = b"".join(struct.pack("<IBBHQ", n, t, 0, 0, 0) for n, t in symbols)
+    indirectoff = symoff + len(nlist)
+    indirect_data = b"".join(struct.pack("<I", i) for i in indirect)
+    stroff = indirectoff + len(indirect_data)
+    linkedit_size = stroff + len(strings) - linkedit_file
+    image.segment("__LINKEDIT", linkedit_addr, PAGE, linkedit_file, linkedit_size)
+
+    # Slots hold recognisable junk; the index never reads them
+    image.write_at(got_file, b"".join(struct.pack("<Q", 0x1111 * (i + 1)) for i in range(4)))
+    image.write_at(lazy_file, b"".join(struct.pack("<Q", 0x2222 * (i + 1)) for i in range(4)))
+    image.write_at(symoff, nlist + indirect_data + strings)
+
+    symtab = struct.pack("<IIIIII", LC_SYMTAB, 24, symoff, len(symbols), stroff, len(strings))
+    dysymtab = struct.pack("<II18I", LC_DYSYMTAB, 80,
+                           0, 0,                       # Local symbols
+                           0, 0,                       # Defined external symbols
+                           0, len(symbols),            # Undefined symbols
+                           0, 0, 0, 0, 0, 0,           # TOC, modules, external refs
+                           indirectoff, len(indirect),
+                           0, 0, 0, 0)                 # Relocations
+    return image.build([symtab, dysymtab])
+
+
+# Chain links: ("bind", ordinal, addend), ("rebase", target),
+# ("auth_bind", ordinal, diversity, addr_div, key) and
+# ("auth_rebase", target, diversity, addr_div, key)
+def encode_link(fmt, link, next):
+    kind = link[0]
+    if fmt in (DYLD_CHAINED_PTR_64, DYLD_CHAINED_PTR_64_OFFSET):
+        # bind:1 next:12 reserved:19 addend:8 ordinal:24, or
+        # bind:0 next:12 reserved:7 high8:8 target:36
+        if kind == "bind":
+            return 1 << 63 | next << 51 | link[2] << 24 | link[1]
+        return next << 51 | link[1]
+    # auth:1 bind:1 next:11, then per kind
+    if kind == "bind":
+        return 1 << 62 | next << 51 | (link[2] & 0x7FFFF) << 32 | link[1]
+    if kind == "auth_bind":
+        return (1 << 63 | 1 << 62 | next << 51 | link[4] << 49 | link[3] << 48 |
+                link[2] << 32 | link[1])
+    if kind == "auth_rebase":
+        return 1 << 63 | next << 51 | link[4] << 49 | link[3] << 48 | link[2] << 32 | link[1]
+    return next << 51 | link[1]
+
+
+def encode_chain(fmt, links):
+    """links: [(offset, link)] in chain order. Returns [(offset, raw)]."""
+    stride = 8 if fmt == DYLD_CHAINED_PTR_ARM64E else 4
+    encoded = []
+    for i, (offset, link) in enumerate(links):
+        next = (links[i + 1][0] - offset) // stride if i + 1 < len(links) else 0
+        encoded.append((offset, encode_link(fmt, link, next)))
+    return encoded
+
+
+CHAINED_IMPORTS = [
+    # (name, library ordinal, weak)
+    (b"_posix_spawn", 1, False),
+    (b"_waitpid", 1, False),
+    (b"_execve", 1, False),
+    (b"_posix_spawn", 2, False),                  # Same name from another dylib
+    (b"_weak_var", BIND_SPECIAL_DYLIB_WEAK_LOOKUP, True),
+    (b"_unused", 1, False),                       # Never bound
+]
+
+
+def chained_image(fmt, imports_format, pagezero):
+    """
+    __DATA_CONST (three pages) and __DATA hold the chains:
+
+      __DATA_CONST+0x10     _posix_spawn      import 0
+      __DATA_CONST+0x18     rebase
+      __DATA_CONST+0x20     _waitpid          import 1, inline addend
+      __DATA_CONST+0x30     _posix_spawn      import 3
+      (page 1 has no fixups)
+      __DATA_CONST+0x2040   _waitpid          import 1
+      __DATA+0x0            rebase (authenticated in format 1)
+      __DATA+0x8            _execve           import 2, the import's addend
+                                              (authenticated in format 1)
+      __DATA+0x10           _weak_var         import 4
+
+    The inline addend is -16 in format 1 and 8 in the others. _execve's
+    import addend is 32 with DYLD_CHAINED_IMPORT_ADDEND and 0x100000000 with
+    DYLD_CHAINED_IMPORT_ADDEND64.
+    """
+    arm64e = fmt == DYLD_CHAINED_PTR_ARM64E
+    image = Image(MH_EXECUTE if pagezero else MH_DYLIB)
+    text = 0x100000000 if pagezero else 0
+    const_file, data_file, linkedit_file = PAGE, 4 * PAGE, 5 * PAGE
+
+    const_chains = [
+        [(0x10, ("bind", 0, 0)),
+         (0x18, ("rebase", 0x800)),
+         (0x20, ("bind", 1, -16 if arm64e else 8)),
+         (0x30, ("bind", 3, 0))],
+        [],
+        [(0x40, ("bind", 1, 0))],
+    ]
+    data_chain = [
+        (0x0, ("auth_rebase", 0x900, 0x55, 1, 2) if arm64e else ("rebase", 0x900)),
+        (0x8, ("auth_bind", 2, 0x1234, 1, 0) if arm64e else ("bind", 2, 0)),
+        (0x10, ("bind", 4, 0)),
+    ]
+    for page, chain in enumerate(const_chains):
+        for offset, raw in encode_chain(fmt, chain):
+            image.write_at(const_file + page * PAGE + offset, struct.pack("<Q", raw))
+    for offset, raw in encode_chain(fmt, data_chain):
+        image.write_at(data_file + offset, struct.pack("<Q", raw))
+
+    # dyld_chained_starts_in_segment for one segment
+    def starts_in_segment(segment_offset, chains):
+        pages = [chain[0][0] if chain else DYLD_CHAINED_PTR_START_NONE for chain in chains]
+        starts = struct.pack("<IHHQIH", 22 + 2 * len(pages), PAGE, fmt, segment_offset, 0,
+                             len(pages))
+        starts += b"".join(struct.pack("<H", page) for page in pages)
+        return starts + b"\0" * (-len(starts) % 4)
+
+    segment_names = (["__PAGEZERO"] if pagezero else []) + \
+                    ["__TEXT", "__DATA_CONST", "__DATA", "__LINKEDIT"]
+    segment_starts = {
+        "__DATA_CONST": starts_in_segment(const_file, const_chains),
+        "__DATA": starts_in_segment(data_file, [data_chain]),
+    }
+    starts_in_image = bytearray(struct.pack("<I", len(segment_names)))
+    body = bytearray()
+    for name in segment_names:
+        if name in segment_starts:
+            starts_in_image += struct.pack("<I", 4 + 4 * len(segment_names) + len(body))
+            body += segment_starts[name]
+        else:
+            starts_in_image += struct.pack("<I", 0)
+    starts_in_image += body
+
+    pool = bytearray(b"\0")
+    imports = bytearray()
+    for name, ordinal, weak in CHAINED_IMPORTS:
+        name_offset = len(pool)
+        pool += name + b"\0"
+        addend = 0
+        if name == b"_execve":
+            addend = 0x100000000 if imports_format == DYLD_CHAINED_IMPORT_ADDEND64 else 32
+        if imports_format == DYLD_CHAINED_IMPORT_ADDEND64:
+            imports += struct.pack("<QQ", (ordinal & 0xFFFF) | weak << 16 | name_offset << 32,
+                                   addend)
+        else:
+            imports += struct.pack("<I", (ordinal & 0xFF) | weak << 8 | name_offset << 9)
+            if imports_format == DYLD_CHAINED_IMPORT_ADDEND:
+                imports += struct.pack("<i", addend)
+
+    starts_offset = 32
+    imports_offset = starts_offset + len(starts_in_image)
+    symbols_offset = imports_offset + len(imports)
+    payload = struct.pack("<IIIIIII", 0, starts_offset, imports_offset, symbols_offset,
+                          len(CHAINED_IMPORTS), imports_format, 0)
+    payload += b"\0" * (starts_offset - len(payload)) + starts_in_image + imports + pool
+    image.write_at(linkedit_file, payload)
+
+    if pagezero:
+        image.segment("__PAGEZERO", 0, text, 0, 0)
+    image.segment("__TEXT", text, PAGE, 0, PAGE,
+                  [("__text", text + 0x800, 0x100, 0x800, 0x80000400, 0)])
+    image.segment("__DATA_CONST", text + const_file, 3 * PAGE, const_file, 3 * PAGE,
+                  [("__const", text + const_file, 3 * PAGE, const_file, S_REGULAR, 0)])
+    image.segment("__DATA", text + data_file, PAGE, data_file, PAGE,
+                  [("__data", text + data_file, PAGE, data_file, S_REGULAR, 0)])
+    image.segment("__LINKEDIT", text + linkedit_file, PAGE, linkedit_file, len(payload))
+    fixups = struct.pack("<IIII", LC_DYLD_CHAINED_FIXUPS, 16, linkedit_file, len(payload))
+    return image.build([fixups])
+
+
+FIXTURES = {
+    "symbols.dylib": lambda: symbols_image(MH_DYLIB, 0, False, 0),
+    "symbols-exec.macho": lambda: symbols_image(MH_EXECUTE, 0x100000000, True, 2 * PAGE),
+    "chained-arm64e.dylib": lambda: chained_image(DYLD_CHAINED_PTR_ARM64E,
+                                                  DYLD_CHAINED_IMPORT_ADDEND64, False),
+    "chained-64.dylib": lambda: chained_image(DYLD_CHAINED_PTR_64, DYLD_CHAINED_IMPORT, False),
+    "chained-64-offset.macho": lambda: chained_image(DYLD_CHAINED_PTR_64_OFFSET,
+                                                     DYLD_CHAINED_IMPORT_ADDEND, True),
+}
+
+
+def main():
+    for name, build in FIXTURES.items():
+        with open(os.path.join(HERE, name), "wb") as f:
+            f.write(build())
+        print("wrote", name)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,277 @@
+/**
+ * HIAHChainedFixupsTests.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Host tests for the chained fixups import → bind slot table.
+ *
+ * The fixtures (Fixtures/chained-*, see generate_fixtures.py) carry the
+ * same imports and chains in pointer formats 1 (ARM64E), 2 (64) and
+ * 6 (64_OFFSET), each with a different import table format. The table is
+ * built from the file contents of each segment, as HIAHHook builds it, and
+ * must find every bind slot with its addend and, for arm64e, its
+ * authentication; rebases in the same chains must be stepped over.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHHostTest.h"
+#include "HIAHChainedFixups.h"
+#include <string.h>
+
+#define TEST_LC_SEGMENT_64          0x19u
+#define TEST_LC_DYLD_CHAINED_FIXUPS 0x80000034u
+#define TEST_PAGE                   0x1000u
+#define TEST_MAX_SEGMENTS           8
+
+typedef struct {
+    uint8_t *file;
+    HIAHChainedSegment segments[TEST_MAX_SEGMENTS];
+    uint32_t segmentCount;
+    uint32_t constSegment;     // __DATA_CONST
+    uint32_t dataSegment;      // __DATA
+    uint8_t *payload;          // LC_DYLD_CHAINED_FIXUPS, inside file
+    size_t payloadSize;
+} TestFixture;
+
+/**
+ * What differs between the fixtures.
+ */
+typedef struct {
+    int64_t inlineAddend;      // Of the first _waitpid bind
+    int64_t execveAddend;      // From _execve's import entry
+    bool authenticated;        // _execve is an authenticated bind
+} TestExpected;
+
+static uint32_t TestRead32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t TestRead64(const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static void TestWrite16(uint8_t *p, uint16_t value) {
+    memcpy(p, &value, sizeof(value));
+}
+
+static void TestWrite32(uint8_t *p, uint32_t value) {
+    memcpy(p, &value, sizeof(value));
+}
+
+static void TestWrite64(uint8_t *p, uint64_t value) {
+    memcpy(p, &value, sizeof(value));
+}
+
+static TestFixture TestLoadFixture(const char *name) {
+    size_t fileSize = 0;
+    TestFixture fixture = {0};
+    fixture.file = HIAHTestReadFixture(name, &fileSize);
+    fixture.constSegment = fixture.dataSegment = UINT32_MAX;
+
+    uint8_t *cursor = fixture.file + 32;
+    for (uint32_t i = 0; i < TestRead32(fixture.file + 16); i++) {
+        uint32_t cmd = TestRead32(cursor);
+        if (cmd == TEST_LC_SEGMENT_64) {
+            HIAH_CHECK(fixture.segmentCount < TEST_MAX_SEGMENTS);
+            uint64_t fileoff = TestRead64(cursor + 40), filesize = TestRead64(cursor + 48);
+            HIAH_CHECK(fileoff + filesize <= fileSize);
+            if (memcmp(cursor + 8, "__DATA_CONST", 13) == 0) {
+                fixture.constSegment = fixture.segmentCount;
+            } else if (memcmp(cursor + 8, "__DATA", 7) == 0) {
+                fixture.dataSegment = fixture.segmentCount;
+            }
+            fixture.segments[fixture.segmentCount++] =
+                (HIAHChainedSegment){ fixture.file + fileoff, filesize };
+        } else if (cmd == TEST_LC_DYLD_CHAINED_FIXUPS) {
+            uint32_t dataoff = TestRead32(cursor + 8), datasize = TestRead32(cursor + 12);
+            HIAH_CHECK((size_t)dataoff + datasize <= fileSize);
+            fixture.payload = fixture.file + dataoff;
+            fixture.payloadSize = datasize;
+        }
+        cursor += TestRead32(cursor + 4);
+    }
+    HIAH_CHECK(fixture.payload != NULL);
+    HIAH_CHECK(fixture.constSegment != UINT32_MAX && fixture.dataSegment != UINT32_MAX);
+    return fixture;
+}
+
+static HIAHChainedFixups *TestCreate(const TestFixture *fixture) {
+    return HIAHChainedFixupsCreate(fixture->payload, fixture->payloadSize, fixture->segments,
+                                   fixture->segmentCount);
+}
+
+/**
+ * @return dyld_chained_starts_in_segment of `segment`, inside the payload
+ */
+static uint8_t *TestSegmentStarts(const TestFixture *fixture, uint32_t segment) {
+    uint8_t *startsInImage = fixture->payload + TestRead32(fixture->payload + 4);
+    return startsInImage + TestRead32(startsInImage + 4 + segment * 4);
+}
+
+static void TestCheckBind(const HIAHChainedBind *bind, uint32_t segment, uint64_t offset,
+                          uint32_t import, int64_t addend) {
+    HIAH_CHECK_EQ(bind->segment, segment);
+    HIAH_CHECK_EQ(bind->offset, offset);
+    HIAH_CHECK_EQ(bind->import, import);
+    HIAH_CHECK_EQ(bind->addend, addend);
+}
+
+static void TestCheckFixture(const char *name, TestExpected expected) {
+    TestFixture fixture = TestLoadFixture(name);
+    HIAHChainedFixups *fixups = TestCreate(&fixture);
+    HIAH_CHECK(fixups != NULL);
+
+    HIAH_CHECK_EQ(HIAHChainedFixupsImportCount(fixups), 6);
+    const HIAHChainedImport *import = HIAHChainedFixupsImport(fixups, 0);
+    HIAH_CHECK(strcmp(import->name, "_posix_spawn") == 0);
+    HIAH_CHECK_EQ(import->libraryOrdinal, 1);
+    HIAH_CHECK(!import->weak);
+    HIAH_CHECK_EQ(HIAHChainedFixupsImport(fixups, 3)->libraryOrdinal, 2);
+    import = HIAHChainedFixupsImport(fixups, 4);
+    HIAH_CHECK(strcmp(import->name, "_weak_var") == 0);
+    HIAH_CHECK_EQ(import->libraryOrdinal, -3);
+    HIAH_CHECK(import->weak);
+    HIAH_CHECK(HIAHChainedFixupsImport(fixups, 6) == NULL);
+
+    // Six binds; the rebases between them are not slots
+    size_t count = 0;
+    HIAH_CHECK(HIAHChainedFixupsBinds(fixups, &count) != NULL);
+    HIAH_CHECK_EQ(count, 6);
+
+    // Both imports named _posix_spawn, in chain order
+    const HIAHChainedBind *binds = HIAHChainedFixupsFind(fixups, "posix_spawn", &count);
+    HIAH_CHECK_EQ(count, 2);
+    TestCheckBind(&binds[0], fixture.constSegment, 0x10, 0, 0);
+    TestCheckBind(&binds[1], fixture.constSegment, 0x30, 3, 0);
+
+    // The second chain of __DATA_CONST starts on its third page
+    binds = HIAHChainedFixupsFind(fixups, "waitpid", &count);
+    HIAH_CHECK_EQ(count, 2);
+    TestCheckBind(&binds[0], fixture.constSegment, 0x20, 1, expected.inlineAddend);
+    TestCheckBind(&binds[1], fixture.constSegment, 2 * TEST_PAGE + 0x40, 1, 0);
+    HIAH_CHECK_EQ(binds[0].flags, 0);
+
+    binds = HIAHChainedFixupsFind(fixups, "execve", &count);
+    HIAH_CHECK_EQ(count, 1);
+    TestCheckBind(&binds[0], fixture.dataSegment, 0x8, 2, expected.execveAddend);
+    if (expected.authenticated) {
+        HIAH_CHECK_EQ(binds[0].flags, HIAH_CHAINED_BIND_AUTH | HIAH_CHAINED_BIND_ADDRESS_DIVERSITY);
+        HIAH_CHECK_EQ(binds[0].key, 0);
+        HIAH_CHECK_EQ(binds[0].diversity, 0x1234);
+    } else {
+        HIAH_CHECK_EQ(binds[0].flags, 0);
+    }
+
+    binds = HIAHChainedFixupsFind(fixups, "weak_var", &count);
+    HIAH_CHECK_EQ(count, 1);
+    TestCheckBind(&binds[0], fixture.dataSegment, 0x10, 4, 0);
+
+    // Imported but never bound, and names that are not imported
+    HIAH_CHECK(HIAHChainedFixupsFind(fixups, "unused", &count) == NULL);
+    HIAH_CHECK_EQ(count, 0);
+    HIAH_CHECK(HIAHChainedFixupsFind(fixups, "_posix_spawn", &count) == NULL);
+    HIAH_CHECK(HIAHChainedFixupsFind(fixups, "posix_spaw", &count) == NULL);
+    HIAH_CHECK(HIAHChainedFixupsFind(fixups, "", &count) == NULL);
+
+    HIAHChainedFixupsDestroy(fixups);
+    free(fixture.file);
+}
+
+// MARK: - Tests
+
+static void TestPointerFormatARM64E(void) {
+    TestCheckFixture("chained-arm64e.dylib", (TestExpected){ -16, 0x100000000, true });
+}
+
+static void TestPointerFormat64(void) {
+    TestCheckFixture("chained-64.dylib", (TestExpected){ 8, 0, false });
+}
+
+static void TestPointerFormat64Offset(void) {
+    // __PAGEZERO first, so every segment index is one higher
+    TestCheckFixture("chained-64-offset.macho", (TestExpected){ 8, 32, false });
+}
+
+static void TestUnsupportedPointerFormat(void) {
+    TestFixture fixture = TestLoadFixture("chained-64.dylib");
+    // DYLD_CHAINED_PTR_32
+    TestWrite16(TestSegmentStarts(&fixture, fixture.constSegment) + 6, 3);
+    HIAH_CHECK(TestCreate(&fixture) == NULL);
+    free(fixture.file);
+}
+
+static void TestTruncated(void) {
+    TestFixture fixture = TestLoadFixture("chained-arm64e.dylib");
+    HIAH_CHECK(HIAHChainedFixupsCreate(NULL, fixture.payloadSize, fixture.segments,
+                                       fixture.segmentCount) == NULL);
+
+    // Every prefix cuts into the last import name at least; copies of
+    // exactly that size let a sanitizer build catch reads past the end
+    for (size_t size = 0; size < fixture.payloadSize; size++) {
+        uint8_t *copy = malloc(size ? size : 1);
+        memcpy(copy, fixture.payload, size);
+        HIAH_CHECK(HIAHChainedFixupsCreate(copy, size, fixture.segments,
+                                           fixture.segmentCount) == NULL);
+        free(copy);
+    }
+
+    // Fewer segments than the starts table describes
+    HIAH_CHECK(HIAHChainedFixupsCreate(fixture.payload, fixture.payloadSize, fixture.segments,
+                                       fixture.dataSegment) == NULL);
+
+    // A chain that runs off the end of its segment
+    fixture.segments[fixture.dataSegment].size = 0x10;
+    HIAH_CHECK(TestCreate(&fixture) == NULL);
+    free(fixture.file);
+}
+
+static void TestMalformed(void) {
+    TestFixture fixture = TestLoadFixture("chained-64.dylib");
+    TestWrite32(fixture.payload, 1);
+    HIAH_CHECK(TestCreate(&fixture) == NULL);
+    free(fixture.file);
+
+    // A bind to an ordinal past the import table
+    fixture = TestLoadFixture("chained-64.dylib");
+    uint8_t *slot = (uint8_t *)fixture.segments[fixture.constSegment].data + 0x10;
+    TestWrite64(slot, (TestRead64(slot) & ~0xFFFFFFull) | 6);
+    HIAH_CHECK(TestCreate(&fixture) == NULL);
+    free(fixture.file);
+
+    // An import name outside the symbol pool (DYLD_CHAINED_IMPORT: name_offset:23)
+    fixture = TestLoadFixture("chained-64.dylib");
+    uint8_t *imports = fixture.payload + TestRead32(fixture.payload + 8);
+    TestWrite32(imports, (TestRead32(imports) & 0x1FF) | 0x7FFFFFu << 9);
+    HIAH_CHECK(TestCreate(&fixture) == NULL);
+    free(fixture.file);
+
+    // A page start too close to the end of the segment for a pointer
+    fixture = TestLoadFixture("chained-64-offset.macho");
+    TestWrite16(TestSegmentStarts(&fixture, fixture.dataSegment) + 22, TEST_PAGE - 4);
+    HIAH_CHECK(TestCreate(&fixture) == NULL);
+    free(fixture.file);
+
+    // A multi-start page, which only 32-bit formats use
+    fixture = TestLoadFixture("chained-arm64e.dylib");
+    TestWrite16(TestSegmentStarts(&fixture, fixture.constSegment) + 22, 0x8000);
+    HIAH_CHECK(TestCreate(&fixture) == NULL);
+    free(fixture.file);
+}
+
+int main(void) {
+    printf("HIAHChainedFixups\n");
+    HIAH_RUN_TEST(TestPointerFormatARM64E);
+    HIAH_RUN_TEST(TestPointerFormat64);
+    HIAH_RUN_TEST(TestPointerFormat64Offset);
+    HIAH_RUN_TEST(TestUnsupportedPointerFormat);
+    HIAH_RUN_TEST(TestTruncated);
+    HIAH_RUN_TEST(TestMalformed);
+    return 0;
+}
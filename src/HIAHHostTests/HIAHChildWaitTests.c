@@ -0,0 +1,489 @@
+/**
+ * HIAHChildWaitTests.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Host tests for waits on virtual and forwarded children.
+ *
+ * A simulated shell spawns hundreds of children, some in-process (virtual)
+ * and some forwarded, and collects them the way a shell does: waitpid(-1),
+ * waitpid(0), group waits and waits by PID, blocking and WNOHANG, until
+ * ECHILD. The kernel side is a HIAHChildRegistry keyed by the physical
+ * PID, as in HIAHKernel, and a HIAHChildWatcher feeds its exits to the
+ * shell's registry. Every child must be collected exactly once, with its
+ * own status, and no wait may give up while a child is still running.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHHostTest.h"
+#include "HIAHChildRegistry.h"
+#include "HIAHChildWatcher.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TEST_MAX_CHILDREN   1024
+#define TEST_KERNEL_PID     1000          // HIAHKernel's first virtual PID
+#define TEST_GUEST_PID      0x10000000    // HIAH_GUEST_FIRST_VIRTUAL_PID
+
+// MARK: - Simulated kernel and shell
+
+typedef struct {
+    HIAHChildRegistry *registry;   // Forwarded children, by physical parent
+    atomic_bool unavailable;
+} TestKernel;
+
+// As HIAHKernel keys the parents: negated, so a physical PID is never taken
+// for one of the kernel's own
+static pid_t TestKernelParent(void) {
+    return -getpid();
+}
+
+typedef struct {
+    pid_t pid;
+    pid_t group;
+    int code;
+    bool external;
+    int collected;
+    unsigned delay;           // Microseconds it runs for
+    atomic_bool release;      // Or until set, when delay is 0
+    atomic_bool exited;
+    HIAHChildRegistry *registry;
+    pthread_t runner;
+} TestChild;
+
+typedef struct {
+    TestKernel kernel;
+    HIAHChildRegistry *registry;   // The shell's
+    HIAHChildWatcher *watcher;
+    pid_t pid;
+    TestChild children[TEST_MAX_CHILDREN];
+    int count;
+    uint32_t seed;
+} TestShell;
+
+// The watcher's wait: a blocking any-child wait, answered by the kernel
+static pid_t TestKernelWait(int *status, void *context) {
+    TestKernel *kernel = context;
+    if (atomic_load(&kernel->unavailable)) {
+        return -1;
+    }
+    pid_t pid = HIAHChildRegistryWait(kernel->registry, TestKernelParent(), -1, status, 0);
+    return pid > 0 ? pid : 0;
+}
+
+static uint32_t TestRandom(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void TestShellInit(TestShell *shell, uint32_t seed) {
+    memset(shell, 0, sizeof(*shell));
+    shell->kernel.registry = HIAHChildRegistryCreate(TEST_KERNEL_PID, NULL, NULL);
+    HIAHChildRegistryTrackExternal(shell->kernel.registry, true);
+    shell->registry = HIAHChildRegistryCreate(TEST_GUEST_PID, NULL, NULL);
+    shell->watcher = HIAHChildWatcherCreate(shell->registry, TestKernelWait, &shell->kernel);
+    HIAH_CHECK(shell->kernel.registry && shell->registry && shell->watcher);
+    shell->pid = getpid();
+    shell->seed = seed;
+}
+
+static void TestShellDestroy(TestShell *shell) {
+    for (int i = 0; i < shell->count; i++) {
+        pthread_join(shell->children[i].runner, NULL);
+    }
+    // Nothing is left, so the watcher is about to stop
+    HIAHChildWatcherDestroy(shell->watcher);
+    HIAHChildRegistryStats stats;
+    HIAHChildRegistryGetStats(shell->registry, &stats);
+    HIAH_CHECK_EQ(stats.running + stats.zombies, 0);
+    HIAHChildRegistryGetStats(shell->kernel.registry, &stats);
+    HIAH_CHECK_EQ(stats.running + stats.zombies, 0);
+    HIAHChildRegistryDestroy(shell->registry);
+    HIAHChildRegistryDestroy(shell->kernel.registry);
+}
+
+static void *TestChildRun(void *data) {
+    TestChild *child = data;
+    if (child->delay) {
+        usleep(child->delay);
+    } else {
+        while (!atomic_load(&child->release)) {
+            usleep(100);
+        }
+    }
+    HIAHChildRegistryExit(child->registry, child->pid, W_EXITCODE(child->code, 0));
+    atomic_store(&child->exited, true);
+    return NULL;
+}
+
+/**
+ * posix_spawn() as the hooks do it. Forwarded children are started by the
+ * kernel, which may see them exit before the spawn returns.
+ *
+ * @param group As for HIAHChildRegistryAdd()
+ * @param delay Microseconds the child runs; 0 until released
+ */
+static TestChild *TestSpawn(TestShell *shell, bool external, pid_t group, unsigned delay) {
+    HIAH_CHECK(shell->count < TEST_MAX_CHILDREN);
+    TestChild *child = &shell->children[shell->count++];
+    child->external = external;
+    child->code = (shell->count * 7) & 0xff;
+    child->delay = delay;
+    atomic_init(&child->release, false);
+    atomic_init(&child->exited, false);
+
+    if (external) {
+        HIAHChildWatcherWillSpawn(shell->watcher);
+        child->pid = HIAHChildRegistryAdd(shell->kernel.registry, TestKernelParent(), 0, 0);
+        child->registry = shell->kernel.registry;
+        HIAH_CHECK(pthread_create(&child->runner, NULL, TestChildRun, child) == 0);
+        // The spawn reply is slow now and then
+        if (TestRandom(&shell->seed) % 8 == 0) {
+            usleep(TestRandom(&shell->seed) % 500);
+        }
+        HIAH_CHECK_EQ(HIAHChildWatcherDidSpawn(shell->watcher, shell->pid, group, child->pid), child->pid);
+    } else {
+        child->pid = HIAHChildRegistryAdd(shell->registry, shell->pid, group, 0);
+        child->registry = shell->registry;
+        HIAH_CHECK(pthread_create(&child->runner, NULL, TestChildRun, child) == 0);
+    }
+    HIAH_CHECK(child->pid > 0);
+    child->group = HIAHChildRegistryGroup(shell->registry, child->pid);
+    return child;
+}
+
+static TestChild *TestFind(TestShell *shell, pid_t pid) {
+    for (int i = 0; i < shell->count; i++) {
+        if (shell->children[i].pid == pid) {
+            return &shell->children[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * The kernel's wait by PID. It goes by the process table, not the registry,
+ * and drops the child from the registry once it answers with its exit.
+ */
+static pid_t TestKernelWaitPid(TestShell *shell, pid_t pid, int *status, int options) {
+    TestChild *child = TestFind(shell, pid);
+    if (atomic_load(&shell->kernel.unavailable) || !child) {
+        return -1;
+    }
+    while (!atomic_load(&child->exited)) {
+        if (options & WNOHANG) {
+            return 0;
+        }
+        usleep(50);
+    }
+    HIAHChildRegistryRemove(shell->kernel.registry, pid);
+    *status = W_EXITCODE(child->code, 0);
+    return pid;
+}
+
+/**
+ * hook_waitpid(): a forwarded child that is named is asked for directly,
+ * anything else is left to the shell's registry.
+ */
+static pid_t TestWaitpid(TestShell *shell, pid_t pid, int *status, int options) {
+    HIAHChildInfo info;
+    if (pid > 0 && HIAHChildRegistryLookup(shell->registry, pid, &info) && info.parent == shell->pid &&
+        info.external && !info.exited) {
+        int childStatus = 0;
+        pid_t result = TestKernelWaitPid(shell, pid, &childStatus, options);
+        if (result == 0) {
+            return 0;
+        }
+        if (result < 0) {
+            HIAHChildRegistryRemove(shell->registry, pid);
+        } else {
+            HIAHChildRegistryExit(shell->registry, pid, childStatus);
+        }
+        return HIAHChildRegistryWait(shell->registry, shell->pid, pid, status, WNOHANG);
+    }
+    if (HIAHChildRegistryHasChildren(shell->registry, shell->pid, pid)) {
+        return HIAHChildRegistryWait(shell->registry, shell->pid, pid, status, options);
+    }
+    errno = ECHILD;
+    return -1;
+}
+
+// Checks a collected child and returns it
+static TestChild *TestCollected(TestShell *shell, pid_t pid, int status) {
+    TestChild *child = TestFind(shell, pid);
+    HIAH_CHECK(child != NULL);
+    HIAH_CHECK_EQ(child->collected, 0);
+    child->collected++;
+    HIAH_CHECK(WIFEXITED(status));
+    HIAH_CHECK_EQ(WEXITSTATUS(status), child->code);
+    return child;
+}
+
+/**
+ * Waits with `selector` until ECHILD and returns how many were collected.
+ * Each must satisfy the selector.
+ */
+static int TestDrain(TestShell *shell, pid_t selector, int options) {
+    int collected = 0;
+    for (;;) {
+        int status = 0;
+        pid_t pid = TestWaitpid(shell, selector, &status, options);
+        if (pid < 0) {
+            HIAH_CHECK_EQ(errno, ECHILD);
+            return collected;
+        }
+        if (pid == 0) {
+            HIAH_CHECK(options & WNOHANG);
+            usleep(50);
+            continue;
+        }
+        TestChild *child = TestCollected(shell, pid, status);
+        if (selector == 0) {
+            HIAH_CHECK_EQ(child->group, shell->pid);
+        } else if (selector < -1) {
+            HIAH_CHECK_EQ(child->group, -selector);
+        }
+        collected++;
+    }
+}
+
+// MARK: - Tests
+
+static void TestAnyChild(void) {
+    TestShell *shell = calloc(1, sizeof(TestShell));
+    TestShellInit(shell, 0x9e3779b9u);
+
+    // A shell running a script: starts jobs, reaps what finished
+    // (WNOHANG) every few, then waits for the rest
+    int collected = 0;
+    for (int i = 0; i < 400; i++) {
+        TestSpawn(shell, i % 3 != 0, -1, 1 + TestRandom(&shell->seed) % 3000);
+        if (i % 16 == 15) {
+            int status;
+            pid_t pid;
+            while ((pid = TestWaitpid(shell, -1, &status, WNOHANG)) > 0) {
+                TestCollected(shell, pid, status);
+                collected++;
+            }
+            // ECHILD only once every child so far is collected
+            HIAH_CHECK(pid == 0 || (pid < 0 && errno == ECHILD && collected == i + 1));
+        }
+    }
+    collected += TestDrain(shell, -1, 0);
+    HIAH_CHECK_EQ(collected, 400);
+
+    // Every forwarded exit came through the watcher
+    HIAHChildWatcherStats stats;
+    HIAHChildWatcherGetStats(shell->watcher, &stats);
+    HIAH_CHECK_EQ(stats.spawns, 266);
+    HIAH_CHECK_EQ(stats.exits, 266);
+    HIAH_CHECK_EQ(stats.failures, 0);
+    TestShellDestroy(shell);
+    free(shell);
+}
+
+static void TestGroups(void) {
+    TestShell *shell = calloc(1, sizeof(TestShell));
+    TestShellInit(shell, 0x85ebca6bu);
+
+    // Two pipelines in groups of their own, each led by its first command,
+    // and jobs in the shell's group
+    pid_t groups[2] = {0, 0};
+    int counts[3] = {0, 0, 0};
+    for (int i = 0; i < 300; i++) {
+        int job = i % 3;
+        bool external = (i / 3) % 2 == 0;
+        unsigned delay = 1 + TestRandom(&shell->seed) % 4000;
+        if (job == 2) {
+            TestSpawn(shell, external, -1, delay);
+        } else {
+            TestChild *child = TestSpawn(shell, external, groups[job], delay);
+            if (!groups[job]) {
+                groups[job] = child->pid;
+            }
+            HIAH_CHECK_EQ(child->group, groups[job]);
+        }
+        counts[job]++;
+    }
+
+    HIAH_CHECK_EQ(TestDrain(shell, 0, 0), counts[2]);
+    HIAH_CHECK_EQ(TestDrain(shell, -groups[0], 0), counts[0]);
+    HIAH_CHECK_EQ(TestDrain(shell, -groups[1], WNOHANG), counts[1]);
+    HIAH_CHECK_EQ(TestDrain(shell, -1, 0), 0);
+    TestShellDestroy(shell);
+    free(shell);
+}
+
+static void TestConcurrentWaiters(void) {
+    TestShell *shell = calloc(1, sizeof(TestShell));
+    TestShellInit(shell, 0xc2b2ae35u);
+
+    // Waits by PID race waitpid(-1): each child still goes to exactly one
+    for (int i = 0; i < 200; i++) {
+        TestSpawn(shell, i % 2 == 0, -1, 1 + TestRandom(&shell->seed) % 2000);
+    }
+    int collected = 0;
+    for (int i = shell->count - 1; i >= 0; i -= 3) {
+        TestChild *child = &shell->children[i];
+        int status;
+        pid_t pid = TestWaitpid(shell, child->pid, &status, 0);
+        if (pid > 0) {
+            HIAH_CHECK_EQ(pid, child->pid);
+            TestCollected(shell, pid, status);
+            collected++;
+        }
+    }
+    collected += TestDrain(shell, -1, 0);
+    HIAH_CHECK_EQ(collected, 200);
+    TestShellDestroy(shell);
+    free(shell);
+}
+
+static void TestEarlyExit(void) {
+    TestShell *shell = calloc(1, sizeof(TestShell));
+    TestShellInit(shell, 0x27d4eb2fu);
+
+    // Keeps the watcher waiting on the kernel
+    TestChild *first = TestSpawn(shell, true, -1, 0);
+
+    // The kernel reports this one before its spawn returns
+    HIAHChildWatcherWillSpawn(shell->watcher);
+    TestChild *child = &shell->children[shell->count++];
+    child->external = true;
+    child->code = 42;
+    child->registry = shell->kernel.registry;
+    child->pid = HIAHChildRegistryAdd(shell->kernel.registry, TestKernelParent(), 0, 0);
+    atomic_init(&child->release, true);
+    atomic_init(&child->exited, false);
+    HIAH_CHECK(pthread_create(&child->runner, NULL, TestChildRun, child) == 0);
+    HIAHChildWatcherStats stats;
+    do {
+        usleep(100);
+        HIAHChildWatcherGetStats(shell->watcher, &stats);
+    } while (stats.exits == 0);
+    HIAH_CHECK_EQ(HIAHChildWatcherDidSpawn(shell->watcher, shell->pid, -1, child->pid), child->pid);
+    child->group = shell->pid;
+
+    int status;
+    HIAH_CHECK_EQ(TestWaitpid(shell, -1, &status, WNOHANG), child->pid);
+    TestCollected(shell, child->pid, status);
+    HIAH_CHECK_EQ(TestWaitpid(shell, -1, &status, WNOHANG), 0);
+
+    atomic_store(&first->release, true);
+    HIAH_CHECK_EQ(TestDrain(shell, -1, 0), 1);
+    HIAHChildWatcherGetStats(shell->watcher, &stats);
+    HIAH_CHECK_EQ(stats.spawns, 2);
+    HIAH_CHECK_EQ(stats.exits, 2);
+    HIAH_CHECK_EQ(stats.early, 1);
+    TestShellDestroy(shell);
+    free(shell);
+}
+
+static void TestKernelUnavailable(void) {
+    TestShell *shell = calloc(1, sizeof(TestShell));
+    TestShellInit(shell, 0x165667b1u);
+    atomic_store(&shell->kernel.unavailable, true);
+
+    // Untracked again, a forwarded child is only found by naming it
+    TestChild *external = TestSpawn(shell, true, -1, 0);
+    TestChild *local = TestSpawn(shell, false, -1, 1000);
+    HIAHChildWatcherStats stats;
+    do {
+        usleep(100);
+        HIAHChildWatcherGetStats(shell->watcher, &stats);
+    } while (stats.failures == 0);
+    HIAHChildWatcherDestroy(shell->watcher);
+
+    HIAH_CHECK_EQ(TestDrain(shell, -1, 0), 1);
+    HIAH_CHECK_EQ(local->collected, 1);
+    HIAH_CHECK(!HIAHChildRegistryHasChildren(shell->registry, shell->pid, -1));
+    HIAH_CHECK(HIAHChildRegistryHasChildren(shell->registry, shell->pid, external->pid));
+
+    atomic_store(&shell->kernel.unavailable, false);
+    atomic_store(&external->release, true);
+    int status;
+    HIAH_CHECK_EQ(TestWaitpid(shell, external->pid, &status, 0), external->pid);
+    TestCollected(shell, external->pid, status);
+
+    shell->watcher = HIAHChildWatcherCreate(shell->registry, TestKernelWait, &shell->kernel);
+    TestShellDestroy(shell);
+    free(shell);
+}
+
+static void TestParentExit(void) {
+    HIAHChildRegistry *registry = HIAHChildRegistryCreate(TEST_GUEST_PID, NULL, NULL);
+    HIAHChildRegistryTrackExternal(registry, true);
+
+    // A guest's forwarded child outlives it: orphaned while tracked, then
+    // dropped when it exits or once nothing tracks it
+    pid_t guest = HIAHChildRegistryAdd(registry, 1, -1, 0);
+    HIAH_CHECK(HIAHChildRegistryAdd(registry, guest, -1, 5000) == 5000);
+    HIAH_CHECK(HIAHChildRegistryAdd(registry, guest, -1, 5001) == 5001);
+    HIAH_CHECK(HIAHChildRegistryExit(registry, guest, 0));
+    HIAHChildInfo info;
+    HIAH_CHECK(HIAHChildRegistryLookup(registry, 5000, &info));
+    HIAH_CHECK_EQ(info.parent, 0);
+    HIAH_CHECK(HIAHChildRegistryExit(registry, 5000, 0));
+    HIAH_CHECK(!HIAHChildRegistryLookup(registry, 5000, NULL));
+    HIAHChildRegistryTrackExternal(registry, false);
+    HIAH_CHECK(!HIAHChildRegistryLookup(registry, 5001, NULL));
+
+    // The kernel forgets the children of a process that exits
+    HIAHChildRegistryTrackExternal(registry, true);
+    HIAH_CHECK(HIAHChildRegistryAdd(registry, 77, -1, 6000) == 6000);
+    HIAH_CHECK(HIAHChildRegistryAdd(registry, 77, -1, 6001) == 6001);
+    HIAH_CHECK(HIAHChildRegistryExit(registry, 6001, 0));
+    HIAH_CHECK(HIAHChildRegistryAdd(registry, 78, -1, 6002) == 6002);
+    HIAHChildRegistryForget(registry, 77);
+    errno = 0;
+    HIAH_CHECK_EQ(HIAHChildRegistryWait(registry, 77, -1, NULL, 0), -1);
+    HIAH_CHECK_EQ(errno, ECHILD);
+    HIAH_CHECK(HIAHChildRegistryLookup(registry, 6002, NULL));
+
+    HIAHChildRegistryRemove(registry, 6002);
+    HIAHChildRegistryRemove(registry, guest);
+
+    // The kernel's PIDs may equal a host PID: a forwarded child under the
+    // PID of its own parent is neither the parent's group nor its parent
+    pid_t host = 7000;
+    pid_t sibling = HIAHChildRegistryAdd(registry, host, -1, 0);
+    HIAH_CHECK(HIAHChildRegistryAdd(registry, host, -1, host) == host);
+    pid_t later = HIAHChildRegistryAdd(registry, host, -1, 0);
+    HIAH_CHECK_EQ(HIAHChildRegistryGroup(registry, sibling), host);
+    HIAH_CHECK_EQ(HIAHChildRegistryGroup(registry, later), host);
+    HIAH_CHECK(HIAHChildRegistryExit(registry, host, W_EXITCODE(3, 0)));
+    HIAH_CHECK(HIAHChildRegistryLookup(registry, sibling, &info));
+    HIAH_CHECK_EQ(info.parent, host);
+    int status = 0;
+    HIAH_CHECK_EQ(HIAHChildRegistryWait(registry, host, 0, &status, WNOHANG), host);
+    HIAH_CHECK_EQ(WEXITSTATUS(status), 3);
+    HIAH_CHECK(HIAHChildRegistryExit(registry, sibling, 0));
+    HIAH_CHECK(HIAHChildRegistryExit(registry, later, 0));
+    HIAH_CHECK_EQ(HIAHChildRegistryWait(registry, host, 0, NULL, 0), sibling);
+    HIAH_CHECK_EQ(HIAHChildRegistryWait(registry, host, -1, NULL, 0), later);
+    HIAHChildRegistryStats stats;
+    HIAHChildRegistryGetStats(registry, &stats);
+    HIAH_CHECK_EQ(stats.running + stats.zombies, 0);
+    HIAHChildRegistryDestroy(registry);
+}
+
+int main(void) {
+    printf("HIAHChildRegistry + HIAHChildWatcher\n");
+    HIAH_RUN_TEST(TestAnyChild);
+    HIAH_RUN_TEST(TestGroups);
+    HIAH_RUN_TEST(TestConcurrentWaiters);
+    HIAH_RUN_TEST(TestEarlyExit);
+    HIAH_RUN_TEST(TestKernelUnavailable);
+    HIAH_RUN_TEST(TestParentExit);
+    return 0;
+}
@@ -0,0 +1,344 @@
+/**
+ * HIAHControlServerTests.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Host tests and load test for the control socket reactor.
+ *
+ * The handler either echoes each request straight from the reactor thread
+ * or defers it, so another thread answers later and out of order, the way
+ * the kernel answers a spawn from a global queue. The load test keeps
+ * hundreds of connections open at once, with requests pipelined and split
+ * across writes, and checks every reply arrives exactly once and in order.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHControlServer.h"
+#include "HIAHHostTest.h"
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_MAX_DEFERRED 64
+
+typedef struct {
+    HIAHControlRequest request;
+    char message[64];
+    size_t length;
+} TestDeferred;
+
+static pthread_mutex_t gDeferredLock = PTHREAD_MUTEX_INITIALIZER;
+static TestDeferred gDeferred[TEST_MAX_DEFERRED];
+static size_t gDeferredCount;
+static bool gDefer;
+
+static void TestHandler(HIAHControlServer *server, HIAHControlRequest request,
+                        const uint8_t *message, size_t length, void *context) {
+    (void)context;
+    pthread_mutex_lock(&gDeferredLock);
+    if (gDefer) {
+        HIAH_CHECK(gDeferredCount < TEST_MAX_DEFERRED && length < sizeof(gDeferred[0].message));
+        TestDeferred *deferred = &gDeferred[gDeferredCount++];
+        deferred->request = request;
+        memcpy(deferred->message, message, length);
+        deferred->length = length;
+        pthread_mutex_unlock(&gDeferredLock);
+        return;
+    }
+    pthread_mutex_unlock(&gDeferredLock);
+    HIAH_CHECK(HIAHControlServerReply(server, request, message, length));
+}
+
+static void TestSleepMs(long ms) {
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000L};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+static void TestSetDefer(bool defer) {
+    pthread_mutex_lock(&gDeferredLock);
+    gDefer = defer;
+    gDeferredCount = 0;
+    pthread_mutex_unlock(&gDeferredLock);
+}
+
+static void TestWaitForDeferred(size_t count) {
+    for (int i = 0; i < 500; i++) {
+        pthread_mutex_lock(&gDeferredLock);
+        size_t deferred = gDeferredCount;
+        pthread_mutex_unlock(&gDeferredLock);
+        if (deferred == count) {
+            return;
+        }
+        TestSleepMs(10);
+    }
+    HIAH_CHECK_EQ(gDeferredCount, count);
+}
+
+static HIAHControlServer *TestStartServer(const char *path) {
+    HIAHControlServerConfig config = {0};
+    int error = 0;
+    HIAHControlServer *server = HIAHControlServerCreate(path, &config, TestHandler, NULL, &error);
+    HIAH_CHECK(server != NULL);
+    HIAH_CHECK(HIAHControlServerStart(server));
+    return server;
+}
+
+static int TestConnect(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    HIAH_CHECK(fd >= 0);
+    HIAH_CHECK(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    return fd;
+}
+
+static void TestWriteAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = send(fd, data, length, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        HIAH_CHECK(n > 0);
+        data += n;
+        length -= (size_t)n;
+    }
+}
+
+static size_t TestReadExactly(int fd, char *buffer, size_t length) {
+    size_t done = 0;
+    while (done < length) {
+        ssize_t n = recv(fd, buffer + done, length - done, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += (size_t)n;
+    }
+    return done;
+}
+
+static double TestCPUSeconds(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (double)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) +
+           (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static void TestWaitForActive(HIAHControlServer *server, uint64_t active) {
+    HIAHControlServerStats stats;
+    for (int i = 0; i < 500; i++) {
+        HIAHControlServerGetStats(server, &stats);
+        if (stats.active == active) {
+            return;
+        }
+        TestSleepMs(10);
+    }
+    HIAH_CHECK_EQ(stats.active, active);
+}
+
+static void TestTempPath(char *path, size_t size, const char *name) {
+    const char *dir = getenv("TMPDIR");
+    snprintf(path, size, "%s/%s.%d.s", dir ? dir : "/tmp", name, (int)getpid());
+}
+
+// MARK: - Tests
+
+static void TestSplitAndPipelined(void) {
+    char path[108];
+    TestTempPath(path, sizeof(path), "hiah-split");
+    HIAHControlServer *server = TestStartServer(path);
+
+    int fd = TestConnect(path);
+    const char *first = "{\"command\":\"list\"}";
+    for (const char *p = first; *p; p++) {
+        TestWriteAll(fd, p, 1);
+    }
+    TestWriteAll(fd, "\r\n\n{\"a\":1}\n{\"b\":2}\n", 19);
+
+    const char *expected = "{\"command\":\"list\"}\n{\"a\":1}\n{\"b\":2}\n";
+    char reply[64] = {0};
+    HIAH_CHECK_EQ(TestReadExactly(fd, reply, strlen(expected)), strlen(expected));
+    HIAH_CHECK(memcmp(reply, expected, strlen(expected)) == 0);
+
+    close(fd);
+    TestWaitForActive(server, 0);
+    HIAHControlServerDestroy(server);
+}
+
+static void TestRepliesKeepRequestOrder(void) {
+    char path[108];
+    TestTempPath(path, sizeof(path), "hiah-order");
+    HIAHControlServer *server = TestStartServer(path);
+    TestSetDefer(true);
+
+    int fd = TestConnect(path);
+    TestWriteAll(fd, "r0\nr1\nr2\nr3\n", 12);
+    TestWaitForDeferred(4);
+
+    // Answer newest first; the server must still send them in request order
+    for (int i = 3; i >= 0; i--) {
+        HIAH_CHECK(HIAHControlServerReply(server, gDeferred[i].request, gDeferred[i].message,
+                                          gDeferred[i].length));
+    }
+    char reply[12];
+    HIAH_CHECK_EQ(TestReadExactly(fd, reply, sizeof(reply)), sizeof(reply));
+    HIAH_CHECK(memcmp(reply, "r0\nr1\nr2\nr3\n", sizeof(reply)) == 0);
+
+    TestSetDefer(false);
+    close(fd);
+    TestWaitForActive(server, 0);
+    HIAHControlServerDestroy(server);
+}
+
+static void TestClosedPeerWithPendingReplies(void) {
+    char path[108];
+    TestTempPath(path, sizeof(path), "hiah-hup");
+    HIAHControlServer *server = TestStartServer(path);
+    TestSetDefer(true);
+
+    int fd = TestConnect(path);
+    TestWriteAll(fd, "w1\nw2\n", 6);
+    TestWaitForDeferred(2);
+    close(fd);
+    TestWaitForActive(server, 1);
+
+    // Parked replies must not keep the reactor busy while the peer is gone
+    double start = TestCPUSeconds();
+    TestSleepMs(300);
+    double used = TestCPUSeconds() - start;
+    HIAH_CHECK(used < 0.1);
+
+    // Once answered, the connection goes away
+    HIAHControlServerReply(server, gDeferred[1].request, gDeferred[1].message, gDeferred[1].length);
+    HIAHControlServerReply(server, gDeferred[0].request, gDeferred[0].message, gDeferred[0].length);
+    TestWaitForActive(server, 0);
+
+    TestSetDefer(false);
+    HIAHControlServerDestroy(server);
+}
+
+// MARK: - Load
+
+#define TEST_LOAD_THREADS 4
+#define TEST_LOAD_CONNECTIONS_PER_THREAD 100
+#define TEST_LOAD_REQUESTS 20
+
+typedef struct {
+    const char *path;
+    int index;
+    long replies;
+} TestLoadClient;
+
+static void *TestLoadThread(void *data) {
+    TestLoadClient *client = data;
+    int fds[TEST_LOAD_CONNECTIONS_PER_THREAD];
+    char expected[TEST_LOAD_CONNECTIONS_PER_THREAD][TEST_LOAD_REQUESTS * 32];
+    size_t expectedLength[TEST_LOAD_CONNECTIONS_PER_THREAD];
+    size_t received[TEST_LOAD_CONNECTIONS_PER_THREAD];
+
+    // Every connection is open before any request is sent
+    for (int c = 0; c < TEST_LOAD_CONNECTIONS_PER_THREAD; c++) {
+        fds[c] = TestConnect(client->path);
+        expectedLength[c] = 0;
+        received[c] = 0;
+        for (int r = 0; r < TEST_LOAD_REQUESTS; r++) {
+            expectedLength[c] += (size_t)snprintf(expected[c] + expectedLength[c],
+                                                  sizeof(expected[c]) - expectedLength[c],
+                                                  "{\"c\":%d,\"n\":%d,\"r\":%d}\n", client->index, c, r);
+        }
+    }
+    // Send everything in two uneven halves so requests straddle writes
+    for (int c = 0; c < TEST_LOAD_CONNECTIONS_PER_THREAD; c++) {
+        TestWriteAll(fds[c], expected[c], expectedLength[c] / 3);
+    }
+    for (int c = 0; c < TEST_LOAD_CONNECTIONS_PER_THREAD; c++) {
+        TestWriteAll(fds[c], expected[c] + expectedLength[c] / 3, expectedLength[c] - expectedLength[c] / 3);
+    }
+
+    int remaining = TEST_LOAD_CONNECTIONS_PER_THREAD;
+    struct pollfd polls[TEST_LOAD_CONNECTIONS_PER_THREAD];
+    while (remaining > 0) {
+        for (int c = 0; c < TEST_LOAD_CONNECTIONS_PER_THREAD; c++) {
+            polls[c].fd = received[c] < expectedLength[c] ? fds[c] : -1;
+            polls[c].events = POLLIN;
+        }
+        int ready = poll(polls, TEST_LOAD_CONNECTIONS_PER_THREAD, 10000);
+        HIAH_CHECK(ready > 0);
+        for (int c = 0; c < TEST_LOAD_CONNECTIONS_PER_THREAD; c++) {
+            if (polls[c].fd < 0 || !(polls[c].revents & POLLIN)) {
+                continue;
+            }
+            char buffer[4096];
+            ssize_t n = recv(fds[c], buffer, sizeof(buffer), 0);
+            HIAH_CHECK(n > 0 && received[c] + (size_t)n <= expectedLength[c]);
+            HIAH_CHECK(memcmp(buffer, expected[c] + received[c], (size_t)n) == 0);
+            received[c] += (size_t)n;
+            if (received[c] == expectedLength[c]) {
+                client->replies += TEST_LOAD_REQUESTS;
+                close(fds[c]);
+                remaining--;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void TestManyConcurrentClients(void) {
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    rlim_t needed = 2 * TEST_LOAD_THREADS * TEST_LOAD_CONNECTIONS_PER_THREAD + 64;
+    if (limit.rlim_cur < needed && limit.rlim_max >= needed) {
+        limit.rlim_cur = needed;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    char path[108];
+    TestTempPath(path, sizeof(path), "hiah-load");
+    HIAHControlServer *server = TestStartServer(path);
+
+    pthread_t threads[TEST_LOAD_THREADS];
+    TestLoadClient clients[TEST_LOAD_THREADS];
+    for (int t = 0; t < TEST_LOAD_THREADS; t++) {
+        clients[t] = (TestLoadClient){path, t, 0};
+        HIAH_CHECK(pthread_create(&threads[t], NULL, TestLoadThread, &clients[t]) == 0);
+    }
+    long replies = 0;
+    for (int t = 0; t < TEST_LOAD_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        replies += clients[t].replies;
+    }
+    HIAH_CHECK_EQ(replies, TEST_LOAD_THREADS * TEST_LOAD_CONNECTIONS_PER_THREAD * TEST_LOAD_REQUESTS);
+
+    TestWaitForActive(server, 0);
+    HIAHControlServerStats stats;
+    HIAHControlServerGetStats(server, &stats);
+    HIAH_CHECK_EQ(stats.accepted, TEST_LOAD_THREADS * TEST_LOAD_CONNECTIONS_PER_THREAD);
+    HIAH_CHECK_EQ(stats.messages, replies);
+    HIAH_CHECK_EQ(stats.replies, replies);
+    HIAH_CHECK_EQ(stats.protocolErrors, 0);
+    HIAHControlServerDestroy(server);
+}
+
+int main(void) {
+    printf("HIAHControlServer\n");
+    HIAH_RUN_TEST(TestSplitAndPipelined);
+    HIAH_RUN_TEST(TestRepliesKeepRequestOrder);
+    HIAH_RUN_TEST(TestClosedPeerWithPendingReplies);
+    HIAH_RUN_TEST(TestManyConcurrentClients);
+    return 0;
+}
@@ -0,0 +1,299 @@
+/**
+ * HIAHExportTrieTests.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Host tests and fuzzer for the export trie walker.
+ *
+ * Tries are built with HIAHExportTrieWriter.h from random symbol sets with
+ * every kind of terminal (regular, weak, thread-local, absolute, re-export,
+ * stub and resolver) and looked up name by name. Hand-written tries cover
+ * each malformation the walker must reject. The fuzzer then mutates valid
+ * tries (bit flips, byte stores, truncation, overlong ULEBs) and feeds in
+ * random bytes, looking names up in a heap copy of exactly the trie's size
+ * so that a sanitizer build catches any read past the end.
+ * HIAH_FUZZ_ITERATIONS sets the number of mutated tries (default 20000).
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHHostTest.h"
+#include "HIAHExportTrie.h"
+#include "HIAHExportTrieWriter.h"
+#include <string.h>
+
+typedef struct {
+    char name[48];
+    HIAHExport info;
+    char importName[24];
+} TestSymbol;
+
+static uint32_t gSeed = 0x2545f491u;
+
+static uint32_t TestRandom(void) {
+    gSeed ^= gSeed << 13;
+    gSeed ^= gSeed >> 17;
+    gSeed ^= gSeed << 5;
+    return gSeed;
+}
+
+/**
+ * Names are built from a few shared prefixes, so the trie gets deep edges,
+ * split edges and names that are prefixes of other names.
+ */
+static void TestRandomName(char *name, size_t size) {
+    static const char *const prefixes[] = {"_", "_posix_spawn", "_pthread_", "_objc_", "__Z", "_os_"};
+    static const char alphabet[] = "abcdefghijklmnopqrstuvwxyz0123456789_";
+    int length = snprintf(name, size, "%s", prefixes[TestRandom() % 6]);
+    int extra = 1 + (int)(TestRandom() % 12);
+    for (int i = 0; i < extra && (size_t)length + 1 < size; i++) {
+        name[length++] = alphabet[TestRandom() % (sizeof(alphabet) - 1)];
+    }
+    name[length] = '\0';
+}
+
+static void TestRandomInfo(TestSymbol *symbol) {
+    HIAHExport *info = &symbol->info;
+    memset(info, 0, sizeof(*info));
+    switch (TestRandom() % 6) {
+    case 0: info->flags = HIAH_EXPORT_KIND_REGULAR; break;
+    case 1: info->flags = HIAH_EXPORT_KIND_REGULAR | HIAH_EXPORT_WEAK_DEFINITION; break;
+    case 2: info->flags = HIAH_EXPORT_KIND_THREAD_LOCAL; break;
+    case 3: info->flags = HIAH_EXPORT_KIND_ABSOLUTE; break;
+    case 4: info->flags = HIAH_EXPORT_STUB_AND_RESOLVER; break;
+    default: info->flags = HIAH_EXPORT_REEXPORT; break;
+    }
+    if (info->flags & HIAH_EXPORT_REEXPORT) {
+        info->ordinal = 1 + TestRandom() % 300;
+        if (TestRandom() % 2) {
+            TestRandomName(symbol->importName, sizeof(symbol->importName));
+        } else {
+            symbol->importName[0] = '\0';
+        }
+        info->importName = symbol->importName;
+    } else {
+        // Mix one-byte and multi-byte ULEBs
+        info->address = TestRandom() % 2 ? TestRandom() % 100 : ((uint64_t)TestRandom() << 20 | TestRandom());
+        if (info->flags & HIAH_EXPORT_STUB_AND_RESOLVER) {
+            info->resolver = TestRandom();
+        }
+    }
+}
+
+/**
+ * Builds a trie of up to `count` random symbols; returns how many distinct
+ * ones went in.
+ */
+static size_t TestBuildTrie(TestSymbol *symbols, size_t count, uint8_t **trie, size_t *size) {
+    HIAHTrieNode *root = HIAHTrieWriterCreate();
+    size_t added = 0;
+    for (size_t i = 0; i < count; i++) {
+        TestSymbol *symbol = &symbols[added];
+        TestRandomName(symbol->name, sizeof(symbol->name));
+        TestRandomInfo(symbol);
+        if (HIAHTrieWriterAdd(root, symbol->name, &symbol->info)) {
+            added++;
+        }
+    }
+    *trie = HIAHTrieWriterEncode(root, size);
+    HIAHTrieWriterDestroy(root);
+    return added;
+}
+
+static bool TestIsSymbol(const TestSymbol *symbols, size_t count, const char *name) {
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(symbols[i].name, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// MARK: - Tests
+
+static void TestRoundTrip(void) {
+    enum { kSymbols = 3000 };
+    TestSymbol *symbols = calloc(kSymbols, sizeof(TestSymbol));
+    uint8_t *trie;
+    size_t size;
+    size_t count = TestBuildTrie(symbols, kSymbols, &trie, &size);
+    HIAH_CHECK(count > kSymbols / 2);
+
+    for (size_t i = 0; i < count; i++) {
+        HIAHExport found;
+        HIAH_CHECK(HIAHExportTrieFind(trie, size, symbols[i].name, &found));
+        HIAH_CHECK_EQ(found.flags, symbols[i].info.flags);
+        if (found.flags & HIAH_EXPORT_REEXPORT) {
+            HIAH_CHECK_EQ(found.ordinal, symbols[i].info.ordinal);
+            HIAH_CHECK(strcmp(found.importName, symbols[i].importName) == 0);
+        } else {
+            HIAH_CHECK_EQ(found.address, symbols[i].info.address);
+            HIAH_CHECK_EQ(found.resolver, symbols[i].info.resolver);
+            HIAH_CHECK(found.importName == NULL);
+        }
+    }
+    free(trie);
+    free(symbols);
+}
+
+static void TestMisses(void) {
+    enum { kSymbols = 500 };
+    TestSymbol *symbols = calloc(kSymbols, sizeof(TestSymbol));
+    uint8_t *trie;
+    size_t size;
+    size_t count = TestBuildTrie(symbols, kSymbols, &trie, &size);
+
+    HIAHExport found;
+    HIAH_CHECK(!HIAHExportTrieFind(trie, size, "", &found));
+    HIAH_CHECK(!HIAHExportTrieFind(trie, size, "_definitely_not_there", &found));
+    for (size_t i = 0; i < count; i++) {
+        char name[64];
+        // Every proper prefix that is not a symbol itself, and an extension
+        size_t length = strlen(symbols[i].name);
+        for (size_t cut = 1; cut < length; cut++) {
+            memcpy(name, symbols[i].name, cut);
+            name[cut] = '\0';
+            if (!TestIsSymbol(symbols, count, name)) {
+                HIAH_CHECK(!HIAHExportTrieFind(trie, size, name, &found));
+            }
+        }
+        snprintf(name, sizeof(name), "%s$", symbols[i].name);
+        HIAH_CHECK(!HIAHExportTrieFind(trie, size, name, &found));
+    }
+
+    HIAH_CHECK(!HIAHExportTrieFind(NULL, size, symbols[0].name, &found));
+    HIAH_CHECK(!HIAHExportTrieFind(trie, 0, symbols[0].name, &found));
+    HIAH_CHECK(!HIAHExportTrieFind(trie, size, NULL, &found));
+    HIAH_CHECK(!HIAHExportTrieFind(trie, size, symbols[0].name, NULL));
+    free(trie);
+    free(symbols);
+}
+
+static bool TestFindIn(const uint8_t *bytes, size_t size, const char *symbol) {
+    // Exactly sized, so reading past the end is a heap overflow
+    uint8_t *copy = malloc(size ? size : 1);
+    memcpy(copy, bytes, size);
+    HIAHExport found;
+    bool result = HIAHExportTrieFind(copy, size, symbol, &found);
+    free(copy);
+    return result;
+}
+
+static void TestMalformed(void) {
+    // Root with one edge "_a" to a terminal node at 6: address 0x10
+    static const uint8_t valid[] = {0x00, 0x01, '_', 'a', 0x00, 0x06, 0x02, 0x00, 0x10, 0x00};
+    HIAH_CHECK(TestFindIn(valid, sizeof(valid), "_a"));
+    HIAH_CHECK(!TestFindIn(valid, sizeof(valid), "_b"));
+
+    // The child points at its parent, and before its parent
+    static const uint8_t cycle[] = {0x00, 0x01, '_', 'a', 0x00, 0x00};
+    HIAH_CHECK(!TestFindIn(cycle, sizeof(cycle), "_a_a_a"));
+    static const uint8_t backwards[] = {0x00, 0x01, '_', 0x00, 0x05, 0x00, 0x01, 'a', 0x00, 0x03};
+    HIAH_CHECK(!TestFindIn(backwards, sizeof(backwards), "_aa"));
+
+    // Child offset past the end
+    static const uint8_t outside[] = {0x00, 0x01, '_', 'a', 0x00, 0x40};
+    HIAH_CHECK(!TestFindIn(outside, sizeof(outside), "_a"));
+
+    // Terminal size larger than the rest of the trie
+    static const uint8_t terminal[] = {0x00, 0x01, '_', 'a', 0x00, 0x06, 0x7f, 0x00, 0x10, 0x00};
+    HIAH_CHECK(!TestFindIn(terminal, sizeof(terminal), "_a"));
+
+    // Terminal info cut short inside its own size
+    static const uint8_t shortInfo[] = {0x00, 0x01, '_', 'a', 0x00, 0x06, 0x01, 0x00, 0x00};
+    HIAH_CHECK(!TestFindIn(shortInfo, sizeof(shortInfo), "_a"));
+
+    // Re-export name without its NUL
+    static const uint8_t importName[] = {0x00, 0x01, '_', 'a', 0x00, 0x06, 0x04, 0x08, 0x01, 'x', 'y', 0x00};
+    HIAH_CHECK(!TestFindIn(importName, sizeof(importName), "_a"));
+
+    // Edge label runs off the end
+    static const uint8_t edge[] = {0x00, 0x01, '_', 'a', 'b'};
+    HIAH_CHECK(!TestFindIn(edge, sizeof(edge), "_ab"));
+
+    // ULEBs that never end or overflow 64 bits
+    static const uint8_t endless[] = {0x80, 0x80, 0x80};
+    HIAH_CHECK(!TestFindIn(endless, sizeof(endless), "_a"));
+    static const uint8_t overflow[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x7f, 0x00};
+    HIAH_CHECK(!TestFindIn(overflow, sizeof(overflow), "_a"));
+
+    // Child count promising more children than there are bytes
+    static const uint8_t children[] = {0x00, 0xff, '_', 'a', 0x00, 0x06};
+    HIAH_CHECK(!TestFindIn(children, sizeof(children), "_b"));
+}
+
+// MARK: - Fuzzing
+
+static void TestFuzzOne(const uint8_t *bytes, size_t size, const TestSymbol *symbols, size_t count) {
+    uint8_t *copy = malloc(size ? size : 1);
+    memcpy(copy, bytes, size);
+    for (int probe = 0; probe < 8; probe++) {
+        char absent[48];
+        const char *name = symbols[TestRandom() % count].name;
+        if (probe == 7) {
+            TestRandomName(absent, sizeof(absent));
+            name = absent;
+        }
+        HIAHExport found;
+        if (HIAHExportTrieFind(copy, size, name, &found) && (found.flags & HIAH_EXPORT_REEXPORT)) {
+            // A re-export name must lie inside the trie, NUL included
+            HIAH_CHECK((const uint8_t *)found.importName >= copy);
+            HIAH_CHECK((const uint8_t *)found.importName < copy + size);
+            HIAH_CHECK(memchr(found.importName, '\0', (size_t)(copy + size - (const uint8_t *)found.importName)));
+        }
+    }
+    free(copy);
+}
+
+static void TestFuzzMutations(void) {
+    enum { kSymbols = 200 };
+    const char *setting = getenv("HIAH_FUZZ_ITERATIONS");
+    long iterations = setting ? strtol(setting, NULL, 10) : 20000;
+
+    TestSymbol *symbols = calloc(kSymbols, sizeof(TestSymbol));
+    uint8_t *trie;
+    size_t size;
+    size_t count = TestBuildTrie(symbols, kSymbols, &trie, &size);
+    uint8_t *mutated = malloc(size + 16);
+
+    for (long i = 0; i < iterations; i++) {
+        memcpy(mutated, trie, size);
+        size_t mutatedSize = size;
+        int mutations = 1 + (int)(TestRandom() % 4);
+        for (int m = 0; m < mutations; m++) {
+            size_t at = TestRandom() % mutatedSize;
+            switch (TestRandom() % 5) {
+            case 0: mutated[at] ^= (uint8_t)(1u << (TestRandom() % 8)); break;
+            case 1: mutated[at] = (uint8_t)TestRandom(); break;
+            case 2: mutated[at] = 0xff; break;                               // Continuation
+            case 3: mutated[at] = 0x00; break;                               // Early NUL
+            default: mutatedSize = 1 + TestRandom() % mutatedSize; break;    // Truncate
+            }
+        }
+        TestFuzzOne(mutated, mutatedSize, symbols, count);
+    }
+
+    // Plain noise
+    for (long i = 0; i < iterations / 10; i++) {
+        size_t noiseSize = 1 + TestRandom() % 64;
+        for (size_t j = 0; j < noiseSize; j++) {
+            mutated[j] = (uint8_t)TestRandom();
+        }
+        TestFuzzOne(mutated, noiseSize, symbols, count);
+    }
+
+    free(mutated);
+    free(trie);
+    free(symbols);
+}
+
+int main(void) {
+    printf("HIAHExportTrie\n");
+    HIAH_RUN_TEST(TestRoundTrip);
+    HIAH_RUN_TEST(TestMisses);
+    HIAH_RUN_TEST(TestMalformed);
+    HIAH_RUN_TEST(TestFuzzMutations);
+    return 0;
+}
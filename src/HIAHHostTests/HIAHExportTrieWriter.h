@@ -0,0 +1,230 @@
+/**
+ * HIAHExportTrieWriter.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Export trie writer for tests and benchmarks.
+ *
+ * Builds tries the way ld64 lays them out: a radix tree over the mangled
+ * names, encoded in preorder so every child follows its parent, with node
+ * offsets recomputed until their ULEB128 sizes settle. HIAHExportTrieFind()
+ * must find every name added with exactly the terminal info it was given.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_EXPORT_TRIE_WRITER_H
+#define HIAH_EXPORT_TRIE_WRITER_H
+
+#include "HIAHExportTrie.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct HIAHTrieNode HIAHTrieNode;
+
+struct HIAHTrieNode {
+    bool terminal;
+    HIAHExport info;           // importName is owned
+    size_t childCount;
+    char **edges;              // Owned
+    HIAHTrieNode **children;
+    uint64_t offset;
+};
+
+static inline HIAHTrieNode *HIAHTrieWriterCreate(void) {
+    return calloc(1, sizeof(HIAHTrieNode));
+}
+
+static inline void HIAHTrieWriterDestroy(HIAHTrieNode *node) {
+    if (!node) {
+        return;
+    }
+    for (size_t i = 0; i < node->childCount; i++) {
+        free(node->edges[i]);
+        HIAHTrieWriterDestroy(node->children[i]);
+    }
+    free(node->edges);
+    free(node->children);
+    free((char *)node->info.importName);
+    free(node);
+}
+
+static inline char *HIAHTrieWriterCopy(const char *string, size_t length) {
+    char *copy = malloc(length + 1);
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+static inline void HIAHTrieWriterAppendChild(HIAHTrieNode *node, char *edge, HIAHTrieNode *child) {
+    node->edges = realloc(node->edges, (node->childCount + 1) * sizeof(char *));
+    node->children = realloc(node->children, (node->childCount + 1) * sizeof(HIAHTrieNode *));
+    node->edges[node->childCount] = edge;
+    node->children[node->childCount] = child;
+    node->childCount++;
+}
+
+/**
+ * Adds `name` (mangled, non-empty). Returns false if it is already there.
+ */
+static inline bool HIAHTrieWriterAdd(HIAHTrieNode *node, const char *name, const HIAHExport *info) {
+    while (*name) {
+        HIAHTrieNode *next = NULL;
+        for (size_t i = 0; i < node->childCount && !next; i++) {
+            char *edge = node->edges[i];
+            if (edge[0] != name[0]) {
+                continue;
+            }
+            size_t shared = 0;
+            while (edge[shared] && edge[shared] == name[shared]) {
+                shared++;
+            }
+            if (edge[shared] != '\0') {
+                // Split the edge where the names diverge
+                HIAHTrieNode *middle = HIAHTrieWriterCreate();
+                HIAHTrieWriterAppendChild(middle, HIAHTrieWriterCopy(edge + shared, strlen(edge + shared)),
+                                          node->children[i]);
+                node->edges[i] = HIAHTrieWriterCopy(edge, shared);
+                node->children[i] = middle;
+                free(edge);
+            }
+            next = node->children[i];
+            name += shared;
+        }
+        if (!next) {
+            next = HIAHTrieWriterCreate();
+            HIAHTrieWriterAppendChild(node, HIAHTrieWriterCopy(name, strlen(name)), next);
+            name += strlen(name);
+        }
+        node = next;
+    }
+    if (node->terminal) {
+        return false;
+    }
+    node->terminal = true;
+    node->info = *info;
+    if (info->importName) {
+        node->info.importName = HIAHTrieWriterCopy(info->importName, strlen(info->importName));
+    }
+    return true;
+}
+
+// MARK: - Encoding
+
+static inline size_t HIAHTrieWriterULEBSize(uint64_t value) {
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        size++;
+    }
+    return size;
+}
+
+static inline uint8_t *HIAHTrieWriterPutULEB(uint8_t *out, uint64_t value) {
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        *out++ = byte | (value ? 0x80 : 0);
+    } while (value);
+    return out;
+}
+
+static inline size_t HIAHTrieWriterTerminalSize(const HIAHTrieNode *node) {
+    if (!node->terminal) {
+        return 0;
+    }
+    const HIAHExport *info = &node->info;
+    size_t size = HIAHTrieWriterULEBSize(info->flags);
+    if (info->flags & HIAH_EXPORT_REEXPORT) {
+        return size + HIAHTrieWriterULEBSize(info->ordinal) +
+               strlen(info->importName ? info->importName : "") + 1;
+    }
+    size += HIAHTrieWriterULEBSize(info->address);
+    if (info->flags & HIAH_EXPORT_STUB_AND_RESOLVER) {
+        size += HIAHTrieWriterULEBSize(info->resolver);
+    }
+    return size;
+}
+
+static inline size_t HIAHTrieWriterNodeSize(const HIAHTrieNode *node) {
+    size_t terminal = HIAHTrieWriterTerminalSize(node);
+    size_t size = HIAHTrieWriterULEBSize(terminal) + terminal + 1;
+    for (size_t i = 0; i < node->childCount; i++) {
+        size += strlen(node->edges[i]) + 1 + HIAHTrieWriterULEBSize(node->children[i]->offset);
+    }
+    return size;
+}
+
+static inline void HIAHTrieWriterCollect(HIAHTrieNode *node, HIAHTrieNode ***order, size_t *count,
+                                         size_t *capacity) {
+    if (*count == *capacity) {
+        *capacity = *capacity ? *capacity * 2 : 64;
+        *order = realloc(*order, *capacity * sizeof(HIAHTrieNode *));
+    }
+    (*order)[(*count)++] = node;
+    for (size_t i = 0; i < node->childCount; i++) {
+        HIAHTrieWriterCollect(node->children[i], order, count, capacity);
+    }
+}
+
+/**
+ * @return A malloc'd trie of `*size` bytes
+ */
+static inline uint8_t *HIAHTrieWriterEncode(HIAHTrieNode *root, size_t *size) {
+    HIAHTrieNode **order = NULL;
+    size_t count = 0, capacity = 0;
+    HIAHTrieWriterCollect(root, &order, &count, &capacity);
+
+    // Offsets depend on the sizes of the offsets before them
+    bool changed = true;
+    uint64_t total = 0;
+    while (changed) {
+        changed = false;
+        total = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (order[i]->offset != total) {
+                order[i]->offset = total;
+                changed = true;
+            }
+            total += HIAHTrieWriterNodeSize(order[i]);
+        }
+    }
+
+    uint8_t *trie = malloc(total ? (size_t)total : 1);
+    for (size_t i = 0; i < count; i++) {
+        const HIAHTrieNode *node = order[i];
+        uint8_t *out = trie + node->offset;
+        size_t terminal = HIAHTrieWriterTerminalSize(node);
+        out = HIAHTrieWriterPutULEB(out, terminal);
+        if (node->terminal) {
+            const HIAHExport *info = &node->info;
+            out = HIAHTrieWriterPutULEB(out, info->flags);
+            if (info->flags & HIAH_EXPORT_REEXPORT) {
+                const char *importName = info->importName ? info->importName : "";
+                out = HIAHTrieWriterPutULEB(out, info->ordinal);
+                memcpy(out, importName, strlen(importName) + 1);
+                out += strlen(importName) + 1;
+            } else {
+                out = HIAHTrieWriterPutULEB(out, info->address);
+                if (info->flags & HIAH_EXPORT_STUB_AND_RESOLVER) {
+                    out = HIAHTrieWriterPutULEB(out, info->resolver);
+                }
+            }
+        }
+        *out++ = (uint8_t)node->childCount;
+        for (size_t j = 0; j < node->childCount; j++) {
+            memcpy(out, node->edges[j], strlen(node->edges[j]) + 1);
+            out += strlen(node->edges[j]) + 1;
+            out = HIAHTrieWriterPutULEB(out, node->children[j]->offset);
+        }
+    }
+    free(order);
+    *size = (size_t)total;
+    return trie;
+}
+
+#endif /* HIAH_EXPORT_TRIE_WRITER_H */
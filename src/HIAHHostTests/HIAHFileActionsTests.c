@@ -0,0 +1,296 @@
+/**
+ * HIAHFileActionsTests.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Host tests for the file action side table.
+ *
+ * Actions are recorded the way the guest hooks record them: next to the
+ * real posix_spawn_file_actions_* call, and only when that call succeeds.
+ * The stress test runs concurrent spawners, each building heap-allocated
+ * file actions (so addresses freed by one thread are reused by another),
+ * checking that the copy it gets back is exactly what it recorded, and
+ * now and then spawning a real child with them. Another holds more live
+ * objects across threads than the table has slots, so entries overflow.
+ * HIAH_STRESS_ITERATIONS sets the iterations per spawner (default 4000).
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHHostTest.h"
+#include "HIAHFileActions.h"
+#include <pthread.h>
+#include <spawn.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define TEST_SPAWNERS    16
+#define TEST_TABLE_SLOTS 256     // HIAH_FILE_ACTIONS_SLOTS
+
+extern char **environ;
+
+// MARK: - Hook stand-ins
+
+static void TestInit(posix_spawn_file_actions_t *fa) {
+    HIAHFileActionsForget(fa);
+    HIAH_CHECK(posix_spawn_file_actions_init(fa) == 0);
+}
+
+static void TestDestroy(posix_spawn_file_actions_t *fa) {
+    HIAHFileActionsForget(fa);
+    posix_spawn_file_actions_destroy(fa);
+}
+
+static bool TestAddDup2(posix_spawn_file_actions_t *fa, int fd, int newFd) {
+    if (posix_spawn_file_actions_adddup2(fa, fd, newFd) != 0) {
+        return false;
+    }
+    return HIAHFileActionsRecord(fa, (HIAHFileAction){ HIAHFileActionDup2, fd, newFd });
+}
+
+static bool TestAddClose(posix_spawn_file_actions_t *fa, int fd) {
+    if (posix_spawn_file_actions_addclose(fa, fd) != 0) {
+        return false;
+    }
+    return HIAHFileActionsRecord(fa, (HIAHFileAction){ HIAHFileActionClose, fd, 0 });
+}
+
+static void TestCheckActions(const void *fa, const HIAHFileAction *expected, size_t count) {
+    HIAHFileAction *actions = NULL;
+    HIAH_CHECK_EQ(HIAHFileActionsCopy(fa, &actions), count);
+    HIAH_CHECK(count ? actions != NULL : actions == NULL);
+    for (size_t i = 0; i < count; i++) {
+        HIAH_CHECK_EQ(actions[i].type, expected[i].type);
+        HIAH_CHECK_EQ(actions[i].fd, expected[i].fd);
+        HIAH_CHECK_EQ(actions[i].newFd, expected[i].newFd);
+    }
+    free(actions);
+}
+
+// MARK: - Tests
+
+static void TestRecordCopyForget(void) {
+    posix_spawn_file_actions_t fa;
+    TestInit(&fa);
+    TestCheckActions(&fa, NULL, 0);
+
+    HIAH_CHECK(TestAddDup2(&fa, 5, 1));
+    HIAH_CHECK(TestAddClose(&fa, 5));
+    HIAHFileAction expected[] = {{HIAHFileActionDup2, 5, 1}, {HIAHFileActionClose, 5, 0}};
+    TestCheckActions(&fa, expected, 2);
+    HIAH_CHECK_EQ(HIAHFileActionsCount(), 1);
+
+    // A call the real function rejects is not recorded
+    HIAH_CHECK(!TestAddDup2(&fa, -1, 1));
+    TestCheckActions(&fa, expected, 2);
+
+    TestDestroy(&fa);
+    TestCheckActions(&fa, NULL, 0);
+    HIAH_CHECK_EQ(HIAHFileActionsCount(), 0);
+
+    // Null and reserved addresses are never entries
+    HIAH_CHECK(!HIAHFileActionsRecord(NULL, expected[0]));
+    HIAH_CHECK(!HIAHFileActionsRecord((const void *)1, expected[0]));
+}
+
+static void TestSpill(void) {
+    posix_spawn_file_actions_t fa;
+    TestInit(&fa);
+    HIAHFileAction expected[40];
+    for (int i = 0; i < 40; i++) {
+        HIAH_CHECK(TestAddDup2(&fa, 100 + i, i % 3));
+        expected[i] = (HIAHFileAction){ HIAHFileActionDup2, 100 + i, i % 3 };
+    }
+    TestCheckActions(&fa, expected, 40);
+
+    // Re-initialized at the same address, the object starts empty
+    TestDestroy(&fa);
+    TestInit(&fa);
+    TestCheckActions(&fa, NULL, 0);
+    HIAH_CHECK(TestAddClose(&fa, 7));
+    TestCheckActions(&fa, &(HIAHFileAction){ HIAHFileActionClose, 7, 0 }, 1);
+    TestDestroy(&fa);
+    HIAH_CHECK_EQ(HIAHFileActionsCount(), 0);
+}
+
+static void TestFullTable(void) {
+    // Past the last slot, entries overflow and behave the same
+    static uint64_t objects[TEST_TABLE_SLOTS + 64];
+    size_t count = sizeof(objects) / sizeof(objects[0]);
+    for (size_t i = 0; i < count; i++) {
+        HIAHFileAction action = { HIAHFileActionClose, (int32_t)i, 0 };
+        HIAH_CHECK(HIAHFileActionsRecord(&objects[i], action));
+    }
+    HIAH_CHECK_EQ(HIAHFileActionsCount(), count);
+
+    // Overflowed entries spill past their inline actions too
+    HIAHFileAction expected[20];
+    expected[0] = (HIAHFileAction){ HIAHFileActionClose, (int32_t)(count - 1), 0 };
+    for (int i = 1; i < 20; i++) {
+        expected[i] = (HIAHFileAction){ HIAHFileActionDup2, i, 1 };
+        HIAH_CHECK(HIAHFileActionsRecord(&objects[count - 1], expected[i]));
+    }
+    TestCheckActions(&objects[count - 1], expected, 20);
+
+    // Every entry is still found, and forgetting entries in either place
+    // leaves the others intact
+    for (size_t i = 0; i < count - 1; i++) {
+        TestCheckActions(&objects[i], &(HIAHFileAction){ HIAHFileActionClose, (int32_t)i, 0 }, 1);
+    }
+    for (size_t i = 0; i < count; i += 2) {
+        HIAHFileActionsForget(&objects[i]);
+    }
+    for (size_t i = 1; i < count - 1; i += 2) {
+        TestCheckActions(&objects[i], &(HIAHFileAction){ HIAHFileActionClose, (int32_t)i, 0 }, 1);
+        TestCheckActions(&objects[i - 1], NULL, 0);
+    }
+    for (size_t i = 1; i < count; i += 2) {
+        HIAHFileActionsForget(&objects[i]);
+    }
+    HIAH_CHECK_EQ(HIAHFileActionsCount(), 0);
+
+    // Emptied, the table takes new objects again
+    HIAH_CHECK(HIAHFileActionsRecord(&objects[0], expected[0]));
+    TestCheckActions(&objects[0], expected, 1);
+    HIAHFileActionsForget(&objects[0]);
+    HIAH_CHECK_EQ(HIAHFileActionsCount(), 0);
+}
+
+static void TestTombstoneChurn(void) {
+    // Far more objects than slots pass through, a few alive at a time, so
+    // every slot ends up a tombstone and is reused
+    static uint64_t objects[64 * TEST_TABLE_SLOTS];
+    size_t count = sizeof(objects) / sizeof(objects[0]);
+    for (size_t i = 0; i < count; i++) {
+        HIAHFileAction action = { HIAHFileActionDup2, (int32_t)i, 1 };
+        HIAH_CHECK(HIAHFileActionsRecord(&objects[i], action));
+        TestCheckActions(&objects[i], &action, 1);
+        if (i >= 8) {
+            HIAHFileActionsForget(&objects[i - 8]);
+        }
+    }
+    for (size_t i = count - 8; i < count; i++) {
+        HIAHFileActionsForget(&objects[i]);
+    }
+    HIAH_CHECK_EQ(HIAHFileActionsCount(), 0);
+}
+
+typedef struct {
+    int index;
+    int iterations;
+    int spawned;
+} TestSpawner;
+
+#define TEST_HELD 32    // Per thread, so all threads together overflow
+
+static void *TestHolderThread(void *data) {
+    TestSpawner *holder = data;
+    static _Thread_local uint64_t objects[TEST_HELD];
+    for (int i = 0; i < holder->iterations / 8; i++) {
+        for (int o = 0; o < TEST_HELD; o++) {
+            HIAHFileAction action = { HIAHFileActionDup2, holder->index, o + i };
+            HIAH_CHECK(HIAHFileActionsRecord(&objects[o], action));
+        }
+        for (int o = 0; o < TEST_HELD; o++) {
+            TestCheckActions(&objects[o], &(HIAHFileAction){ HIAHFileActionDup2, holder->index, o + i }, 1);
+            HIAHFileActionsForget(&objects[o]);
+        }
+    }
+    return NULL;
+}
+
+static void TestConcurrentOverflow(void) {
+    const char *value = getenv("HIAH_STRESS_ITERATIONS");
+    int iterations = value && atoi(value) > 0 ? atoi(value) : 4000;
+
+    pthread_t threads[TEST_SPAWNERS];
+    TestSpawner holders[TEST_SPAWNERS];
+    for (int t = 0; t < TEST_SPAWNERS; t++) {
+        holders[t] = (TestSpawner){ t, iterations, 0 };
+        HIAH_CHECK(pthread_create(&threads[t], NULL, TestHolderThread, &holders[t]) == 0);
+    }
+    for (int t = 0; t < TEST_SPAWNERS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    HIAH_CHECK_EQ(HIAHFileActionsCount(), 0);
+}
+
+static void *TestSpawnerThread(void *data) {
+    TestSpawner *spawner = data;
+    int pipeFds[2];
+    HIAH_CHECK(pipe(pipeFds) == 0);
+
+    for (int i = 0; i < spawner->iterations; i++) {
+        // Heap objects, so one thread's freed address is another's next
+        posix_spawn_file_actions_t *fa = malloc(sizeof(*fa));
+        HIAH_CHECK(fa != NULL);
+        TestInit(fa);
+
+        // A pipe setup of varying length, so entries move between inline
+        // and spilled storage. The pipe's descriptors are this thread's
+        // alone, so actions from another spawner would not match.
+        HIAHFileAction expected[12];
+        size_t count = 0;
+        int extra = (i + spawner->index) % 9;
+        HIAH_CHECK(TestAddDup2(fa, pipeFds[1], 1));
+        expected[count++] = (HIAHFileAction){ HIAHFileActionDup2, pipeFds[1], 1 };
+        for (int e = 0; e < extra; e++) {
+            HIAH_CHECK(TestAddDup2(fa, pipeFds[e % 2], 2));
+            expected[count++] = (HIAHFileAction){ HIAHFileActionDup2, pipeFds[e % 2], 2 };
+        }
+        HIAH_CHECK(TestAddClose(fa, pipeFds[0]));
+        expected[count++] = (HIAHFileAction){ HIAHFileActionClose, pipeFds[0], 0 };
+        HIAH_CHECK(TestAddClose(fa, pipeFds[1]));
+        expected[count++] = (HIAHFileAction){ HIAHFileActionClose, pipeFds[1], 0 };
+
+        TestCheckActions(fa, expected, count);
+
+        if (i % 32 == 0) {
+            char *argv[] = {"true", NULL};
+            pid_t pid;
+            HIAH_CHECK(posix_spawnp(&pid, "true", fa, NULL, argv, environ) == 0);
+            int status = 0;
+            HIAH_CHECK(waitpid(pid, &status, 0) == pid);
+            spawner->spawned++;
+        }
+
+        TestDestroy(fa);
+        free(fa);
+    }
+    close(pipeFds[0]);
+    close(pipeFds[1]);
+    return NULL;
+}
+
+static void TestConcurrentSpawners(void) {
+    const char *value = getenv("HIAH_STRESS_ITERATIONS");
+    int iterations = value && atoi(value) > 0 ? atoi(value) : 4000;
+
+    pthread_t threads[TEST_SPAWNERS];
+    TestSpawner spawners[TEST_SPAWNERS];
+    for (int t = 0; t < TEST_SPAWNERS; t++) {
+        spawners[t] = (TestSpawner){ t, iterations, 0 };
+        HIAH_CHECK(pthread_create(&threads[t], NULL, TestSpawnerThread, &spawners[t]) == 0);
+    }
+    int spawned = 0;
+    for (int t = 0; t < TEST_SPAWNERS; t++) {
+        pthread_join(threads[t], NULL);
+        spawned += spawners[t].spawned;
+    }
+    HIAH_CHECK_EQ(spawned, TEST_SPAWNERS * ((iterations + 31) / 32));
+    HIAH_CHECK_EQ(HIAHFileActionsCount(), 0);
+}
+
+int main(void) {
+    printf("HIAHFileActions\n");
+    HIAH_RUN_TEST(TestRecordCopyForget);
+    HIAH_RUN_TEST(TestSpill);
+    HIAH_RUN_TEST(TestFullTable);
+    HIAH_RUN_TEST(TestTombstoneChurn);
+    HIAH_RUN_TEST(TestConcurrentOverflow);
+    HIAH_RUN_TEST(TestConcurrentSpawners);
+    return 0;
+}
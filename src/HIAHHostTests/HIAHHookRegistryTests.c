@@ -0,0 +1,418 @@
+/**
+ * HIAHHookRegistryTests.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Host tests for the registry of active hooks.
+ *
+ * A simulated image feed stands in for dyld: images are "loaded" by adding
+ * them to a list, and once the registry starts the feed, each one is
+ * reported through HIAHHookRegistryImageAdded() (the path HIAHHookImageAdded
+ * takes) after the list holds it, as dyld does. Starting the feed replays
+ * the list. The images are synthetic 64-bit Mach-O images with a __got
+ * section; applying hooks scans them with HIAHHookScanImage(), as
+ * HIAHHookInterceptBatch does, and writes the matched slots. Every scan is
+ * logged, so the tests can tell which images were looked at.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHHostTest.h"
+#include "HIAHHookRegistry.h"
+#include <pthread.h>
+#include <string.h>
+
+#define TEST_HOOKS        4
+#define TEST_SLOTS        96
+#define TEST_MAX_IMAGES   512
+#define TEST_LOADERS      8
+#define TEST_TEXT_VMADDR  0x100000000ull
+
+// Stand-ins for the hooked functions and their replacements; only their
+// addresses matter
+static char gOriginals[TEST_HOOKS];
+static char gReplacements[TEST_HOOKS];
+static char gOther;
+
+// MARK: - Synthetic Images
+
+typedef struct {
+    uint32_t magic;
+    int32_t cputype;
+    int32_t cpusubtype;
+    uint32_t filetype;
+    uint32_t ncmds;
+    uint32_t sizeofcmds;
+    uint32_t flags;
+    uint32_t reserved;
+} TestHeader;
+
+typedef struct {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    char segname[16];
+    uint64_t vmaddr;
+    uint64_t vmsize;
+    uint64_t fileoff;
+    uint64_t filesize;
+    int32_t maxprot;
+    int32_t initprot;
+    uint32_t nsects;
+    uint32_t flags;
+} TestSegment;
+
+typedef struct {
+    char sectname[16];
+    char segname[16];
+    uint64_t addr;
+    uint64_t size;
+    uint32_t offset;
+    uint32_t align;
+    uint32_t reloff;
+    uint32_t nreloc;
+    uint32_t flags;
+    uint32_t reserved1;
+    uint32_t reserved2;
+    uint32_t reserved3;
+} TestSection;
+
+typedef struct {
+    uint8_t *data;
+    void **slots;
+    int planted[TEST_HOOKS];   // Slots holding each original
+    int scans;                 // Times an apply looked at this image
+} TestImage;
+
+#define TEST_HEADER_SIZE 512
+
+static TestSegment *TestAddSegment(uint8_t **cursor, TestHeader *header, const char *name,
+                                   uint64_t offset, uint64_t size, uint32_t nsects) {
+    TestSegment *segment = (TestSegment *)*cursor;
+    segment->cmd = 0x19;                    // LC_SEGMENT_64
+    segment->cmdsize = (uint32_t)(sizeof(TestSegment) + nsects * sizeof(TestSection));
+    snprintf(segment->segname, sizeof(segment->segname), "%s", name);
+    segment->vmaddr = TEST_TEXT_VMADDR + offset;
+    segment->vmsize = size;
+    segment->fileoff = offset;
+    segment->filesize = size;
+    segment->nsects = nsects;
+    header->ncmds++;
+    header->sizeofcmds += segment->cmdsize;
+    *cursor += segment->cmdsize;
+    return segment;
+}
+
+/**
+ * __TEXT over the header, then __DATA_CONST,__got. Slot `j` holds the
+ * original of hook `(j + seed) % (TEST_HOOKS + 1)`, the last value meaning
+ * an unhooked import.
+ */
+static void TestBuildImage(TestImage *image, int seed) {
+    memset(image, 0, sizeof(*image));
+    size_t gotSize = TEST_SLOTS * sizeof(void *);
+    image->data = calloc(1, TEST_HEADER_SIZE + gotSize);
+    HIAH_CHECK(image->data != NULL);
+
+    TestHeader *header = (TestHeader *)image->data;
+    header->magic = 0xfeedfacf;             // MH_MAGIC_64
+    header->filetype = 0x6;                 // MH_DYLIB
+    uint8_t *cursor = (uint8_t *)(header + 1);
+    TestAddSegment(&cursor, header, "__TEXT", 0, TEST_HEADER_SIZE, 0);
+    TestSegment *data = TestAddSegment(&cursor, header, "__DATA_CONST", TEST_HEADER_SIZE, gotSize, 1);
+    TestSection *got = (TestSection *)(data + 1);
+    snprintf(got->segname, sizeof(got->segname), "__DATA_CONST");
+    snprintf(got->sectname, sizeof(got->sectname), "__got");
+    got->addr = TEST_TEXT_VMADDR + TEST_HEADER_SIZE;
+    got->size = gotSize;
+    got->offset = TEST_HEADER_SIZE;
+    got->align = 3;
+    got->flags = 0x6;                       // S_NON_LAZY_SYMBOL_POINTERS
+
+    image->slots = (void **)(image->data + TEST_HEADER_SIZE);
+    for (int j = 0; j < TEST_SLOTS; j++) {
+        int hook = (j + seed) % (TEST_HOOKS + 1);
+        if (hook < TEST_HOOKS) {
+            image->slots[j] = &gOriginals[hook];
+            image->planted[hook]++;
+        } else {
+            image->slots[j] = &gOther;
+        }
+    }
+}
+
+// Slots of `image` still holding the original of `hook`
+static int TestUnhooked(const TestImage *image, int hook) {
+    int count = 0;
+    for (int j = 0; j < TEST_SLOTS; j++) {
+        count += image->slots[j] == &gOriginals[hook];
+    }
+    return count;
+}
+
+static HIAHHookBinding TestBinding(int hook) {
+    return (HIAHHookBinding){ &gOriginals[hook], &gReplacements[hook], NULL, 0 };
+}
+
+// MARK: - Simulated Feed
+
+typedef struct {
+    pthread_mutex_t lock;      // Also serializes applies, as page writes would
+    TestImage *loaded[TEST_MAX_IMAGES];
+    int count;
+    bool watching;
+    int globalApplies;
+    HIAHHookRegistry *registry;
+} TestFeed;
+
+static void TestWriteSlot(void **slot, HIAHHookBinding *binding, void *context) {
+    (void)context;
+    *slot = binding->replacement;
+    binding->rewritten++;
+}
+
+static void TestApplyImage(TestImage *image, const HIAHHookTargetSet *set) {
+    image->scans++;
+    HIAHHookScanImage(image->data, set, TestWriteSlot, NULL);
+}
+
+static void TestApply(const void *image, HIAHHookBinding *bindings, size_t count, void *context) {
+    TestFeed *feed = context;
+    HIAHHookTarget storage[TEST_HOOKS * 2];
+    HIAH_CHECK(count <= TEST_HOOKS * 2);
+    HIAHHookTargetSet set;
+    HIAHHookTargetSetBuild(&set, storage, bindings, count);
+
+    pthread_mutex_lock(&feed->lock);
+    if (image) {
+        for (int i = 0; i < feed->count; i++) {
+            if (feed->loaded[i]->data == image) {
+                TestApplyImage(feed->loaded[i], &set);
+            }
+        }
+    } else {
+        feed->globalApplies++;
+        for (int i = 0; i < feed->count; i++) {
+            TestApplyImage(feed->loaded[i], &set);
+        }
+    }
+    pthread_mutex_unlock(&feed->lock);
+}
+
+static void TestWatch(HIAHHookRegistry *registry, void *context) {
+    TestFeed *feed = context;
+    TestImage *replay[TEST_MAX_IMAGES];
+    pthread_mutex_lock(&feed->lock);
+    feed->watching = true;
+    int count = feed->count;
+    memcpy(replay, feed->loaded, (size_t)count * sizeof(TestImage *));
+    pthread_mutex_unlock(&feed->lock);
+    for (int i = 0; i < count; i++) {
+        HIAHHookRegistryImageAdded(registry, replay[i]->data);
+    }
+}
+
+static void TestFeedInit(TestFeed *feed) {
+    memset(feed, 0, sizeof(*feed));
+    pthread_mutex_init(&feed->lock, NULL);
+    feed->registry = HIAHHookRegistryCreate(TestApply, TestWatch, feed);
+    HIAH_CHECK(feed->registry != NULL);
+}
+
+static void TestFeedDestroy(TestFeed *feed) {
+    HIAHHookRegistryDestroy(feed->registry);
+    for (int i = 0; i < feed->count; i++) {
+        free(feed->loaded[i]->data);
+        free(feed->loaded[i]);
+    }
+    pthread_mutex_destroy(&feed->lock);
+}
+
+static TestImage *TestLoad(TestFeed *feed, int seed) {
+    TestImage *image = malloc(sizeof(TestImage));
+    HIAH_CHECK(image != NULL);
+    TestBuildImage(image, seed);
+    pthread_mutex_lock(&feed->lock);
+    HIAH_CHECK(feed->count < TEST_MAX_IMAGES);
+    feed->loaded[feed->count++] = image;
+    bool watching = feed->watching;
+    pthread_mutex_unlock(&feed->lock);
+    if (watching) {
+        HIAHHookRegistryImageAdded(feed->registry, image->data);
+    }
+    return image;
+}
+
+static void TestResetScans(TestFeed *feed) {
+    pthread_mutex_lock(&feed->lock);
+    for (int i = 0; i < feed->count; i++) {
+        feed->loaded[i]->scans = 0;
+    }
+    feed->globalApplies = 0;
+    pthread_mutex_unlock(&feed->lock);
+}
+
+// MARK: - Tests
+
+static void TestOnlyNewImageScanned(void) {
+    TestFeed feed;
+    TestFeedInit(&feed);
+    TestImage *early[3];
+    for (int i = 0; i < 3; i++) {
+        early[i] = TestLoad(&feed, i);
+    }
+
+    // Reported before any hook is active: nothing to scan
+    HIAHHookRegistryImageAdded(feed.registry, early[0]->data);
+    HIAH_CHECK_EQ(early[0]->scans, 0);
+
+    // The replay is the initial install, one scan per loaded image
+    HIAHHookBinding bindings[2] = { TestBinding(0), TestBinding(1) };
+    HIAH_CHECK(HIAHHookRegistryAdd(feed.registry, bindings, 2));
+    for (int h = 0; h < 2; h++) {
+        HIAH_CHECK_EQ(bindings[h].rewritten,
+                      early[0]->planted[h] + early[1]->planted[h] + early[2]->planted[h]);
+    }
+    for (int i = 0; i < 3; i++) {
+        HIAH_CHECK_EQ(early[i]->scans, 1);
+    }
+    HIAH_CHECK_EQ(feed.globalApplies, 0);
+    HIAHHookRegistryStats stats;
+    HIAHHookRegistryGetStats(feed.registry, &stats);
+    HIAH_CHECK_EQ(stats.imagesReplayed, 3);
+    HIAH_CHECK_EQ(stats.imagesAdded, 0);
+
+    // A later image is scanned alone
+    TestResetScans(&feed);
+    TestImage *late = TestLoad(&feed, 7);
+    HIAH_CHECK_EQ(late->scans, 1);
+    for (int i = 0; i < 3; i++) {
+        HIAH_CHECK_EQ(early[i]->scans, 0);
+    }
+    HIAH_CHECK_EQ(feed.globalApplies, 0);
+    HIAH_CHECK_EQ(TestUnhooked(late, 0), 0);
+    HIAH_CHECK_EQ(TestUnhooked(late, 1), 0);
+    HIAH_CHECK_EQ(TestUnhooked(late, 2), late->planted[2]);
+    HIAHHookRegistryGetStats(feed.registry, &stats);
+    HIAH_CHECK_EQ(stats.imagesReplayed, 3);
+    HIAH_CHECK_EQ(stats.imagesAdded, 1);
+    TestFeedDestroy(&feed);
+}
+
+static void TestLaterBindingsReachEarlierImages(void) {
+    TestFeed feed;
+    TestFeedInit(&feed);
+    TestImage *a = TestLoad(&feed, 0);
+    HIAHHookBinding first = TestBinding(0);
+    HIAH_CHECK(HIAHHookRegistryAdd(feed.registry, &first, 1));
+    TestImage *b = TestLoad(&feed, 1);
+
+    // Hooks registered after the feed started go over every image once
+    TestResetScans(&feed);
+    HIAHHookBinding second[2] = { TestBinding(2), TestBinding(3) };
+    HIAH_CHECK(HIAHHookRegistryAdd(feed.registry, second, 2));
+    HIAH_CHECK_EQ(feed.globalApplies, 1);
+    HIAH_CHECK_EQ(a->scans, 1);
+    HIAH_CHECK_EQ(b->scans, 1);
+    for (int h = 2; h < 4; h++) {
+        HIAH_CHECK_EQ(TestUnhooked(a, h), 0);
+        HIAH_CHECK_EQ(TestUnhooked(b, h), 0);
+        HIAH_CHECK_EQ(second[h - 2].rewritten, a->planted[h] + b->planted[h]);
+    }
+    HIAH_CHECK_EQ(TestUnhooked(a, 1), a->planted[1]);
+
+    // And every active hook reaches images added afterwards
+    TestImage *c = TestLoad(&feed, 2);
+    for (int h = 0; h < TEST_HOOKS; h++) {
+        HIAH_CHECK_EQ(TestUnhooked(c, h), h == 1 ? c->planted[1] : 0);
+    }
+
+    // Totals add up: every planted slot of every active hook, once
+    HIAHHookRegistryStats stats;
+    HIAHHookRegistryGetStats(feed.registry, &stats);
+    uint64_t expected = 0;
+    for (int h = 0; h < TEST_HOOKS; h++) {
+        if (h != 1) {
+            expected += (uint64_t)(a->planted[h] + b->planted[h] + c->planted[h]);
+        }
+    }
+    HIAH_CHECK_EQ(stats.bindings, 3);
+    HIAH_CHECK_EQ(stats.rewritten, expected);
+    HIAH_CHECK_EQ(stats.imagesReplayed, 1);
+    HIAH_CHECK_EQ(stats.imagesAdded, 2);
+
+    // Applied again, a hook finds nothing left to rewrite
+    HIAHHookBinding again = TestBinding(0);
+    HIAH_CHECK(HIAHHookRegistryAdd(feed.registry, &again, 1));
+    HIAH_CHECK_EQ(again.rewritten, 0);
+    HIAHHookRegistryGetStats(feed.registry, &stats);
+    HIAH_CHECK_EQ(stats.rewritten, expected);
+    TestFeedDestroy(&feed);
+}
+
+static void TestNamesCopied(void) {
+    TestFeed feed;
+    TestFeedInit(&feed);
+    char name[] = "posix_spawn";
+    HIAHHookBinding binding = { NULL, &gReplacements[0], name, 0 };
+    HIAH_CHECK(HIAHHookRegistryAdd(feed.registry, &binding, 1));
+    memset(name, 'x', sizeof(name) - 1);
+    TestLoad(&feed, 0);
+    TestFeedDestroy(&feed);
+}
+
+typedef struct {
+    TestFeed *feed;
+    int index;
+} TestLoader;
+
+static void *TestLoaderThread(void *data) {
+    TestLoader *loader = data;
+    for (int i = 0; i < TEST_MAX_IMAGES / TEST_LOADERS - 1; i++) {
+        TestLoad(loader->feed, loader->index * 101 + i);
+    }
+    return NULL;
+}
+
+static void TestConcurrentLoads(void) {
+    // Hooks are added while images are being loaded on other threads; no
+    // image may miss a hook, and no slot may be counted twice
+    TestFeed feed;
+    TestFeedInit(&feed);
+    pthread_t threads[TEST_LOADERS];
+    TestLoader loaders[TEST_LOADERS];
+    for (int t = 0; t < TEST_LOADERS; t++) {
+        loaders[t] = (TestLoader){ &feed, t };
+        HIAH_CHECK(pthread_create(&threads[t], NULL, TestLoaderThread, &loaders[t]) == 0);
+    }
+    for (int h = 0; h < TEST_HOOKS; h++) {
+        HIAHHookBinding binding = TestBinding(h);
+        HIAH_CHECK(HIAHHookRegistryAdd(feed.registry, &binding, 1));
+    }
+    for (int t = 0; t < TEST_LOADERS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+
+    uint64_t planted = 0;
+    for (int i = 0; i < feed.count; i++) {
+        for (int h = 0; h < TEST_HOOKS; h++) {
+            HIAH_CHECK_EQ(TestUnhooked(feed.loaded[i], h), 0);
+            planted += (uint64_t)feed.loaded[i]->planted[h];
+        }
+    }
+    HIAHHookRegistryStats stats;
+    HIAHHookRegistryGetStats(feed.registry, &stats);
+    HIAH_CHECK_EQ(stats.rewritten, planted);
+    HIAH_CHECK(stats.imagesReplayed + stats.imagesAdded <= (uint64_t)feed.count);
+    TestFeedDestroy(&feed);
+}
+
+int main(void) {
+    printf("HIAHHookRegistry\n");
+    HIAH_RUN_TEST(TestOnlyNewImageScanned);
+    HIAH_RUN_TEST(TestLaterBindingsReachEarlierImages);
+    HIAH_RUN_TEST(TestNamesCopied);
+    HIAH_RUN_TEST(TestConcurrentLoads);
+    return 0;
+}
@@ -0,0 +1,82 @@
+/**
+ * HIAHHostTest.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Minimal assertion helpers for the host test programs.
+ *
+ * Each test program is a plain executable that exits non-zero on the first
+ * failed check, so the nix check phase (or a shell loop) can run them
+ * without a test framework.
+ *
+ * Fixtures are read from $HIAH_TEST_FIXTURES, or from
+ * src/HIAHHostTests/Fixtures when run from the source root.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_HOST_TEST_H
+#define HIAH_HOST_TEST_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define HIAH_CHECK(condition)                                                   \
+    do {                                                                        \
+        if (!(condition)) {                                                     \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,    \
+                    #condition);                                                \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
+
+#define HIAH_CHECK_EQ(actual, expected)                                         \
+    do {                                                                        \
+        long long hiahActual_ = (long long)(actual);                            \
+        long long hiahExpected_ = (long long)(expected);                        \
+        if (hiahActual_ != hiahExpected_) {                                     \
+            fprintf(stderr, "%s:%d: %s is %lld, expected %lld\n", __FILE__,     \
+                    __LINE__, #actual, hiahActual_, hiahExpected_);             \
+            exit(1);                                                            \
+        }                                                                       \
+    } while (0)
+
+#define HIAH_RUN_TEST(test)                                                     \
+    do {                                                                        \
+        printf("  %-44s", #test);                                               \
+        fflush(stdout);                                                         \
+        test();                                                                 \
+        printf("ok\n");                                                         \
+    } while (0)
+
+/**
+ * Reads a whole fixture into a malloc'd buffer, or exits.
+ */
+static inline uint8_t *HIAHTestReadFixture(const char *name, size_t *size) {
+    const char *directory = getenv("HIAH_TEST_FIXTURES");
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", directory && *directory ? directory : "src/HIAHHostTests/Fixtures",
+             name);
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "cannot open fixture %s\n", path);
+        exit(1);
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = malloc(length > 0 ? (size_t)length : 1);
+    if (!data || length < 0 || fread(data, 1, (size_t)length, file) != (size_t)length) {
+        fprintf(stderr, "cannot read fixture %s\n", path);
+        exit(1);
+    }
+    fclose(file);
+    *size = (size_t)length;
+    return data;
+}
+
+#endif /* HIAH_HOST_TEST_H */
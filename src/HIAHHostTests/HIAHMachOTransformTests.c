@@ -0,0 +1,754 @@
+/**
+ * HIAHMachOTransformTests.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Host tests for Mach-O header edits on files.
+ *
+ * Every file transform is checked against HIAHMachOTransformBuffer() on a
+ * copy of the same bytes: the file must end up exactly as the buffer does.
+ * The binaries are built here, thin and fat, each slice ending in a code
+ * signature; the symbols fixture covers a real linker layout.
+ *
+ * The header edits (filetype, __PAGEZERO, an added load command) are
+ * checked field by field on thin and fat binaries, leave everything past
+ * the load commands alone, and apply only once. A transform that cannot
+ * apply leaves the file as it was.
+ *
+ * FAT_MAGIC_64 binaries round-trip like FAT_MAGIC ones. Binaries with
+ * enough slices to be edited on the worker pool must come out with every
+ * slice as it would alone, in order, and the same on every run.
+ *
+ * Removing the signature, on its own, shortens each slice and __LINKEDIT
+ * and moves the slices after it; signature data that does not end its
+ * slice stays. Edited files are replaced, not written in place: an image mapped
+ * from the file keeps its contents, and the crash test kills transforms of
+ * a fat binary at varying points and checks that the file is always either
+ * the original or the finished result. HIAH_STRESS_ITERATIONS sets the
+ * number of kills (default 40).
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHHostTest.h"
+#include "HIAHMachOTransform.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TEST_PAGE       0x4000u
+#define TEST_SIGNATURE  0x4000u    // One page, so a trimmed slice frees exactly one
+#define TEST_PAGEZERO   0x100000000ull
+#define TEST_FAT_MAGIC    0xcafebabeu
+#define TEST_FAT_MAGIC_64 0xcafebabfu
+
+static char TestDirectory[256];
+
+// MARK: - Binaries
+
+typedef struct {
+    uint8_t *data;
+    size_t length;
+} TestBuffer;
+
+static void TestPut32(TestBuffer *b, uint32_t value) {
+    memcpy(b->data + b->length, &value, 4);
+    b->length += 4;
+}
+
+static void TestPut64(TestBuffer *b, uint64_t value) {
+    memcpy(b->data + b->length, &value, 8);
+    b->length += 8;
+}
+
+static void TestPutBig32(uint8_t *p, uint32_t value) {
+    value = __builtin_bswap32(value);
+    memcpy(p, &value, 4);
+}
+
+static void TestPutSegment(TestBuffer *b, const char *name, uint64_t vmaddr, uint64_t vmsize,
+                           uint64_t fileoff, uint64_t filesize, uint32_t nsects) {
+    TestPut32(b, 0x19);                    // LC_SEGMENT_64
+    TestPut32(b, 72 + nsects * 80);
+    memset(b->data + b->length, 0, 16);
+    memcpy(b->data + b->length, name, strlen(name));
+    b->length += 16;
+    TestPut64(b, vmaddr);
+    TestPut64(b, vmsize);
+    TestPut64(b, fileoff);
+    TestPut64(b, filesize);
+    TestPut32(b, filesize ? 5 : 0);        // maxprot
+    TestPut32(b, filesize ? 5 : 0);        // initprot
+    TestPut32(b, nsects);
+    TestPut32(b, 0);
+}
+
+/**
+ * Fills `slice` with an executable: __PAGEZERO, __TEXT with one section on
+ * the second page, __LINKEDIT and a code signature ending the slice. The
+ * rest is a pattern that depends on `seed`, so moved data can be told apart.
+ */
+static void TestBuildSlice(uint8_t *slice, size_t size, uint32_t cputype, uint32_t seed) {
+    for (size_t i = 0; i < size; i++) {
+        slice[i] = (uint8_t)(i * 131 + seed * 7 + (i >> 12));
+    }
+    memset(slice, 0, TEST_PAGE);
+    size_t linkedit = size - 2 * TEST_SIGNATURE;
+    TestBuffer b = {slice, 32};
+
+    TestPutSegment(&b, "__PAGEZERO", 0, TEST_PAGEZERO, 0, 0, 0);
+    TestPutSegment(&b, "__TEXT", TEST_PAGEZERO, linkedit, 0, linkedit, 1);
+    memset(b.data + b.length, 0, 80);
+    memcpy(b.data + b.length, "__text", 6);
+    memcpy(b.data + b.length + 16, "__TEXT", 6);
+    b.length += 32;
+    TestPut64(&b, TEST_PAGEZERO + TEST_PAGE);
+    TestPut64(&b, linkedit - TEST_PAGE);
+    TestPut32(&b, TEST_PAGE);              // offset
+    b.length += 28;
+    TestPutSegment(&b, "__LINKEDIT", TEST_PAGEZERO + linkedit, size - linkedit, linkedit,
+                   size - linkedit, 0);
+    TestPut32(&b, 0x1d);                   // LC_CODE_SIGNATURE
+    TestPut32(&b, 16);
+    TestPut32(&b, (uint32_t)(size - TEST_SIGNATURE));
+    TestPut32(&b, TEST_SIGNATURE);
+
+    uint32_t header[8] = {
+        0xfeedfacf, cputype, 0, HIAH_MACHO_FILETYPE_EXECUTE,
+        4, (uint32_t)(b.length - 32), 0x00200085, 0,
+    };
+    memcpy(slice, header, sizeof(header));
+}
+
+/**
+ * A thin binary if `fatMagic` is 0, else a fat one with that magic and
+ * page-aligned slices.
+ */
+static uint8_t *TestBuildFat(uint32_t fatMagic, uint32_t slices, size_t sliceSize, size_t *length) {
+    static const uint32_t cputypes[] = {0x0100000c, 0x01000007, 0x0100000c};
+    size_t archSize = fatMagic == TEST_FAT_MAGIC_64 ? 32 : 20;
+    size_t offset = fatMagic ? (8 + slices * archSize + TEST_PAGE - 1) / TEST_PAGE * TEST_PAGE : 0;
+    *length = offset + slices * sliceSize;
+    uint8_t *bytes = calloc(1, *length);
+    HIAH_CHECK(bytes != NULL);
+    if (fatMagic) {
+        TestPutBig32(bytes, fatMagic);
+        TestPutBig32(bytes + 4, slices);
+    }
+    for (uint32_t i = 0; i < slices; i++) {
+        TestBuildSlice(bytes + offset, sliceSize, cputypes[i % 3], i);
+        uint8_t *arch = bytes + 8 + i * archSize;
+        if (fatMagic == TEST_FAT_MAGIC_64) {
+            TestPutBig32(arch, cputypes[i % 3]);
+            TestPutBig32(arch + 12, (uint32_t)offset);    // High halves stay 0
+            TestPutBig32(arch + 20, (uint32_t)sliceSize);
+            TestPutBig32(arch + 24, 14);
+        } else if (fatMagic) {
+            TestPutBig32(arch, cputypes[i % 3]);
+            TestPutBig32(arch + 8, (uint32_t)offset);
+            TestPutBig32(arch + 12, (uint32_t)sliceSize);
+            TestPutBig32(arch + 16, 14);
+        }
+        offset += sliceSize;
+    }
+    return bytes;
+}
+
+/**
+ * A thin binary for one slice, a FAT_MAGIC one for more.
+ */
+static uint8_t *TestBuildBinary(uint32_t slices, size_t sliceSize, size_t *length) {
+    return TestBuildFat(slices > 1 ? TEST_FAT_MAGIC : 0, slices, sliceSize, length);
+}
+
+// An LC_RPATH, 8-byte aligned
+static const uint8_t TestCommand[32] = {
+    0x1c, 0x00, 0x00, 0x80, 32, 0, 0, 0, 12, 0, 0, 0,
+    '@', 'e', 'x', 'e', 'c', 'u', 't', 'a', 'b', 'l', 'e', '_', 'p', 'a', 't', 'h',
+};
+
+// Header edits only: the slices keep their length
+static const HIAHMachOEdit TestHeaderEdits[] = {
+    {.kind = HIAHMachOEditSetFileType, .fromTypes = HIAH_MACHO_FILETYPE_BIT(HIAH_MACHO_FILETYPE_EXECUTE),
+     .fileType = HIAH_MACHO_FILETYPE_BUNDLE},
+    {.kind = HIAHMachOEditRelocatePageZero, .address = 0xFFFFC000ull, .size = 0x4000},
+    {.kind = HIAHMachOEditAddLoadCommand, .command = TestCommand, .commandSize = sizeof(TestCommand)},
+};
+#define TEST_HEADER_EDIT_COUNT (sizeof(TestHeaderEdits) / sizeof(TestHeaderEdits[0]))
+
+static const HIAHMachOEdit TestTrimEdits[] = {
+    {.kind = HIAHMachOEditRemoveSignature},
+};
+
+static const HIAHMachOEdit TestEdits[] = {
+    {.kind = HIAHMachOEditSetFileType, .fromTypes = HIAH_MACHO_FILETYPE_BIT(HIAH_MACHO_FILETYPE_EXECUTE),
+     .fileType = HIAH_MACHO_FILETYPE_BUNDLE},
+    {.kind = HIAHMachOEditRelocatePageZero, .address = 0xFFFFC000ull, .size = 0x4000},
+    {.kind = HIAHMachOEditRemoveSignature},
+};
+#define TEST_EDIT_COUNT (sizeof(TestEdits) / sizeof(TestEdits[0]))
+
+static uint32_t TestRead32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+static uint64_t TestRead64(const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, 8);
+    return value;
+}
+
+/**
+ * Checks a slice built by TestBuildSlice() after TestHeaderEdits: each edit
+ * shows in its header field, and nothing past the load commands moved.
+ */
+static void TestCheckHeaderEdits(const uint8_t *slice, const uint8_t *original, size_t size) {
+    HIAH_CHECK_EQ(TestRead32(slice + 12), HIAH_MACHO_FILETYPE_BUNDLE);
+    uint32_t ncmds = TestRead32(slice + 16);
+    uint32_t sizeofcmds = TestRead32(slice + 20);
+    HIAH_CHECK_EQ(ncmds, TestRead32(original + 16) + 1);
+    HIAH_CHECK_EQ(sizeofcmds, TestRead32(original + 20) + sizeof(TestCommand));
+
+    // __PAGEZERO comes first, the added command last
+    HIAH_CHECK(memcmp(slice + 32 + 8, "__PAGEZERO", 10) == 0);
+    HIAH_CHECK_EQ(TestRead64(slice + 32 + 24), 0xFFFFC000ull);
+    HIAH_CHECK_EQ(TestRead64(slice + 32 + 32), 0x4000);
+    HIAH_CHECK(memcmp(slice + 32 + sizeofcmds - sizeof(TestCommand), TestCommand,
+                      sizeof(TestCommand)) == 0);
+
+    // The other load commands are as they were
+    HIAH_CHECK(memcmp(slice + 32 + 72, original + 32 + 72, TestRead32(original + 20) - 72) == 0);
+    HIAH_CHECK(memcmp(slice + TEST_PAGE, original + TEST_PAGE, size - TEST_PAGE) == 0);
+}
+
+// MARK: - Files
+
+static void TestPath(char *path, size_t size, const char *name) {
+    snprintf(path, size, "%s/%s", TestDirectory, name);
+}
+
+static void TestWriteFile(const char *path, const uint8_t *bytes, size_t length, mode_t mode) {
+    unlink(path);
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, mode);
+    HIAH_CHECK(fd >= 0);
+    for (size_t done = 0; done < length;) {
+        ssize_t written = write(fd, bytes + done, length - done);
+        HIAH_CHECK(written > 0);
+        done += (size_t)written;
+    }
+    HIAH_CHECK(fchmod(fd, mode) == 0);
+    HIAH_CHECK(close(fd) == 0);
+}
+
+static uint8_t *TestReadFile(const char *path, size_t *length) {
+    int fd = open(path, O_RDONLY);
+    HIAH_CHECK(fd >= 0);
+    struct stat st;
+    HIAH_CHECK(fstat(fd, &st) == 0);
+    uint8_t *bytes = malloc(st.st_size > 0 ? (size_t)st.st_size : 1);
+    HIAH_CHECK(bytes != NULL);
+    for (size_t done = 0; done < (size_t)st.st_size;) {
+        ssize_t got = read(fd, bytes + done, (size_t)st.st_size - done);
+        HIAH_CHECK(got > 0);
+        done += (size_t)got;
+    }
+    close(fd);
+    *length = (size_t)st.st_size;
+    return bytes;
+}
+
+static bool TestFileEquals(const char *path, const uint8_t *bytes, size_t length) {
+    size_t fileLength = 0;
+    uint8_t *file = TestReadFile(path, &fileLength);
+    bool equal = fileLength == length && memcmp(file, bytes, length) == 0;
+    free(file);
+    return equal;
+}
+
+static ino_t TestInode(const char *path) {
+    struct stat st;
+    HIAH_CHECK(stat(path, &st) == 0);
+    return st.st_ino;
+}
+
+// Files in the test directory; a leftover replacement would be one more
+static int TestFileCount(void) {
+    DIR *dir = opendir(TestDirectory);
+    HIAH_CHECK(dir != NULL);
+    int count = 0;
+    for (struct dirent *entry; (entry = readdir(dir));) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            count++;
+        }
+    }
+    closedir(dir);
+    return count;
+}
+
+static void TestRemoveAll(void) {
+    DIR *dir = opendir(TestDirectory);
+    HIAH_CHECK(dir != NULL);
+    for (struct dirent *entry; (entry = readdir(dir));) {
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0) {
+            char path[512];
+            TestPath(path, sizeof(path), entry->d_name);
+            unlink(path);
+        }
+    }
+    closedir(dir);
+}
+
+/**
+ * Transforms `bytes` as a file and in memory and checks they agree. Returns
+ * the expected result, which the caller frees.
+ */
+static uint8_t *TestRoundTrip(const char *name, const uint8_t *bytes, size_t length,
+                              const HIAHMachOEdit *edits, size_t editCount,
+                              HIAHMachOTransformStats *stats, size_t *expectedLength) {
+    char path[512];
+    TestPath(path, sizeof(path), name);
+    TestWriteFile(path, bytes, length, 0755);
+
+    uint8_t *expected = malloc(length);
+    HIAH_CHECK(expected != NULL);
+    memcpy(expected, bytes, length);
+    *expectedLength = length;
+    HIAHMachOTransformStats bufferStats;
+    char error[256] = "";
+    HIAH_CHECK(HIAHMachOTransformBuffer(expected, expectedLength, edits, editCount, &bufferStats,
+                                        error, sizeof(error)));
+
+    HIAH_CHECK(HIAHMachOTransformFile(path, edits, editCount, stats, error, sizeof(error)));
+    HIAH_CHECK(TestFileEquals(path, expected, *expectedLength));
+    HIAH_CHECK_EQ(stats->length, *expectedLength);
+    HIAH_CHECK_EQ(stats->slicesChanged, bufferStats.slicesChanged);
+    HIAH_CHECK_EQ(stats->bytesTrimmed, bufferStats.bytesTrimmed);
+
+    // The replacement keeps the mode and leaves nothing behind
+    struct stat st;
+    HIAH_CHECK(stat(path, &st) == 0);
+    HIAH_CHECK_EQ(st.st_mode & 07777, 0755);
+    HIAH_CHECK_EQ(TestFileCount(), 1);
+    unlink(path);
+    return expected;
+}
+
+// MARK: - Header Edits
+
+static void TestEditsThin(void) {
+    size_t length = 0;
+    uint8_t *bytes = TestBuildBinary(1, 16 * TEST_PAGE, &length);
+    HIAHMachOTransformStats stats;
+    size_t expectedLength = 0;
+    uint8_t *expected = TestRoundTrip("edits-thin", bytes, length, TestHeaderEdits,
+                                      TEST_HEADER_EDIT_COUNT, &stats, &expectedLength);
+
+    HIAH_CHECK_EQ(stats.slices, 1);
+    HIAH_CHECK_EQ(stats.slicesChanged, 1);
+    HIAH_CHECK_EQ(stats.applied[HIAHMachOEditSetFileType], 1);
+    HIAH_CHECK_EQ(stats.applied[HIAHMachOEditRelocatePageZero], 1);
+    HIAH_CHECK_EQ(stats.applied[HIAHMachOEditAddLoadCommand], 1);
+    HIAH_CHECK_EQ(stats.bytesTrimmed, 0);
+    HIAH_CHECK_EQ(expectedLength, length);
+    TestCheckHeaderEdits(expected, bytes, length);
+
+    // Applied again, the edits find nothing left to do
+    size_t againLength = expectedLength;
+    uint8_t *again = malloc(againLength);
+    HIAH_CHECK(again != NULL);
+    memcpy(again, expected, againLength);
+    char error[256] = "";
+    HIAH_CHECK(HIAHMachOTransformBuffer(again, &againLength, TestHeaderEdits, TEST_HEADER_EDIT_COUNT,
+                                        &stats, error, sizeof(error)));
+    HIAH_CHECK_EQ(stats.slicesChanged, 0);
+    HIAH_CHECK(againLength == expectedLength && memcmp(again, expected, againLength) == 0);
+    free(again);
+    free(expected);
+    free(bytes);
+}
+
+static void TestEditsFat(void) {
+    size_t sliceSize = 12 * TEST_PAGE;
+    size_t length = 0;
+    uint8_t *bytes = TestBuildBinary(3, sliceSize, &length);
+    HIAHMachOTransformStats stats;
+    size_t expectedLength = 0;
+    uint8_t *expected = TestRoundTrip("edits-fat", bytes, length, TestHeaderEdits,
+                                      TEST_HEADER_EDIT_COUNT, &stats, &expectedLength);
+
+    HIAH_CHECK_EQ(stats.slices, 3);
+    HIAH_CHECK_EQ(stats.slicesChanged, 3);
+    for (int k = 0; k < (int)TEST_HEADER_EDIT_COUNT; k++) {
+        HIAH_CHECK_EQ(stats.applied[TestHeaderEdits[k].kind], 3);
+    }
+    HIAH_CHECK_EQ(expectedLength, length);
+
+    // The fat header and the slices stay where they were
+    HIAH_CHECK(memcmp(expected, bytes, TEST_PAGE) == 0);
+    for (uint32_t i = 0; i < 3; i++) {
+        size_t offset = TEST_PAGE + i * sliceSize;
+        TestCheckHeaderEdits(expected + offset, bytes + offset, sliceSize);
+    }
+    free(expected);
+    free(bytes);
+}
+
+static void TestFixture(void) {
+    size_t length = 0;
+    uint8_t *bytes = HIAHTestReadFixture("symbols-exec.macho", &length);
+    HIAHMachOTransformStats stats;
+    size_t expectedLength = 0;
+    uint8_t *expected = TestRoundTrip("fixture", bytes, length, TestEdits, 2, &stats,
+                                      &expectedLength);
+    HIAH_CHECK_EQ(stats.slicesChanged, 1);
+    HIAH_CHECK_EQ(expectedLength, length);
+
+    // Transformed again, nothing changes and the file is not replaced
+    char path[512];
+    TestPath(path, sizeof(path), "fixture");
+    TestWriteFile(path, expected, expectedLength, 0755);
+    ino_t inode = TestInode(path);
+    char error[256] = "";
+    HIAH_CHECK(HIAHMachOTransformFile(path, TestEdits, 2, &stats, error, sizeof(error)));
+    HIAH_CHECK_EQ(stats.slicesChanged, 0);
+    HIAH_CHECK_EQ(stats.bytesWritten, 0);
+    HIAH_CHECK_EQ(TestInode(path), inode);
+    HIAH_CHECK(TestFileEquals(path, expected, expectedLength));
+    unlink(path);
+    free(expected);
+    free(bytes);
+}
+
+static void TestFailureLeavesFile(void) {
+    size_t length = 0;
+    uint8_t *bytes = TestBuildBinary(2, 8 * TEST_PAGE, &length);
+    char path[512];
+    TestPath(path, sizeof(path), "failure");
+    TestWriteFile(path, bytes, length, 0755);
+    ino_t inode = TestInode(path);
+
+    // A load command that cannot fit before the first section, after edits
+    // that would have applied
+    static uint8_t command[2 * TEST_PAGE];
+    uint32_t header[2] = {0x80000028u, sizeof(command)};    // LC_MAIN
+    memcpy(command, header, sizeof(header));
+    HIAHMachOEdit edits[TEST_EDIT_COUNT + 1];
+    memcpy(edits, TestEdits, sizeof(TestEdits));
+    edits[TEST_EDIT_COUNT] = (HIAHMachOEdit){
+        .kind = HIAHMachOEditAddLoadCommand, .command = command, .commandSize = sizeof(command)};
+    char error[256] = "";
+    HIAH_CHECK(!HIAHMachOTransformFile(path, edits, TEST_EDIT_COUNT + 1, NULL, error, sizeof(error)));
+    HIAH_CHECK(error[0] != '\0');
+    HIAH_CHECK_EQ(TestInode(path), inode);
+    HIAH_CHECK(TestFileEquals(path, bytes, length));
+    HIAH_CHECK_EQ(TestFileCount(), 1);
+
+    // Not a Mach-O at all
+    memset(bytes, 0x5a, 64);
+    TestWriteFile(path, bytes, length, 0644);
+    HIAH_CHECK(!HIAHMachOTransformFile(path, TestEdits, TEST_EDIT_COUNT, NULL, error, sizeof(error)));
+    HIAH_CHECK(TestFileEquals(path, bytes, length));
+    HIAH_CHECK_EQ(TestFileCount(), 1);
+    unlink(path);
+
+    HIAH_CHECK(!HIAHMachOTransformFile(path, TestEdits, TEST_EDIT_COUNT, NULL, error, sizeof(error)));
+    free(bytes);
+}
+
+// MARK: - Fat Slices
+
+static void TestFat64(void) {
+    size_t sliceSize = 12 * TEST_PAGE;
+    size_t length = 0;
+    uint8_t *bytes = TestBuildFat(TEST_FAT_MAGIC_64, 3, sliceSize, &length);
+
+    HIAHMachOSliceRange *ranges = NULL;
+    uint32_t count = 0;
+    char error[256] = "";
+    HIAH_CHECK(HIAHMachOListSlices(bytes, length, &ranges, &count, error, sizeof(error)));
+    HIAH_CHECK_EQ(count, 3);
+    for (uint32_t i = 0; i < count; i++) {
+        HIAH_CHECK_EQ(ranges[i].offset, TEST_PAGE + i * sliceSize);
+        HIAH_CHECK_EQ(ranges[i].size, sliceSize);
+        HIAH_CHECK_EQ(ranges[i].cputype, i == 1 ? 0x01000007u : 0x0100000cu);
+    }
+    free(ranges);
+
+    // Header edits in place, as with FAT_MAGIC
+    HIAHMachOTransformStats stats;
+    size_t expectedLength = 0;
+    uint8_t *expected = TestRoundTrip("fat64-edits", bytes, length, TestHeaderEdits,
+                                      TEST_HEADER_EDIT_COUNT, &stats, &expectedLength);
+    HIAH_CHECK_EQ(stats.slicesChanged, 3);
+    HIAH_CHECK(memcmp(expected, bytes, TEST_PAGE) == 0);
+    for (uint32_t i = 0; i < 3; i++) {
+        size_t offset = TEST_PAGE + i * sliceSize;
+        TestCheckHeaderEdits(expected + offset, bytes + offset, sliceSize);
+    }
+    free(expected);
+
+    // Shortened slices move, and the 64-bit fat header follows them
+    expected = TestRoundTrip("fat64-trim", bytes, length, TestEdits, TEST_EDIT_COUNT, &stats,
+                             &expectedLength);
+    HIAH_CHECK_EQ(expectedLength, length - 3 * TEST_SIGNATURE);
+    HIAH_CHECK_EQ(TestRead32(expected), __builtin_bswap32(TEST_FAT_MAGIC_64));
+    HIAH_CHECK(HIAHMachOListSlices(expected, expectedLength, &ranges, &count, error, sizeof(error)));
+    HIAH_CHECK_EQ(count, 3);
+    for (uint32_t i = 0; i < count; i++) {
+        HIAH_CHECK_EQ(ranges[i].offset, TEST_PAGE + i * (sliceSize - TEST_SIGNATURE));
+        HIAH_CHECK_EQ(ranges[i].size, sliceSize - TEST_SIGNATURE);
+    }
+    free(ranges);
+    free(expected);
+    free(bytes);
+}
+
+static void TestParallelSlices(void) {
+    // Enough header space across slices (80 x 16 KB) to be edited by the
+    // worker pool rather than on this thread
+    const uint32_t slices = 80;
+    const size_t sliceSize = 4 * TEST_PAGE;
+    const uint32_t magics[] = {TEST_FAT_MAGIC, TEST_FAT_MAGIC_64};
+
+    for (size_t m = 0; m < sizeof(magics) / sizeof(magics[0]); m++) {
+        size_t length = 0;
+        uint8_t *bytes = TestBuildFat(magics[m], slices, sliceSize, &length);
+        HIAHMachOTransformStats stats;
+        size_t expectedLength = 0;
+        uint8_t *expected = TestRoundTrip("parallel", bytes, length, TestEdits, TEST_EDIT_COUNT,
+                                          &stats, &expectedLength);
+        HIAH_CHECK_EQ(stats.slices, slices);
+        HIAH_CHECK_EQ(stats.slicesChanged, slices);
+
+        // Each slice comes out as it would on its own, in its own place
+        HIAHMachOSliceRange *ranges = NULL;
+        uint32_t count = 0;
+        char error[256] = "";
+        HIAH_CHECK(HIAHMachOListSlices(expected, expectedLength, &ranges, &count, error,
+                                       sizeof(error)));
+        HIAH_CHECK_EQ(count, slices);
+        size_t firstOffset = ranges[0].offset;
+        uint8_t *thin = malloc(sliceSize);
+        HIAH_CHECK(thin != NULL);
+        for (uint32_t i = 0; i < count; i++) {
+            memcpy(thin, bytes + firstOffset + i * sliceSize, sliceSize);
+            size_t thinLength = sliceSize;
+            HIAH_CHECK(HIAHMachOTransformBuffer(thin, &thinLength, TestEdits, TEST_EDIT_COUNT, NULL,
+                                                error, sizeof(error)));
+            HIAH_CHECK_EQ(ranges[i].offset, firstOffset + i * thinLength);
+            HIAH_CHECK_EQ(ranges[i].size, thinLength);
+            HIAH_CHECK(memcmp(expected + ranges[i].offset, thin, thinLength) == 0);
+        }
+        free(thin);
+        free(ranges);
+
+        // And the same bytes every time
+        for (int run = 0; run < 4; run++) {
+            size_t againLength = length;
+            uint8_t *again = malloc(length);
+            HIAH_CHECK(again != NULL);
+            memcpy(again, bytes, length);
+            HIAH_CHECK(HIAHMachOTransformBuffer(again, &againLength, TestEdits, TEST_EDIT_COUNT,
+                                                NULL, error, sizeof(error)));
+            HIAH_CHECK(againLength == expectedLength && memcmp(again, expected, againLength) == 0);
+            free(again);
+        }
+        free(expected);
+        free(bytes);
+    }
+}
+
+// MARK: - Signature Trim
+
+/**
+ * Checks a slice built by TestBuildSlice() after TestTrimEdits: the
+ * signature command and data are gone, __LINKEDIT ends where the data
+ * did, and everything else is as it was.
+ */
+static void TestCheckTrimmed(const uint8_t *slice, const uint8_t *original, size_t size) {
+    HIAH_CHECK_EQ(TestRead32(slice + 12), HIAH_MACHO_FILETYPE_EXECUTE);
+    HIAH_CHECK_EQ(TestRead32(slice + 16), TestRead32(original + 16) - 1);
+    HIAH_CHECK_EQ(TestRead32(slice + 20), TestRead32(original + 20) - 16);
+
+    // __LINKEDIT follows __PAGEZERO and __TEXT
+    const uint8_t *linkedit = slice + 32 + 72 + 152;
+    HIAH_CHECK(memcmp(linkedit + 8, "__LINKEDIT", 10) == 0);
+    HIAH_CHECK_EQ(TestRead64(linkedit + 48), TestRead64(original + 32 + 224 + 48) - TEST_SIGNATURE);
+    HIAH_CHECK_EQ(TestRead64(linkedit + 32), TestRead64(original + 32 + 224 + 32) - TEST_SIGNATURE);
+
+    HIAH_CHECK(memcmp(slice + TEST_PAGE, original + TEST_PAGE, size - TEST_PAGE - TEST_SIGNATURE) == 0);
+}
+
+static void TestTrimThin(void) {
+    size_t length = 0;
+    uint8_t *bytes = TestBuildBinary(1, 16 * TEST_PAGE, &length);
+    HIAHMachOTransformStats stats;
+    size_t expectedLength = 0;
+    uint8_t *expected = TestRoundTrip("trim-thin", bytes, length, TestTrimEdits, 1, &stats,
+                                      &expectedLength);
+
+    HIAH_CHECK_EQ(stats.slices, 1);
+    HIAH_CHECK_EQ(stats.applied[HIAHMachOEditRemoveSignature], 1);
+    HIAH_CHECK_EQ(stats.bytesTrimmed, TEST_SIGNATURE);
+    HIAH_CHECK_EQ(expectedLength, length - TEST_SIGNATURE);
+    TestCheckTrimmed(expected, bytes, length);
+    free(expected);
+    free(bytes);
+}
+
+static void TestTrimFat(void) {
+    size_t sliceSize = 12 * TEST_PAGE;
+    size_t length = 0;
+    uint8_t *bytes = TestBuildBinary(3, sliceSize, &length);
+    HIAHMachOTransformStats stats;
+    size_t expectedLength = 0;
+    uint8_t *expected = TestRoundTrip("trim-fat", bytes, length, TestTrimEdits, 1, &stats,
+                                      &expectedLength);
+
+    HIAH_CHECK_EQ(stats.slices, 3);
+    HIAH_CHECK_EQ(stats.slicesChanged, 3);
+    HIAH_CHECK_EQ(stats.bytesTrimmed, 3 * TEST_SIGNATURE);
+    HIAH_CHECK_EQ(expectedLength, length - 3 * TEST_SIGNATURE);
+
+    // Each slice moved down by the signatures before it, and the fat header
+    // says so
+    HIAHMachOSliceRange *ranges = NULL;
+    uint32_t count = 0;
+    char error[256] = "";
+    HIAH_CHECK(HIAHMachOListSlices(expected, expectedLength, &ranges, &count, error, sizeof(error)));
+    HIAH_CHECK_EQ(count, 3);
+    for (uint32_t i = 0; i < count; i++) {
+        size_t original = TEST_PAGE + i * sliceSize;
+        HIAH_CHECK_EQ(ranges[i].offset, original - i * TEST_SIGNATURE);
+        HIAH_CHECK_EQ(ranges[i].size, sliceSize - TEST_SIGNATURE);
+        TestCheckTrimmed(expected + ranges[i].offset, bytes + original, sliceSize);
+    }
+    free(ranges);
+
+    // Signature data that does not end its slice is left in place
+    TestBuildSlice(bytes + TEST_PAGE + sliceSize, sliceSize, 0x01000007, 1);
+    uint8_t *signature = bytes + TEST_PAGE + sliceSize + 32 + 224 + 72;
+    uint32_t dataoff = TestRead32(signature + 8) - TEST_PAGE;
+    memcpy(signature + 8, &dataoff, 4);
+    free(expected);
+    expected = TestRoundTrip("trim-inner", bytes, length, TestTrimEdits, 1, &stats, &expectedLength);
+    HIAH_CHECK_EQ(stats.slicesChanged, 3);
+    HIAH_CHECK_EQ(stats.bytesTrimmed, 2 * TEST_SIGNATURE);
+    free(expected);
+    free(bytes);
+}
+
+static void TestMappedImage(void) {
+    size_t length = 0;
+    uint8_t *bytes = TestBuildBinary(2, 8 * TEST_PAGE, &length);
+    char path[512];
+    TestPath(path, sizeof(path), "mapped");
+    TestWriteFile(path, bytes, length, 0755);
+
+    // As a loaded image would be: the edits must not show up in it
+    int fd = open(path, O_RDONLY);
+    HIAH_CHECK(fd >= 0);
+    uint8_t *mapped = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    HIAH_CHECK(mapped != MAP_FAILED);
+    close(fd);
+
+    char error[256] = "";
+    HIAHMachOTransformStats stats;
+    HIAH_CHECK(HIAHMachOTransformFile(path, TestEdits, TEST_EDIT_COUNT, &stats, error, sizeof(error)));
+    HIAH_CHECK_EQ(stats.slicesChanged, 2);
+    HIAH_CHECK(memcmp(mapped, bytes, length) == 0);
+    munmap(mapped, length);
+    unlink(path);
+    free(bytes);
+}
+
+static void TestCrash(void) {
+    const char *value = getenv("HIAH_STRESS_ITERATIONS");
+    int iterations = value && atoi(value) > 0 ? atoi(value) : 40;
+
+    // Big enough that moving the later slices takes a while
+    size_t length = 0;
+    uint8_t *bytes = TestBuildBinary(3, 1024 * TEST_PAGE, &length);
+    size_t expectedLength = length;
+    uint8_t *expected = malloc(length);
+    HIAH_CHECK(expected != NULL);
+    memcpy(expected, bytes, length);
+    char error[256] = "";
+    HIAH_CHECK(HIAHMachOTransformBuffer(expected, &expectedLength, TestEdits, TEST_EDIT_COUNT, NULL,
+                                        error, sizeof(error)));
+
+    char path[512];
+    TestPath(path, sizeof(path), "crash");
+
+    // Kills spread from right away to past the time one transform takes
+    TestWriteFile(path, bytes, length, 0755);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    HIAH_CHECK(HIAHMachOTransformFile(path, TestEdits, TEST_EDIT_COUNT, NULL, error, sizeof(error)));
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    HIAH_CHECK(TestFileEquals(path, expected, expectedLength));
+    long long duration = (end.tv_sec - start.tv_sec) * 1000000LL + (end.tv_nsec - start.tv_nsec) / 1000;
+
+    int original = 0, transformed = 0;
+    for (int i = 0; i < iterations; i++) {
+        TestWriteFile(path, bytes, length, 0755);
+        pid_t pid = fork();
+        HIAH_CHECK(pid >= 0);
+        if (pid == 0) {
+            _exit(HIAHMachOTransformFile(path, TestEdits, TEST_EDIT_COUNT, NULL, NULL, 0) ? 0 : 1);
+        }
+        usleep((useconds_t)(i * 2 * duration / iterations));
+        kill(pid, SIGKILL);
+        int status = 0;
+        HIAH_CHECK(waitpid(pid, &status, 0) == pid);
+        HIAH_CHECK(WIFSIGNALED(status) || WEXITSTATUS(status) == 0);
+
+        size_t fileLength = 0;
+        uint8_t *file = TestReadFile(path, &fileLength);
+        if (fileLength == length && memcmp(file, bytes, length) == 0) {
+            original++;
+        } else {
+            HIAH_CHECK_EQ(fileLength, expectedLength);
+            HIAH_CHECK(memcmp(file, expected, expectedLength) == 0);
+            transformed++;
+        }
+        free(file);
+        // A killed transform may leave its replacement; never the file
+        TestRemoveAll();
+    }
+    HIAH_CHECK(original > 0 && transformed > 0);
+    free(expected);
+    free(bytes);
+}
+
+int main(void) {
+    printf("HIAHMachOTransform\n");
+    const char *tmp = getenv("TMPDIR");
+    snprintf(TestDirectory, sizeof(TestDirectory), "%s/hiah-transform-XXXXXX", tmp && *tmp ? tmp : "/tmp");
+    HIAH_CHECK(mkdtemp(TestDirectory) != NULL);
+
+    HIAH_RUN_TEST(TestEditsThin);
+    HIAH_RUN_TEST(TestEditsFat);
+    HIAH_RUN_TEST(TestFixture);
+    HIAH_RUN_TEST(TestFailureLeavesFile);
+    HIAH_RUN_TEST(TestFat64);
+    HIAH_RUN_TEST(TestParallelSlices);
+    HIAH_RUN_TEST(TestTrimThin);
+    HIAH_RUN_TEST(TestTrimFat);
+    HIAH_RUN_TEST(TestMappedImage);
+    HIAH_RUN_TEST(TestCrash);
+
+    TestRemoveAll();
+    rmdir(TestDirectory);
+    return 0;
+}
@@ -0,0 +1,266 @@
+/**
+ * HIAHProcessTableTests.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Host tests for the sharded virtual process table.
+ *
+ * Values are small reference-counted records, so every test also checks
+ * that each retain handed out by the table is balanced once the table is
+ * gone. The concurrent test runs readers against a writer that keeps
+ * registering and removing in-process guests that all share one physical
+ * PID, the way the kernel registers extension-hosted processes.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHHostTest.h"
+#include "HIAHProcessTable.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+
+typedef struct {
+    pid_t pid;
+    _Atomic long references;
+} TestProcess;
+
+static _Atomic long gLiveReferences;
+
+static void *TestRetain(void *value) {
+    atomic_fetch_add(&((TestProcess *)value)->references, 1);
+    atomic_fetch_add(&gLiveReferences, 1);
+    return value;
+}
+
+static void TestRelease(void *value) {
+    atomic_fetch_sub(&((TestProcess *)value)->references, 1);
+    atomic_fetch_sub(&gLiveReferences, 1);
+}
+
+static const HIAHProcessTableCallbacks kTestCallbacks = {TestRetain, TestRelease};
+
+static HIAHProcessTableKey TestKey(pid_t pid, pid_t physicalPid) {
+    HIAHProcessTableKey key;
+    memset(&key, 0, sizeof(key));
+    key.pid = pid;
+    key.physicalPid = physicalPid;
+    return key;
+}
+
+static pid_t TestPhysicalLookup(HIAHProcessTable *table, pid_t physicalPid) {
+    TestProcess *process = HIAHProcessTableCopyValueForPhysicalPID(table, physicalPid);
+    if (!process) {
+        return 0;
+    }
+    pid_t pid = process->pid;
+    TestRelease(process);
+    return pid;
+}
+
+// MARK: - Tests
+
+static void TestInsertLookupRemove(void) {
+    HIAHProcessTable *table = HIAHProcessTableCreate(&kTestCallbacks, 1000);
+    TestProcess processes[3] = {{.pid = 1000}, {.pid = 1001}, {.pid = 1002}};
+
+    HIAHProcessTableKey key = TestKey(1000, 500);
+    HIAH_CHECK(HIAHProcessTableInsert(table, &key, &processes[0]));
+    key = TestKey(1001, -1);
+    key.hasRequestIdentifier = true;
+    memset(key.requestIdentifier, 0xab, sizeof(key.requestIdentifier));
+    HIAH_CHECK(HIAHProcessTableInsert(table, &key, &processes[1]));
+    key = TestKey(1002, 501);
+    HIAH_CHECK(HIAHProcessTableInsert(table, &key, &processes[2]));
+    HIAH_CHECK_EQ(HIAHProcessTableCount(table), 3);
+
+    TestProcess *found = HIAHProcessTableCopyValueForPID(table, 1001);
+    HIAH_CHECK(found == &processes[1]);
+    TestRelease(found);
+
+    uint8_t uuid[HIAH_PROCESS_TABLE_UUID_SIZE];
+    memset(uuid, 0xab, sizeof(uuid));
+    found = HIAHProcessTableCopyValueForRequestIdentifier(table, uuid);
+    HIAH_CHECK(found == &processes[1]);
+    TestRelease(found);
+
+    HIAH_CHECK_EQ(TestPhysicalLookup(table, 500), 1000);
+    HIAH_CHECK_EQ(TestPhysicalLookup(table, 501), 1002);
+    HIAH_CHECK_EQ(TestPhysicalLookup(table, 502), 0);
+    HIAH_CHECK(HIAHProcessTableCopyValueForPhysicalPID(table, -1) == NULL);
+
+    found = HIAHProcessTableRemove(table, 1002);
+    HIAH_CHECK(found == &processes[2]);
+    TestRelease(found);
+    HIAH_CHECK(HIAHProcessTableRemove(table, 1002) == NULL);
+    HIAH_CHECK_EQ(TestPhysicalLookup(table, 501), 0);
+    HIAH_CHECK_EQ(HIAHProcessTableCount(table), 2);
+
+    HIAHProcessTableDestroy(table);
+    HIAH_CHECK_EQ(atomic_load(&gLiveReferences), 0);
+}
+
+static void TestSharedPhysicalPID(void) {
+    enum { kCount = 4096 };
+    HIAHProcessTable *table = HIAHProcessTableCreate(&kTestCallbacks, 1);
+    TestProcess *processes = calloc(kCount, sizeof(TestProcess));
+
+    for (int i = 0; i < kCount; i++) {
+        processes[i].pid = HIAHProcessTableAllocatePID(table);
+        HIAHProcessTableKey key = TestKey(processes[i].pid, 4242);
+        HIAH_CHECK(HIAHProcessTableInsert(table, &key, &processes[i]));
+        HIAH_CHECK_EQ(TestPhysicalLookup(table, 4242), processes[i].pid);
+    }
+
+    // Removing older members keeps the newest; removing the newest falls back
+    for (int i = 0; i < kCount / 2; i++) {
+        TestRelease(HIAHProcessTableRemove(table, processes[i].pid));
+        HIAH_CHECK_EQ(TestPhysicalLookup(table, 4242), processes[kCount - 1].pid);
+    }
+    for (int i = kCount - 1; i >= kCount / 2; i--) {
+        HIAH_CHECK_EQ(TestPhysicalLookup(table, 4242), processes[i].pid);
+        TestRelease(HIAHProcessTableRemove(table, processes[i].pid));
+    }
+    HIAH_CHECK_EQ(TestPhysicalLookup(table, 4242), 0);
+    HIAH_CHECK_EQ(HIAHProcessTableCount(table), 0);
+
+    HIAHProcessTableDestroy(table);
+    HIAH_CHECK_EQ(atomic_load(&gLiveReferences), 0);
+    free(processes);
+}
+
+static void TestUpdateKeyMovesGroups(void) {
+    HIAHProcessTable *table = HIAHProcessTableCreate(&kTestCallbacks, 1);
+    TestProcess a = {.pid = 10}, b = {.pid = 11};
+
+    HIAHProcessTableKey key = TestKey(10, -1);
+    HIAH_CHECK(HIAHProcessTableInsert(table, &key, &a));
+    key = TestKey(11, 300);
+    HIAH_CHECK(HIAHProcessTableInsert(table, &key, &b));
+    HIAH_CHECK_EQ(TestPhysicalLookup(table, 300), 11);
+
+    // An unknown physical PID becomes known
+    key = TestKey(10, 300);
+    HIAH_CHECK(HIAHProcessTableUpdateKey(table, &key));
+    HIAH_CHECK_EQ(TestPhysicalLookup(table, 300), 11);
+
+    // The newest member leaves for a group of its own
+    key = TestKey(11, 301);
+    HIAH_CHECK(HIAHProcessTableUpdateKey(table, &key));
+    HIAH_CHECK_EQ(TestPhysicalLookup(table, 300), 10);
+    HIAH_CHECK_EQ(TestPhysicalLookup(table, 301), 11);
+
+    // Re-keying within the same group keeps the group
+    key = TestKey(10, 300);
+    key.hasRequestIdentifier = true;
+    memset(key.requestIdentifier, 7, sizeof(key.requestIdentifier));
+    HIAH_CHECK(HIAHProcessTableUpdateKey(table, &key));
+    HIAH_CHECK_EQ(TestPhysicalLookup(table, 300), 10);
+
+    // The last member leaves, emptying the group
+    key = TestKey(10, -1);
+    HIAH_CHECK(HIAHProcessTableUpdateKey(table, &key));
+    HIAH_CHECK_EQ(TestPhysicalLookup(table, 300), 0);
+
+    key = TestKey(99, 300);
+    HIAH_CHECK(!HIAHProcessTableUpdateKey(table, &key));
+
+    HIAHProcessTableDestroy(table);
+    HIAH_CHECK_EQ(atomic_load(&gLiveReferences), 0);
+}
+
+static void TestSnapshotOrder(void) {
+    HIAHProcessTable *table = HIAHProcessTableCreate(&kTestCallbacks, 1);
+    TestProcess processes[64];
+    for (int i = 63; i >= 0; i--) {
+        processes[i].pid = 100 + i;
+        atomic_init(&processes[i].references, 0);
+        HIAHProcessTableKey key = TestKey(processes[i].pid, 1 + i % 3);
+        HIAH_CHECK(HIAHProcessTableInsert(table, &key, &processes[i]));
+    }
+
+    HIAHProcessTableSnapshot snapshot;
+    HIAH_CHECK(HIAHProcessTableCopySnapshot(table, &snapshot));
+    HIAH_CHECK_EQ(snapshot.count, 64);
+    HIAH_CHECK_EQ(snapshot.generation & 1, 0);
+    for (size_t i = 0; i < snapshot.count; i++) {
+        HIAH_CHECK_EQ(snapshot.keys[i].pid, 100 + (pid_t)i);
+        HIAH_CHECK(snapshot.values[i] == &processes[i]);
+    }
+    HIAHProcessTableSnapshotFree(table, &snapshot);
+
+    HIAHProcessTableDestroy(table);
+    HIAH_CHECK_EQ(atomic_load(&gLiveReferences), 0);
+}
+
+// MARK: - Concurrency
+
+typedef struct {
+    HIAHProcessTable *table;
+    _Atomic bool stop;
+    _Atomic long lookups;
+} TestConcurrentState;
+
+static void *TestReaderThread(void *context) {
+    TestConcurrentState *state = context;
+    while (!atomic_load(&state->stop)) {
+        TestProcess *process = HIAHProcessTableCopyValueForPhysicalPID(state->table, 9000);
+        if (process) {
+            // The value must still be alive while we hold it
+            HIAH_CHECK(atomic_load(&process->references) > 0);
+            TestRelease(process);
+        }
+        HIAHProcessTableSnapshot snapshot;
+        HIAH_CHECK(HIAHProcessTableCopySnapshot(state->table, &snapshot));
+        for (size_t i = 1; i < snapshot.count; i++) {
+            HIAH_CHECK(snapshot.keys[i - 1].pid < snapshot.keys[i].pid);
+        }
+        HIAHProcessTableSnapshotFree(state->table, &snapshot);
+        atomic_fetch_add(&state->lookups, 1);
+    }
+    return NULL;
+}
+
+static void TestConcurrentReaders(void) {
+    enum { kReaders = 4, kSlots = 256, kRounds = 20000 };
+    TestConcurrentState state = {.table = HIAHProcessTableCreate(&kTestCallbacks, 1)};
+    TestProcess *processes = calloc(kSlots, sizeof(TestProcess));
+
+    pthread_t readers[kReaders];
+    for (int i = 0; i < kReaders; i++) {
+        HIAH_CHECK(pthread_create(&readers[i], NULL, TestReaderThread, &state) == 0);
+    }
+
+    for (int round = 0; round < kRounds; round++) {
+        TestProcess *process = &processes[round % kSlots];
+        if (process->pid) {
+            TestRelease(HIAHProcessTableRemove(state.table, process->pid));
+        }
+        process->pid = HIAHProcessTableAllocatePID(state.table);
+        HIAHProcessTableKey key = TestKey(process->pid, (round % 7) ? 9000 : 9001);
+        HIAH_CHECK(HIAHProcessTableInsert(state.table, &key, process));
+    }
+
+    atomic_store(&state.stop, true);
+    for (int i = 0; i < kReaders; i++) {
+        pthread_join(readers[i], NULL);
+    }
+    HIAH_CHECK_EQ(HIAHProcessTableCount(state.table), kSlots);
+    HIAH_CHECK(atomic_load(&state.lookups) > 0);
+
+    HIAHProcessTableDestroy(state.table);
+    HIAH_CHECK_EQ(atomic_load(&gLiveReferences), 0);
+    free(processes);
+}
+
+int main(void) {
+    printf("HIAHProcessTable\n");
+    HIAH_RUN_TEST(TestInsertLookupRemove);
+    HIAH_RUN_TEST(TestSharedPhysicalPID);
+    HIAH_RUN_TEST(TestUpdateKeyMovesGroups);
+    HIAH_RUN_TEST(TestSnapshotOrder);
+    HIAH_RUN_TEST(TestConcurrentReaders);
+    return 0;
+}
@@ -0,0 +1,209 @@
+/**
+ * HIAHSymbolIndexTests.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Host tests for the name → symbol pointer slot index.
+ *
+ * The fixtures (Fixtures/symbols.dylib and symbols-exec.macho, see
+ * generate_fixtures.py) are mapped the way dyld maps them, each segment at
+ * its address relative to __TEXT, and indexed in place. Both import
+ * _posix_spawn through __got[0] and __la_symbol_ptr[0], _waitpid through
+ * __got[2] and _execve through __la_symbol_ptr[1]; every other slot is
+ * local, absolute, out of range or unnamed.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHHostTest.h"
+#include "HIAHSymbolIndex.h"
+#include <string.h>
+
+#define TEST_LC_SEGMENT_64  0x19u
+#define TEST_LC_DYSYMTAB    0xbu
+#define TEST_PAGE           0x1000u
+
+typedef struct {
+    uint8_t *base;     // __TEXT, where the header lands
+    size_t size;
+} TestImage;
+
+static uint32_t TestRead32(const uint8_t *p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t TestRead64(const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static void TestWrite32(uint8_t *p, uint32_t value) {
+    memcpy(p, &value, sizeof(value));
+}
+
+/**
+ * @return The first load command of type `cmd`, or NULL
+ */
+static uint8_t *TestFindCommand(uint8_t *header, uint32_t cmd) {
+    uint8_t *cursor = header + 32;
+    for (uint32_t i = 0; i < TestRead32(header + 16); i++) {
+        if (TestRead32(cursor) == cmd) {
+            return cursor;
+        }
+        cursor += TestRead32(cursor + 4);
+    }
+    return NULL;
+}
+
+/**
+ * Maps every segment from __TEXT up at its offset from __TEXT's address.
+ */
+static TestImage TestMapFixture(const char *name) {
+    size_t fileSize = 0;
+    uint8_t *file = HIAHTestReadFixture(name, &fileSize);
+
+    uint64_t text = UINT64_MAX, end = 0;
+    uint8_t *cursor = file + 32;
+    for (uint32_t i = 0; i < TestRead32(file + 16); i++) {
+        if (TestRead32(cursor) == TEST_LC_SEGMENT_64) {
+            uint64_t vmaddr = TestRead64(cursor + 24), vmsize = TestRead64(cursor + 32);
+            if (memcmp(cursor + 8, "__TEXT", 7) == 0) {
+                text = vmaddr;
+            }
+            if (vmaddr + vmsize > end) {
+                end = vmaddr + vmsize;
+            }
+        }
+        cursor += TestRead32(cursor + 4);
+    }
+    HIAH_CHECK(text != UINT64_MAX);
+
+    TestImage image = {calloc(1, (size_t)(end - text)), (size_t)(end - text)};
+    HIAH_CHECK(image.base != NULL);
+    cursor = file + 32;
+    for (uint32_t i = 0; i < TestRead32(file + 16); i++) {
+        if (TestRead32(cursor) == TEST_LC_SEGMENT_64 && TestRead64(cursor + 24) >= text) {
+            uint64_t fileoff = TestRead64(cursor + 40), filesize = TestRead64(cursor + 48);
+            HIAH_CHECK(fileoff + filesize <= fileSize);
+            memcpy(image.base + (TestRead64(cursor + 24) - text), file + fileoff, (size_t)filesize);
+        }
+        cursor += TestRead32(cursor + 4);
+    }
+    free(file);
+    return image;
+}
+
+static void **TestSlot(const TestImage *image, uint32_t page, uint32_t index) {
+    return (void **)(image->base + page * TEST_PAGE) + index;
+}
+
+/**
+ * Checks the fixture's imports. `lazyPage` is the page of __la_symbol_ptr
+ * relative to __TEXT.
+ */
+static void TestCheckImports(const TestImage *image, uint32_t lazyPage) {
+    HIAHSymbolIndex *index = HIAHSymbolIndexCreate(image->base);
+    HIAH_CHECK(index != NULL);
+    HIAH_CHECK(HIAHSymbolIndexImage(index) == image->base);
+    HIAH_CHECK_EQ(HIAHSymbolIndexCount(index), 4);
+
+    size_t count = 0;
+    const HIAHSymbolSlot *slots = HIAHSymbolIndexFind(index, "posix_spawn", &count);
+    HIAH_CHECK_EQ(count, 2);
+    HIAH_CHECK(slots[0].address == TestSlot(image, 1, 0));
+    HIAH_CHECK(slots[1].address == TestSlot(image, lazyPage, 0));
+
+    slots = HIAHSymbolIndexFind(index, "waitpid", &count);
+    HIAH_CHECK_EQ(count, 1);
+    HIAH_CHECK(slots[0].address == TestSlot(image, 1, 2));
+
+    slots = HIAHSymbolIndexFind(index, "execve", &count);
+    HIAH_CHECK_EQ(count, 1);
+    HIAH_CHECK(slots[0].address == TestSlot(image, lazyPage, 1));
+
+    // Declared but only reached through local, absolute or bad entries
+    HIAH_CHECK(HIAHSymbolIndexFind(index, "unused", &count) == NULL);
+    HIAH_CHECK_EQ(count, 0);
+    HIAH_CHECK(HIAHSymbolIndexFind(index, "_posix_spawn", &count) == NULL);
+    HIAH_CHECK(HIAHSymbolIndexFind(index, "posix_spaw", &count) == NULL);
+    HIAH_CHECK(HIAHSymbolIndexFind(index, "", &count) == NULL);
+
+    HIAHSymbolIndexDestroy(index);
+}
+
+// MARK: - Tests
+
+static void TestDylibSlots(void) {
+    TestImage image = TestMapFixture("symbols.dylib");
+    TestCheckImports(&image, 2);
+    free(image.base);
+}
+
+static void TestExecutableSlide(void) {
+    // __TEXT at 0x100000000 and __LINKEDIT two pages past its file offset
+    TestImage image = TestMapFixture("symbols-exec.macho");
+    TestCheckImports(&image, 2);
+    free(image.base);
+}
+
+static void TestIndirectTableBounds(void) {
+    TestImage image = TestMapFixture("symbols.dylib");
+    uint8_t *dysymtab = TestFindCommand(image.base, TEST_LC_DYSYMTAB);
+    HIAH_CHECK(dysymtab != NULL);
+
+    // Only __got[0..1] remain covered: one import, one local
+    TestWrite32(dysymtab + 60, 2);
+    HIAHSymbolIndex *index = HIAHSymbolIndexCreate(image.base);
+    HIAH_CHECK(index != NULL);
+    HIAH_CHECK_EQ(HIAHSymbolIndexCount(index), 1);
+    size_t count = 0;
+    HIAH_CHECK(HIAHSymbolIndexFind(index, "posix_spawn", &count) != NULL);
+    HIAH_CHECK_EQ(count, 1);
+    HIAH_CHECK(HIAHSymbolIndexFind(index, "waitpid", &count) == NULL);
+    HIAHSymbolIndexDestroy(index);
+    free(image.base);
+}
+
+static void TestWithoutDysymtab(void) {
+    TestImage image = TestMapFixture("symbols.dylib");
+    TestWrite32(TestFindCommand(image.base, TEST_LC_DYSYMTAB), 0x7fffffff);
+
+    HIAHSymbolIndex *index = HIAHSymbolIndexCreate(image.base);
+    HIAH_CHECK(index != NULL);
+    HIAH_CHECK_EQ(HIAHSymbolIndexCount(index), 0);
+    size_t count = 1;
+    HIAH_CHECK(HIAHSymbolIndexFind(index, "posix_spawn", &count) == NULL);
+    HIAH_CHECK_EQ(count, 0);
+    HIAHSymbolIndexDestroy(index);
+    free(image.base);
+}
+
+static void TestMalformed(void) {
+    HIAH_CHECK(HIAHSymbolIndexCreate(NULL) == NULL);
+
+    TestImage image = TestMapFixture("symbols.dylib");
+    TestWrite32(image.base, 0xcafebabe);
+    HIAH_CHECK(HIAHSymbolIndexCreate(image.base) == NULL);
+    free(image.base);
+
+    // A load command too short to step over
+    image = TestMapFixture("symbols.dylib");
+    TestWrite32(image.base + 32 + 4, 0);
+    HIAH_CHECK(HIAHSymbolIndexCreate(image.base) == NULL);
+    free(image.base);
+}
+
+int main(void) {
+    printf("HIAHSymbolIndex\n");
+    HIAH_RUN_TEST(TestDylibSlots);
+    HIAH_RUN_TEST(TestExecutableSlide);
+    HIAH_RUN_TEST(TestIndirectTableBounds);
+    HIAH_RUN_TEST(TestWithoutDysymtab);
+    HIAH_RUN_TEST(TestMalformed);
+    return 0;
+}
@@ -222,27 +222,12 @@
             [self log:@"Set executable permissions (0755)"];
         }
         
-        // Verify it's a valid Mach-O binary
-        NSData *headerData = [[NSFileManager defaultManager] contentsOfFile:execPath];
-        if (headerData.length < 4) {
-            [self log:@"ERROR: Executable is too small to be a valid binary"];
-            [[NSFileManager defaultManager] removeItemAtPath:destPath error:nil];
-            [[NSFileManager defaultManager] removeItemAtPath:tempDir error:nil];
-            dispatch_async(dispatch_get_main_queue(), ^{
-                self.statusLabel.text = @"Invalid executable binary";
-                self.browseButton.enabled = YES;
-            });
-            return;
-        }
-        
-        uint32_t magic = *(uint32_t *)[headerData bytes];
-        const uint32_t MH_MAGIC_64 = 0xfeedfacf;
-        const uint32_t MH_CIGAM_64 = 0xcffaedfe;
-        const uint32_t FAT_MAGIC = 0xcafebabe;
-        const uint32_t FAT_CIGAM = 0xbebafeca;
-        
-        if (magic != MH_MAGIC_64 && magic != MH_CIGAM_64 && magic != FAT_MAGIC && magic != FAT_CIGAM) {
-            [self log:[NSString stringWithFormat:@"ERROR: Not a valid Mach-O binary (magic: 0x%08x)", magic]];
+        // Verify it's a valid Mach-O binary. This reads only its headers and
+        // records them in the Mach-O index, which the app list and launches
+        // are served from.
+        NSDictionary *binaryInfo = [HIAHMachOUtils indexedInfoForBinary:execPath];
+        if (!binaryInfo) {
+            [self log:@"ERROR: Not a valid Mach-O binary (no 64-bit slice)"];
             [[NSFileManager defaultManager] removeItemAtPath:destPath error:nil];
             [[NSFileManager defaultManager] removeItemAtPath:tempDir error:nil];
             dispatch_async(dispatch_get_main_queue(), ^{
@@ -276,6 +261,10 @@
             }
         }
         
+        // Index the installed binary so the app list and launches never
+        // have to open it
+        [HIAHMachOUtils indexBinary:execPath];
+        
         // IMPORTANT: We DON'T remove or resign here
         // The ProcessRunner extension will handle signing when loading
         // This allows the extension to use its own certificate/provisioning
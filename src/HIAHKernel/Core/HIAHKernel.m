@@ -9,14 +9,25 @@
  */
 
 #import "HIAHKernel.h"
+#import "HIAHChildRegistry.h"
+#import "HIAHControlEnvironment.h"
+#import "HIAHControlProtocol.h"
+#import "HIAHControlServer.h"
+#import "HIAHHookMetrics.h"
+#import "HIAHImagePool.h"
 #import "HIAHLogging.h"
 #import "HIAHMachOUtils.h"
+#import "HIAHOutputChannel.h"
+#import "HIAHPatchedImageCache.h"
+#import "HIAHProcessTable.h"
+#import "HIAHSpawnTrace.h"
 #import <CoreFoundation/CoreFoundation.h>
 #import <Foundation/Foundation.h>
-#import <dlfcn.h>
 #import <errno.h>
-#import <sys/socket.h>
-#import <sys/un.h>
+#import <os/lock.h>
+#import <signal.h>
+#import <sys/uio.h>
+#import <sys/wait.h>
 #import <unistd.h>
 
 // Callback for extension started notifications
@@ -88,21 +99,359 @@ NSNotificationName const HIAHKernelProcessOutputNotification =
     @"HIAHKernelProcessOutput";
 NSErrorDomain const HIAHKernelErrorDomain = @"HIAHKernelErrorDomain";
 
+// Process table value callbacks: entries hold a +1 on the HIAHProcess
+static void *HIAHKernelProcessRetain(void *value) {
+  return (void *)CFRetain((CFTypeRef)value);
+}
+
+static void HIAHKernelProcessRelease(void *value) { CFRelease((CFTypeRef)value); }
+
+// Forwarded children are recorded under their requester's negated physical
+// PID, so it is never taken for one of the kernel's own PIDs
+static inline pid_t HIAHKernelForwardedParent(pid_t physicalPid) {
+  return -physicalPid;
+}
+
+static HIAHProcessTableKey HIAHKernelTableKeyForProcess(HIAHProcess *process) {
+  HIAHProcessTableKey key;
+  memset(&key, 0, sizeof(key));
+  key.pid = process.pid;
+  key.physicalPid = process.physicalPid;
+  if (process.requestIdentifier) {
+    key.hasRequestIdentifier = true;
+    [process.requestIdentifier getUUIDBytes:key.requestIdentifier];
+  }
+  return key;
+}
+
 @interface HIAHKernel ()
-@property(nonatomic, strong)
-    NSMutableDictionary<NSNumber *, HIAHProcess *> *processTable;
-@property(nonatomic, strong) NSRecursiveLock *lock;
+@property(nonatomic, assign) HIAHProcessTable *processTable;
 @property(nonatomic, strong) NSMutableArray *activeExtensions;
-@property(nonatomic, assign) int controlSocket;
+@property(nonatomic, assign) HIAHControlServer *controlServer;
+@property(nonatomic, assign)
+    HIAHControlEnvironmentStore *environmentStore; // Guests' base environments
 @property(nonatomic, copy, readwrite) NSString *controlSocketPath;
 @property(nonatomic, assign) BOOL isShuttingDown;
 @property(nonatomic, strong)
     NSString *socketDirectory; // Cached socket directory
 @property(nonatomic, strong)
     NSXPCListener *xpcListener; // XPC listener for extension communication
-@property(nonatomic, assign) pid_t nextVirtualPid;
+@property(nonatomic, copy)
+    void (^outputRelay)(HIAHProcess *process); // Default output consumer
+@property(nonatomic, strong)
+    HIAHPatchedImageCache *patchedImageCache; // Patched MH_EXECUTE guests
+@property(nonatomic, strong) NSMutableDictionary<NSNumber *, NSMutableArray *>
+    *controlWaiters; // Parked "wait" requests by pid
+@property(nonatomic, strong) NSMutableDictionary<NSNumber *, NSMutableArray *>
+    *controlChildWaiters; // Parked any-child "wait" requests by parent
+@property(nonatomic, assign)
+    HIAHChildRegistry *forwardedChildren; // Guarded by controlWaiters
+- (void)handleControlMessage:(NSData *)message
+                     request:(HIAHControlRequest)request;
+- (void)relayOutputOfProcess:(HIAHProcess *)process;
+- (void)spawnVirtualProcessWithPath:(NSString *)path
+                          arguments:(NSArray<NSString *> *)arguments
+                        environment:
+                            (NSDictionary<NSString *, NSString *> *)environment
+                 environmentEntries:(NSData *)environmentEntries
+                         completion:
+                             (void (^)(pid_t pid, NSError *error))completion;
 @end
 
+// Runs on the control server's reactor thread: copy the request out of the
+// connection buffer and handle it off-thread.
+static void HIAHKernelControlMessage(HIAHControlServer *server,
+                                     HIAHControlRequest request,
+                                     const uint8_t *message, size_t length,
+                                     void *context) {
+  HIAHKernel *kernel = (__bridge HIAHKernel *)context;
+  NSData *data = [NSData dataWithBytes:message length:length];
+  dispatch_async(
+      dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [kernel handleControlMessage:data request:request];
+      });
+}
+
+// Length of the longest prefix that does not end inside a UTF-8 sequence.
+static size_t HIAHKernelUTF8CompleteLength(const uint8_t *bytes,
+                                           size_t length) {
+  size_t continuation = 0;
+  for (size_t i = length; i > 0 && continuation < 4; i--) {
+    uint8_t c = bytes[i - 1];
+    if ((c & 0xC0) == 0x80) {
+      continuation++;
+      continue;
+    }
+    size_t needed = c < 0x80             ? 1
+                    : (c & 0xE0) == 0xC0 ? 2
+                    : (c & 0xF0) == 0xE0 ? 3
+                    : (c & 0xF8) == 0xF0 ? 4
+                                         : 1;
+    return continuation + 1 >= needed ? length : i - 1;
+  }
+  return length; // Not UTF-8; pass it through
+}
+
+// Hook metrics travel as {name, calls, nanoseconds, buckets, p50, p99}
+// dictionaries, so JSON clients can read them too.
+static NSArray *HIAHKernelHookMetricsArray(const HIAHHookMetric *metrics) {
+  NSMutableArray *hooks = [NSMutableArray array];
+  for (int h = 0; h < HIAHHookMetricCount; h++) {
+    const HIAHHookMetric *metric = &metrics[h];
+    if (metric->calls == 0) {
+      continue;
+    }
+    int used = HIAH_HOOK_METRIC_BUCKETS;
+    while (used > 0 && metric->buckets[used - 1] == 0) {
+      used--;
+    }
+    NSMutableArray *buckets = [NSMutableArray arrayWithCapacity:used];
+    for (int b = 0; b < used; b++) {
+      [buckets addObject:@(metric->buckets[b])];
+    }
+    [hooks addObject:@{
+      @"name" : @(HIAHHookMetricName((HIAHHookMetricID)h)),
+      @"calls" : @(metric->calls),
+      @"nanoseconds" : @(metric->nanoseconds),
+      @"buckets" : buckets,
+      @"p50" : @(HIAHHookMetricPercentile(metric, 50)),
+      @"p99" : @(HIAHHookMetricPercentile(metric, 99))
+    }];
+  }
+  return hooks;
+}
+
+static void HIAHKernelHookMetricsFromArray(NSArray *hooks,
+                                           HIAHHookMetric *metrics) {
+  memset(metrics, 0, sizeof(HIAHHookMetric) * HIAHHookMetricCount);
+  for (NSDictionary *hook in hooks) {
+    if (![hook isKindOfClass:[NSDictionary class]] ||
+        ![hook[@"name"] isKindOfClass:[NSString class]]) {
+      continue;
+    }
+    HIAHHookMetricID h = HIAHHookMetricForName([hook[@"name"] UTF8String]);
+    if (h == HIAHHookMetricCount) {
+      continue;
+    }
+    HIAHHookMetric metric = {0};
+    metric.calls = [hook[@"calls"] unsignedLongLongValue];
+    metric.nanoseconds = [hook[@"nanoseconds"] unsignedLongLongValue];
+    NSArray *buckets = hook[@"buckets"];
+    if ([buckets isKindOfClass:[NSArray class]]) {
+      for (NSUInteger b = 0;
+           b < buckets.count && b < HIAH_HOOK_METRIC_BUCKETS; b++) {
+        metric.buckets[b] = [buckets[b] unsignedLongLongValue];
+      }
+    }
+    HIAHHookMetricsAdd(&metrics[h], &metric);
+  }
+}
+
+// Takes ownership of a packed envp: the NSData frees it
+static NSData *HIAHKernelEnvironmentData(char **envp) {
+  if (!envp) {
+    return nil;
+  }
+  size_t count = 0;
+  while (envp[count]) {
+    count++;
+  }
+  return [NSData dataWithBytesNoCopy:envp
+                              length:(count + 1) * sizeof(char *)
+                        freeWhenDone:YES];
+}
+
+// Binary requests are decoded straight from the frame into the same shape as
+// the JSON ones, so both framings share processControlRequest:request:.
+// Environment deltas are resolved against `store` here, while the strings
+// are still in the frame. The environment stays the packed envp it was
+// built as (`envp`), rather than the dictionary JSON requests carry (`env`).
+static NSDictionary *
+HIAHKernelDecodeBinaryRequest(NSData *message,
+                              HIAHControlEnvironmentStore *store) {
+  HIAHControlReader reader;
+  HIAHControlMessageType type;
+  if (!HIAHControlReaderInit(&reader, message.bytes, message.length, &type)) {
+    return nil;
+  }
+
+  NSMutableDictionary *req = [NSMutableDictionary dictionary];
+  switch (type) {
+  case HIAHControlMessageSpawn:
+    req[@"command"] = @"spawn";
+    break;
+  case HIAHControlMessageList:
+    req[@"command"] = @"list";
+    break;
+  case HIAHControlMessageHookMetrics:
+    req[@"command"] = @"hook-metrics";
+    break;
+  case HIAHControlMessageWait:
+    req[@"command"] = @"wait";
+    break;
+  case HIAHControlMessageSignal:
+    req[@"command"] = @"signal";
+    break;
+  case HIAHControlMessageEnvironment:
+    req[@"command"] = @"environment";
+    break;
+  default:
+    req[@"command"] = [NSString stringWithFormat:@"#%d", type];
+    break;
+  }
+
+  HIAHHookMetric hooks[HIAHHookMetricCount] = {0};
+  BOOL hasHooks = NO;
+  const char **envEntries = NULL, **envRemoved = NULL;
+  size_t envCount = 0, envRemovedCount = 0;
+  uint64_t envHandle = 0;
+  HIAHControlField field;
+  int status;
+  while ((status = HIAHControlReaderNext(&reader, &field)) == 1) {
+    switch (field.tag) {
+    case HIAHControlFieldPid:
+      req[@"pid"] = @(HIAHControlFieldInt(&field));
+      break;
+    case HIAHControlFieldRequestID:
+      req[@"requestID"] = @((uint64_t)HIAHControlFieldInt(&field));
+      break;
+    case HIAHControlFieldSignal:
+      req[@"signal"] = @(HIAHControlFieldInt(&field));
+      break;
+    case HIAHControlFieldOptions:
+      req[@"options"] = @(HIAHControlFieldInt(&field));
+      break;
+    case HIAHControlFieldParent:
+      req[@"parent"] = @(HIAHControlFieldInt(&field));
+      break;
+    case HIAHControlFieldHookMetric:
+      if (!HIAHHookMetricsDecode(&field, hooks)) {
+        free(envEntries);
+        free(envRemoved);
+        return nil;
+      }
+      hasHooks = YES;
+      break;
+    case HIAHControlFieldPath: {
+      const char *path = HIAHControlFieldString(&field, NULL);
+      if (path) {
+        req[@"path"] = [NSString stringWithUTF8String:path];
+      }
+      break;
+    }
+    case HIAHControlFieldArguments: {
+      NSMutableArray *args = [NSMutableArray
+          arrayWithCapacity:HIAHControlFieldStringCount(&field)];
+      HIAHControlStringIterator it;
+      HIAHControlFieldStrings(&field, &it);
+      const char *arg;
+      while ((arg = HIAHControlStringIteratorNext(&it, NULL))) {
+        [args addObject:[NSString stringWithUTF8String:arg] ?: @""];
+      }
+      req[@"args"] = args;
+      break;
+    }
+    case HIAHControlFieldEnvironment:
+      free(envEntries);
+      envEntries = HIAHControlFieldCopyStrings(&field, &envCount);
+      break;
+    case HIAHControlFieldEnvRemoved:
+      free(envRemoved);
+      envRemoved = HIAHControlFieldCopyStrings(&field, &envRemovedCount);
+      break;
+    case HIAHControlFieldEnvHandle:
+      envHandle = (uint64_t)HIAHControlFieldInt(&field);
+      break;
+    default:
+      break;
+    }
+  }
+  if (hasHooks) {
+    req[@"hooks"] = HIAHKernelHookMetricsArray(hooks);
+  }
+
+  if (status == 0 && type == HIAHControlMessageEnvironment) {
+    uint64_t handle =
+        envEntries && store
+            ? HIAHControlEnvironmentStoreRegister(store, envEntries, envCount)
+            : 0;
+    if (handle) {
+      req[@"envHandle"] = @(handle);
+    }
+  } else if (status == 0 && envHandle) {
+    // A delta: envEntries holds the changed entries only
+    bool unknown = true;
+    char **envp =
+        store ? HIAHControlEnvironmentStoreBuild(
+                    store, envHandle, envEntries, envEntries ? envCount : 0,
+                    envRemoved, envRemoved ? envRemovedCount : 0, &unknown)
+              : NULL;
+    if (envp) {
+      req[@"envp"] = HIAHKernelEnvironmentData(envp);
+    } else {
+      req[unknown ? @"envUnknown" : @"envFailed"] = @YES;
+    }
+  } else if (status == 0 && envEntries) {
+    // The entries point into the frame, which is gone once this returns
+    char **envp = HIAHControlEnvironmentPack(envEntries, envCount, NULL);
+    if (envp) {
+      req[@"envp"] = HIAHKernelEnvironmentData(envp);
+    } else {
+      req[@"envFailed"] = @YES;
+    }
+  }
+  free(envEntries);
+  free(envRemoved);
+  return status == 0 ? req : nil;
+}
+
+static void HIAHKernelEncodeBinaryReply(NSDictionary *resp,
+                                        HIAHControlWriter *writer) {
+  HIAHControlWriterInit(writer, HIAHControlMessageReply);
+  NSString *status = resp[@"status"];
+  HIAHControlWriterAddInt(
+      writer, HIAHControlFieldStatus,
+      [status isEqualToString:@"ok"] ? HIAHControlStatusOK
+      : [status isEqualToString:@"unknown-environment"]
+          ? HIAHControlStatusUnknownEnvironment
+      : [status isEqualToString:@"no-child"] ? HIAHControlStatusNoChild
+                                              : HIAHControlStatusError);
+  if (resp[@"error"]) {
+    HIAHControlWriterAddString(writer, HIAHControlFieldError,
+                               [resp[@"error"] UTF8String]);
+  }
+  if (resp[@"pid"]) {
+    HIAHControlWriterAddInt(writer, HIAHControlFieldPid,
+                            [resp[@"pid"] intValue]);
+  }
+  if (resp[@"exitCode"]) {
+    HIAHControlWriterAddInt(writer, HIAHControlFieldExitCode,
+                            [resp[@"exitCode"] intValue]);
+  }
+  if (resp[@"envHandle"]) {
+    HIAHControlWriterAddInt(writer, HIAHControlFieldEnvHandle,
+                            [resp[@"envHandle"] longLongValue]);
+  }
+  for (NSDictionary *proc in resp[@"processes"]) {
+    size_t mark =
+        HIAHControlWriterBeginMessage(writer, HIAHControlFieldProcess);
+    HIAHControlWriterAddInt(writer, HIAHControlFieldPid,
+                            [proc[@"pid"] intValue]);
+    HIAHControlWriterAddString(writer, HIAHControlFieldPath,
+                               [proc[@"path"] UTF8String]);
+    HIAHControlWriterAddInt(writer, HIAHControlFieldExited,
+                            [proc[@"exited"] boolValue]);
+    HIAHControlWriterAddInt(writer, HIAHControlFieldExitCode,
+                            [proc[@"exitCode"] intValue]);
+    HIAHControlWriterEndMessage(writer, mark);
+  }
+  if (resp[@"hooks"]) {
+    HIAHHookMetric hooks[HIAHHookMetricCount];
+    HIAHKernelHookMetricsFromArray(resp[@"hooks"], hooks);
+    HIAHHookMetricsEncode(writer, hooks);
+  }
+}
+
 @implementation HIAHKernel
 
 #pragma mark - Singleton
@@ -121,16 +470,33 @@ NSErrorDomain const HIAHKernelErrorDomain = @"HIAHKernelErrorDomain";
 - (instancetype)init {
   self = [super init];
   if (self) {
-    _processTable = [NSMutableDictionary dictionary];
-    _lock = [[NSRecursiveLock alloc] init];
+    // Start virtual PIDs at 1000
+    HIAHProcessTableCallbacks callbacks = {HIAHKernelProcessRetain,
+                                           HIAHKernelProcessRelease};
+    _processTable = HIAHProcessTableCreate(&callbacks, 1000);
     _activeExtensions = [NSMutableArray array];
-    _controlSocket = -1;
+    _controlWaiters = [NSMutableDictionary dictionary];
+    _controlChildWaiters = [NSMutableDictionary dictionary];
+    // Every entry is external; the first PID is never handed out
+    _forwardedChildren = HIAHChildRegistryCreate(INT32_MAX, NULL, NULL);
+    HIAHChildRegistryTrackExternal(_forwardedChildren, true);
+    _environmentStore = HIAHControlEnvironmentStoreCreate(0);
     _isShuttingDown = NO;
-    _nextVirtualPid = 1000; // Start virtual PIDs at 1000
+
+    __weak HIAHKernel *weakSelf = self;
+    _outputRelay = ^(HIAHProcess *process) {
+      [weakSelf relayOutputOfProcess:process];
+    };
 
     // Default configuration
     _appGroupIdentifier = @"group.com.aspauldingcode.HIAH";
     _extensionIdentifier = @"com.aspauldingcode.HIAHDesktop.ProcessRunner";
+    _patchedImageCache = [[HIAHPatchedImageCache alloc] init];
+
+    // Warm the image pool with the tools the host app declares
+    self.imagePreloadManifestPath =
+        [[NSBundle mainBundle] pathForResource:@"HIAHPreload"
+                                        ofType:@"manifest"];
 
     // Listen for extension started notifications (Darwin notifications)
     // This allows us to enable JIT immediately when an extension process starts
@@ -154,6 +520,25 @@ NSErrorDomain const HIAHKernelErrorDomain = @"HIAHKernelErrorDomain";
 
 - (void)dealloc {
   [self shutdown];
+  HIAHControlServerDestroy(_controlServer);
+  _controlServer = NULL;
+  HIAHProcessTableDestroy(_processTable);
+  _processTable = NULL;
+  HIAHControlEnvironmentStoreDestroy(_environmentStore);
+  _environmentStore = NULL;
+  HIAHChildRegistryDestroy(_forwardedChildren);
+  _forwardedChildren = NULL;
+}
+
+#pragma mark - Configuration
+
+- (unsigned long long)patchedImageCacheBudget {
+  return self.patchedImageCache.budget;
+}
+
+- (void)setPatchedImageCacheBudget:(unsigned long long)budget {
+  self.patchedImageCache.budget = budget;
+  [self.patchedImageCache trim];
 }
 
 #pragma mark - Control Socket
@@ -172,87 +557,118 @@ NSErrorDomain const HIAHKernelErrorDomain = @"HIAHKernelErrorDomain";
       [self.socketDirectory stringByAppendingPathComponent:socketName];
   NSLog(@"[HIAHKernel] Control socket: %@", self.controlSocketPath);
 
-  int serverSock = socket(AF_UNIX, SOCK_STREAM, 0);
-  if (serverSock < 0) {
-    NSLog(@"[HIAHKernel] Failed to create control socket: %s", strerror(errno));
+  // All clients are served by one kqueue reactor thread; request handling
+  // itself runs on a global queue so a slow spawn never stalls the socket.
+  HIAHControlServerConfig config = {0};
+  int err = 0;
+  HIAHControlServer *server = HIAHControlServerCreate(
+      [self.controlSocketPath fileSystemRepresentation], &config,
+      HIAHKernelControlMessage, (__bridge void *)self, &err);
+  if (!server) {
+    NSLog(@"[HIAHKernel] Failed to bind control socket at %@: %s",
+          self.controlSocketPath, strerror(err));
     return;
   }
-
-  struct sockaddr_un addr;
-  memset(&addr, 0, sizeof(addr));
-  addr.sun_family = AF_UNIX;
-
-  // Use absolute path instead of chdir (iOS device sandboxing)
-  const char *fullSocketPath = [self.controlSocketPath UTF8String];
-  if (strlen(fullSocketPath) >= sizeof(addr.sun_path)) {
-    NSLog(@"[HIAHKernel] Control socket path too long: %@",
-          self.controlSocketPath);
-    close(serverSock);
+  if (!HIAHControlServerStart(server)) {
+    NSLog(@"[HIAHKernel] Failed to start control socket server");
+    HIAHControlServerDestroy(server);
     return;
   }
 
-  strncpy(addr.sun_path, fullSocketPath, sizeof(addr.sun_path) - 1);
-  unlink(fullSocketPath); // Remove if exists
+  self.controlServer = server;
+  NSLog(@"[HIAHKernel] Control socket ready: %@", self.controlSocketPath);
+}
 
-  if (bind(serverSock, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
-    listen(serverSock, 5);
-    self.controlSocket = serverSock;
-    [self startControlSocketListener];
-    NSLog(@"[HIAHKernel] Control socket ready: %@", self.controlSocketPath);
+- (void)handleControlMessage:(NSData *)message
+                     request:(HIAHControlRequest)request {
+  id req;
+  if (request.protocolVersion > 0) {
+    req = HIAHKernelDecodeBinaryRequest(message, self.environmentStore);
   } else {
-    NSLog(@"[HIAHKernel] Failed to bind control socket at %@: %s",
-          self.controlSocketPath, strerror(errno));
-    close(serverSock);
+    NSError *err;
+    req = [NSJSONSerialization JSONObjectWithData:message
+                                          options:0
+                                            error:&err];
+  }
+  if (![req isKindOfClass:[NSDictionary class]]) {
+    [self sendControlReply:@{
+      @"status" : @"error",
+      @"error" : @"Malformed request"
+    }
+                   request:request];
+    return;
   }
+  // Multiplexed clients match replies by the ID they sent
+  request.requestID = [req[@"requestID"] unsignedLongLongValue];
+  [self processControlRequest:req request:request];
 }
 
-- (void)startControlSocketListener {
-  dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0), ^{
-    while (!self.isShuttingDown && self.controlSocket >= 0) {
-      int clientSock = accept(self.controlSocket, NULL, NULL);
-      if (clientSock >= 0) {
-        [self handleControlClient:clientSock];
+- (void)sendControlReply:(NSDictionary *)resp
+                 request:(HIAHControlRequest)request {
+  if (request.protocolVersion > 0) {
+    HIAHControlWriter writer;
+    HIAHKernelEncodeBinaryReply(resp, &writer);
+    if (request.requestID) {
+      HIAHControlWriterAddInt(&writer, HIAHControlFieldRequestID,
+                              (int64_t)request.requestID);
+    }
+    if (writer.failed) {
+      // Every request needs its reply, or later ones stay parked behind it
+      HIAHControlWriterFree(&writer);
+      HIAHControlWriterInit(&writer, HIAHControlMessageReply);
+      HIAHControlWriterAddInt(&writer, HIAHControlFieldStatus,
+                              HIAHControlStatusError);
+      HIAHControlWriterAddString(&writer, HIAHControlFieldError,
+                                 "Failed to encode reply");
+      if (request.requestID) {
+        HIAHControlWriterAddInt(&writer, HIAHControlFieldRequestID,
+                                (int64_t)request.requestID);
       }
     }
-  });
-}
+    // Out of memory even for that: an empty frame still answers it
+    HIAHControlServerReply(self.controlServer, request, writer.data,
+                           writer.failed ? 0 : writer.length);
+    HIAHControlWriterFree(&writer);
+    return;
+  }
 
-- (void)handleControlClient:(int)sock {
-  dispatch_async(
-      dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        NSMutableData *data = [NSMutableData data];
-        char buffer[1024];
-        ssize_t n;
-
-        while ((n = read(sock, buffer, sizeof(buffer))) > 0) {
-          [data appendBytes:buffer length:n];
-          // Simple newline-delimited JSON protocol
-          if (buffer[n - 1] == '\n') {
-            NSError *err;
-            NSDictionary *req = [NSJSONSerialization JSONObjectWithData:data
-                                                                options:0
-                                                                  error:&err];
-            if (req) {
-              [self processControlRequest:req socket:sock];
-            }
-            [data setLength:0];
-          }
-        }
-        close(sock);
-      });
+  NSData *respData = [NSJSONSerialization dataWithJSONObject:resp
+                                                     options:0
+                                                       error:nil];
+  if (!respData) {
+    respData = [@"{\"status\":\"error\",\"error\":\"Failed to encode reply\"}"
+        dataUsingEncoding:NSUTF8StringEncoding];
+  }
+  HIAHControlServerReply(self.controlServer, request, respData.bytes,
+                         respData.length);
 }
 
-- (void)processControlRequest:(NSDictionary *)req socket:(int)sock {
+- (void)processControlRequest:(NSDictionary *)req
+                      request:(HIAHControlRequest)request {
   NSString *command = req[@"command"];
 
   if ([command isEqualToString:@"spawn"]) {
+    if (req[@"envUnknown"] || req[@"envFailed"]) {
+      // Nothing was spawned; the guest resends the environment in full
+      [self sendControlReply:@{
+        @"status" : req[@"envUnknown"] ? @"unknown-environment" : @"error",
+        @"error" : req[@"envUnknown"] ? @"Unknown environment handle"
+                                      : @"Out of memory"
+      }
+                     request:request];
+      return;
+    }
     NSString *path = req[@"path"];
     NSArray *args = req[@"args"];
     NSDictionary *env = req[@"env"];
+    // Only binary requests carry one; JSON cannot produce NSData
+    NSData *envp = [req[@"envp"] isKindOfClass:[NSData class]] ? req[@"envp"]
+                                                               : nil;
 
     [self spawnVirtualProcessWithPath:path
                             arguments:args
                           environment:env
+                   environmentEntries:envp
                            completion:^(pid_t pid, NSError *error) {
                              NSDictionary *resp;
                              if (error) {
@@ -261,14 +677,14 @@ NSErrorDomain const HIAHKernelErrorDomain = @"HIAHKernelErrorDomain";
                                  @"error" : error.localizedDescription
                                };
                              } else {
+                               if (req[@"parent"]) {
+                                 [self recordForwardedChild:pid
+                                                     parent:[req[@"parent"]
+                                                                intValue]];
+                               }
                                resp = @{@"status" : @"ok", @"pid" : @(pid)};
                              }
-                             NSData *respData =
-                                 [NSJSONSerialization dataWithJSONObject:resp
-                                                                 options:0
-                                                                   error:nil];
-                             write(sock, respData.bytes, respData.length);
-                             write(sock, "\n", 1);
+                             [self sendControlReply:resp request:request];
                            }];
   } else if ([command isEqualToString:@"list"]) {
     NSArray *procs = [self allProcesses];
@@ -281,21 +697,271 @@ NSErrorDomain const HIAHKernelErrorDomain = @"HIAHKernelErrorDomain";
         @"exitCode" : @(p.exitCode)
       }];
     }
-    NSDictionary *resp = @{@"status" : @"ok", @"processes" : procList};
-    NSData *respData = [NSJSONSerialization dataWithJSONObject:resp
-                                                       options:0
-                                                         error:nil];
-    write(sock, respData.bytes, respData.length);
-    write(sock, "\n", 1);
+    [self sendControlReply:@{@"status" : @"ok", @"processes" : procList}
+                   request:request];
+  } else if ([command isEqualToString:@"hook-metrics"]) {
+    [self handleHookMetricsRequest:req request:request];
+  } else if ([command isEqualToString:@"environment"]) {
+    // Registered while decoding; only the handle is left to send
+    [self sendControlReply:req[@"envHandle"]
+                               ? @{
+                                   @"status" : @"ok",
+                                   @"envHandle" : req[@"envHandle"]
+                                 }
+                               : @{
+                                   @"status" : @"error",
+                                   @"error" : @"Cannot register environment"
+                                 }
+                   request:request];
+  } else if ([command isEqualToString:@"wait"]) {
+    [self handleWaitRequest:req request:request];
+  } else if ([command isEqualToString:@"signal"]) {
+    [self handleSignalRequest:req request:request];
+  } else {
+    // Every request gets exactly one reply, or the client would hang
+    [self sendControlReply:@{
+      @"status" : @"error",
+      @"error" : [NSString
+          stringWithFormat:@"Unknown command: %@", command ?: @"(none)"]
+    }
+                   request:request];
   }
 }
 
+#pragma mark - Wait and Signal
+
+// Replies once the process exits; with WNOHANG, right away with pid 0 if it
+// is still running. The reply is deferred by parking the request, so a
+// multiplexed connection keeps serving other requests meanwhile.
+- (void)handleWaitRequest:(NSDictionary *)req
+                  request:(HIAHControlRequest)request {
+  pid_t pid = [req[@"pid"] intValue];
+  int options = [req[@"options"] intValue];
+  if (pid == -1 && req[@"parent"]) {
+    [self handleChildWaitRequest:req request:request];
+    return;
+  }
+  HIAHProcess *process = [self processForPID:pid];
+  if (!process) {
+    [self sendControlReply:@{
+      @"status" : @"error",
+      @"error" : [NSString stringWithFormat:@"No such process: %d", pid]
+    }
+                   request:request];
+    return;
+  }
+
+  NSDictionary *resp = nil;
+  @synchronized(self.controlWaiters) {
+    if (process.isExited) {
+      resp = @{
+        @"status" : @"ok",
+        @"pid" : @(pid),
+        @"exitCode" : @(process.exitCode)
+      };
+      // Collected by its parent; an any-child wait must not report it again
+      HIAHChildRegistryRemove(self.forwardedChildren, pid);
+    } else if (options & WNOHANG) {
+      resp = @{@"status" : @"ok", @"pid" : @0};
+    } else {
+      NSMutableArray *waiters = self.controlWaiters[@(pid)];
+      if (!waiters) {
+        waiters = [NSMutableArray array];
+        self.controlWaiters[@(pid)] = waiters;
+      }
+      [waiters addObject:[NSValue valueWithBytes:&request
+                                        objCType:@encode(HIAHControlRequest)]];
+    }
+  }
+  if (resp) {
+    [self sendControlReply:resp request:request];
+  }
+}
+
+// Answers every request parked on `pid`
+- (void)completeWaitersForPID:(pid_t)pid reply:(NSDictionary *)resp {
+  NSArray *waiters;
+  @synchronized(self.controlWaiters) {
+    waiters = self.controlWaiters[@(pid)];
+    [self.controlWaiters removeObjectForKey:@(pid)];
+  }
+  for (NSValue *value in waiters) {
+    HIAHControlRequest request;
+    [value getValue:&request];
+    [self sendControlReply:resp request:request];
+  }
+}
+
+#pragma mark - Forwarded Children
+
+// A spawn that names its requester makes the child that process's forwarded
+// child, so the requester can wait for any of them, not only by PID
+- (void)recordForwardedChild:(pid_t)pid parent:(pid_t)physicalParent {
+  pid_t parent = HIAHKernelForwardedParent(physicalParent);
+  BOOL exited = NO;
+  @synchronized(self.controlWaiters) {
+    HIAHProcess *process = [self processForPID:pid];
+    if (HIAHChildRegistryAdd(self.forwardedChildren, parent, 0, pid) == pid &&
+        (!process || process.isExited)) {
+      // Gone before its spawn was answered
+      HIAHChildRegistryExit(self.forwardedChildren, pid,
+                            W_EXITCODE(process.exitCode & 0xff, 0));
+      exited = YES;
+    }
+  }
+  if (exited) {
+    [self completeChildWaitersForParent:parent];
+  }
+}
+
+// Called with the waiters' lock held. nil while every child is running.
+- (NSDictionary *)childWaitReplyForParent:(pid_t)parent {
+  int status = 0;
+  pid_t child = HIAHChildRegistryWait(self.forwardedChildren, parent, -1,
+                                      &status, WNOHANG);
+  if (child > 0) {
+    return @{
+      @"status" : @"ok",
+      @"pid" : @(child),
+      @"exitCode" : @(WEXITSTATUS(status))
+    };
+  }
+  if (child < 0) {
+    return @{@"status" : @"no-child", @"error" : @"No child processes"};
+  }
+  return nil;
+}
+
+// waitpid(-1) over the requester's forwarded children. Like a wait by PID,
+// a blocking one is parked until there is an answer.
+- (void)handleChildWaitRequest:(NSDictionary *)req
+                       request:(HIAHControlRequest)request {
+  pid_t parent = HIAHKernelForwardedParent([req[@"parent"] intValue]);
+  int options = [req[@"options"] intValue];
+  NSDictionary *resp = nil;
+  @synchronized(self.controlWaiters) {
+    resp = [self childWaitReplyForParent:parent];
+    if (!resp && (options & WNOHANG)) {
+      resp = @{@"status" : @"ok", @"pid" : @0};
+    } else if (!resp) {
+      NSMutableArray *waiters = self.controlChildWaiters[@(parent)];
+      if (!waiters) {
+        waiters = [NSMutableArray array];
+        self.controlChildWaiters[@(parent)] = waiters;
+      }
+      [waiters addObject:[NSValue valueWithBytes:&request
+                                        objCType:@encode(HIAHControlRequest)]];
+    }
+  }
+  if (resp) {
+    [self sendControlReply:resp request:request];
+  }
+}
+
+// Answers the requests parked by `parent` that can be answered now, one
+// child each
+- (void)completeChildWaitersForParent:(pid_t)parent {
+  NSMutableArray *requests = [NSMutableArray array];
+  NSMutableArray *replies = [NSMutableArray array];
+  @synchronized(self.controlWaiters) {
+    NSMutableArray *waiters = self.controlChildWaiters[@(parent)];
+    while (waiters.count > 0) {
+      NSDictionary *resp = [self childWaitReplyForParent:parent];
+      if (!resp) {
+        break;
+      }
+      [requests addObject:waiters[0]];
+      [replies addObject:resp];
+      [waiters removeObjectAtIndex:0];
+    }
+    if (waiters && waiters.count == 0) {
+      [self.controlChildWaiters removeObjectForKey:@(parent)];
+    }
+  }
+  for (NSUInteger i = 0; i < requests.count; i++) {
+    HIAHControlRequest request;
+    [requests[i] getValue:&request];
+    [self sendControlReply:replies[i] request:request];
+  }
+}
+
+// Records the exit of `pid` if it is a forwarded child. Called with the
+// waiters' lock held; returns its parent's key, or 0.
+- (pid_t)exitForwardedChild:(pid_t)pid exitCode:(int)exitCode {
+  HIAHChildInfo info;
+  if (!HIAHChildRegistryLookup(self.forwardedChildren, pid, &info) ||
+      !HIAHChildRegistryExit(self.forwardedChildren, pid,
+                             W_EXITCODE(exitCode & 0xff, 0))) {
+    return 0;
+  }
+  return info.parent;
+}
+
+- (void)handleSignalRequest:(NSDictionary *)req
+                    request:(HIAHControlRequest)request {
+  pid_t pid = [req[@"pid"] intValue];
+  int sig = [req[@"signal"] intValue];
+  HIAHProcess *process = [self processForPID:pid];
+  NSString *error = nil;
+  if (!process || process.isExited) {
+    error = [NSString stringWithFormat:@"No such process: %d", pid];
+  } else if (process.physicalPid <= 0 || process.physicalPid == getpid()) {
+    // In-process guests share the kernel's process; only probing is safe
+    if (sig != 0) {
+      error = @"Cannot signal a guest running inside the kernel";
+    }
+  } else if (kill(process.physicalPid, sig) != 0) {
+    error = [NSString stringWithUTF8String:strerror(errno)];
+  }
+  [self sendControlReply:error ? @{@"status" : @"error", @"error" : error}
+                               : @{@"status" : @"ok"}
+                 request:request];
+}
+
+#pragma mark - Hook Metrics
+
+// Guests publish the calls made since their last publish; this sums them
+// with the kernel's own hooks.
+- (void)handleHookMetricsRequest:(NSDictionary *)req
+                         request:(HIAHControlRequest)request {
+  static HIAHHookMetric guestMetrics[HIAHHookMetricCount];
+  static os_unfair_lock guestMetricsLock = OS_UNFAIR_LOCK_INIT;
+
+  NSArray *published = req[@"hooks"];
+  if ([published isKindOfClass:[NSArray class]]) {
+    HIAHHookMetric received[HIAHHookMetricCount];
+    HIAHKernelHookMetricsFromArray(published, received);
+    os_unfair_lock_lock(&guestMetricsLock);
+    for (int h = 0; h < HIAHHookMetricCount; h++) {
+      HIAHHookMetricsAdd(&guestMetrics[h], &received[h]);
+    }
+    os_unfair_lock_unlock(&guestMetricsLock);
+    HIAHLogDebug(HIAHLogKernel, "Hook metrics received from pid %d",
+                 [req[@"pid"] intValue]);
+    [self sendControlReply:@{@"status" : @"ok"} request:request];
+    return;
+  }
+
+  HIAHHookMetric total[HIAHHookMetricCount];
+  HIAHHookMetricsSnapshot(total);
+  os_unfair_lock_lock(&guestMetricsLock);
+  for (int h = 0; h < HIAHHookMetricCount; h++) {
+    HIAHHookMetricsAdd(&total[h], &guestMetrics[h]);
+  }
+  os_unfair_lock_unlock(&guestMetricsLock);
+  [self sendControlReply:@{
+    @"status" : @"ok",
+    @"hooks" : HIAHKernelHookMetricsArray(total)
+  }
+                 request:request];
+}
+
 #pragma mark - Process Management
 
 - (void)registerProcess:(HIAHProcess *)process {
-  [self.lock lock];
-  self.processTable[@(process.pid)] = process;
-  [self.lock unlock];
+  process.kernel = self;
+  HIAHProcessTableKey key = HIAHKernelTableKeyForProcess(process);
+  HIAHProcessTableInsert(self.processTable, &key, (__bridge void *)process);
 
   NSLog(@"[HIAHKernel] Registered process %d (%@)", process.pid,
         process.executablePath);
@@ -306,14 +972,37 @@ NSErrorDomain const HIAHKernelErrorDomain = @"HIAHKernelErrorDomain";
                   userInfo:@{@"process" : process}];
 }
 
+- (void)reindexProcess:(HIAHProcess *)process {
+  if (process.kernel != self) {
+    return;
+  }
+  HIAHProcessTableKey key = HIAHKernelTableKeyForProcess(process);
+  HIAHProcessTableUpdateKey(self.processTable, &key);
+}
+
 - (void)unregisterProcessWithPID:(pid_t)pid {
-  [self.lock lock];
-  HIAHProcess *process = self.processTable[@(pid)];
-  [self.processTable removeObjectForKey:@(pid)];
-  [self.lock unlock];
+  HIAHProcess *process = (__bridge_transfer HIAHProcess *)HIAHProcessTableRemove(
+      self.processTable, pid);
+  process.kernel = nil;
+
+  // Gone without an exit: its parent still has to be able to collect it
+  pid_t parent;
+  @synchronized(self.controlWaiters) {
+    parent = [self exitForwardedChild:pid exitCode:process.exitCode];
+  }
+  if (parent) {
+    [self completeChildWaitersForParent:parent];
+  }
 
   NSLog(@"[HIAHKernel] Unregistered process %d", pid);
 
+  [self completeWaitersForPID:pid
+                        reply:@{
+                          @"status" : @"error",
+                          @"error" : [NSString
+                              stringWithFormat:@"No such process: %d", pid]
+                        }];
+
   if (process) {
     [[NSNotificationCenter defaultCenter]
         postNotificationName:HIAHKernelProcessExitedNotification
@@ -323,30 +1012,38 @@ NSErrorDomain const HIAHKernelErrorDomain = @"HIAHKernelErrorDomain";
 }
 
 - (HIAHProcess *)processForPID:(pid_t)pid {
-  [self.lock lock];
-  HIAHProcess *proc = self.processTable[@(pid)];
-  [self.lock unlock];
-  return proc;
+  return (__bridge_transfer HIAHProcess *)HIAHProcessTableCopyValueForPID(
+      self.processTable, pid);
+}
+
+- (HIAHProcess *)processForPhysicalPID:(pid_t)physicalPid {
+  return (__bridge_transfer HIAHProcess *)
+      HIAHProcessTableCopyValueForPhysicalPID(self.processTable, physicalPid);
 }
 
 - (HIAHProcess *)processForRequestIdentifier:(NSUUID *)uuid {
-  [self.lock lock];
-  __block HIAHProcess *result = nil;
-  [self.processTable enumerateKeysAndObjectsUsingBlock:^(
-                         NSNumber *key, HIAHProcess *obj, BOOL *stop) {
-    if ([obj.requestIdentifier isEqual:uuid]) {
-      result = obj;
-      *stop = YES;
-    }
-  }];
-  [self.lock unlock];
-  return result;
+  if (!uuid) {
+    return nil;
+  }
+  uuid_t bytes;
+  [uuid getUUIDBytes:bytes];
+  return (__bridge_transfer HIAHProcess *)
+      HIAHProcessTableCopyValueForRequestIdentifier(self.processTable, bytes);
 }
 
 - (NSArray<HIAHProcess *> *)allProcesses {
-  [self.lock lock];
-  NSArray *processes = [self.processTable allValues];
-  [self.lock unlock];
+  HIAHProcessTableSnapshot snapshot;
+  if (!HIAHProcessTableCopySnapshot(self.processTable, &snapshot)) {
+    HIAHLogError(HIAHLogKernel, "Failed to snapshot process table");
+    return @[];
+  }
+
+  NSMutableArray<HIAHProcess *> *processes =
+      [NSMutableArray arrayWithCapacity:snapshot.count];
+  for (size_t i = 0; i < snapshot.count; i++) {
+    [processes addObject:(__bridge HIAHProcess *)snapshot.values[i]];
+  }
+  HIAHProcessTableSnapshotFree(self.processTable, &snapshot);
 
   if (processes.count == 0) {
     HIAHLogDebug(HIAHLogKernel, "Process table is empty");
@@ -355,12 +1052,41 @@ NSErrorDomain const HIAHKernelErrorDomain = @"HIAHKernelErrorDomain";
   return processes;
 }
 
+- (uint64_t)processTableGeneration {
+  return HIAHProcessTableGeneration(self.processTable);
+}
+
 - (void)handleExitForPID:(pid_t)pid exitCode:(int)exitCode {
   HIAHProcess *proc = [self processForPID:pid];
   if (proc) {
-    proc.isExited = YES;
-    proc.exitCode = exitCode;
+    // Under the waiters' lock, so a wait either sees the exit or is parked
+    // before it and completed below
+    pid_t parent, physicalPid = proc.physicalPid;
+    BOOL ownProcess = physicalPid > 0 && physicalPid != getpid();
+    @synchronized(self.controlWaiters) {
+      proc.isExited = YES;
+      proc.exitCode = exitCode;
+      parent = [self exitForwardedChild:pid exitCode:exitCode];
+      // Its own forwarded children are nobody's to collect now
+      if (ownProcess) {
+        HIAHChildRegistryForget(self.forwardedChildren,
+                                HIAHKernelForwardedParent(physicalPid));
+      }
+    }
+    if (parent) {
+      [self completeChildWaitersForParent:parent];
+    }
+    if (ownProcess) {
+      [self completeChildWaitersForParent:HIAHKernelForwardedParent(
+                                              physicalPid)];
+    }
     HIAHLogInfo(HIAHLogKernel, "Process %d exited with code %d", pid, exitCode);
+    [self completeWaitersForPID:pid
+                          reply:@{
+                            @"status" : @"ok",
+                            @"pid" : @(pid),
+                            @"exitCode" : @(exitCode)
+                          }];
 
     [[NSNotificationCenter defaultCenter]
         postNotificationName:HIAHKernelProcessExitedNotification
@@ -369,30 +1095,211 @@ NSErrorDomain const HIAHKernelErrorDomain = @"HIAHKernelErrorDomain";
   }
 }
 
-#pragma mark - Process Spawning
+#pragma mark - Process Output
 
-- (void)spawnVirtualProcessWithPath:(NSString *)path
-                          arguments:(NSArray<NSString *> *)arguments
-                        environment:
-                            (NSDictionary<NSString *, NSString *> *)environment
-                         completion:
-                             (void (^)(pid_t pid, NSError *error))completion {
+- (BOOL)attachOutputConsumerForPID:(pid_t)pid
+                           handler:(void (^)(HIAHProcess *process))handler {
+  HIAHProcess *process = [self processForPID:pid];
+  if (!process.outputRing || !handler) {
+    return NO;
+  }
 
-  if (!path || path.length == 0) {
-    if (completion) {
-      NSError *error = [NSError
-          errorWithDomain:HIAHKernelErrorDomain
-                     code:HIAHKernelErrorInvalidPath
-                 userInfo:@{
-                   NSLocalizedDescriptionKey : @"Invalid executable path"
-                 }];
-      completion(-1, error);
+  // Waits out a relay pass that is draining right now
+  @synchronized(process) {
+    process.outputHandler = handler;
+  }
+
+  // An armed ring has nobody draining it, so hand the new consumer whatever
+  // is already buffered. Otherwise the notification in flight reaches it.
+  if (HIAHOutputRingDisarm(process.outputRing)) {
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+      handler(process);
+    });
+  }
+  return YES;
+}
+
+- (void)relayOutputOfProcess:(HIAHProcess *)process {
+  HIAHOutputRing *ring = process.outputRing;
+  for (;;) {
+    size_t held;
+    @synchronized(process) {
+      void (^handler)(HIAHProcess *) = process.outputHandler;
+      if (handler != self.outputRelay) {
+        // Another consumer took over; pass the wakeup on
+        if (handler) {
+          dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+            handler(process);
+          });
+        }
+        return;
+      }
+      held = [self relayBufferedOutputOfProcess:process];
     }
+    if (HIAHOutputRingAtEOF(ring) || HIAHOutputRingArm(ring, held)) {
+      return;
+    }
+  }
+}
+
+// Forwards everything buffered to the host's stdout, onOutput and the output
+// notification, once per batch. Returns the bytes of a trailing, incomplete
+// UTF-8 sequence left in the ring for the next pass.
+- (size_t)relayBufferedOutputOfProcess:(HIAHProcess *)process {
+  HIAHOutputRing *ring = process.outputRing;
+  struct iovec regions[2];
+  int count = HIAHOutputRingPeek(ring, regions);
+  if (count == 0) {
+    return 0;
+  }
+
+  size_t length = regions[0].iov_len + (count > 1 ? regions[1].iov_len : 0);
+  NSData *bytes;
+  if (count == 1) {
+    bytes = [NSData dataWithBytesNoCopy:regions[0].iov_base
+                                 length:length
+                           freeWhenDone:NO];
+  } else {
+    NSMutableData *joined = [NSMutableData dataWithCapacity:length];
+    [joined appendBytes:regions[0].iov_base length:regions[0].iov_len];
+    [joined appendBytes:regions[1].iov_base length:regions[1].iov_len];
+    bytes = joined;
+  }
+
+  size_t complete = HIAHKernelUTF8CompleteLength(bytes.bytes, length);
+  if (complete < length && HIAHOutputRingIsClosed(ring)) {
+    complete = length;
+  }
+  if (complete == 0) {
+    return length;
+  }
+
+  NSString *output = [[NSString alloc] initWithBytes:bytes.bytes
+                                              length:complete
+                                            encoding:NSUTF8StringEncoding];
+  if (!output) {
+    output = [[NSString alloc] initWithBytes:bytes.bytes
+                                      length:complete
+                                    encoding:NSISOLatin1StringEncoding];
+  }
+  fwrite(bytes.bytes, 1, complete, stdout);
+  fflush(stdout);
+  HIAHOutputRingConsume(ring, complete);
+
+  pid_t pid = process.pid;
+  if (self.onOutput) {
+    self.onOutput(pid, output);
+  }
+  [[NSNotificationCenter defaultCenter]
+      postNotificationName:HIAHKernelProcessOutputNotification
+                    object:self
+                  userInfo:@{@"pid" : @(pid), @"output" : output}];
+  return length - complete;
+}
+
+#pragma mark - Guest Images
+
+// MH_EXECUTE binaries are patched into a dlopen-able copy (MH_EXECUTE →
+// MH_BUNDLE). Patched images are cached by content, so only the first
+// launch of a binary pays for the copy and the patch.
+- (NSString *)loadablePathForBinary:(NSString *)path error:(NSError **)error {
+  if (![HIAHMachOUtils isMHExecute:path]) {
+    return path;
+  }
+
+  NSError *cacheError = nil;
+  NSString *patchedPath = [self.patchedImageCache
+      imagePathForSourcePath:path
+               recipeVersion:HIAH_JITLESS_PATCH_RECIPE_VERSION
+                    preparer:^BOOL(NSString *stagingPath) {
+                      HIAHLogInfo(HIAHLogKernel,
+                                  "Binary is MH_EXECUTE, patching for dlopen...");
+                      // JIT-less mode patch (LiveContainer approach)
+                      return [HIAHMachOUtils
+                          patchBinaryForJITLessMode:stagingPath];
+                    }
+                       error:&cacheError];
+  if (!patchedPath) {
+    HIAHLogError(HIAHLogKernel, "Failed to patch binary for dlopen: %s",
+                 [[cacheError description] UTF8String]);
+    if (error) {
+      *error = cacheError;
+    }
+    return nil;
+  }
+
+  HIAHLogInfo(HIAHLogKernel, "Using patched binary: %s",
+              [patchedPath UTF8String]);
+  return patchedPath;
+}
+
+- (void)setImagePreloadManifestPath:(NSString *)path {
+  _imagePreloadManifestPath = [path copy];
+  if (path) {
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+      [self preloadImagesFromManifest:path];
+    });
+  }
+}
+
+- (void)preloadImagesFromManifest:(NSString *)manifestPath {
+  NSString *manifest = [NSString stringWithContentsOfFile:manifestPath
+                                                 encoding:NSUTF8StringEncoding
+                                                    error:nil];
+  if (!manifest) {
     return;
   }
 
+  NSString *base = [manifestPath stringByDeletingLastPathComponent];
+  NSUInteger loaded = 0;
+  for (NSString *rawLine in
+       [manifest componentsSeparatedByCharactersInSet:
+                     [NSCharacterSet newlineCharacterSet]]) {
+    NSString *line = [rawLine
+        stringByTrimmingCharactersInSet:[NSCharacterSet
+                                            whitespaceCharacterSet]];
+    if (line.length == 0 || [line hasPrefix:@"#"]) {
+      continue;
+    }
+    NSString *path =
+        line.isAbsolutePath ? line : [base stringByAppendingPathComponent:line];
+
+    NSString *loadablePath = [self loadablePathForBinary:path error:nil];
+    char error[512];
+    if (loadablePath &&
+        HIAHImagePoolPreload(HIAHImagePoolShared(), loadablePath.UTF8String,
+                             error, sizeof(error))) {
+      loaded++;
+    } else {
+      HIAHLogWarning(HIAHLogKernel, "Could not preload %s: %s",
+                     path.UTF8String, loadablePath ? error : "patch failed");
+    }
+  }
+  HIAHLogInfo(HIAHLogKernel, "Preloaded %lu guest images from %s",
+              (unsigned long)loaded, manifestPath.UTF8String);
+}
+
+- (NSDictionary<NSString *, NSNumber *> *)imagePoolStatistics {
+  HIAHImagePoolStats stats;
+  HIAHImagePoolGetStats(HIAHImagePoolShared(), &stats);
+  return @{
+    @"hits" : @(stats.hits),
+    @"misses" : @(stats.misses),
+    @"failures" : @(stats.failures),
+    @"evictions" : @(stats.evictions),
+    @"resident" : @(stats.resident),
+    @"inUse" : @(stats.inUse),
+  };
+}
+
+#pragma mark - Process Spawning
+
+// Locates the executable of a .app bundle (through its Info.plist) and
+// checks that it exists.
+- (NSString *)resolveExecutableAtPath:(NSString *)path error:(NSError **)error {
   NSFileManager *fm = [NSFileManager defaultManager];
   NSString *actualExecutablePath = path;
+  NSString *failure = nil;
 
   // Handle .app bundle paths
   // If the path points to a .app bundle, we need to find the executable inside
@@ -425,322 +1332,359 @@ NSErrorDomain const HIAHKernelErrorDomain = @"HIAHKernelErrorDomain";
         } else {
           NSLog(@"[HIAHKernel] ERROR: Could not find executable '%@' in bundle",
                 executableName);
-          if (completion) {
-            NSError *error = [NSError
-                errorWithDomain:HIAHKernelErrorDomain
-                           code:HIAHKernelErrorInvalidPath
-                       userInfo:@{
-                         NSLocalizedDescriptionKey : [NSString
-                             stringWithFormat:
-                                 @"Executable '%@' not found in bundle",
-                                 executableName]
-                       }];
-            completion(-1, error);
-          }
-          return;
+          failure = [NSString
+              stringWithFormat:@"Executable '%@' not found in bundle",
+                               executableName];
         }
       }
     } else {
       NSLog(@"[HIAHKernel] ERROR: No CFBundleExecutable in Info.plist");
-      if (completion) {
-        NSError *error =
-            [NSError errorWithDomain:HIAHKernelErrorDomain
-                                code:HIAHKernelErrorInvalidPath
-                            userInfo:@{
-                              NSLocalizedDescriptionKey :
-                                  @"No CFBundleExecutable in Info.plist"
-                            }];
-        completion(-1, error);
-      }
-      return;
+      failure = @"No CFBundleExecutable in Info.plist";
     }
   }
 
-  // Update path to actual executable
-  path = actualExecutablePath;
-  NSLog(@"[HIAHKernel] Final executable path: %@", path);
-
   // Verify the executable exists
-  if (![fm fileExistsAtPath:path]) {
-    NSLog(@"[HIAHKernel] ERROR: Executable not found at: %@", path);
-    if (completion) {
-      NSError *error = [NSError
-          errorWithDomain:HIAHKernelErrorDomain
-                     code:HIAHKernelErrorInvalidPath
-                 userInfo:@{
-                   NSLocalizedDescriptionKey : [NSString
-                       stringWithFormat:@"Executable not found: %@", path]
-                 }];
-      completion(-1, error);
-    }
-    return;
+  if (!failure && ![fm fileExistsAtPath:actualExecutablePath]) {
+    NSLog(@"[HIAHKernel] ERROR: Executable not found at: %@",
+          actualExecutablePath);
+    failure = [NSString
+        stringWithFormat:@"Executable not found: %@", actualExecutablePath];
   }
 
-  // CRITICAL: Ensure executable has correct permissions
-  NSDictionary *attrs = @{NSFilePosixPermissions : @0755};
-  NSError *permError = nil;
-  [fm setAttributes:attrs ofItemAtPath:path error:&permError];
-  if (permError) {
-    NSLog(@"[HIAHKernel] Warning: Could not set executable permissions: %@",
-          permError);
-  } else {
-    NSLog(@"[HIAHKernel] Set executable permissions for: %@", path);
+  if (failure) {
+    if (error) {
+      *error = [NSError errorWithDomain:HIAHKernelErrorDomain
+                                   code:HIAHKernelErrorInvalidPath
+                               userInfo:@{NSLocalizedDescriptionKey : failure}];
+    }
+    return nil;
   }
 
-  NSError *error = nil;
+  NSLog(@"[HIAHKernel] Final executable path: %@", actualExecutablePath);
+  return actualExecutablePath;
+}
 
-  // 1. Create stdout/stderr capture socket
-  // Use NSTemporaryDirectory() - iOS-proper temporary storage
-  NSString *socketDir = self.socketDirectory ?: NSTemporaryDirectory();
+static NSString *HIAHKernelFormatSpawnTrace(const HIAHSpawnTrace *trace) {
+  char buffer[1024];
+  HIAHSpawnTraceFormat(trace, buffer, sizeof(buffer));
+  return [NSString stringWithUTF8String:buffer];
+}
 
-  // Short socket name
-  NSString *socketName =
-      [NSString stringWithFormat:@"%d.s", arc4random() % 100];
-  NSString *socketPath = [socketDir stringByAppendingPathComponent:socketName];
+- (nullable NSString *)spawnTraceForPID:(pid_t)pid {
+  HIAHProcess *process = [self processForPID:pid];
+  if (!process.spawnTrace) {
+    return nil;
+  }
+  return HIAHKernelFormatSpawnTrace(process.spawnTrace);
+}
+
+- (void)spawnVirtualProcessWithPath:(NSString *)path
+                          arguments:(NSArray<NSString *> *)arguments
+                        environment:
+                            (NSDictionary<NSString *, NSString *> *)environment
+                         completion:
+                             (void (^)(pid_t pid, NSError *error))completion {
+  [self spawnVirtualProcessWithPath:path
+                          arguments:arguments
+                        environment:environment
+                 environmentEntries:nil
+                         completion:completion];
+}
 
-  NSLog(@"[HIAHKernel] Spawn socket: %@", socketPath);
+// `environmentEntries`, a packed envp, is used in place of `environment`
+// when given. Forwarded spawns arrive that way and keep it to the launch.
+- (void)spawnVirtualProcessWithPath:(NSString *)path
+                          arguments:(NSArray<NSString *> *)arguments
+                        environment:
+                            (NSDictionary<NSString *, NSString *> *)environment
+                 environmentEntries:(NSData *)environmentEntries
+                         completion:
+                             (void (^)(pid_t pid, NSError *error))completion {
 
-  int serverSock = socket(AF_UNIX, SOCK_STREAM, 0);
-  if (serverSock < 0) {
-    NSLog(@"[HIAHKernel] Failed to create socket: %s", strerror(errno));
+  if (!path || path.length == 0) {
     if (completion) {
-      NSError *err = [NSError
+      NSError *error = [NSError
           errorWithDomain:HIAHKernelErrorDomain
-                     code:HIAHKernelErrorSocketCreationFailed
+                     code:HIAHKernelErrorInvalidPath
                  userInfo:@{
-                   NSLocalizedDescriptionKey : @"Failed to create output socket"
+                   NSLocalizedDescriptionKey : @"Invalid executable path"
                  }];
-      completion(-1, err);
+      completion(-1, error);
     }
     return;
   }
 
-  struct sockaddr_un addr;
-  memset(&addr, 0, sizeof(addr));
-  addr.sun_family = AF_UNIX;
+  // The spawn runs as a pipeline of traced stages:
+  //
+  //   resolve ─┬─ prepare → load → entry ─┬─ register → launch
+  //            └─ channel ────────────────┘
+  //
+  // Binary preparation runs on a global queue while this thread opens the
+  // output channel; the two meet before the process is registered.
 
-  // Use absolute path instead of chdir (iOS device doesn't allow chdir to app
-  // group)
-  const char *fullSocketPath = [socketPath UTF8String];
-  if (strlen(fullSocketPath) >= sizeof(addr.sun_path)) {
-    NSLog(@"[HIAHKernel] Socket path too long: %@", socketPath);
-    close(serverSock);
+  // The process object exists from the start: it owns the spawn trace, and
+  // its output ring can be fed before it is registered
+  HIAHProcess *vproc = [HIAHProcess processWithPath:path
+                                          arguments:arguments
+                                        environment:environment];
+  vproc.environmentEntries = environmentEntries;
+  vproc.outputHandler = self.outputRelay;
+  HIAHSpawnTrace *trace = vproc.spawnTrace;
+  HIAHSpawnTraceStart(trace);
+
+  // 1. Resolve the executable
+  HIAHSpawnTraceBegin(trace, HIAHSpawnStageResolve);
+  NSError *resolveError = nil;
+  NSString *resolvedPath = [self resolveExecutableAtPath:path
+                                                   error:&resolveError];
+  if (!resolvedPath) {
+    HIAHSpawnTraceFail(trace, HIAHSpawnStageResolve);
     if (completion) {
-      NSError *err =
-          [NSError errorWithDomain:HIAHKernelErrorDomain
-                              code:HIAHKernelErrorSocketCreationFailed
-                          userInfo:@{
-                            NSLocalizedDescriptionKey : @"Socket path too long"
-                          }];
-      completion(-1, err);
+      completion(-1, resolveError);
     }
     return;
   }
+  HIAHSpawnTraceEnd(trace, HIAHSpawnStageResolve);
+  path = resolvedPath;
+  vproc.executablePath = path;
 
-  strncpy(addr.sun_path, fullSocketPath, sizeof(addr.sun_path) - 1);
-  unlink(fullSocketPath); // Remove if exists
+  // 2a. Prepare, load and look up the entry point, off this thread
+  typedef int (*main_func_t)(int argc, char **argv, char **envp);
+  HIAHImagePool *imagePool = HIAHImagePoolShared();
+  __block HIAHImage *image = NULL;
+  __block main_func_t main_func = NULL;
+  __block NSError *loadError = nil;
+
+  dispatch_group_t stages = dispatch_group_create();
+  dispatch_group_async(
+      stages, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+        // CRITICAL: Ensure executable has correct permissions
+        HIAHSpawnTraceBegin(trace, HIAHSpawnStagePrepare);
+        NSError *permError = nil;
+        [[NSFileManager defaultManager]
+            setAttributes:@{NSFilePosixPermissions : @0755}
+             ofItemAtPath:path
+                    error:&permError];
+        if (permError) {
+          NSLog(@"[HIAHKernel] Warning: Could not set executable "
+                @"permissions: %@",
+                permError);
+        }
 
-  if (bind(serverSock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-    NSLog(@"[HIAHKernel] Failed to bind stdout socket at %@: %s", socketPath,
-          strerror(errno));
-    close(serverSock);
-    if (completion) {
-      NSError *err = [NSError
-          errorWithDomain:HIAHKernelErrorDomain
-                     code:HIAHKernelErrorSocketCreationFailed
-                 userInfo:@{
-                   NSLocalizedDescriptionKey :
-                       [NSString stringWithFormat:@"Failed to bind socket: %s",
-                                                  strerror(errno)]
-                 }];
-      completion(-1, err);
-    }
-    return;
+        // Patch binary for dlopen if needed
+        NSError *patchError = nil;
+        NSString *executablePath = [self loadablePathForBinary:path
+                                                         error:&patchError];
+        if (!executablePath) {
+          HIAHSpawnTraceFail(trace, HIAHSpawnStagePrepare);
+          NSMutableDictionary *userInfo = [NSMutableDictionary
+              dictionaryWithObject:@"Failed to patch binary"
+                            forKey:NSLocalizedDescriptionKey];
+          userInfo[NSUnderlyingErrorKey] = patchError;
+          loadError = [NSError errorWithDomain:HIAHKernelErrorDomain
+                                          code:HIAHKernelErrorSpawnFailed
+                                      userInfo:userInfo];
+          return;
+        }
+        HIAHSpawnTraceEnd(trace, HIAHSpawnStagePrepare);
+
+        // Load the binary via dlopen. Warm images come straight from the
+        // pool; the guest holds its image until main() returns.
+        HIAHLogInfo(HIAHLogKernel, "Loading binary via dlopen: %s",
+                    [executablePath UTF8String]);
+        HIAHSpawnTraceBegin(trace, HIAHSpawnStageLoad);
+        char dlopen_error[512];
+        image = HIAHImagePoolAcquire(imagePool, [executablePath UTF8String],
+                                     dlopen_error, sizeof(dlopen_error));
+        if (!image) {
+          HIAHSpawnTraceFail(trace, HIAHSpawnStageLoad);
+          HIAHLogError(HIAHLogKernel, "dlopen failed: %s", dlopen_error);
+          loadError = [NSError
+              errorWithDomain:HIAHKernelErrorDomain
+                         code:HIAHKernelErrorSpawnFailed
+                     userInfo:@{
+                       NSLocalizedDescriptionKey : [NSString
+                           stringWithFormat:@"dlopen failed: %s", dlopen_error]
+                     }];
+          return;
+        }
+        HIAHSpawnTraceEnd(trace, HIAHSpawnStageLoad);
+        HIAHLogInfo(HIAHLogKernel, "Binary loaded successfully via dlopen");
+
+        // For command-line tools like ssh/waypipe, we need to find main()
+        // (_main is used by some binaries)
+        HIAHSpawnTraceBegin(trace, HIAHSpawnStageEntry);
+        static const char *const entryNames[] = {"main", "_main", NULL};
+        main_func =
+            (main_func_t)HIAHImageFindEntry(imagePool, image, entryNames, NULL);
+        HIAHSpawnTraceEnd(trace, HIAHSpawnStageEntry);
+      });
+
+  // 2b. Open the guest's stdout/stderr channel. The guest gets pre-connected
+  // descriptors, so there is no socket file to collide on and no accept().
+  HIAHSpawnTraceBegin(trace, HIAHSpawnStageChannel);
+  __block HIAHOutputChannel channel;
+  int channelError = 0;
+  BOOL channelOpen = HIAHOutputChannelOpen(&channel, &channelError);
+  if (channelOpen) {
+    // Pump the guest's output into its ring until the guest's ends are
+    // closed; the block keeps vproc alive
+    dispatch_async(
+        dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+          if (vproc.outputRing) {
+            HIAHOutputChannelPump(&channel, vproc.outputRing);
+          }
+          HIAHOutputChannelCloseKernel(&channel);
+        });
+    HIAHSpawnTraceEnd(trace, HIAHSpawnStageChannel);
+  } else {
+    HIAHSpawnTraceFail(trace, HIAHSpawnStageChannel);
+    NSLog(@"[HIAHKernel] Failed to create output channel: %s",
+          strerror(channelError));
   }
 
-  listen(serverSock, 1);
+  // 3. Join the branches, then register and launch
+  dispatch_group_notify(
+      stages, dispatch_get_global_queue(QOS_CLASS_USER_INITIATED, 0), ^{
+        NSError *error = loadError;
+        if (!channelOpen) {
+          error = [NSError
+              errorWithDomain:HIAHKernelErrorDomain
+                         code:HIAHKernelErrorSocketCreationFailed
+                     userInfo:@{
+                       NSLocalizedDescriptionKey :
+                           @"Failed to create output channel"
+                     }];
+        }
+        if (error) {
+          if (channelOpen) {
+            HIAHOutputChannelCloseGuest(&channel);
+          }
+          HIAHImagePoolRelease(imagePool, image);
+          HIAHLogWarning(HIAHLogKernel, "Spawn of %s failed:\n%s",
+                         [path UTF8String],
+                         [HIAHKernelFormatSpawnTrace(trace) UTF8String]);
+          if (completion) {
+            completion(-1, error);
+          }
+          return;
+        }
 
-  // Start background thread to read from socket
-  dispatch_async(
-      dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-        int clientSock = accept(serverSock, NULL, NULL);
-        if (clientSock >= 0) {
-          char buffer[1024];
-          ssize_t n;
-          while ((n = read(clientSock, buffer, sizeof(buffer) - 1)) > 0) {
-            buffer[n] = '\0';
-            NSString *output = [NSString stringWithUTF8String:buffer];
-            if (output) {
-              NSLog(@"[HIAHKernel Guest] %@", output);
-
-              if (self.onOutput) {
-                self.onOutput(0, output);
-              }
+        // Register the virtual process
+        HIAHSpawnTraceBegin(trace, HIAHSpawnStageRegister);
+        vproc.pid = HIAHProcessTableAllocatePID(self.processTable);
 
-              [[NSNotificationCenter defaultCenter]
-                  postNotificationName:HIAHKernelProcessOutputNotification
-                                object:self
-                              userInfo:@{@"output" : output}];
+        // For dlopen-based execution, we don't have a separate physical PID
+        // The code runs in our process
+        vproc.physicalPid = getpid();
 
-              printf("%s", [output UTF8String]);
-              fflush(stdout);
-            }
+        [self registerProcess:vproc];
+        HIAHSpawnTraceEnd(trace, HIAHSpawnStageRegister);
+
+        HIAHLogInfo(HIAHLogKernel,
+                    "Spawned guest process via dlopen (Virtual PID: %d)",
+                    vproc.pid);
+
+        if (!main_func) {
+          HIAHLogWarning(HIAHLogKernel, "No main() entry point found, binary "
+                                        "loaded but not executed");
+          HIAHOutputChannelCloseGuest(&channel);
+          HIAHImagePoolRelease(imagePool, image);
+
+          // Still return success - the binary is loaded
+          if (completion) {
+            completion(vproc.pid, nil);
           }
-          close(clientSock);
+          return;
         }
-        close(serverSock);
-        unlink([socketPath UTF8String]);
-      });
 
+        HIAHLogInfo(HIAHLogKernel,
+                    "Found entry point, executing in background thread...");
+
+        // Execute main() in a background thread
+        HIAHSpawnTraceBegin(trace, HIAHSpawnStageLaunch);
+        dispatch_async(
+            dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+              // Prepare argc/argv
+              int argc = (int)(arguments.count + 1);
+              char **argv = malloc(sizeof(char *) * (argc + 1));
+              argv[0] = strdup([path UTF8String]);
+              for (int i = 0; i < arguments.count; i++) {
+                argv[i + 1] = strdup([arguments[i] UTF8String]);
+              }
+              argv[argc] = NULL;
+
+              // Prepare envp: the guest's own entries, with the kernel's
+              // replacing any inherited copies, in one allocation
+              char stdoutFd[32], stderrFd[32];
+              snprintf(stdoutFd, sizeof(stdoutFd), "HIAH_STDOUT_FD=%d",
+                       channel.guestFds[HIAHOutputStreamStdout]);
+              snprintf(stderrFd, sizeof(stderrFd), "HIAH_STDERR_FD=%d",
+                       channel.guestFds[HIAHOutputStreamStderr]);
+              NS_VALID_UNTIL_END_OF_SCOPE
+              NSString *socketEntry =
+                  self.controlSocketPath
+                      ? [@"HIAH_KERNEL_SOCKET="
+                            stringByAppendingString:self.controlSocketPath]
+                      : nil;
+              const char *extra[] = {stdoutFd, stderrFd,
+                                     socketEntry.UTF8String, NULL};
+
+              char **envp;
+              if (environmentEntries) {
+                envp = HIAHControlEnvironmentPackReplacing(
+                    environmentEntries.bytes, SIZE_MAX, extra);
+              } else {
+                // Each UTF8String buffer lives only as long as its string,
+                // so envStrings keeps them past the pack that copies them
+                const char **entries =
+                    malloc(sizeof(char *) * (environment.count + 1));
+                NS_VALID_UNTIL_END_OF_SCOPE
+                NSMutableArray<NSString *> *envStrings =
+                    [NSMutableArray arrayWithCapacity:environment.count];
+                size_t envCount = 0;
+                for (NSString *key in environment) {
+                  NSString *envStr = [NSString
+                      stringWithFormat:@"%@=%@", key, environment[key]];
+                  [envStrings addObject:envStr];
+                  entries[envCount++] = [envStr UTF8String];
+                }
+                envp = HIAHControlEnvironmentPackReplacing(entries, envCount,
+                                                           extra);
+                free(entries);
+              }
 
-  // 2. Patch binary for dlopen if needed
-  NSString *executablePath = path;
-  
-  // Check if binary needs patching (MH_EXECUTE → MH_BUNDLE)
-  if ([HIAHMachOUtils isMHExecute:path]) {
-    HIAHLogInfo(HIAHLogKernel, "Binary is MH_EXECUTE, patching for dlopen...");
-    
-    // Create a temporary copy for patching
-    NSString *tempPath = [NSTemporaryDirectory() stringByAppendingPathComponent:
-                         [[path lastPathComponent] stringByAppendingString:@".patched"]];
-    
-    NSError *copyError = nil;
-    if (![[NSFileManager defaultManager] copyItemAtPath:path
-                                                  toPath:tempPath
-                                                   error:&copyError]) {
-      HIAHLogError(HIAHLogKernel, "Failed to copy binary for patching: %s",
-                   [[copyError description] UTF8String]);
-      if (completion) {
-        completion(-1, copyError);
-      }
-      return;
-    }
-    
-    // Patch the binary using JIT-less mode (LiveContainer approach)
-    if (![HIAHMachOUtils patchBinaryForJITLessMode:tempPath]) {
-      HIAHLogError(HIAHLogKernel, "Failed to patch binary for dlopen");
-      if (completion) {
-        NSError *err = [NSError errorWithDomain:HIAHKernelErrorDomain
-                                           code:HIAHKernelErrorSpawnFailed
-                                       userInfo:@{NSLocalizedDescriptionKey: @"Failed to patch binary"}];
-        completion(-1, err);
-      }
-      return;
-    }
-    
-    executablePath = tempPath;
-    HIAHLogInfo(HIAHLogKernel, "Binary patched successfully: %s", [tempPath UTF8String]);
-  }
-  
-  // 3. Load the binary via dlopen
-  HIAHLogInfo(HIAHLogKernel, "Loading binary via dlopen: %s", [executablePath UTF8String]);
-  
-  void *handle = dlopen([executablePath UTF8String], RTLD_NOW | RTLD_GLOBAL);
-  if (!handle) {
-    const char *dlopen_error = dlerror();
-    HIAHLogError(HIAHLogKernel, "dlopen failed: %s", dlopen_error ?: "(null)");
-    
-    if (completion) {
-      NSError *err = [NSError errorWithDomain:HIAHKernelErrorDomain
-                                         code:HIAHKernelErrorSpawnFailed
-                                     userInfo:@{NSLocalizedDescriptionKey: 
-                                       [NSString stringWithFormat:@"dlopen failed: %s", 
-                                        dlopen_error ?: "(null)"]}];
-      completion(-1, err);
-    }
-    return;
-  }
-  
-  HIAHLogInfo(HIAHLogKernel, "Binary loaded successfully via dlopen");
-  
-  // 4. Create virtual process entry
-  HIAHProcess *vproc = [HIAHProcess processWithPath:path
-                                          arguments:arguments
-                                        environment:environment];
-  
-  // Assign virtual PID
-  [self.lock lock];
-  vproc.pid = self.nextVirtualPid++;
-  [self.lock unlock];
-  
-  // For dlopen-based execution, we don't have a separate physical PID
-  // The code runs in our process
-  vproc.physicalPid = getpid();
-  
-  [self registerProcess:vproc];
-  
-  HIAHLogInfo(HIAHLogKernel, "Spawned guest process via dlopen (Virtual PID: %d)", vproc.pid);
-  
-  // 5. Find and execute entry point
-  // For command-line tools like ssh/waypipe, we need to find main()
-  typedef int (*main_func_t)(int argc, char **argv, char **envp);
-  main_func_t main_func = (main_func_t)dlsym(handle, "main");
-  
-  if (!main_func) {
-    // Try _main (some binaries use this)
-    main_func = (main_func_t)dlsym(handle, "_main");
-  }
-  
-  if (main_func) {
-    HIAHLogInfo(HIAHLogKernel, "Found entry point, executing in background thread...");
-    
-    // Execute main() in a background thread
-    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-      // Prepare argc/argv
-      int argc = (int)(arguments.count + 1);
-      char **argv = malloc(sizeof(char *) * (argc + 1));
-      argv[0] = strdup([path UTF8String]);
-      for (int i = 0; i < arguments.count; i++) {
-        argv[i + 1] = strdup([arguments[i] UTF8String]);
-      }
-      argv[argc] = NULL;
-      
-      // Prepare envp
-      NSMutableDictionary *fullEnv = environment ? [environment mutableCopy] : [NSMutableDictionary dictionary];
-      fullEnv[@"HIAH_STDOUT_SOCKET"] = socketPath;
-      if (self.controlSocketPath) {
-        fullEnv[@"HIAH_KERNEL_SOCKET"] = self.controlSocketPath;
-      }
-      
-      int envCount = (int)fullEnv.count;
-      char **envp = malloc(sizeof(char *) * (envCount + 1));
-      int envIdx = 0;
-      for (NSString *key in fullEnv) {
-        NSString *value = fullEnv[key];
-        NSString *envStr = [NSString stringWithFormat:@"%@=%@", key, value];
-        envp[envIdx++] = strdup([envStr UTF8String]);
-      }
-      envp[envCount] = NULL;
-      
-      // Call main()
-      HIAHLogInfo(HIAHLogKernel, "Calling main() with %d arguments", argc);
-      int exitCode = main_func(argc, argv, envp);
-      HIAHLogInfo(HIAHLogKernel, "main() returned with exit code: %d", exitCode);
-      
-      // Clean up
-      for (int i = 0; i < argc; i++) {
-        free(argv[i]);
-      }
-      free(argv);
-      for (int i = 0; i < envCount; i++) {
-        free(envp[i]);
-      }
-      free(envp);
-      
-      // Mark process as exited
-      [self handleExitForPID:vproc.pid exitCode:exitCode];
-    });
-    
-    // Return success immediately (execution is async)
-    if (completion) {
-      completion(vproc.pid, nil);
-    }
-  } else {
-    HIAHLogWarning(HIAHLogKernel, "No main() entry point found, binary loaded but not executed");
-    
-    // Still return success - the binary is loaded
-    if (completion) {
-      completion(vproc.pid, nil);
-    }
-  }
+              HIAHSpawnTraceEnd(trace, HIAHSpawnStageLaunch);
+              HIAHLogDebug(HIAHLogKernel, "Spawn trace for PID %d:\n%s",
+                           vproc.pid,
+                           [HIAHKernelFormatSpawnTrace(trace) UTF8String]);
+
+              // Call main()
+              HIAHLogInfo(HIAHLogKernel, "Calling main() with %d arguments",
+                          argc);
+              int exitCode = main_func(argc, argv, envp);
+              HIAHLogInfo(HIAHLogKernel, "main() returned with exit code: %d",
+                          exitCode);
+
+              // Clean up
+              for (int i = 0; i < argc; i++) {
+                free(argv[i]);
+              }
+              free(argv);
+              free(envp);
+
+              // Lets the pump see EOF once everything the guest wrote is
+              // buffered
+              HIAHOutputChannelCloseGuest(&channel);
+              HIAHImagePoolRelease(imagePool, image);
+
+              // Mark process as exited
+              [self handleExitForPID:vproc.pid exitCode:exitCode];
+            });
+
+        // Return success immediately (execution is async)
+        if (completion) {
+          completion(vproc.pid, nil);
+        }
+      });
 }
@@ -9,9 +9,44 @@
  */
 
 #import "HIAHProcess.h"
+#import "HIAHKernel.h"
+
+// Runs on the output pump's thread, which keeps the process alive while it
+// can still produce.
+static void HIAHProcessOutputRingNotify(HIAHOutputRing *ring, void *context) {
+    HIAHProcess *process = (__bridge HIAHProcess *)context;
+    void (^handler)(HIAHProcess *) = process.outputHandler;
+    if (!handler) {
+        return;   // Stays unarmed; the next consumer starts by draining
+    }
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        handler(process);
+    });
+}
+
+static NSDictionary *HIAHProcessEnvironmentDictionary(const char *const *envp) {
+    NSMutableDictionary *env = [NSMutableDictionary dictionary];
+    for (size_t i = 0; envp[i]; i++) {
+        const char *eq = strchr(envp[i], '=');
+        if (!eq) {
+            continue;
+        }
+        NSString *key = [[NSString alloc] initWithBytes:envp[i]
+                                                 length:eq - envp[i]
+                                               encoding:NSUTF8StringEncoding];
+        NSString *value = [NSString stringWithUTF8String:eq + 1];
+        // The first entry is the one getenv() finds
+        if (key && value && !env[key]) {
+            env[key] = value;
+        }
+    }
+    return env;
+}
 
 @implementation HIAHProcess
 
+@synthesize environment = _environment;
+
 - (instancetype)init {
     self = [super init];
     if (self) {
@@ -21,10 +56,54 @@
         _ppid = -1;
         _exitCode = 0;
         _isExited = NO;
+        // Untouched ring pages are never committed, so this is cheap for
+        // processes that print little
+        _outputRing = HIAHOutputRingCreate(0, HIAHProcessOutputRingNotify, (__bridge void *)self);
+        _spawnTrace = calloc(1, sizeof(HIAHSpawnTrace));
     }
     return self;
 }
 
+- (void)dealloc {
+    if (_outputRing) {
+        HIAHOutputRingCancel(_outputRing);
+        HIAHOutputRingRelease(_outputRing);
+    }
+    free(_spawnTrace);
+}
+
+- (void)setPhysicalPid:(pid_t)physicalPid {
+    if (_physicalPid == physicalPid) {
+        return;
+    }
+    _physicalPid = physicalPid;
+    [self.kernel reindexProcess:self];
+}
+
+- (NSDictionary<NSString *, NSString *> *)environment {
+    // Only inspection reads this, so spawns never pay for the dictionary
+    @synchronized (self) {
+        if (!_environment && _environmentEntries) {
+            _environment = [HIAHProcessEnvironmentDictionary(_environmentEntries.bytes) copy];
+        }
+        return _environment;
+    }
+}
+
+- (void)setEnvironment:(NSDictionary<NSString *, NSString *> *)environment {
+    @synchronized (self) {
+        _environment = [environment copy];
+    }
+}
+
+- (void)setRequestIdentifier:(NSUUID *)requestIdentifier {
+    if (_requestIdentifier == requestIdentifier || [_requestIdentifier isEqual:requestIdentifier]) {
+        return;
+    }
+    _requestIdentifier = requestIdentifier;
+    [self.kernel reindexProcess:self];
+}
+
 + (instancetype)processWithPath:(NSString *)path
                       arguments:(NSArray<NSString *> *)arguments
                     environment:(NSDictionary<NSString *, NSString *> *)environment {
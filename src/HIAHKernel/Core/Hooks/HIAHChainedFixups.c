@@ -0,0 +1,458 @@
+/**
+ * HIAHChainedFixups.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Import → bind slot table built from LC_DYLD_CHAINED_FIXUPS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHChainedFixups.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Layout constants, as in <mach-o/fixup-chains.h>
+#define HIAH_CHAINED_HEADER_SIZE        28
+#define HIAH_CHAINED_SEGMENT_HEADER     22      // dyld_chained_starts_in_segment up to page_start[]
+#define HIAH_CHAINED_PAGE_NONE          0xFFFF
+#define HIAH_CHAINED_PAGE_MULTI         0x8000
+
+#define HIAH_CHAINED_IMPORT             1
+#define HIAH_CHAINED_IMPORT_ADDEND      2
+#define HIAH_CHAINED_IMPORT_ADDEND64    3
+
+#define HIAH_CHAINED_PTR_ARM64E             1
+#define HIAH_CHAINED_PTR_64                 2
+#define HIAH_CHAINED_PTR_64_OFFSET          6
+#define HIAH_CHAINED_PTR_ARM64E_USERLAND    9
+#define HIAH_CHAINED_PTR_ARM64E_USERLAND24  12
+
+/**
+ * Binds of all the imports that share one name.
+ */
+typedef struct {
+    uint32_t hash;         // Hash of the name without the leading '_'
+    uint32_t import;       // First import with the name
+    size_t first;          // Into binds
+    size_t count;
+} HIAHChainedGroup;
+
+struct HIAHChainedFixups {
+    HIAHChainedImport *imports;
+    uint32_t importCount;
+    uint32_t *importGroups;    // Import ordinal → group
+    HIAHChainedGroup *groups;  // Sorted by (hash, name)
+    uint32_t groupCount;
+    HIAHChainedBind *binds;    // Grouped, in chain order within a group
+    size_t bindCount;
+};
+
+typedef struct {
+    HIAHChainedBind *binds;
+    size_t count;
+    size_t capacity;
+} HIAHChainedBindList;
+
+// MARK: - Helpers
+
+static uint16_t HIAHChainedRead16(const uint8_t *p) {
+    return (uint16_t)(p[0] | p[1] << 8);
+}
+
+static uint32_t HIAHChainedRead32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint64_t HIAHChainedRead64(const uint8_t *p) {
+    return (uint64_t)HIAHChainedRead32(p) | (uint64_t)HIAHChainedRead32(p + 4) << 32;
+}
+
+// FNV-1a
+static uint32_t HIAHChainedHash(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// C symbols carry a leading underscore in the symbol pool
+static const char *HIAHChainedCName(const char *name) {
+    return name[0] == '_' ? name + 1 : name;
+}
+
+static int64_t HIAHChainedSignExtend(uint64_t value, unsigned bits) {
+    uint64_t sign = 1ull << (bits - 1);
+    return (int64_t)((value ^ sign) - sign);
+}
+
+static bool HIAHChainedAppend(HIAHChainedBindList *list, HIAHChainedBind bind) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 256;
+        HIAHChainedBind *grown = realloc(list->binds, capacity * sizeof(*grown));
+        if (!grown) {
+            return false;
+        }
+        list->binds = grown;
+        list->capacity = capacity;
+    }
+    list->binds[list->count++] = bind;
+    return true;
+}
+
+// MARK: - Imports
+
+static size_t HIAHChainedImportSize(uint32_t importsFormat) {
+    switch (importsFormat) {
+        case HIAH_CHAINED_IMPORT:          return 4;
+        case HIAH_CHAINED_IMPORT_ADDEND:   return 8;
+        case HIAH_CHAINED_IMPORT_ADDEND64: return 16;
+        default:                           return 0;
+    }
+}
+
+// The import table's bounds are checked by the caller
+static bool HIAHChainedParseImports(HIAHChainedFixups *fixups, const uint8_t *data, size_t size,
+                                    uint32_t importsOffset, uint32_t importsFormat,
+                                    uint32_t symbolsOffset) {
+    size_t entrySize = HIAHChainedImportSize(importsFormat);
+    if (symbolsOffset > size) {
+        return false;
+    }
+
+    const char *pool = (const char *)data + symbolsOffset;
+    size_t poolSize = size - symbolsOffset;
+    for (uint32_t i = 0; i < fixups->importCount; i++) {
+        const uint8_t *entry = data + importsOffset + (size_t)i * entrySize;
+        HIAHChainedImport *import = &fixups->imports[i];
+        uint64_t nameOffset;
+        if (importsFormat == HIAH_CHAINED_IMPORT_ADDEND64) {
+            uint64_t raw = HIAHChainedRead64(entry);
+            import->libraryOrdinal = (int16_t)(raw & 0xFFFF);
+            import->weak = (raw >> 16) & 1;
+            nameOffset = raw >> 32;
+        } else {
+            uint32_t raw = HIAHChainedRead32(entry);
+            import->libraryOrdinal = (int8_t)(raw & 0xFF);
+            import->weak = (raw >> 8) & 1;
+            nameOffset = raw >> 9;
+        }
+        if (nameOffset >= poolSize || !memchr(pool + nameOffset, '\0', poolSize - nameOffset)) {
+            return false;
+        }
+        import->name = pool + nameOffset;
+    }
+    return true;
+}
+
+// Addend an import contributes on top of the one encoded in the pointer
+static int64_t HIAHChainedImportAddend(const uint8_t *data, uint32_t importsOffset,
+                                       uint32_t importsFormat, uint32_t ordinal) {
+    if (importsFormat == HIAH_CHAINED_IMPORT_ADDEND) {
+        return (int32_t)HIAHChainedRead32(data + importsOffset + (size_t)ordinal * 8 + 4);
+    }
+    if (importsFormat == HIAH_CHAINED_IMPORT_ADDEND64) {
+        return (int64_t)HIAHChainedRead64(data + importsOffset + (size_t)ordinal * 16 + 8);
+    }
+    return 0;
+}
+
+typedef struct {
+    uint32_t hash;
+    uint32_t import;
+    const char *name;
+} HIAHChainedImportKey;
+
+static int HIAHChainedCompareImports(const void *a, const void *b) {
+    const HIAHChainedImportKey *left = a;
+    const HIAHChainedImportKey *right = b;
+    if (left->hash != right->hash) {
+        return left->hash < right->hash ? -1 : 1;
+    }
+    int order = strcmp(left->name, right->name);
+    if (order != 0) {
+        return order;
+    }
+    return left->import < right->import ? -1 : left->import > right->import;
+}
+
+/**
+ * Gives every distinct import name a group, ordered by (hash, name).
+ */
+static bool HIAHChainedGroupImports(HIAHChainedFixups *fixups) {
+    uint32_t count = fixups->importCount;
+    HIAHChainedImportKey *keys = malloc((count ? count : 1) * sizeof(HIAHChainedImportKey));
+    fixups->groups = malloc((count ? count : 1) * sizeof(HIAHChainedGroup));
+    if (!keys || !fixups->groups) {
+        free(keys);
+        return false;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const char *name = fixups->imports[i].name;
+        keys[i] = (HIAHChainedImportKey){ HIAHChainedHash(HIAHChainedCName(name)), i, name };
+    }
+    qsort(keys, count, sizeof(HIAHChainedImportKey), HIAHChainedCompareImports);
+
+    uint32_t groupCount = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (i == 0 || keys[i].hash != keys[i - 1].hash || strcmp(keys[i].name, keys[i - 1].name) != 0) {
+            fixups->groups[groupCount++] = (HIAHChainedGroup){
+                .hash = keys[i].hash,
+                .import = keys[i].import,
+            };
+        }
+        fixups->importGroups[keys[i].import] = groupCount - 1;
+    }
+    fixups->groupCount = groupCount;
+    free(keys);
+    return true;
+}
+
+// MARK: - Chains
+
+static unsigned HIAHChainedStride(uint16_t format) {
+    switch (format) {
+        case HIAH_CHAINED_PTR_ARM64E:
+        case HIAH_CHAINED_PTR_ARM64E_USERLAND:
+        case HIAH_CHAINED_PTR_ARM64E_USERLAND24:
+            return 8;
+        case HIAH_CHAINED_PTR_64:
+        case HIAH_CHAINED_PTR_64_OFFSET:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Decodes one chain link. Returns the distance to the next link in strides
+ * (0 at the end of the chain) and fills `bind` if the link is a bind.
+ */
+static uint32_t HIAHChainedDecode(uint64_t raw, uint16_t format, bool *isBind, HIAHChainedBind *bind) {
+    if (format == HIAH_CHAINED_PTR_64 || format == HIAH_CHAINED_PTR_64_OFFSET) {
+        // bind:1 next:12 reserved:19 addend:8 ordinal:24
+        *isBind = (raw >> 63) & 1;
+        if (*isBind) {
+            bind->import = (uint32_t)(raw & 0xFFFFFF);
+            bind->addend = (int64_t)((raw >> 24) & 0xFF);
+        }
+        return (uint32_t)((raw >> 51) & 0xFFF);
+    }
+
+    // auth:1 bind:1 next:11, then auth binds carry key:2 addrDiv:1
+    // diversity:16 and plain binds a 19-bit addend above a 16 or 24-bit ordinal
+    bool auth = (raw >> 63) & 1;
+    *isBind = (raw >> 62) & 1;
+    if (*isBind) {
+        uint64_t ordinalMask = format == HIAH_CHAINED_PTR_ARM64E_USERLAND24 ? 0xFFFFFF : 0xFFFF;
+        bind->import = (uint32_t)(raw & ordinalMask);
+        if (auth) {
+            bind->diversity = (uint16_t)((raw >> 32) & 0xFFFF);
+            bind->flags = HIAH_CHAINED_BIND_AUTH;
+            if ((raw >> 48) & 1) {
+                bind->flags |= HIAH_CHAINED_BIND_ADDRESS_DIVERSITY;
+            }
+            bind->key = (uint8_t)((raw >> 49) & 3);
+        } else {
+            bind->addend = HIAHChainedSignExtend((raw >> 32) & 0x7FFFF, 19);
+        }
+    }
+    return (uint32_t)((raw >> 51) & 0x7FF);
+}
+
+static bool HIAHChainedWalkSegment(const HIAHChainedFixups *fixups, const uint8_t *data, size_t size,
+                                   size_t startsOffset, uint32_t segmentIndex,
+                                   const HIAHChainedSegment *segment,
+                                   uint32_t importsOffset, uint32_t importsFormat,
+                                   HIAHChainedBindList *list) {
+    if (startsOffset > size || size - startsOffset < HIAH_CHAINED_SEGMENT_HEADER) {
+        return false;
+    }
+    const uint8_t *starts = data + startsOffset;
+    uint16_t pageSize = HIAHChainedRead16(starts + 4);
+    uint16_t format = HIAHChainedRead16(starts + 6);
+    uint16_t pageCount = HIAHChainedRead16(starts + 20);
+    unsigned stride = HIAHChainedStride(format);
+    if (stride == 0 || pageSize == 0 ||
+        (size - startsOffset - HIAH_CHAINED_SEGMENT_HEADER) / 2 < pageCount) {
+        return false;
+    }
+
+    for (uint16_t page = 0; page < pageCount; page++) {
+        uint16_t start = HIAHChainedRead16(starts + HIAH_CHAINED_SEGMENT_HEADER + page * 2);
+        if (start == HIAH_CHAINED_PAGE_NONE) {
+            continue;
+        }
+        if (start & HIAH_CHAINED_PAGE_MULTI) {
+            return false;   // Only used by 32-bit formats
+        }
+
+        uint64_t offset = (uint64_t)page * pageSize + start;
+        for (;;) {
+            if (offset > segment->size || segment->size - offset < 8) {
+                return false;
+            }
+            HIAHChainedBind bind = { .offset = offset, .segment = segmentIndex };
+            bool isBind = false;
+            uint32_t next = HIAHChainedDecode(HIAHChainedRead64(segment->data + offset),
+                                              format, &isBind, &bind);
+            if (isBind) {
+                if (bind.import >= fixups->importCount) {
+                    return false;
+                }
+                bind.addend += HIAHChainedImportAddend(data, importsOffset, importsFormat, bind.import);
+                if (!HIAHChainedAppend(list, bind)) {
+                    return false;
+                }
+            }
+            if (next == 0) {
+                break;
+            }
+            offset += (uint64_t)next * stride;
+        }
+    }
+    return true;
+}
+
+// MARK: - Table
+
+HIAHChainedFixups *HIAHChainedFixupsCreate(const uint8_t *data, size_t size,
+                                           const HIAHChainedSegment *segments,
+                                           uint32_t segmentCount) {
+    if (!data || size < HIAH_CHAINED_HEADER_SIZE) {
+        return NULL;
+    }
+    uint32_t version = HIAHChainedRead32(data);
+    uint32_t startsOffset = HIAHChainedRead32(data + 4);
+    uint32_t importsOffset = HIAHChainedRead32(data + 8);
+    uint32_t symbolsOffset = HIAHChainedRead32(data + 12);
+    uint32_t importCount = HIAHChainedRead32(data + 16);
+    uint32_t importsFormat = HIAHChainedRead32(data + 20);
+    uint32_t symbolsFormat = HIAHChainedRead32(data + 24);
+    size_t importSize = HIAHChainedImportSize(importsFormat);
+    if (version != 0 || symbolsFormat != 0 || importSize == 0 ||
+        startsOffset > size || size - startsOffset < 4 ||
+        importsOffset > size || (size - importsOffset) / importSize < importCount) {
+        return NULL;
+    }
+
+    HIAHChainedFixups *fixups = calloc(1, sizeof(*fixups));
+    if (!fixups) {
+        return NULL;
+    }
+    fixups->importCount = importCount;
+    fixups->imports = calloc(importCount ? importCount : 1, sizeof(HIAHChainedImport));
+    fixups->importGroups = calloc(importCount ? importCount : 1, sizeof(uint32_t));
+    if (!fixups->imports || !fixups->importGroups ||
+        !HIAHChainedParseImports(fixups, data, size, importsOffset, importsFormat, symbolsOffset) ||
+        !HIAHChainedGroupImports(fixups)) {
+        HIAHChainedFixupsDestroy(fixups);
+        return NULL;
+    }
+
+    // Walk every segment's chains
+    HIAHChainedBindList list = { NULL, 0, 0 };
+    const uint8_t *startsInImage = data + startsOffset;
+    uint32_t chainedSegments = HIAHChainedRead32(startsInImage);
+    bool valid = (size - startsOffset - 4) / 4 >= chainedSegments;
+    for (uint32_t i = 0; valid && i < chainedSegments; i++) {
+        uint32_t segmentOffset = HIAHChainedRead32(startsInImage + 4 + (size_t)i * 4);
+        if (segmentOffset == 0) {
+            continue;   // No fixups in this segment
+        }
+        valid = i < segmentCount &&
+                HIAHChainedWalkSegment(fixups, data, size, (size_t)startsOffset + segmentOffset, i,
+                                       &segments[i], importsOffset, importsFormat, &list);
+    }
+    if (!valid) {
+        free(list.binds);
+        HIAHChainedFixupsDestroy(fixups);
+        return NULL;
+    }
+
+    // Group the binds by name (counting sort on the import's group)
+    fixups->binds = malloc((list.count ? list.count : 1) * sizeof(HIAHChainedBind));
+    if (!fixups->binds) {
+        free(list.binds);
+        HIAHChainedFixupsDestroy(fixups);
+        return NULL;
+    }
+    for (size_t i = 0; i < list.count; i++) {
+        fixups->groups[fixups->importGroups[list.binds[i].import]].count++;
+    }
+    size_t first = 0;
+    for (uint32_t g = 0; g < fixups->groupCount; g++) {
+        fixups->groups[g].first = first;
+        first += fixups->groups[g].count;
+        fixups->groups[g].count = 0;
+    }
+    for (size_t i = 0; i < list.count; i++) {
+        HIAHChainedGroup *group = &fixups->groups[fixups->importGroups[list.binds[i].import]];
+        fixups->binds[group->first + group->count++] = list.binds[i];
+    }
+    fixups->bindCount = list.count;
+    free(list.binds);
+    return fixups;
+}
+
+void HIAHChainedFixupsDestroy(HIAHChainedFixups *fixups) {
+    if (!fixups) {
+        return;
+    }
+    free(fixups->imports);
+    free(fixups->importGroups);
+    free(fixups->groups);
+    free(fixups->binds);
+    free(fixups);
+}
+
+uint32_t HIAHChainedFixupsImportCount(const HIAHChainedFixups *fixups) {
+    return fixups ? fixups->importCount : 0;
+}
+
+const HIAHChainedImport *HIAHChainedFixupsImport(const HIAHChainedFixups *fixups,
+                                                 uint32_t ordinal) {
+    if (!fixups || ordinal >= fixups->importCount) {
+        return NULL;
+    }
+    return &fixups->imports[ordinal];
+}
+
+const HIAHChainedBind *HIAHChainedFixupsBinds(const HIAHChainedFixups *fixups,
+                                              size_t *count) {
+    *count = fixups ? fixups->bindCount : 0;
+    return fixups ? fixups->binds : NULL;
+}
+
+const HIAHChainedBind *HIAHChainedFixupsFind(const HIAHChainedFixups *fixups,
+                                             const char *name,
+                                             size_t *count) {
+    *count = 0;
+    if (!fixups || !name || fixups->groupCount == 0) {
+        return NULL;
+    }
+
+    uint32_t hash = HIAHChainedHash(name);
+    size_t low = 0;
+    size_t high = fixups->groupCount;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (fixups->groups[mid].hash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    for (size_t i = low; i < fixups->groupCount && fixups->groups[i].hash == hash; i++) {
+        const HIAHChainedGroup *group = &fixups->groups[i];
+        if (strcmp(HIAHChainedCName(fixups->imports[group->import].name), name) == 0) {
+            *count = group->count;
+            return group->count ? &fixups->binds[group->first] : NULL;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,110 @@
+/**
+ * HIAHChainedFixups.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Import → bind slot table built from LC_DYLD_CHAINED_FIXUPS.
+ *
+ * Images linked with chained fixups carry no lazy pointer sections for most
+ * of their binds: each data page holds a chain of encoded pointers that dyld
+ * walks and overwrites at load time. The starts of those chains and the
+ * import table live in __LINKEDIT; the chains themselves only exist in the
+ * file, since dyld replaces every link with the bound value. The table is
+ * therefore built from the segment contents as stored on disk, once, and
+ * afterwards maps a symbol name to every slot bound to it.
+ *
+ * Pointer formats DYLD_CHAINED_PTR_ARM64E (1), _64 (2), _64_OFFSET (6),
+ * _ARM64E_USERLAND (9) and _ARM64E_USERLAND24 (12) are understood.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_CHAINED_FIXUPS_H
+#define HIAH_CHAINED_FIXUPS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct HIAHChainedFixups HIAHChainedFixups;
+
+/**
+ * Contents of one segment as stored in the file, chains intact. Segments
+ * are numbered in load command order, as in dyld_chained_starts_in_image.
+ */
+typedef struct {
+    const uint8_t *data;
+    uint64_t size;
+} HIAHChainedSegment;
+
+#define HIAH_CHAINED_BIND_AUTH              0x01    // arm64e authenticated pointer
+#define HIAH_CHAINED_BIND_ADDRESS_DIVERSITY 0x02    // Discriminator blends in the slot address
+
+/**
+ * One bind slot.
+ */
+typedef struct {
+    uint64_t offset;       // From the start of the segment
+    int64_t addend;
+    uint32_t segment;
+    uint32_t import;       // Import ordinal
+    uint16_t diversity;    // Authenticated binds: discriminator
+    uint8_t key;           // Authenticated binds: IA, IB, DA, DB
+    uint8_t flags;
+} HIAHChainedBind;
+
+typedef struct {
+    const char *name;          // Mangled, with its leading underscore
+    int32_t libraryOrdinal;    // Negative for the special ordinals
+    bool weak;
+} HIAHChainedImport;
+
+/**
+ * Builds the table.
+ *
+ * @param fixups The LC_DYLD_CHAINED_FIXUPS payload. Import names point into
+ *               it, so it must outlive the table.
+ * @param segments File contents of the image's segments; they are only read
+ *                 while building
+ * @return The table, or NULL if the fixups are malformed, use a pointer
+ *         format not listed above, or memory runs out
+ */
+HIAHChainedFixups *HIAHChainedFixupsCreate(const uint8_t *fixups, size_t size,
+                                           const HIAHChainedSegment *segments,
+                                           uint32_t segmentCount);
+
+void HIAHChainedFixupsDestroy(HIAHChainedFixups *fixups);
+
+uint32_t HIAHChainedFixupsImportCount(const HIAHChainedFixups *fixups);
+
+const HIAHChainedImport *HIAHChainedFixupsImport(const HIAHChainedFixups *fixups,
+                                                 uint32_t ordinal);
+
+/**
+ * Every bind slot, grouped by symbol name.
+ */
+const HIAHChainedBind *HIAHChainedFixupsBinds(const HIAHChainedFixups *fixups,
+                                              size_t *count);
+
+/**
+ * Finds every slot bound to a symbol, whichever import(s) name it.
+ *
+ * @param name C symbol name, without the leading underscore ("posix_spawn")
+ * @param count Receives the number of slots
+ * @return The first slot, or NULL if no import has that name
+ */
+const HIAHChainedBind *HIAHChainedFixupsFind(const HIAHChainedFixups *fixups,
+                                             const char *name,
+                                             size_t *count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_CHAINED_FIXUPS_H */
@@ -0,0 +1,137 @@
+/**
+ * HIAHExportTrie.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Mach-O export trie lookup.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHExportTrie.h"
+#include <string.h>
+
+// MARK: - Reading
+
+typedef struct {
+    const uint8_t *cursor;
+    const uint8_t *end;
+} HIAHTrieReader;
+
+static bool HIAHTrieReadULEB(HIAHTrieReader *reader, uint64_t *value) {
+    uint64_t result = 0;
+    unsigned shift = 0;
+    while (reader->cursor < reader->end) {
+        uint8_t byte = *reader->cursor++;
+        if (shift >= 64 || (shift == 63 && (byte & 0x7f) > 1)) {
+            return false;
+        }
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns a NUL-terminated string inside the trie and steps over it
+static const char *HIAHTrieReadString(HIAHTrieReader *reader) {
+    const char *string = (const char *)reader->cursor;
+    const uint8_t *nul = memchr(reader->cursor, '\0', (size_t)(reader->end - reader->cursor));
+    if (!nul) {
+        return NULL;
+    }
+    reader->cursor = nul + 1;
+    return string;
+}
+
+static bool HIAHTrieReadTerminal(HIAHTrieReader *reader, HIAHExport *result) {
+    memset(result, 0, sizeof(*result));
+    if (!HIAHTrieReadULEB(reader, &result->flags)) {
+        return false;
+    }
+    if (result->flags & HIAH_EXPORT_REEXPORT) {
+        if (!HIAHTrieReadULEB(reader, &result->ordinal)) {
+            return false;
+        }
+        result->importName = HIAHTrieReadString(reader);
+        return result->importName != NULL;
+    }
+    if (!HIAHTrieReadULEB(reader, &result->address)) {
+        return false;
+    }
+    if (result->flags & HIAH_EXPORT_STUB_AND_RESOLVER) {
+        return HIAHTrieReadULEB(reader, &result->resolver);
+    }
+    return true;
+}
+
+// MARK: - Lookup
+
+bool HIAHExportTrieFind(const uint8_t *trie, size_t size, const char *symbol,
+                        HIAHExport *result) {
+    if (!trie || size == 0 || !symbol || !result) {
+        return false;
+    }
+
+    const uint8_t *end = trie + size;
+    uint64_t offset = 0;
+    // Every node visited moves strictly deeper, so a well-formed walk
+    // visits at most one node per trie byte
+    for (size_t visited = 0; visited <= size; visited++) {
+        HIAHTrieReader reader = { trie + offset, end };
+        uint64_t terminalSize;
+        if (!HIAHTrieReadULEB(&reader, &terminalSize) ||
+            terminalSize > (uint64_t)(end - reader.cursor)) {
+            return false;
+        }
+
+        if (*symbol == '\0') {
+            if (terminalSize == 0) {
+                return false;
+            }
+            HIAHTrieReader terminal = { reader.cursor, reader.cursor + terminalSize };
+            return HIAHTrieReadTerminal(&terminal, result);
+        }
+
+        reader.cursor += terminalSize;
+        if (reader.cursor >= end) {
+            return false;
+        }
+        uint8_t childCount = *reader.cursor++;
+
+        bool descended = false;
+        for (uint8_t i = 0; i < childCount; i++) {
+            // Match the edge against the symbol in the same pass that
+            // steps over it, rather than scanning it three times
+            size_t edgeLength = 0;
+            bool matches = true;
+            while (reader.cursor < end && *reader.cursor != '\0') {
+                matches = matches && (uint8_t)symbol[edgeLength] == *reader.cursor;
+                edgeLength += matches;
+                reader.cursor++;
+            }
+            uint64_t childOffset;
+            if (reader.cursor++ >= end || !HIAHTrieReadULEB(&reader, &childOffset)) {
+                return false;
+            }
+            if (edgeLength == 0 || !matches) {
+                continue;
+            }
+            // Children must lie after their parent, which rules out cycles
+            if (childOffset <= offset || childOffset >= size) {
+                return false;
+            }
+            symbol += edgeLength;
+            offset = childOffset;
+            descended = true;
+            break;
+        }
+        if (!descended) {
+            return false;
+        }
+    }
+    return false;
+}
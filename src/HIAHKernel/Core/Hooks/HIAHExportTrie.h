@@ -0,0 +1,60 @@
+/**
+ * HIAHExportTrie.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Mach-O export trie lookup.
+ *
+ * dyld publishes an image's exported symbols as a prefix trie, found through
+ * LC_DYLD_EXPORTS_TRIE or the export range of LC_DYLD_INFO(_ONLY). Looking
+ * a symbol up walks one edge per shared prefix instead of searching the
+ * symbol table. The walker is bounds-checked against the trie size and
+ * rejects malformed or cyclic tries, so it is safe on untrusted input.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_EXPORT_TRIE_H
+#define HIAH_EXPORT_TRIE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Export flags, as in <mach-o/loader.h>
+#define HIAH_EXPORT_KIND_MASK          0x03
+#define HIAH_EXPORT_KIND_REGULAR       0x00
+#define HIAH_EXPORT_KIND_THREAD_LOCAL  0x01
+#define HIAH_EXPORT_KIND_ABSOLUTE      0x02
+#define HIAH_EXPORT_WEAK_DEFINITION    0x04
+#define HIAH_EXPORT_REEXPORT           0x08
+#define HIAH_EXPORT_STUB_AND_RESOLVER  0x10
+
+typedef struct {
+    uint64_t flags;
+    uint64_t address;          // Offset from the mach header (absolute value for KIND_ABSOLUTE)
+    uint64_t resolver;         // Resolver offset (STUB_AND_RESOLVER)
+    uint64_t ordinal;          // Dylib ordinal the symbol comes from (REEXPORT)
+    const char *importName;    // Name in that dylib, "" if unchanged (REEXPORT)
+} HIAHExport;
+
+/**
+ * Looks `symbol` up in an export trie.
+ *
+ * @param symbol Mangled name, with its leading underscore ("_posix_spawn")
+ * @return false if the symbol is not exported or the trie is malformed
+ */
+bool HIAHExportTrieFind(const uint8_t *trie, size_t size, const char *symbol,
+                        HIAHExport *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_EXPORT_TRIE_H */
@@ -0,0 +1,217 @@
+/**
+ * HIAHFileActions.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Lock-free file action side table, with a locked overflow list for
+ * when the table fills up.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHFileActions.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Concurrent spawners each hold one object between init and destroy, so a
+// few hundred slots leave the table sparse
+#define HIAH_FILE_ACTIONS_SLOTS  256
+#define HIAH_FILE_ACTIONS_INLINE 6
+
+// No object lives at these addresses
+#define HIAH_FILE_ACTIONS_EMPTY     ((uintptr_t)0)
+#define HIAH_FILE_ACTIONS_TOMBSTONE ((uintptr_t)1)
+
+typedef struct HIAHFileActionsEntry {
+    _Atomic uintptr_t key;
+    uint32_t count;
+    uint32_t capacity;    // Of `spill`
+    HIAHFileAction *spill;
+    HIAHFileAction inlineActions[HIAH_FILE_ACTIONS_INLINE];
+    bool overflow;                        // Heap entry in the overflow list...
+    struct HIAHFileActionsEntry *next;    // ...followed by this one
+} HIAHFileActionsEntry;
+
+static HIAHFileActionsEntry g_entries[HIAH_FILE_ACTIONS_SLOTS];
+static atomic_size_t g_liveEntries;
+
+// Entries that found the table full. Only walked while non-empty, so the
+// lock stays off the usual path.
+static pthread_mutex_t g_overflowLock = PTHREAD_MUTEX_INITIALIZER;
+static HIAHFileActionsEntry *g_overflow;
+static atomic_size_t g_overflowEntries;
+
+static inline size_t HIAHFileActionsHome(uintptr_t key) {
+    // Objects are at least 8-byte aligned; mix the rest
+    uint64_t h = (uint64_t)key * 0x9e3779b97f4a7c15ull;
+    return (size_t)(h >> 40) & (HIAH_FILE_ACTIONS_SLOTS - 1);
+}
+
+static HIAHFileActionsEntry *HIAHFileActionsLookup(uintptr_t key) {
+    size_t slot = HIAHFileActionsHome(key);
+    for (size_t probe = 0; probe < HIAH_FILE_ACTIONS_SLOTS; probe++) {
+        HIAHFileActionsEntry *entry = &g_entries[(slot + probe) & (HIAH_FILE_ACTIONS_SLOTS - 1)];
+        uintptr_t current = atomic_load_explicit(&entry->key, memory_order_acquire);
+        if (current == key) {
+            return entry;
+        }
+        if (current == HIAH_FILE_ACTIONS_EMPTY) {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+static HIAHFileActionsEntry *HIAHFileActionsClaim(uintptr_t key) {
+    size_t slot = HIAHFileActionsHome(key);
+    for (size_t probe = 0; probe < HIAH_FILE_ACTIONS_SLOTS; probe++) {
+        HIAHFileActionsEntry *entry = &g_entries[(slot + probe) & (HIAH_FILE_ACTIONS_SLOTS - 1)];
+        uintptr_t current = atomic_load_explicit(&entry->key, memory_order_relaxed);
+        if ((current == HIAH_FILE_ACTIONS_EMPTY || current == HIAH_FILE_ACTIONS_TOMBSTONE) &&
+            atomic_compare_exchange_strong_explicit(&entry->key, &current, key,
+                                                    memory_order_acquire,
+                                                    memory_order_relaxed)) {
+            // The previous owner left the entry empty
+            atomic_fetch_add_explicit(&g_liveEntries, 1, memory_order_relaxed);
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static HIAHFileActionsEntry *HIAHFileActionsOverflowLookup(uintptr_t key) {
+    if (atomic_load_explicit(&g_overflowEntries, memory_order_acquire) == 0) {
+        return NULL;
+    }
+    pthread_mutex_lock(&g_overflowLock);
+    HIAHFileActionsEntry *entry = g_overflow;
+    while (entry && atomic_load_explicit(&entry->key, memory_order_relaxed) != key) {
+        entry = entry->next;
+    }
+    pthread_mutex_unlock(&g_overflowLock);
+    // The entry stays put until its own object forgets it
+    return entry;
+}
+
+static HIAHFileActionsEntry *HIAHFileActionsOverflowClaim(uintptr_t key) {
+    HIAHFileActionsEntry *entry = calloc(1, sizeof(HIAHFileActionsEntry));
+    if (!entry) {
+        return NULL;
+    }
+    atomic_init(&entry->key, key);
+    entry->overflow = true;
+    pthread_mutex_lock(&g_overflowLock);
+    entry->next = g_overflow;
+    g_overflow = entry;
+    atomic_fetch_add_explicit(&g_overflowEntries, 1, memory_order_release);
+    pthread_mutex_unlock(&g_overflowLock);
+    atomic_fetch_add_explicit(&g_liveEntries, 1, memory_order_relaxed);
+    return entry;
+}
+
+static void HIAHFileActionsOverflowRemove(HIAHFileActionsEntry *entry) {
+    pthread_mutex_lock(&g_overflowLock);
+    HIAHFileActionsEntry **link = &g_overflow;
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    atomic_fetch_sub_explicit(&g_overflowEntries, 1, memory_order_release);
+    pthread_mutex_unlock(&g_overflowLock);
+    free(entry->spill);
+    free(entry);
+    atomic_fetch_sub_explicit(&g_liveEntries, 1, memory_order_relaxed);
+}
+
+// An object's entry is in the table or in the overflow list, never both:
+// it is only claimed after both came up empty, by the one thread using it
+static HIAHFileActionsEntry *HIAHFileActionsFind(uintptr_t key) {
+    HIAHFileActionsEntry *entry = HIAHFileActionsLookup(key);
+    return entry ? entry : HIAHFileActionsOverflowLookup(key);
+}
+
+static inline const HIAHFileAction *HIAHFileActionsItems(const HIAHFileActionsEntry *entry) {
+    return entry->spill ? entry->spill : entry->inlineActions;
+}
+
+bool HIAHFileActionsRecord(const void *fileActions, HIAHFileAction action) {
+    uintptr_t key = (uintptr_t)fileActions;
+    if (key <= HIAH_FILE_ACTIONS_TOMBSTONE) {
+        return false;
+    }
+
+    HIAHFileActionsEntry *entry = HIAHFileActionsFind(key);
+    if (!entry && !(entry = HIAHFileActionsClaim(key)) &&
+        !(entry = HIAHFileActionsOverflowClaim(key))) {
+        return false;
+    }
+
+    if (!entry->spill && entry->count < HIAH_FILE_ACTIONS_INLINE) {
+        entry->inlineActions[entry->count++] = action;
+        return true;
+    }
+
+    if (!entry->spill || entry->count == entry->capacity) {
+        uint32_t capacity = entry->capacity ? entry->capacity * 2 : HIAH_FILE_ACTIONS_INLINE * 2;
+        HIAHFileAction *spill = realloc(entry->spill, capacity * sizeof(*spill));
+        if (!spill) {
+            return false;
+        }
+        if (!entry->spill) {
+            memcpy(spill, entry->inlineActions, entry->count * sizeof(*spill));
+        }
+        entry->spill = spill;
+        entry->capacity = capacity;
+    }
+    entry->spill[entry->count++] = action;
+    return true;
+}
+
+size_t HIAHFileActionsCopy(const void *fileActions, HIAHFileAction **actions) {
+    *actions = NULL;
+    uintptr_t key = (uintptr_t)fileActions;
+    if (key <= HIAH_FILE_ACTIONS_TOMBSTONE) {
+        return 0;
+    }
+
+    HIAHFileActionsEntry *entry = HIAHFileActionsFind(key);
+    if (!entry || entry->count == 0) {
+        return 0;
+    }
+    HIAHFileAction *copy = malloc(entry->count * sizeof(*copy));
+    if (!copy) {
+        return 0;
+    }
+    memcpy(copy, HIAHFileActionsItems(entry), entry->count * sizeof(*copy));
+    *actions = copy;
+    return entry->count;
+}
+
+void HIAHFileActionsForget(const void *fileActions) {
+    uintptr_t key = (uintptr_t)fileActions;
+    if (key <= HIAH_FILE_ACTIONS_TOMBSTONE) {
+        return;
+    }
+
+    HIAHFileActionsEntry *entry = HIAHFileActionsFind(key);
+    if (!entry) {
+        return;
+    }
+    if (entry->overflow) {
+        HIAHFileActionsOverflowRemove(entry);
+        return;
+    }
+    free(entry->spill);
+    entry->spill = NULL;
+    entry->count = 0;
+    entry->capacity = 0;
+    // Later keys may have probed past this slot, so it cannot become empty
+    atomic_store_explicit(&entry->key, HIAH_FILE_ACTIONS_TOMBSTONE, memory_order_release);
+    atomic_fetch_sub_explicit(&g_liveEntries, 1, memory_order_relaxed);
+}
+
+size_t HIAHFileActionsCount(void) {
+    return atomic_load_explicit(&g_liveEntries, memory_order_relaxed);
+}
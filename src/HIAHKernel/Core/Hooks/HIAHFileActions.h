@@ -0,0 +1,84 @@
+/**
+ * HIAHFileActions.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Side table of the file actions recorded on posix_spawn_file_actions_t
+ * objects, so an in-process spawn can replay them on the guest thread.
+ *
+ * Entries are keyed by the object's address in a fixed open-addressing
+ * table. Slots are claimed and released with compare-and-swap; there is no
+ * lock. A posix_spawn_file_actions_t may not be used from two threads at
+ * once, so only one thread at a time touches a given entry's actions, and
+ * the handoff between a released slot and its next owner is ordered by the
+ * key's acquire/release atomics. Most entries fit the few actions a pipe
+ * setup needs inline; longer lists spill to the heap.
+ *
+ * Released slots become tombstones that the next claim in their probe
+ * sequence reuses, so lookups stay short under steady churn.
+ *
+ * If every slot is taken, further entries go to a heap list behind a lock.
+ * The list is only searched while it holds something, so a full table
+ * costs speed, not correctness.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_FILE_ACTIONS_H
+#define HIAH_FILE_ACTIONS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    HIAHFileActionClose = 1,
+    HIAHFileActionDup2  = 2,
+} HIAHFileActionType;
+
+typedef struct {
+    int32_t type;
+    int32_t fd;
+    int32_t newFd;    // Dup2 only
+} HIAHFileAction;
+
+/**
+ * Appends an action to the list for `fileActions`, creating the entry on
+ * first use.
+ *
+ * @return false if memory runs out; the action is then not replayed
+ */
+bool HIAHFileActionsRecord(const void *fileActions, HIAHFileAction action);
+
+/**
+ * Copies the actions recorded for `fileActions`.
+ *
+ * @param actions Receives a malloc'd array (free it), or NULL if there are
+ *                none or memory runs out
+ * @return The number of actions copied
+ */
+size_t HIAHFileActionsCopy(const void *fileActions, HIAHFileAction **actions);
+
+/**
+ * Drops the entry for `fileActions`, if any. Call when the object is
+ * initialized or destroyed, so a later object at the same address starts
+ * empty.
+ */
+void HIAHFileActionsForget(const void *fileActions);
+
+/**
+ * @return The number of live entries (diagnostics)
+ */
+size_t HIAHFileActionsCount(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_FILE_ACTIONS_H */
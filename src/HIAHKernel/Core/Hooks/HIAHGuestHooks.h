@@ -20,8 +20,14 @@ NS_ASSUME_NONNULL_BEGIN
  * Hooks installed:
  * - posix_spawn: Intercepts process creation, redirects to dlopen or kernel
  * - posix_spawn_file_actions_adddup2/addclose: Tracks pipe setup
+ * - posix_spawn_file_actions_init/destroy: Drop the tracked actions
  * - execve: Intercepts exec calls, handles SSH specially
- * - waitpid: Handles thread-based pseudo-PIDs
+ * - waitpid: Waits for virtual children (see HIAHChildRegistry.h), including
+ *   WNOHANG, any-child and process-group waits; kernel-run children are
+ *   waited for through the kernel
+ *
+ * In-process guests get virtual PIDs and report their exit code when their
+ * entry point returns. SIGCHLD is raised on this process for each exit.
  */
 __attribute__((visibility("default")))
 void HIAHInstallHooks(void);
@@ -45,5 +51,16 @@ void HIAHDisableHooksForCurrentThread(void);
 __attribute__((visibility("default")))
 void HIAHEnableHooksForCurrentThread(void);
 
+/**
+ * Sends the hook call counts and latency histograms gathered since the last
+ * publish to the kernel (see HIAHHookMetrics.h), waiting for the reply.
+ * Runs at exit, and on a utility queue shortly after in-process guests
+ * finish (once for guests that finish together, after their parents have
+ * been woken); does nothing when the kernel socket is unset or metrics are
+ * compiled out.
+ */
+__attribute__((visibility("default")))
+void HIAHGuestHooksPublishMetrics(void);
+
 NS_ASSUME_NONNULL_END
 
@@ -7,7 +7,15 @@
  */
 
 #import "HIAHGuestHooks.h"
+#import "HIAHChildRegistry.h"
+#import "HIAHChildWatcher.h"
+#import "HIAHControlChannel.h"
+#import "HIAHControlEnvironment.h"
+#import "HIAHControlProtocol.h"
+#import "HIAHFileActions.h"
 #import "HIAHHook.h"
+#import "HIAHHookMetrics.h"
+#import "HIAHImagePool.h"
 #import <Foundation/Foundation.h>
 #import <spawn.h>
 #import <dlfcn.h>
@@ -21,44 +29,23 @@
 #import <sys/stat.h>
 #import <pthread.h>
 #import <fcntl.h>
+#import <signal.h>
+#import <stdatomic.h>
 #import <stdint.h>
 
 #pragma mark - File Actions Tracking
 
-typedef enum {
-    HIAHActionClose,
-    HIAHActionDup2,
-    HIAHActionOpen
-} HIAHActionType;
-
-typedef struct {
-    HIAHActionType type;
-    int fd;
-    int new_fd;
-    char *path;
-    int oflag;
-    mode_t mode;
-} HIAHAction;
-
 typedef struct HIAHThreadArgs {
+    pid_t pid;                  // Virtual
     char *path;
     int argc;
     char **argv;
-    NSArray *actions;
+    HIAHFileAction *actions;    // Replayed on the guest thread
+    size_t actionCount;
 } HIAHThreadArgs;
 
-static NSMutableDictionary<NSValue *, NSMutableArray *> *g_actions_map = nil;
-static NSLock *g_actions_lock = nil;
 static BOOL g_hooksInstalled = NO;
 
-static void HIAHInitActions(void) {
-    static dispatch_once_t onceToken;
-    dispatch_once(&onceToken, ^{
-        g_actions_map = [[NSMutableDictionary alloc] init];
-        g_actions_lock = [[NSLock alloc] init];
-    });
-}
-
 #pragma mark - Thread-Local Hook Control
 
 static __thread BOOL gInHook = NO;
@@ -75,47 +62,106 @@ BOOL HIAHHooksInstalled(void) {
     return g_hooksInstalled;
 }
 
+#pragma mark - Virtual Children
+
+// Well above any PID the host or the kernel hands out
+#define HIAH_GUEST_FIRST_VIRTUAL_PID 0x10000000
+
+// Set on guest threads; spawns and waits made there belong to that guest
+static __thread pid_t t_virtualPid;
+
+static pid_t HIAHCurrentPid(void) {
+    return t_virtualPid ? t_virtualPid : getpid();
+}
+
+// Every guest shares this process, so SIGCHLD can only be sent to it
+static void HIAHChildExited(pid_t parent, pid_t child, int status, void *context) {
+    kill(getpid(), SIGCHLD);
+}
+
+// Children of this process and of its in-process guests
+static HIAHChildRegistry *HIAHChildren(void) {
+    static HIAHChildRegistry *children;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        children = HIAHChildRegistryCreate(HIAH_GUEST_FIRST_VIRTUAL_PID, HIAHChildExited, NULL);
+    });
+    return children;
+}
+
+static pid_t HIAHForwardWaitAny(int *status, void *context);
+
+// Reports the exits of children forwarded to the kernel to HIAHChildren(),
+// so waits for any child or a group see them too
+static HIAHChildWatcher *HIAHForwardedChildren(void) {
+    static HIAHChildWatcher *watcher;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        HIAHChildRegistry *children = HIAHChildren();
+        if (children) watcher = HIAHChildWatcherCreate(children, HIAHForwardWaitAny, NULL);
+    });
+    return watcher;
+}
+
+// The group posix_spawn() would put the child in: < 0 for the parent's
+static pid_t HIAHSpawnGroup(const posix_spawnattr_t *attr) {
+    short flags = 0;
+    pid_t group = 0;
+    if (!attr || posix_spawnattr_getflags(attr, &flags) != 0 || !(flags & POSIX_SPAWN_SETPGROUP)) return -1;
+    if (posix_spawnattr_getpgroup(attr, &group) != 0) return -1;
+    return group;
+}
+
 #pragma mark - File Action Hooks
 
 typedef int (*ps_fa_adddup2_t)(posix_spawn_file_actions_t *, int, int);
 typedef int (*ps_fa_addclose_t)(posix_spawn_file_actions_t *, int);
+typedef int (*ps_fa_init_t)(posix_spawn_file_actions_t *);
+typedef int (*ps_fa_destroy_t)(posix_spawn_file_actions_t *);
+
+// Actions live in HIAHFileActions' side table from init to destroy. Only
+// those the real call accepted are recorded, so the replay matches what a
+// real spawn would have done. An action that cannot be recorded fails
+// the call with ENOMEM, as the real one does when it cannot grow.
+DEFINE_HOOK(posix_spawn_file_actions_init, int, (posix_spawn_file_actions_t *fa)) {
+    // A new object at the address of one never destroyed starts empty
+    HIAHFileActionsForget(fa);
+    return ORIG_FUNC(posix_spawn_file_actions_init)(fa);
+}
+
+DEFINE_HOOK(posix_spawn_file_actions_destroy, int, (posix_spawn_file_actions_t *fa)) {
+    HIAHFileActionsForget(fa);
+    return ORIG_FUNC(posix_spawn_file_actions_destroy)(fa);
+}
 
 DEFINE_HOOK(posix_spawn_file_actions_adddup2, int, (posix_spawn_file_actions_t *fa, int fd, int new_fd)) {
-    HIAHInitActions();
-    [g_actions_lock lock];
-    NSValue *key = [NSValue valueWithPointer:fa];
-    if (!g_actions_map[key]) g_actions_map[key] = [NSMutableArray array];
-    
-    HIAHAction *a = calloc(1, sizeof(HIAHAction));
-    a->type = HIAHActionDup2;
-    a->fd = fd;
-    a->new_fd = new_fd;
-    [g_actions_map[key] addObject:[NSValue valueWithPointer:a]];
-    NSLog(@"[HIAHHook] Captured file action: dup2(%d, %d)", fd, new_fd);
-    [g_actions_lock unlock];
-    
-    return ORIG_FUNC(posix_spawn_file_actions_adddup2)(fa, fd, new_fd);
+    HIAH_HOOK_METRICS_SCOPE(HIAHHookMetricFileActionsAddDup2);
+    int result = ORIG_FUNC(posix_spawn_file_actions_adddup2)(fa, fd, new_fd);
+    if (result == 0 &&
+        !HIAHFileActionsRecord(fa, (HIAHFileAction){ HIAHFileActionDup2, fd, new_fd })) {
+        // Replaying without it would wire the child's stdio wrong
+        NSLog(@"[HIAHHook] Could not track file action dup2(%d, %d)", fd, new_fd);
+        return ENOMEM;
+    }
+    return result;
 }
 
 DEFINE_HOOK(posix_spawn_file_actions_addclose, int, (posix_spawn_file_actions_t *fa, int fd)) {
-    HIAHInitActions();
-    [g_actions_lock lock];
-    NSValue *key = [NSValue valueWithPointer:fa];
-    if (!g_actions_map[key]) g_actions_map[key] = [NSMutableArray array];
-    
-    HIAHAction *a = calloc(1, sizeof(HIAHAction));
-    a->type = HIAHActionClose;
-    a->fd = fd;
-    [g_actions_map[key] addObject:[NSValue valueWithPointer:a]];
-    [g_actions_lock unlock];
-    
-    return ORIG_FUNC(posix_spawn_file_actions_addclose)(fa, fd);
+    HIAH_HOOK_METRICS_SCOPE(HIAHHookMetricFileActionsAddClose);
+    int result = ORIG_FUNC(posix_spawn_file_actions_addclose)(fa, fd);
+    if (result == 0 &&
+        !HIAHFileActionsRecord(fa, (HIAHFileAction){ HIAHFileActionClose, fd, -1 })) {
+        NSLog(@"[HIAHHook] Could not track file action close(%d)", fd);
+        return ENOMEM;
+    }
+    return result;
 }
 
 #pragma mark - Forward Declarations
 
 static void *HIAHGuestThread(void *data);
-static int HIAHForwardSpawn(pid_t *pid, const char *path, char *const argv[], char *const envp[]);
+static int HIAHForwardSpawn(pid_t *pid, pid_t parent, const char *path, char *const argv[], char *const envp[]);
+static pid_t HIAHForwardWait(pid_t pid, int options, int *status);
 static int HIAHInProcessSpawn(pid_t *pid, const char *path,
                               const posix_spawn_file_actions_t *file_actions,
                               const posix_spawnattr_t *attr,
@@ -142,7 +188,8 @@ static int hook_posix_spawn(pid_t * __restrict pid, const char * __restrict path
                             const posix_spawn_file_actions_t * __restrict file_actions,
                             const posix_spawnattr_t * __restrict attr,
                             char *const argv[ __restrict], char *const envp[ __restrict]) {
-    
+    HIAH_HOOK_METRICS_SCOPE(HIAHHookMetricPosixSpawn);
+
     if (gInHook || getenv("HIAH_NO_HOOKS")) {
         return ORIG_FUNC(posix_spawn)(pid, path, file_actions, attr, argv, envp);
     }
@@ -183,36 +230,13 @@ static int hook_posix_spawn(pid_t * __restrict pid, const char * __restrict path
         }
         
         if (sshDylibPath) {
-            HIAHThreadArgs *targs = calloc(1, sizeof(HIAHThreadArgs));
-            targs->path = strdup([sshDylibPath UTF8String]);
-            int argc = 0;
-            while (argv[argc]) argc++;
-            targs->argc = argc;
-            targs->argv = malloc(sizeof(char *) * (argc + 1));
-            for (int i = 0; i < argc; i++) targs->argv[i] = strdup(argv[i]);
-            targs->argv[argc] = NULL;
-            
-            HIAHInitActions();
-            [g_actions_lock lock];
-            NSValue *key = [NSValue valueWithPointer:file_actions];
-            if (g_actions_map[key]) {
-                targs->actions = [g_actions_map[key] copy];
-            }
-            [g_actions_lock unlock];
-            
-            pthread_t thread;
-            if (pthread_create(&thread, NULL, HIAHGuestThread, targs) != 0) {
-                gInHook = NO;
-                return EAGAIN;
-            }
-            
-            #pragma clang diagnostic push
-            #pragma clang diagnostic ignored "-Wint-to-pointer-cast"
-            #pragma clang diagnostic ignored "-Wpointer-to-int-cast"
-            if (pid) *pid = (pid_t)(uintptr_t)thread;
-            #pragma clang diagnostic pop
-            NSLog(@"[HIAHHook] SSH started in thread (pseudo-PID: %lu)", (unsigned long)thread);
+            pid_t sshPid = 0;
+            int result = HIAHInProcessSpawn(&sshPid, [sshDylibPath UTF8String], file_actions, attr,
+                                            (char *const *)argv, (char *const *)envp);
             gInHook = NO;
+            if (result != 0) return EAGAIN;
+            if (pid) *pid = sshPid;
+            NSLog(@"[HIAHHook] SSH started in thread (PID: %d)", sshPid);
             return 0;
         }
     }
@@ -233,8 +257,17 @@ static int hook_posix_spawn(pid_t * __restrict pid, const char * __restrict path
         return ORIG_FUNC(posix_spawn)(pid, path, file_actions, attr, argv, envp);
     }
     
-    int result = HIAHForwardSpawn(pid, path, (char *const *)argv, (char *const *)envp);
+    // The kernel runs it and reports its exit to the watcher, which may
+    // hear of it before the spawn returns
+    HIAHChildWatcher *watcher = HIAHForwardedChildren();
+    if (watcher) HIAHChildWatcherWillSpawn(watcher);
+    pid_t childPid = 0;
+    int result = HIAHForwardSpawn(&childPid, getpid(), path, (char *const *)argv, (char *const *)envp);
+    if (watcher) {
+        HIAHChildWatcherDidSpawn(watcher, HIAHCurrentPid(), HIAHSpawnGroup(attr), result == 0 ? childPid : -1);
+    }
     if (result == 0) {
+        if (pid) *pid = childPid;
         gInHook = NO;
         return 0;
     }
@@ -244,6 +277,7 @@ static int hook_posix_spawn(pid_t * __restrict pid, const char * __restrict path
 }
 
 static int hook_execve(const char *path, char *const argv[], char *const envp[]) {
+    HIAH_HOOK_METRICS_SCOPE(HIAHHookMetricExecve);
     if (gInHook || getenv("HIAH_NO_HOOKS")) {
         return ORIG_FUNC(execve)(path, argv, envp);
     }
@@ -316,7 +350,7 @@ static int hook_execve(const char *path, char *const argv[], char *const envp[])
 
     // Try forwarding
     pid_t pid;
-    int result = HIAHForwardSpawn(&pid, path, (char *const *)argv, (char *const *)envp);
+    int result = HIAHForwardSpawn(&pid, 0, path, (char *const *)argv, (char *const *)envp);
     if (result == 0) {
         exit(0);
     }
@@ -326,40 +360,68 @@ static int hook_execve(const char *path, char *const argv[], char *const envp[])
 }
 
 static pid_t hook_waitpid(pid_t pid, int *stat_loc, int options) {
+    HIAH_HOOK_METRICS_SCOPE(HIAHHookMetricWaitpid);
     if (gInHook || getenv("HIAH_NO_HOOKS")) {
         return ORIG_FUNC(waitpid)(pid, stat_loc, options);
     }
     
-    // Handle thread-based pseudo-PIDs
-    if (pid > 100000) {
-        #pragma clang diagnostic push
-        #pragma clang diagnostic ignored "-Wint-to-pointer-cast"
-        pthread_t thread = (pthread_t)(uintptr_t)pid;
-        #pragma clang diagnostic pop
-        if (options & WNOHANG) return 0;
-        pthread_join(thread, NULL);
-        if (stat_loc) *stat_loc = 0;
-        return pid;
+    HIAHChildRegistry *children = HIAHChildren();
+    pid_t self = HIAHCurrentPid();
+    if (!children) {
+        return ORIG_FUNC(waitpid)(pid, stat_loc, options);
+    }
+
+    // A child the kernel runs: its exit is learned by asking
+    HIAHChildInfo info;
+    if (pid > 0 && HIAHChildRegistryLookup(children, pid, &info) &&
+        info.parent == self && info.external && !info.exited) {
+        int status = 0;
+        pid_t result = HIAHForwardWait(pid, options, &status);
+        if (result == 0) return 0;
+        if (result < 0) {
+            HIAHChildRegistryRemove(children, pid);
+        } else {
+            HIAHChildRegistryExit(children, pid, status);
+        }
+        // Hands the status to exactly one of any racing waiters
+        return HIAHChildRegistryWait(children, self, pid, stat_loc, WNOHANG);
+    }
+
+    // Virtual children, and forwarded ones while the watcher reports their
+    // exits; anything else is a real child of this process
+    if (HIAHChildRegistryHasChildren(children, self, pid)) {
+        return HIAHChildRegistryWait(children, self, pid, stat_loc, options);
     }
-    
     return ORIG_FUNC(waitpid)(pid, stat_loc, options);
 }
 
 #pragma mark - In-Process Thread Spawning
 
+static void HIAHGuestHooksSchedulePublish(void);
+
+static void HIAHThreadArgsFree(HIAHThreadArgs *args) {
+    for (int i = 0; i < args->argc; i++) free(args->argv[i]);
+    free(args->argv);
+    free(args->actions);
+    free(args->path);
+    free(args);
+}
+
 static void *HIAHGuestThread(void *data) {
     HIAHThreadArgs *args = (HIAHThreadArgs *)data;
-    NSLog(@"[HIAHHook] Guest thread started: %s", args->path);
+    t_virtualPid = args->pid;
+    NSLog(@"[HIAHHook] Guest thread started: %s (PID %d)", args->path, args->pid);
+
+    // What a shell reports when the command cannot be run
+    int status = W_EXITCODE(127, 0);
     
     // Apply file actions
-    if (args->actions && args->actions.count > 0) {
-        for (NSValue *val in args->actions) {
-            HIAHAction *a = [val pointerValue];
-            if (a->type == HIAHActionDup2) {
-                dup2(a->fd, a->new_fd);
-            } else if (a->type == HIAHActionClose) {
-                close(a->fd);
-            }
+    for (size_t i = 0; i < args->actionCount; i++) {
+        const HIAHFileAction *a = &args->actions[i];
+        if (a->type == HIAHFileActionDup2) {
+            dup2(a->fd, a->newFd);
+        } else if (a->type == HIAHFileActionClose) {
+            close(a->fd);
         }
     }
     
@@ -371,16 +433,19 @@ static void *HIAHGuestThread(void *data) {
         setenv("SSHPASS", hiahPass, 1);
     }
     
-    void *handle = dlopen(args->path, RTLD_NOW | RTLD_GLOBAL);
-    if (!handle) {
-        NSLog(@"[HIAHHook] dlopen failed: %s", dlerror());
+    // Repeated spawns of the same tool reuse the warm image and its entry
+    HIAHImagePool *pool = HIAHImagePoolShared();
+    char error[512];
+    HIAHImage *image = HIAHImagePoolAcquire(pool, args->path, error, sizeof(error));
+    if (!image) {
+        NSLog(@"[HIAHHook] dlopen failed: %s", error);
         goto cleanup;
     }
     
-    int (*entry)(int, char **) = dlsym(handle, "ssh_main");
-    if (!entry) entry = dlsym(handle, "waypipe_main");
-    if (!entry) entry = dlsym(handle, "hello_entry");
-    if (!entry) entry = dlsym(handle, "main");
+    static const char *const entryNames[] = {
+        "ssh_main", "waypipe_main", "hello_entry", "main", NULL
+    };
+    int (*entry)(int, char **) = HIAHImageFindEntry(pool, image, entryNames, NULL);
     
     if (entry) {
         NSLog(@"[HIAHHook] Calling entry point with %d args", args->argc);
@@ -390,13 +455,16 @@ static void *HIAHGuestThread(void *data) {
         fflush(stdout);
         fflush(stderr);
         NSLog(@"[HIAHHook] Guest thread finished: %d", rc);
+        status = W_EXITCODE(rc & 0xff, 0);
     }
+    HIAHImagePoolRelease(pool, image);
     
 cleanup:
-    for (int i = 0; i < args->argc; i++) free(args->argv[i]);
-    free(args->argv);
-    free(args->path);
-    free(args);
+    // Wakes the parent's waitpid() and raises SIGCHLD. The metrics go to the
+    // kernel afterwards, off the exit path.
+    HIAHChildRegistryExit(HIAHChildren(), args->pid, status);
+    HIAHThreadArgsFree(args);
+    HIAHGuestHooksSchedulePublish();
     return NULL;
 }
 
@@ -413,48 +481,171 @@ static int HIAHInProcessSpawn(pid_t *pid, const char *path,
     for (int i = 0; i < argc; i++) targs->argv[i] = strdup(argv[i]);
     targs->argv[argc] = NULL;
     
-    HIAHInitActions();
-    [g_actions_lock lock];
-    NSValue *key = [NSValue valueWithPointer:file_actions];
-    if (g_actions_map[key]) {
-        targs->actions = [g_actions_map[key] copy];
+    targs->actionCount = HIAHFileActionsCopy(file_actions, &targs->actions);
+
+    // Registered before the thread starts so it can exit at once
+    HIAHChildRegistry *children = HIAHChildren();
+    pid_t childPid = children ? HIAHChildRegistryAdd(children, HIAHCurrentPid(), HIAHSpawnGroup(attr), 0) : -1;
+    if (childPid < 0) {
+        HIAHThreadArgsFree(targs);
+        return -1;
     }
-    [g_actions_lock unlock];
-    
+    targs->pid = childPid;
+
+    // Nobody joins it: waitpid() collects its status from the registry
     pthread_t thread;
-    if (pthread_create(&thread, NULL, HIAHGuestThread, targs) != 0) {
-        free(targs->path);
-        free(targs->argv);
-        free(targs);
+    pthread_attr_t threadAttr;
+    pthread_attr_init(&threadAttr);
+    pthread_attr_setdetachstate(&threadAttr, PTHREAD_CREATE_DETACHED);
+    int created = pthread_create(&thread, &threadAttr, HIAHGuestThread, targs);
+    pthread_attr_destroy(&threadAttr);
+    if (created != 0) {
+        HIAHChildRegistryRemove(children, childPid);
+        HIAHThreadArgsFree(targs);
         return -1;
     }
-    #pragma clang diagnostic push
-    #pragma clang diagnostic ignored "-Wint-to-pointer-cast"
-    #pragma clang diagnostic ignored "-Wpointer-to-int-cast"
-    if (pid) *pid = (pid_t)(uintptr_t)thread;
-    #pragma clang diagnostic pop
+    if (pid) *pid = childPid;
     return 0;
 }
 
-static int HIAHForwardSpawn(pid_t *pid, const char *path, char *const argv[], char *const envp[]) {
-    const char *kernelSocketPath = getenv("HIAH_KERNEL_SOCKET");
-    if (!kernelSocketPath) return -1;
+// The kernel connection shared by every thread of this guest, opened on
+// first use. NULL outside a kernel.
+static HIAHControlChannel *HIAHKernelChannel(void) {
+    static HIAHControlChannel *channel;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        const char *kernelSocketPath = getenv("HIAH_KERNEL_SOCKET");
+        if (kernelSocketPath) {
+            channel = HIAHControlChannelCreate(kernelSocketPath);
+        }
+    });
+    return channel;
+}
 
-    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
-    if (sock < 0) return -1;
+// This guest's environment as it was at the first forwarded spawn; spawns
+// send their environment relative to it. The kernel's handle for it is
+// dropped when the kernel forgets the base, and registered again on the
+// next spawn.
+static pthread_mutex_t g_environmentLock = PTHREAD_MUTEX_INITIALIZER;
+static HIAHControlEnvironmentBase *g_environmentBase;
+static uint64_t g_environmentHandle;
+static BOOL g_environmentRefused;    // Kernels older than environment deltas
 
-    struct sockaddr_un addr;
-    memset(&addr, 0, sizeof(addr));
-    addr.sun_family = AF_UNIX;
-    strncpy(addr.sun_path, kernelSocketPath, sizeof(addr.sun_path) - 1);
-    
-    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
-        close(sock);
-        return -1;
+static uint64_t HIAHRegisteredEnvironment(HIAHControlChannel *channel, const HIAHControlEnvironmentBase **base) {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        extern char **environ;
+        g_environmentBase = HIAHControlEnvironmentBaseCreate((const char *const *)environ);
+    });
+    *base = g_environmentBase;
+    if (!g_environmentBase) return 0;
+
+    pthread_mutex_lock(&g_environmentLock);
+    uint64_t handle = g_environmentHandle;
+    BOOL refused = g_environmentRefused;
+    pthread_mutex_unlock(&g_environmentLock);
+    if (handle || refused) return handle;
+
+    // Not under the lock: racing registrations of the same base get the same
+    // handle from the kernel
+    size_t count = 0;
+    const char *const *entries = HIAHControlEnvironmentBaseEntries(g_environmentBase, &count);
+    HIAHControlWriter writer;
+    HIAHControlWriterInit(&writer, HIAHControlMessageEnvironment);
+    HIAHControlWriterAddStringArray(&writer, HIAHControlFieldEnvironment, entries, count);
+
+    uint8_t *buffer = NULL;
+    size_t length = 0;
+    HIAHControlReader reader;
+    BOOL answered = NO;
+    if (HIAHControlChannelCall(channel, &writer, &buffer, &length) == HIAHControlChannelOK &&
+        HIAHControlReaderInit(&reader, buffer, length, NULL)) {
+        answered = YES;
+        HIAHControlField field;
+        while (HIAHControlReaderNext(&reader, &field) == 1) {
+            if (field.tag == HIAHControlFieldEnvHandle) handle = (uint64_t)HIAHControlFieldInt(&field);
+        }
     }
+    free(buffer);
+    HIAHControlWriterFree(&writer);
+
+    pthread_mutex_lock(&g_environmentLock);
+    g_environmentHandle = handle;
+    g_environmentRefused = answered && !handle;
+    pthread_mutex_unlock(&g_environmentLock);
+    return handle;
+}
+
+static void HIAHForgetEnvironment(uint64_t handle) {
+    pthread_mutex_lock(&g_environmentLock);
+    if (g_environmentHandle == handle) g_environmentHandle = 0;
+    pthread_mutex_unlock(&g_environmentLock);
+}
+
+static HIAHControlChannelResult HIAHForwardSpawnBinary(HIAHControlChannel *channel, int *result, pid_t *pid,
+                                                       pid_t parent, const char *path, char *const argv[],
+                                                       char *const envp[]) {
+    // Usually only a few entries differ from the registered base
+    const HIAHControlEnvironmentBase *base = NULL;
+    uint64_t handle = HIAHRegisteredEnvironment(channel, &base);
+    HIAHControlEnvironmentDelta delta;
+    BOOL useDelta = handle && HIAHControlEnvironmentDiff(base, (const char *const *)envp, &delta);
+
+    HIAHControlChannelResult status;
+    for (;;) {
+        // argv and envp go out as-is; no intermediate objects on the hot path
+        HIAHControlWriter writer;
+        HIAHControlWriterInit(&writer, HIAHControlMessageSpawn);
+        HIAHControlWriterAddString(&writer, HIAHControlFieldPath, path);
+        // The kernel records the child as ours, to answer waits for any child
+        if (parent > 0) HIAHControlWriterAddInt(&writer, HIAHControlFieldParent, parent);
+        HIAHControlWriterAddStringArray(&writer, HIAHControlFieldArguments,
+                                        (argv && argv[0]) ? (const char *const *)argv + 1 : NULL, SIZE_MAX);
+        if (useDelta) {
+            HIAHControlWriterAddInt(&writer, HIAHControlFieldEnvHandle, (int64_t)handle);
+            HIAHControlWriterAddStringArray(&writer, HIAHControlFieldEnvironment, delta.changes, delta.changeCount);
+            HIAHControlWriterAddStringArray(&writer, HIAHControlFieldEnvRemoved, delta.removed, delta.removedCount);
+        } else {
+            HIAHControlWriterAddStringArray(&writer, HIAHControlFieldEnvironment, (const char *const *)envp, SIZE_MAX);
+        }
+
+        uint8_t *buffer = NULL;
+        size_t length = 0;
+        status = HIAHControlChannelCall(channel, &writer, &buffer, &length);
+        HIAHControlWriterFree(&writer);
+
+        *result = -1;
+        int64_t replyStatus = HIAHControlStatusError, childPid = 0;
+        HIAHControlReader reader;
+        if (status == HIAHControlChannelOK && HIAHControlReaderInit(&reader, buffer, length, NULL)) {
+            HIAHControlField field;
+            while (HIAHControlReaderNext(&reader, &field) == 1) {
+                if (field.tag == HIAHControlFieldStatus) replyStatus = HIAHControlFieldInt(&field);
+                else if (field.tag == HIAHControlFieldPid) childPid = HIAHControlFieldInt(&field);
+            }
+        }
+        free(buffer);
+
+        // The kernel evicted the base and spawned nothing: resend in full
+        if (useDelta && replyStatus == HIAHControlStatusUnknownEnvironment) {
+            HIAHForgetEnvironment(handle);
+            HIAHControlEnvironmentDeltaFree(&delta);
+            useDelta = NO;
+            continue;
+        }
+        if (replyStatus == HIAHControlStatusOK) {
+            if (pid) *pid = (pid_t)childPid;
+            *result = 0;
+        }
+        break;
+    }
+    if (useDelta) HIAHControlEnvironmentDeltaFree(&delta);
+    return status;
+}
 
+static int HIAHForwardSpawnJSON(int sock, pid_t *pid, const char *path, char *const argv[], char *const envp[]) {
     NSMutableArray *args = [NSMutableArray array];
-    if (argv) {
+    if (argv && argv[0]) {
         for (int i = 1; argv[i] != NULL; i++) {
             [args addObject:[NSString stringWithUTF8String:argv[i]]];
         }
@@ -482,21 +673,157 @@ static int HIAHForwardSpawn(pid_t *pid, const char *path, char *const argv[], ch
     write(sock, reqData.bytes, reqData.length);
     write(sock, "\n", 1);
 
-    char buffer[1024];
-    ssize_t n = read(sock, buffer, sizeof(buffer) - 1);
-    close(sock);
-    
-    if (n > 0) {
-        buffer[n] = '\0';
-        NSDictionary *resp = [NSJSONSerialization JSONObjectWithData:[NSData dataWithBytes:buffer length:n] 
-                                                             options:0 
+    // Replies are not size-limited; read up to the newline
+    uint8_t *buffer = NULL;
+    size_t capacity = 0, length = 0;
+    int result = -1;
+    if (HIAHControlReceiveLine(sock, &buffer, &capacity, &length)) {
+        NSDictionary *resp = [NSJSONSerialization JSONObjectWithData:[NSData dataWithBytesNoCopy:buffer
+                                                                                          length:length
+                                                                                    freeWhenDone:NO]
+                                                             options:0
                                                                error:nil];
         if ([resp[@"status"] isEqualToString:@"ok"]) {
             if (pid) *pid = [resp[@"pid"] intValue];
-            return 0;
+            result = 0;
+        }
+    }
+    free(buffer);
+    return result;
+}
+
+static int HIAHForwardSpawn(pid_t *pid, pid_t parent, const char *path, char *const argv[], char *const envp[]) {
+    HIAHControlChannel *channel = HIAHKernelChannel();
+    if (!channel || !path) return -1;
+
+    // Binary frames over the shared connection when the kernel speaks them.
+    // A spawn lost with a broken connection is not retried: the kernel may
+    // already have started it.
+    int result = -1;
+    if (HIAHForwardSpawnBinary(channel, &result, pid, parent, path, argv, envp) != HIAHControlChannelUnsupported) {
+        return result;
+    }
+
+    // JSON kernels get a connection per spawn
+    uint8_t version = 0;
+    int sock = HIAHControlConnect(getenv("HIAH_KERNEL_SOCKET"), &version);
+    if (sock < 0) return -1;
+    result = HIAHForwardSpawnJSON(sock, pid, path, argv, envp);
+    close(sock);
+    return result;
+}
+
+// Asks the kernel about a child it runs, or with `pid` -1 about any of this
+// process's forwarded children. Returns the PID once it exited (`status` in
+// wait() encoding), 0 while it runs under WNOHANG or when there is no child
+// left to wait for, or -1 if the kernel does not know it or cannot be asked.
+static pid_t HIAHForwardWait(pid_t pid, int options, int *status) {
+    HIAHControlChannel *channel = HIAHKernelChannel();
+    if (!channel) return -1;
+
+    HIAHControlWriter writer;
+    HIAHControlWriterInit(&writer, HIAHControlMessageWait);
+    HIAHControlWriterAddInt(&writer, HIAHControlFieldPid, pid);
+    HIAHControlWriterAddInt(&writer, HIAHControlFieldOptions, options);
+    if (pid == -1) HIAHControlWriterAddInt(&writer, HIAHControlFieldParent, getpid());
+
+    uint8_t *buffer = NULL;
+    size_t length = 0;
+    pid_t result = -1;
+    HIAHControlReader reader;
+    if (HIAHControlChannelCall(channel, &writer, &buffer, &length) == HIAHControlChannelOK &&
+        HIAHControlReaderInit(&reader, buffer, length, NULL)) {
+        int64_t replyStatus = HIAHControlStatusError, childPid = -1, exitCode = 0;
+        HIAHControlField field;
+        while (HIAHControlReaderNext(&reader, &field) == 1) {
+            if (field.tag == HIAHControlFieldStatus) replyStatus = HIAHControlFieldInt(&field);
+            else if (field.tag == HIAHControlFieldPid) childPid = HIAHControlFieldInt(&field);
+            else if (field.tag == HIAHControlFieldExitCode) exitCode = HIAHControlFieldInt(&field);
+        }
+        if (replyStatus == HIAHControlStatusOK && childPid >= 0) {
+            result = (pid_t)childPid;
+            if (result > 0) *status = W_EXITCODE((int)(exitCode & 0xff), 0);
+        } else if (replyStatus == HIAHControlStatusNoChild) {
+            result = 0;
+        }
+    }
+    free(buffer);
+    HIAHControlWriterFree(&writer);
+    return result;
+}
+
+// The watcher's wait. Kernels older than forwarded-child tracking answer it
+// with an error, and the watcher gives up.
+static pid_t HIAHForwardWaitAny(int *status, void *context) {
+    return HIAHForwardWait(-1, 0, status);
+}
+
+#pragma mark - Metrics
+
+void HIAHGuestHooksPublishMetrics(void) {
+#if HIAH_HOOK_METRICS
+    HIAHControlChannel *channel = HIAHKernelChannel();
+    if (!channel) return;
+
+    // The kernel adds up what it receives, so only calls made since the last
+    // successful publish are sent
+    static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    static HIAHHookMetric published[HIAHHookMetricCount];
+    pthread_mutex_lock(&lock);
+
+    HIAHHookMetric current[HIAHHookMetricCount];
+    HIAHHookMetric delta[HIAHHookMetricCount];
+    HIAHHookMetricsSnapshot(current);
+    BOOL changed = NO;
+    for (int h = 0; h < HIAHHookMetricCount; h++) {
+        delta[h] = current[h];
+        HIAHHookMetricsSubtract(&delta[h], &published[h]);
+        changed |= delta[h].calls > 0;
+    }
+
+    // Old kernels only speak JSON and have nowhere to put the metrics; the
+    // channel reports them as unsupported
+    if (changed) {
+        HIAHControlWriter writer;
+        HIAHControlWriterInit(&writer, HIAHControlMessageHookMetrics);
+        HIAHControlWriterAddInt(&writer, HIAHControlFieldPid, getpid());
+        HIAHHookMetricsEncode(&writer, delta);
+
+        uint8_t *buffer = NULL;
+        size_t length = 0;
+        HIAHControlReader reader;
+        if (HIAHControlChannelCall(channel, &writer, &buffer, &length) == HIAHControlChannelOK &&
+            HIAHControlReaderInit(&reader, buffer, length, NULL)) {
+            HIAHControlField field;
+            while (HIAHControlReaderNext(&reader, &field) == 1) {
+                if (field.tag == HIAHControlFieldStatus && HIAHControlFieldInt(&field) == 0) {
+                    memcpy(published, current, sizeof(published));
+                }
+            }
         }
+        free(buffer);
+        HIAHControlWriterFree(&writer);
     }
-    return -1;
+    pthread_mutex_unlock(&lock);
+#endif
+}
+
+// Guests that finish close together share one publish, sent from a utility
+// queue a moment after the first of them exits
+#define HIAH_GUEST_PUBLISH_DELAY_MS 100
+
+static void HIAHGuestHooksSchedulePublish(void) {
+#if HIAH_HOOK_METRICS
+    static atomic_bool pending;
+    if (atomic_exchange(&pending, true)) return;
+
+    dispatch_queue_t queue = dispatch_get_global_queue(QOS_CLASS_UTILITY, 0);
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, HIAH_GUEST_PUBLISH_DELAY_MS * NSEC_PER_MSEC), queue, ^{
+        // Cleared first, so calls counted after the snapshot get a publish of their own
+        atomic_store(&pending, false);
+        HIAHGuestHooksPublishMetrics();
+    });
+#endif
 }
 
 #pragma mark - Hook Installation
@@ -504,33 +831,46 @@ static int HIAHForwardSpawn(pid_t *pid, const char *path, char *const argv[], ch
 void HIAHInstallHooks(void) {
     static dispatch_once_t onceToken;
     dispatch_once(&onceToken, ^{
-        HIAHInitActions();
-        
         // Initialize original function pointers
         orig_posix_spawn = dlsym(RTLD_DEFAULT, "posix_spawn");
         orig_execve = dlsym(RTLD_DEFAULT, "execve");
         orig_waitpid = dlsym(RTLD_DEFAULT, "waitpid");
         orig_posix_spawn_file_actions_adddup2 = dlsym(RTLD_DEFAULT, "posix_spawn_file_actions_adddup2");
         orig_posix_spawn_file_actions_addclose = dlsym(RTLD_DEFAULT, "posix_spawn_file_actions_addclose");
+        orig_posix_spawn_file_actions_init = dlsym(RTLD_DEFAULT, "posix_spawn_file_actions_init");
+        orig_posix_spawn_file_actions_destroy = dlsym(RTLD_DEFAULT, "posix_spawn_file_actions_destroy");
         
-        // Install hooks
-        if (orig_posix_spawn) {
-            HIAHHookIntercept(HIAHHookScopeGlobal, NULL, orig_posix_spawn, hook_posix_spawn);
-        }
-        if (orig_execve) {
-            HIAHHookIntercept(HIAHHookScopeGlobal, NULL, orig_execve, hook_execve);
-        }
-        if (orig_waitpid) {
-            HIAHHookIntercept(HIAHHookScopeGlobal, NULL, orig_waitpid, hook_waitpid);
-        }
-        if (orig_posix_spawn_file_actions_adddup2) {
-            HIAHHookIntercept(HIAHHookScopeGlobal, NULL, orig_posix_spawn_file_actions_adddup2, hook_posix_spawn_file_actions_adddup2);
-        }
-        if (orig_posix_spawn_file_actions_addclose) {
-            HIAHHookIntercept(HIAHHookScopeGlobal, NULL, orig_posix_spawn_file_actions_addclose, hook_posix_spawn_file_actions_addclose);
-        }
+        // Install all hooks in one walk over the loaded images and keep them
+        // active for images loaded later (guest binaries, their dylibs).
+        // Rebinding by name also covers lazy pointers not bound yet.
+        HIAHHookBinding bindings[] = {
+            { orig_posix_spawn, hook_posix_spawn, "posix_spawn", 0 },
+            { orig_execve, hook_execve, "execve", 0 },
+            { orig_waitpid, hook_waitpid, "waitpid", 0 },
+            { orig_posix_spawn_file_actions_adddup2, hook_posix_spawn_file_actions_adddup2,
+              "posix_spawn_file_actions_adddup2", 0 },
+            { orig_posix_spawn_file_actions_addclose, hook_posix_spawn_file_actions_addclose,
+              "posix_spawn_file_actions_addclose", 0 },
+            { orig_posix_spawn_file_actions_init, hook_posix_spawn_file_actions_init,
+              "posix_spawn_file_actions_init", 0 },
+            { orig_posix_spawn_file_actions_destroy, hook_posix_spawn_file_actions_destroy,
+              "posix_spawn_file_actions_destroy", 0 },
+        };
+        HIAHHookInterceptPersistent(bindings, sizeof(bindings) / sizeof(bindings[0]));
+        NSLog(@"[HIAHHook] Rewrote posix_spawn:%u execve:%u waitpid:%u adddup2:%u addclose:%u "
+              @"init:%u destroy:%u",
+              bindings[0].rewritten, bindings[1].rewritten, bindings[2].rewritten,
+              bindings[3].rewritten, bindings[4].rewritten, bindings[5].rewritten,
+              bindings[6].rewritten);
+        HIAHHookStats stats;
+        HIAHHookGetStats(&stats);
+        NSLog(@"[HIAHHook] %llu sites in %llu page ranges, %llu vm_protect calls",
+              stats.sitesPatched, stats.pageRanges, stats.protectCalls);
         
         g_hooksInstalled = YES;
+#if HIAH_HOOK_METRICS
+        atexit(HIAHGuestHooksPublishMetrics);
+#endif
         NSLog(@"[HIAHKernel] Virtual kernel hooks installed");
     });
 }
@@ -14,119 +14,673 @@
  */
 
 #include "HIAHHook.h"
+#include "HIAHHookRegistry.h"
+#include "HIAHSymbolIndex.h"
+#include "HIAHExportTrie.h"
+#include "HIAHChainedFixups.h"
+#include "HIAHMachOFormat.h"
 #include <mach-o/dyld.h>
 #include <mach-o/nlist.h>
-#include <mach-o/getsect.h>
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
-// Pointer authentication support
-#if __arm64e__
-#include <ptrauth.h>
-#define HIAH_STRIP_PTR(ptr) ptrauth_strip(ptr, ptrauth_key_asia)
-#else
-#define HIAH_STRIP_PTR(ptr) (ptr)
-#endif
+#define HIAH_HOOK_INLINE_TARGETS 16
+
+// MARK: - Patching
+
+/**
+ * A pointer slot to rewrite. Sites are collected first and written in
+ * HIAHHookCommitPatches, grouped by page, so a hook that matches many slots
+ * costs one protection change per page range instead of two per slot.
+ */
+typedef struct {
+    void **slot;
+    void *value;               // Written as is (signed for authenticated slots)
+    HIAHHookBinding *binding;
+    size_t order;              // Collection order; the first site for a slot wins
+} HIAHHookPatch;
+
+typedef struct {
+    HIAHHookPatch *patches;
+    size_t count;
+    size_t capacity;
+} HIAHHookPatchList;
+
+static _Atomic uint64_t g_statSites;
+static _Atomic uint64_t g_statRanges;
+static _Atomic uint64_t g_statProtectCalls;
+static _Atomic uint64_t g_statRegionQueries;
+
+static HIAHHookRegistry *HIAHHookActive(void);
+
+static int HIAHHookComparePatches(const void *a, const void *b) {
+    const HIAHHookPatch *left = a;
+    const HIAHHookPatch *right = b;
+    if (left->slot != right->slot) {
+        return left->slot < right->slot ? -1 : 1;
+    }
+    return left->order < right->order ? -1 : left->order > right->order;
+}
 
 /**
- * Rewrites function pointers in a symbol pointer section.
+ * Writes the patches inside [start, end), which lies in one VM region with
+ * protection `protection`. Read-only memory is made writable for the
+ * duration and then given back exactly the protection it had.
  */
-static void HIAHHookRewriteSection(const HIAHMachHeader *header,
-                                    HIAHSection *section,
-                                    void *target,
-                                    void *replacement) {
-    // Get the actual section data location
-    unsigned long dataSize = 0;
-    void *sectionData = getsectiondata(header, section->segname, section->sectname, &dataSize);
+static void HIAHHookWriteChunk(uintptr_t start, uintptr_t end, vm_prot_t protection,
+                               HIAHHookPatch *patches, size_t count) {
+    bool writable = (protection & VM_PROT_WRITE) != 0;
+    if (!writable) {
+        atomic_fetch_add_explicit(&g_statProtectCalls, 1, memory_order_relaxed);
+        kern_return_t kr = vm_protect(mach_task_self(), start, end - start, FALSE,
+                                      protection | VM_PROT_WRITE | VM_PROT_COPY);
+        if (kr != KERN_SUCCESS) {
+            return;
+        }
+    }
     
-    if (!sectionData || dataSize == 0) {
-        return;
+    for (size_t i = 0; i < count; i++) {
+        *patches[i].slot = patches[i].value;
+        patches[i].binding->rewritten++;
     }
+    atomic_fetch_add_explicit(&g_statSites, count, memory_order_relaxed);
+    
+    if (!writable) {
+        atomic_fetch_add_explicit(&g_statProtectCalls, 1, memory_order_relaxed);
+        vm_protect(mach_task_self(), start, end - start, FALSE, protection);
+    }
+}
+
+/**
+ * Writes the patches of one contiguous page range, split wherever the range
+ * crosses into a VM region with a different protection.
+ */
+static void HIAHHookWriteRange(uintptr_t start, uintptr_t end,
+                               HIAHHookPatch *patches, size_t count) {
+    atomic_fetch_add_explicit(&g_statRanges, 1, memory_order_relaxed);
     
-    // Calculate number of pointers in section
-    size_t pointerCount = dataSize / sizeof(void *);
-    void **pointers = (void **)sectionData;
+    size_t next = 0;
+    uintptr_t cursor = start;
+    while (cursor < end && next < count) {
+        vm_address_t regionStart = cursor;
+        vm_size_t regionSize = 0;
+        vm_region_basic_info_data_64_t info;
+        mach_msg_type_number_t infoCount = VM_REGION_BASIC_INFO_COUNT_64;
+        mach_port_t objectName;
+        
+        atomic_fetch_add_explicit(&g_statRegionQueries, 1, memory_order_relaxed);
+        kern_return_t kr = vm_region_64(mach_task_self(), &regionStart, &regionSize,
+                                        VM_REGION_BASIC_INFO_64, (vm_region_info_t)&info,
+                                        &infoCount, &objectName);
+        if (kr != KERN_SUCCESS) {
+            return;
+        }
+        
+        // Sites before the region found (in an unmapped gap) are skipped
+        uintptr_t chunkStart = regionStart > cursor ? (uintptr_t)regionStart : cursor;
+        uintptr_t chunkEnd = (uintptr_t)regionStart + regionSize;
+        if (chunkEnd > end) {
+            chunkEnd = end;
+        }
+        while (next < count && (uintptr_t)patches[next].slot < chunkStart) {
+            next++;
+        }
+        size_t first = next;
+        while (next < count && (uintptr_t)patches[next].slot < chunkEnd) {
+            next++;
+        }
+        if (next > first) {
+            HIAHHookWriteChunk(chunkStart, chunkEnd, info.protection,
+                               &patches[first], next - first);
+        }
+        cursor = chunkEnd;
+    }
+}
+
+static void HIAHHookCommitPatches(HIAHHookPatchList *list) {
+    if (list->count == 0) {
+        return;
+    }
+    qsort(list->patches, list->count, sizeof(HIAHHookPatch), HIAHHookComparePatches);
     
-    // Strip pointer auth from target for comparison
-    void *strippedTarget = HIAH_STRIP_PTR(target);
+    // Drop later sites for a slot that is already being patched
+    size_t unique = 0;
+    for (size_t i = 0; i < list->count; i++) {
+        if (unique > 0 && list->patches[unique - 1].slot == list->patches[i].slot) {
+            continue;
+        }
+        list->patches[unique++] = list->patches[i];
+    }
+    list->count = unique;
     
-    // Scan and replace matching pointers
-    for (size_t i = 0; i < pointerCount; i++) {
-        void *current = HIAH_STRIP_PTR(pointers[i]);
+    uintptr_t pageMask = (uintptr_t)vm_page_size - 1;
+    size_t i = 0;
+    while (i < list->count) {
+        uintptr_t start = (uintptr_t)list->patches[i].slot & ~pageMask;
+        uintptr_t end = ((uintptr_t)(list->patches[i].slot + 1) + pageMask) & ~pageMask;
+        size_t j = i + 1;
         
-        if (current == strippedTarget) {
-            // Temporarily make memory writable
-            mach_vm_address_t addr = (mach_vm_address_t)&pointers[i];
-            kern_return_t kr;
-            
-            kr = vm_protect(mach_task_self(), addr, sizeof(void *), 
-                           FALSE, VM_PROT_READ | VM_PROT_WRITE | VM_PROT_COPY);
-            if (kr != KERN_SUCCESS) {
-                continue;
+        // Extend the range while the next site is on the same or the next page
+        while (j < list->count && ((uintptr_t)list->patches[j].slot & ~pageMask) <= end) {
+            uintptr_t siteEnd = ((uintptr_t)(list->patches[j].slot + 1) + pageMask) & ~pageMask;
+            if (siteEnd > end) {
+                end = siteEnd;
+            }
+            j++;
+        }
+        HIAHHookWriteRange(start, end, &list->patches[i], j - i);
+        i = j;
+    }
+    list->count = 0;
+}
+
+static void HIAHHookAddPatch(HIAHHookPatchList *list, void **slot,
+                             HIAHHookBinding *binding, void *value) {
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 64;
+        HIAHHookPatch *grown = realloc(list->patches, capacity * sizeof(*grown));
+        if (!grown) {
+            // Out of memory: patch this site on its own
+            HIAHHookPatch patch = { slot, value, binding, 0 };
+            HIAHHookPatchList single = { &patch, 1, 1 };
+            HIAHHookCommitPatches(&single);
+            return;
+        }
+        list->patches = grown;
+        list->capacity = capacity;
+    }
+    list->patches[list->count] = (HIAHHookPatch){
+        .slot = slot,
+        .value = value,
+        .binding = binding,
+        .order = list->count,
+    };
+    list->count++;
+}
+
+void HIAHHookGetStats(HIAHHookStats *stats) {
+    stats->sitesPatched = atomic_load_explicit(&g_statSites, memory_order_relaxed);
+    stats->pageRanges = atomic_load_explicit(&g_statRanges, memory_order_relaxed);
+    stats->protectCalls = atomic_load_explicit(&g_statProtectCalls, memory_order_relaxed);
+    stats->regionQueries = atomic_load_explicit(&g_statRegionQueries, memory_order_relaxed);
+    HIAHHookRegistryStats active = {0};
+    if (HIAHHookActive()) {
+        HIAHHookRegistryGetStats(HIAHHookActive(), &active);
+    }
+    stats->imagesReplayed = active.imagesReplayed;
+    stats->imagesAdded = active.imagesAdded;
+}
+
+static void HIAHHookCollectSlot(void **slot, HIAHHookBinding *binding, void *context) {
+    HIAHHookAddPatch(context, slot, binding, HIAH_STRIP_PTR(binding->replacement));
+}
+
+// MARK: - Image Caches
+
+/**
+ * Per-image lookup state: the symbol indexes of the images hooked by name
+ * so far, their chained fixup tables, and the memoized HIAHHookFindSymbol
+ * results. All are dropped when dyld unloads their image, since another
+ * image may later be mapped at the same address.
+ */
+static pthread_mutex_t g_indexLock = PTHREAD_MUTEX_INITIALIZER;
+static HIAHSymbolIndex **g_indexes;
+static size_t g_indexCount;
+static size_t g_indexCapacity;
+
+typedef struct {
+    char *name;            // NULL marks an empty bucket
+    uint32_t hash;
+    void *address;         // NULL memoizes a miss
+} HIAHHookExportEntry;
+
+typedef struct {
+    const HIAHMachHeader *header;
+    HIAHHookExportEntry *entries;   // Open addressing, power-of-two capacity
+    size_t count;
+    size_t capacity;
+} HIAHHookExportCache;
+
+static HIAHHookExportCache *g_exportCaches;
+static size_t g_exportCacheCount;
+static size_t g_exportCacheCapacity;
+
+typedef struct {
+    const HIAHMachHeader *header;
+    HIAHChainedFixups *fixups;      // NULL if the table could not be built
+    uintptr_t *segmentBases;        // Slid segment addresses, in load command order
+    uint32_t segmentCount;
+} HIAHHookChainedImage;
+
+static HIAHHookChainedImage *g_chained;
+static size_t g_chainedCount;
+static size_t g_chainedCapacity;
+
+static void HIAHHookForgetImage(const struct mach_header *header, intptr_t slide) {
+    (void)slide;
+    pthread_mutex_lock(&g_indexLock);
+    for (size_t i = 0; i < g_indexCount; i++) {
+        if (HIAHSymbolIndexImage(g_indexes[i]) == (const void *)header) {
+            HIAHSymbolIndexDestroy(g_indexes[i]);
+            g_indexes[i] = g_indexes[--g_indexCount];
+            break;
+        }
+    }
+    for (size_t i = 0; i < g_exportCacheCount; i++) {
+        HIAHHookExportCache *cache = &g_exportCaches[i];
+        if ((const void *)cache->header == (const void *)header) {
+            for (size_t j = 0; j < cache->capacity; j++) {
+                free(cache->entries[j].name);
             }
-            
-            // Write the replacement
-            pointers[i] = HIAH_STRIP_PTR(replacement);
-            
-            // Restore read-only protection
-            vm_protect(mach_task_self(), addr, sizeof(void *), 
-                      FALSE, VM_PROT_READ);
+            free(cache->entries);
+            *cache = g_exportCaches[--g_exportCacheCount];
+            break;
+        }
+    }
+    for (size_t i = 0; i < g_chainedCount; i++) {
+        if ((const void *)g_chained[i].header == (const void *)header) {
+            HIAHChainedFixupsDestroy(g_chained[i].fixups);
+            free(g_chained[i].segmentBases);
+            g_chained[i] = g_chained[--g_chainedCount];
+            break;
+        }
+    }
+    pthread_mutex_unlock(&g_indexLock);
+}
+
+static void HIAHHookRegisterForgetImage(void) {
+    _dyld_register_func_for_remove_image(HIAHHookForgetImage);
+}
+
+static void HIAHHookWatchRemovedImages(void) {
+    static pthread_once_t watchOnce = PTHREAD_ONCE_INIT;
+    pthread_once(&watchOnce, HIAHHookRegisterForgetImage);
+}
+
+// Caller holds g_indexLock
+static HIAHSymbolIndex *HIAHHookIndexForImage(const HIAHMachHeader *header) {
+    for (size_t i = 0; i < g_indexCount; i++) {
+        if (HIAHSymbolIndexImage(g_indexes[i]) == (const void *)header) {
+            return g_indexes[i];
+        }
+    }
+    
+    if (g_indexCount == g_indexCapacity) {
+        size_t capacity = g_indexCapacity ? g_indexCapacity * 2 : 64;
+        HIAHSymbolIndex **grown = realloc(g_indexes, capacity * sizeof(*grown));
+        if (!grown) {
+            return NULL;
+        }
+        g_indexes = grown;
+        g_indexCapacity = capacity;
+    }
+    
+    HIAHSymbolIndex *index = HIAHSymbolIndexCreate(header);
+    if (index) {
+        g_indexes[g_indexCount++] = index;
+    }
+    return index;
+}
+
+// Caller holds g_indexLock
+static HIAHHookChainedImage *HIAHHookChainedForImage(const HIAHMachHeader *header) {
+    for (size_t i = 0; i < g_chainedCount; i++) {
+        if (g_chained[i].header == header) {
+            return &g_chained[i];
         }
     }
+    return NULL;
 }
 
+// MARK: - Chained Fixups
+
 /**
- * Processes a single Mach-O image for hook installation.
+ * Finds the slice of a possibly fat file that holds the image `header`
+ * was loaded from.
  */
-static void HIAHHookProcessImage(const HIAHMachHeader *header,
-                                  void *target,
-                                  void *replacement) {
-    if (!header || !target || !replacement) {
-        return;
+static bool HIAHHookFindSlice(const uint8_t *file, size_t size, const HIAHMachHeader *header,
+                              size_t *sliceOffset, size_t *sliceSize) {
+    if (size < sizeof(uint32_t)) {
+        return false;
+    }
+    uint32_t magic = HIAHReadBig32(file);
+    if (magic != HIAH_FAT_MAGIC && magic != HIAH_FAT_MAGIC_64) {
+        *sliceOffset = 0;
+        *sliceSize = size;
+        return true;
+    }
+    
+    bool wide = magic == HIAH_FAT_MAGIC_64;
+    size_t archSize = wide ? HIAH_FAT_ARCH_SIZE_64 : HIAH_FAT_ARCH_SIZE;
+    uint32_t archCount = size >= HIAH_FAT_HEADER_SIZE ? HIAHReadBig32(file + 4) : 0;
+    for (uint32_t i = 0; i < archCount && HIAH_FAT_HEADER_SIZE + (size_t)(i + 1) * archSize <= size; i++) {
+        const uint8_t *arch = file + HIAH_FAT_HEADER_SIZE + (size_t)i * archSize;
+        int32_t cputype = (int32_t)HIAHReadBig32(arch);
+        int32_t cpusubtype = (int32_t)HIAHReadBig32(arch + 4);
+        if (cputype != header->cputype ||
+            (cpusubtype & ~CPU_SUBTYPE_MASK) != (header->cpusubtype & ~CPU_SUBTYPE_MASK)) {
+            continue;
+        }
+        uint64_t offset = wide ? HIAHReadBig64(arch + 8) : HIAHReadBig32(arch + 8);
+        uint64_t length = wide ? HIAHReadBig64(arch + 16) : HIAHReadBig32(arch + 12);
+        if (offset > size || length > size - offset) {
+            return false;
+        }
+        *sliceOffset = (size_t)offset;
+        *sliceSize = (size_t)length;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Builds the chained fixup table of a loaded image. dyld has overwritten the
+ * chains in memory, so they are read from the image's file; the import table
+ * is read from the mapped __LINKEDIT.
+ *
+ * @param bases Receives the slid address of each segment, in load command order
+ */
+static HIAHChainedFixups *HIAHHookLoadChainedFixups(const HIAHMachHeader *header,
+                                                    const struct linkedit_data_command *fixupsCommand,
+                                                    uintptr_t **bases,
+                                                    uint32_t *segmentCount) {
+    Dl_info info;
+    if (!dladdr(header, &info) || !info.dli_fname) {
+        return NULL;
+    }
+    int fd = open(info.dli_fname, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    void *file = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        file = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (file == MAP_FAILED) {
+        return NULL;
     }
     
-    // Walk through load commands
-    uintptr_t cmdPtr = (uintptr_t)header + sizeof(HIAHMachHeader);
+    size_t sliceOffset = 0;
+    size_t sliceSize = 0;
+    HIAHChainedSegment *segments = calloc(header->ncmds ? header->ncmds : 1, sizeof(HIAHChainedSegment));
+    uintptr_t *segmentBases = calloc(header->ncmds ? header->ncmds : 1, sizeof(uintptr_t));
+    bool valid = segments && segmentBases &&
+                 HIAHHookFindSlice(file, (size_t)st.st_size, header, &sliceOffset, &sliceSize);
+    
+    // Pair each mapped segment with its bytes in the file
+    const uint8_t *slice = (const uint8_t *)file + sliceOffset;
+    uintptr_t slide = 0;
+    uintptr_t linkeditBase = 0;
+    uint32_t count = 0;
+    uintptr_t cursor = (uintptr_t)header + sizeof(HIAHMachHeader);
+    for (uint32_t i = 0; valid && i < header->ncmds; i++) {
+        const struct load_command *command = (const struct load_command *)cursor;
+        cursor += command->cmdsize;
+        if (command->cmd != HIAH_LC_SEGMENT) {
+            continue;
+        }
+        const HIAHSegmentCommand *segment = (const HIAHSegmentCommand *)command;
+        if (strcmp(segment->segname, "__TEXT") == 0) {
+            slide = (uintptr_t)header - (uintptr_t)segment->vmaddr;
+        } else if (strcmp(segment->segname, "__LINKEDIT") == 0) {
+            linkeditBase = (uintptr_t)segment->vmaddr - (uintptr_t)segment->fileoff;
+        }
+        if (segment->fileoff > sliceSize || segment->filesize > sliceSize - segment->fileoff) {
+            valid = false;
+            break;
+        }
+        segments[count] = (HIAHChainedSegment){ slice + segment->fileoff, segment->filesize };
+        segmentBases[count] = (uintptr_t)segment->vmaddr;
+        count++;
+    }
+    
+    HIAHChainedFixups *fixups = NULL;
+    if (valid && linkeditBase) {
+        for (uint32_t i = 0; i < count; i++) {
+            segmentBases[i] += slide;
+        }
+        const uint8_t *payload = (const uint8_t *)(slide + linkeditBase + fixupsCommand->dataoff);
+        fixups = HIAHChainedFixupsCreate(payload, fixupsCommand->datasize, segments, count);
+    }
     
+    munmap(file, (size_t)st.st_size);
+    free(segments);
+    if (!fixups) {
+        free(segmentBases);
+        return NULL;
+    }
+    *bases = segmentBases;
+    *segmentCount = count;
+    return fixups;
+}
+
+/**
+ * Makes sure the chained fixup table of an image is cached, if the image
+ * has chained fixups at all. The table is built without g_indexLock held,
+ * since dladdr() takes dyld's lock.
+ */
+static void HIAHHookPrepareChainedFixups(const HIAHMachHeader *header) {
+    const struct linkedit_data_command *fixupsCommand = NULL;
+    uintptr_t cursor = (uintptr_t)header + sizeof(HIAHMachHeader);
     for (uint32_t i = 0; i < header->ncmds; i++) {
-        struct load_command *cmd = (struct load_command *)cmdPtr;
+        const struct load_command *command = (const struct load_command *)cursor;
+        if (command->cmd == LC_DYLD_CHAINED_FIXUPS) {
+            fixupsCommand = (const struct linkedit_data_command *)command;
+            break;
+        }
+        cursor += command->cmdsize;
+    }
+    if (!fixupsCommand) {
+        return;   // Classic binds only, or an image from the shared cache
+    }
+    
+    HIAHHookWatchRemovedImages();
+    pthread_mutex_lock(&g_indexLock);
+    bool cached = HIAHHookChainedForImage(header) != NULL;
+    pthread_mutex_unlock(&g_indexLock);
+    if (cached) {
+        return;
+    }
+    
+    // Failures are cached too, as an entry without a table
+    HIAHHookChainedImage image = { header, NULL, NULL, 0 };
+    image.fixups = HIAHHookLoadChainedFixups(header, fixupsCommand, &image.segmentBases, &image.segmentCount);
+    
+    pthread_mutex_lock(&g_indexLock);
+    bool inserted = false;
+    if (!HIAHHookChainedForImage(header)) {
+        if (g_chainedCount == g_chainedCapacity) {
+            size_t capacity = g_chainedCapacity ? g_chainedCapacity * 2 : 16;
+            HIAHHookChainedImage *grown = realloc(g_chained, capacity * sizeof(*grown));
+            if (grown) {
+                g_chained = grown;
+                g_chainedCapacity = capacity;
+            }
+        }
+        if (g_chainedCount < g_chainedCapacity) {
+            g_chained[g_chainedCount++] = image;
+            inserted = true;
+        }
+    }
+    pthread_mutex_unlock(&g_indexLock);
+    
+    if (!inserted) {
+        HIAHChainedFixupsDestroy(image.fixups);
+        free(image.segmentBases);
+    }
+}
+
+/**
+ * The value to store in a bind slot. Authenticated slots hold a pointer
+ * signed with the slot's key and discriminator; dyld authenticates it on
+ * every call through the slot.
+ */
+static void *HIAHHookBindValue(const HIAHChainedBind *bind, void **slot, void *replacement) {
+    void *value = HIAH_STRIP_PTR(replacement);
+#if __arm64e__
+    if (bind->flags & HIAH_CHAINED_BIND_AUTH) {
+        uintptr_t discriminator = bind->diversity;
+        if (bind->flags & HIAH_CHAINED_BIND_ADDRESS_DIVERSITY) {
+            discriminator = ptrauth_blend_discriminator(slot, discriminator);
+        }
+        switch (bind->key) {
+            case 0: return ptrauth_sign_unauthenticated(value, ptrauth_key_asia, discriminator);
+            case 1: return ptrauth_sign_unauthenticated(value, ptrauth_key_asib, discriminator);
+            case 2: return ptrauth_sign_unauthenticated(value, ptrauth_key_asda, discriminator);
+            default: return ptrauth_sign_unauthenticated(value, ptrauth_key_asdb, discriminator);
+        }
+    }
+#else
+    (void)bind;
+    (void)slot;
+#endif
+    return value;
+}
+
+// Caller holds g_indexLock
+static void **HIAHHookBindSlot(const HIAHHookChainedImage *image, const HIAHChainedBind *bind) {
+    if (bind->segment >= image->segmentCount) {
+        return NULL;
+    }
+    return (void **)(image->segmentBases[bind->segment] + (uintptr_t)bind->offset);
+}
+
+/**
+ * Matches the bind slots of an image with chained fixups against the
+ * pointer targets. Unlike the section scan, this reaches binds outside the
+ * symbol pointer sections (__auth_ptr, __const, ...).
+ */
+static void HIAHHookMatchChainedBinds(const HIAHMachHeader *header,
+                                      const HIAHHookTargetSet *set,
+                                      HIAHHookPatchList *list) {
+    HIAHHookPrepareChainedFixups(header);
+    
+    pthread_mutex_lock(&g_indexLock);
+    const HIAHHookChainedImage *image = HIAHHookChainedForImage(header);
+    size_t bindCount = 0;
+    const HIAHChainedBind *binds = image ? HIAHChainedFixupsBinds(image->fixups, &bindCount) : NULL;
+    for (size_t i = 0; i < bindCount; i++) {
+        void **slot = HIAHHookBindSlot(image, &binds[i]);
+        if (!slot) {
+            continue;
+        }
+        HIAHHookBinding *binding = HIAHHookTargetSetLookup(set, (uintptr_t)HIAH_STRIP_PTR(*slot));
+        if (binding) {
+            HIAHHookAddPatch(list, slot, binding, HIAHHookBindValue(&binds[i], slot, binding->replacement));
+        }
+    }
+    pthread_mutex_unlock(&g_indexLock);
+}
+
+/**
+ * Rebinds the named bindings in one image through its chained fixup table
+ * and its symbol index. Chained binds are collected first, so a slot found
+ * through both keeps its signed value.
+ */
+static void HIAHHookRebindImage(const HIAHMachHeader *header,
+                                HIAHHookBinding *bindings,
+                                size_t count,
+                                HIAHHookPatchList *list) {
+    HIAHHookWatchRemovedImages();
+    HIAHHookPrepareChainedFixups(header);
+    
+    pthread_mutex_lock(&g_indexLock);
+    const HIAHHookChainedImage *chained = HIAHHookChainedForImage(header);
+    for (size_t i = 0; chained && chained->fixups && i < count; i++) {
+        HIAHHookBinding *binding = &bindings[i];
+        if (!binding->name) {
+            continue;
+        }
         
-        if (cmd->cmd == HIAH_LC_SEGMENT) {
-            HIAHSegmentCommand *segment = (HIAHSegmentCommand *)cmd;
-            
-            // We're interested in __DATA and __DATA_CONST segments
-            // These contain the symbol pointer tables
-            bool isDataSegment = (strncmp(segment->segname, "__DATA", 6) == 0);
-            
-            if (isDataSegment) {
-                // Iterate through sections in this segment
-                HIAHSection *sections = (HIAHSection *)(cmdPtr + sizeof(HIAHSegmentCommand));
-                
-                for (uint32_t j = 0; j < segment->nsects; j++) {
-                    uint32_t sectionType = sections[j].flags & SECTION_TYPE;
-                    
-                    // Process lazy and non-lazy symbol pointer sections
-                    if (sectionType == S_LAZY_SYMBOL_POINTERS ||
-                        sectionType == S_NON_LAZY_SYMBOL_POINTERS) {
-                        HIAHHookRewriteSection(header, &sections[j], target, replacement);
-                    }
-                }
+        size_t bindCount = 0;
+        const HIAHChainedBind *binds = HIAHChainedFixupsFind(chained->fixups, binding->name, &bindCount);
+        void *replacement = HIAH_STRIP_PTR(binding->replacement);
+        for (size_t j = 0; j < bindCount; j++) {
+            void **slot = HIAHHookBindSlot(chained, &binds[j]);
+            if (!slot || HIAH_STRIP_PTR(*slot) == replacement) {
+                continue;   // Already hooked
             }
+            HIAHHookAddPatch(list, slot, binding, HIAHHookBindValue(&binds[j], slot, replacement));
+        }
+    }
+    
+    HIAHSymbolIndex *index = HIAHHookIndexForImage(header);
+    for (size_t i = 0; index && i < count; i++) {
+        HIAHHookBinding *binding = &bindings[i];
+        if (!binding->name) {
+            continue;
         }
         
-        cmdPtr += cmd->cmdsize;
+        size_t slotCount = 0;
+        const HIAHSymbolSlot *slots = HIAHSymbolIndexFind(index, binding->name, &slotCount);
+        void *replacement = HIAH_STRIP_PTR(binding->replacement);
+        for (size_t j = 0; j < slotCount; j++) {
+            void **slot = slots[j].address;
+            if (HIAH_STRIP_PTR(*slot) == replacement) {
+                continue;   // Already hooked
+            }
+            HIAHHookAddPatch(list, slot, binding, replacement);
+        }
     }
+    pthread_mutex_unlock(&g_indexLock);
 }
 
-HIAHHookResult HIAHHookIntercept(HIAHHookScope scope,
-                                  const HIAHMachHeader *image,
-                                  void *original,
-                                  void *replacement) {
-    if (!original || !replacement) {
-        return HIAHHookResultInvalidArgument;
+/**
+ * Processes a single Mach-O image for hook installation.
+ */
+static void HIAHHookProcessImage(const HIAHMachHeader *header,
+                                  const HIAHHookTargetSet *set,
+                                  HIAHHookPatchList *list) {
+    if (!header || set->count == 0) {
+        return;
     }
     
+    // Bind slots of chained fixups first, so authenticated slots found
+    // again by the section scan keep their signed value
+    HIAHHookMatchChainedBinds(header, set, list);
+    
+    // One walk over the symbol pointer sections for the whole set
+    HIAHHookScanImage(header, set, HIAHHookCollectSlot, list);
+}
+
+/**
+ * Applies a batch to one image: pointer matching for unnamed bindings and
+ * symbol rebinding for named ones.
+ */
+static void HIAHHookApplyToImage(const HIAHMachHeader *header,
+                                 const HIAHHookTargetSet *set,
+                                 HIAHHookBinding *bindings,
+                                 size_t count,
+                                 bool named,
+                                 HIAHHookPatchList *list) {
+    HIAHHookProcessImage(header, set, list);
+    if (named) {
+        HIAHHookRebindImage(header, bindings, count, list);
+    }
+}
+
+static void HIAHHookApply(HIAHHookScope scope,
+                          const HIAHMachHeader *image,
+                          const HIAHHookTargetSet *set,
+                          HIAHHookBinding *bindings,
+                          size_t count) {
+    bool named = false;
+    for (size_t i = 0; i < count; i++) {
+        named = named || bindings[i].name;
+    }
+    
+    HIAHHookPatchList list = { NULL, 0, 0 };
+    
     if (scope == HIAHHookScopeGlobal) {
         // Apply to all loaded images
         uint32_t imageCount = _dyld_image_count();
@@ -134,28 +688,527 @@ HIAHHookResult HIAHHookIntercept(HIAHHookScope scope,
         for (uint32_t i = 0; i < imageCount; i++) {
             const HIAHMachHeader *header = (const HIAHMachHeader *)_dyld_get_image_header(i);
             if (header) {
-                HIAHHookProcessImage(header, original, replacement);
+                HIAHHookApplyToImage(header, set, bindings, count, named, &list);
             }
         }
-    } else if (image) {
-        // Apply to specific image only
-        HIAHHookProcessImage(image, original, replacement);
     } else {
+        // Apply to specific image only
+        HIAHHookApplyToImage(image, set, bindings, count, named, &list);
+    }
+    
+    // All sites are known: write them page range by page range
+    HIAHHookCommitPatches(&list);
+    free(list.patches);
+}
+
+HIAHHookResult HIAHHookIntercept(HIAHHookScope scope,
+                                  const HIAHMachHeader *image,
+                                  void *original,
+                                  void *replacement) {
+    if (!original || !replacement) {
         return HIAHHookResultInvalidArgument;
     }
     
+    HIAHHookBinding binding = { original, replacement, NULL, 0 };
+    return HIAHHookInterceptBatch(scope, image, &binding, 1);
+}
+
+static bool HIAHHookValidBindings(const HIAHHookBinding *bindings, size_t count) {
+    if (!bindings || count == 0) {
+        return false;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if ((bindings[i].original || bindings[i].name) && !bindings[i].replacement) {
+            return false;
+        }
+    }
+    return true;
+}
+
+HIAHHookResult HIAHHookInterceptBatch(HIAHHookScope scope,
+                                       const HIAHMachHeader *image,
+                                       HIAHHookBinding *bindings,
+                                       size_t count) {
+    if (!HIAHHookValidBindings(bindings, count) || (scope != HIAHHookScopeGlobal && !image)) {
+        return HIAHHookResultInvalidArgument;
+    }
+    
+    HIAHHookTarget inlineTargets[HIAH_HOOK_INLINE_TARGETS];
+    HIAHHookTarget *storage = inlineTargets;
+    if (count > HIAH_HOOK_INLINE_TARGETS) {
+        storage = malloc(count * sizeof(HIAHHookTarget));
+    }
+    
+    HIAHHookTargetSet set;
+    if (storage) {
+        HIAHHookTargetSetBuild(&set, storage, bindings, count);
+        HIAHHookApply(scope, image, &set, bindings, count);
+    } else {
+        // Out of memory: fall back to one pass per hook
+        for (size_t i = 0; i < count; i++) {
+            HIAHHookTargetSetBuild(&set, inlineTargets, &bindings[i], 1);
+            HIAHHookApply(scope, image, &set, &bindings[i], 1);
+        }
+    }
+    
+    if (storage != inlineTargets) {
+        free(storage);
+    }
+    return HIAHHookResultSuccess;
+}
+
+// MARK: - Active Hooks
+
+/**
+ * Hooks installed with HIAHHookInterceptPersistent (see HIAHHookRegistry.h),
+ * fed every image dyld adds.
+ */
+static HIAHHookRegistry *g_active;
+
+static void HIAHHookApplyActive(const void *image, HIAHHookBinding *bindings, size_t count,
+                                void *context) {
+    (void)context;
+    HIAHHookInterceptBatch(image ? HIAHHookScopeImage : HIAHHookScopeGlobal, image, bindings, count);
+}
+
+static void HIAHHookImageAddedCallback(const struct mach_header *header, intptr_t slide) {
+    (void)slide;
+    HIAHHookImageAdded((const HIAHMachHeader *)header);
+}
+
+static void HIAHHookWatchAddedImages(HIAHHookRegistry *registry, void *context) {
+    (void)registry;
+    (void)context;
+    // dyld calls back once for every image already loaded, then once for
+    // each image added later
+    _dyld_register_func_for_add_image(HIAHHookImageAddedCallback);
+}
+
+static void HIAHHookCreateActive(void) {
+    g_active = HIAHHookRegistryCreate(HIAHHookApplyActive, HIAHHookWatchAddedImages, NULL);
+}
+
+static HIAHHookRegistry *HIAHHookActive(void) {
+    static pthread_once_t createOnce = PTHREAD_ONCE_INIT;
+    pthread_once(&createOnce, HIAHHookCreateActive);
+    return g_active;
+}
+
+void HIAHHookImageAdded(const HIAHMachHeader *header) {
+    HIAHHookRegistryImageAdded(HIAHHookActive(), header);
+}
+
+HIAHHookResult HIAHHookInterceptPersistent(HIAHHookBinding *bindings, size_t count) {
+    if (!HIAHHookValidBindings(bindings, count)) {
+        return HIAHHookResultInvalidArgument;
+    }
+    HIAHHookRegistry *registry = HIAHHookActive();
+    if (!registry || !HIAHHookRegistryAdd(registry, bindings, count)) {
+        return HIAHHookResultOutOfMemory;
+    }
     return HIAHHookResultSuccess;
 }
 
+// MARK: - Symbol Lookup
+
+#ifdef __LP64__
+typedef struct nlist_64 HIAHNlist;
+#define HIAH_MH_MAGIC MH_MAGIC_64
+#else
+typedef struct nlist HIAHNlist;
+#define HIAH_MH_MAGIC MH_MAGIC
+#endif
+
+#define HIAH_HOOK_MAX_REEXPORT_DEPTH 8
+#define HIAH_HOOK_INLINE_NAMES 64
+
+/**
+ * The tables of one image that symbol lookup reads.
+ */
+typedef struct {
+    const HIAHMachHeader *header;
+    uintptr_t slide;
+    const uint8_t *trie;
+    size_t trieSize;
+    const HIAHNlist *symbols;
+    uint32_t symbolCount;
+    const char *strings;
+    uint32_t stringsSize;
+} HIAHHookSymbolTables;
+
+static size_t HIAHHookFindSymbolsAtDepth(const HIAHMachHeader *image,
+                                         const char *const *names,
+                                         void **addresses,
+                                         size_t count,
+                                         unsigned depth);
+
+// FNV-1a
+static uint32_t HIAHHookHashName(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool HIAHHookLocateSymbolTables(const HIAHMachHeader *header,
+                                       HIAHHookSymbolTables *tables) {
+    memset(tables, 0, sizeof(*tables));
+    tables->header = header;
+    
+    const HIAHSegmentCommand *text = NULL;
+    const HIAHSegmentCommand *linkedit = NULL;
+    const struct symtab_command *symtab = NULL;
+    const struct linkedit_data_command *exportsTrie = NULL;
+    const struct dyld_info_command *dyldInfo = NULL;
+    
+    uintptr_t cursor = (uintptr_t)header + sizeof(HIAHMachHeader);
+    for (uint32_t i = 0; i < header->ncmds; i++) {
+        const struct load_command *command = (const struct load_command *)cursor;
+        if (command->cmdsize < sizeof(struct load_command)) {
+            return false;
+        }
+        switch (command->cmd) {
+            case HIAH_LC_SEGMENT: {
+                const HIAHSegmentCommand *segment = (const HIAHSegmentCommand *)command;
+                if (strcmp(segment->segname, "__TEXT") == 0) {
+                    text = segment;
+                } else if (strcmp(segment->segname, "__LINKEDIT") == 0) {
+                    linkedit = segment;
+                }
+                break;
+            }
+            case LC_SYMTAB:
+                symtab = (const struct symtab_command *)command;
+                break;
+            case LC_DYLD_EXPORTS_TRIE:
+                exportsTrie = (const struct linkedit_data_command *)command;
+                break;
+            case LC_DYLD_INFO:
+            case LC_DYLD_INFO_ONLY:
+                dyldInfo = (const struct dyld_info_command *)command;
+                break;
+        }
+        cursor += command->cmdsize;
+    }
+    if (!text || !linkedit) {
+        return false;
+    }
+    
+    tables->slide = (uintptr_t)header - (uintptr_t)text->vmaddr;
+    uintptr_t linkeditBase = tables->slide + (uintptr_t)linkedit->vmaddr - (uintptr_t)linkedit->fileoff;
+    if (exportsTrie && exportsTrie->datasize > 0) {
+        tables->trie = (const uint8_t *)(linkeditBase + exportsTrie->dataoff);
+        tables->trieSize = exportsTrie->datasize;
+    } else if (dyldInfo && dyldInfo->export_size > 0) {
+        tables->trie = (const uint8_t *)(linkeditBase + dyldInfo->export_off);
+        tables->trieSize = dyldInfo->export_size;
+    }
+    if (symtab) {
+        tables->symbols = (const HIAHNlist *)(linkeditBase + symtab->symoff);
+        tables->symbolCount = symtab->nsyms;
+        tables->strings = (const char *)(linkeditBase + symtab->stroff);
+        tables->stringsSize = symtab->strsize;
+    }
+    return true;
+}
+
+/**
+ * Install name of the dylib a re-export ordinal refers to (1-based, in
+ * load command order).
+ */
+static const char *HIAHHookDylibAtOrdinal(const HIAHMachHeader *header, uint64_t ordinal) {
+    uint64_t current = 0;
+    uintptr_t cursor = (uintptr_t)header + sizeof(HIAHMachHeader);
+    for (uint32_t i = 0; i < header->ncmds; i++) {
+        const struct load_command *command = (const struct load_command *)cursor;
+        cursor += command->cmdsize;
+        switch (command->cmd) {
+            case LC_LOAD_DYLIB:
+            case LC_LOAD_WEAK_DYLIB:
+            case LC_REEXPORT_DYLIB:
+            case LC_LOAD_UPWARD_DYLIB:
+            case LC_LAZY_LOAD_DYLIB:
+                if (++current == ordinal) {
+                    const struct dylib_command *dylib = (const struct dylib_command *)command;
+                    if (dylib->dylib.name.offset >= command->cmdsize) {
+                        return NULL;
+                    }
+                    return (const char *)command + dylib->dylib.name.offset;
+                }
+                break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Finds a loaded image by install name. Names relative to @rpath and
+ * friends match on the part after the prefix.
+ */
+static const HIAHMachHeader *HIAHHookLoadedImageNamed(const char *installName) {
+    const char *suffix = installName[0] == '@' ? strchr(installName, '/') : NULL;
+    size_t suffixLength = suffix ? strlen(suffix) : 0;
+    
+    uint32_t count = _dyld_image_count();
+    for (uint32_t i = 0; i < count; i++) {
+        const char *path = _dyld_get_image_name(i);
+        if (!path) {
+            continue;
+        }
+        if (strcmp(path, installName) == 0) {
+            return (const HIAHMachHeader *)_dyld_get_image_header(i);
+        }
+        size_t length = strlen(path);
+        if (suffix && length >= suffixLength && strcmp(path + length - suffixLength, suffix) == 0) {
+            return (const HIAHMachHeader *)_dyld_get_image_header(i);
+        }
+    }
+    return NULL;
+}
+
+static void *HIAHHookExportAddress(const HIAHHookSymbolTables *tables,
+                                   const HIAHExport *export,
+                                   const char *name,
+                                   unsigned depth) {
+    if (export->flags & HIAH_EXPORT_REEXPORT) {
+        if (depth >= HIAH_HOOK_MAX_REEXPORT_DEPTH) {
+            return NULL;
+        }
+        const char *installName = HIAHHookDylibAtOrdinal(tables->header, export->ordinal);
+        const HIAHMachHeader *dylib = installName ? HIAHHookLoadedImageNamed(installName) : NULL;
+        if (!dylib) {
+            return NULL;
+        }
+        const char *target = name;
+        if (export->importName[0] != '\0') {
+            target = export->importName[0] == '_' ? export->importName + 1 : export->importName;
+        }
+        void *address = NULL;
+        HIAHHookFindSymbolsAtDepth(dylib, &target, &address, 1, depth + 1);
+        return address;
+    }
+    if ((export->flags & HIAH_EXPORT_KIND_MASK) == HIAH_EXPORT_KIND_ABSOLUTE) {
+        return (void *)(uintptr_t)export->address;
+    }
+    // Regular and thread-local exports, and the stubs of resolver-backed
+    // ones, are offsets from the header
+    return (void *)((uintptr_t)tables->header + (uintptr_t)export->address);
+}
+
+/**
+ * Searches the nlist symbol table for a symbol defined in the image.
+ * External definitions win over local ones of the same name.
+ */
+static void *HIAHHookSearchSymtab(const HIAHHookSymbolTables *tables, const char *mangled) {
+    void *local = NULL;
+    for (uint32_t i = 0; i < tables->symbolCount; i++) {
+        const HIAHNlist *symbol = &tables->symbols[i];
+        if ((symbol->n_type & N_STAB) || (symbol->n_type & N_TYPE) != N_SECT) {
+            continue;
+        }
+        uint32_t nameOffset = symbol->n_un.n_strx;
+        if (nameOffset == 0 || nameOffset >= tables->stringsSize ||
+            strcmp(tables->strings + nameOffset, mangled) != 0) {
+            continue;
+        }
+        void *address = (void *)(tables->slide + (uintptr_t)symbol->n_value);
+        if (symbol->n_type & N_EXT) {
+            return address;
+        }
+        if (!local) {
+            local = address;
+        }
+    }
+    return local;
+}
+
+static void *HIAHHookResolveSymbol(const HIAHHookSymbolTables *tables,
+                                   const char *name,
+                                   unsigned depth) {
+    // The export trie and the string table both carry the C underscore
+    char inlineName[256];
+    size_t length = strlen(name);
+    char *mangled = length + 2 <= sizeof(inlineName) ? inlineName : malloc(length + 2);
+    if (!mangled) {
+        return NULL;
+    }
+    mangled[0] = '_';
+    memcpy(mangled + 1, name, length + 1);
+    
+    void *address;
+    HIAHExport export;
+    if (tables->trie && HIAHExportTrieFind(tables->trie, tables->trieSize, mangled, &export)) {
+        address = HIAHHookExportAddress(tables, &export, name, depth);
+    } else {
+        address = HIAHHookSearchSymtab(tables, mangled);
+    }
+    
+    if (mangled != inlineName) {
+        free(mangled);
+    }
+    return address;
+}
+
+// Caller holds g_indexLock
+static HIAHHookExportCache *HIAHHookExportCacheForImage(const HIAHMachHeader *header, bool create) {
+    for (size_t i = 0; i < g_exportCacheCount; i++) {
+        if (g_exportCaches[i].header == header) {
+            return &g_exportCaches[i];
+        }
+    }
+    if (!create) {
+        return NULL;
+    }
+    
+    if (g_exportCacheCount == g_exportCacheCapacity) {
+        size_t capacity = g_exportCacheCapacity ? g_exportCacheCapacity * 2 : 16;
+        HIAHHookExportCache *grown = realloc(g_exportCaches, capacity * sizeof(*grown));
+        if (!grown) {
+            return NULL;
+        }
+        g_exportCaches = grown;
+        g_exportCacheCapacity = capacity;
+    }
+    
+    HIAHHookExportCache *cache = &g_exportCaches[g_exportCacheCount++];
+    *cache = (HIAHHookExportCache){ .header = header };
+    return cache;
+}
+
+// Returns the entry for `name`, or the empty bucket it would go in
+static HIAHHookExportEntry *HIAHHookExportCacheProbe(const HIAHHookExportCache *cache,
+                                                     const char *name,
+                                                     uint32_t hash) {
+    size_t mask = cache->capacity - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+        HIAHHookExportEntry *entry = &cache->entries[i];
+        if (!entry->name || (entry->hash == hash && strcmp(entry->name, name) == 0)) {
+            return entry;
+        }
+    }
+}
+
+static void HIAHHookExportCacheInsert(HIAHHookExportCache *cache,
+                                      const char *name,
+                                      void *address) {
+    // Keep the table at most half full
+    if ((cache->count + 1) * 2 > cache->capacity) {
+        size_t capacity = cache->capacity ? cache->capacity * 2 : 32;
+        HIAHHookExportEntry *entries = calloc(capacity, sizeof(*entries));
+        if (!entries) {
+            return;
+        }
+        HIAHHookExportCache grown = { cache->header, entries, cache->count, capacity };
+        for (size_t i = 0; i < cache->capacity; i++) {
+            HIAHHookExportEntry *entry = &cache->entries[i];
+            if (entry->name) {
+                *HIAHHookExportCacheProbe(&grown, entry->name, entry->hash) = *entry;
+            }
+        }
+        free(cache->entries);
+        *cache = grown;
+    }
+    
+    uint32_t hash = HIAHHookHashName(name);
+    HIAHHookExportEntry *entry = HIAHHookExportCacheProbe(cache, name, hash);
+    if (entry->name) {
+        return;   // Resolved concurrently
+    }
+    char *copy = strdup(name);
+    if (!copy) {
+        return;
+    }
+    *entry = (HIAHHookExportEntry){ copy, hash, address };
+    cache->count++;
+}
+
+static size_t HIAHHookFindSymbolsAtDepth(const HIAHMachHeader *image,
+                                         const char *const *names,
+                                         void **addresses,
+                                         size_t count,
+                                         unsigned depth) {
+    if (!image || !names || !addresses || image->magic != HIAH_MH_MAGIC) {
+        return 0;
+    }
+    HIAHHookWatchRemovedImages();
+    
+    // Without room to flag the misses, every name not cached as found is
+    // resolved again
+    bool inlineMissing[HIAH_HOOK_INLINE_NAMES];
+    bool *missing = count <= HIAH_HOOK_INLINE_NAMES ? inlineMissing : calloc(count, sizeof(bool));
+    
+    // Answer what the cache already knows
+    size_t missCount = 0;
+    pthread_mutex_lock(&g_indexLock);
+    HIAHHookExportCache *cache = HIAHHookExportCacheForImage(image, true);
+    for (size_t i = 0; i < count; i++) {
+        addresses[i] = NULL;
+        bool miss = names[i] != NULL;
+        if (miss && cache && cache->count > 0) {
+            HIAHHookExportEntry *entry = HIAHHookExportCacheProbe(cache, names[i], HIAHHookHashName(names[i]));
+            if (entry->name) {
+                addresses[i] = entry->address;
+                miss = false;
+            }
+        }
+        if (missing) {
+            missing[i] = miss;
+        }
+        missCount += miss;
+    }
+    pthread_mutex_unlock(&g_indexLock);
+    
+    // Resolve the rest without the lock: re-exports call into dyld and
+    // recurse into other images
+    if (missCount > 0) {
+        HIAHHookSymbolTables tables;
+        bool located = HIAHHookLocateSymbolTables(image, &tables);
+        for (size_t i = 0; i < count; i++) {
+            bool miss = missing ? missing[i] : (names[i] && !addresses[i]);
+            if (miss && located) {
+                addresses[i] = HIAHHookResolveSymbol(&tables, names[i], depth);
+            }
+        }
+    
+        // Memoize, unless dyld unloaded the image meanwhile
+        pthread_mutex_lock(&g_indexLock);
+        cache = HIAHHookExportCacheForImage(image, false);
+        for (size_t i = 0; cache && missing && i < count; i++) {
+            if (missing[i]) {
+                HIAHHookExportCacheInsert(cache, names[i], addresses[i]);
+            }
+        }
+        pthread_mutex_unlock(&g_indexLock);
+    }
+    
+    if (missing != inlineMissing) {
+        free(missing);
+    }
+    
+    size_t found = 0;
+    for (size_t i = 0; i < count; i++) {
+        found += addresses[i] != NULL;
+    }
+    return found;
+}
+
+size_t HIAHHookFindSymbols(const HIAHMachHeader *image,
+                           const char *const *names,
+                           void **addresses,
+                           size_t count) {
+    return HIAHHookFindSymbolsAtDepth(image, names, addresses, count, 0);
+}
+
 void *HIAHHookFindSymbol(const HIAHMachHeader *header, const char *name) {
     if (!header || !name) {
         return NULL;
     }
     
-    // Use dlsym for runtime symbol resolution
-    // This is the most reliable method for finding exported symbols
-    void *result = dlsym(RTLD_DEFAULT, name);
-    return result;
+    void *address = NULL;
+    HIAHHookFindSymbols(header, &name, &address, 1);
+    return address;
 }
 
 const HIAHMachHeader *HIAHHookGetMainImage(void) {
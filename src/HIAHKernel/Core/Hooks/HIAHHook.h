@@ -15,7 +15,9 @@
 #define HIAH_HOOK_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "HIAHHookTargets.h"
 #include <mach/mach.h>
 #include <mach-o/loader.h>
 
@@ -53,7 +55,8 @@ typedef enum {
     HIAHHookResultSuccess = 0,
     HIAHHookResultNotFound,
     HIAHHookResultProtectionFailed,
-    HIAHHookResultInvalidArgument
+    HIAHHookResultInvalidArgument,
+    HIAHHookResultOutOfMemory
 } HIAHHookResult;
 
 /**
@@ -73,15 +76,104 @@ HIAHHookResult HIAHHookIntercept(HIAHHookScope scope,
                                   void *original,
                                   void *replacement);
 
+/**
+ * Intercept several functions with a single walk over the image(s).
+ *
+ * Bindings without a name match by value: every symbol pointer slot is
+ * looked up in a sorted set of all the originals, so installing N hooks
+ * costs one scan instead of N. If two bindings share an original, the first
+ * one wins.
+ *
+ * Bindings with a name rebind by symbol: the slots are found through the
+ * image's indirect symbol table (see HIAHSymbolIndex.h), which also catches
+ * lazy pointers that have not been bound yet. The index is built once per
+ * image and cached, so each named hook costs one lookup per image.
+ *
+ * Images linked with chained fixups (LC_DYLD_CHAINED_FIXUPS) also have
+ * their bind slots listed once, from the chains in the image's file (see
+ * HIAHChainedFixups.h). Named bindings rewrite the binds of their import
+ * directly, unnamed ones match every bind slot, including those outside
+ * the symbol pointer sections. On arm64e, authenticated slots are given a
+ * pointer signed for that slot.
+ *
+ * @param scope Whether to hook globally or in a specific image
+ * @param image The image to hook in (ignored if scope is HIAHHookScopeGlobal)
+ * @param bindings Hooks to install; each `rewritten` count is reset and filled in
+ * @param count Number of bindings
+ * @return HIAHHookResultSuccess on success
+ */
+HIAHHookResult HIAHHookInterceptBatch(HIAHHookScope scope,
+                                       const HIAHMachHeader *image,
+                                       HIAHHookBinding *bindings,
+                                       size_t count);
+
+/**
+ * Intercept functions in every loaded image and keep the hooks active.
+ *
+ * The bindings join a registry of active hooks that is applied to each image
+ * dyld adds afterwards (dlopen'd libraries, guest binaries), scanning only
+ * that image (see HIAHHookRegistry.h). Names are copied; `rewritten`
+ * receives the count for the images loaded so far.
+ *
+ * @return HIAHHookResultSuccess on success
+ */
+HIAHHookResult HIAHHookInterceptPersistent(HIAHHookBinding *bindings, size_t count);
+
+/**
+ * Applies the active hooks to one newly added image. This is dyld's
+ * add-image callback; images mapped by other means can be fed in by hand.
+ */
+void HIAHHookImageAdded(const HIAHMachHeader *header);
+
+/**
+ * Cumulative cost of hook installation. Rewrite sites are grouped into
+ * contiguous page ranges and each read-only range is unprotected and
+ * restored once, so `protectCalls` stays far below 2 × `sitesPatched`.
+ */
+typedef struct {
+    uint64_t sitesPatched;     // Pointer slots written
+    uint64_t pageRanges;       // Contiguous page ranges the sites fell into
+    uint64_t protectCalls;     // vm_protect() calls
+    uint64_t regionQueries;    // vm_region_64() calls (to record protections)
+    uint64_t imagesReplayed;   // Images already loaded when the first active
+                               // hooks were installed, hooked as dyld replayed them
+    uint64_t imagesAdded;      // Images hooked one by one as they were added later
+} HIAHHookStats;
+
+/**
+ * Copies the installation counters.
+ */
+void HIAHHookGetStats(HIAHHookStats *stats);
+
 /**
  * Find a function address by name in the specified image.
  *
+ * Looks the name up in the image's export trie (LC_DYLD_EXPORTS_TRIE or
+ * LC_DYLD_INFO), following re-exports into the dylibs they name, and falls
+ * back to the image's nlist symbol table for symbols the trie does not
+ * carry. Results, misses included, are memoized per image until dyld
+ * unloads it.
+ *
  * @param image The Mach-O header to search in
  * @param name The symbol name (without leading underscore)
  * @return The function address, or NULL if not found
  */
 void *HIAHHookFindSymbol(const HIAHMachHeader *image, const char *name);
 
+/**
+ * Find several symbols in one image, parsing its load commands once.
+ *
+ * @param image The Mach-O header to search in
+ * @param names Symbol names (without leading underscore)
+ * @param addresses Receives each address, or NULL where not found
+ * @param count Number of names
+ * @return Number of names found
+ */
+size_t HIAHHookFindSymbols(const HIAHMachHeader *image,
+                           const char *const *names,
+                           void **addresses,
+                           size_t count);
+
 /**
  * Get the Mach-O header for the main executable.
  */
@@ -0,0 +1,293 @@
+/**
+ * HIAHHookMetrics.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Per-thread sharded hook counters and latency histograms.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHHookMetrics.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *const HIAHHookMetricNames[HIAHHookMetricCount] = {
+    [HIAHHookMetricPosixSpawn]          = "posix_spawn",
+    [HIAHHookMetricExecve]              = "execve",
+    [HIAHHookMetricWaitpid]             = "waitpid",
+    [HIAHHookMetricFileActionsAddDup2]  = "posix_spawn_file_actions_adddup2",
+    [HIAHHookMetricFileActionsAddClose] = "posix_spawn_file_actions_addclose",
+};
+
+const char *HIAHHookMetricName(HIAHHookMetricID hook) {
+    return (unsigned)hook < HIAHHookMetricCount ? HIAHHookMetricNames[hook] : NULL;
+}
+
+HIAHHookMetricID HIAHHookMetricForName(const char *name) {
+    if (name) {
+        for (int i = 0; i < HIAHHookMetricCount; i++) {
+            if (strcmp(HIAHHookMetricNames[i], name) == 0) {
+                return (HIAHHookMetricID)i;
+            }
+        }
+    }
+    return HIAHHookMetricCount;
+}
+
+uint64_t HIAHHookMetricsNow(void) {
+#ifdef __APPLE__
+    // Reads the commpage, no syscall
+    return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static unsigned HIAHHookMetricBucket(uint64_t nanoseconds) {
+    if (nanoseconds == 0) {
+        return 0;
+    }
+    unsigned bucket = 64 - (unsigned)__builtin_clzll(nanoseconds);
+    return bucket < HIAH_HOOK_METRIC_BUCKETS ? bucket : HIAH_HOOK_METRIC_BUCKETS - 1;
+}
+
+void HIAHHookMetricsAdd(HIAHHookMetric *into, const HIAHHookMetric *from) {
+    into->calls += from->calls;
+    into->nanoseconds += from->nanoseconds;
+    for (int b = 0; b < HIAH_HOOK_METRIC_BUCKETS; b++) {
+        into->buckets[b] += from->buckets[b];
+    }
+}
+
+void HIAHHookMetricsSubtract(HIAHHookMetric *from, const HIAHHookMetric *earlier) {
+    from->calls -= earlier->calls;
+    from->nanoseconds -= earlier->nanoseconds;
+    for (int b = 0; b < HIAH_HOOK_METRIC_BUCKETS; b++) {
+        from->buckets[b] -= earlier->buckets[b];
+    }
+}
+
+uint64_t HIAHHookMetricPercentile(const HIAHHookMetric *metric, double percentile) {
+    if (metric->calls == 0) {
+        return 0;
+    }
+    if (percentile < 0) {
+        percentile = 0;
+    } else if (percentile > 100) {
+        percentile = 100;
+    }
+    // Rank of the wanted call, 1-based
+    uint64_t rank = (uint64_t)((double)metric->calls * percentile / 100.0);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int b = 0; b < HIAH_HOOK_METRIC_BUCKETS - 1; b++) {
+        seen += metric->buckets[b];
+        if (seen >= rank) {
+            return 1ull << b;
+        }
+    }
+    return UINT64_MAX;
+}
+
+// MARK: - Shards
+
+#if HIAH_HOOK_METRICS
+
+typedef struct {
+    _Atomic uint64_t calls;
+    _Atomic uint64_t nanoseconds;
+    _Atomic uint64_t buckets[HIAH_HOOK_METRIC_BUCKETS];
+} HIAHHookMetricCounters;
+
+/**
+ * One thread's counters. Only the owning thread writes them, so updates are
+ * a relaxed load and store rather than an atomic add; readers may see a call
+ * counted before its bucket, which a snapshot tolerates.
+ *
+ * Shards are never freed: a reader may be walking the list at any time, and
+ * a released shard keeps its counts for the next thread that claims it.
+ */
+typedef struct HIAHHookMetricsShard {
+    HIAHHookMetricCounters hooks[HIAHHookMetricCount];
+    struct HIAHHookMetricsShard *next;
+    atomic_bool claimed;
+} __attribute__((aligned(64))) HIAHHookMetricsShard;
+
+static _Atomic(HIAHHookMetricsShard *) g_shards;
+static pthread_key_t g_shardKey;
+static pthread_once_t g_shardKeyOnce = PTHREAD_ONCE_INIT;
+static __thread HIAHHookMetricsShard *t_shard;
+
+static void HIAHHookMetricsReleaseShard(void *value) {
+    HIAHHookMetricsShard *shard = value;
+    // A hook running in a later TLS destructor claims a shard again
+    t_shard = NULL;
+    atomic_store_explicit(&shard->claimed, false, memory_order_release);
+}
+
+static void HIAHHookMetricsCreateKey(void) {
+    pthread_key_create(&g_shardKey, HIAHHookMetricsReleaseShard);
+}
+
+static HIAHHookMetricsShard *HIAHHookMetricsClaimShard(void) {
+    pthread_once(&g_shardKeyOnce, HIAHHookMetricsCreateKey);
+
+    HIAHHookMetricsShard *shard = atomic_load_explicit(&g_shards, memory_order_acquire);
+    for (; shard; shard = shard->next) {
+        bool expected = false;
+        if (!atomic_load_explicit(&shard->claimed, memory_order_relaxed) &&
+            atomic_compare_exchange_strong_explicit(&shard->claimed, &expected, true,
+                                                    memory_order_acquire,
+                                                    memory_order_relaxed)) {
+            break;
+        }
+    }
+
+    if (!shard) {
+        if (posix_memalign((void **)&shard, 64, sizeof(*shard)) != 0) {
+            return NULL;
+        }
+        memset(shard, 0, sizeof(*shard));
+        atomic_init(&shard->claimed, true);
+        HIAHHookMetricsShard *head = atomic_load_explicit(&g_shards, memory_order_relaxed);
+        do {
+            shard->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&g_shards, &head, shard,
+                                                        memory_order_release,
+                                                        memory_order_relaxed));
+    }
+
+    pthread_setspecific(g_shardKey, shard);
+    t_shard = shard;
+    return shard;
+}
+
+static inline void HIAHHookMetricsBump(_Atomic uint64_t *counter, uint64_t amount) {
+    atomic_store_explicit(counter,
+                          atomic_load_explicit(counter, memory_order_relaxed) + amount,
+                          memory_order_relaxed);
+}
+
+void HIAHHookMetricsRecord(HIAHHookMetricID hook, uint64_t start) {
+    uint64_t elapsed = HIAHHookMetricsNow() - start;
+    if ((unsigned)hook >= HIAHHookMetricCount) {
+        return;
+    }
+    HIAHHookMetricsShard *shard = t_shard;
+    if (!shard && !(shard = HIAHHookMetricsClaimShard())) {
+        return;
+    }
+    HIAHHookMetricCounters *counters = &shard->hooks[hook];
+    HIAHHookMetricsBump(&counters->calls, 1);
+    HIAHHookMetricsBump(&counters->nanoseconds, elapsed);
+    HIAHHookMetricsBump(&counters->buckets[HIAHHookMetricBucket(elapsed)], 1);
+}
+
+void HIAHHookMetricsSnapshot(HIAHHookMetric metrics[HIAHHookMetricCount]) {
+    memset(metrics, 0, sizeof(HIAHHookMetric) * HIAHHookMetricCount);
+    HIAHHookMetricsShard *shard = atomic_load_explicit(&g_shards, memory_order_acquire);
+    for (; shard; shard = shard->next) {
+        for (int h = 0; h < HIAHHookMetricCount; h++) {
+            HIAHHookMetricCounters *counters = &shard->hooks[h];
+            metrics[h].calls += atomic_load_explicit(&counters->calls, memory_order_relaxed);
+            metrics[h].nanoseconds +=
+                atomic_load_explicit(&counters->nanoseconds, memory_order_relaxed);
+            for (int b = 0; b < HIAH_HOOK_METRIC_BUCKETS; b++) {
+                metrics[h].buckets[b] +=
+                    atomic_load_explicit(&counters->buckets[b], memory_order_relaxed);
+            }
+        }
+    }
+}
+
+#else
+
+void HIAHHookMetricsRecord(HIAHHookMetricID hook, uint64_t start) {
+    (void)hook;
+    (void)start;
+}
+
+void HIAHHookMetricsSnapshot(HIAHHookMetric metrics[HIAHHookMetricCount]) {
+    memset(metrics, 0, sizeof(HIAHHookMetric) * HIAHHookMetricCount);
+}
+
+#endif
+
+// MARK: - Wire Format
+
+void HIAHHookMetricsEncode(HIAHControlWriter *writer,
+                           const HIAHHookMetric metrics[HIAHHookMetricCount]) {
+    for (int h = 0; h < HIAHHookMetricCount; h++) {
+        const HIAHHookMetric *metric = &metrics[h];
+        if (metric->calls == 0) {
+            continue;
+        }
+        size_t mark = HIAHControlWriterBeginMessage(writer, HIAHControlFieldHookMetric);
+        HIAHControlWriterAddString(writer, HIAHControlFieldName, HIAHHookMetricNames[h]);
+        HIAHControlWriterAddInt(writer, HIAHControlFieldCalls, (int64_t)metric->calls);
+        HIAHControlWriterAddInt(writer, HIAHControlFieldNanoseconds,
+                                (int64_t)metric->nanoseconds);
+        // Trailing empty buckets are implied
+        int used = HIAH_HOOK_METRIC_BUCKETS;
+        while (used > 0 && metric->buckets[used - 1] == 0) {
+            used--;
+        }
+        for (int b = 0; b < used; b++) {
+            HIAHControlWriterAddInt(writer, HIAHControlFieldBucket, (int64_t)metric->buckets[b]);
+        }
+        HIAHControlWriterEndMessage(writer, mark);
+    }
+}
+
+bool HIAHHookMetricsDecode(const HIAHControlField *field,
+                           HIAHHookMetric metrics[HIAHHookMetricCount]) {
+    if (field->kind != HIAHControlKindMessage) {
+        return false;
+    }
+
+    HIAHControlReader reader;
+    HIAHControlReaderInitMessage(&reader, field);
+    HIAHHookMetric metric = {0};
+    HIAHHookMetricID hook = HIAHHookMetricCount;
+    int bucket = 0;
+    HIAHControlField child;
+    int status;
+    while ((status = HIAHControlReaderNext(&reader, &child)) == 1) {
+        switch (child.tag) {
+            case HIAHControlFieldName:
+                if (child.kind == HIAHControlKindString) {
+                    hook = HIAHHookMetricForName(HIAHControlFieldString(&child, NULL));
+                }
+                break;
+            case HIAHControlFieldCalls:
+                metric.calls = (uint64_t)HIAHControlFieldInt(&child);
+                break;
+            case HIAHControlFieldNanoseconds:
+                metric.nanoseconds = (uint64_t)HIAHControlFieldInt(&child);
+                break;
+            case HIAHControlFieldBucket:
+                if (bucket < HIAH_HOOK_METRIC_BUCKETS) {
+                    metric.buckets[bucket++] = (uint64_t)HIAHControlFieldInt(&child);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (status != 0) {
+        return false;
+    }
+    // Hooks this build does not know about are skipped, not an error
+    if (hook != HIAHHookMetricCount) {
+        HIAHHookMetricsAdd(&metrics[hook], &metric);
+    }
+    return true;
+}
@@ -0,0 +1,143 @@
+/**
+ * HIAHHookMetrics.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Call counters and latency histograms for the interception hooks.
+ *
+ * Every thread records into its own shard, with plain relaxed stores and no
+ * read-modify-write, so hooks on different threads never share a cache line.
+ * A snapshot sums all shards on demand. Shards of exited threads are handed
+ * to new threads, so the counts survive thread churn without the shard list
+ * growing with it.
+ *
+ * Latencies go into power-of-two buckets: bucket 0 counts calls under 1 ns,
+ * bucket i calls of [2^(i-1), 2^i) ns, and the last bucket everything above.
+ *
+ * Build with -DHIAH_HOOK_METRICS=0 to compile the instrumentation out:
+ * HIAH_HOOK_METRICS_SCOPE() then expands to nothing and the snapshot is all
+ * zeros.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_HOOK_METRICS_H
+#define HIAH_HOOK_METRICS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "HIAHControlProtocol.h"
+
+#ifndef HIAH_HOOK_METRICS
+#define HIAH_HOOK_METRICS 1
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HIAH_HOOK_METRIC_BUCKETS 32
+
+typedef enum {
+    HIAHHookMetricPosixSpawn = 0,
+    HIAHHookMetricExecve,
+    HIAHHookMetricWaitpid,
+    HIAHHookMetricFileActionsAddDup2,
+    HIAHHookMetricFileActionsAddClose,
+    HIAHHookMetricCount
+} HIAHHookMetricID;
+
+typedef struct {
+    uint64_t calls;
+    uint64_t nanoseconds;                          // Total time spent in the hook
+    uint64_t buckets[HIAH_HOOK_METRIC_BUCKETS];
+} HIAHHookMetric;
+
+/**
+ * @return The hooked function's name ("posix_spawn")
+ */
+const char *HIAHHookMetricName(HIAHHookMetricID hook);
+
+/**
+ * @return The hook named `name`, or HIAHHookMetricCount
+ */
+HIAHHookMetricID HIAHHookMetricForName(const char *name);
+
+/**
+ * @return Monotonic time in nanoseconds
+ */
+uint64_t HIAHHookMetricsNow(void);
+
+/**
+ * Records one call that started at `start` (from HIAHHookMetricsNow()).
+ */
+void HIAHHookMetricsRecord(HIAHHookMetricID hook, uint64_t start);
+
+/**
+ * Sums every thread's shard.
+ */
+void HIAHHookMetricsSnapshot(HIAHHookMetric metrics[HIAHHookMetricCount]);
+
+/**
+ * Adds a metric recorded elsewhere, e.g. by a guest process, to `into`.
+ */
+void HIAHHookMetricsAdd(HIAHHookMetric *into, const HIAHHookMetric *from);
+
+/**
+ * Removes the calls in `earlier`, a previous snapshot, from `from`.
+ */
+void HIAHHookMetricsSubtract(HIAHHookMetric *from, const HIAHHookMetric *earlier);
+
+/**
+ * Upper bound, in nanoseconds, of the bucket holding the `percentile`th
+ * call (0-100). 0 if the hook was never called.
+ */
+uint64_t HIAHHookMetricPercentile(const HIAHHookMetric *metric, double percentile);
+
+/**
+ * Adds one HIAHControlFieldHookMetric message per hook that was called.
+ */
+void HIAHHookMetricsEncode(HIAHControlWriter *writer,
+                           const HIAHHookMetric metrics[HIAHHookMetricCount]);
+
+/**
+ * Adds one HIAHControlFieldHookMetric message to `metrics`. Hooks this build
+ * does not know are skipped.
+ *
+ * @return false if the message is malformed
+ */
+bool HIAHHookMetricsDecode(const HIAHControlField *field,
+                           HIAHHookMetric metrics[HIAHHookMetricCount]);
+
+#if HIAH_HOOK_METRICS
+
+typedef struct {
+    uint64_t start;
+    HIAHHookMetricID hook;
+} HIAHHookMetricsScope;
+
+static inline void HIAHHookMetricsScopeEnd(HIAHHookMetricsScope *scope) {
+    HIAHHookMetricsRecord(scope->hook, scope->start);
+}
+
+/**
+ * Times the rest of the enclosing block, whichever way it returns.
+ */
+#define HIAH_HOOK_METRICS_SCOPE(hook) \
+    __attribute__((cleanup(HIAHHookMetricsScopeEnd), unused)) \
+    HIAHHookMetricsScope hiahHookMetricsScope = { HIAHHookMetricsNow(), (hook) }
+
+#else
+
+#define HIAH_HOOK_METRICS_SCOPE(hook)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_HOOK_METRICS_H */
@@ -0,0 +1,191 @@
+/**
+ * HIAHHookRegistry.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Registry of active hooks, applied to each image as it is added.
+ *
+ * The bindings only grow, so an index into them stays valid. The lock is
+ * never held while calling the apply or watch callbacks: dyld may hold its
+ * own lock while it reports an image, and applying a hook calls into dyld.
+ * Each image is applied a snapshot of the bindings and the counts are
+ * added back afterwards.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHHookRegistry.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIAH_REGISTRY_INLINE_BINDINGS 16
+
+struct HIAHHookRegistry {
+    pthread_mutex_t lock;
+    HIAHHookRegistryApply apply;
+    HIAHHookRegistryWatch watch;
+    void *context;
+
+    HIAHHookBinding *active;
+    size_t count;
+    size_t capacity;
+
+    bool watching;
+    bool replaying;            // The feed is replaying loaded images...
+    pthread_t replayThread;    // ...on this thread
+
+    HIAHHookRegistryStats stats;
+};
+
+HIAHHookRegistry *HIAHHookRegistryCreate(HIAHHookRegistryApply apply, HIAHHookRegistryWatch watch,
+                                         void *context) {
+    if (!apply || !watch) {
+        return NULL;
+    }
+    HIAHHookRegistry *registry = calloc(1, sizeof(HIAHHookRegistry));
+    if (!registry) {
+        return NULL;
+    }
+    pthread_mutex_init(&registry->lock, NULL);
+    registry->apply = apply;
+    registry->watch = watch;
+    registry->context = context;
+    return registry;
+}
+
+void HIAHHookRegistryDestroy(HIAHHookRegistry *registry) {
+    if (!registry) {
+        return;
+    }
+    for (size_t i = 0; i < registry->count; i++) {
+        free((char *)registry->active[i].name);
+    }
+    free(registry->active);
+    pthread_mutex_destroy(&registry->lock);
+    free(registry);
+}
+
+// Caller holds `lock`. Adds the counts of an apply pass to the bindings
+// from `first` on.
+static void HIAHHookRegistryCount(HIAHHookRegistry *registry, size_t first,
+                                  const HIAHHookBinding *pass, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        registry->active[first + i].rewritten += pass[i].rewritten;
+        registry->stats.rewritten += pass[i].rewritten;
+    }
+}
+
+void HIAHHookRegistryImageAdded(HIAHHookRegistry *registry, const void *image) {
+    if (!registry || !image) {
+        return;
+    }
+
+    HIAHHookBinding inlineBindings[HIAH_REGISTRY_INLINE_BINDINGS];
+    HIAHHookBinding *snapshot = inlineBindings;
+    pthread_mutex_lock(&registry->lock);
+    size_t count = registry->count;
+    bool replayed = registry->replaying && pthread_equal(registry->replayThread, pthread_self());
+    if (count > HIAH_REGISTRY_INLINE_BINDINGS) {
+        snapshot = malloc(count * sizeof(HIAHHookBinding));
+    }
+    if (snapshot && count > 0) {
+        memcpy(snapshot, registry->active, count * sizeof(HIAHHookBinding));
+    }
+    pthread_mutex_unlock(&registry->lock);
+    if (!snapshot || count == 0) {
+        return;
+    }
+
+    // Only this image is scanned
+    registry->apply(image, snapshot, count, registry->context);
+
+    pthread_mutex_lock(&registry->lock);
+    HIAHHookRegistryCount(registry, 0, snapshot, count);
+    if (replayed) {
+        registry->stats.imagesReplayed++;
+    } else {
+        registry->stats.imagesAdded++;
+    }
+    pthread_mutex_unlock(&registry->lock);
+
+    if (snapshot != inlineBindings) {
+        free(snapshot);
+    }
+}
+
+bool HIAHHookRegistryAdd(HIAHHookRegistry *registry, HIAHHookBinding *bindings, size_t count) {
+    pthread_mutex_lock(&registry->lock);
+    if (registry->count + count > registry->capacity) {
+        size_t capacity = registry->capacity ? registry->capacity : 16;
+        while (capacity < registry->count + count) {
+            capacity *= 2;
+        }
+        HIAHHookBinding *grown = realloc(registry->active, capacity * sizeof(*grown));
+        if (!grown) {
+            pthread_mutex_unlock(&registry->lock);
+            return false;
+        }
+        registry->active = grown;
+        registry->capacity = capacity;
+    }
+    size_t first = registry->count;
+    for (size_t i = 0; i < count; i++) {
+        HIAHHookBinding *entry = &registry->active[first + i];
+        *entry = bindings[i];
+        entry->rewritten = 0;
+        if (bindings[i].name && !(entry->name = strdup(bindings[i].name))) {
+            while (i-- > 0) {
+                free((char *)registry->active[first + i].name);
+            }
+            pthread_mutex_unlock(&registry->lock);
+            return false;
+        }
+    }
+    // Published before the images are scanned, so an image added meanwhile
+    // is hooked by the feed (applying a hook twice is harmless)
+    registry->count += count;
+    registry->stats.bindings += count;
+    bool startWatching = !registry->watching;
+    if (startWatching) {
+        registry->watching = true;
+        registry->replaying = true;
+        registry->replayThread = pthread_self();
+    }
+    pthread_mutex_unlock(&registry->lock);
+
+    if (startWatching) {
+        // The replay of the loaded images is the initial install
+        registry->watch(registry, registry->context);
+        pthread_mutex_lock(&registry->lock);
+        registry->replaying = false;
+        pthread_mutex_unlock(&registry->lock);
+    } else {
+        HIAHHookBinding inlineBindings[HIAH_REGISTRY_INLINE_BINDINGS];
+        HIAHHookBinding *pass = count > HIAH_REGISTRY_INLINE_BINDINGS
+            ? malloc(count * sizeof(HIAHHookBinding)) : inlineBindings;
+        if (pass) {
+            memcpy(pass, bindings, count * sizeof(HIAHHookBinding));
+            registry->apply(NULL, pass, count, registry->context);
+            pthread_mutex_lock(&registry->lock);
+            HIAHHookRegistryCount(registry, first, pass, count);
+            pthread_mutex_unlock(&registry->lock);
+            if (pass != inlineBindings) {
+                free(pass);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&registry->lock);
+    for (size_t i = 0; i < count; i++) {
+        bindings[i].rewritten = registry->active[first + i].rewritten;
+    }
+    pthread_mutex_unlock(&registry->lock);
+    return true;
+}
+
+void HIAHHookRegistryGetStats(HIAHHookRegistry *registry, HIAHHookRegistryStats *stats) {
+    pthread_mutex_lock(&registry->lock);
+    *stats = registry->stats;
+    pthread_mutex_unlock(&registry->lock);
+}
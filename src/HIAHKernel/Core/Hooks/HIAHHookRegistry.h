@@ -0,0 +1,89 @@
+/**
+ * HIAHHookRegistry.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Registry of active hooks, applied to each image as it is added.
+ *
+ * This is the bookkeeping half of HIAHHookInterceptPersistent: the active
+ * bindings, the snapshot taken for each added image and the `rewritten`
+ * totals. Scanning and writing an image is left to an apply callback
+ * (HIAHHookInterceptBatch in HIAHHook.c), and images come from a feed the
+ * registry starts with the first hooks (dyld's add-image callback on
+ * Darwin, a simulated one in the host tests).
+ *
+ * An added image is scanned for the active hooks and nothing else; hooks
+ * added later are applied to every image loaded so far, once. The feed
+ * replays the images already loaded when it starts; those are counted
+ * apart from images added afterwards.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_HOOK_REGISTRY_H
+#define HIAH_HOOK_REGISTRY_H
+
+#include "HIAHHookTargets.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct HIAHHookRegistry HIAHHookRegistry;
+
+/**
+ * Applies `bindings` to one image, or to every loaded image if `image` is
+ * NULL, setting each binding's `rewritten`. Called without the registry's
+ * lock.
+ */
+typedef void (*HIAHHookRegistryApply)(const void *image, HIAHHookBinding *bindings, size_t count,
+                                      void *context);
+
+/**
+ * Starts the image feed: HIAHHookRegistryImageAdded() for every image
+ * already loaded, before returning, then for each image added later.
+ */
+typedef void (*HIAHHookRegistryWatch)(HIAHHookRegistry *registry, void *context);
+
+typedef struct {
+    uint64_t bindings;         // Active hooks
+    uint64_t rewritten;        // Pointer slots they rewrote, all images
+    uint64_t imagesReplayed;   // Images already loaded when the feed started
+    uint64_t imagesAdded;      // Images hooked one by one as they were added
+} HIAHHookRegistryStats;
+
+HIAHHookRegistry *HIAHHookRegistryCreate(HIAHHookRegistryApply apply, HIAHHookRegistryWatch watch,
+                                         void *context);
+
+/**
+ * Frees the registry. No image may be added meanwhile.
+ */
+void HIAHHookRegistryDestroy(HIAHHookRegistry *registry);
+
+/**
+ * Makes `bindings` active and applies them to the images loaded so far:
+ * through the feed's replay the first time, with one apply over all images
+ * after that. Names are copied; `rewritten` receives the count for the
+ * images loaded so far.
+ *
+ * @return false if memory ran out, with no binding added
+ */
+bool HIAHHookRegistryAdd(HIAHHookRegistry *registry, HIAHHookBinding *bindings, size_t count);
+
+/**
+ * Applies the active hooks to one newly added image only. Thread-safe.
+ */
+void HIAHHookRegistryImageAdded(HIAHHookRegistry *registry, const void *image);
+
+void HIAHHookRegistryGetStats(HIAHHookRegistry *registry, HIAHHookRegistryStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_HOOK_REGISTRY_H */
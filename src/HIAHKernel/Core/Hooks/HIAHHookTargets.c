@@ -0,0 +1,180 @@
+/**
+ * HIAHHookTargets.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Hook target set and symbol pointer section scan.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHHookTargets.h"
+#include "HIAHMachOFormat.h"
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint32_t magic;
+    int32_t cputype;
+    int32_t cpusubtype;
+    uint32_t filetype;
+    uint32_t ncmds;
+    uint32_t sizeofcmds;
+    uint32_t flags;
+    uint32_t reserved;
+} HIAHTargetsHeader;
+
+typedef struct {
+    uint32_t cmd;
+    uint32_t cmdsize;
+} HIAHTargetsLoadCommand;
+
+typedef struct {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    char segname[16];
+    uint64_t vmaddr;
+    uint64_t vmsize;
+    uint64_t fileoff;
+    uint64_t filesize;
+    int32_t maxprot;
+    int32_t initprot;
+    uint32_t nsects;
+    uint32_t flags;
+} HIAHTargetsSegment;
+
+typedef struct {
+    char sectname[16];
+    char segname[16];
+    uint64_t addr;
+    uint64_t size;
+    uint32_t offset;
+    uint32_t align;
+    uint32_t reloff;
+    uint32_t nreloc;
+    uint32_t flags;
+    uint32_t reserved1;
+    uint32_t reserved2;
+    uint32_t reserved3;
+} HIAHTargetsSection;
+
+// MARK: - Target Set
+
+static int HIAHHookCompareTargets(const void *a, const void *b) {
+    const HIAHHookTarget *left = a;
+    const HIAHHookTarget *right = b;
+    if (left->target != right->target) {
+        return left->target < right->target ? -1 : 1;
+    }
+    // Equal originals: keep caller order so the first binding wins
+    return left->binding < right->binding ? -1 : left->binding > right->binding;
+}
+
+void HIAHHookTargetSetBuild(HIAHHookTargetSet *set,
+                            HIAHHookTarget *storage,
+                            HIAHHookBinding *bindings,
+                            size_t count) {
+    size_t used = 0;
+    for (size_t i = 0; i < count; i++) {
+        bindings[i].rewritten = 0;
+        if (!bindings[i].original || bindings[i].name) {
+            continue;
+        }
+        storage[used].target = (uintptr_t)HIAH_STRIP_PTR(bindings[i].original);
+        storage[used].binding = &bindings[i];
+        used++;
+    }
+    qsort(storage, used, sizeof(HIAHHookTarget), HIAHHookCompareTargets);
+
+    size_t unique = 0;
+    for (size_t i = 0; i < used; i++) {
+        if (unique > 0 && storage[unique - 1].target == storage[i].target) {
+            continue;
+        }
+        storage[unique++] = storage[i];
+    }
+
+    set->targets = storage;
+    set->count = unique;
+    set->lowest = unique ? storage[0].target : UINTPTR_MAX;
+    set->highest = unique ? storage[unique - 1].target : 0;
+}
+
+HIAHHookBinding *HIAHHookTargetSetLookup(const HIAHHookTargetSet *set, uintptr_t value) {
+    if (value < set->lowest || value > set->highest) {
+        return NULL;
+    }
+    size_t low = 0;
+    size_t high = set->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (set->targets[mid].target < value) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < set->count && set->targets[low].target == value) {
+        return set->targets[low].binding;
+    }
+    return NULL;
+}
+
+// MARK: - Image Scan
+
+size_t HIAHHookScanImage(const void *header,
+                         const HIAHHookTargetSet *set,
+                         HIAHHookSlotMatch match,
+                         void *context) {
+    const HIAHTargetsHeader *mh = header;
+    if (!mh || mh->magic != HIAH_MACHO_MAGIC_64 || set->count == 0) {
+        return 0;
+    }
+    const uint8_t *commands = (const uint8_t *)header + sizeof(HIAHTargetsHeader);
+
+    // The slide, as getsectiondata() works it out: __TEXT maps the header
+    uintptr_t slide = 0;
+    const uint8_t *cursor = commands;
+    for (uint32_t i = 0; i < mh->ncmds; i++) {
+        const HIAHTargetsLoadCommand *command = (const HIAHTargetsLoadCommand *)cursor;
+        if (command->cmd == HIAH_LC_SEGMENT_64) {
+            const HIAHTargetsSegment *segment = (const HIAHTargetsSegment *)cursor;
+            if (strncmp(segment->segname, "__TEXT", sizeof(segment->segname)) == 0) {
+                slide = (uintptr_t)header - (uintptr_t)segment->vmaddr;
+                break;
+            }
+        }
+        cursor += command->cmdsize;
+    }
+
+    size_t scanned = 0;
+    cursor = commands;
+    for (uint32_t i = 0; i < mh->ncmds; i++) {
+        const HIAHTargetsLoadCommand *command = (const HIAHTargetsLoadCommand *)cursor;
+
+        // Symbol pointer tables live in __DATA and __DATA_CONST
+        if (command->cmd == HIAH_LC_SEGMENT_64) {
+            const HIAHTargetsSegment *segment = (const HIAHTargetsSegment *)cursor;
+            const HIAHTargetsSection *sections = (const HIAHTargetsSection *)(segment + 1);
+            for (uint32_t j = 0; strncmp(segment->segname, "__DATA", 6) == 0 && j < segment->nsects; j++) {
+                uint32_t type = sections[j].flags & HIAH_SECTION_TYPE;
+                if (type != HIAH_S_LAZY_SYMBOL_POINTERS && type != HIAH_S_NON_LAZY_SYMBOL_POINTERS) {
+                    continue;
+                }
+
+                void **pointers = (void **)(uintptr_t)(sections[j].addr + slide);
+                size_t pointerCount = (size_t)(sections[j].size / sizeof(void *));
+                for (size_t k = 0; k < pointerCount; k++) {
+                    HIAHHookBinding *binding =
+                        HIAHHookTargetSetLookup(set, (uintptr_t)HIAH_STRIP_PTR(pointers[k]));
+                    if (binding) {
+                        match(&pointers[k], binding, context);
+                    }
+                }
+                scanned += pointerCount;
+            }
+        }
+        cursor += command->cmdsize;
+    }
+    return scanned;
+}
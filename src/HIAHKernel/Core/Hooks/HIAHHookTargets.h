@@ -0,0 +1,103 @@
+/**
+ * HIAHHookTargets.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Hook target set and symbol pointer section scan.
+ *
+ * This is the matching half of HIAHHookInterceptBatch: the originals of a
+ * batch go into one sorted set, and a single walk over an image's
+ * `__DATA*` symbol pointer sections looks every slot up in it. Writing the
+ * matched slots (page protections, pointer signing) stays in HIAHHook.c.
+ *
+ * Images are read as mapped 64-bit Mach-O (MH_MAGIC_64); anything else is
+ * skipped. Section addresses are slid by the distance between the header
+ * and `__TEXT`'s vmaddr, as getsectiondata() does.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_HOOK_TARGETS_H
+#define HIAH_HOOK_TARGETS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pointer authentication support
+#if __arm64e__
+#include <ptrauth.h>
+#define HIAH_STRIP_PTR(ptr) ptrauth_strip(ptr, ptrauth_key_asia)
+#else
+#define HIAH_STRIP_PTR(ptr) (ptr)
+#endif
+
+/**
+ * One hook in a batch passed to HIAHHookInterceptBatch.
+ */
+typedef struct {
+    void *original;        // Function to intercept (NULL entries are skipped)
+    void *replacement;     // Function to call instead
+    const char *name;      // Symbol to rebind by name instead (NULL = match `original`)
+    uint32_t rewritten;    // Out: pointer slots rewritten for this hook
+} HIAHHookBinding;
+
+/**
+ * Hook targets of one install pass, sorted by stripped address.
+ */
+typedef struct {
+    uintptr_t target;
+    HIAHHookBinding *binding;
+} HIAHHookTarget;
+
+typedef struct {
+    HIAHHookTarget *targets;
+    size_t count;
+    uintptr_t lowest;      // Cheap range check before the binary search
+    uintptr_t highest;
+} HIAHHookTargetSet;
+
+/**
+ * Fills `set` from the unnamed bindings, dropping NULL originals and
+ * duplicates (the first binding for an original wins). Resets every
+ * binding's `rewritten`.
+ *
+ * @param storage Room for `count` targets; owned by the caller
+ */
+void HIAHHookTargetSetBuild(HIAHHookTargetSet *set,
+                            HIAHHookTarget *storage,
+                            HIAHHookBinding *bindings,
+                            size_t count);
+
+/**
+ * @return The binding whose original is `value` (already stripped), or NULL
+ */
+HIAHHookBinding *HIAHHookTargetSetLookup(const HIAHHookTargetSet *set, uintptr_t value);
+
+/**
+ * Called for every slot whose stripped value is in the set.
+ */
+typedef void (*HIAHHookSlotMatch)(void **slot, HIAHHookBinding *binding, void *context);
+
+/**
+ * Walks the lazy and non-lazy symbol pointer sections of the `__DATA*`
+ * segments of one mapped image and reports every slot that matches.
+ *
+ * @return Number of slots looked at
+ */
+size_t HIAHHookScanImage(const void *header,
+                         const HIAHHookTargetSet *set,
+                         HIAHHookSlotMatch match,
+                         void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_HOOK_TARGETS_H */
@@ -0,0 +1,328 @@
+/**
+ * HIAHSymbolIndex.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Name → symbol pointer slot index for one loaded Mach-O image.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHSymbolIndex.h"
+#include "HIAHMachOFormat.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    uint32_t cmd;
+    uint32_t cmdsize;
+} HIAHIndexLoadCommand;
+
+typedef struct {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t symoff;
+    uint32_t nsyms;
+    uint32_t stroff;
+    uint32_t strsize;
+} HIAHIndexSymtab;
+
+typedef struct {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    uint32_t ilocalsym, nlocalsym;
+    uint32_t iextdefsym, nextdefsym;
+    uint32_t iundefsym, nundefsym;
+    uint32_t tocoff, ntoc;
+    uint32_t modtaboff, nmodtab;
+    uint32_t extrefsymoff, nextrefsyms;
+    uint32_t indirectsymoff, nindirectsyms;
+    uint32_t extreloff, nextrel;
+    uint32_t locreloff, nlocrel;
+} HIAHIndexDysymtab;
+
+// Images are read at the native pointer width, as dyld maps them
+#ifdef __LP64__
+#define HIAH_INDEX_MAGIC HIAH_MACHO_MAGIC_64
+#define HIAH_INDEX_LC_SEGMENT HIAH_LC_SEGMENT_64
+typedef uint64_t HIAHIndexAddress;
+
+typedef struct {
+    uint32_t magic;
+    int32_t cputype;
+    int32_t cpusubtype;
+    uint32_t filetype;
+    uint32_t ncmds;
+    uint32_t sizeofcmds;
+    uint32_t flags;
+    uint32_t reserved;
+} HIAHIndexHeader;
+
+typedef struct {
+    uint32_t n_strx;
+    uint8_t n_type;
+    uint8_t n_sect;
+    uint16_t n_desc;
+    uint64_t n_value;
+} HIAHIndexNlist;
+#else
+#define HIAH_INDEX_MAGIC HIAH_MACHO_MAGIC
+#define HIAH_INDEX_LC_SEGMENT HIAH_LC_SEGMENT_32
+typedef uint32_t HIAHIndexAddress;
+
+typedef struct {
+    uint32_t magic;
+    int32_t cputype;
+    int32_t cpusubtype;
+    uint32_t filetype;
+    uint32_t ncmds;
+    uint32_t sizeofcmds;
+    uint32_t flags;
+} HIAHIndexHeader;
+
+typedef struct {
+    uint32_t n_strx;
+    uint8_t n_type;
+    uint8_t n_sect;
+    int16_t n_desc;
+    uint32_t n_value;
+} HIAHIndexNlist;
+#endif
+
+typedef struct {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    char segname[16];
+    HIAHIndexAddress vmaddr;
+    HIAHIndexAddress vmsize;
+    HIAHIndexAddress fileoff;
+    HIAHIndexAddress filesize;
+    int32_t maxprot;
+    int32_t initprot;
+    uint32_t nsects;
+    uint32_t flags;
+} HIAHIndexSegment;
+
+typedef struct {
+    char sectname[16];
+    char segname[16];
+    HIAHIndexAddress addr;
+    HIAHIndexAddress size;
+    uint32_t offset;
+    uint32_t align;
+    uint32_t reloff;
+    uint32_t nreloc;
+    uint32_t flags;
+    uint32_t reserved1;
+    uint32_t reserved2;
+#ifdef __LP64__
+    uint32_t reserved3;
+#endif
+} HIAHIndexSection;
+
+struct HIAHSymbolIndex {
+    const void *image;
+    const char *strings;
+    uint32_t stringsSize;
+    HIAHSymbolSlot *slots;     // Sorted by (hash, nameOffset)
+    size_t count;
+};
+
+// MARK: - Helpers
+
+// FNV-1a
+static uint32_t HIAHSymbolHash(const char *name) {
+    uint32_t hash = 2166136261u;
+    for (const unsigned char *c = (const unsigned char *)name; *c; c++) {
+        hash ^= *c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// C symbols carry a leading underscore in the string table
+static const char *HIAHSymbolCName(const char *name) {
+    return name[0] == '_' ? name + 1 : name;
+}
+
+static int HIAHSymbolCompareSlots(const void *a, const void *b) {
+    const HIAHSymbolSlot *left = a;
+    const HIAHSymbolSlot *right = b;
+    if (left->hash != right->hash) {
+        return left->hash < right->hash ? -1 : 1;
+    }
+    if (left->nameOffset != right->nameOffset) {
+        return left->nameOffset < right->nameOffset ? -1 : 1;
+    }
+    return left->address < right->address ? -1 : left->address > right->address;
+}
+
+static bool HIAHSymbolIsPointerSection(const HIAHIndexSection *section) {
+    uint32_t type = section->flags & HIAH_SECTION_TYPE;
+    return type == HIAH_S_LAZY_SYMBOL_POINTERS || type == HIAH_S_NON_LAZY_SYMBOL_POINTERS;
+}
+
+// MARK: - Index
+
+HIAHSymbolIndex *HIAHSymbolIndexCreate(const void *image) {
+    const HIAHIndexHeader *header = image;
+    if (!header || header->magic != HIAH_INDEX_MAGIC) {
+        return NULL;
+    }
+
+    const HIAHIndexSegment *text = NULL;
+    const HIAHIndexSegment *linkedit = NULL;
+    const HIAHIndexSymtab *symtab = NULL;
+    const HIAHIndexDysymtab *dysymtab = NULL;
+    size_t slotCount = 0;
+
+    // First pass: locate the tables and size the index
+    uintptr_t cursor = (uintptr_t)header + sizeof(HIAHIndexHeader);
+    for (uint32_t i = 0; i < header->ncmds; i++) {
+        const HIAHIndexLoadCommand *command = (const HIAHIndexLoadCommand *)cursor;
+        if (command->cmdsize < sizeof(HIAHIndexLoadCommand)) {
+            return NULL;
+        }
+        if (command->cmd == HIAH_INDEX_LC_SEGMENT) {
+            const HIAHIndexSegment *segment = (const HIAHIndexSegment *)command;
+            if (strncmp(segment->segname, "__TEXT", sizeof(segment->segname)) == 0) {
+                text = segment;
+            } else if (strncmp(segment->segname, "__LINKEDIT", sizeof(segment->segname)) == 0) {
+                linkedit = segment;
+            }
+            const HIAHIndexSection *sections = (const HIAHIndexSection *)(segment + 1);
+            for (uint32_t j = 0; j < segment->nsects; j++) {
+                if (HIAHSymbolIsPointerSection(&sections[j])) {
+                    slotCount += (size_t)(sections[j].size / sizeof(void *));
+                }
+            }
+        } else if (command->cmd == HIAH_LC_SYMTAB) {
+            symtab = (const HIAHIndexSymtab *)command;
+        } else if (command->cmd == HIAH_LC_DYSYMTAB) {
+            dysymtab = (const HIAHIndexDysymtab *)command;
+        }
+        cursor += command->cmdsize;
+    }
+
+    HIAHSymbolIndex *index = calloc(1, sizeof(*index));
+    if (!index) {
+        return NULL;
+    }
+    index->image = image;
+    if (!text || !linkedit || !symtab || !dysymtab || slotCount == 0) {
+        return index;   // Nothing imported through pointer sections
+    }
+
+    uintptr_t slide = (uintptr_t)header - (uintptr_t)text->vmaddr;
+    uintptr_t linkeditBase = slide + (uintptr_t)linkedit->vmaddr - (uintptr_t)linkedit->fileoff;
+    const HIAHIndexNlist *symbols = (const HIAHIndexNlist *)(linkeditBase + symtab->symoff);
+    const uint32_t *indirect = (const uint32_t *)(linkeditBase + dysymtab->indirectsymoff);
+    index->strings = (const char *)(linkeditBase + symtab->stroff);
+    index->stringsSize = symtab->strsize;
+
+    index->slots = malloc(slotCount * sizeof(HIAHSymbolSlot));
+    if (!index->slots) {
+        free(index);
+        return NULL;
+    }
+
+    // Second pass: one entry per slot that names a symbol
+    cursor = (uintptr_t)header + sizeof(HIAHIndexHeader);
+    for (uint32_t i = 0; i < header->ncmds; i++) {
+        const HIAHIndexLoadCommand *command = (const HIAHIndexLoadCommand *)cursor;
+        cursor += command->cmdsize;
+        if (command->cmd != HIAH_INDEX_LC_SEGMENT) {
+            continue;
+        }
+        const HIAHIndexSegment *segment = (const HIAHIndexSegment *)command;
+        const HIAHIndexSection *sections = (const HIAHIndexSection *)(segment + 1);
+        for (uint32_t j = 0; j < segment->nsects; j++) {
+            const HIAHIndexSection *section = &sections[j];
+            if (!HIAHSymbolIsPointerSection(section)) {
+                continue;
+            }
+            void **pointers = (void **)(slide + (uintptr_t)section->addr);
+            size_t pointerCount = (size_t)(section->size / sizeof(void *));
+            for (size_t k = 0; k < pointerCount; k++) {
+                size_t entry = (size_t)section->reserved1 + k;
+                if (entry >= dysymtab->nindirectsyms) {
+                    break;
+                }
+                uint32_t symbol = indirect[entry];
+                if (symbol & (HIAH_INDIRECT_SYMBOL_LOCAL | HIAH_INDIRECT_SYMBOL_ABS)) {
+                    continue;
+                }
+                if (symbol >= symtab->nsyms) {
+                    continue;
+                }
+                uint32_t nameOffset = symbols[symbol].n_strx;
+                if (nameOffset == 0 || nameOffset >= index->stringsSize) {
+                    continue;
+                }
+                const char *name = index->strings + nameOffset;
+                index->slots[index->count++] = (HIAHSymbolSlot){
+                    .address = &pointers[k],
+                    .hash = HIAHSymbolHash(HIAHSymbolCName(name)),
+                    .nameOffset = nameOffset,
+                };
+            }
+        }
+    }
+
+    qsort(index->slots, index->count, sizeof(HIAHSymbolSlot), HIAHSymbolCompareSlots);
+    return index;
+}
+
+void HIAHSymbolIndexDestroy(HIAHSymbolIndex *index) {
+    if (!index) {
+        return;
+    }
+    free(index->slots);
+    free(index);
+}
+
+const void *HIAHSymbolIndexImage(const HIAHSymbolIndex *index) {
+    return index->image;
+}
+
+const HIAHSymbolSlot *HIAHSymbolIndexFind(const HIAHSymbolIndex *index,
+                                          const char *name,
+                                          size_t *count) {
+    *count = 0;
+    if (!index || !name || index->count == 0) {
+        return NULL;
+    }
+
+    uint32_t hash = HIAHSymbolHash(name);
+    size_t low = 0;
+    size_t high = index->count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (index->slots[mid].hash < hash) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    // Slots of one symbol share a name offset and are adjacent
+    for (size_t i = low; i < index->count && index->slots[i].hash == hash;) {
+        uint32_t nameOffset = index->slots[i].nameOffset;
+        size_t run = i;
+        while (run < index->count && index->slots[run].hash == hash &&
+               index->slots[run].nameOffset == nameOffset) {
+            run++;
+        }
+        if (strcmp(HIAHSymbolCName(index->strings + nameOffset), name) == 0) {
+            *count = run - i;
+            return &index->slots[i];
+        }
+        i = run;
+    }
+    return NULL;
+}
+
+size_t HIAHSymbolIndexCount(const HIAHSymbolIndex *index) {
+    return index ? index->count : 0;
+}
@@ -0,0 +1,81 @@
+/**
+ * HIAHSymbolIndex.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Name → symbol pointer slot index for one loaded Mach-O image.
+ *
+ * Every lazy and non-lazy symbol pointer slot of an image belongs to an
+ * imported symbol: the section's `reserved1` is its first entry in the
+ * LC_DYSYMTAB indirect symbol table, which in turn indexes the LC_SYMTAB
+ * nlist entries and their names. Building the index walks that chain once;
+ * afterwards, finding every slot bound (or yet to be bound) to a symbol is a
+ * binary search, with no pointer comparisons and no dependency on whether a
+ * lazy stub has been called yet.
+ *
+ * The index reads the image as mapped in memory (with its slide applied);
+ * it does not call into dyld.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_SYMBOL_INDEX_H
+#define HIAH_SYMBOL_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct HIAHSymbolIndex HIAHSymbolIndex;
+
+/**
+ * One symbol pointer slot.
+ */
+typedef struct {
+    void **address;        // Slot in the loaded image
+    uint32_t hash;         // Hash of the symbol name (without the leading '_')
+    uint32_t nameOffset;   // String table offset of the symbol name
+} HIAHSymbolSlot;
+
+/**
+ * Builds the index of a loaded image.
+ *
+ * @param header The image's Mach-O header, as mapped by dyld
+ * @return The index (possibly empty), or NULL if the image is malformed or
+ *         memory runs out
+ */
+HIAHSymbolIndex *HIAHSymbolIndexCreate(const void *header);
+
+void HIAHSymbolIndexDestroy(HIAHSymbolIndex *index);
+
+/**
+ * @return The image the index was built from
+ */
+const void *HIAHSymbolIndexImage(const HIAHSymbolIndex *index);
+
+/**
+ * Finds every slot of an imported symbol.
+ *
+ * @param name C symbol name, without the leading underscore ("posix_spawn")
+ * @param count Receives the number of slots
+ * @return The first slot, or NULL if the image does not import `name`
+ */
+const HIAHSymbolSlot *HIAHSymbolIndexFind(const HIAHSymbolIndex *index,
+                                          const char *name,
+                                          size_t *count);
+
+/**
+ * @return Total number of slots in the index
+ */
+size_t HIAHSymbolIndexCount(const HIAHSymbolIndex *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_SYMBOL_INDEX_H */
@@ -0,0 +1,368 @@
+/**
+ * HIAHControlChannel.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Multiplexed control socket client.
+ *
+ * Two locks: `sendLock` keeps the order in which calls join the pending
+ * list equal to the order their frames hit the socket (which is what
+ * version 1 replies are matched by), and `lock` guards everything else.
+ * Whoever reads the socket does so without either lock.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHControlChannel.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+typedef struct HIAHControlPendingCall {
+    struct HIAHControlPendingCall *next;
+    uint64_t requestID;
+    uint8_t *reply;
+    size_t length;
+    bool done;
+    bool lost;
+} HIAHControlPendingCall;
+
+struct HIAHControlChannel {
+    char *socketPath;
+    pthread_mutex_t sendLock;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+
+    int fd;
+    uint8_t version;
+    bool broken;         // Shut down; replaced by the next call
+    bool unsupported;    // The kernel refused the binary protocol
+    bool reading;        // A waiting call is reading the socket
+    uint64_t nextRequestID;
+
+    // Sent and unanswered, in send order
+    HIAHControlPendingCall *head;
+    HIAHControlPendingCall *tail;
+    uint64_t inFlight;
+
+    HIAHControlChannelStats stats;
+    struct HIAHControlChannel *nextChannel;
+};
+
+// MARK: - Fork Handling
+
+static pthread_mutex_t g_channelsLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t g_atforkOnce = PTHREAD_ONCE_INIT;
+static HIAHControlChannel *g_channels;
+
+static void HIAHControlChannelsPrepare(void) {
+    pthread_mutex_lock(&g_channelsLock);
+    for (HIAHControlChannel *channel = g_channels; channel; channel = channel->nextChannel) {
+        pthread_mutex_lock(&channel->sendLock);
+        pthread_mutex_lock(&channel->lock);
+    }
+}
+
+static void HIAHControlChannelsParent(void) {
+    for (HIAHControlChannel *channel = g_channels; channel; channel = channel->nextChannel) {
+        pthread_mutex_unlock(&channel->lock);
+        pthread_mutex_unlock(&channel->sendLock);
+    }
+    pthread_mutex_unlock(&g_channelsLock);
+}
+
+// The child shares the parent's socket, so replies would reach whichever
+// process reads first: drop it (close only; shutdown would cut the parent
+// off too) and forget the calls of threads that do not exist here
+static void HIAHControlChannelsChild(void) {
+    for (HIAHControlChannel *channel = g_channels; channel; channel = channel->nextChannel) {
+        if (channel->fd >= 0) {
+            close(channel->fd);
+            channel->fd = -1;
+        }
+        channel->broken = false;
+        channel->reading = false;
+        channel->head = channel->tail = NULL;
+        channel->inFlight = 0;
+        pthread_cond_init(&channel->changed, NULL);
+        pthread_mutex_unlock(&channel->lock);
+        pthread_mutex_unlock(&channel->sendLock);
+    }
+    pthread_mutex_unlock(&g_channelsLock);
+}
+
+static void HIAHControlChannelsRegisterAtfork(void) {
+    pthread_atfork(HIAHControlChannelsPrepare, HIAHControlChannelsParent, HIAHControlChannelsChild);
+}
+
+// MARK: - Pending Calls
+
+// Caller holds `lock`
+static void HIAHControlChannelRemove(HIAHControlChannel *channel, HIAHControlPendingCall *call) {
+    HIAHControlPendingCall **link = &channel->head;
+    HIAHControlPendingCall *previous = NULL;
+    while (*link && *link != call) {
+        previous = *link;
+        link = &(*link)->next;
+    }
+    if (!*link) {
+        return;
+    }
+    *link = call->next;
+    if (channel->tail == call) {
+        channel->tail = previous;
+    }
+    call->next = NULL;
+    channel->inFlight--;
+}
+
+/**
+ * Shuts the connection down and fails every call waiting on it. The socket
+ * is closed by the next call to connect, once no reader is using it.
+ * Caller holds `lock`.
+ */
+static void HIAHControlChannelBreak(HIAHControlChannel *channel) {
+    if (channel->fd >= 0 && !channel->broken) {
+        shutdown(channel->fd, SHUT_RDWR);
+    }
+    channel->broken = true;
+    while (channel->head) {
+        HIAHControlPendingCall *call = channel->head;
+        channel->head = call->next;
+        call->next = NULL;
+        call->lost = true;
+        call->done = true;
+    }
+    channel->tail = NULL;
+    channel->inFlight = 0;
+    pthread_cond_broadcast(&channel->changed);
+}
+
+/**
+ * Hands a received reply to its call, taking ownership of `buffer`.
+ * Caller holds `lock`.
+ */
+static void HIAHControlChannelDeliver(HIAHControlChannel *channel, uint8_t *buffer, size_t length) {
+    HIAHControlReader reader;
+    if (!HIAHControlReaderInit(&reader, buffer, length, NULL)) {
+        free(buffer);
+        HIAHControlChannelBreak(channel);
+        return;
+    }
+
+    uint64_t requestID = 0;
+    HIAHControlField field;
+    while (HIAHControlReaderNext(&reader, &field) == 1) {
+        if (field.tag == HIAHControlFieldRequestID) {
+            requestID = (uint64_t)HIAHControlFieldInt(&field);
+            break;
+        }
+    }
+
+    // Without an ID the kernel answers in order: the reply is the oldest call's
+    HIAHControlPendingCall *call = channel->head;
+    if (requestID != 0) {
+        while (call && call->requestID != requestID) {
+            call = call->next;
+        }
+    }
+    if (!call) {
+        free(buffer);
+        return;
+    }
+    HIAHControlChannelRemove(channel, call);
+    call->reply = buffer;
+    call->length = length;
+    call->done = true;
+}
+
+// MARK: - Connection
+
+/**
+ * Makes sure the channel has a working connection. Caller holds both locks;
+ * `lock` is dropped while connecting.
+ */
+static HIAHControlChannelResult HIAHControlChannelEnsureConnected(HIAHControlChannel *channel) {
+    if (channel->unsupported) {
+        return HIAHControlChannelUnsupported;
+    }
+    if (channel->fd >= 0 && !channel->broken) {
+        return HIAHControlChannelOK;
+    }
+
+    // A reader still inside recv() has the old socket; it returns promptly
+    // after the shutdown
+    while (channel->reading) {
+        pthread_cond_wait(&channel->changed, &channel->lock);
+    }
+    if (channel->fd >= 0) {
+        close(channel->fd);
+        channel->fd = -1;
+    }
+    channel->broken = false;
+
+    pthread_mutex_unlock(&channel->lock);
+    uint8_t version = 0;
+    int fd = HIAHControlConnect(channel->socketPath, &version);
+    pthread_mutex_lock(&channel->lock);
+
+    if (fd < 0) {
+        return HIAHControlChannelUnavailable;
+    }
+    if (version == 0) {
+        close(fd);
+        channel->unsupported = true;
+        return HIAHControlChannelUnsupported;
+    }
+    channel->fd = fd;
+    channel->version = version;
+    channel->stats.connects++;
+    return HIAHControlChannelOK;
+}
+
+// MARK: - Public API
+
+HIAHControlChannel *HIAHControlChannelCreate(const char *socketPath) {
+    if (!socketPath) {
+        return NULL;
+    }
+    HIAHControlChannel *channel = calloc(1, sizeof(HIAHControlChannel));
+    if (!channel) {
+        return NULL;
+    }
+    channel->socketPath = strdup(socketPath);
+    if (!channel->socketPath) {
+        free(channel);
+        return NULL;
+    }
+    channel->fd = -1;
+    pthread_mutex_init(&channel->sendLock, NULL);
+    pthread_mutex_init(&channel->lock, NULL);
+    pthread_cond_init(&channel->changed, NULL);
+
+    pthread_once(&g_atforkOnce, HIAHControlChannelsRegisterAtfork);
+    pthread_mutex_lock(&g_channelsLock);
+    channel->nextChannel = g_channels;
+    g_channels = channel;
+    pthread_mutex_unlock(&g_channelsLock);
+    return channel;
+}
+
+void HIAHControlChannelDestroy(HIAHControlChannel *channel) {
+    if (!channel) {
+        return;
+    }
+    pthread_mutex_lock(&g_channelsLock);
+    HIAHControlChannel **link = &g_channels;
+    while (*link && *link != channel) {
+        link = &(*link)->nextChannel;
+    }
+    if (*link) {
+        *link = channel->nextChannel;
+    }
+    pthread_mutex_unlock(&g_channelsLock);
+
+    if (channel->fd >= 0) {
+        close(channel->fd);
+    }
+    pthread_cond_destroy(&channel->changed);
+    pthread_mutex_destroy(&channel->lock);
+    pthread_mutex_destroy(&channel->sendLock);
+    free(channel->socketPath);
+    free(channel);
+}
+
+HIAHControlChannelResult HIAHControlChannelCall(HIAHControlChannel *channel,
+                                                HIAHControlWriter *request,
+                                                uint8_t **reply,
+                                                size_t *replyLength) {
+    *reply = NULL;
+    *replyLength = 0;
+
+    pthread_mutex_lock(&channel->sendLock);
+    pthread_mutex_lock(&channel->lock);
+    channel->stats.calls++;
+    HIAHControlChannelResult result = HIAHControlChannelEnsureConnected(channel);
+    if (result != HIAHControlChannelOK) {
+        channel->stats.failures++;
+        pthread_mutex_unlock(&channel->lock);
+        pthread_mutex_unlock(&channel->sendLock);
+        return result;
+    }
+
+    HIAHControlPendingCall call = {0};
+    call.requestID = ++channel->nextRequestID;
+    if (channel->tail) {
+        channel->tail->next = &call;
+    } else {
+        channel->head = &call;
+    }
+    channel->tail = &call;
+    if (++channel->inFlight > channel->stats.peakInFlight) {
+        channel->stats.peakInFlight = channel->inFlight;
+    }
+    int fd = channel->fd;
+    bool tagged = channel->version >= HIAH_CONTROL_MULTIPLEXED;
+    pthread_mutex_unlock(&channel->lock);
+
+    if (tagged) {
+        HIAHControlWriterAddInt(request, HIAHControlFieldRequestID, (int64_t)call.requestID);
+    }
+    bool sent = !request->failed && HIAHControlSendFrame(fd, request->data, request->length);
+    pthread_mutex_unlock(&channel->sendLock);
+
+    pthread_mutex_lock(&channel->lock);
+    if (!sent) {
+        // Possibly a partial frame: nothing after it can be trusted
+        if (!call.done) {
+            HIAHControlChannelRemove(channel, &call);
+            HIAHControlChannelBreak(channel);
+        }
+        channel->stats.failures++;
+        pthread_mutex_unlock(&channel->lock);
+        return HIAHControlChannelUnavailable;
+    }
+
+    while (!call.done) {
+        if (channel->reading) {
+            pthread_cond_wait(&channel->changed, &channel->lock);
+            continue;
+        }
+
+        channel->reading = true;
+        int readFd = channel->fd;
+        pthread_mutex_unlock(&channel->lock);
+        uint8_t *buffer = NULL;
+        size_t capacity = 0, length = 0;
+        bool received = HIAHControlReceiveFrame(readFd, &buffer, &capacity, &length);
+        pthread_mutex_lock(&channel->lock);
+
+        channel->reading = false;
+        if (received) {
+            HIAHControlChannelDeliver(channel, buffer, length);
+        } else {
+            free(buffer);
+            HIAHControlChannelBreak(channel);
+        }
+        // Wakes the callers whose replies arrived and the next reader
+        pthread_cond_broadcast(&channel->changed);
+    }
+
+    if (call.lost) {
+        channel->stats.failures++;
+        result = HIAHControlChannelLost;
+    } else {
+        *reply = call.reply;
+        *replyLength = call.length;
+    }
+    pthread_mutex_unlock(&channel->lock);
+    return result;
+}
+
+void HIAHControlChannelGetStats(HIAHControlChannel *channel, HIAHControlChannelStats *stats) {
+    pthread_mutex_lock(&channel->lock);
+    *stats = channel->stats;
+    pthread_mutex_unlock(&channel->lock);
+}
@@ -0,0 +1,89 @@
+/**
+ * HIAHControlChannel.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Persistent, multiplexed client connection to the kernel control socket.
+ *
+ * One channel serves every thread of a guest. Each call tags its request
+ * with a fresh RequestID and waits for the reply carrying it, so spawns,
+ * waits and signals from different threads are in flight on the same
+ * connection at once. No reader thread is needed: while calls are waiting,
+ * one of them reads replies off the socket and hands each to its caller,
+ * then passes the job on once its own reply has arrived.
+ *
+ * The connection is opened on the first call and reopened on the next call
+ * after it breaks. A request that was sent before the connection broke is
+ * not resent, since the kernel may already have acted on it. In a forked
+ * child the channel starts over with a connection of its own.
+ *
+ * Kernels that only speak version 1 answer in request order and do not echo
+ * request IDs; the channel matches those replies in order instead. Kernels
+ * without the binary protocol are reported as unsupported, so callers can
+ * fall back to newline JSON.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_CONTROL_CHANNEL_H
+#define HIAH_CONTROL_CHANNEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "HIAHControlProtocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct HIAHControlChannel HIAHControlChannel;
+
+typedef enum {
+    HIAHControlChannelOK = 0,
+    HIAHControlChannelUnavailable,   // Cannot connect, or the request could not be sent
+    HIAHControlChannelUnsupported,   // The kernel only speaks newline JSON
+    HIAHControlChannelLost,          // Sent, but the connection broke before the reply
+} HIAHControlChannelResult;
+
+typedef struct {
+    uint64_t calls;
+    uint64_t connects;
+    uint64_t failures;
+    uint64_t peakInFlight;
+} HIAHControlChannelStats;
+
+/**
+ * Creates a channel. Nothing is connected until the first call.
+ */
+HIAHControlChannel *HIAHControlChannelCreate(const char *socketPath);
+
+/**
+ * Closes the connection and frees the channel. No call may be in progress.
+ */
+void HIAHControlChannelDestroy(HIAHControlChannel *channel);
+
+/**
+ * Sends one request and waits for its reply. Thread-safe.
+ *
+ * @param request A request built with HIAHControlWriter; the channel adds its
+ *                RequestID field to it
+ * @param reply Receives the reply payload (malloc'd, free it) on success
+ */
+HIAHControlChannelResult HIAHControlChannelCall(HIAHControlChannel *channel,
+                                                HIAHControlWriter *request,
+                                                uint8_t **reply,
+                                                size_t *replyLength);
+
+/**
+ * Copies the counters.
+ */
+void HIAHControlChannelGetStats(HIAHControlChannel *channel, HIAHControlChannelStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_CONTROL_CHANNEL_H */
@@ -0,0 +1,417 @@
+/**
+ * HIAHControlEnvironment.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Delta-encoded environments for forwarded spawns.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHControlEnvironment.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIAH_CONTROL_ENVIRONMENT_DEFAULT_CAPACITY 64
+
+// Per string on the wire: u32 length plus NUL
+#define HIAH_CONTROL_ENVIRONMENT_STRING_OVERHEAD 5
+
+// MARK: - Entries
+
+static inline size_t HIAHControlEnvironmentKeyLength(const char *entry) {
+    return strcspn(entry, "=");
+}
+
+// Orders "KEY=VALUE" entries and bare keys by key alone
+static int HIAHControlEnvironmentCompareKeys(const void *a, const void *b) {
+    const char *left = *(const char *const *)a;
+    const char *right = *(const char *const *)b;
+    size_t leftLength = HIAHControlEnvironmentKeyLength(left);
+    size_t rightLength = HIAHControlEnvironmentKeyLength(right);
+    int order = memcmp(left, right, leftLength < rightLength ? leftLength : rightLength);
+    if (order != 0) {
+        return order;
+    }
+    return leftLength < rightLength ? -1 : leftLength > rightLength;
+}
+
+static int HIAHControlEnvironmentCompareEntries(const void *a, const void *b) {
+    return strcmp(*(const char *const *)a, *(const char *const *)b);
+}
+
+static size_t HIAHControlEnvironmentCount(const char *const *entries) {
+    size_t count = 0;
+    while (entries && entries[count]) {
+        count++;
+    }
+    return count;
+}
+
+char **HIAHControlEnvironmentPack(const char *const *entries, size_t count,
+                                  const char *const *extra) {
+    if (count == SIZE_MAX) {
+        count = HIAHControlEnvironmentCount(entries);
+    }
+    size_t extraCount = HIAHControlEnvironmentCount(extra);
+    size_t total = count + extraCount;
+
+    size_t bytes = 0;
+    for (size_t i = 0; i < total; i++) {
+        bytes += strlen(i < count ? entries[i] : extra[i - count]) + 1;
+    }
+    char **envp = malloc((total + 1) * sizeof(char *) + bytes);
+    if (!envp) {
+        return NULL;
+    }
+    char *cursor = (char *)(envp + total + 1);
+    for (size_t i = 0; i < total; i++) {
+        const char *entry = i < count ? entries[i] : extra[i - count];
+        size_t length = strlen(entry) + 1;
+        memcpy(cursor, entry, length);
+        envp[i] = cursor;
+        cursor += length;
+    }
+    envp[total] = NULL;
+    return envp;
+}
+
+char **HIAHControlEnvironmentPackReplacing(const char *const *entries, size_t count,
+                                           const char *const *extra) {
+    if (count == SIZE_MAX) {
+        count = HIAHControlEnvironmentCount(entries);
+    }
+    const char **kept = malloc((count + 1) * sizeof(char *));
+    if (!kept) {
+        return NULL;
+    }
+    size_t keptCount = 0;
+    for (size_t i = 0; i < count; i++) {
+        bool replaced = false;
+        for (size_t e = 0; extra && extra[e] && !replaced; e++) {
+            replaced = HIAHControlEnvironmentCompareKeys(&entries[i], &extra[e]) == 0;
+        }
+        if (!replaced) {
+            kept[keptCount++] = entries[i];
+        }
+    }
+    char **envp = HIAHControlEnvironmentPack(kept, keptCount, extra);
+    free(kept);
+    return envp;
+}
+
+// MARK: - Kernel Side
+
+typedef struct {
+    uint64_t handle;      // 0 = free
+    uint64_t hash;
+    uint64_t lastUse;
+    size_t count;
+    size_t bytes;
+    char **entries;       // Packed, sorted
+} HIAHControlEnvironmentSlot;
+
+struct HIAHControlEnvironmentStore {
+    pthread_mutex_t lock;
+    size_t capacity;
+    HIAHControlEnvironmentSlot *slots;
+    uint64_t nextHandle;
+    uint64_t clock;
+    HIAHControlEnvironmentStats stats;
+};
+
+static uint64_t HIAHControlEnvironmentHash(const char *const *entries, size_t count) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < count; i++) {
+        for (const uint8_t *p = (const uint8_t *)entries[i];; p++) {
+            hash = (hash ^ *p) * 0x100000001b3ull;
+            if (*p == 0) {
+                break;
+            }
+        }
+    }
+    return hash;
+}
+
+HIAHControlEnvironmentStore *HIAHControlEnvironmentStoreCreate(size_t capacity) {
+    HIAHControlEnvironmentStore *store = calloc(1, sizeof(HIAHControlEnvironmentStore));
+    if (!store) {
+        return NULL;
+    }
+    store->capacity = capacity ? capacity : HIAH_CONTROL_ENVIRONMENT_DEFAULT_CAPACITY;
+    store->slots = calloc(store->capacity, sizeof(HIAHControlEnvironmentSlot));
+    if (!store->slots) {
+        free(store);
+        return NULL;
+    }
+    pthread_mutex_init(&store->lock, NULL);
+    return store;
+}
+
+void HIAHControlEnvironmentStoreDestroy(HIAHControlEnvironmentStore *store) {
+    if (!store) {
+        return;
+    }
+    for (size_t i = 0; i < store->capacity; i++) {
+        free(store->slots[i].entries);
+    }
+    pthread_mutex_destroy(&store->lock);
+    free(store->slots);
+    free(store);
+}
+
+uint64_t HIAHControlEnvironmentStoreRegister(HIAHControlEnvironmentStore *store,
+                                             const char *const *entries, size_t count) {
+    // Sorted, so the same environment in any order is one base
+    const char **sorted = malloc((count + 1) * sizeof(char *));
+    if (!sorted) {
+        return 0;
+    }
+    if (count) {
+        memcpy(sorted, entries, count * sizeof(char *));
+    }
+    qsort(sorted, count, sizeof(char *), HIAHControlEnvironmentCompareEntries);
+    uint64_t hash = HIAHControlEnvironmentHash(sorted, count);
+
+    pthread_mutex_lock(&store->lock);
+    store->stats.registrations++;
+    HIAHControlEnvironmentSlot *victim = &store->slots[0];
+    for (size_t i = 0; i < store->capacity; i++) {
+        HIAHControlEnvironmentSlot *slot = &store->slots[i];
+        if (slot->handle && slot->hash == hash && slot->count == count) {
+            size_t same = 0;
+            while (same < count && strcmp(slot->entries[same], sorted[same]) == 0) {
+                same++;
+            }
+            if (same == count) {
+                slot->lastUse = ++store->clock;
+                store->stats.shared++;
+                uint64_t handle = slot->handle;
+                pthread_mutex_unlock(&store->lock);
+                free(sorted);
+                return handle;
+            }
+        }
+        if (victim->handle && (!slot->handle || slot->lastUse < victim->lastUse)) {
+            victim = slot;
+        }
+    }
+
+    char **packed = HIAHControlEnvironmentPack(sorted, count, NULL);
+    free(sorted);
+    if (!packed) {
+        pthread_mutex_unlock(&store->lock);
+        return 0;
+    }
+    if (victim->handle) {
+        free(victim->entries);
+        store->stats.evictions++;
+        store->stats.bases--;
+        store->stats.bytes -= victim->bytes;
+    }
+    victim->handle = ++store->nextHandle;
+    victim->hash = hash;
+    victim->lastUse = ++store->clock;
+    victim->count = count;
+    victim->entries = packed;
+    victim->bytes = (count + 1) * sizeof(char *);
+    for (size_t i = 0; i < count; i++) {
+        victim->bytes += strlen(packed[i]) + 1;
+    }
+    store->stats.bases++;
+    store->stats.bytes += victim->bytes;
+    uint64_t handle = victim->handle;
+    pthread_mutex_unlock(&store->lock);
+    return handle;
+}
+
+char **HIAHControlEnvironmentStoreBuild(HIAHControlEnvironmentStore *store, uint64_t handle,
+                                        const char *const *changes, size_t changeCount,
+                                        const char *const *removed, size_t removedCount,
+                                        bool *unknown) {
+    *unknown = false;
+
+    // Every key the delta sets or drops hides the base entry with that key
+    size_t overrideCount = changeCount + removedCount;
+    const char **overrides = malloc((overrideCount + 1) * sizeof(char *));
+    if (!overrides) {
+        return NULL;
+    }
+    if (changeCount) {
+        memcpy(overrides, changes, changeCount * sizeof(char *));
+    }
+    if (removedCount) {
+        memcpy(overrides + changeCount, removed, removedCount * sizeof(char *));
+    }
+    qsort(overrides, overrideCount, sizeof(char *), HIAHControlEnvironmentCompareKeys);
+
+    pthread_mutex_lock(&store->lock);
+    HIAHControlEnvironmentSlot *slot = NULL;
+    for (size_t i = 0; handle && i < store->capacity && !slot; i++) {
+        if (store->slots[i].handle == handle) {
+            slot = &store->slots[i];
+        }
+    }
+    store->stats.builds++;
+    if (!slot) {
+        store->stats.misses++;
+        pthread_mutex_unlock(&store->lock);
+        free(overrides);
+        *unknown = true;
+        return NULL;
+    }
+    slot->lastUse = ++store->clock;
+
+    // Keep the surviving base entries in a scratch list, then pack them with
+    // the changes in one allocation
+    const char **kept = malloc((slot->count + 1) * sizeof(char *));
+    char **envp = NULL;
+    if (kept) {
+        size_t keptCount = 0;
+        for (size_t i = 0; i < slot->count; i++) {
+            if (!overrideCount ||
+                !bsearch(&slot->entries[i], overrides, overrideCount, sizeof(char *),
+                         HIAHControlEnvironmentCompareKeys)) {
+                kept[keptCount++] = slot->entries[i];
+            }
+        }
+        const char **tail = malloc((changeCount + 1) * sizeof(char *));
+        if (tail) {
+            if (changeCount) {
+                memcpy(tail, changes, changeCount * sizeof(char *));
+            }
+            tail[changeCount] = NULL;
+            envp = HIAHControlEnvironmentPack(kept, keptCount, tail);
+            free(tail);
+        }
+        free(kept);
+    }
+    pthread_mutex_unlock(&store->lock);
+    free(overrides);
+    return envp;
+}
+
+void HIAHControlEnvironmentStoreGetStats(HIAHControlEnvironmentStore *store,
+                                         HIAHControlEnvironmentStats *stats) {
+    pthread_mutex_lock(&store->lock);
+    *stats = store->stats;
+    pthread_mutex_unlock(&store->lock);
+}
+
+// MARK: - Guest Side
+
+struct HIAHControlEnvironmentBase {
+    size_t count;
+    char **entries;   // Packed, sorted
+    char **keys;      // Packed, keys[i] is the key of entries[i]
+};
+
+HIAHControlEnvironmentBase *HIAHControlEnvironmentBaseCreate(const char *const *envp) {
+    size_t count = HIAHControlEnvironmentCount(envp);
+    const char **sorted = malloc((count + 1) * sizeof(char *));
+    HIAHControlEnvironmentBase *base = calloc(1, sizeof(HIAHControlEnvironmentBase));
+    if (!sorted || !base) {
+        free(sorted);
+        free(base);
+        return NULL;
+    }
+    if (count) {
+        memcpy(sorted, envp, count * sizeof(char *));
+    }
+    qsort(sorted, count, sizeof(char *), HIAHControlEnvironmentCompareEntries);
+    base->count = count;
+    base->entries = HIAHControlEnvironmentPack(sorted, count, NULL);
+    free(sorted);
+
+    size_t keyBytes = 0;
+    for (size_t i = 0; base->entries && i < count; i++) {
+        keyBytes += HIAHControlEnvironmentKeyLength(base->entries[i]) + 1;
+    }
+    base->keys = base->entries ? malloc((count + 1) * sizeof(char *) + keyBytes) : NULL;
+    if (!base->keys) {
+        HIAHControlEnvironmentBaseFree(base);
+        return NULL;
+    }
+    char *cursor = (char *)(base->keys + count + 1);
+    for (size_t i = 0; i < count; i++) {
+        size_t length = HIAHControlEnvironmentKeyLength(base->entries[i]);
+        memcpy(cursor, base->entries[i], length);
+        cursor[length] = '\0';
+        base->keys[i] = cursor;
+        cursor += length + 1;
+    }
+    base->keys[count] = NULL;
+    return base;
+}
+
+void HIAHControlEnvironmentBaseFree(HIAHControlEnvironmentBase *base) {
+    if (!base) {
+        return;
+    }
+    free(base->entries);
+    free(base->keys);
+    free(base);
+}
+
+const char *const *HIAHControlEnvironmentBaseEntries(const HIAHControlEnvironmentBase *base,
+                                                     size_t *count) {
+    *count = base->count;
+    return (const char *const *)base->entries;
+}
+
+bool HIAHControlEnvironmentDiff(const HIAHControlEnvironmentBase *base, const char *const *envp,
+                                HIAHControlEnvironmentDelta *delta) {
+    memset(delta, 0, sizeof(*delta));
+    size_t count = HIAHControlEnvironmentCount(envp);
+    delta->changes = malloc((count + 1) * sizeof(char *));
+    delta->removed = malloc((base->count + 1) * sizeof(char *));
+    bool *present = calloc(base->count + 1, sizeof(bool));
+    if (!delta->changes || !delta->removed || !present) {
+        free(present);
+        HIAHControlEnvironmentDeltaFree(delta);
+        return false;
+    }
+
+    size_t fullBytes = 0, deltaBytes = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t length = strlen(envp[i]) + HIAH_CONTROL_ENVIRONMENT_STRING_OVERHEAD;
+        fullBytes += length;
+        char **match = bsearch(&envp[i], base->entries, base->count, sizeof(char *),
+                               HIAHControlEnvironmentCompareEntries);
+        if (match) {
+            present[match - base->entries] = true;
+        } else {
+            delta->changes[delta->changeCount++] = envp[i];
+            deltaBytes += length;
+        }
+    }
+
+    // A changed value needs no removal: the change hides the base entry
+    qsort(delta->changes, delta->changeCount, sizeof(char *), HIAHControlEnvironmentCompareKeys);
+    for (size_t i = 0; i < base->count; i++) {
+        if (present[i] ||
+            (delta->changeCount &&
+             bsearch(&base->keys[i], delta->changes, delta->changeCount, sizeof(char *),
+                     HIAHControlEnvironmentCompareKeys))) {
+            continue;
+        }
+        delta->removed[delta->removedCount++] = base->keys[i];
+        deltaBytes += strlen(base->keys[i]) + HIAH_CONTROL_ENVIRONMENT_STRING_OVERHEAD;
+    }
+    free(present);
+
+    // The handle field and the removal array header
+    deltaBytes += 16 + 12;
+    if (deltaBytes >= fullBytes) {
+        HIAHControlEnvironmentDeltaFree(delta);
+        return false;
+    }
+    return true;
+}
+
+void HIAHControlEnvironmentDeltaFree(HIAHControlEnvironmentDelta *delta) {
+    free(delta->changes);
+    free(delta->removed);
+    memset(delta, 0, sizeof(*delta));
+}
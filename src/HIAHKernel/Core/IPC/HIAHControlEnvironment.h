@@ -0,0 +1,139 @@
+/**
+ * HIAHControlEnvironment.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Delta-encoded environments for forwarded spawns.
+ *
+ * A child's environment is nearly always its parent's plus a few changes.
+ * A guest therefore registers its base environment with the kernel once and
+ * receives a handle. After that, each spawn sends only the entries it adds
+ * or changes, plus the keys it drops. The kernel interns bases by content,
+ * so guests that start from the same environment share one copy, and keeps
+ * a bounded number of them. Handles are never reused: a spawn naming an
+ * evicted base is answered with HIAHControlStatusUnknownEnvironment, and the
+ * guest registers again and resends.
+ *
+ * Every envp built here is a single allocation: the pointer array followed
+ * by the strings. Release it with free().
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_CONTROL_ENVIRONMENT_H
+#define HIAH_CONTROL_ENVIRONMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Copies `count` entries (SIZE_MAX for a NULL-terminated array) into one
+ * NULL-terminated allocation.
+ *
+ * @param extra Further entries appended after them (NULL-terminated, may be NULL)
+ * @return The envp, or NULL if memory runs out
+ */
+char **HIAHControlEnvironmentPack(const char *const *entries, size_t count,
+                                  const char *const *extra);
+
+/**
+ * Like HIAHControlEnvironmentPack(), but leaves out the entries whose key
+ * one of `extra` sets, so `extra` replaces them rather than following a
+ * stale copy that getenv() would find first. Meant for a few extras.
+ */
+char **HIAHControlEnvironmentPackReplacing(const char *const *entries, size_t count,
+                                           const char *const *extra);
+
+// MARK: - Kernel Side
+
+typedef struct HIAHControlEnvironmentStore HIAHControlEnvironmentStore;
+
+typedef struct {
+    uint64_t registrations;
+    uint64_t shared;      // Registrations answered with an existing base
+    uint64_t evictions;
+    uint64_t builds;
+    uint64_t misses;      // Builds naming an unknown handle
+    uint64_t bases;       // Held now
+    uint64_t bytes;       // Held now
+} HIAHControlEnvironmentStats;
+
+/**
+ * @param capacity Bases held at once; the least recently used is evicted
+ *                 beyond it (0 = 64)
+ */
+HIAHControlEnvironmentStore *HIAHControlEnvironmentStoreCreate(size_t capacity);
+void HIAHControlEnvironmentStoreDestroy(HIAHControlEnvironmentStore *store);
+
+/**
+ * Registers a base environment. Thread-safe.
+ *
+ * @return Its handle (never 0), or 0 if memory runs out
+ */
+uint64_t HIAHControlEnvironmentStoreRegister(HIAHControlEnvironmentStore *store,
+                                             const char *const *entries, size_t count);
+
+/**
+ * Builds a spawn's environment: the base entries whose keys are neither
+ * removed nor set again by `changes`, then `changes`. Thread-safe.
+ *
+ * @param unknown Set when `handle` names no base (evicted, or never issued)
+ * @return The envp, or NULL if `unknown` or memory runs out
+ */
+char **HIAHControlEnvironmentStoreBuild(HIAHControlEnvironmentStore *store, uint64_t handle,
+                                        const char *const *changes, size_t changeCount,
+                                        const char *const *removed, size_t removedCount,
+                                        bool *unknown);
+
+void HIAHControlEnvironmentStoreGetStats(HIAHControlEnvironmentStore *store,
+                                         HIAHControlEnvironmentStats *stats);
+
+// MARK: - Guest Side
+
+/**
+ * A guest's snapshot of the base it registered.
+ */
+typedef struct HIAHControlEnvironmentBase HIAHControlEnvironmentBase;
+
+/**
+ * Snapshots `envp`, e.g. `environ` at the first forwarded spawn.
+ */
+HIAHControlEnvironmentBase *HIAHControlEnvironmentBaseCreate(const char *const *envp);
+void HIAHControlEnvironmentBaseFree(HIAHControlEnvironmentBase *base);
+
+/**
+ * The snapshot's entries, to register with the kernel.
+ */
+const char *const *HIAHControlEnvironmentBaseEntries(const HIAHControlEnvironmentBase *base,
+                                                     size_t *count);
+
+typedef struct {
+    const char **changes;    // Entries of `envp` not in the base
+    size_t changeCount;
+    const char **removed;    // Keys of base entries that `envp` drops
+    size_t removedCount;
+} HIAHControlEnvironmentDelta;
+
+/**
+ * Computes `envp` relative to `base`. The arrays point into `envp` and the
+ * base, which must outlive the delta.
+ *
+ * @return false if memory runs out or the delta would not be smaller than
+ *         `envp` itself; send the environment in full then
+ */
+bool HIAHControlEnvironmentDiff(const HIAHControlEnvironmentBase *base, const char *const *envp,
+                                HIAHControlEnvironmentDelta *delta);
+void HIAHControlEnvironmentDeltaFree(HIAHControlEnvironmentDelta *delta);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_CONTROL_ENVIRONMENT_H */
@@ -0,0 +1,505 @@
+/**
+ * HIAHControlProtocol.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Binary control protocol encoder, zero-copy decoder and blocking client
+ * helpers.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHControlProtocol.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef MSG_NOSIGNAL
+#define HIAH_CONTROL_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define HIAH_CONTROL_SEND_FLAGS 0
+#endif
+
+// How long an old, JSON-only kernel gets to (not) answer the hello
+#define HIAH_CONTROL_HELLO_TIMEOUT_MS 500
+
+#define HIAH_CONTROL_MAX_FRAME (64u << 20)
+
+// MARK: - Little Endian
+
+static inline void HIAHControlStore16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void HIAHControlStore32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint16_t HIAHControlLoad16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t HIAHControlLoad32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// MARK: - Encoding
+
+static uint8_t *HIAHControlWriterGrow(HIAHControlWriter *writer, size_t extra) {
+    if (writer->failed) {
+        return NULL;
+    }
+    if (writer->capacity - writer->length < extra) {
+        size_t capacity = writer->capacity ? writer->capacity : 256;
+        while (capacity - writer->length < extra) {
+            capacity *= 2;
+        }
+        uint8_t *data = realloc(writer->data, capacity);
+        if (!data) {
+            writer->failed = true;
+            return NULL;
+        }
+        writer->data = data;
+        writer->capacity = capacity;
+    }
+    uint8_t *p = writer->data + writer->length;
+    writer->length += extra;
+    return p;
+}
+
+static uint8_t *HIAHControlWriterAddField(HIAHControlWriter *writer, uint16_t tag, uint8_t kind,
+                                          size_t length) {
+    if (length > UINT32_MAX) {
+        writer->failed = true;
+        return NULL;
+    }
+    uint8_t *p = HIAHControlWriterGrow(writer, HIAH_CONTROL_FIELD_HEADER + length);
+    if (!p) {
+        return NULL;
+    }
+    HIAHControlStore16(p, tag);
+    p[2] = kind;
+    p[3] = 0;
+    HIAHControlStore32(p + 4, (uint32_t)length);
+    return p + HIAH_CONTROL_FIELD_HEADER;
+}
+
+void HIAHControlWriterInit(HIAHControlWriter *writer, HIAHControlMessageType type) {
+    memset(writer, 0, sizeof(*writer));
+    uint8_t *p = HIAHControlWriterGrow(writer, HIAH_CONTROL_PAYLOAD_HEADER);
+    if (p) {
+        p[0] = HIAH_CONTROL_PAYLOAD_VERSION;
+        p[1] = (uint8_t)type;
+        p[2] = p[3] = 0;
+    }
+}
+
+void HIAHControlWriterFree(HIAHControlWriter *writer) {
+    free(writer->data);
+    memset(writer, 0, sizeof(*writer));
+}
+
+void HIAHControlWriterAddInt(HIAHControlWriter *writer, uint16_t tag, int64_t value) {
+    uint8_t *p = HIAHControlWriterAddField(writer, tag, HIAHControlKindInt, 8);
+    if (p) {
+        HIAHControlStore32(p, (uint32_t)(uint64_t)value);
+        HIAHControlStore32(p + 4, (uint32_t)((uint64_t)value >> 32));
+    }
+}
+
+void HIAHControlWriterAddString(HIAHControlWriter *writer, uint16_t tag, const char *string) {
+    if (!string) {
+        return;
+    }
+    size_t length = strlen(string) + 1;
+    uint8_t *p = HIAHControlWriterAddField(writer, tag, HIAHControlKindString, length);
+    if (p) {
+        memcpy(p, string, length);
+    }
+}
+
+void HIAHControlWriterAddStringArray(HIAHControlWriter *writer, uint16_t tag,
+                                     const char *const *strings, size_t count) {
+    if (!strings) {
+        count = 0;
+    } else if (count == SIZE_MAX) {
+        count = 0;
+        while (strings[count]) {
+            count++;
+        }
+    }
+
+    // Size first so the field is written in one pass
+    size_t length = 4;
+    for (size_t i = 0; i < count; i++) {
+        length += 4 + strlen(strings[i]) + 1;
+    }
+    if (count > UINT32_MAX) {
+        writer->failed = true;
+        return;
+    }
+
+    uint8_t *p = HIAHControlWriterAddField(writer, tag, HIAHControlKindStringArray, length);
+    if (!p) {
+        return;
+    }
+    HIAHControlStore32(p, (uint32_t)count);
+    p += 4;
+    for (size_t i = 0; i < count; i++) {
+        size_t stringLength = strlen(strings[i]);
+        HIAHControlStore32(p, (uint32_t)stringLength);
+        memcpy(p + 4, strings[i], stringLength + 1);
+        p += 4 + stringLength + 1;
+    }
+}
+
+size_t HIAHControlWriterBeginMessage(HIAHControlWriter *writer, uint16_t tag) {
+    size_t mark = writer->length;
+    HIAHControlWriterAddField(writer, tag, HIAHControlKindMessage, 0);
+    return mark;
+}
+
+void HIAHControlWriterEndMessage(HIAHControlWriter *writer, size_t mark) {
+    if (writer->failed) {
+        return;
+    }
+    size_t length = writer->length - mark - HIAH_CONTROL_FIELD_HEADER;
+    if (length > UINT32_MAX) {
+        writer->failed = true;
+        return;
+    }
+    HIAHControlStore32(writer->data + mark + 4, (uint32_t)length);
+}
+
+// MARK: - Decoding
+
+bool HIAHControlReaderInit(HIAHControlReader *reader, const void *payload, size_t length,
+                           HIAHControlMessageType *type) {
+    const uint8_t *bytes = payload;
+    if (!bytes || length < HIAH_CONTROL_PAYLOAD_HEADER ||
+        bytes[0] == 0 || bytes[0] > HIAH_CONTROL_PAYLOAD_VERSION) {
+        return false;
+    }
+    if (type) {
+        *type = (HIAHControlMessageType)bytes[1];
+    }
+    reader->cursor = bytes + HIAH_CONTROL_PAYLOAD_HEADER;
+    reader->end = bytes + length;
+    return true;
+}
+
+void HIAHControlReaderInitMessage(HIAHControlReader *reader, const HIAHControlField *field) {
+    reader->cursor = field->value;
+    reader->end = field->value + field->length;
+}
+
+static bool HIAHControlValidateStringArray(const uint8_t *value, uint32_t length) {
+    if (length < 4) {
+        return false;
+    }
+    uint32_t count = HIAHControlLoad32(value);
+    const uint8_t *p = value + 4;
+    const uint8_t *end = value + length;
+    for (uint32_t i = 0; i < count; i++) {
+        if ((size_t)(end - p) < 4) {
+            return false;
+        }
+        uint32_t stringLength = HIAHControlLoad32(p);
+        p += 4;
+        if ((size_t)(end - p) <= stringLength || p[stringLength] != '\0') {
+            return false;
+        }
+        p += stringLength + 1;
+    }
+    return p == end;
+}
+
+int HIAHControlReaderNext(HIAHControlReader *reader, HIAHControlField *field) {
+    size_t available = (size_t)(reader->end - reader->cursor);
+    if (available == 0) {
+        return 0;
+    }
+    if (available < HIAH_CONTROL_FIELD_HEADER) {
+        return -1;
+    }
+
+    const uint8_t *p = reader->cursor;
+    field->tag = HIAHControlLoad16(p);
+    field->kind = p[2];
+    field->length = HIAHControlLoad32(p + 4);
+    field->value = p + HIAH_CONTROL_FIELD_HEADER;
+    if (available - HIAH_CONTROL_FIELD_HEADER < field->length) {
+        return -1;
+    }
+
+    switch (field->kind) {
+        case HIAHControlKindInt:
+            if (field->length != 8) return -1;
+            break;
+        case HIAHControlKindString:
+            if (field->length == 0 || field->value[field->length - 1] != '\0') return -1;
+            break;
+        case HIAHControlKindStringArray:
+            if (!HIAHControlValidateStringArray(field->value, field->length)) return -1;
+            break;
+        case HIAHControlKindMessage:
+            break;   // Validated when it is read
+        default:
+            break;   // Unknown kinds are skipped by tag-based readers
+    }
+
+    reader->cursor = field->value + field->length;
+    return 1;
+}
+
+int64_t HIAHControlFieldInt(const HIAHControlField *field) {
+    if (field->kind != HIAHControlKindInt) {
+        return 0;
+    }
+    uint64_t low = HIAHControlLoad32(field->value);
+    uint64_t high = HIAHControlLoad32(field->value + 4);
+    return (int64_t)(low | (high << 32));
+}
+
+const char *HIAHControlFieldString(const HIAHControlField *field, size_t *length) {
+    if (field->kind != HIAHControlKindString) {
+        return NULL;
+    }
+    if (length) {
+        *length = field->length - 1;
+    }
+    return (const char *)field->value;
+}
+
+uint32_t HIAHControlFieldStringCount(const HIAHControlField *field) {
+    return field->kind == HIAHControlKindStringArray ? HIAHControlLoad32(field->value) : 0;
+}
+
+void HIAHControlFieldStrings(const HIAHControlField *field, HIAHControlStringIterator *iterator) {
+    iterator->remaining = HIAHControlFieldStringCount(field);
+    iterator->cursor = iterator->remaining ? field->value + 4 : NULL;
+}
+
+const char *HIAHControlStringIteratorNext(HIAHControlStringIterator *iterator, size_t *length) {
+    if (iterator->remaining == 0) {
+        return NULL;
+    }
+    uint32_t stringLength = HIAHControlLoad32(iterator->cursor);
+    const char *string = (const char *)iterator->cursor + 4;
+    iterator->cursor += 4 + stringLength + 1;
+    iterator->remaining--;
+    if (length) {
+        *length = stringLength;
+    }
+    return string;
+}
+
+const char **HIAHControlFieldCopyStrings(const HIAHControlField *field, size_t *count) {
+    uint32_t total = HIAHControlFieldStringCount(field);
+    const char **strings = malloc(((size_t)total + 1) * sizeof(char *));
+    if (!strings) {
+        return NULL;
+    }
+    HIAHControlStringIterator it;
+    HIAHControlFieldStrings(field, &it);
+    for (uint32_t i = 0; i < total; i++) {
+        strings[i] = HIAHControlStringIteratorNext(&it, NULL);
+    }
+    strings[total] = NULL;
+    if (count) {
+        *count = total;
+    }
+    return strings;
+}
+
+// MARK: - Blocking Client
+
+static bool HIAHControlWriteAll(int fd, const uint8_t *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = send(fd, data, length, HIAH_CONTROL_SEND_FLAGS);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool HIAHControlReadAll(int fd, uint8_t *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = recv(fd, data, length, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool HIAHControlReserve(uint8_t **buffer, size_t *capacity, size_t needed) {
+    if (*capacity >= needed) {
+        return true;
+    }
+    size_t grown = *capacity ? *capacity : 1024;
+    while (grown < needed) {
+        grown *= 2;
+    }
+    uint8_t *data = realloc(*buffer, grown);
+    if (!data) {
+        return false;
+    }
+    *buffer = data;
+    *capacity = grown;
+    return true;
+}
+
+static int HIAHControlOpen(const char *socketPath) {
+    struct sockaddr_un addr;
+    if (!socketPath || strlen(socketPath) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+#ifdef SO_NOSIGPIPE
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int HIAHControlConnect(const char *socketPath, uint8_t *version) {
+    int fd = HIAHControlOpen(socketPath);
+    if (fd < 0) {
+        return -1;
+    }
+
+    uint8_t hello[HIAH_CONTROL_HELLO_LENGTH];
+    memcpy(hello, HIAH_CONTROL_MAGIC, HIAH_CONTROL_MAGIC_LENGTH);
+    hello[HIAH_CONTROL_MAGIC_LENGTH] = HIAH_CONTROL_PROTOCOL_VERSION;
+
+    struct timeval timeout = {0, HIAH_CONTROL_HELLO_TIMEOUT_MS * 1000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    uint8_t answer[HIAH_CONTROL_HELLO_LENGTH];
+    if (HIAHControlWriteAll(fd, hello, sizeof(hello)) &&
+        HIAHControlReadAll(fd, answer, sizeof(answer)) &&
+        memcmp(answer, HIAH_CONTROL_MAGIC, HIAH_CONTROL_MAGIC_LENGTH) == 0 &&
+        answer[HIAH_CONTROL_MAGIC_LENGTH] != 0) {
+        struct timeval none = {0, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &none, sizeof(none));
+        if (version) {
+            *version = answer[HIAH_CONTROL_MAGIC_LENGTH];
+        }
+        return fd;
+    }
+
+    // The hello is now stuck in an older kernel's line buffer; start over
+    close(fd);
+    fd = HIAHControlOpen(socketPath);
+    if (fd >= 0 && version) {
+        *version = 0;
+    }
+    return fd;
+}
+
+bool HIAHControlSendFrame(int fd, const void *payload, size_t length) {
+    if (length > UINT32_MAX) {
+        return false;
+    }
+    uint8_t header[HIAH_CONTROL_FRAME_HEADER];
+    HIAHControlStore32(header, (uint32_t)length);
+
+    struct iovec iov[2] = {{header, sizeof(header)}, {(void *)payload, length}};
+    size_t total = sizeof(header) + length;
+    ssize_t n;
+    do {
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = iov;
+        message.msg_iovlen = 2;
+        n = sendmsg(fd, &message, HIAH_CONTROL_SEND_FLAGS);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        return false;
+    }
+    if ((size_t)n == total) {
+        return true;
+    }
+
+    // Short write: finish byte-wise
+    size_t sent = (size_t)n;
+    if (sent < sizeof(header)) {
+        if (!HIAHControlWriteAll(fd, header + sent, sizeof(header) - sent)) {
+            return false;
+        }
+        sent = sizeof(header);
+    }
+    return HIAHControlWriteAll(fd, (const uint8_t *)payload + (sent - sizeof(header)),
+                               total - sent);
+}
+
+bool HIAHControlReceiveFrame(int fd, uint8_t **buffer, size_t *capacity, size_t *length) {
+    uint8_t header[HIAH_CONTROL_FRAME_HEADER];
+    if (!HIAHControlReadAll(fd, header, sizeof(header))) {
+        return false;
+    }
+    uint32_t frameLength = HIAHControlLoad32(header);
+    if (frameLength > HIAH_CONTROL_MAX_FRAME ||
+        !HIAHControlReserve(buffer, capacity, frameLength ? frameLength : 1) ||
+        !HIAHControlReadAll(fd, *buffer, frameLength)) {
+        return false;
+    }
+    *length = frameLength;
+    return true;
+}
+
+bool HIAHControlReceiveLine(int fd, uint8_t **buffer, size_t *capacity, size_t *length) {
+    size_t used = 0;
+    for (;;) {
+        if (!HIAHControlReserve(buffer, capacity, used + 4096)) {
+            return false;
+        }
+        ssize_t n = recv(fd, *buffer + used, *capacity - used, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        uint8_t *newline = memchr(*buffer + used, '\n', (size_t)n);
+        if (newline) {
+            *length = (size_t)(newline - *buffer);
+            return true;
+        }
+        used += (size_t)n;
+        if (used > HIAH_CONTROL_MAX_FRAME) {
+            return false;
+        }
+    }
+}
@@ -0,0 +1,252 @@
+/**
+ * HIAHControlProtocol.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Binary framing for the kernel control socket.
+ *
+ * A client opts in by sending a 5 byte hello as the very first bytes of a
+ * connection: the magic "HIAH" followed by the highest protocol version it
+ * speaks. The kernel answers with the magic and the version it picked
+ * (0 = refused, the connection is then closed). Connections that start with
+ * anything else, e.g. '{', keep using newline-delimited JSON.
+ *
+ * After the handshake every message is a frame:
+ *
+ *     u32 payloadLength (little endian) | payload
+ *
+ * and every payload starts with a 4 byte header (version, message type,
+ * two reserved bytes) followed by fields:
+ *
+ *     u16 tag | u8 kind | u8 reserved | u32 length | value
+ *
+ * Integers are little endian. Strings carry their NUL terminator and string
+ * arrays keep one per element, so the decoder hands out `const char *`
+ * pointers straight into the received frame instead of copying.
+ *
+ * On a version 1 connection replies come back in request order. Version 2
+ * makes a connection multiplexed: the kernel writes each reply as soon as it
+ * is ready, and echoes the request's RequestID field in it so the client
+ * can match them up (see HIAHControlChannel.h). The payload format itself is
+ * the same in both.
+ *
+ * A spawn's environment is sent either in full, or as a delta against a base
+ * the guest registered once with an Environment message. In a delta, the
+ * Environment field carries only new and changed entries, and EnvRemoved the
+ * keys of base entries to drop (see HIAHControlEnvironment.h).
+ *
+ * A spawn that carries a Parent field makes the child a forwarded child of
+ * that process. A wait with Pid -1 and the same Parent is answered with the
+ * next of them to exit, or NoChild once none are left.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_CONTROL_PROTOCOL_H
+#define HIAH_CONTROL_PROTOCOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HIAH_CONTROL_MAGIC            "HIAH"
+#define HIAH_CONTROL_MAGIC_LENGTH     4
+#define HIAH_CONTROL_HELLO_LENGTH     (HIAH_CONTROL_MAGIC_LENGTH + 1)
+#define HIAH_CONTROL_PROTOCOL_VERSION 2   // Highest connection version
+#define HIAH_CONTROL_MULTIPLEXED      2   // First version with out-of-order replies
+#define HIAH_CONTROL_PAYLOAD_VERSION  1
+#define HIAH_CONTROL_FRAME_HEADER     4
+#define HIAH_CONTROL_PAYLOAD_HEADER   4
+#define HIAH_CONTROL_FIELD_HEADER     8
+
+typedef enum {
+    HIAHControlMessageSpawn       = 1,
+    HIAHControlMessageList        = 2,
+    HIAHControlMessageHookMetrics = 3,
+    HIAHControlMessageWait        = 4,
+    HIAHControlMessageSignal      = 5,
+    HIAHControlMessageEnvironment = 6,
+    HIAHControlMessageReply       = 0x80,
+} HIAHControlMessageType;
+
+typedef enum {
+    HIAHControlKindInt         = 1,   // 8 byte signed integer
+    HIAHControlKindString      = 2,   // Bytes plus NUL (length includes it)
+    HIAHControlKindStringArray = 3,   // u32 count, then per string: u32 length, bytes, NUL
+    HIAHControlKindMessage     = 4,   // Nested fields, no payload header
+} HIAHControlFieldKind;
+
+typedef enum {
+    HIAHControlFieldStatus      = 1,   // Int, 0 = ok
+    HIAHControlFieldError       = 2,   // String
+    HIAHControlFieldPid         = 3,   // Int
+    HIAHControlFieldPath        = 4,   // String
+    HIAHControlFieldArguments   = 5,   // StringArray, argv[1...]
+    HIAHControlFieldEnvironment = 6,   // StringArray of "KEY=VALUE"
+    HIAHControlFieldProcess     = 7,   // Message, repeated in list replies
+    HIAHControlFieldExited      = 8,   // Int
+    HIAHControlFieldExitCode    = 9,   // Int
+    HIAHControlFieldHookMetric  = 10,  // Message, repeated in hook metrics
+    HIAHControlFieldName        = 11,  // String
+    HIAHControlFieldCalls       = 12,  // Int
+    HIAHControlFieldNanoseconds = 13,  // Int
+    HIAHControlFieldBucket      = 14,  // Int, repeated in bucket order
+    HIAHControlFieldRequestID   = 15,  // Int, chosen by the client, echoed in the reply
+    HIAHControlFieldSignal      = 16,  // Int
+    HIAHControlFieldOptions     = 17,  // Int, waitpid() options
+    HIAHControlFieldEnvHandle   = 18,  // Int, a registered base environment
+    HIAHControlFieldEnvRemoved  = 19,  // StringArray of keys dropped from the base
+    HIAHControlFieldParent      = 20,  // Int, physical PID of the process asking
+} HIAHControlFieldTag;
+
+// Values of HIAHControlFieldStatus
+typedef enum {
+    HIAHControlStatusOK                 = 0,
+    HIAHControlStatusError              = 1,
+    HIAHControlStatusUnknownEnvironment = 2,   // Register the base environment again
+    HIAHControlStatusNoChild            = 3,   // A wait for any child, and there are none
+} HIAHControlStatus;
+
+// MARK: - Encoding
+
+/**
+ * Growable payload builder. Allocation failures are sticky: check `failed`
+ * once after the last field instead of after every call.
+ */
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} HIAHControlWriter;
+
+void HIAHControlWriterInit(HIAHControlWriter *writer, HIAHControlMessageType type);
+void HIAHControlWriterFree(HIAHControlWriter *writer);
+
+void HIAHControlWriterAddInt(HIAHControlWriter *writer, uint16_t tag, int64_t value);
+void HIAHControlWriterAddString(HIAHControlWriter *writer, uint16_t tag, const char *string);
+
+/**
+ * Adds a string array. Pass `count` = SIZE_MAX for a NULL-terminated array
+ * such as argv or envp. A NULL `strings` adds an empty array.
+ */
+void HIAHControlWriterAddStringArray(HIAHControlWriter *writer, uint16_t tag,
+                                     const char *const *strings, size_t count);
+
+/**
+ * Opens a nested message; fields added until the matching
+ * HIAHControlWriterEndMessage() belong to it.
+ *
+ * @return A mark to pass to HIAHControlWriterEndMessage()
+ */
+size_t HIAHControlWriterBeginMessage(HIAHControlWriter *writer, uint16_t tag);
+void HIAHControlWriterEndMessage(HIAHControlWriter *writer, size_t mark);
+
+// MARK: - Decoding
+
+typedef struct {
+    const uint8_t *cursor;
+    const uint8_t *end;
+} HIAHControlReader;
+
+/**
+ * A decoded field. `value` points into the caller's buffer, which must
+ * outlive the field.
+ */
+typedef struct {
+    uint16_t tag;
+    uint8_t kind;
+    uint32_t length;
+    const uint8_t *value;
+} HIAHControlField;
+
+typedef struct {
+    const uint8_t *cursor;
+    uint32_t remaining;
+} HIAHControlStringIterator;
+
+/**
+ * Validates the payload header.
+ *
+ * @param type Receives the message type (may be NULL)
+ * @return false if the payload is truncated or of an unknown version
+ */
+bool HIAHControlReaderInit(HIAHControlReader *reader, const void *payload, size_t length,
+                           HIAHControlMessageType *type);
+
+/**
+ * Reads the fields of a nested message.
+ */
+void HIAHControlReaderInitMessage(HIAHControlReader *reader, const HIAHControlField *field);
+
+/**
+ * Advances to the next field. Strings and string arrays are fully validated
+ * here, so the accessors below cannot fail on a field returned by it.
+ *
+ * @return 1 for a field, 0 at the end, -1 if the payload is malformed
+ */
+int HIAHControlReaderNext(HIAHControlReader *reader, HIAHControlField *field);
+
+int64_t HIAHControlFieldInt(const HIAHControlField *field);
+
+/**
+ * @return The NUL-terminated string inside the payload
+ */
+const char *HIAHControlFieldString(const HIAHControlField *field, size_t *length);
+
+uint32_t HIAHControlFieldStringCount(const HIAHControlField *field);
+void HIAHControlFieldStrings(const HIAHControlField *field, HIAHControlStringIterator *iterator);
+
+/**
+ * @return The next NUL-terminated string inside the payload, or NULL
+ */
+const char *HIAHControlStringIteratorNext(HIAHControlStringIterator *iterator, size_t *length);
+
+/**
+ * Collects the strings of a string array field.
+ *
+ * @return A malloc'd, NULL-terminated array of pointers into the payload
+ *         (free the array only), or NULL if memory runs out
+ */
+const char **HIAHControlFieldCopyStrings(const HIAHControlField *field, size_t *count);
+
+// MARK: - Blocking Client
+
+/**
+ * Connects to the control socket and offers the binary protocol. Kernels
+ * that do not answer the hello in time are reconnected in JSON mode.
+ *
+ * @param version Receives the negotiated version, 0 for newline JSON
+ * @return A connected socket, or -1
+ */
+int HIAHControlConnect(const char *socketPath, uint8_t *version);
+
+/**
+ * Sends one length-prefixed frame.
+ */
+bool HIAHControlSendFrame(int fd, const void *payload, size_t length);
+
+/**
+ * Receives one length-prefixed frame into `*buffer` (grown with realloc as
+ * needed; free it when done).
+ */
+bool HIAHControlReceiveFrame(int fd, uint8_t **buffer, size_t *capacity, size_t *length);
+
+/**
+ * Receives one newline-terminated JSON reply of any size, without the
+ * newline. Intended for one request per connection: bytes after the newline
+ * are discarded.
+ */
+bool HIAHControlReceiveLine(int fd, uint8_t **buffer, size_t *capacity, size_t *length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_CONTROL_PROTOCOL_H */
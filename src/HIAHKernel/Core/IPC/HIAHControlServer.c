@@ -0,0 +1,840 @@
+/**
+ * HIAHControlServer.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Readiness-based control socket server implementation.
+ *
+ * The reactor thread owns every connection. Other threads only touch the
+ * reply queue, which they hand over by writing one byte to a wake pipe.
+ * All descriptors are level-triggered, so partially drained input or output
+ * is simply picked up again on the next wait.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHControlServer.h"
+#include "HIAHControlProtocol.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#if defined(__APPLE__) || defined(__FreeBSD__)
+#define HIAH_CONTROL_USE_KQUEUE 1
+#include <sys/event.h>
+#else
+#include <sys/epoll.h>
+#endif
+
+#ifndef SOMAXCONN
+#define SOMAXCONN 128
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define HIAH_CONTROL_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define HIAH_CONTROL_SEND_FLAGS 0
+#endif
+
+#define HIAH_CONTROL_DEFAULT_MAX_MESSAGE  (1u << 20)
+#define HIAH_CONTROL_DEFAULT_HIGH_WATER   (4u << 20)
+#define HIAH_CONTROL_READ_CHUNK           16384
+#define HIAH_CONTROL_READ_BUDGET          (256u * 1024)   // Per connection per wakeup
+#define HIAH_CONTROL_MAX_EVENTS           128
+
+typedef struct {
+    uint8_t *data;
+    size_t offset;     // First unconsumed byte
+    size_t length;     // End of valid data
+    size_t capacity;
+} HIAHControlBuffer;
+
+typedef struct HIAHControlQueuedReply {
+    struct HIAHControlQueuedReply *next;
+    HIAHControlRequest request;
+    size_t length;
+    uint8_t data[];
+} HIAHControlQueuedReply;
+
+typedef struct {
+    int fd;
+    HIAHControlConnectionID identifier;
+    HIAHControlBuffer input;
+    HIAHControlBuffer output;
+    size_t scanned;          // Input bytes already searched for a frame boundary
+    uint32_t pending;        // Requests delivered but not yet answered
+    uint32_t nextSequence;   // Sequence of the next delivered request
+    uint32_t nextReply;      // Sequence whose reply goes out next
+    HIAHControlQueuedReply *parked;   // Early replies, sorted by sequence
+    uint8_t protocolVersion; // 0 = newline JSON
+    bool negotiated;         // Framing chosen from the first bytes
+    bool readClosed;
+    bool readPaused;
+    bool wantsWrite;
+    bool polled;             // Registered with the poller
+    bool dead;
+} HIAHControlConnection;
+
+struct HIAHControlServer {
+    char *socketPath;
+    HIAHControlServerConfig config;
+    HIAHControlMessageHandler handler;
+    void *context;
+
+    int listenFd;
+    int pollFd;
+    int wakeFds[2];
+
+    pthread_t thread;
+    bool running;
+    _Atomic bool stopping;
+
+    // Reactor-owned connection table, indexed by file descriptor
+    HIAHControlConnection **connections;
+    size_t connectionCapacity;
+    uint32_t nextGeneration;
+
+    pthread_mutex_t queueLock;
+    HIAHControlQueuedReply *queueHead;
+    HIAHControlQueuedReply *queueTail;
+
+    _Atomic uint64_t accepted;
+    _Atomic uint64_t active;
+    _Atomic uint64_t peakActive;
+    _Atomic uint64_t messages;
+    _Atomic uint64_t replies;
+    _Atomic uint64_t protocolErrors;
+    _Atomic uint64_t bytesIn;
+    _Atomic uint64_t bytesOut;
+};
+
+// MARK: - Buffers
+
+static bool HIAHControlBufferReserve(HIAHControlBuffer *buffer, size_t extra) {
+    if (buffer->offset > 0 && buffer->offset == buffer->length) {
+        buffer->offset = buffer->length = 0;
+    }
+    if (buffer->capacity - buffer->length >= extra) {
+        return true;
+    }
+    // Reclaim consumed space before growing
+    if (buffer->offset > 0) {
+        memmove(buffer->data, buffer->data + buffer->offset, buffer->length - buffer->offset);
+        buffer->length -= buffer->offset;
+        buffer->offset = 0;
+        if (buffer->capacity - buffer->length >= extra) {
+            return true;
+        }
+    }
+    size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+    while (capacity - buffer->length < extra) {
+        capacity *= 2;
+    }
+    uint8_t *data = realloc(buffer->data, capacity);
+    if (!data) {
+        return false;
+    }
+    buffer->data = data;
+    buffer->capacity = capacity;
+    return true;
+}
+
+static bool HIAHControlBufferAppend(HIAHControlBuffer *buffer, const void *data, size_t length) {
+    if (!HIAHControlBufferReserve(buffer, length)) {
+        return false;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return true;
+}
+
+static inline size_t HIAHControlBufferPending(const HIAHControlBuffer *buffer) {
+    return buffer->length - buffer->offset;
+}
+
+// MARK: - Poller
+
+static int HIAHControlPollerCreate(void) {
+#if HIAH_CONTROL_USE_KQUEUE
+    return kqueue();
+#else
+    return epoll_create1(EPOLL_CLOEXEC);
+#endif
+}
+
+static bool HIAHControlPollerSet(int pollFd, int fd, bool readable, bool writable, bool add) {
+#if HIAH_CONTROL_USE_KQUEUE
+    // Only register a write filter once somebody asks for it; pipes reject it
+    struct kevent changes[2];
+    int count = 0;
+    EV_SET(&changes[count++], fd, EVFILT_READ, EV_ADD | (readable ? EV_ENABLE : EV_DISABLE), 0, 0, NULL);
+    if (writable || !add) {
+        EV_SET(&changes[count++], fd, EVFILT_WRITE, EV_ADD | (writable ? EV_ENABLE : EV_DISABLE), 0, 0, NULL);
+    }
+    return kevent(pollFd, changes, count, NULL, 0, NULL) == 0;
+#else
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = (readable ? EPOLLIN : 0) | (writable ? EPOLLOUT : 0);
+    event.data.fd = fd;
+    return epoll_ctl(pollFd, add ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event) == 0;
+#endif
+}
+
+typedef struct {
+    int fd;
+    bool readable;
+    bool writable;
+    bool failed;
+} HIAHControlEvent;
+
+static int HIAHControlPollerWait(int pollFd, HIAHControlEvent *out, int maxEvents) {
+#if HIAH_CONTROL_USE_KQUEUE
+    struct kevent events[HIAH_CONTROL_MAX_EVENTS];
+    int n = kevent(pollFd, NULL, 0, events, maxEvents, NULL);
+    for (int i = 0; i < n; i++) {
+        out[i].fd = (int)events[i].ident;
+        out[i].readable = events[i].filter == EVFILT_READ;
+        out[i].writable = events[i].filter == EVFILT_WRITE;
+        // EOF on read is reported through read() itself
+        out[i].failed = (events[i].flags & EV_ERROR) != 0;
+    }
+    return n;
+#else
+    struct epoll_event events[HIAH_CONTROL_MAX_EVENTS];
+    int n = epoll_wait(pollFd, events, maxEvents, -1);
+    for (int i = 0; i < n; i++) {
+        out[i].fd = events[i].data.fd;
+        out[i].readable = (events[i].events & (EPOLLIN | EPOLLHUP)) != 0;
+        out[i].writable = (events[i].events & EPOLLOUT) != 0;
+        out[i].failed = (events[i].events & EPOLLERR) != 0;
+    }
+    return n;
+#endif
+}
+
+// MARK: - Connections
+
+static inline int HIAHControlConnectionFd(HIAHControlConnectionID identifier) {
+    return (int)(identifier & 0xffffffffu);
+}
+
+static HIAHControlConnection *HIAHControlServerLookup(HIAHControlServer *server,
+                                                      HIAHControlConnectionID identifier) {
+    int fd = HIAHControlConnectionFd(identifier);
+    if (fd < 0 || (size_t)fd >= server->connectionCapacity) {
+        return NULL;
+    }
+    HIAHControlConnection *connection = server->connections[fd];
+    return (connection && connection->identifier == identifier) ? connection : NULL;
+}
+
+static void HIAHControlConnectionUpdateInterest(HIAHControlServer *server, HIAHControlConnection *connection) {
+    bool readable = !connection->readClosed && !connection->readPaused;
+#if !HIAH_CONTROL_USE_KQUEUE
+    // epoll reports EPOLLHUP whatever was asked for, level-triggered, so a
+    // closed peer that is still owed replies would wake the reactor forever.
+    // Leave the poller until there is output to flush again.
+    if (!readable && !connection->wantsWrite) {
+        if (connection->polled) {
+            epoll_ctl(server->pollFd, EPOLL_CTL_DEL, connection->fd, NULL);
+            connection->polled = false;
+        }
+        return;
+    }
+#endif
+    if (HIAHControlPollerSet(server->pollFd, connection->fd, readable, connection->wantsWrite,
+                             !connection->polled)) {
+        connection->polled = true;
+    } else if (!connection->polled) {
+        connection->dead = true;
+    }
+}
+
+static void HIAHControlConnectionClose(HIAHControlServer *server, HIAHControlConnection *connection) {
+    server->connections[connection->fd] = NULL;
+    close(connection->fd);   // Also drops it from the poller
+    while (connection->parked) {
+        HIAHControlQueuedReply *next = connection->parked->next;
+        free(connection->parked);
+        connection->parked = next;
+    }
+    free(connection->input.data);
+    free(connection->output.data);
+    free(connection);
+    atomic_fetch_sub_explicit(&server->active, 1, memory_order_relaxed);
+}
+
+/**
+ * Closes the connection if it is broken, or if the peer has finished and
+ * every request has been answered and flushed.
+ *
+ * @return true if the connection was closed
+ */
+static bool HIAHControlConnectionReap(HIAHControlServer *server, HIAHControlConnection *connection) {
+    if (connection->dead ||
+        (connection->readClosed && connection->pending == 0 &&
+         HIAHControlBufferPending(&connection->output) == 0)) {
+        HIAHControlConnectionClose(server, connection);
+        return true;
+    }
+    return false;
+}
+
+static void HIAHControlConnectionFlush(HIAHControlServer *server, HIAHControlConnection *connection) {
+    HIAHControlBuffer *output = &connection->output;
+    while (HIAHControlBufferPending(output) > 0) {
+        ssize_t n = send(connection->fd, output->data + output->offset, HIAHControlBufferPending(output),
+                         HIAH_CONTROL_SEND_FLAGS);
+        if (n > 0) {
+            output->offset += (size_t)n;
+            atomic_fetch_add_explicit(&server->bytesOut, (uint64_t)n, memory_order_relaxed);
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            connection->dead = true;
+            return;
+        }
+    }
+
+    // Backpressure: stop reading above the high watermark, resume below half of it
+    size_t unsent = HIAHControlBufferPending(output);
+    bool wantsWrite = unsent > 0;
+    bool readPaused = connection->readPaused ? unsent > server->config.writeHighWatermark / 2
+                                             : unsent > server->config.writeHighWatermark;
+    if (wantsWrite != connection->wantsWrite || readPaused != connection->readPaused) {
+        connection->wantsWrite = wantsWrite;
+        connection->readPaused = readPaused;
+        HIAHControlConnectionUpdateInterest(server, connection);
+    }
+}
+
+static void HIAHControlConnectionWriteReply(HIAHControlServer *server,
+                                            HIAHControlConnection *connection,
+                                            const void *data,
+                                            size_t length) {
+    if (connection->pending > 0) {
+        connection->pending--;
+    }
+    connection->nextReply++;
+
+    bool appended;
+    if (connection->protocolVersion > 0) {
+        uint8_t header[HIAH_CONTROL_FRAME_HEADER] = {
+            (uint8_t)length, (uint8_t)(length >> 8), (uint8_t)(length >> 16), (uint8_t)(length >> 24)};
+        appended = length <= UINT32_MAX &&
+                   HIAHControlBufferAppend(&connection->output, header, sizeof(header)) &&
+                   HIAHControlBufferAppend(&connection->output, data, length);
+    } else {
+        appended = HIAHControlBufferAppend(&connection->output, data, length) &&
+                   HIAHControlBufferAppend(&connection->output, "\n", 1);
+    }
+    if (!appended) {
+        connection->dead = true;
+        return;
+    }
+    atomic_fetch_add_explicit(&server->replies, 1, memory_order_relaxed);
+}
+
+/**
+ * Writes `reply` if it is next in line, otherwise parks it (taking
+ * ownership). Any parked replies that become due are written too. On a
+ * multiplexed connection every reply is in line.
+ *
+ * @return true if `reply` was parked and must not be freed by the caller
+ */
+static bool HIAHControlConnectionSubmitReply(HIAHControlServer *server,
+                                             HIAHControlConnection *connection,
+                                             HIAHControlQueuedReply *reply) {
+    if (connection->protocolVersion < HIAH_CONTROL_MULTIPLEXED &&
+        reply->request.sequence != connection->nextReply) {
+        HIAHControlQueuedReply **link = &connection->parked;
+        while (*link && (*link)->request.sequence < reply->request.sequence) {
+            link = &(*link)->next;
+        }
+        reply->next = *link;
+        *link = reply;
+        return true;
+    }
+
+    HIAHControlConnectionWriteReply(server, connection, reply->data, reply->length);
+    while (connection->parked && connection->parked->request.sequence == connection->nextReply) {
+        HIAHControlQueuedReply *due = connection->parked;
+        connection->parked = due->next;
+        HIAHControlConnectionWriteReply(server, connection, due->data, due->length);
+        free(due);
+    }
+    HIAHControlConnectionFlush(server, connection);
+    return false;
+}
+
+/**
+ * Picks the framing from the first bytes of a connection.
+ *
+ * @return false if more input is needed to decide
+ */
+static bool HIAHControlConnectionNegotiate(HIAHControlServer *server, HIAHControlConnection *connection) {
+    HIAHControlBuffer *input = &connection->input;
+    const uint8_t *start = input->data + input->offset;
+    size_t available = HIAHControlBufferPending(input);
+    size_t compare = available < HIAH_CONTROL_MAGIC_LENGTH ? available : HIAH_CONTROL_MAGIC_LENGTH;
+
+    if (memcmp(start, HIAH_CONTROL_MAGIC, compare) != 0) {
+        connection->negotiated = true;   // Plain JSON client
+        return true;
+    }
+    if (available < HIAH_CONTROL_HELLO_LENGTH) {
+        return false;
+    }
+
+    uint8_t offered = start[HIAH_CONTROL_MAGIC_LENGTH];
+    uint8_t version = offered < HIAH_CONTROL_PROTOCOL_VERSION ? offered : HIAH_CONTROL_PROTOCOL_VERSION;
+    input->offset += HIAH_CONTROL_HELLO_LENGTH;
+    connection->negotiated = true;
+    connection->protocolVersion = version;
+
+    uint8_t answer[HIAH_CONTROL_HELLO_LENGTH];
+    memcpy(answer, HIAH_CONTROL_MAGIC, HIAH_CONTROL_MAGIC_LENGTH);
+    answer[HIAH_CONTROL_MAGIC_LENGTH] = version;
+    if (!HIAHControlBufferAppend(&connection->output, answer, sizeof(answer))) {
+        connection->dead = true;
+        return true;
+    }
+    if (version == 0) {
+        // Refused: say so, then close once the answer is out
+        atomic_fetch_add_explicit(&server->protocolErrors, 1, memory_order_relaxed);
+        connection->readClosed = true;
+        HIAHControlConnectionUpdateInterest(server, connection);
+    }
+    HIAHControlConnectionFlush(server, connection);
+    return true;
+}
+
+static void HIAHControlConnectionDeliver(HIAHControlServer *server, HIAHControlConnection *connection,
+                                         const uint8_t *message, size_t length) {
+    HIAHControlRequest request = {connection->identifier, connection->nextSequence++,
+                                  connection->protocolVersion, 0};
+    connection->pending++;
+    atomic_fetch_add_explicit(&server->messages, 1, memory_order_relaxed);
+    server->handler(server, request, message, length, server->context);
+}
+
+/**
+ * Delivers every complete length-prefixed frame in the input buffer. The
+ * handler sees the payload in place.
+ */
+static void HIAHControlConnectionDispatchFrames(HIAHControlServer *server, HIAHControlConnection *connection) {
+    HIAHControlBuffer *input = &connection->input;
+
+    while (!connection->dead && !connection->readClosed) {
+        const uint8_t *start = input->data + input->offset;
+        size_t available = HIAHControlBufferPending(input);
+        if (available < HIAH_CONTROL_FRAME_HEADER) {
+            return;
+        }
+        size_t frameLength = (size_t)start[0] | ((size_t)start[1] << 8) |
+                             ((size_t)start[2] << 16) | ((size_t)start[3] << 24);
+        if (frameLength == 0 || frameLength > server->config.maxMessageSize) {
+            atomic_fetch_add_explicit(&server->protocolErrors, 1, memory_order_relaxed);
+            connection->dead = true;
+            return;
+        }
+        if (available - HIAH_CONTROL_FRAME_HEADER < frameLength) {
+            return;
+        }
+        input->offset += HIAH_CONTROL_FRAME_HEADER + frameLength;
+        HIAHControlConnectionDeliver(server, connection, start + HIAH_CONTROL_FRAME_HEADER, frameLength);
+    }
+}
+
+/**
+ * Delivers every complete newline-terminated request in the input buffer.
+ */
+static void HIAHControlConnectionDispatchLines(HIAHControlServer *server, HIAHControlConnection *connection) {
+    HIAHControlBuffer *input = &connection->input;
+
+    while (!connection->dead) {
+        uint8_t *start = input->data + input->offset;
+        size_t available = HIAHControlBufferPending(input);
+        uint8_t *newline = memchr(start + connection->scanned, '\n', available - connection->scanned);
+        if (!newline) {
+            connection->scanned = available;
+            if (available > server->config.maxMessageSize) {
+                atomic_fetch_add_explicit(&server->protocolErrors, 1, memory_order_relaxed);
+                connection->dead = true;
+            }
+            return;
+        }
+
+        size_t frameLength = (size_t)(newline - start);
+        input->offset += frameLength + 1;
+        connection->scanned = 0;
+
+        size_t messageLength = frameLength;
+        if (messageLength > 0 && start[messageLength - 1] == '\r') {
+            messageLength--;
+        }
+        if (messageLength == 0) {
+            continue;
+        }
+        if (messageLength > server->config.maxMessageSize) {
+            atomic_fetch_add_explicit(&server->protocolErrors, 1, memory_order_relaxed);
+            connection->dead = true;
+            return;
+        }
+
+        HIAHControlConnectionDeliver(server, connection, start, messageLength);
+    }
+}
+
+static void HIAHControlConnectionDispatch(HIAHControlServer *server, HIAHControlConnection *connection) {
+    if (!connection->negotiated && !HIAHControlConnectionNegotiate(server, connection)) {
+        return;
+    }
+    if (connection->protocolVersion > 0) {
+        HIAHControlConnectionDispatchFrames(server, connection);
+    } else {
+        HIAHControlConnectionDispatchLines(server, connection);
+    }
+}
+
+static void HIAHControlConnectionRead(HIAHControlServer *server, HIAHControlConnection *connection) {
+    size_t budget = HIAH_CONTROL_READ_BUDGET;
+
+    while (budget > 0 && !connection->dead && !connection->readPaused && !connection->readClosed) {
+        if (!HIAHControlBufferReserve(&connection->input, HIAH_CONTROL_READ_CHUNK)) {
+            connection->dead = true;
+            return;
+        }
+        HIAHControlBuffer *input = &connection->input;
+        ssize_t n = recv(connection->fd, input->data + input->length, HIAH_CONTROL_READ_CHUNK, 0);
+        if (n > 0) {
+            input->length += (size_t)n;
+            budget = (size_t)n >= budget ? 0 : budget - (size_t)n;
+            atomic_fetch_add_explicit(&server->bytesIn, (uint64_t)n, memory_order_relaxed);
+            HIAHControlConnectionDispatch(server, connection);
+        } else if (n == 0) {
+            // Peer finished sending; keep the socket until replies are out
+            connection->readClosed = true;
+            HIAHControlConnectionUpdateInterest(server, connection);
+            return;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return;
+        } else {
+            connection->dead = true;
+            return;
+        }
+    }
+}
+
+static void HIAHControlServerAccept(HIAHControlServer *server) {
+    for (;;) {
+        int fd = accept(server->listenFd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;   // EAGAIN, or out of descriptors until someone closes
+        }
+
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+        if ((size_t)fd >= server->connectionCapacity) {
+            size_t capacity = server->connectionCapacity ? server->connectionCapacity : 64;
+            while (capacity <= (size_t)fd) {
+                capacity *= 2;
+            }
+            HIAHControlConnection **grown = realloc(server->connections, capacity * sizeof(*grown));
+            if (!grown) {
+                close(fd);
+                continue;
+            }
+            memset(grown + server->connectionCapacity, 0,
+                   (capacity - server->connectionCapacity) * sizeof(*grown));
+            server->connections = grown;
+            server->connectionCapacity = capacity;
+        }
+
+        HIAHControlConnection *connection = calloc(1, sizeof(HIAHControlConnection));
+        if (!connection || !HIAHControlPollerSet(server->pollFd, fd, true, false, true)) {
+            free(connection);
+            close(fd);
+            continue;
+        }
+        connection->fd = fd;
+        connection->polled = true;
+        connection->identifier = ((uint64_t)++server->nextGeneration << 32) | (uint32_t)fd;
+        server->connections[fd] = connection;
+
+        atomic_fetch_add_explicit(&server->accepted, 1, memory_order_relaxed);
+        uint64_t active = atomic_fetch_add_explicit(&server->active, 1, memory_order_relaxed) + 1;
+        if (active > atomic_load_explicit(&server->peakActive, memory_order_relaxed)) {
+            atomic_store_explicit(&server->peakActive, active, memory_order_relaxed);
+        }
+    }
+}
+
+static void HIAHControlServerDrainQueue(HIAHControlServer *server) {
+    char scratch[64];
+    while (read(server->wakeFds[0], scratch, sizeof(scratch)) > 0) {
+    }
+
+    pthread_mutex_lock(&server->queueLock);
+    HIAHControlQueuedReply *reply = server->queueHead;
+    server->queueHead = server->queueTail = NULL;
+    pthread_mutex_unlock(&server->queueLock);
+
+    while (reply) {
+        HIAHControlQueuedReply *next = reply->next;
+        HIAHControlConnection *connection = HIAHControlServerLookup(server, reply->request.connection);
+        bool parked = false;
+        if (connection) {
+            parked = HIAHControlConnectionSubmitReply(server, connection, reply);
+            HIAHControlConnectionReap(server, connection);
+        }
+        if (!parked) {
+            free(reply);
+        }
+        reply = next;
+    }
+}
+
+static void *HIAHControlServerRun(void *data) {
+    HIAHControlServer *server = data;
+    HIAHControlEvent events[HIAH_CONTROL_MAX_EVENTS];
+
+    while (!atomic_load(&server->stopping)) {
+        int n = HIAHControlPollerWait(server->pollFd, events, HIAH_CONTROL_MAX_EVENTS);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].fd;
+            if (fd == server->listenFd) {
+                HIAHControlServerAccept(server);
+                continue;
+            }
+            if (fd == server->wakeFds[0]) {
+                HIAHControlServerDrainQueue(server);
+                continue;
+            }
+            if (fd < 0 || (size_t)fd >= server->connectionCapacity || !server->connections[fd]) {
+                continue;   // Closed earlier in this batch
+            }
+
+            HIAHControlConnection *connection = server->connections[fd];
+            if (events[i].failed) {
+                connection->dead = true;
+            }
+            if (events[i].readable && !connection->dead) {
+                HIAHControlConnectionRead(server, connection);
+            }
+            if (events[i].writable && !connection->dead) {
+                HIAHControlConnectionFlush(server, connection);
+            }
+            HIAHControlConnectionReap(server, connection);
+        }
+    }
+    return NULL;
+}
+
+// MARK: - Public API
+
+HIAHControlServer *HIAHControlServerCreate(const char *socketPath,
+                                           const HIAHControlServerConfig *config,
+                                           HIAHControlMessageHandler handler,
+                                           void *context,
+                                           int *error) {
+    struct sockaddr_un addr;
+    if (!socketPath || !handler || strlen(socketPath) >= sizeof(addr.sun_path)) {
+        if (error) *error = EINVAL;
+        return NULL;
+    }
+
+    HIAHControlServer *server = calloc(1, sizeof(HIAHControlServer));
+    if (!server) {
+        if (error) *error = ENOMEM;
+        return NULL;
+    }
+    server->listenFd = server->pollFd = server->wakeFds[0] = server->wakeFds[1] = -1;
+    server->handler = handler;
+    server->context = context;
+    if (config) {
+        server->config = *config;
+    }
+    if (server->config.backlog <= 0) server->config.backlog = SOMAXCONN;
+    if (server->config.maxMessageSize == 0) server->config.maxMessageSize = HIAH_CONTROL_DEFAULT_MAX_MESSAGE;
+    if (server->config.writeHighWatermark == 0) server->config.writeHighWatermark = HIAH_CONTROL_DEFAULT_HIGH_WATER;
+    pthread_mutex_init(&server->queueLock, NULL);
+
+    server->socketPath = strdup(socketPath);
+    server->listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    server->pollFd = HIAHControlPollerCreate();
+    if (!server->socketPath || server->listenFd < 0 || server->pollFd < 0 || pipe(server->wakeFds) != 0) {
+        goto fail;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        fcntl(server->wakeFds[i], F_SETFL, fcntl(server->wakeFds[i], F_GETFL) | O_NONBLOCK);
+        fcntl(server->wakeFds[i], F_SETFD, FD_CLOEXEC);
+    }
+    fcntl(server->listenFd, F_SETFL, fcntl(server->listenFd, F_GETFL) | O_NONBLOCK);
+    fcntl(server->listenFd, F_SETFD, FD_CLOEXEC);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath, sizeof(addr.sun_path) - 1);
+    unlink(socketPath); // Remove if exists
+
+    if (bind(server->listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server->listenFd, server->config.backlog) != 0 ||
+        !HIAHControlPollerSet(server->pollFd, server->listenFd, true, false, true) ||
+        !HIAHControlPollerSet(server->pollFd, server->wakeFds[0], true, false, true)) {
+        goto fail;
+    }
+    return server;
+
+fail:
+    if (error) *error = errno;
+    HIAHControlServerDestroy(server);
+    return NULL;
+}
+
+bool HIAHControlServerStart(HIAHControlServer *server) {
+    if (!server || server->running) {
+        return false;
+    }
+    atomic_store(&server->stopping, false);
+    if (pthread_create(&server->thread, NULL, HIAHControlServerRun, server) != 0) {
+        return false;
+    }
+    server->running = true;
+    return true;
+}
+
+void HIAHControlServerStop(HIAHControlServer *server) {
+    if (!server || !server->running) {
+        return;
+    }
+    atomic_store(&server->stopping, true);
+    (void)write(server->wakeFds[1], "x", 1);
+    pthread_join(server->thread, NULL);
+    server->running = false;
+
+    for (size_t fd = 0; fd < server->connectionCapacity; fd++) {
+        if (server->connections[fd]) {
+            HIAHControlConnectionClose(server, server->connections[fd]);
+        }
+    }
+
+    pthread_mutex_lock(&server->queueLock);
+    HIAHControlQueuedReply *reply = server->queueHead;
+    server->queueHead = server->queueTail = NULL;
+    pthread_mutex_unlock(&server->queueLock);
+    while (reply) {
+        HIAHControlQueuedReply *next = reply->next;
+        free(reply);
+        reply = next;
+    }
+}
+
+void HIAHControlServerDestroy(HIAHControlServer *server) {
+    if (!server) {
+        return;
+    }
+    HIAHControlServerStop(server);
+    if (server->listenFd >= 0) {
+        close(server->listenFd);
+        if (server->socketPath) {
+            unlink(server->socketPath);
+        }
+    }
+    if (server->pollFd >= 0) close(server->pollFd);
+    if (server->wakeFds[0] >= 0) close(server->wakeFds[0]);
+    if (server->wakeFds[1] >= 0) close(server->wakeFds[1]);
+    pthread_mutex_destroy(&server->queueLock);
+    free(server->connections);
+    free(server->socketPath);
+    free(server);
+}
+
+bool HIAHControlServerReply(HIAHControlServer *server,
+                            HIAHControlRequest request,
+                            const void *data,
+                            size_t length) {
+    if (!server || !server->running || atomic_load(&server->stopping)) {
+        return false;
+    }
+
+    bool onReactor = pthread_equal(pthread_self(), server->thread);
+    if (onReactor && !HIAHControlServerLookup(server, request.connection)) {
+        return false;
+    }
+
+    HIAHControlQueuedReply *reply = malloc(sizeof(HIAHControlQueuedReply) + length);
+    if (!reply) {
+        return false;
+    }
+    reply->next = NULL;
+    reply->request = request;
+    reply->length = length;
+    memcpy(reply->data, data, length);
+
+    // Replies made from the handler go straight to the connection
+    if (onReactor) {
+        HIAHControlConnection *connection = HIAHControlServerLookup(server, request.connection);
+        if (!HIAHControlConnectionSubmitReply(server, connection, reply)) {
+            free(reply);
+        }
+        return true;
+    }
+
+    pthread_mutex_lock(&server->queueLock);
+    bool wasEmpty = server->queueHead == NULL;
+    if (server->queueTail) {
+        server->queueTail->next = reply;
+    } else {
+        server->queueHead = reply;
+    }
+    server->queueTail = reply;
+    pthread_mutex_unlock(&server->queueLock);
+
+    // One wakeup per batch of replies
+    if (wasEmpty) {
+        (void)write(server->wakeFds[1], "x", 1);
+    }
+    return true;
+}
+
+void HIAHControlServerGetStats(HIAHControlServer *server, HIAHControlServerStats *stats) {
+    if (!server || !stats) {
+        return;
+    }
+    stats->accepted = atomic_load_explicit(&server->accepted, memory_order_relaxed);
+    stats->active = atomic_load_explicit(&server->active, memory_order_relaxed);
+    stats->peakActive = atomic_load_explicit(&server->peakActive, memory_order_relaxed);
+    stats->messages = atomic_load_explicit(&server->messages, memory_order_relaxed);
+    stats->replies = atomic_load_explicit(&server->replies, memory_order_relaxed);
+    stats->protocolErrors = atomic_load_explicit(&server->protocolErrors, memory_order_relaxed);
+    stats->bytesIn = atomic_load_explicit(&server->bytesIn, memory_order_relaxed);
+    stats->bytesOut = atomic_load_explicit(&server->bytesOut, memory_order_relaxed);
+}
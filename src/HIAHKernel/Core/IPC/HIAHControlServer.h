@@ -0,0 +1,135 @@
+/**
+ * HIAHControlServer.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Event-driven server for the kernel control socket (`k.s`).
+ *
+ * A single reactor thread multiplexes the listening socket and every client
+ * connection with kqueue (Darwin) or epoll (Linux). Connections are
+ * non-blocking, have their own input and output buffers, and requests are
+ * framed incrementally, so a request split across reads (or several requests
+ * in one read) is handled correctly. Replies may be sent from any thread.
+ *
+ * Each connection picks its framing with its first bytes: a binary protocol
+ * hello (see HIAHControlProtocol.h) switches it to length-prefixed frames,
+ * anything else keeps newline-delimited JSON.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_CONTROL_SERVER_H
+#define HIAH_CONTROL_SERVER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct HIAHControlServer HIAHControlServer;
+
+/**
+ * Identifies a connection for its whole lifetime. IDs are never reused, so a
+ * late reply to a closed connection is dropped instead of reaching whichever
+ * client got the same file descriptor afterwards.
+ */
+typedef uint64_t HIAHControlConnectionID;
+
+/**
+ * Identifies one request on a connection. Replies are written in request
+ * order even when they are produced out of order on other threads, except
+ * on multiplexed connections (HIAH_CONTROL_MULTIPLEXED), where each goes
+ * out as soon as it is queued.
+ */
+typedef struct {
+    HIAHControlConnectionID connection;
+    uint32_t sequence;
+    uint8_t protocolVersion;   // 0 = newline JSON, otherwise binary frames
+    uint64_t requestID;        // Set by the handler from the request's RequestID (0 = none)
+} HIAHControlRequest;
+
+/**
+ * Called on the reactor thread for every complete request.
+ *
+ * `message` excludes the framing and is only valid for the duration of the
+ * call. For binary connections it is one complete payload. Every request must eventually be answered with exactly one
+ * HIAHControlServerReply(); a connection whose peer has finished sending
+ * stays open until all of its requests are answered.
+ */
+typedef void (*HIAHControlMessageHandler)(HIAHControlServer *server,
+                                          HIAHControlRequest request,
+                                          const uint8_t *message,
+                                          size_t length,
+                                          void *context);
+
+typedef struct {
+    int backlog;                 // listen() backlog (0 = SOMAXCONN)
+    size_t maxMessageSize;       // Larger requests close the connection (0 = 1 MiB)
+    size_t writeHighWatermark;   // Stop reading a client whose unsent output exceeds this (0 = 4 MiB)
+} HIAHControlServerConfig;
+
+typedef struct {
+    uint64_t accepted;
+    uint64_t active;
+    uint64_t peakActive;
+    uint64_t messages;
+    uint64_t replies;
+    uint64_t protocolErrors;
+    uint64_t bytesIn;
+    uint64_t bytesOut;
+} HIAHControlServerStats;
+
+/**
+ * Binds and listens on `socketPath` (an existing socket file is replaced).
+ *
+ * @param error Receives errno on failure (may be NULL)
+ * @return The server, or NULL on failure
+ */
+HIAHControlServer *HIAHControlServerCreate(const char *socketPath,
+                                           const HIAHControlServerConfig *config,
+                                           HIAHControlMessageHandler handler,
+                                           void *context,
+                                           int *error);
+
+/**
+ * Starts the reactor thread.
+ */
+bool HIAHControlServerStart(HIAHControlServer *server);
+
+/**
+ * Stops the reactor thread and closes every connection. Safe to call twice.
+ */
+void HIAHControlServerStop(HIAHControlServer *server);
+
+/**
+ * Stops the server, unlinks the socket file and frees it.
+ */
+void HIAHControlServerDestroy(HIAHControlServer *server);
+
+/**
+ * Queues a reply to one request. Thread-safe; never blocks on the peer.
+ * The server adds the framing.
+ *
+ * @return false if the server is stopped, the connection is known to be
+ *         gone, or the reply could not be queued
+ */
+bool HIAHControlServerReply(HIAHControlServer *server,
+                            HIAHControlRequest request,
+                            const void *data,
+                            size_t length);
+
+/**
+ * Copies the current counters.
+ */
+void HIAHControlServerGetStats(HIAHControlServer *server, HIAHControlServerStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_CONTROL_SERVER_H */
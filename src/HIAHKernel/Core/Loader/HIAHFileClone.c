@@ -0,0 +1,420 @@
+/**
+ * HIAHFileClone.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Copy-on-write copies of guest binaries and app bundles.
+ *
+ * On Apple platforms a tree is first offered to clonefile() whole, which
+ * APFS does in one metadata operation; on other file systems, and on
+ * Linux, the tree is walked and every file tries clone, range and copy in
+ * turn. A method that fails for one file because the file system does not
+ * support it is not retried for the rest of the walk.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE    // copy_file_range, SEEK_DATA
+#endif
+
+#include "HIAHFileClone.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <sys/clonefile.h>
+#define HIAH_STAT_ATIME(st) ((st)->st_atimespec)
+#define HIAH_STAT_MTIME(st) ((st)->st_mtimespec)
+#else
+#define HIAH_STAT_ATIME(st) ((st)->st_atim)
+#define HIAH_STAT_MTIME(st) ((st)->st_mtim)
+#endif
+#if defined(__linux__)
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+#define HIAH_FILE_CLONE_CHUNK (1u << 20)
+
+typedef struct {
+    unsigned flags;    // HIAH_FILE_CLONE_* plus methods found unsupported
+    HIAHFileCloneStats stats;
+    uint8_t *buffer;   // Copy method, allocated on first use
+    char *error;
+    size_t errorSize;
+} HIAHFileCloneContext;
+
+static void HIAHFileCloneError(HIAHFileCloneContext *context, const char *format, ...) {
+    if (!context->error || context->errorSize == 0) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vsnprintf(context->error, context->errorSize, format, args);
+    va_end(args);
+}
+
+// Errors that mean "not here", as opposed to a failing disk or a full one
+static bool HIAHFileCloneUnsupported(int error) {
+    return error == EOPNOTSUPP || error == ENOTSUP || error == EXDEV || error == EINVAL ||
+           error == ENOSYS || error == ENOTTY;
+}
+
+static void HIAHFileCloneCopyAttributes(int fd, const struct stat *st) {
+    fchmod(fd, st->st_mode & 07777);
+    struct timespec times[2] = {HIAH_STAT_ATIME(st), HIAH_STAT_MTIME(st)};
+    futimens(fd, times);
+}
+
+// MARK: - Copy Method
+
+static bool HIAHFileCloneIsZero(const uint8_t *bytes, size_t length) {
+    return length == 0 || (bytes[0] == 0 && memcmp(bytes, bytes + 1, length - 1) == 0);
+}
+
+/**
+ * Copies [offset, end) of `in` to the same place in `out`, leaving all-zero
+ * chunks as holes.
+ */
+static bool HIAHFileCloneCopyRange(HIAHFileCloneContext *context, int in, int out,
+                                   off_t offset, off_t end) {
+    if (!context->buffer && !(context->buffer = malloc(HIAH_FILE_CLONE_CHUNK))) {
+        HIAHFileCloneError(context, "out of memory");
+        return false;
+    }
+    while (offset < end) {
+        size_t want = end - offset < HIAH_FILE_CLONE_CHUNK ? (size_t)(end - offset)
+                                                           : HIAH_FILE_CLONE_CHUNK;
+        ssize_t got = pread(in, context->buffer, want, offset);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            HIAHFileCloneError(context, "read: %s", got < 0 ? strerror(errno) : "file shrank");
+            return false;
+        }
+        if (!HIAHFileCloneIsZero(context->buffer, (size_t)got)) {
+            for (ssize_t done = 0; done < got;) {
+                ssize_t written = pwrite(out, context->buffer + done, (size_t)(got - done),
+                                         offset + done);
+                if (written < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (written <= 0) {
+                    HIAHFileCloneError(context, "write: %s", strerror(errno));
+                    return false;
+                }
+                done += written;
+            }
+            context->stats.bytesCopied += (uint64_t)got;
+        }
+        offset += got;
+    }
+    return true;
+}
+
+// MARK: - Range Method
+
+#if defined(__linux__)
+/**
+ * copy_file_range() over [offset, end). Returns -1 on failure, 0 if the
+ * file system cannot do it (nothing was copied), 1 on success.
+ */
+static int HIAHFileCloneKernelRange(HIAHFileCloneContext *context, int in, int out,
+                                    off_t offset, off_t end) {
+    bool started = false;
+    while (offset < end) {
+        loff_t from = offset, to = offset;
+        ssize_t n = copy_file_range(in, &from, out, &to, (size_t)(end - offset), 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && !started && HIAHFileCloneUnsupported(errno)) {
+            return 0;
+        }
+        if (n <= 0) {
+            HIAHFileCloneError(context, "copy_file_range: %s", n < 0 ? strerror(errno) : "file shrank");
+            return -1;
+        }
+        started = true;
+        offset += n;
+        context->stats.bytesCopied += (uint64_t)n;
+    }
+    return 1;
+}
+#endif
+
+/**
+ * Copies the data extents of `in`, so holes stay holes. Returns the method
+ * used for the bulk of it, or -1.
+ */
+static int HIAHFileCloneExtents(HIAHFileCloneContext *context, int in, int out, off_t size) {
+#if defined(__linux__)
+    HIAHFileCloneMethod method = (context->flags & HIAH_FILE_CLONE_NO_RANGE) ? HIAHFileCloneMethodCopy
+                                                                             : HIAHFileCloneMethodRange;
+#else
+    HIAHFileCloneMethod method = HIAHFileCloneMethodCopy;
+#endif
+    off_t offset = 0;
+    while (offset < size) {
+        off_t data = offset, hole = size;
+#ifdef SEEK_DATA
+        data = lseek(in, offset, SEEK_DATA);
+        if (data < 0 && errno == ENXIO) {
+            break;    // Only a hole remains
+        }
+        if (data < 0) {
+            data = offset;    // No extent information: treat it all as data
+        } else {
+            hole = lseek(in, data, SEEK_HOLE);
+            if (hole < 0 || hole > size) {
+                hole = size;
+            }
+        }
+#endif
+        int done = 0;
+#if defined(__linux__)
+        if (!(context->flags & HIAH_FILE_CLONE_NO_RANGE)) {
+            done = HIAHFileCloneKernelRange(context, in, out, data, hole);
+            if (done < 0) {
+                return -1;
+            }
+            if (done == 0) {
+                context->flags |= HIAH_FILE_CLONE_NO_RANGE;
+            }
+        }
+#endif
+        if (!done) {
+            method = HIAHFileCloneMethodCopy;
+            if (!HIAHFileCloneCopyRange(context, in, out, data, hole)) {
+                return -1;
+            }
+        }
+        offset = hole;
+    }
+
+    // Trailing holes and skipped zero chunks
+    if (ftruncate(out, size) != 0) {
+        HIAHFileCloneError(context, "truncate: %s", strerror(errno));
+        return -1;
+    }
+    return (int)method;
+}
+
+// MARK: - Files
+
+static bool HIAHFileCloneRegular(HIAHFileCloneContext *context, const char *source,
+                                 const char *destination, const struct stat *st) {
+#if defined(__APPLE__)
+    if (!(context->flags & HIAH_FILE_CLONE_NO_CLONE)) {
+        if (clonefile(source, destination, CLONE_NOFOLLOW) == 0) {
+            context->stats.files++;
+            context->stats.bytes += (uint64_t)st->st_size;
+            context->stats.methods[HIAHFileCloneMethodClone]++;
+            return true;
+        }
+        if (!HIAHFileCloneUnsupported(errno)) {
+            HIAHFileCloneError(context, "clonefile %s: %s", destination, strerror(errno));
+            return false;
+        }
+        context->flags |= HIAH_FILE_CLONE_NO_CLONE;
+    }
+#endif
+
+    int in = open(source, O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        HIAHFileCloneError(context, "open %s: %s", source, strerror(errno));
+        return false;
+    }
+    int out = open(destination, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    if (out < 0) {
+        HIAHFileCloneError(context, "create %s: %s", destination, strerror(errno));
+        close(in);
+        return false;
+    }
+
+    int method = -1;
+#if defined(__linux__) && defined(FICLONE)
+    if (!(context->flags & HIAH_FILE_CLONE_NO_CLONE)) {
+        if (ioctl(out, FICLONE, in) == 0) {
+            method = HIAHFileCloneMethodClone;
+        } else if (HIAHFileCloneUnsupported(errno)) {
+            context->flags |= HIAH_FILE_CLONE_NO_CLONE;
+        }
+    }
+#endif
+    if (method < 0) {
+        method = HIAHFileCloneExtents(context, in, out, st->st_size);
+    }
+    if (method >= 0) {
+        HIAHFileCloneCopyAttributes(out, st);
+    }
+    close(in);
+    if (close(out) != 0 && method >= 0) {
+        HIAHFileCloneError(context, "close %s: %s", destination, strerror(errno));
+        method = -1;
+    }
+    if (method < 0) {
+        unlink(destination);
+        return false;
+    }
+    context->stats.files++;
+    context->stats.bytes += (uint64_t)st->st_size;
+    context->stats.methods[method]++;
+    return true;
+}
+
+static bool HIAHFileCloneSymlink(HIAHFileCloneContext *context, const char *source,
+                                 const char *destination) {
+    char target[PATH_MAX];
+    ssize_t length = readlink(source, target, sizeof(target) - 1);
+    if (length < 0) {
+        HIAHFileCloneError(context, "readlink %s: %s", source, strerror(errno));
+        return false;
+    }
+    target[length] = '\0';
+    if (symlink(target, destination) != 0) {
+        HIAHFileCloneError(context, "symlink %s: %s", destination, strerror(errno));
+        return false;
+    }
+    context->stats.symlinks++;
+    return true;
+}
+
+static bool HIAHFileCloneWalk(HIAHFileCloneContext *context, const char *source,
+                              const char *destination);
+
+static bool HIAHFileCloneDirectory(HIAHFileCloneContext *context, const char *source,
+                                   const char *destination, const struct stat *st) {
+    if (mkdir(destination, 0700) != 0) {
+        HIAHFileCloneError(context, "mkdir %s: %s", destination, strerror(errno));
+        return false;
+    }
+    DIR *dir = opendir(source);
+    if (!dir) {
+        HIAHFileCloneError(context, "opendir %s: %s", source, strerror(errno));
+        return false;
+    }
+    context->stats.directories++;
+
+    bool ok = true;
+    struct dirent *entry;
+    char from[PATH_MAX], to[PATH_MAX];
+    while (ok && (entry = readdir(dir))) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        if ((size_t)snprintf(from, sizeof(from), "%s/%s", source, entry->d_name) >= sizeof(from) ||
+            (size_t)snprintf(to, sizeof(to), "%s/%s", destination, entry->d_name) >= sizeof(to)) {
+            HIAHFileCloneError(context, "path too long under %s", source);
+            ok = false;
+            break;
+        }
+        ok = HIAHFileCloneWalk(context, from, to);
+    }
+    closedir(dir);
+
+    // Last, so a read-only directory can still be filled and its mtime is
+    // not bumped by the filling
+    int fd = open(destination, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        HIAHFileCloneCopyAttributes(fd, st);
+        close(fd);
+    }
+    return ok;
+}
+
+static bool HIAHFileCloneWalk(HIAHFileCloneContext *context, const char *source,
+                              const char *destination) {
+    struct stat st;
+    if (lstat(source, &st) != 0) {
+        HIAHFileCloneError(context, "stat %s: %s", source, strerror(errno));
+        return false;
+    }
+    if (S_ISREG(st.st_mode)) {
+        return HIAHFileCloneRegular(context, source, destination, &st);
+    }
+    if (S_ISDIR(st.st_mode)) {
+        return HIAHFileCloneDirectory(context, source, destination, &st);
+    }
+    if (S_ISLNK(st.st_mode)) {
+        return HIAHFileCloneSymlink(context, source, destination);
+    }
+    context->stats.skipped++;
+    return true;
+}
+
+// MARK: - Public API
+
+bool HIAHFileCloneFile(const char *source, const char *destination, unsigned flags,
+                       HIAHFileCloneStats *stats, char *error, size_t errorSize) {
+    HIAHFileCloneContext context = {.flags = flags, .error = error, .errorSize = errorSize};
+    struct stat st;
+    bool ok;
+    if (stat(source, &st) != 0) {
+        HIAHFileCloneError(&context, "stat %s: %s", source, strerror(errno));
+        ok = false;
+    } else if (!S_ISREG(st.st_mode)) {
+        HIAHFileCloneError(&context, "%s is not a regular file", source);
+        ok = false;
+    } else {
+        ok = HIAHFileCloneRegular(&context, source, destination, &st);
+    }
+    free(context.buffer);
+    if (stats) {
+        *stats = context.stats;
+    }
+    return ok;
+}
+
+bool HIAHFileCloneTree(const char *source, const char *destination, unsigned flags,
+                       HIAHFileCloneStats *stats, char *error, size_t errorSize) {
+    HIAHFileCloneContext context = {.flags = flags, .error = error, .errorSize = errorSize};
+    bool ok = false, done = false;
+
+#if defined(__APPLE__)
+    struct stat st;
+    if (!(flags & HIAH_FILE_CLONE_NO_CLONE) && lstat(source, &st) == 0 && S_ISDIR(st.st_mode)) {
+        if (clonefile(source, destination, CLONE_NOFOLLOW) == 0) {
+            context.stats.directories = 1;
+            context.stats.methods[HIAHFileCloneMethodClone] = 1;
+            ok = done = true;
+        } else if (!HIAHFileCloneUnsupported(errno)) {
+            HIAHFileCloneError(&context, "clonefile %s: %s", destination, strerror(errno));
+            done = true;
+        } else {
+            context.flags |= HIAH_FILE_CLONE_NO_CLONE;
+        }
+    }
+#endif
+    if (!done) {
+        ok = HIAHFileCloneWalk(&context, source, destination);
+    }
+    free(context.buffer);
+    if (stats) {
+        *stats = context.stats;
+    }
+    return ok;
+}
+
+const char *HIAHFileCloneMethodName(HIAHFileCloneMethod method) {
+    switch (method) {
+        case HIAHFileCloneMethodClone:
+            return "clone";
+        case HIAHFileCloneMethodRange:
+            return "range";
+        case HIAHFileCloneMethodCopy:
+            return "copy";
+        default:
+            return "unknown";
+    }
+}
@@ -0,0 +1,92 @@
+/**
+ * HIAHFileClone.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Copy-on-write copies of guest binaries and app bundles.
+ *
+ * Staging an app for the extension and preparing a patched image both copy
+ * the whole binary, then change a few header bytes. Here the copy shares
+ * the source's blocks wherever the file system allows it, so only the pages
+ * patched afterwards are ever written:
+ *
+ *   Clone  clonefile() on APFS (a whole tree in one call), FICLONE on
+ *          Linux (btrfs, XFS with reflink, bcachefs)
+ *   Range  copy_file_range() on Linux, which stays in the kernel and which
+ *          some file systems (NFS, CIFS, XFS over the same device) turn
+ *          into shared extents too
+ *   Copy   chunked read/write that skips holes and all-zero chunks, so a
+ *          sparse source stays sparse
+ *
+ * Each file takes the first method that works. Modes and timestamps are
+ * preserved, as copyItemAtPath: does. Patch the copy with
+ * HIAHMachOTransformFile(), which only writes the bytes it changes; a full
+ * rewrite would materialize every block again.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_FILE_CLONE_H
+#define HIAH_FILE_CLONE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    HIAHFileCloneMethodClone = 0,
+    HIAHFileCloneMethodRange,
+    HIAHFileCloneMethodCopy,
+    HIAHFileCloneMethodCount
+} HIAHFileCloneMethod;
+
+// Methods to skip, mainly to measure the fallbacks
+#define HIAH_FILE_CLONE_NO_CLONE (1u << 0)
+#define HIAH_FILE_CLONE_NO_RANGE (1u << 1)
+
+typedef struct {
+    uint64_t files;
+    uint64_t directories;
+    uint64_t symlinks;
+    uint64_t skipped;                              // Sockets, FIFOs, devices
+    uint64_t bytes;                                // Size of the files
+    uint64_t bytesCopied;                          // Handed to the Range and Copy
+                                                   // methods rather than shared
+    uint64_t methods[HIAHFileCloneMethodCount];    // Files per method; a tree
+                                                   // cloned whole counts once
+} HIAHFileCloneStats;
+
+/**
+ * Copies the regular file `source` to `destination`, which must not exist.
+ *
+ * @param flags HIAH_FILE_CLONE_* bits, usually 0
+ * @param stats May be NULL
+ * @return false with `error` set on failure; a partial `destination` is
+ *         removed
+ */
+bool HIAHFileCloneFile(const char *source, const char *destination, unsigned flags,
+                       HIAHFileCloneStats *stats, char *error, size_t errorSize);
+
+/**
+ * Copies a file, symlink or directory tree to `destination`, which must not
+ * exist. Symlinks are copied as links, not followed.
+ *
+ * @return false with `error` set on failure; a partial copy may be left at
+ *         `destination` for the caller to remove
+ */
+bool HIAHFileCloneTree(const char *source, const char *destination, unsigned flags,
+                       HIAHFileCloneStats *stats, char *error, size_t errorSize);
+
+const char *HIAHFileCloneMethodName(HIAHFileCloneMethod method);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_FILE_CLONE_H */
@@ -0,0 +1,402 @@
+/**
+ * HIAHImagePool.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Warm pool of dlopen'd guest images.
+ *
+ * Images sit on one list in most-recently-used order. The pool lock is
+ * never held across dlopen() or dlclose(): both can run guest initializers
+ * and finalizers, which may spawn (and so re-enter the pool).
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHImagePool.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef __APPLE__
+#include <dispatch/dispatch.h>
+#endif
+
+#define HIAH_IMAGE_SYMBOL_SLOTS 8
+
+typedef struct {
+    char *name;
+    void *address;     // NULL caches a failed lookup
+} HIAHImageSymbolSlot;
+
+struct HIAHImage {
+    HIAHImage *prev;
+    HIAHImage *next;
+    char *path;
+    dev_t device;
+    ino_t inode;
+    time_t mtime;
+    off_t size;
+    void *handle;
+    unsigned refs;
+    bool detached;     // Off the list (replaced on disk); closed on last release
+    HIAHImageSymbolSlot symbols[HIAH_IMAGE_SYMBOL_SLOTS];
+    int symbolCount;
+};
+
+struct HIAHImagePool {
+    pthread_mutex_t lock;
+    HIAHImage *head;   // Most recently used
+    HIAHImage *tail;
+    size_t capacity;
+    size_t resident;
+    size_t inUse;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t failures;
+    uint64_t evictions;
+};
+
+// MARK: - Helpers
+
+static void HIAHImageCopyError(char *error, size_t errorSize, const char *message) {
+    if (error && errorSize > 0) {
+        snprintf(error, errorSize, "%s", message ? message : "unknown error");
+    }
+}
+
+static void HIAHImageFree(HIAHImage *image) {
+    for (int i = 0; i < image->symbolCount; i++) {
+        free(image->symbols[i].name);
+    }
+    free(image->path);
+    free(image);
+}
+
+// Closes a chain of images linked through `next`, outside the pool lock
+static void HIAHImageCloseChain(HIAHImage *image) {
+    while (image) {
+        HIAHImage *next = image->next;
+        dlclose(image->handle);
+        HIAHImageFree(image);
+        image = next;
+    }
+}
+
+static bool HIAHImageMatches(const HIAHImage *image, const struct stat *st) {
+    return image->device == st->st_dev && image->inode == st->st_ino &&
+           image->mtime == st->st_mtime && image->size == st->st_size;
+}
+
+// Caller holds the lock
+static void HIAHImagePoolUnlink(HIAHImagePool *pool, HIAHImage *image) {
+    if (image->prev) {
+        image->prev->next = image->next;
+    } else {
+        pool->head = image->next;
+    }
+    if (image->next) {
+        image->next->prev = image->prev;
+    } else {
+        pool->tail = image->prev;
+    }
+    image->prev = image->next = NULL;
+    pool->resident--;
+}
+
+// Caller holds the lock
+static void HIAHImagePoolPushFront(HIAHImagePool *pool, HIAHImage *image) {
+    image->prev = NULL;
+    image->next = pool->head;
+    if (pool->head) {
+        pool->head->prev = image;
+    } else {
+        pool->tail = image;
+    }
+    pool->head = image;
+    pool->resident++;
+}
+
+// Caller holds the lock. Moves idle images beyond `keep` onto a chain for
+// HIAHImageCloseChain.
+static HIAHImage *HIAHImagePoolCollectIdle(HIAHImagePool *pool, size_t keep,
+                                           size_t *count) {
+    size_t idle = pool->resident - pool->inUse;
+    HIAHImage *victims = NULL;
+    size_t collected = 0;
+
+    HIAHImage *image = pool->tail;
+    while (image && idle > keep) {
+        HIAHImage *prev = image->prev;
+        if (image->refs == 0) {
+            HIAHImagePoolUnlink(pool, image);
+            image->next = victims;
+            victims = image;
+            idle--;
+            collected++;
+        }
+        image = prev;
+    }
+    pool->evictions += collected;
+    if (count) {
+        *count = collected;
+    }
+    return victims;
+}
+
+// MARK: - Pool
+
+HIAHImagePool *HIAHImagePoolCreate(size_t capacity) {
+    HIAHImagePool *pool = calloc(1, sizeof(*pool));
+    if (!pool) {
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->capacity = capacity;
+    return pool;
+}
+
+void HIAHImagePoolDestroy(HIAHImagePool *pool) {
+    if (!pool) {
+        return;
+    }
+    HIAHImagePoolTrim(pool, 0);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+#ifdef __APPLE__
+static void HIAHImagePoolMemoryPressure(void *context) {
+    size_t closed = HIAHImagePoolTrim((HIAHImagePool *)context, 0);
+    if (closed > 0) {
+        fprintf(stderr, "[HIAHImagePool] Memory pressure: closed %zu idle images\n", closed);
+    }
+}
+#endif
+
+static HIAHImagePool *g_sharedPool;
+
+static void HIAHImagePoolCreateShared(void) {
+    g_sharedPool = HIAHImagePoolCreate(HIAH_IMAGE_POOL_DEFAULT_CAPACITY);
+#ifdef __APPLE__
+    dispatch_source_t source = dispatch_source_create(
+        DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+        DISPATCH_MEMORYPRESSURE_WARN | DISPATCH_MEMORYPRESSURE_CRITICAL,
+        dispatch_get_global_queue(QOS_CLASS_UTILITY, 0));
+    if (source) {
+        // Lives as long as the process, like the pool
+        dispatch_set_context(source, g_sharedPool);
+        dispatch_source_set_event_handler_f(source, HIAHImagePoolMemoryPressure);
+        dispatch_resume(source);
+    }
+#endif
+}
+
+HIAHImagePool *HIAHImagePoolShared(void) {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, HIAHImagePoolCreateShared);
+    return g_sharedPool;
+}
+
+HIAHImage *HIAHImagePoolAcquire(HIAHImagePool *pool, const char *path,
+                                char *error, size_t errorSize) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        HIAHImageCopyError(error, errorSize, strerror(errno));
+        return NULL;
+    }
+
+    HIAHImage *stale = NULL;
+    pthread_mutex_lock(&pool->lock);
+    for (HIAHImage *image = pool->head; image; image = image->next) {
+        if (strcmp(image->path, path) != 0) {
+            continue;
+        }
+        if (HIAHImageMatches(image, &st)) {
+            if (image->refs++ == 0) {
+                pool->inUse++;
+            }
+            if (image != pool->head) {
+                HIAHImagePoolUnlink(pool, image);
+                HIAHImagePoolPushFront(pool, image);
+            }
+            pool->hits++;
+            pthread_mutex_unlock(&pool->lock);
+            return image;
+        }
+        // Rebuilt on disk: retire the old image
+        HIAHImagePoolUnlink(pool, image);
+        if (image->refs == 0) {
+            stale = image;
+        } else {
+            image->detached = true;
+            pool->inUse--;
+        }
+        break;
+    }
+    pool->misses++;
+    pthread_mutex_unlock(&pool->lock);
+
+    HIAHImageCloseChain(stale);
+
+    void *handle = dlopen(path, RTLD_NOW | RTLD_GLOBAL);
+    if (!handle) {
+        HIAHImageCopyError(error, errorSize, dlerror());
+        pthread_mutex_lock(&pool->lock);
+        pool->failures++;
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+    }
+
+    HIAHImage *image = calloc(1, sizeof(*image));
+    char *pathCopy = strdup(path);
+    if (!image || !pathCopy) {
+        free(image);
+        free(pathCopy);
+        dlclose(handle);
+        HIAHImageCopyError(error, errorSize, "out of memory");
+        return NULL;
+    }
+    image->path = pathCopy;
+    image->device = st.st_dev;
+    image->inode = st.st_ino;
+    image->mtime = st.st_mtime;
+    image->size = st.st_size;
+    image->handle = handle;
+    image->refs = 1;
+
+    pthread_mutex_lock(&pool->lock);
+    // Another thread may have loaded the same image meanwhile; keep one entry
+    HIAHImage *existing = NULL;
+    for (HIAHImage *other = pool->head; other; other = other->next) {
+        if (strcmp(other->path, path) == 0 && HIAHImageMatches(other, &st)) {
+            existing = other;
+            break;
+        }
+    }
+    HIAHImage *victims = NULL;
+    if (existing) {
+        if (existing->refs++ == 0) {
+            pool->inUse++;
+        }
+        image->next = NULL;
+        victims = image;   // Our duplicate handle only drops a dlopen() count
+        image = existing;
+    } else {
+        HIAHImagePoolPushFront(pool, image);
+        pool->inUse++;
+        HIAHImage *evicted = HIAHImagePoolCollectIdle(pool, pool->capacity, NULL);
+        victims = evicted;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    HIAHImageCloseChain(victims);
+    return image;
+}
+
+void HIAHImagePoolRelease(HIAHImagePool *pool, HIAHImage *image) {
+    if (!image) {
+        return;
+    }
+    HIAHImage *victims = NULL;
+    pthread_mutex_lock(&pool->lock);
+    if (--image->refs == 0) {
+        if (image->detached) {
+            victims = image;
+        } else {
+            pool->inUse--;
+            victims = HIAHImagePoolCollectIdle(pool, pool->capacity, NULL);
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    HIAHImageCloseChain(victims);
+}
+
+bool HIAHImagePoolPreload(HIAHImagePool *pool, const char *path,
+                          char *error, size_t errorSize) {
+    HIAHImage *image = HIAHImagePoolAcquire(pool, path, error, errorSize);
+    if (!image) {
+        return false;
+    }
+    HIAHImagePoolRelease(pool, image);
+    return true;
+}
+
+size_t HIAHImagePoolTrim(HIAHImagePool *pool, size_t keep) {
+    size_t count = 0;
+    pthread_mutex_lock(&pool->lock);
+    HIAHImage *victims = HIAHImagePoolCollectIdle(pool, keep, &count);
+    pthread_mutex_unlock(&pool->lock);
+
+    HIAHImageCloseChain(victims);
+    return count;
+}
+
+void HIAHImagePoolGetStats(HIAHImagePool *pool, HIAHImagePoolStats *stats) {
+    pthread_mutex_lock(&pool->lock);
+    stats->hits = pool->hits;
+    stats->misses = pool->misses;
+    stats->failures = pool->failures;
+    stats->evictions = pool->evictions;
+    stats->resident = pool->resident;
+    stats->inUse = pool->inUse;
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// MARK: - Images
+
+void *HIAHImageHandle(HIAHImage *image) {
+    return image->handle;
+}
+
+void *HIAHImageSymbol(HIAHImagePool *pool, HIAHImage *image, const char *name) {
+    pthread_mutex_lock(&pool->lock);
+    for (int i = 0; i < image->symbolCount; i++) {
+        if (strcmp(image->symbols[i].name, name) == 0) {
+            void *address = image->symbols[i].address;
+            pthread_mutex_unlock(&pool->lock);
+            return address;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    // dlsym() does not run guest code, but keep the lock short anyway
+    void *address = dlsym(image->handle, name);
+
+    pthread_mutex_lock(&pool->lock);
+    if (image->symbolCount < HIAH_IMAGE_SYMBOL_SLOTS) {
+        bool cached = false;
+        for (int i = 0; i < image->symbolCount; i++) {
+            if (strcmp(image->symbols[i].name, name) == 0) {
+                cached = true;
+                break;
+            }
+        }
+        char *nameCopy = cached ? NULL : strdup(name);
+        if (nameCopy) {
+            image->symbols[image->symbolCount].name = nameCopy;
+            image->symbols[image->symbolCount].address = address;
+            image->symbolCount++;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return address;
+}
+
+void *HIAHImageFindEntry(HIAHImagePool *pool, HIAHImage *image,
+                         const char *const *names, const char **found) {
+    for (int i = 0; names[i]; i++) {
+        void *address = HIAHImageSymbol(pool, image, names[i]);
+        if (address) {
+            if (found) {
+                *found = names[i];
+            }
+            return address;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,126 @@
+/**
+ * HIAHImagePool.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Warm pool of dlopen'd guest images.
+ *
+ * In-process guests are images loaded with dlopen() and run through an
+ * entry point found with dlsym(). Shell pipelines spawn the same few tools
+ * over and over, so the pool keeps recently used images open together with
+ * their resolved symbols (including failed lookups). A warm spawn costs one
+ * stat() and a list walk instead of a load, bind and symbol search.
+ *
+ * Images are reference counted: spawns acquire an image for as long as the
+ * guest runs. Idle images beyond the pool's capacity are closed least
+ * recently used first, and all idle images are closed under memory pressure.
+ * An image whose file changed on disk is replaced on the next acquire.
+ *
+ * Plain C, no Apple-only dependencies (memory pressure is only watched where
+ * libdispatch reports it).
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_IMAGE_POOL_H
+#define HIAH_IMAGE_POOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Idle images kept open by the shared pool.
+ */
+#define HIAH_IMAGE_POOL_DEFAULT_CAPACITY 16
+
+typedef struct HIAHImagePool HIAHImagePool;
+typedef struct HIAHImage HIAHImage;
+
+typedef struct {
+    uint64_t hits;          // Acquires served from the pool
+    uint64_t misses;        // Acquires that had to dlopen()
+    uint64_t failures;      // dlopen() failures
+    uint64_t evictions;     // Idle images closed (capacity or memory pressure)
+    size_t resident;        // Images currently open
+    size_t inUse;           // Images with at least one reference
+} HIAHImagePoolStats;
+
+/**
+ * @param capacity Idle images to keep open (images in use never count
+ *                 against it and are never evicted)
+ */
+HIAHImagePool *HIAHImagePoolCreate(size_t capacity);
+
+/**
+ * Closes every image and frees the pool. Every acquired image must have
+ * been released.
+ */
+void HIAHImagePoolDestroy(HIAHImagePool *pool);
+
+/**
+ * Process-wide pool used by the kernel's spawn path and the guest hooks.
+ * Created on first use; it watches memory pressure where supported.
+ */
+HIAHImagePool *HIAHImagePoolShared(void);
+
+/**
+ * Returns the image at `path` with one reference, opening it on a miss.
+ *
+ * @param error Receives the dlopen() error on failure (may be NULL)
+ * @return NULL if the image cannot be loaded
+ */
+HIAHImage *HIAHImagePoolAcquire(HIAHImagePool *pool, const char *path,
+                                char *error, size_t errorSize);
+
+/**
+ * Drops a reference taken by HIAHImagePoolAcquire. The image stays warm
+ * until it is evicted.
+ */
+void HIAHImagePoolRelease(HIAHImagePool *pool, HIAHImage *image);
+
+/**
+ * Opens `path` ahead of its first spawn and leaves it idle in the pool.
+ */
+bool HIAHImagePoolPreload(HIAHImagePool *pool, const char *path,
+                          char *error, size_t errorSize);
+
+/**
+ * Closes idle images, least recently used first, until at most `keep` are
+ * left. HIAHImagePoolTrim(pool, 0) is the memory-pressure response.
+ *
+ * @return Number of images closed
+ */
+size_t HIAHImagePoolTrim(HIAHImagePool *pool, size_t keep);
+
+void HIAHImagePoolGetStats(HIAHImagePool *pool, HIAHImagePoolStats *stats);
+
+// MARK: - Images
+
+/**
+ * @return The dlopen() handle of an acquired image
+ */
+void *HIAHImageHandle(HIAHImage *image);
+
+/**
+ * dlsym() with a per-image cache; misses are cached too.
+ */
+void *HIAHImageSymbol(HIAHImagePool *pool, HIAHImage *image, const char *name);
+
+/**
+ * Returns the first of `names` (NULL-terminated) the image exports.
+ *
+ * @param found Receives the matching name (may be NULL)
+ */
+void *HIAHImageFindEntry(HIAHImagePool *pool, HIAHImage *image,
+                         const char *const *names, const char **found);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_IMAGE_POOL_H */
@@ -0,0 +1,133 @@
+/**
+ * HIAHMachOFormat.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Mach-O layout constants and field readers shared by the loader, the hook
+ * scanners and their benchmarks.
+ *
+ * The values are those of <mach-o/loader.h>, <mach-o/fat.h> and
+ * <mach-o/nlist.h>, which Linux does not have. Fields are read and written
+ * with memcpy, so any alignment is fine; `swapped` is set for slices in the
+ * other byte order, and fat headers are always big-endian.
+ *
+ * Internal to HIAHKernel. Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_MACHO_FORMAT_H
+#define HIAH_MACHO_FORMAT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// MARK: - Magics
+
+#define HIAH_MACHO_MAGIC    0xfeedfaceu
+#define HIAH_MACHO_CIGAM    0xcefaedfeu
+#define HIAH_MACHO_MAGIC_64 0xfeedfacfu
+#define HIAH_MACHO_CIGAM_64 0xcffaedfeu
+#define HIAH_FAT_MAGIC      0xcafebabeu    // Big-endian on disk
+#define HIAH_FAT_MAGIC_64   0xcafebabfu    // Big-endian on disk
+
+// MARK: - Headers
+
+#define HIAH_MACHO_HEADER_SIZE    28
+#define HIAH_MACHO_HEADER_SIZE_64 32
+#define HIAH_FAT_HEADER_SIZE      8
+#define HIAH_FAT_ARCH_SIZE        20
+#define HIAH_FAT_ARCH_SIZE_64     32
+
+// mach_header fields
+#define HIAH_MH_CPUTYPE    4
+#define HIAH_MH_FILETYPE   12
+#define HIAH_MH_NCMDS      16
+#define HIAH_MH_SIZEOFCMDS 20
+
+// Values of mach_header.filetype
+#define HIAH_MACHO_FILETYPE_EXECUTE 0x2
+#define HIAH_MACHO_FILETYPE_DYLIB   0x6
+#define HIAH_MACHO_FILETYPE_BUNDLE  0x8
+
+#define HIAH_CPU_ARCH_MASK  0xff000000u
+#define HIAH_CPU_ARCH_ABI64 0x01000000u
+#define HIAH_CPU_TYPE_ARM   12
+
+// MARK: - Load Commands
+
+#define HIAH_LC_SEGMENT_32        0x1u    // HIAHHook.h has HIAH_LC_SEGMENT, the native width
+#define HIAH_LC_SYMTAB            0x2u
+#define HIAH_LC_DYSYMTAB          0xbu
+#define HIAH_LC_LOAD_DYLIB        0xcu
+#define HIAH_LC_SEGMENT_64        0x19u
+#define HIAH_LC_CODE_SIGNATURE    0x1du
+#define HIAH_LC_LAZY_LOAD_DYLIB   0x20u
+#define HIAH_LC_LOAD_WEAK_DYLIB   0x80000018u
+#define HIAH_LC_REEXPORT_DYLIB    0x8000001fu
+#define HIAH_LC_LOAD_UPWARD_DYLIB 0x80000023u
+
+// Section flags
+#define HIAH_SECTION_TYPE               0x000000ffu
+#define HIAH_S_REGULAR                  0x0u
+#define HIAH_S_NON_LAZY_SYMBOL_POINTERS 0x6u
+#define HIAH_S_LAZY_SYMBOL_POINTERS     0x7u
+
+// Indirect symbol table entries that name no symbol
+#define HIAH_INDIRECT_SYMBOL_LOCAL 0x80000000u
+#define HIAH_INDIRECT_SYMBOL_ABS   0x40000000u
+
+// MARK: - Field Access
+
+static inline uint32_t HIAHRead32(const uint8_t *p, bool swapped) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return swapped ? __builtin_bswap32(value) : value;
+}
+
+static inline uint64_t HIAHRead64(const uint8_t *p, bool swapped) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return swapped ? __builtin_bswap64(value) : value;
+}
+
+static inline void HIAHWrite32(uint8_t *p, uint32_t value, bool swapped) {
+    value = swapped ? __builtin_bswap32(value) : value;
+    memcpy(p, &value, sizeof(value));
+}
+
+static inline void HIAHWrite64(uint8_t *p, uint64_t value, bool swapped) {
+    value = swapped ? __builtin_bswap64(value) : value;
+    memcpy(p, &value, sizeof(value));
+}
+
+static inline uint32_t HIAHReadBig32(const uint8_t *p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline uint64_t HIAHReadBig64(const uint8_t *p) {
+    return ((uint64_t)HIAHReadBig32(p) << 32) | HIAHReadBig32(p + 4);
+}
+
+static inline void HIAHWriteBig32(uint8_t *p, uint32_t value) {
+    p[0] = (uint8_t)(value >> 24);
+    p[1] = (uint8_t)(value >> 16);
+    p[2] = (uint8_t)(value >> 8);
+    p[3] = (uint8_t)value;
+}
+
+static inline void HIAHWriteBig64(uint8_t *p, uint64_t value) {
+    HIAHWriteBig32(p, (uint32_t)(value >> 32));
+    HIAHWriteBig32(p + 4, (uint32_t)value);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_MACHO_FORMAT_H */
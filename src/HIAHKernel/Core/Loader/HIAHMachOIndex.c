@@ -0,0 +1,835 @@
+/**
+ * HIAHMachOIndex.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Persistent index of Mach-O metadata for installed binaries.
+ *
+ * Binaries are mapped read-only to be scanned, so only the header pages and
+ * the start of the code signature are ever read from disk. Records live in a
+ * chained hash table keyed by path, behind one lock; binaries are scanned
+ * outside it.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHMachOIndex.h"
+#include "HIAHMachOFormat.h"
+#include "HIAHMachOTransform.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#define HIAH_STAT_MTIME(st) ((st)->st_mtimespec)
+#else
+#define HIAH_STAT_MTIME(st) ((st)->st_mtim)
+#endif
+
+#define HIAH_MACHO_INDEX_MAGIC      0x58444948u    // "HIDX"; a foreign byte order fails the check
+#define HIAH_MACHO_INDEX_VERSION    1
+#define HIAH_MACHO_INDEX_MAX_FILE   (256u << 20)
+#define HIAH_MACHO_INDEX_MAX_RECORD (1u << 20)
+#define HIAH_MACHO_INDEX_BUCKETS    64             // Initial; doubles as records are added
+
+#define HIAH_CSMAGIC_EMBEDDED_SIGNATURE    0xfade0cc0u
+#define HIAH_CSMAGIC_EMBEDDED_ENTITLEMENTS 0xfade7171u
+#define HIAH_CSSLOT_ENTITLEMENTS           5
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t reserved;
+    uint64_t length;    // Bytes of records after the header
+} HIAHMachOIndexFileHeader;
+
+typedef struct HIAHMachOIndexEntry {
+    struct HIAHMachOIndexEntry *next;
+    uint64_t hash;
+    HIAHMachOImageInfo *info;
+} HIAHMachOIndexEntry;
+
+struct HIAHMachOIndex {
+    pthread_mutex_t lock;
+    pthread_mutex_t saveLock;     // One save at a time, so the newest lands last
+    char *path;
+    HIAHMachOIndexEntry **buckets;
+    size_t bucketCount;           // A power of two
+    size_t count;
+    uint64_t generation;          // Bumped by every change
+    uint64_t savedGeneration;     // What the file on disk holds
+    uint64_t hits;
+    uint64_t scans;
+    uint64_t stale;
+};
+
+static void HIAHMachOIndexError(char *error, size_t errorSize, const char *format, ...) {
+    if (!error || errorSize == 0) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vsnprintf(error, errorSize, format, args);
+    va_end(args);
+}
+
+static uint64_t HIAHMachOIndexHash(const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static bool HIAHMachOIsDylibCommand(uint32_t type) {
+    return type == HIAH_LC_LOAD_DYLIB || type == HIAH_LC_LOAD_WEAK_DYLIB ||
+           type == HIAH_LC_REEXPORT_DYLIB || type == HIAH_LC_LAZY_LOAD_DYLIB ||
+           type == HIAH_LC_LOAD_UPWARD_DYLIB;
+}
+
+static void HIAHMachOIdentityFromStat(const struct stat *st, HIAHMachOFileIdentity *identity) {
+    memset(identity, 0, sizeof(*identity));
+    identity->device = (uint64_t)st->st_dev;
+    identity->inode = (uint64_t)st->st_ino;
+    identity->size = (uint64_t)st->st_size;
+    identity->mtimeSeconds = (int64_t)HIAH_STAT_MTIME(st).tv_sec;
+    identity->mtimeNanoseconds = (int64_t)HIAH_STAT_MTIME(st).tv_nsec;
+}
+
+static bool HIAHMachOSameIdentity(const HIAHMachOFileIdentity *a, const HIAHMachOFileIdentity *b) {
+    return a->device == b->device && a->inode == b->inode && a->size == b->size &&
+           a->mtimeSeconds == b->mtimeSeconds && a->mtimeNanoseconds == b->mtimeNanoseconds;
+}
+
+// MARK: - Record Building
+
+typedef struct {
+    uint8_t *data;
+    size_t length;
+    size_t capacity;
+} HIAHMachOIndexBuilder;
+
+#define HIAH_BUILDER_SLICE(builder, i) \
+    ((HIAHMachOSliceInfo *)((builder)->data + sizeof(HIAHMachOImageInfo)) + (i))
+
+/**
+ * Appends `bytes` zeroed bytes, rounded up to 8.
+ *
+ * @return Their offset in the record, or 0 if the record would grow too big
+ */
+static uint32_t HIAHMachOBuilderReserve(HIAHMachOIndexBuilder *builder, size_t bytes) {
+    size_t rounded = (bytes + 7) & ~(size_t)7;
+    if (rounded > HIAH_MACHO_INDEX_MAX_RECORD - builder->length) {
+        return 0;
+    }
+    if (builder->length + rounded > builder->capacity) {
+        size_t capacity = builder->capacity ? builder->capacity : 1024;
+        while (capacity < builder->length + rounded) {
+            capacity *= 2;
+        }
+        uint8_t *data = realloc(builder->data, capacity);
+        if (!data) {
+            return 0;
+        }
+        builder->data = data;
+        builder->capacity = capacity;
+    }
+    uint32_t offset = (uint32_t)builder->length;
+    memset(builder->data + offset, 0, rounded);
+    builder->length += rounded;
+    return offset;
+}
+
+/**
+ * Hashes the entitlements blob of an embedded signature.
+ */
+static uint64_t HIAHMachOEntitlementsHash(const uint8_t *slice, uint64_t sliceSize,
+                                          uint32_t dataoff, uint32_t datasize) {
+    if (datasize < 12 || dataoff > sliceSize || datasize > sliceSize - dataoff) {
+        return 0;
+    }
+    const uint8_t *blob = slice + dataoff;
+    if (HIAHReadBig32(blob) != HIAH_CSMAGIC_EMBEDDED_SIGNATURE) {
+        return 0;
+    }
+    uint32_t length = HIAHReadBig32(blob + 4);
+    if (length > datasize || length < 12) {
+        length = datasize;
+    }
+    uint32_t count = HIAHReadBig32(blob + 8);
+    if (count > (length - 12) / 8) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        if (HIAHReadBig32(blob + 12 + i * 8) != HIAH_CSSLOT_ENTITLEMENTS) {
+            continue;
+        }
+        uint32_t offset = HIAHReadBig32(blob + 16 + i * 8);
+        if (offset > length - 8 || HIAHReadBig32(blob + offset) != HIAH_CSMAGIC_EMBEDDED_ENTITLEMENTS) {
+            return 0;
+        }
+        uint32_t entitlementsLength = HIAHReadBig32(blob + offset + 4);
+        if (entitlementsLength < 8 || entitlementsLength > length - offset) {
+            return 0;
+        }
+        uint64_t hash = HIAHMachOIndexHash(blob + offset, entitlementsLength);
+        return hash ? hash : 1;
+    }
+    return 0;
+}
+
+/**
+ * Records one slice: its header, segments, linked dylibs and signature.
+ * A slice that does not parse keeps filetype 0 and nothing else.
+ *
+ * @return false if the record would grow too big or memory runs out
+ */
+static bool HIAHMachOScanSlice(HIAHMachOIndexBuilder *builder, uint32_t index,
+                               const uint8_t *base, uint64_t size) {
+    if (size < HIAH_MACHO_HEADER_SIZE) {
+        return true;
+    }
+    uint32_t magic;
+    memcpy(&magic, base, sizeof(magic));
+    bool is64 = magic == HIAH_MACHO_MAGIC_64 || magic == HIAH_MACHO_CIGAM_64;
+    bool swapped = magic == HIAH_MACHO_CIGAM || magic == HIAH_MACHO_CIGAM_64;
+    if (!is64 && magic != HIAH_MACHO_MAGIC && magic != HIAH_MACHO_CIGAM) {
+        return true;
+    }
+    uint32_t headerSize = is64 ? HIAH_MACHO_HEADER_SIZE_64 : HIAH_MACHO_HEADER_SIZE;
+    uint32_t ncmds = HIAHRead32(base + 16, swapped);
+    uint32_t sizeofcmds = HIAHRead32(base + 20, swapped);
+    if (size < headerSize || sizeofcmds > size - headerSize) {
+        return true;
+    }
+
+    // First pass: check the commands and size what they contribute
+    uint32_t segments = 0, dylibs = 0;
+    size_t names = 0;
+    const uint8_t *cmd = base + headerSize;
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < ncmds; i++) {
+        if (sizeofcmds - used < 8) {
+            return true;
+        }
+        uint32_t type = HIAHRead32(cmd, swapped);
+        uint32_t cmdsize = HIAHRead32(cmd + 4, swapped);
+        if (cmdsize < 8 || cmdsize > sizeofcmds - used) {
+            return true;
+        }
+        if ((type == HIAH_LC_SEGMENT_64 && cmdsize >= 72) || (type == HIAH_LC_SEGMENT_32 && cmdsize >= 56)) {
+            segments++;
+        } else if (HIAHMachOIsDylibCommand(type) && cmdsize >= 24) {
+            uint32_t nameOffset = HIAHRead32(cmd + 8, swapped);
+            if (nameOffset >= 24 && nameOffset < cmdsize) {
+                dylibs++;
+                names += strnlen((const char *)cmd + nameOffset, cmdsize - nameOffset) + 1;
+            }
+        }
+        cmd += cmdsize;
+        used += cmdsize;
+    }
+
+    uint32_t segmentsOffset = 0, dylibsOffset = 0, namesOffset = 0;
+    if (segments && !(segmentsOffset = HIAHMachOBuilderReserve(builder, segments * sizeof(HIAHMachOSegmentInfo)))) {
+        return false;
+    }
+    if (dylibs && (!(dylibsOffset = HIAHMachOBuilderReserve(builder, dylibs * sizeof(uint32_t))) ||
+                   !(namesOffset = HIAHMachOBuilderReserve(builder, names)))) {
+        return false;
+    }
+
+    HIAHMachOSliceInfo *info = HIAH_BUILDER_SLICE(builder, index);
+    info->cputype = HIAHRead32(base + 4, swapped);
+    info->cpusubtype = HIAHRead32(base + 8, swapped);
+    info->filetype = HIAHRead32(base + 12, swapped);
+    info->flags = HIAHRead32(base + 24, swapped);
+    info->segmentsOffset = segmentsOffset;
+    info->segmentCount = segments;
+    info->dylibsOffset = dylibsOffset;
+    info->dylibCount = dylibs;
+
+    // Second pass: fill them in
+    HIAHMachOSegmentInfo *segment = (HIAHMachOSegmentInfo *)(builder->data + segmentsOffset);
+    uint8_t *dylibOffsets = builder->data + dylibsOffset;
+    cmd = base + headerSize;
+    for (uint32_t i = 0; i < ncmds; i++) {
+        uint32_t type = HIAHRead32(cmd, swapped);
+        uint32_t cmdsize = HIAHRead32(cmd + 4, swapped);
+        bool segment64 = type == HIAH_LC_SEGMENT_64 && cmdsize >= 72;
+        bool segment32 = type == HIAH_LC_SEGMENT_32 && cmdsize >= 56;
+        if (segment64 || segment32) {
+            memcpy(segment->name, cmd + 8, sizeof(segment->name));
+            if (segment64) {
+                segment->vmaddr = HIAHRead64(cmd + 24, swapped);
+                segment->vmsize = HIAHRead64(cmd + 32, swapped);
+                segment->fileoff = HIAHRead64(cmd + 40, swapped);
+                segment->filesize = HIAHRead64(cmd + 48, swapped);
+                segment->maxprot = HIAHRead32(cmd + 56, swapped);
+                segment->initprot = HIAHRead32(cmd + 60, swapped);
+            } else {
+                segment->vmaddr = HIAHRead32(cmd + 24, swapped);
+                segment->vmsize = HIAHRead32(cmd + 28, swapped);
+                segment->fileoff = HIAHRead32(cmd + 32, swapped);
+                segment->filesize = HIAHRead32(cmd + 36, swapped);
+                segment->maxprot = HIAHRead32(cmd + 40, swapped);
+                segment->initprot = HIAHRead32(cmd + 44, swapped);
+            }
+            segment++;
+        } else if (HIAHMachOIsDylibCommand(type) && cmdsize >= 24) {
+            uint32_t nameOffset = HIAHRead32(cmd + 8, swapped);
+            if (nameOffset >= 24 && nameOffset < cmdsize) {
+                size_t nameLength = strnlen((const char *)cmd + nameOffset, cmdsize - nameOffset);
+                memcpy(builder->data + namesOffset, cmd + nameOffset, nameLength);
+                memcpy(dylibOffsets, &namesOffset, sizeof(namesOffset));
+                dylibOffsets += sizeof(uint32_t);
+                namesOffset += (uint32_t)nameLength + 1;
+            }
+        } else if (type == HIAH_LC_CODE_SIGNATURE && cmdsize >= 16) {
+            info->codeSignatureOffset = HIAHRead32(cmd + 8, swapped);
+            info->codeSignatureSize = HIAHRead32(cmd + 12, swapped);
+            info->entitlementsHash = HIAHMachOEntitlementsHash(base, size, info->codeSignatureOffset,
+                                                               info->codeSignatureSize);
+        }
+        cmd += cmdsize;
+    }
+    return true;
+}
+
+static HIAHMachOImageInfo *HIAHMachOScanFile(int fd, const struct stat *st, const char *path,
+                                             char *error, size_t errorSize) {
+    size_t length = (size_t)st->st_size;
+    const uint8_t *bytes = NULL;
+    if (length > 0) {
+        bytes = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (bytes == MAP_FAILED) {
+            HIAHMachOIndexError(error, errorSize, "mmap %s: %s", path, strerror(errno));
+            return NULL;
+        }
+    }
+
+    HIAHMachOSliceRange *ranges = NULL;
+    uint32_t count = 0;
+    if (length >= 4 && !HIAHMachOListSlices(bytes, length, &ranges, &count, NULL, 0)) {
+        count = 0;
+    }
+    if (count == 1 && ranges[0].offset == 0 && HIAHReadBig32(bytes) != HIAH_FAT_MAGIC &&
+        HIAHReadBig32(bytes) != HIAH_FAT_MAGIC_64) {
+        // Thin: only Mach-O files get a slice
+        uint32_t magic;
+        memcpy(&magic, bytes, sizeof(magic));
+        if (magic != HIAH_MACHO_MAGIC && magic != HIAH_MACHO_CIGAM &&
+            magic != HIAH_MACHO_MAGIC_64 && magic != HIAH_MACHO_CIGAM_64) {
+            count = 0;
+        }
+    }
+
+    // The header and slice table come first, at offset 0, so every later
+    // reservation has a nonzero offset
+    HIAHMachOIndexBuilder builder = {0};
+    size_t pathLength = strlen(path);
+    HIAHMachOBuilderReserve(&builder, sizeof(HIAHMachOImageInfo) + count * sizeof(HIAHMachOSliceInfo));
+    bool ok = builder.data != NULL;
+    for (uint32_t i = 0; ok && i < count; i++) {
+        HIAHMachOSliceInfo *slice = HIAH_BUILDER_SLICE(&builder, i);
+        slice->offset = ranges[i].offset;
+        slice->size = ranges[i].size;
+        ok = HIAHMachOScanSlice(&builder, i, bytes + ranges[i].offset, ranges[i].size);
+    }
+    uint32_t pathOffset = 0;
+    ok = ok && pathLength < HIAH_MACHO_INDEX_MAX_RECORD &&
+         (pathOffset = HIAHMachOBuilderReserve(&builder, pathLength + 1)) != 0;
+
+    free(ranges);
+    if (bytes) {
+        munmap((void *)bytes, length);
+    }
+    if (!ok) {
+        HIAHMachOIndexError(error, errorSize, "%s: record too large or out of memory", path);
+        free(builder.data);
+        return NULL;
+    }
+
+    memcpy(builder.data + pathOffset, path, pathLength);
+    HIAHMachOImageInfo *info = (HIAHMachOImageInfo *)builder.data;
+    info->length = (uint32_t)builder.length;
+    info->sliceCount = count;
+    info->pathOffset = pathOffset;
+    info->pathLength = (uint32_t)pathLength;
+    HIAHMachOIdentityFromStat(st, &info->identity);
+    return info;
+}
+
+// MARK: - Records
+
+HIAHMachOImageInfo *HIAHMachOImageInfoRead(const char *path, char *error, size_t errorSize) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        HIAHMachOIndexError(error, errorSize, "open %s: %s", path, strerror(errno));
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        HIAHMachOIndexError(error, errorSize, "%s is not a regular file", path);
+        close(fd);
+        return NULL;
+    }
+    HIAHMachOImageInfo *info = HIAHMachOScanFile(fd, &st, path, error, errorSize);
+    close(fd);
+    return info;
+}
+
+void HIAHMachOImageInfoFree(HIAHMachOImageInfo *info) {
+    free(info);
+}
+
+static HIAHMachOImageInfo *HIAHMachOImageInfoCopy(const HIAHMachOImageInfo *info) {
+    HIAHMachOImageInfo *copy = malloc(info->length);
+    if (copy) {
+        memcpy(copy, info, info->length);
+    }
+    return copy;
+}
+
+const char *HIAHMachOImageInfoPath(const HIAHMachOImageInfo *info) {
+    return (const char *)info + info->pathOffset;
+}
+
+const HIAHMachOSliceInfo *HIAHMachOImageInfoPrimarySlice(const HIAHMachOImageInfo *info) {
+    for (uint32_t i = 0; i < info->sliceCount; i++) {
+        if (info->slices[i].filetype != 0 && (info->slices[i].cputype & HIAH_CPU_ARCH_ABI64)) {
+            return &info->slices[i];
+        }
+    }
+    return NULL;
+}
+
+const HIAHMachOSegmentInfo *HIAHMachOSliceInfoSegments(const HIAHMachOImageInfo *info,
+                                                       const HIAHMachOSliceInfo *slice) {
+    if (slice->segmentCount == 0) {
+        return NULL;
+    }
+    return (const HIAHMachOSegmentInfo *)((const uint8_t *)info + slice->segmentsOffset);
+}
+
+const char *HIAHMachOSliceInfoDylib(const HIAHMachOImageInfo *info,
+                                    const HIAHMachOSliceInfo *slice, uint32_t index) {
+    if (index >= slice->dylibCount) {
+        return NULL;
+    }
+    uint32_t offset;
+    memcpy(&offset, (const uint8_t *)info + slice->dylibsOffset + index * sizeof(uint32_t), sizeof(offset));
+    return (const char *)info + offset;
+}
+
+static bool HIAHMachOStringValid(const HIAHMachOImageInfo *info, uint32_t offset) {
+    return offset >= sizeof(HIAHMachOImageInfo) && offset < info->length &&
+           memchr((const uint8_t *)info + offset, 0, info->length - offset) != NULL;
+}
+
+/**
+ * Checks a record read from disk, so the accessors never leave it.
+ */
+static bool HIAHMachOImageInfoValid(const HIAHMachOImageInfo *info, size_t available) {
+    if (available < sizeof(HIAHMachOImageInfo)) {
+        return false;
+    }
+    uint64_t length = info->length;
+    if (length < sizeof(HIAHMachOImageInfo) || length % 8 != 0 || length > available ||
+        info->sliceCount > (length - sizeof(HIAHMachOImageInfo)) / sizeof(HIAHMachOSliceInfo)) {
+        return false;
+    }
+    if (!HIAHMachOStringValid(info, info->pathOffset) ||
+        info->pathLength != strlen(HIAHMachOImageInfoPath(info))) {
+        return false;
+    }
+    for (uint32_t i = 0; i < info->sliceCount; i++) {
+        const HIAHMachOSliceInfo *slice = &info->slices[i];
+        if ((slice->segmentCount &&
+             (slice->segmentsOffset % 8 != 0 ||
+              slice->segmentsOffset + (uint64_t)slice->segmentCount * sizeof(HIAHMachOSegmentInfo) > length)) ||
+            (slice->dylibCount &&
+             (slice->dylibsOffset % 4 != 0 ||
+              slice->dylibsOffset + (uint64_t)slice->dylibCount * sizeof(uint32_t) > length))) {
+            return false;
+        }
+        for (uint32_t d = 0; d < slice->dylibCount; d++) {
+            uint32_t offset;
+            memcpy(&offset, (const uint8_t *)info + slice->dylibsOffset + d * sizeof(uint32_t), sizeof(offset));
+            if (!HIAHMachOStringValid(info, offset)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// MARK: - Table
+
+// Caller holds the lock
+static HIAHMachOIndexEntry **HIAHMachOIndexFind(HIAHMachOIndex *index, const char *path, uint64_t hash) {
+    HIAHMachOIndexEntry **link = &index->buckets[hash & (index->bucketCount - 1)];
+    for (; *link; link = &(*link)->next) {
+        if ((*link)->hash == hash && strcmp(HIAHMachOImageInfoPath((*link)->info), path) == 0) {
+            return link;
+        }
+    }
+    return link;
+}
+
+// Caller holds the lock. Takes ownership of `info`, replacing any record
+// for the same path.
+static bool HIAHMachOIndexStore(HIAHMachOIndex *index, HIAHMachOImageInfo *info) {
+    const char *path = HIAHMachOImageInfoPath(info);
+    uint64_t hash = HIAHMachOIndexHash(path, info->pathLength);
+    HIAHMachOIndexEntry **link = HIAHMachOIndexFind(index, path, hash);
+    index->generation++;
+    if (*link) {
+        free((*link)->info);
+        (*link)->info = info;
+        return true;
+    }
+
+    if (index->count >= index->bucketCount) {
+        size_t bucketCount = index->bucketCount * 2;
+        HIAHMachOIndexEntry **buckets = calloc(bucketCount, sizeof(*buckets));
+        if (buckets) {
+            for (size_t b = 0; b < index->bucketCount; b++) {
+                HIAHMachOIndexEntry *entry = index->buckets[b];
+                while (entry) {
+                    HIAHMachOIndexEntry *next = entry->next;
+                    entry->next = buckets[entry->hash & (bucketCount - 1)];
+                    buckets[entry->hash & (bucketCount - 1)] = entry;
+                    entry = next;
+                }
+            }
+            free(index->buckets);
+            index->buckets = buckets;
+            index->bucketCount = bucketCount;
+            link = HIAHMachOIndexFind(index, path, hash);
+        }
+    }
+
+    HIAHMachOIndexEntry *entry = malloc(sizeof(*entry));
+    if (!entry) {
+        free(info);
+        return false;
+    }
+    entry->next = NULL;
+    entry->hash = hash;
+    entry->info = info;
+    *link = entry;
+    index->count++;
+    return true;
+}
+
+// Caller holds the lock
+static void HIAHMachOIndexUnlink(HIAHMachOIndex *index, HIAHMachOIndexEntry **link) {
+    HIAHMachOIndexEntry *entry = *link;
+    *link = entry->next;
+    free(entry->info);
+    free(entry);
+    index->count--;
+    index->generation++;
+}
+
+// Caller holds the lock
+static void HIAHMachOIndexClear(HIAHMachOIndex *index) {
+    for (size_t b = 0; b < index->bucketCount; b++) {
+        while (index->buckets[b]) {
+            HIAHMachOIndexUnlink(index, &index->buckets[b]);
+        }
+    }
+}
+
+// MARK: - Persistence
+
+static void HIAHMachOIndexLoad(HIAHMachOIndex *index) {
+    int fd = open(index->path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    uint8_t *buffer = NULL;
+    size_t length = 0;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(HIAHMachOIndexFileHeader) &&
+        st.st_size <= HIAH_MACHO_INDEX_MAX_FILE && (buffer = malloc((size_t)st.st_size))) {
+        while (length < (size_t)st.st_size) {
+            ssize_t n = read(fd, buffer + length, (size_t)st.st_size - length);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                break;
+            }
+            length += (size_t)n;
+        }
+    }
+    close(fd);
+
+    HIAHMachOIndexFileHeader header;
+    bool ok = buffer && length == (size_t)st.st_size;
+    if (ok) {
+        memcpy(&header, buffer, sizeof(header));
+        ok = header.magic == HIAH_MACHO_INDEX_MAGIC && header.version == HIAH_MACHO_INDEX_VERSION &&
+             header.length == length - sizeof(header);
+    }
+
+    // Records are 8-byte multiples after a 24-byte header, so they stay
+    // aligned within the buffer
+    size_t offset = sizeof(header);
+    for (uint32_t i = 0; ok && i < header.count; i++) {
+        const HIAHMachOImageInfo *info = (const HIAHMachOImageInfo *)(buffer + offset);
+        HIAHMachOImageInfo *copy = NULL;
+        ok = HIAHMachOImageInfoValid(info, length - offset) && (copy = HIAHMachOImageInfoCopy(info)) &&
+             HIAHMachOIndexStore(index, copy);
+        if (ok) {
+            offset += info->length;
+        }
+    }
+    if (!ok || offset != length) {
+        // Damaged or from another version: start over, it is only a cache
+        HIAHMachOIndexClear(index);
+    }
+    free(buffer);
+    index->savedGeneration = index->generation;
+}
+
+static bool HIAHMachOIndexWriteAll(int fd, const uint8_t *data, size_t length) {
+    while (length > 0) {
+        ssize_t written = write(fd, data, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+    }
+    return true;
+}
+
+// MARK: - Index
+
+HIAHMachOIndex *HIAHMachOIndexCreate(const char *path) {
+    HIAHMachOIndex *index = calloc(1, sizeof(*index));
+    if (!index) {
+        return NULL;
+    }
+    index->path = strdup(path);
+    index->bucketCount = HIAH_MACHO_INDEX_BUCKETS;
+    index->buckets = calloc(index->bucketCount, sizeof(*index->buckets));
+    if (!index->path || !index->buckets) {
+        free(index->path);
+        free(index->buckets);
+        free(index);
+        return NULL;
+    }
+    pthread_mutex_init(&index->lock, NULL);
+    pthread_mutex_init(&index->saveLock, NULL);
+    HIAHMachOIndexLoad(index);
+    return index;
+}
+
+void HIAHMachOIndexDestroy(HIAHMachOIndex *index) {
+    if (!index) {
+        return;
+    }
+    HIAHMachOIndexClear(index);
+    pthread_mutex_destroy(&index->lock);
+    pthread_mutex_destroy(&index->saveLock);
+    free(index->buckets);
+    free(index->path);
+    free(index);
+}
+
+/**
+ * Reads `binaryPath` and stores its record.
+ *
+ * @return A copy of the new record, or NULL with `error` set
+ */
+static HIAHMachOImageInfo *HIAHMachOIndexScan(HIAHMachOIndex *index, const char *binaryPath,
+                                              char *error, size_t errorSize) {
+    HIAHMachOImageInfo *info = HIAHMachOImageInfoRead(binaryPath, error, errorSize);
+    HIAHMachOImageInfo *copy = info ? HIAHMachOImageInfoCopy(info) : NULL;
+    if (!copy) {
+        if (info) {
+            HIAHMachOIndexError(error, errorSize, "out of memory");
+        }
+        free(info);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&index->lock);
+    HIAHMachOIndexEntry **link = HIAHMachOIndexFind(index, binaryPath, HIAHMachOIndexHash(binaryPath, strlen(binaryPath)));
+    if (*link && !HIAHMachOSameIdentity(&(*link)->info->identity, &info->identity)) {
+        index->stale++;
+    }
+    index->scans++;
+    HIAHMachOIndexStore(index, info);
+    pthread_mutex_unlock(&index->lock);
+    return copy;
+}
+
+HIAHMachOImageInfo *HIAHMachOIndexLookup(HIAHMachOIndex *index, const char *binaryPath,
+                                         char *error, size_t errorSize) {
+    struct stat st;
+    if (stat(binaryPath, &st) != 0) {
+        HIAHMachOIndexError(error, errorSize, "stat %s: %s", binaryPath, strerror(errno));
+        return NULL;
+    }
+    HIAHMachOFileIdentity identity;
+    HIAHMachOIdentityFromStat(&st, &identity);
+
+    pthread_mutex_lock(&index->lock);
+    HIAHMachOIndexEntry *entry = *HIAHMachOIndexFind(index, binaryPath, HIAHMachOIndexHash(binaryPath, strlen(binaryPath)));
+    if (entry && HIAHMachOSameIdentity(&entry->info->identity, &identity)) {
+        HIAHMachOImageInfo *copy = HIAHMachOImageInfoCopy(entry->info);
+        index->hits++;
+        pthread_mutex_unlock(&index->lock);
+        if (!copy) {
+            HIAHMachOIndexError(error, errorSize, "out of memory");
+        }
+        return copy;
+    }
+    pthread_mutex_unlock(&index->lock);
+
+    // A change made while the binary is scanned moves its mtime again, so
+    // the record this stores is replaced on the next lookup
+    return HIAHMachOIndexScan(index, binaryPath, error, errorSize);
+}
+
+bool HIAHMachOIndexUpdate(HIAHMachOIndex *index, const char *binaryPath,
+                          char *error, size_t errorSize) {
+    HIAHMachOImageInfo *info = HIAHMachOIndexScan(index, binaryPath, error, errorSize);
+    free(info);
+    return info != NULL;
+}
+
+void HIAHMachOIndexRemove(HIAHMachOIndex *index, const char *binaryPath) {
+    pthread_mutex_lock(&index->lock);
+    HIAHMachOIndexEntry **link = HIAHMachOIndexFind(index, binaryPath, HIAHMachOIndexHash(binaryPath, strlen(binaryPath)));
+    if (*link) {
+        HIAHMachOIndexUnlink(index, link);
+    }
+    pthread_mutex_unlock(&index->lock);
+}
+
+size_t HIAHMachOIndexPrune(HIAHMachOIndex *index) {
+    size_t removed = 0;
+    pthread_mutex_lock(&index->lock);
+    for (size_t b = 0; b < index->bucketCount; b++) {
+        HIAHMachOIndexEntry **link = &index->buckets[b];
+        while (*link) {
+            struct stat st;
+            if (stat(HIAHMachOImageInfoPath((*link)->info), &st) != 0 && errno == ENOENT) {
+                HIAHMachOIndexUnlink(index, link);
+                removed++;
+            } else {
+                link = &(*link)->next;
+            }
+        }
+    }
+    pthread_mutex_unlock(&index->lock);
+    return removed;
+}
+
+bool HIAHMachOIndexSave(HIAHMachOIndex *index, char *error, size_t errorSize) {
+    // Saves from several threads would otherwise race to rename, and an
+    // older snapshot could replace a newer one
+    pthread_mutex_lock(&index->saveLock);
+    pthread_mutex_lock(&index->lock);
+    if (index->generation == index->savedGeneration) {
+        pthread_mutex_unlock(&index->lock);
+        pthread_mutex_unlock(&index->saveLock);
+        return true;
+    }
+    uint64_t generation = index->generation;
+    HIAHMachOIndexFileHeader header = {
+        .magic = HIAH_MACHO_INDEX_MAGIC,
+        .version = HIAH_MACHO_INDEX_VERSION,
+        .count = (uint32_t)index->count,
+    };
+    for (size_t b = 0; b < index->bucketCount; b++) {
+        for (HIAHMachOIndexEntry *entry = index->buckets[b]; entry; entry = entry->next) {
+            header.length += entry->info->length;
+        }
+    }
+    uint8_t *buffer = malloc(sizeof(header) + header.length);
+    if (buffer) {
+        uint8_t *cursor = buffer + sizeof(header);
+        for (size_t b = 0; b < index->bucketCount; b++) {
+            for (HIAHMachOIndexEntry *entry = index->buckets[b]; entry; entry = entry->next) {
+                memcpy(cursor, entry->info, entry->info->length);
+                cursor += entry->info->length;
+            }
+        }
+        memcpy(buffer, &header, sizeof(header));
+    }
+    pthread_mutex_unlock(&index->lock);
+    if (!buffer) {
+        pthread_mutex_unlock(&index->saveLock);
+        HIAHMachOIndexError(error, errorSize, "out of memory");
+        return false;
+    }
+
+    // A name of its own, so other processes saving the same file never
+    // write into it
+    size_t pathLength = strlen(index->path) + sizeof(".XXXXXX");
+    char *temporary = malloc(pathLength);
+    bool ok = temporary != NULL;
+    if (ok) {
+        snprintf(temporary, pathLength, "%s.XXXXXX", index->path);
+        int fd = mkstemp(temporary);
+        if (fd >= 0) {
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+        ok = fd >= 0 && fchmod(fd, 0644) == 0 &&
+             HIAHMachOIndexWriteAll(fd, buffer, sizeof(header) + header.length);
+        if (fd >= 0 && close(fd) != 0) {
+            ok = false;
+        }
+        if (ok && rename(temporary, index->path) != 0) {
+            ok = false;
+        }
+        if (!ok) {
+            HIAHMachOIndexError(error, errorSize, "write %s: %s", index->path, strerror(errno));
+            if (fd >= 0) {
+                unlink(temporary);
+            }
+        }
+    } else {
+        HIAHMachOIndexError(error, errorSize, "out of memory");
+    }
+    free(temporary);
+    free(buffer);
+
+    if (ok) {
+        pthread_mutex_lock(&index->lock);
+        if (generation > index->savedGeneration) {
+            index->savedGeneration = generation;
+        }
+        pthread_mutex_unlock(&index->lock);
+    }
+    pthread_mutex_unlock(&index->saveLock);
+    return ok;
+}
+
+void HIAHMachOIndexGetStats(HIAHMachOIndex *index, HIAHMachOIndexStats *stats) {
+    pthread_mutex_lock(&index->lock);
+    stats->hits = index->hits;
+    stats->scans = index->scans;
+    stats->stale = index->stale;
+    stats->records = index->count;
+    pthread_mutex_unlock(&index->lock);
+}
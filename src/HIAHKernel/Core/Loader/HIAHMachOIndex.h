@@ -0,0 +1,191 @@
+/**
+ * HIAHMachOIndex.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Persistent index of Mach-O metadata for installed binaries.
+ *
+ * Launching a guest, listing apps on the Desktop and deciding whether a
+ * binary needs patching all want the same few facts from its headers:
+ * filetype and CPU of each slice, the segment table, where the code
+ * signature lies, which dylibs it links and whether its entitlements
+ * changed. Reading them means opening and mapping the binary and walking
+ * its load commands every time. The index keeps one compact record per
+ * binary instead, built at install time or on first use, so a query costs
+ * one stat() and a hash table lookup.
+ *
+ * Records are keyed by path and remember the file's identity (device,
+ * inode, size, mtime). A lookup whose identity no longer matches rescans
+ * the binary, so a reinstalled or patched file is never served stale.
+ * Files that are not Mach-O get a record without slices, so asking about
+ * them again is just as cheap.
+ *
+ * A record is one flat block: the slice table, then each slice's segments
+ * and dylib names, then the path, all addressed by offsets from the start
+ * of the record. The same bytes are kept in memory, returned to callers
+ * and written to disk, so loading and copying never parse anything. The
+ * file is replaced atomically on save, one save at a time, from a temporary
+ * file of its own; processes sharing it may lose each other's recent
+ * records, which only costs a rescan.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_MACHO_INDEX_H
+#define HIAH_MACHO_INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct HIAHMachOIndex HIAHMachOIndex;
+
+typedef struct {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    int64_t mtimeSeconds;
+    int64_t mtimeNanoseconds;
+} HIAHMachOFileIdentity;
+
+typedef struct {
+    char name[16];          // Not NUL-terminated when 16 characters long
+    uint64_t vmaddr;
+    uint64_t vmsize;
+    uint64_t fileoff;       // Within the slice
+    uint64_t filesize;
+    uint32_t maxprot;
+    uint32_t initprot;
+} HIAHMachOSegmentInfo;
+
+typedef struct {
+    uint64_t offset;                 // Slice within the file
+    uint64_t size;
+    uint64_t entitlementsHash;       // FNV-1a of the entitlements blob, 0 if none
+    uint32_t cputype;                // From the Mach-O header
+    uint32_t cpusubtype;
+    uint32_t filetype;               // 0 if the slice is not a valid Mach-O
+    uint32_t flags;                  // mach_header.flags
+    uint32_t codeSignatureOffset;    // LC_CODE_SIGNATURE dataoff within the slice;
+    uint32_t codeSignatureSize;      // both 0 if unsigned
+    uint32_t segmentsOffset;         // HIAHMachOSegmentInfo[segmentCount]
+    uint32_t segmentCount;
+    uint32_t dylibsOffset;           // uint32_t[dylibCount], each a string offset
+    uint32_t dylibCount;
+} HIAHMachOSliceInfo;
+
+/**
+ * Everything the index knows about one binary. All offsets are from the
+ * start of the record; use the accessors below rather than following them.
+ */
+typedef struct {
+    uint32_t length;        // Whole record, a multiple of 8
+    uint32_t sliceCount;    // 0: not a Mach-O file
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    HIAHMachOFileIdentity identity;
+    HIAHMachOSliceInfo slices[];
+} HIAHMachOImageInfo;
+
+typedef struct {
+    uint64_t hits;          // Lookups answered from a record
+    uint64_t scans;         // Binaries read: unknown, changed or updated
+    uint64_t stale;         // Records replaced because the file changed
+    size_t records;
+} HIAHMachOIndexStats;
+
+// MARK: - Records
+
+/**
+ * Reads the metadata of the binary at `path`, without an index. Only the
+ * header pages and the code signature's index and entitlements are touched.
+ *
+ * @return The record (free with HIAHMachOImageInfoFree()), or NULL with
+ *         `error` set if the file cannot be read. A file that is not
+ *         Mach-O, or is malformed, still gets a record without slices.
+ */
+HIAHMachOImageInfo *HIAHMachOImageInfoRead(const char *path, char *error, size_t errorSize);
+
+void HIAHMachOImageInfoFree(HIAHMachOImageInfo *info);
+
+const char *HIAHMachOImageInfoPath(const HIAHMachOImageInfo *info);
+
+/**
+ * @return The first 64-bit slice, the one dyld picks on arm64 and x86_64,
+ *         or NULL if there is none
+ */
+const HIAHMachOSliceInfo *HIAHMachOImageInfoPrimarySlice(const HIAHMachOImageInfo *info);
+
+const HIAHMachOSegmentInfo *HIAHMachOSliceInfoSegments(const HIAHMachOImageInfo *info,
+                                                       const HIAHMachOSliceInfo *slice);
+
+/**
+ * @return Install name of the slice's `index`th linked dylib, in load
+ *         command order
+ */
+const char *HIAHMachOSliceInfoDylib(const HIAHMachOImageInfo *info,
+                                    const HIAHMachOSliceInfo *slice, uint32_t index);
+
+// MARK: - Index
+
+/**
+ * Opens the index stored at `path`. A missing, unreadable or outdated file
+ * gives an empty index, which is written to `path` on the first save.
+ *
+ * @return NULL only if memory runs out
+ */
+HIAHMachOIndex *HIAHMachOIndexCreate(const char *path);
+
+/**
+ * Frees the index without saving it.
+ */
+void HIAHMachOIndexDestroy(HIAHMachOIndex *index);
+
+/**
+ * Returns the record of `binaryPath`, reading the binary only if it is not
+ * indexed yet or has changed since.
+ *
+ * @return A copy of the record (free with HIAHMachOImageInfoFree()), or
+ *         NULL with `error` set if the file cannot be read
+ */
+HIAHMachOImageInfo *HIAHMachOIndexLookup(HIAHMachOIndex *index, const char *binaryPath,
+                                         char *error, size_t errorSize);
+
+/**
+ * Reads `binaryPath` again and replaces its record, as an install does
+ * after writing the binary.
+ */
+bool HIAHMachOIndexUpdate(HIAHMachOIndex *index, const char *binaryPath,
+                          char *error, size_t errorSize);
+
+/**
+ * Forgets `binaryPath`.
+ */
+void HIAHMachOIndexRemove(HIAHMachOIndex *index, const char *binaryPath);
+
+/**
+ * Forgets every binary that no longer exists.
+ *
+ * @return Number of records removed
+ */
+size_t HIAHMachOIndexPrune(HIAHMachOIndex *index);
+
+/**
+ * Writes the index back if it changed since it was loaded or last saved.
+ * The file is replaced atomically.
+ */
+bool HIAHMachOIndexSave(HIAHMachOIndex *index, char *error, size_t errorSize);
+
+void HIAHMachOIndexGetStats(HIAHMachOIndex *index, HIAHMachOIndexStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_MACHO_INDEX_H */
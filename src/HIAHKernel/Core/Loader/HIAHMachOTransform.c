@@ -0,0 +1,826 @@
+/**
+ * HIAHMachOTransform.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Single-pass Mach-O header edits.
+ *
+ * Each slice's header and load command area is copied into a scratch
+ * buffer and the edits run there. Only once every slice has been edited
+ * successfully are the buffers copied back, and only the span that differs
+ * from the original counts as changed.
+ *
+ * Slices are validated one after another, which only walks their load
+ * commands, then edited on the worker pool if their scratch areas are big
+ * enough to be worth the threads. Each slice keeps its own error and
+ * counts, and they are merged in slice order, so results do not depend on
+ * scheduling.
+ *
+ * Removing a signature that ends its slice also shortens the slice. The
+ * slices are then laid out again: each moves down behind the previous one,
+ * as far as its fat alignment allows, the fat header is rewritten to match
+ * and the file is cut after the last slice.
+ *
+ * A file is edited through a clone next to it, with the same write-back:
+ * moved slices are copied down within the clone, which is then cut,
+ * synced and renamed over the original.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHMachOTransform.h"
+#include "HIAHFileClone.h"
+#include "HIAHMachOFormat.h"
+#include "HIAHWorkerPool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define HIAH_ARM64_PAGE_SIZE    0x4000u
+#define HIAH_DEFAULT_PAGE_SIZE  0x1000u
+
+#define HIAH_MOVE_CHUNK (1u << 20)
+
+// Scratch bytes across all slices below which they are edited on the
+// calling thread. Typical headers are a few KB, where starting workers
+// would cost more than the edits.
+#define HIAH_MACHO_PARALLEL_AREA (1u << 20)
+
+typedef struct {
+    size_t offset;        // In the file
+    size_t length;
+    uint32_t cputype;     // From the fat header, or 0
+    uint32_t cpusubtype;
+    uint32_t align;       // Power of two, from the fat header
+    size_t newLength;     // Without a signature cut off its end
+    size_t newOffset;     // Where the slice goes once earlier ones shrank
+    bool is64;
+    bool swapped;
+    uint32_t headerSize;
+    uint32_t commandSpace;    // Bytes before the first section's data
+    uint8_t *scratch;         // Header and load command area being edited
+    size_t changedStart;      // Within the slice; empty when start == end
+    size_t changedEnd;
+    bool failed;
+    bool changed;
+    uint32_t applied[HIAHMachOEditKindCount];
+    char error[192];
+} HIAHMachOSlice;
+
+static void HIAHMachOError(char *error, size_t errorSize, const char *format, ...) {
+    if (!error || errorSize == 0) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vsnprintf(error, errorSize, format, args);
+    va_end(args);
+}
+
+// MARK: - Parsing
+
+/**
+ * Checks the slice's header and load commands and measures the room the
+ * load commands may grow into.
+ */
+static bool HIAHMachOParseSlice(const uint8_t *bytes, HIAHMachOSlice *slice,
+                                char *error, size_t errorSize) {
+    const uint8_t *base = bytes + slice->offset;
+    if (slice->length < HIAH_MACHO_HEADER_SIZE) {
+        HIAHMachOError(error, errorSize, "slice at %zu is truncated", slice->offset);
+        return false;
+    }
+    uint32_t magic;
+    memcpy(&magic, base, sizeof(magic));
+    slice->is64 = magic == HIAH_MACHO_MAGIC_64 || magic == HIAH_MACHO_CIGAM_64;
+    slice->swapped = magic == HIAH_MACHO_CIGAM || magic == HIAH_MACHO_CIGAM_64;
+    if (!slice->is64 && magic != HIAH_MACHO_MAGIC && magic != HIAH_MACHO_CIGAM) {
+        HIAHMachOError(error, errorSize, "unknown Mach-O magic 0x%x at %zu", magic, slice->offset);
+        return false;
+    }
+    slice->headerSize = slice->is64 ? HIAH_MACHO_HEADER_SIZE_64 : HIAH_MACHO_HEADER_SIZE;
+
+    bool swapped = slice->swapped;
+    uint32_t ncmds = HIAHRead32(base + HIAH_MH_NCMDS, swapped);
+    uint32_t sizeofcmds = HIAHRead32(base + HIAH_MH_SIZEOFCMDS, swapped);
+    if (slice->length < slice->headerSize || sizeofcmds > slice->length - slice->headerSize) {
+        HIAHMachOError(error, errorSize, "load commands of slice at %zu overrun it", slice->offset);
+        return false;
+    }
+
+    // Load commands may grow up to the first byte of section (or later
+    // segment) data
+    uint64_t limit = slice->length;
+    const uint8_t *cmd = base + slice->headerSize;
+    uint32_t used = 0;
+    for (uint32_t i = 0; i < ncmds; i++) {
+        if (sizeofcmds - used < 8) {
+            HIAHMachOError(error, errorSize, "load command %u of slice at %zu is truncated", i, slice->offset);
+            return false;
+        }
+        uint32_t type = HIAHRead32(cmd, swapped);
+        uint32_t cmdsize = HIAHRead32(cmd + 4, swapped);
+        if (cmdsize < 8 || cmdsize % 4 != 0 || cmdsize > sizeofcmds - used) {
+            HIAHMachOError(error, errorSize, "load command %u of slice at %zu has bad size %u",
+                           i, slice->offset, cmdsize);
+            return false;
+        }
+
+        bool segment64 = type == HIAH_LC_SEGMENT_64 && cmdsize >= 72;
+        bool segment32 = type == HIAH_LC_SEGMENT_32 && cmdsize >= 56;
+        if (segment64 || segment32) {
+            uint64_t fileoff = segment64 ? HIAHRead64(cmd + 40, swapped) : HIAHRead32(cmd + 32, swapped);
+            uint64_t filesize = segment64 ? HIAHRead64(cmd + 48, swapped) : HIAHRead32(cmd + 36, swapped);
+            uint32_t nsects = HIAHRead32(cmd + (segment64 ? 64 : 48), swapped);
+            if (fileoff > 0 && filesize > 0 && fileoff < limit) {
+                limit = fileoff;
+            }
+            uint32_t sectionSize = segment64 ? 80 : 68;
+            uint32_t header = segment64 ? 72 : 56;
+            for (uint32_t s = 0; s < nsects && header + (uint64_t)(s + 1) * sectionSize <= cmdsize; s++) {
+                const uint8_t *section = cmd + header + s * sectionSize;
+                uint32_t offset = HIAHRead32(section + (segment64 ? 48 : 40), swapped);
+                if (offset > 0 && offset < limit) {
+                    limit = offset;
+                }
+            }
+        }
+        cmd += cmdsize;
+        used += cmdsize;
+    }
+
+    if (limit < slice->headerSize + (uint64_t)sizeofcmds) {
+        limit = slice->headerSize + (uint64_t)sizeofcmds;
+    }
+    if (limit - slice->headerSize > UINT32_MAX) {
+        limit = slice->headerSize + (uint64_t)UINT32_MAX;
+    }
+    slice->commandSpace = (uint32_t)(limit - slice->headerSize);
+    return true;
+}
+
+/**
+ * Finds the Mach-O slices of a thin or fat file.
+ *
+ * @return The slices (free them), or NULL with `error` set
+ */
+static HIAHMachOSlice *HIAHMachOFindSlices(const uint8_t *bytes, size_t length, uint32_t *count,
+                                           char *error, size_t errorSize) {
+    *count = 0;
+    if (length < 4) {
+        HIAHMachOError(error, errorSize, "file is too small to be Mach-O");
+        return NULL;
+    }
+
+    uint32_t magic = HIAHReadBig32(bytes);
+    if (magic != HIAH_FAT_MAGIC && magic != HIAH_FAT_MAGIC_64) {
+        HIAHMachOSlice *slice = calloc(1, sizeof(HIAHMachOSlice));
+        if (!slice) {
+            HIAHMachOError(error, errorSize, "out of memory");
+            return NULL;
+        }
+        slice->length = length;
+        slice->newLength = length;
+        *count = 1;
+        return slice;
+    }
+
+    if (length < HIAH_FAT_HEADER_SIZE) {
+        HIAHMachOError(error, errorSize, "fat header is truncated");
+        return NULL;
+    }
+    bool wide = magic == HIAH_FAT_MAGIC_64;
+    size_t archSize = wide ? HIAH_FAT_ARCH_SIZE_64 : HIAH_FAT_ARCH_SIZE;
+    uint32_t archCount = HIAHReadBig32(bytes + 4);
+    if (archCount == 0 || archCount > (length - HIAH_FAT_HEADER_SIZE) / archSize) {
+        HIAHMachOError(error, errorSize, "fat header lists %u slices", archCount);
+        return NULL;
+    }
+    HIAHMachOSlice *slices = calloc(archCount, sizeof(HIAHMachOSlice));
+    if (!slices) {
+        HIAHMachOError(error, errorSize, "out of memory");
+        return NULL;
+    }
+    for (uint32_t i = 0; i < archCount; i++) {
+        const uint8_t *arch = bytes + HIAH_FAT_HEADER_SIZE + i * archSize;
+        uint64_t offset = wide ? HIAHReadBig64(arch + 8) : HIAHReadBig32(arch + 8);
+        uint64_t size = wide ? HIAHReadBig64(arch + 16) : HIAHReadBig32(arch + 12);
+        if (offset < HIAH_FAT_HEADER_SIZE || offset > length || size > length - offset) {
+            HIAHMachOError(error, errorSize, "fat slice %u lies outside the file", i);
+            free(slices);
+            return NULL;
+        }
+        slices[i].offset = (size_t)offset;
+        slices[i].length = (size_t)size;
+        slices[i].newOffset = (size_t)offset;
+        slices[i].newLength = (size_t)size;
+        slices[i].cputype = HIAHReadBig32(arch);
+        slices[i].cpusubtype = HIAHReadBig32(arch + 4);
+        slices[i].align = HIAHReadBig32(arch + (wide ? 24 : 16));
+    }
+    *count = archCount;
+    return slices;
+}
+
+// MARK: - Edits
+
+/**
+ * Cuts a removed code signature off the slice if nothing follows it, and
+ * shrinks __LINKEDIT, which ends with it, to match. A signature anywhere
+ * else stays where it is, only unreferenced.
+ */
+static void HIAHMachOTrimSignature(HIAHMachOSlice *slice, uint32_t ncmds,
+                                   uint64_t dataoff, uint64_t datasize) {
+    if (datasize == 0 || dataoff + datasize != slice->newLength ||
+        dataoff < slice->headerSize + (uint64_t)slice->commandSpace) {
+        return;
+    }
+    bool swapped = slice->swapped;
+    uint8_t *cmd = slice->scratch + slice->headerSize;
+    for (uint32_t i = 0; i < ncmds; i++) {
+        uint32_t type = HIAHRead32(cmd, swapped);
+        uint32_t cmdsize = HIAHRead32(cmd + 4, swapped);
+        bool segment64 = type == HIAH_LC_SEGMENT_64 && cmdsize >= 72;
+        bool segment32 = type == HIAH_LC_SEGMENT_32 && cmdsize >= 56;
+        if (!(segment64 || segment32) || strncmp((const char *)cmd + 8, "__LINKEDIT", 16) != 0) {
+            cmd += cmdsize;
+            continue;
+        }
+
+        uint64_t fileoff = segment64 ? HIAHRead64(cmd + 40, swapped) : HIAHRead32(cmd + 32, swapped);
+        uint64_t filesize = segment64 ? HIAHRead64(cmd + 48, swapped) : HIAHRead32(cmd + 36, swapped);
+        uint64_t vmsize = segment64 ? HIAHRead64(cmd + 32, swapped) : HIAHRead32(cmd + 28, swapped);
+        if (fileoff > dataoff || fileoff + filesize != dataoff + datasize) {
+            return;
+        }
+
+        // vmsize stays a whole number of the slice's pages
+        uint32_t cputype = HIAHRead32(slice->scratch + HIAH_MH_CPUTYPE, swapped);
+        bool arm64 = (cputype & ~HIAH_CPU_ARCH_MASK) == HIAH_CPU_TYPE_ARM && (cputype & HIAH_CPU_ARCH_MASK);
+        uint64_t page = arm64 ? HIAH_ARM64_PAGE_SIZE : HIAH_DEFAULT_PAGE_SIZE;
+        uint64_t trimmedSize = dataoff - fileoff;
+        uint64_t trimmedVMSize = (trimmedSize + page - 1) & ~(page - 1);
+        if (trimmedVMSize > vmsize) {
+            trimmedVMSize = vmsize;
+        }
+        if (segment64) {
+            HIAHWrite64(cmd + 32, trimmedVMSize, swapped);
+            HIAHWrite64(cmd + 48, trimmedSize, swapped);
+        } else {
+            HIAHWrite32(cmd + 28, (uint32_t)trimmedVMSize, swapped);
+            HIAHWrite32(cmd + 36, (uint32_t)trimmedSize, swapped);
+        }
+        slice->newLength = (size_t)dataoff;
+        return;
+    }
+}
+
+/**
+ * Runs one edit on a slice's scratch copy.
+ *
+ * @return 1 if it changed something, 0 if not, -1 on error
+ */
+static int HIAHMachOApplyEdit(HIAHMachOSlice *slice, const HIAHMachOEdit *edit,
+                              char *error, size_t errorSize) {
+    uint8_t *header = slice->scratch;
+    bool swapped = slice->swapped;
+    uint32_t ncmds = HIAHRead32(header + HIAH_MH_NCMDS, swapped);
+    uint32_t sizeofcmds = HIAHRead32(header + HIAH_MH_SIZEOFCMDS, swapped);
+    uint8_t *commands = header + slice->headerSize;
+
+    switch (edit->kind) {
+        case HIAHMachOEditSetFileType: {
+            uint32_t fileType = HIAHRead32(header + HIAH_MH_FILETYPE, swapped);
+            if (fileType == edit->fileType) {
+                return 0;
+            }
+            if (edit->fromTypes && (fileType >= 32 || !(edit->fromTypes & HIAH_MACHO_FILETYPE_BIT(fileType)))) {
+                return 0;
+            }
+            HIAHWrite32(header + HIAH_MH_FILETYPE, edit->fileType, swapped);
+            return 1;
+        }
+
+        case HIAHMachOEditRelocatePageZero: {
+            uint8_t *cmd = commands;
+            for (uint32_t i = 0; i < ncmds; i++) {
+                uint32_t type = HIAHRead32(cmd, swapped);
+                uint32_t cmdsize = HIAHRead32(cmd + 4, swapped);
+                bool segment64 = type == HIAH_LC_SEGMENT_64 && cmdsize >= 72;
+                bool segment32 = type == HIAH_LC_SEGMENT_32 && cmdsize >= 56;
+                if ((segment64 || segment32) && strncmp((const char *)cmd + 8, "__PAGEZERO", 16) == 0) {
+                    if (segment64) {
+                        if (HIAHRead64(cmd + 24, swapped) == edit->address &&
+                            HIAHRead64(cmd + 32, swapped) == edit->size) {
+                            return 0;
+                        }
+                        HIAHWrite64(cmd + 24, edit->address, swapped);
+                        HIAHWrite64(cmd + 32, edit->size, swapped);
+                        return 1;
+                    }
+                    if (edit->address > UINT32_MAX || edit->size > UINT32_MAX) {
+                        HIAHMachOError(error, errorSize, "__PAGEZERO of 32-bit slice at %zu cannot move to 0x%llx",
+                                       slice->offset, (unsigned long long)edit->address);
+                        return -1;
+                    }
+                    if (HIAHRead32(cmd + 24, swapped) == edit->address &&
+                        HIAHRead32(cmd + 28, swapped) == edit->size) {
+                        return 0;
+                    }
+                    HIAHWrite32(cmd + 24, (uint32_t)edit->address, swapped);
+                    HIAHWrite32(cmd + 28, (uint32_t)edit->size, swapped);
+                    return 1;
+                }
+                cmd += cmdsize;
+            }
+            return 0;
+        }
+
+        case HIAHMachOEditRemoveSignature: {
+            int changed = 0;
+            uint8_t *cmd = commands;
+            uint32_t offset = 0;
+            for (uint32_t i = 0; i < ncmds;) {
+                uint32_t type = HIAHRead32(cmd, swapped);
+                uint32_t cmdsize = HIAHRead32(cmd + 4, swapped);
+                if (type != HIAH_LC_CODE_SIGNATURE) {
+                    cmd += cmdsize;
+                    offset += cmdsize;
+                    i++;
+                    continue;
+                }
+                uint64_t dataoff = cmdsize >= 16 ? HIAHRead32(cmd + 8, swapped) : 0;
+                uint64_t datasize = cmdsize >= 16 ? HIAHRead32(cmd + 12, swapped) : 0;
+
+                // Close the gap and clear the bytes it leaves behind
+                memmove(cmd, cmd + cmdsize, sizeofcmds - offset - cmdsize);
+                memset(commands + sizeofcmds - cmdsize, 0, cmdsize);
+                ncmds--;
+                sizeofcmds -= cmdsize;
+                changed = 1;
+                HIAHMachOTrimSignature(slice, ncmds, dataoff, datasize);
+            }
+            if (changed) {
+                HIAHWrite32(header + HIAH_MH_NCMDS, ncmds, swapped);
+                HIAHWrite32(header + HIAH_MH_SIZEOFCMDS, sizeofcmds, swapped);
+            }
+            return changed;
+        }
+
+        case HIAHMachOEditAddLoadCommand: {
+            uint32_t alignment = slice->is64 ? 8 : 4;
+            if (!edit->command || edit->commandSize < 8 || edit->commandSize % alignment != 0) {
+                HIAHMachOError(error, errorSize, "load command of %u bytes is not %u-byte aligned",
+                               edit->commandSize, alignment);
+                return -1;
+            }
+            if (HIAHRead32(edit->command + 4, false) != edit->commandSize) {
+                HIAHMachOError(error, errorSize, "load command's cmdsize does not match its length");
+                return -1;
+            }
+            if (swapped) {
+                HIAHMachOError(error, errorSize, "cannot add a load command to byte-swapped slice at %zu",
+                               slice->offset);
+                return -1;
+            }
+            uint8_t *cmd = commands;
+            for (uint32_t i = 0; i < ncmds; i++) {
+                uint32_t cmdsize = HIAHRead32(cmd + 4, swapped);
+                if (cmdsize == edit->commandSize && memcmp(cmd, edit->command, cmdsize) == 0) {
+                    return 0;
+                }
+                cmd += cmdsize;
+            }
+            if (edit->commandSize > slice->commandSpace - sizeofcmds) {
+                HIAHMachOError(error, errorSize,
+                               "no room for a %u byte load command in slice at %zu (%u bytes free)",
+                               edit->commandSize, slice->offset, slice->commandSpace - sizeofcmds);
+                return -1;
+            }
+            memcpy(commands + sizeofcmds, edit->command, edit->commandSize);
+            HIAHWrite32(header + HIAH_MH_NCMDS, ncmds + 1, swapped);
+            HIAHWrite32(header + HIAH_MH_SIZEOFCMDS, sizeofcmds + edit->commandSize, swapped);
+            return 1;
+        }
+
+        default:
+            HIAHMachOError(error, errorSize, "unknown edit kind %d", (int)edit->kind);
+            return -1;
+    }
+}
+
+// MARK: - Transform
+
+typedef struct {
+    const uint8_t *bytes;
+    HIAHMachOSlice *slices;
+    const HIAHMachOEdit *edits;
+    size_t editCount;
+} HIAHMachOTransformJob;
+
+/**
+ * Edits one parsed slice's scratch copy and finds the span that changed.
+ * Runs on a pool worker; touches nothing but its own slice.
+ */
+static void HIAHMachOEditSlice(size_t index, void *context) {
+    HIAHMachOTransformJob *job = context;
+    HIAHMachOSlice *slice = &job->slices[index];
+    size_t area = slice->headerSize + (size_t)slice->commandSpace;
+    slice->scratch = malloc(area);
+    if (!slice->scratch) {
+        HIAHMachOError(slice->error, sizeof(slice->error), "out of memory");
+        slice->failed = true;
+        return;
+    }
+    const uint8_t *original = job->bytes + slice->offset;
+    memcpy(slice->scratch, original, area);
+
+    for (size_t e = 0; e < job->editCount; e++) {
+        int result = HIAHMachOApplyEdit(slice, &job->edits[e], slice->error, sizeof(slice->error));
+        if (result < 0) {
+            slice->failed = true;
+            return;
+        }
+        if (result > 0) {
+            slice->applied[job->edits[e].kind]++;
+            slice->changed = true;
+        }
+    }
+
+    // Only the span that actually differs is written back
+    size_t start = 0, end = area;
+    while (start < end && slice->scratch[start] == original[start]) {
+        start++;
+    }
+    while (end > start && slice->scratch[end - 1] == original[end - 1]) {
+        end--;
+    }
+    slice->changedStart = start;
+    slice->changedEnd = end;
+}
+
+/**
+ * Places slices that follow a shortened one right behind it, at the next
+ * offset their alignment allows, and rewrites the fat header to match.
+ * Slices are only moved when they lie in file order and the last one ends
+ * the file; otherwise they stay put and just get shorter.
+ *
+ * @return The length of the file once the slices are in place
+ */
+static size_t HIAHMachOLayoutSlices(uint8_t *bytes, size_t length, HIAHMachOSlice *slices, uint32_t count) {
+    uint32_t magic = HIAHReadBig32(bytes);
+    if (magic != HIAH_FAT_MAGIC && magic != HIAH_FAT_MAGIC_64) {
+        return slices[0].newLength;
+    }
+
+    bool packed = slices[count - 1].offset + slices[count - 1].length == length;
+    for (uint32_t i = 1; i < count && packed; i++) {
+        packed = slices[i].offset >= slices[i - 1].offset + slices[i - 1].length;
+    }
+
+    bool wide = magic == HIAH_FAT_MAGIC_64;
+    size_t archSize = wide ? HIAH_FAT_ARCH_SIZE_64 : HIAH_FAT_ARCH_SIZE;
+    for (uint32_t i = 0; i < count; i++) {
+        HIAHMachOSlice *slice = &slices[i];
+        if (packed && i > 0 && slice->align < 32) {
+            uint64_t alignment = 1ull << slice->align;
+            uint64_t end = slices[i - 1].newOffset + (uint64_t)slices[i - 1].newLength;
+            uint64_t offset = (end + alignment - 1) & ~(alignment - 1);
+            if (offset < slice->offset) {
+                slice->newOffset = (size_t)offset;
+            }
+        }
+        uint8_t *arch = bytes + HIAH_FAT_HEADER_SIZE + i * archSize;
+        if (wide) {
+            HIAHWriteBig64(arch + 8, slice->newOffset);
+            HIAHWriteBig64(arch + 16, slice->newLength);
+        } else {
+            HIAHWriteBig32(arch + 8, (uint32_t)slice->newOffset);
+            HIAHWriteBig32(arch + 12, (uint32_t)slice->newLength);
+        }
+    }
+    return packed ? slices[count - 1].newOffset + slices[count - 1].newLength : length;
+}
+
+static void HIAHMachOFreeSlices(HIAHMachOSlice *slices, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        free(slices[i].scratch);
+    }
+    free(slices);
+}
+
+/**
+ * Edits every slice's scratch copy and, if all succeed, copies the changes
+ * into `bytes` and lays the slices out again. Moving them is left to the
+ * caller, who also frees the slices on success.
+ */
+static HIAHMachOSlice *HIAHMachOTransformSlices(uint8_t *bytes, size_t length,
+                                                const HIAHMachOEdit *edits, size_t editCount,
+                                                HIAHMachOTransformStats *stats, uint32_t *sliceCount,
+                                                char *error, size_t errorSize) {
+    uint32_t count = 0;
+    HIAHMachOSlice *slices = HIAHMachOFindSlices(bytes, length, &count, error, errorSize);
+    if (!slices) {
+        return NULL;
+    }
+
+    size_t area = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (!HIAHMachOParseSlice(bytes, &slices[i], error, errorSize)) {
+            free(slices);
+            return NULL;
+        }
+        area += slices[i].headerSize + (size_t)slices[i].commandSpace;
+    }
+
+    HIAHMachOTransformJob job = {bytes, slices, edits, editCount};
+    unsigned workers = count > 1 && area >= HIAH_MACHO_PARALLEL_AREA ? 0 : 1;
+    HIAHWorkerPoolRun(count, workers, HIAHMachOEditSlice, &job);
+
+    // The first failing slice in file order is the one reported
+    HIAHMachOTransformStats local = {0};
+    for (uint32_t i = 0; i < count; i++) {
+        HIAHMachOSlice *slice = &slices[i];
+        if (slice->failed) {
+            HIAHMachOError(error, errorSize, "%s", slice->error);
+            HIAHMachOFreeSlices(slices, count);
+            return NULL;
+        }
+        for (int k = 0; k < HIAHMachOEditKindCount; k++) {
+            local.applied[k] += slice->applied[k];
+        }
+        local.slices++;
+        if (slice->changed && slice->changedStart < slice->changedEnd) {
+            local.slicesChanged++;
+        }
+        local.bytesTrimmed += slice->length - slice->newLength;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        HIAHMachOSlice *slice = &slices[i];
+        if (slice->changedStart < slice->changedEnd) {
+            memcpy(bytes + slice->offset + slice->changedStart, slice->scratch + slice->changedStart,
+                   slice->changedEnd - slice->changedStart);
+        }
+        free(slice->scratch);
+        slice->scratch = NULL;
+    }
+    local.length = local.bytesTrimmed ? HIAHMachOLayoutSlices(bytes, length, slices, count) : length;
+    if (stats) {
+        *stats = local;
+    }
+    *sliceCount = count;
+    return slices;
+}
+
+bool HIAHMachOListSlices(const uint8_t *bytes, size_t length,
+                         HIAHMachOSliceRange **ranges, uint32_t *count,
+                         char *error, size_t errorSize) {
+    *ranges = NULL;
+    *count = 0;
+    uint32_t found = 0;
+    HIAHMachOSlice *slices = HIAHMachOFindSlices(bytes, length, &found, error, errorSize);
+    if (!slices) {
+        return false;
+    }
+    HIAHMachOSliceRange *list = calloc(found, sizeof(HIAHMachOSliceRange));
+    if (!list) {
+        HIAHMachOError(error, errorSize, "out of memory");
+        free(slices);
+        return false;
+    }
+    for (uint32_t i = 0; i < found; i++) {
+        list[i].offset = slices[i].offset;
+        list[i].size = slices[i].length;
+        list[i].cputype = slices[i].cputype;
+        list[i].cpusubtype = slices[i].cpusubtype;
+        if (found == 1 && length >= 12 && slices[i].offset == 0) {
+            // Thin: the CPU comes from the Mach-O header itself
+            uint32_t magic;
+            memcpy(&magic, bytes, sizeof(magic));
+            bool swapped = magic == HIAH_MACHO_CIGAM || magic == HIAH_MACHO_CIGAM_64;
+            list[i].cputype = HIAHRead32(bytes + 4, swapped);
+            list[i].cpusubtype = HIAHRead32(bytes + 8, swapped);
+        }
+    }
+    free(slices);
+    *ranges = list;
+    *count = found;
+    return true;
+}
+
+bool HIAHMachOTransformBuffer(uint8_t *bytes, size_t *length,
+                              const HIAHMachOEdit *edits, size_t editCount,
+                              HIAHMachOTransformStats *stats,
+                              char *error, size_t errorSize) {
+    HIAHMachOTransformStats local;
+    uint32_t count = 0;
+    HIAHMachOSlice *slices = HIAHMachOTransformSlices(bytes, *length, edits, editCount,
+                                                      &local, &count, error, errorSize);
+    if (!slices) {
+        return false;
+    }
+    // In file order every slice moves down, never over one still to move
+    for (uint32_t i = 0; i < count; i++) {
+        if (slices[i].newOffset != slices[i].offset) {
+            memmove(bytes + slices[i].newOffset, bytes + slices[i].offset, slices[i].newLength);
+        }
+    }
+    free(slices);
+    *length = (size_t)local.length;
+    if (stats) {
+        *stats = local;
+    }
+    return true;
+}
+
+static bool HIAHMachOWriteAll(int fd, const uint8_t *data, size_t length, uint64_t offset,
+                              uint64_t *bytesWritten, const char *path, char *error, size_t errorSize) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, (off_t)offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            HIAHMachOError(error, errorSize, "write %s: %s", path, strerror(errno));
+            return false;
+        }
+        data += written;
+        offset += (uint64_t)written;
+        length -= (size_t)written;
+        *bytesWritten += (uint64_t)written;
+    }
+    return true;
+}
+
+/**
+ * Copies a slice down to its new offset within the file. Going up from its
+ * start, every chunk is read before anything overwrites it.
+ */
+static bool HIAHMachOMoveSlice(int fd, const HIAHMachOSlice *slice, uint8_t *buffer,
+                               uint64_t *bytesWritten, const char *path, char *error, size_t errorSize) {
+    for (size_t done = 0; done < slice->newLength;) {
+        size_t chunk = slice->newLength - done < HIAH_MOVE_CHUNK ? slice->newLength - done : HIAH_MOVE_CHUNK;
+        ssize_t got = pread(fd, buffer, chunk, (off_t)(slice->offset + done));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            HIAHMachOError(error, errorSize, "read %s: %s", path, got < 0 ? strerror(errno) : "truncated");
+            return false;
+        }
+        if (!HIAHMachOWriteAll(fd, buffer, (size_t)got, slice->newOffset + done, bytesWritten,
+                               path, error, errorSize)) {
+            return false;
+        }
+        done += (size_t)got;
+    }
+    return true;
+}
+
+/**
+ * Clones `path` to a new file next to it, for the edits to go into. The
+ * name is taken with mkstemp() and given back for the clone, which refuses
+ * to overwrite anything that got there meanwhile. Bytes the clone had to
+ * copy rather than share count as written.
+ */
+static int HIAHMachOCreateReplacement(const char *path, char **temporary, uint64_t *bytesWritten,
+                                      char *error, size_t errorSize) {
+    size_t pathLength = strlen(path) + sizeof(".XXXXXX");
+    char *name = malloc(pathLength);
+    if (!name) {
+        HIAHMachOError(error, errorSize, "out of memory");
+        return -1;
+    }
+    snprintf(name, pathLength, "%s.XXXXXX", path);
+    int reserved = mkstemp(name);
+    if (reserved < 0) {
+        HIAHMachOError(error, errorSize, "create %s: %s", name, strerror(errno));
+        free(name);
+        return -1;
+    }
+    close(reserved);
+    unlink(name);
+
+    HIAHFileCloneStats cloneStats = {0};
+    char cloneError[256] = "";
+    if (!HIAHFileCloneFile(path, name, 0, &cloneStats, cloneError, sizeof(cloneError))) {
+        HIAHMachOError(error, errorSize, "copy %s: %s", path, cloneError);
+        free(name);
+        return -1;
+    }
+    int fd = open(name, O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        HIAHMachOError(error, errorSize, "open %s: %s", name, strerror(errno));
+        unlink(name);
+        free(name);
+        return -1;
+    }
+    *temporary = name;
+    *bytesWritten += cloneStats.bytesCopied;
+    return fd;
+}
+
+bool HIAHMachOTransformFile(const char *path,
+                            const HIAHMachOEdit *edits, size_t editCount,
+                            HIAHMachOTransformStats *stats,
+                            char *error, size_t errorSize) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        HIAHMachOError(error, errorSize, "open %s: %s", path, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        HIAHMachOError(error, errorSize, "%s is empty or cannot be examined", path);
+        close(fd);
+        return false;
+    }
+    size_t length = (size_t)st.st_size;
+
+    // Private and writable: edits copy only the pages they touch, and nothing
+    // reaches a file until it is written out below
+    uint8_t *bytes = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (bytes == MAP_FAILED) {
+        HIAHMachOError(error, errorSize, "mmap %s: %s", path, strerror(errno));
+        return false;
+    }
+
+    HIAHMachOTransformStats local;
+    uint32_t count = 0;
+    HIAHMachOSlice *slices = HIAHMachOTransformSlices(bytes, length, edits, editCount,
+                                                      &local, &count, error, errorSize);
+    bool ok = slices != NULL;
+
+    // The edits go into a clone that replaces the file once complete, so a
+    // crash or a full disk never leaves a half-edited or half-moved binary
+    char *temporary = NULL;
+    int out = -1;
+    if (ok && (local.slicesChanged || local.bytesTrimmed)) {
+        out = HIAHMachOCreateReplacement(path, &temporary, &local.bytesWritten, error, errorSize);
+        ok = out >= 0;
+    }
+    uint8_t *buffer = NULL;
+    for (uint32_t i = 0; out >= 0 && ok && i < count; i++) {
+        // A moved slice is copied from the clone as it was, then its edited
+        // header comes from the mapping
+        HIAHMachOSlice *slice = &slices[i];
+        if (slice->newOffset != slice->offset) {
+            if (!buffer && !(buffer = malloc(HIAH_MOVE_CHUNK))) {
+                HIAHMachOError(error, errorSize, "out of memory");
+                ok = false;
+                break;
+            }
+            ok = HIAHMachOMoveSlice(out, slice, buffer, &local.bytesWritten, temporary, error, errorSize);
+        }
+        ok = ok && HIAHMachOWriteAll(out, bytes + slice->offset + slice->changedStart,
+                                     slice->changedEnd - slice->changedStart,
+                                     slice->newOffset + slice->changedStart,
+                                     &local.bytesWritten, temporary, error, errorSize);
+    }
+    uint32_t magic = HIAHReadBig32(bytes);
+    if (out >= 0 && ok && local.bytesTrimmed && (magic == HIAH_FAT_MAGIC || magic == HIAH_FAT_MAGIC_64)) {
+        size_t archSize = magic == HIAH_FAT_MAGIC_64 ? HIAH_FAT_ARCH_SIZE_64 : HIAH_FAT_ARCH_SIZE;
+        ok = HIAHMachOWriteAll(out, bytes + HIAH_FAT_HEADER_SIZE, count * archSize, HIAH_FAT_HEADER_SIZE,
+                               &local.bytesWritten, temporary, error, errorSize);
+    }
+
+    free(buffer);
+    free(slices);
+    munmap(bytes, length);
+    if (out >= 0) {
+        if (ok && local.length < length && ftruncate(out, (off_t)local.length) != 0) {
+            HIAHMachOError(error, errorSize, "truncate %s: %s", temporary, strerror(errno));
+            ok = false;
+        }
+        // On disk before it is renamed into place, or a crash could leave
+        // the new name pointing at missing data
+        if (ok && fsync(out) != 0) {
+            HIAHMachOError(error, errorSize, "sync %s: %s", temporary, strerror(errno));
+            ok = false;
+        }
+        if (close(out) != 0 && ok) {
+            HIAHMachOError(error, errorSize, "close %s: %s", temporary, strerror(errno));
+            ok = false;
+        }
+        if (ok && rename(temporary, path) != 0) {
+            HIAHMachOError(error, errorSize, "rename %s: %s", path, strerror(errno));
+            ok = false;
+        }
+        if (!ok) {
+            unlink(temporary);
+        }
+        free(temporary);
+    }
+    if (ok && stats) {
+        *stats = local;
+    }
+    return ok;
+}
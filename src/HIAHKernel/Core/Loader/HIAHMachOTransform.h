@@ -0,0 +1,143 @@
+/**
+ * HIAHMachOTransform.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Single-pass Mach-O header edits.
+ *
+ * Preparing a guest binary takes several header edits: a new filetype, a
+ * relocated __PAGEZERO, no LC_CODE_SIGNATURE, sometimes an extra load
+ * command. They only touch the first pages of each slice, yet done one at a
+ * time each edit read and rewrote the whole file. Here the edits are given
+ * as one list and applied together: the file is mapped once, copy-on-write,
+ * every slice of a fat binary is validated and then edited, and only the
+ * header ranges that changed are written out, once. On APFS a 100 MB
+ * executable costs a few pages of I/O instead of several full copies.
+ *
+ * Nothing is written unless every slice parses and every edit fits. The
+ * edits then go into a clone of the file (see HIAHFileClone.h), which is
+ * synced and renamed over it, so a failed transform, or a crash during
+ * one, leaves the file as it was, and an image already mapped keeps its
+ * old contents. Where the file system shares blocks, the clone costs no
+ * copying; elsewhere it is one full copy of the file. A symlink at the path
+ * is replaced by the edited file, not followed.
+ *
+ * Removing the signature also removes the signature data when it ends the
+ * slice, as codesign and ld64 lay it out: __LINKEDIT loses it from filesize
+ * and vmsize and the slice gets shorter, so the prepared image is smaller
+ * to copy and hash, and signing it again leaves no stale blob behind.
+ * Slices after a shortened one move down to their next aligned offset and
+ * the fat header is rewritten; that copies them, so a thin binary is the
+ * cheap case.
+ *
+ * Thin and fat (FAT_MAGIC and FAT_MAGIC_64) files with 32- and 64-bit
+ * slices of either byte order are understood; load commands are only added
+ * to slices in host byte order. Slices of a fat file are edited in parallel
+ * when there is enough work to make it pay (see HIAHWorkerPool.h).
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_MACHO_TRANSFORM_H
+#define HIAH_MACHO_TRANSFORM_H
+
+#include "HIAHMachOFormat.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Filetypes (HIAH_MACHO_FILETYPE_*) are in HIAHMachOFormat.h
+#define HIAH_MACHO_FILETYPE_BIT(type) (1u << (type))
+
+typedef enum {
+    HIAHMachOEditSetFileType = 0,     // Slices whose filetype is in `fromTypes` get `fileType`
+    HIAHMachOEditRelocatePageZero,    // __PAGEZERO moves to `address` with `size`
+    HIAHMachOEditRemoveSignature,     // LC_CODE_SIGNATURE is dropped, its data too if it ends the slice
+    HIAHMachOEditAddLoadCommand,      // `command` is appended unless already present
+    HIAHMachOEditKindCount
+} HIAHMachOEditKind;
+
+/**
+ * One edit, applied to every Mach-O slice in list order.
+ */
+typedef struct {
+    HIAHMachOEditKind kind;
+    uint32_t fromTypes;        // SetFileType: HIAH_MACHO_FILETYPE_BIT()s, 0 = any
+    uint32_t fileType;         // SetFileType
+    uint64_t address;          // RelocatePageZero
+    uint64_t size;             // RelocatePageZero
+    const uint8_t *command;    // AddLoadCommand: the whole command, in host byte order
+    uint32_t commandSize;      // AddLoadCommand: a multiple of 8 (4 for 32-bit slices)
+} HIAHMachOEdit;
+
+typedef struct {
+    uint32_t slices;                               // Mach-O slices found
+    uint32_t slicesChanged;
+    uint32_t applied[HIAHMachOEditKindCount];      // Slices each kind of edit changed
+    uint64_t bytesWritten;                         // Committed to the file, with
+                                                   // what its clone copied
+    uint64_t bytesTrimmed;                         // Signature data cut off the slices
+    uint64_t length;                               // Of the file afterwards
+} HIAHMachOTransformStats;
+
+/**
+ * Where one slice of a binary lies.
+ */
+typedef struct {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t cputype;
+    uint32_t cpusubtype;
+} HIAHMachOSliceRange;
+
+/**
+ * Lists the slices of a thin or fat binary in file order; a thin binary is
+ * one slice. Only the fat header is checked, not the slices themselves.
+ *
+ * @param ranges Receives the list, to be freed by the caller
+ * @return false with `error` set if the fat header is malformed
+ */
+bool HIAHMachOListSlices(const uint8_t *bytes, size_t length,
+                         HIAHMachOSliceRange **ranges, uint32_t *count,
+                         char *error, size_t errorSize);
+
+/**
+ * Applies `edits` to a binary in memory.
+ *
+ * @param length In: the binary's length. Out: its length after the edits,
+ *               which is shorter if a signature was cut off
+ * @param stats May be NULL
+ * @param error Receives a description on failure
+ * @return false, with `bytes` untouched, if a slice does not parse or an
+ *         edit does not fit
+ */
+bool HIAHMachOTransformBuffer(uint8_t *bytes, size_t *length,
+                              const HIAHMachOEdit *edits, size_t editCount,
+                              HIAHMachOTransformStats *stats,
+                              char *error, size_t errorSize);
+
+/**
+ * Applies `edits` to the file at `path`. A clone of it gets what changed,
+ * plus any slices that move, and is cut short if it got shorter; then it
+ * replaces the file. Nothing is written if no slice changes.
+ *
+ * @return false, with the file untouched, if it cannot be read, a slice does
+ *         not parse, an edit does not fit or the replacement cannot be
+ *         written
+ */
+bool HIAHMachOTransformFile(const char *path,
+                            const HIAHMachOEdit *edits, size_t editCount,
+                            HIAHMachOTransformStats *stats,
+                            char *error, size_t errorSize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_MACHO_TRANSFORM_H */
@@ -0,0 +1,92 @@
+/**
+ * HIAHPatchedImageCache.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Content-addressed cache of patched guest binaries.
+ *
+ * Spawning an MH_EXECUTE guest needs a patched copy of its binary. The cache
+ * keeps those copies across launches, so a repeated launch of the same
+ * binary goes straight to dlopen without copying or patching it again.
+ *
+ * Images are named by the SHA-256 of the source binary plus the version of
+ * the patch recipe that produced them. Hashing is only needed the first time
+ * a source file is seen: the index maps a file's identity (device, inode,
+ * mtime, size) to its digest, so later lookups cost one stat(). Two apps
+ * with the same executable name never share an image unless their binaries
+ * are byte-identical, in which case sharing is correct.
+ *
+ * The cache is bounded by a disk budget and evicts least recently used
+ * images first.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#import <Foundation/Foundation.h>
+
+NS_ASSUME_NONNULL_BEGIN
+
+/// Default disk budget for cached images (512 MiB)
+extern const unsigned long long HIAHPatchedImageCacheDefaultBudget;
+
+/**
+ * Turns the staged copy of a source binary into the cached image, in place.
+ *
+ * @return NO to discard the copy and fail the lookup
+ */
+typedef BOOL (^HIAHPatchedImagePreparer)(NSString *stagingPath);
+
+@interface HIAHPatchedImageCache : NSObject
+
+/// Directory holding the images and the identity index
+@property (nonatomic, copy, readonly) NSString *directory;
+
+/// Bytes the cached images may occupy. Lowering it trims on the next insert;
+/// call -trim to apply it right away.
+@property (atomic, assign) unsigned long long budget;
+
+/**
+ * Creates a cache in `directory` (created if missing). Images left by an
+ * earlier launch are picked up again.
+ */
+- (instancetype)initWithDirectory:(NSString *)directory
+                           budget:(unsigned long long)budget;
+
+/**
+ * Creates a cache in Library/Caches/HIAHKernel/PatchedImages with
+ * HIAHPatchedImageCacheDefaultBudget.
+ */
+- (instancetype)init;
+
+/**
+ * Returns the cached image for `sourcePath`, building it on a miss.
+ *
+ * On a miss the source is copied into the cache, `preparer` patches (and
+ * signs, if it wants to) the copy, and the result is published atomically.
+ * Concurrent misses on the same source may each prepare a copy; the last
+ * one wins and all of them are equivalent.
+ *
+ * @param recipeVersion Version of what `preparer` does. Bump it whenever the
+ *                      preparer's output changes, so stale images are not
+ *                      reused.
+ * @param error Set on failure
+ * @return Path of the image, or nil
+ */
+- (nullable NSString *)imagePathForSourcePath:(NSString *)sourcePath
+                                recipeVersion:(uint32_t)recipeVersion
+                                     preparer:(HIAHPatchedImagePreparer)preparer
+                                        error:(NSError **)error;
+
+/**
+ * Evicts least recently used images until the cache fits its budget.
+ */
+- (void)trim;
+
+/**
+ * Removes every cached image and forgets all identities.
+ */
+- (void)removeAllImages;
+
+@end
+
+NS_ASSUME_NONNULL_END
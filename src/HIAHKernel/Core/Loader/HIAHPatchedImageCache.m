@@ -0,0 +1,424 @@
+/**
+ * HIAHPatchedImageCache.m
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Content-addressed cache of patched guest binaries.
+ *
+ * Layout of the cache directory:
+ *   <sha256>.v<recipe>   Patched image
+ *   *.tmp                Image being prepared (never looked up)
+ *   index.plist          Source identity -> sha256 of the source
+ *
+ * Recency is the image's mtime, which is bumped on every hit, so LRU order
+ * survives relaunches without being tracked in the index.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#import "HIAHPatchedImageCache.h"
+#import "HIAHFileClone.h"
+#import "HIAHLogging.h"
+#import <CommonCrypto/CommonDigest.h>
+#import <errno.h>
+#import <fcntl.h>
+#import <sys/stat.h>
+#import <sys/time.h>
+#import <unistd.h>
+
+const unsigned long long HIAHPatchedImageCacheDefaultBudget =
+    512ull * 1024 * 1024;
+
+static NSString *const HIAHPatchedImageIndexName = @"index.plist";
+static NSString *const HIAHPatchedImageStagingSuffix = @".tmp";
+
+static NSError *HIAHPatchedImageCacheError(int code, NSString *description) {
+  return [NSError errorWithDomain:NSPOSIXErrorDomain
+                             code:code
+                         userInfo:@{NSLocalizedDescriptionKey : description}];
+}
+
+// Identity of an open source file. Any in-place rewrite changes mtime or
+// size; a replaced file gets a new inode.
+static NSString *HIAHPatchedImageIdentity(const struct stat *st) {
+  return [NSString
+      stringWithFormat:@"%llx-%llx-%lld.%09ld-%lld",
+                       (unsigned long long)st->st_dev,
+                       (unsigned long long)st->st_ino,
+                       (long long)st->st_mtimespec.tv_sec,
+                       (long)st->st_mtimespec.tv_nsec,
+                       (long long)st->st_size];
+}
+
+static BOOL HIAHPatchedImageSameFile(const struct stat *a,
+                                     const struct stat *b) {
+  return a->st_dev == b->st_dev && a->st_ino == b->st_ino &&
+         a->st_size == b->st_size &&
+         a->st_mtimespec.tv_sec == b->st_mtimespec.tv_sec &&
+         a->st_mtimespec.tv_nsec == b->st_mtimespec.tv_nsec;
+}
+
+static NSString *HIAHPatchedImageDigest(int fd) {
+  CC_SHA256_CTX ctx;
+  CC_SHA256_Init(&ctx);
+
+  const size_t chunk = 1024 * 1024;
+  uint8_t *buffer = malloc(chunk);
+  if (!buffer) {
+    return nil;
+  }
+  off_t offset = 0;
+  for (;;) {
+    ssize_t n = pread(fd, buffer, chunk, offset);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      free(buffer);
+      return nil;
+    }
+    if (n == 0) {
+      break;
+    }
+    CC_SHA256_Update(&ctx, buffer, (CC_LONG)n);
+    offset += n;
+  }
+  free(buffer);
+
+  unsigned char digest[CC_SHA256_DIGEST_LENGTH];
+  CC_SHA256_Final(digest, &ctx);
+
+  char hex[CC_SHA256_DIGEST_LENGTH * 2 + 1];
+  for (int i = 0; i < CC_SHA256_DIGEST_LENGTH; i++) {
+    snprintf(hex + i * 2, 3, "%02x", digest[i]);
+  }
+  return [NSString stringWithUTF8String:hex];
+}
+
+@interface HIAHPatchedImageCache ()
+@property(nonatomic, copy, readwrite) NSString *directory;
+@property(nonatomic, strong)
+    NSMutableDictionary<NSString *, NSString *> *identities;
+@end
+
+@implementation HIAHPatchedImageCache
+
+- (instancetype)initWithDirectory:(NSString *)directory
+                           budget:(unsigned long long)budget {
+  self = [super init];
+  if (self) {
+    _directory = [directory copy];
+    _budget = budget;
+
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory
+                              withIntermediateDirectories:YES
+                                               attributes:nil
+                                                    error:nil];
+
+    NSDictionary *index = [NSDictionary
+        dictionaryWithContentsOfFile:
+            [directory stringByAppendingPathComponent:HIAHPatchedImageIndexName]];
+    _identities = [NSMutableDictionary dictionary];
+    for (id key in index) {
+      id value = index[key];
+      if ([key isKindOfClass:[NSString class]] &&
+          [value isKindOfClass:[NSString class]]) {
+        _identities[key] = value;
+      }
+    }
+  }
+  return self;
+}
+
+- (instancetype)init {
+  NSString *caches = NSSearchPathForDirectoriesInDomains(
+                         NSCachesDirectory, NSUserDomainMask, YES)
+                         .firstObject
+                         ?: NSTemporaryDirectory();
+  NSString *directory = [[caches stringByAppendingPathComponent:@"HIAHKernel"]
+      stringByAppendingPathComponent:@"PatchedImages"];
+  return [self initWithDirectory:directory
+                          budget:HIAHPatchedImageCacheDefaultBudget];
+}
+
+#pragma mark - Lookup
+
+- (NSString *)imagePathForDigest:(NSString *)digest
+                   recipeVersion:(uint32_t)recipeVersion {
+  return [self.directory
+      stringByAppendingPathComponent:[NSString stringWithFormat:@"%@.v%u",
+                                                                digest,
+                                                                recipeVersion]];
+}
+
+// Bumps the image to most recently used.
+// @return NO if the image does not exist
+- (BOOL)touchImageAtPath:(NSString *)path {
+  return utimes(path.fileSystemRepresentation, NULL) == 0;
+}
+
+- (NSString *)imagePathForSourcePath:(NSString *)sourcePath
+                       recipeVersion:(uint32_t)recipeVersion
+                            preparer:(HIAHPatchedImagePreparer)preparer
+                               error:(NSError **)error {
+  int fd = open(sourcePath.fileSystemRepresentation, O_RDONLY | O_CLOEXEC);
+  struct stat before;
+  if (fd < 0 || fstat(fd, &before) != 0) {
+    int code = errno;
+    if (fd >= 0) {
+      close(fd);
+    }
+    if (error) {
+      *error = HIAHPatchedImageCacheError(
+          code, [NSString stringWithFormat:@"Cannot read %@: %s", sourcePath,
+                                           strerror(code)]);
+    }
+    return nil;
+  }
+
+  // Fast path: a source seen before costs one fstat() and one utimes()
+  NSString *identity = HIAHPatchedImageIdentity(&before);
+  NSString *digest = nil;
+  @synchronized(self) {
+    digest = self.identities[identity];
+  }
+  if (digest) {
+    NSString *imagePath = [self imagePathForDigest:digest
+                                     recipeVersion:recipeVersion];
+    if ([self touchImageAtPath:imagePath]) {
+      close(fd);
+      HIAHLogDebug(HIAHLogKernel, "Patched image cache hit: %s",
+                   imagePath.UTF8String);
+      return imagePath;
+    }
+  } else {
+    // Unknown identity (new, moved or reinstalled file): fall back to the
+    // content, which may still match an image built from another copy
+    digest = HIAHPatchedImageDigest(fd);
+    struct stat after;
+    BOOL stable = digest && fstat(fd, &after) == 0 &&
+                  HIAHPatchedImageSameFile(&before, &after);
+    if (!digest) {
+      int code = errno;
+      close(fd);
+      if (error) {
+        *error = HIAHPatchedImageCacheError(
+            code, [NSString stringWithFormat:@"Cannot hash %@: %s", sourcePath,
+                                             strerror(code)]);
+      }
+      return nil;
+    }
+    if (!stable) {
+      // The digest may not describe what would be copied
+      close(fd);
+      if (error) {
+        *error = HIAHPatchedImageCacheError(
+            EAGAIN, [NSString stringWithFormat:@"%@ changed while being read",
+                                               sourcePath]);
+      }
+      return nil;
+    }
+    [self recordIdentity:identity digest:digest];
+
+    NSString *imagePath = [self imagePathForDigest:digest
+                                     recipeVersion:recipeVersion];
+    if ([self touchImageAtPath:imagePath]) {
+      close(fd);
+      HIAHLogDebug(HIAHLogKernel, "Patched image cache content hit: %s",
+                   imagePath.UTF8String);
+      return imagePath;
+    }
+  }
+  close(fd);
+
+  NSString *imagePath = [self buildImageFromSourcePath:sourcePath
+                                                digest:digest
+                                         recipeVersion:recipeVersion
+                                              preparer:preparer
+                                                 error:error];
+  if (imagePath) {
+    [self trimKeepingPath:imagePath];
+  }
+  return imagePath;
+}
+
+#pragma mark - Insertion
+
+- (NSString *)buildImageFromSourcePath:(NSString *)sourcePath
+                                digest:(NSString *)digest
+                         recipeVersion:(uint32_t)recipeVersion
+                              preparer:(HIAHPatchedImagePreparer)preparer
+                                 error:(NSError **)error {
+  NSFileManager *fm = [NSFileManager defaultManager];
+  NSString *imagePath = [self imagePathForDigest:digest
+                                   recipeVersion:recipeVersion];
+  NSString *stagingPath = [imagePath
+      stringByAppendingFormat:@".%@%@", [NSUUID UUID].UUIDString,
+                              HIAHPatchedImageStagingSuffix];
+
+  [fm createDirectoryAtPath:self.directory
+      withIntermediateDirectories:YES
+                       attributes:nil
+                            error:nil];
+  // A clone shares the source's blocks; the preparer's header edits only
+  // materialize the pages they touch
+  char cloneError[256];
+  if (!HIAHFileCloneFile(sourcePath.fileSystemRepresentation,
+                         stagingPath.fileSystemRepresentation, 0, NULL,
+                         cloneError, sizeof(cloneError))) {
+    if (error) {
+      *error = HIAHPatchedImageCacheError(
+          EIO, [NSString stringWithFormat:@"Failed to stage %@: %s", sourcePath,
+                                          cloneError]);
+    }
+    return nil;
+  }
+  chmod(stagingPath.fileSystemRepresentation, 0755);
+
+  if (!preparer(stagingPath)) {
+    [fm removeItemAtPath:stagingPath error:nil];
+    if (error) {
+      *error = HIAHPatchedImageCacheError(
+          EINVAL, [NSString stringWithFormat:@"Failed to prepare image for %@",
+                                             sourcePath]);
+    }
+    return nil;
+  }
+
+  // Publish atomically: a concurrent lookup sees either no image or a
+  // complete one
+  if (rename(stagingPath.fileSystemRepresentation,
+             imagePath.fileSystemRepresentation) != 0) {
+    int code = errno;
+    [fm removeItemAtPath:stagingPath error:nil];
+    if (error) {
+      *error = HIAHPatchedImageCacheError(
+          code, [NSString stringWithFormat:@"Failed to publish image: %s",
+                                           strerror(code)]);
+    }
+    return nil;
+  }
+
+  HIAHLogInfo(HIAHLogKernel, "Patched image cached: %s", imagePath.UTF8String);
+  return imagePath;
+}
+
+- (void)recordIdentity:(NSString *)identity digest:(NSString *)digest {
+  @synchronized(self) {
+    self.identities[identity] = digest;
+    [self saveIndex];
+  }
+}
+
+// Caller holds @synchronized(self)
+- (void)saveIndex {
+  [self.identities
+      writeToFile:[self.directory
+                      stringByAppendingPathComponent:HIAHPatchedImageIndexName]
+       atomically:YES];
+}
+
+#pragma mark - Eviction
+
+- (void)trim {
+  [self trimKeepingPath:nil];
+}
+
+- (void)trimKeepingPath:(NSString *)keepPath {
+  NSFileManager *fm = [NSFileManager defaultManager];
+  NSArray<NSString *> *names = [fm contentsOfDirectoryAtPath:self.directory
+                                                       error:nil];
+  NSMutableArray<NSDictionary *> *images = [NSMutableArray array];
+  unsigned long long total = 0;
+
+  for (NSString *name in names) {
+    if ([name isEqualToString:HIAHPatchedImageIndexName] ||
+        [name hasSuffix:HIAHPatchedImageStagingSuffix]) {
+      continue;
+    }
+    NSString *path = [self.directory stringByAppendingPathComponent:name];
+    struct stat st;
+    if (stat(path.fileSystemRepresentation, &st) != 0 ||
+        !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    total += (unsigned long long)st.st_size;
+    [images addObject:@{
+      @"path" : path,
+      @"size" : @((unsigned long long)st.st_size),
+      @"used" : @((double)st.st_mtimespec.tv_sec +
+                  (double)st.st_mtimespec.tv_nsec / 1e9),
+    }];
+  }
+
+  unsigned long long budget = self.budget;
+  if (total <= budget) {
+    return;
+  }
+
+  [images sortUsingComparator:^NSComparisonResult(NSDictionary *a,
+                                                  NSDictionary *b) {
+    return [a[@"used"] compare:b[@"used"]];
+  }];
+
+  for (NSDictionary *image in images) {
+    if (total <= budget) {
+      break;
+    }
+    NSString *path = image[@"path"];
+    if ([path isEqualToString:keepPath]) {
+      continue;
+    }
+    // Unlinking an image that is still mapped by dlopen is harmless
+    if (unlink(path.fileSystemRepresentation) == 0) {
+      total -= [image[@"size"] unsignedLongLongValue];
+      HIAHLogDebug(HIAHLogKernel, "Evicted patched image: %s",
+                   path.UTF8String);
+    }
+  }
+
+  [self forgetIdentitiesWithoutImages];
+}
+
+// Keeps the index from growing without bound as images are evicted. An
+// identity stays while any recipe version of its image exists.
+- (void)forgetIdentitiesWithoutImages {
+  NSArray<NSString *> *names =
+      [[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.directory
+                                                          error:nil];
+  NSMutableSet<NSString *> *digests = [NSMutableSet set];
+  for (NSString *name in names) {
+    NSRange dot = [name rangeOfString:@"."];
+    if (dot.location != NSNotFound &&
+        ![name hasSuffix:HIAHPatchedImageStagingSuffix]) {
+      [digests addObject:[name substringToIndex:dot.location]];
+    }
+  }
+
+  @synchronized(self) {
+    NSArray<NSString *> *stale = [self.identities
+        keysOfEntriesPassingTest:^BOOL(NSString *identity, NSString *digest,
+                                       BOOL *stop) {
+          return ![digests containsObject:digest];
+        }]
+                                     .allObjects;
+    if (stale.count > 0) {
+      [self.identities removeObjectsForKeys:stale];
+      [self saveIndex];
+    }
+  }
+}
+
+- (void)removeAllImages {
+  NSFileManager *fm = [NSFileManager defaultManager];
+  @synchronized(self) {
+    for (NSString *name in [fm contentsOfDirectoryAtPath:self.directory
+                                                   error:nil]) {
+      [fm removeItemAtPath:[self.directory stringByAppendingPathComponent:name]
+                     error:nil];
+    }
+    [self.identities removeAllObjects];
+  }
+}
+
+@end
@@ -0,0 +1,73 @@
+/**
+ * HIAHWorkerPool.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Bounded parallel-for over independent pieces of work.
+ *
+ * Workers are started per run and claim indices from a shared counter, so
+ * a slow slice does not hold up the others' share. Fat binaries have a
+ * handful of slices and each run is milliseconds of hashing at least, so
+ * the thread start-up is noise.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHWorkerPool.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+typedef struct {
+    size_t count;
+    atomic_size_t next;
+    HIAHWorkerTask task;
+    void *context;
+} HIAHWorkerRun;
+
+static void *HIAHWorkerLoop(void *argument) {
+    HIAHWorkerRun *run = argument;
+    for (;;) {
+        size_t index = atomic_fetch_add_explicit(&run->next, 1, memory_order_relaxed);
+        if (index >= run->count) {
+            return NULL;
+        }
+        run->task(index, run->context);
+    }
+}
+
+unsigned HIAHWorkerPoolDefaultWorkers(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) {
+        return 1;
+    }
+    return cpus > HIAH_WORKER_POOL_MAX ? HIAH_WORKER_POOL_MAX : (unsigned)cpus;
+}
+
+void HIAHWorkerPoolRun(size_t count, unsigned workers, HIAHWorkerTask task, void *context) {
+    if (workers == 0) {
+        workers = HIAHWorkerPoolDefaultWorkers();
+    }
+    if (workers > HIAH_WORKER_POOL_MAX) {
+        workers = HIAH_WORKER_POOL_MAX;
+    }
+    if (workers > count) {
+        workers = (unsigned)count;
+    }
+
+    HIAHWorkerRun run = {.count = count, .task = task, .context = context};
+    atomic_init(&run.next, 0);
+
+    // The caller is one of the workers
+    pthread_t threads[HIAH_WORKER_POOL_MAX];
+    unsigned started = 0;
+    for (unsigned i = 1; i < workers; i++) {
+        if (pthread_create(&threads[started], NULL, HIAHWorkerLoop, &run) == 0) {
+            started++;
+        }
+    }
+    HIAHWorkerLoop(&run);
+    for (unsigned i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
@@ -0,0 +1,52 @@
+/**
+ * HIAHWorkerPool.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Bounded parallel-for over independent pieces of work.
+ *
+ * Used for per-slice work on fat binaries: each slice of a universal
+ * binary is parsed, patched, hashed and signed on its own, so the slices
+ * can be spread across cores. Tasks are handed out by index and must only
+ * write results to their own index; the caller reads them back in index
+ * order, so the output never depends on how the tasks were scheduled.
+ *
+ * At most HIAH_WORKER_POOL_MAX threads run at once, the calling thread
+ * among them. If a worker cannot be started, the others pick up its share.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_WORKER_POOL_H
+#define HIAH_WORKER_POOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HIAH_WORKER_POOL_MAX 8
+
+typedef void (*HIAHWorkerTask)(size_t index, void *context);
+
+/**
+ * One worker per online CPU, at most HIAH_WORKER_POOL_MAX.
+ */
+unsigned HIAHWorkerPoolDefaultWorkers(void);
+
+/**
+ * Runs task(0) .. task(count - 1) and returns when all have finished.
+ *
+ * @param workers Threads to use, 0 for HIAHWorkerPoolDefaultWorkers();
+ *                never more than `count` or HIAH_WORKER_POOL_MAX
+ */
+void HIAHWorkerPoolRun(size_t count, unsigned workers, HIAHWorkerTask task, void *context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_WORKER_POOL_H */
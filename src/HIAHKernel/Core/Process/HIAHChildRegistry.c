@@ -0,0 +1,364 @@
+/**
+ * HIAHChildRegistry.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Virtual child processes and their wait queues.
+ *
+ * One lock guards the entries; a shell has tens to hundreds of children, so
+ * they are kept in an array and scanned. Waiters hash onto a fixed set of
+ * condition variables by parent PID, and an exit wakes only its parent's.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHChildRegistry.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+// Must be a power of two
+#define HIAH_CHILD_REGISTRY_QUEUES 16
+
+typedef struct {
+    pid_t pid;
+    pid_t parent;
+    pid_t group;
+    int status;
+    bool exited;
+    bool external;
+} HIAHChildEntry;
+
+struct HIAHChildRegistry {
+    pthread_mutex_t lock;
+    pthread_cond_t queues[HIAH_CHILD_REGISTRY_QUEUES];
+    HIAHChildRegistryNotify notify;
+    void *context;
+
+    HIAHChildEntry *entries;
+    size_t count;
+    size_t capacity;
+    pid_t firstPid;
+    pid_t nextPid;
+    bool trackExternal;
+
+    HIAHChildRegistryStats stats;
+};
+
+static inline pthread_cond_t *HIAHChildQueue(HIAHChildRegistry *registry, pid_t parent) {
+    return &registry->queues[(uint32_t)parent & (HIAH_CHILD_REGISTRY_QUEUES - 1)];
+}
+
+// Caller holds `lock`
+static HIAHChildEntry *HIAHChildFind(HIAHChildRegistry *registry, pid_t pid) {
+    for (size_t i = 0; i < registry->count; i++) {
+        if (registry->entries[i].pid == pid) {
+            return &registry->entries[i];
+        }
+    }
+    return NULL;
+}
+
+// Caller holds `lock`. Moves the last entry into the hole.
+static void HIAHChildDiscard(HIAHChildRegistry *registry, HIAHChildEntry *entry) {
+    if (entry->exited) {
+        registry->stats.zombies--;
+    } else {
+        registry->stats.running--;
+    }
+    *entry = registry->entries[--registry->count];
+}
+
+// Caller holds `lock`
+static pid_t HIAHChildGroupLocked(HIAHChildRegistry *registry, pid_t pid) {
+    HIAHChildEntry *entry = HIAHChildFind(registry, pid);
+    return entry ? entry->group : pid;
+}
+
+// Caller holds `lock`. External children run elsewhere and are never a
+// parent here; their PIDs come from the kernel and may equal a host PID.
+static pid_t HIAHChildParentGroupLocked(HIAHChildRegistry *registry, pid_t parent) {
+    HIAHChildEntry *entry = HIAHChildFind(registry, parent);
+    return entry && !entry->external ? entry->group : parent;
+}
+
+/**
+ * Whether a wait by `parent` for `pid` (waitpid() selector, groups already
+ * resolved to `group`) covers `entry`.
+ */
+static bool HIAHChildMatches(const HIAHChildRegistry *registry, const HIAHChildEntry *entry,
+                             pid_t parent, pid_t pid, pid_t group) {
+    if (entry->parent != parent) {
+        return false;
+    }
+    if (pid > 0) {
+        return entry->pid == pid;
+    }
+    // Untracked, only a wait naming an external child can expect to learn
+    // of its exit
+    if (entry->external && !entry->exited && !registry->trackExternal) {
+        return false;
+    }
+    return pid == -1 || entry->group == group;
+}
+
+static pid_t HIAHChildSelectorGroup(HIAHChildRegistry *registry, pid_t parent, pid_t pid) {
+    if (pid == 0) {
+        return HIAHChildParentGroupLocked(registry, parent);
+    }
+    return pid < -1 ? -pid : 0;
+}
+
+// MARK: - Public API
+
+HIAHChildRegistry *HIAHChildRegistryCreate(pid_t firstPid, HIAHChildRegistryNotify notify,
+                                           void *context) {
+    if (firstPid <= 1) {
+        return NULL;
+    }
+    HIAHChildRegistry *registry = calloc(1, sizeof(HIAHChildRegistry));
+    if (!registry) {
+        return NULL;
+    }
+    pthread_mutex_init(&registry->lock, NULL);
+    for (int i = 0; i < HIAH_CHILD_REGISTRY_QUEUES; i++) {
+        pthread_cond_init(&registry->queues[i], NULL);
+    }
+    registry->notify = notify;
+    registry->context = context;
+    registry->firstPid = firstPid;
+    registry->nextPid = firstPid;
+    return registry;
+}
+
+void HIAHChildRegistryDestroy(HIAHChildRegistry *registry) {
+    if (!registry) {
+        return;
+    }
+    for (int i = 0; i < HIAH_CHILD_REGISTRY_QUEUES; i++) {
+        pthread_cond_destroy(&registry->queues[i]);
+    }
+    pthread_mutex_destroy(&registry->lock);
+    free(registry->entries);
+    free(registry);
+}
+
+pid_t HIAHChildRegistryAdd(HIAHChildRegistry *registry, pid_t parent, pid_t group, pid_t pid) {
+    pthread_mutex_lock(&registry->lock);
+    if (pid != 0 && HIAHChildFind(registry, pid)) {
+        pthread_mutex_unlock(&registry->lock);
+        return -1;
+    }
+    if (registry->count == registry->capacity) {
+        size_t capacity = registry->capacity ? registry->capacity * 2 : 32;
+        HIAHChildEntry *entries = realloc(registry->entries, capacity * sizeof(*entries));
+        if (!entries) {
+            pthread_mutex_unlock(&registry->lock);
+            return -1;
+        }
+        registry->entries = entries;
+        registry->capacity = capacity;
+    }
+
+    bool external = pid != 0;
+    if (!external) {
+        // Skips PIDs still held after a wrap
+        do {
+            pid = registry->nextPid;
+            registry->nextPid = pid == INT32_MAX ? registry->firstPid : pid + 1;
+        } while (HIAHChildFind(registry, pid));
+    }
+
+    // Before the entry exists, which may share the parent's PID
+    group = group < 0 ? HIAHChildParentGroupLocked(registry, parent) : (group == 0 ? pid : group);
+    HIAHChildEntry *entry = &registry->entries[registry->count++];
+    entry->pid = pid;
+    entry->parent = parent;
+    entry->group = group;
+    entry->status = 0;
+    entry->exited = false;
+    entry->external = external;
+    registry->stats.spawned++;
+    registry->stats.running++;
+    pthread_mutex_unlock(&registry->lock);
+    return pid;
+}
+
+void HIAHChildRegistryRemove(HIAHChildRegistry *registry, pid_t pid) {
+    pthread_mutex_lock(&registry->lock);
+    HIAHChildEntry *entry = HIAHChildFind(registry, pid);
+    if (entry) {
+        pid_t parent = entry->parent;
+        HIAHChildDiscard(registry, entry);
+        // A waiter may have been counting on it
+        pthread_cond_broadcast(HIAHChildQueue(registry, parent));
+    }
+    pthread_mutex_unlock(&registry->lock);
+}
+
+void HIAHChildRegistryForget(HIAHChildRegistry *registry, pid_t parent) {
+    pthread_mutex_lock(&registry->lock);
+    for (size_t i = 0; i < registry->count;) {
+        if (registry->entries[i].parent == parent) {
+            HIAHChildDiscard(registry, &registry->entries[i]);
+        } else {
+            i++;
+        }
+    }
+    pthread_cond_broadcast(HIAHChildQueue(registry, parent));
+    pthread_mutex_unlock(&registry->lock);
+}
+
+void HIAHChildRegistryTrackExternal(HIAHChildRegistry *registry, bool track) {
+    pthread_mutex_lock(&registry->lock);
+    if (registry->trackExternal != track) {
+        registry->trackExternal = track;
+        if (!track) {
+            for (size_t i = 0; i < registry->count;) {
+                HIAHChildEntry *entry = &registry->entries[i];
+                if (entry->parent == 0 && entry->external) {
+                    HIAHChildDiscard(registry, entry);
+                } else {
+                    i++;
+                }
+            }
+            // Waits blocked on running external children may have none left
+            for (int q = 0; q < HIAH_CHILD_REGISTRY_QUEUES; q++) {
+                pthread_cond_broadcast(&registry->queues[q]);
+            }
+        }
+    }
+    pthread_mutex_unlock(&registry->lock);
+}
+
+bool HIAHChildRegistryExit(HIAHChildRegistry *registry, pid_t pid, int status) {
+    pthread_mutex_lock(&registry->lock);
+    HIAHChildEntry *entry = HIAHChildFind(registry, pid);
+    if (!entry || entry->exited) {
+        pthread_mutex_unlock(&registry->lock);
+        return false;
+    }
+    entry->exited = true;
+    entry->status = status;
+    registry->stats.exited++;
+    registry->stats.running--;
+    registry->stats.zombies++;
+
+    // Its zombies can no longer be collected, nor can untracked external
+    // children whose exit only it would have reported; the rest become
+    // orphans. An external child has none here.
+    bool external = entry->external;
+    for (size_t i = 0; i < registry->count && !external;) {
+        HIAHChildEntry *child = &registry->entries[i];
+        if (child->parent != pid) {
+            i++;
+            continue;
+        }
+        if (child->exited || (child->external && !registry->trackExternal)) {
+            HIAHChildDiscard(registry, child);
+            continue;
+        }
+        registry->stats.orphaned++;
+        child->parent = 0;
+        i++;
+    }
+
+    // Discarding may have moved it
+    entry = HIAHChildFind(registry, pid);
+    pid_t parent = entry->parent;
+    if (parent == 0) {
+        HIAHChildDiscard(registry, entry);
+        pthread_mutex_unlock(&registry->lock);
+        return true;
+    }
+    pthread_cond_broadcast(HIAHChildQueue(registry, parent));
+    pthread_mutex_unlock(&registry->lock);
+
+    if (registry->notify) {
+        registry->notify(parent, pid, status, registry->context);
+    }
+    return true;
+}
+
+pid_t HIAHChildRegistryWait(HIAHChildRegistry *registry, pid_t parent, pid_t pid,
+                            int *status, int options) {
+    pthread_mutex_lock(&registry->lock);
+    registry->stats.waits++;
+    pid_t group = HIAHChildSelectorGroup(registry, parent, pid);
+    bool slept = false;
+
+    for (;;) {
+        bool matched = false;
+        for (size_t i = 0; i < registry->count; i++) {
+            HIAHChildEntry *entry = &registry->entries[i];
+            if (!HIAHChildMatches(registry, entry, parent, pid, group)) {
+                continue;
+            }
+            matched = true;
+            if (!entry->exited) {
+                continue;
+            }
+            pid_t child = entry->pid;
+            if (status) {
+                *status = entry->status;
+            }
+            HIAHChildDiscard(registry, entry);
+            registry->stats.reaped++;
+            pthread_mutex_unlock(&registry->lock);
+            return child;
+        }
+
+        if (!matched) {
+            pthread_mutex_unlock(&registry->lock);
+            errno = ECHILD;
+            return -1;
+        }
+        if (options & WNOHANG) {
+            pthread_mutex_unlock(&registry->lock);
+            return 0;
+        }
+        if (!slept) {
+            registry->stats.sleeps++;
+            slept = true;
+        }
+        pthread_cond_wait(HIAHChildQueue(registry, parent), &registry->lock);
+    }
+}
+
+bool HIAHChildRegistryHasChildren(HIAHChildRegistry *registry, pid_t parent, pid_t pid) {
+    pthread_mutex_lock(&registry->lock);
+    pid_t group = HIAHChildSelectorGroup(registry, parent, pid);
+    bool matched = false;
+    for (size_t i = 0; i < registry->count && !matched; i++) {
+        matched = HIAHChildMatches(registry, &registry->entries[i], parent, pid, group);
+    }
+    pthread_mutex_unlock(&registry->lock);
+    return matched;
+}
+
+bool HIAHChildRegistryLookup(HIAHChildRegistry *registry, pid_t pid, HIAHChildInfo *info) {
+    pthread_mutex_lock(&registry->lock);
+    HIAHChildEntry *entry = HIAHChildFind(registry, pid);
+    if (entry && info) {
+        info->parent = entry->parent;
+        info->group = entry->group;
+        info->exited = entry->exited;
+        info->external = entry->external;
+    }
+    pthread_mutex_unlock(&registry->lock);
+    return entry != NULL;
+}
+
+pid_t HIAHChildRegistryGroup(HIAHChildRegistry *registry, pid_t pid) {
+    pthread_mutex_lock(&registry->lock);
+    pid_t group = HIAHChildGroupLocked(registry, pid);
+    pthread_mutex_unlock(&registry->lock);
+    return group;
+}
+
+void HIAHChildRegistryGetStats(HIAHChildRegistry *registry, HIAHChildRegistryStats *stats) {
+    pthread_mutex_lock(&registry->lock);
+    *stats = registry->stats;
+    pthread_mutex_unlock(&registry->lock);
+}
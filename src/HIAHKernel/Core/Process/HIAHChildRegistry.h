@@ -0,0 +1,150 @@
+/**
+ * HIAHChildRegistry.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Virtual child processes and their wait queues.
+ *
+ * Guests spawned in-process run as threads of the process that spawned
+ * them, so the host kernel knows nothing of their parentage. The registry
+ * gives each one a virtual PID, records who spawned it and which process
+ * group it is in, and keeps its wait() status once it exits, until its
+ * parent collects it, exactly like a zombie.
+ *
+ * Waits follow waitpid(): a PID, any child (-1), the caller's group (0) or
+ * a given group (< -1), blocking or WNOHANG. Blocked waiters sleep on a
+ * condition variable chosen by their PID and are woken only when one of
+ * their children changes. Each exit is also reported through a callback, the
+ * place to raise SIGCHLD.
+ *
+ * A child whose parent exits first is orphaned: nobody can wait for it, so
+ * it is discarded as soon as it exits.
+ *
+ * Children that run elsewhere (forwarded to the kernel) can be added under
+ * the PID they were given. Their exit is only known once it is reported.
+ * While nothing is tracking them they are skipped by waits that name no
+ * single child, and forgotten if the parent exits first. Once their exits
+ * are tracked (see HIAHChildWatcher.h) they are waited for like any other
+ * child.
+ *
+ * This file is plain C11 and has no Apple-only dependencies so it can be
+ * built and exercised on Linux.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_CHILD_REGISTRY_H
+#define HIAH_CHILD_REGISTRY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct HIAHChildRegistry HIAHChildRegistry;
+
+/**
+ * Called after `child` exits, outside the registry's lock.
+ *
+ * @param status The child's status in wait() encoding
+ */
+typedef void (*HIAHChildRegistryNotify)(pid_t parent, pid_t child, int status, void *context);
+
+typedef struct {
+    pid_t parent;     // 0 once orphaned
+    pid_t group;
+    bool exited;
+    bool external;
+} HIAHChildInfo;
+
+typedef struct {
+    uint64_t spawned;
+    uint64_t exited;
+    uint64_t reaped;      // Collected by a wait
+    uint64_t orphaned;    // Outlived their parent
+    uint64_t waits;
+    uint64_t sleeps;      // Waits that had to block
+    uint64_t running;     // Now
+    uint64_t zombies;     // Now
+} HIAHChildRegistryStats;
+
+/**
+ * @param firstPid First virtual PID handed out; choose it above any PID
+ *                 the host or the kernel uses
+ * @param notify May be NULL
+ */
+HIAHChildRegistry *HIAHChildRegistryCreate(pid_t firstPid, HIAHChildRegistryNotify notify,
+                                           void *context);
+void HIAHChildRegistryDestroy(HIAHChildRegistry *registry);
+
+/**
+ * Records a new child of `parent`. Thread-safe.
+ *
+ * @param group < 0 to inherit the parent's group, 0 to lead a new group,
+ *              otherwise the group to join
+ * @param pid 0 to allocate a virtual PID, otherwise the PID of an external
+ *            child
+ * @return The child's PID, or -1 if `pid` is taken or memory runs out
+ */
+pid_t HIAHChildRegistryAdd(HIAHChildRegistry *registry, pid_t parent, pid_t group, pid_t pid);
+
+/**
+ * Forgets a child without reporting it, e.g. when it could not be started.
+ */
+void HIAHChildRegistryRemove(HIAHChildRegistry *registry, pid_t pid);
+
+/**
+ * Forgets every child of `parent`, running or not, without reporting them.
+ */
+void HIAHChildRegistryForget(HIAHChildRegistry *registry, pid_t parent);
+
+/**
+ * Whether every external child's exit will be reported. When it is turned
+ * off, blocked waiters look again and orphaned external children, whose
+ * exit nobody would report, are dropped.
+ */
+void HIAHChildRegistryTrackExternal(HIAHChildRegistry *registry, bool track);
+
+/**
+ * Records that `pid` exited, wakes its parent's waiters and reports it.
+ * Its own children are orphaned. Thread-safe.
+ *
+ * @param status wait() encoding, e.g. W_EXITCODE(code, 0)
+ * @return false if `pid` is unknown or already exited
+ */
+bool HIAHChildRegistryExit(HIAHChildRegistry *registry, pid_t pid, int status);
+
+/**
+ * waitpid() for `parent`'s children. Thread-safe.
+ *
+ * @param options WNOHANG; other flags are ignored
+ * @return The collected child's PID, 0 under WNOHANG while every matching
+ *         child is running, or -1 with errno ECHILD when none matches
+ */
+pid_t HIAHChildRegistryWait(HIAHChildRegistry *registry, pid_t parent, pid_t pid,
+                            int *status, int options);
+
+/**
+ * Whether a wait by `parent` for `pid` would have a child to wait for.
+ */
+bool HIAHChildRegistryHasChildren(HIAHChildRegistry *registry, pid_t parent, pid_t pid);
+
+bool HIAHChildRegistryLookup(HIAHChildRegistry *registry, pid_t pid, HIAHChildInfo *info);
+
+/**
+ * The process group of `pid`; processes the registry does not know lead
+ * their own.
+ */
+pid_t HIAHChildRegistryGroup(HIAHChildRegistry *registry, pid_t pid);
+
+void HIAHChildRegistryGetStats(HIAHChildRegistry *registry, HIAHChildRegistryStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_CHILD_REGISTRY_H */
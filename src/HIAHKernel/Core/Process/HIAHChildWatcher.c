@@ -0,0 +1,186 @@
+/**
+ * HIAHChildWatcher.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Reports the exits of forwarded children to a HIAHChildRegistry.
+ *
+ * One lock orders spawns against exits. The thread is detached and started
+ * again after it stops; `spawns` tells it whether a child was recorded
+ * while the kernel was saying none were left.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHChildWatcher.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct {
+    pid_t pid;
+    int status;
+} HIAHHeldExit;
+
+struct HIAHChildWatcher {
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+    HIAHChildRegistry *registry;
+    HIAHChildWatcherWait wait;
+    void *context;
+
+    bool running;
+    pid_t owner;              // Process the thread runs in; a fork has none
+    size_t inFlight;          // Spawns not yet recorded
+
+    HIAHHeldExit *held;       // Exits of children not yet recorded
+    size_t heldCount;
+    size_t heldCapacity;
+
+    HIAHChildWatcherStats stats;
+};
+
+// Caller holds `lock`. Lost if memory runs out; the child then waits for a
+// wait that names it.
+static void HIAHChildWatcherHold(HIAHChildWatcher *watcher, pid_t pid, int status) {
+    if (watcher->heldCount == watcher->heldCapacity) {
+        size_t capacity = watcher->heldCapacity ? watcher->heldCapacity * 2 : 8;
+        HIAHHeldExit *held = realloc(watcher->held, capacity * sizeof(*held));
+        if (!held) {
+            return;
+        }
+        watcher->held = held;
+        watcher->heldCapacity = capacity;
+    }
+    watcher->held[watcher->heldCount++] = (HIAHHeldExit){ pid, status };
+}
+
+static void *HIAHChildWatcherThread(void *data) {
+    HIAHChildWatcher *watcher = data;
+    pthread_mutex_lock(&watcher->lock);
+    for (;;) {
+        uint64_t seen = watcher->stats.spawns;
+        pthread_mutex_unlock(&watcher->lock);
+        int status = 0;
+        pid_t pid = watcher->wait(&status, watcher->context);
+        pthread_mutex_lock(&watcher->lock);
+
+        if (pid > 0) {
+            watcher->stats.exits++;
+            // Unknown while its spawn has yet to be recorded; known and
+            // exited if a wait naming it got there first
+            if (!HIAHChildRegistryExit(watcher->registry, pid, status) && watcher->inFlight > 0) {
+                HIAHChildWatcherHold(watcher, pid, status);
+            }
+            continue;
+        }
+        if (pid < 0) {
+            watcher->stats.failures++;
+        }
+        // A child recorded meanwhile may not have been known to that wait
+        if (watcher->stats.spawns != seen) {
+            continue;
+        }
+        if (pid < 0) {
+            HIAHChildRegistryTrackExternal(watcher->registry, false);
+        }
+        break;
+    }
+    watcher->running = false;
+    pthread_cond_broadcast(&watcher->idle);
+    pthread_mutex_unlock(&watcher->lock);
+    return NULL;
+}
+
+// Caller holds `lock`
+static void HIAHChildWatcherStart(HIAHChildWatcher *watcher) {
+    if (watcher->running && watcher->owner == getpid()) {
+        return;
+    }
+    watcher->running = true;
+    watcher->owner = getpid();
+    watcher->stats.threads++;
+    HIAHChildRegistryTrackExternal(watcher->registry, true);
+
+    pthread_attr_t attr;
+    pthread_t thread;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    if (pthread_create(&thread, &attr, HIAHChildWatcherThread, watcher) != 0) {
+        watcher->running = false;
+        watcher->stats.failures++;
+        HIAHChildRegistryTrackExternal(watcher->registry, false);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+// MARK: - Public API
+
+HIAHChildWatcher *HIAHChildWatcherCreate(HIAHChildRegistry *registry, HIAHChildWatcherWait wait,
+                                         void *context) {
+    if (!registry || !wait) {
+        return NULL;
+    }
+    HIAHChildWatcher *watcher = calloc(1, sizeof(HIAHChildWatcher));
+    if (!watcher) {
+        return NULL;
+    }
+    pthread_mutex_init(&watcher->lock, NULL);
+    pthread_cond_init(&watcher->idle, NULL);
+    watcher->registry = registry;
+    watcher->wait = wait;
+    watcher->context = context;
+    return watcher;
+}
+
+void HIAHChildWatcherDestroy(HIAHChildWatcher *watcher) {
+    if (!watcher) {
+        return;
+    }
+    pthread_mutex_lock(&watcher->lock);
+    while (watcher->running && watcher->owner == getpid()) {
+        pthread_cond_wait(&watcher->idle, &watcher->lock);
+    }
+    pthread_mutex_unlock(&watcher->lock);
+    pthread_cond_destroy(&watcher->idle);
+    pthread_mutex_destroy(&watcher->lock);
+    free(watcher->held);
+    free(watcher);
+}
+
+void HIAHChildWatcherWillSpawn(HIAHChildWatcher *watcher) {
+    pthread_mutex_lock(&watcher->lock);
+    watcher->inFlight++;
+    pthread_mutex_unlock(&watcher->lock);
+}
+
+pid_t HIAHChildWatcherDidSpawn(HIAHChildWatcher *watcher, pid_t parent, pid_t group, pid_t pid) {
+    pthread_mutex_lock(&watcher->lock);
+    pid_t added = pid > 0 ? HIAHChildRegistryAdd(watcher->registry, parent, group, pid) : -1;
+    if (added > 0) {
+        watcher->stats.spawns++;
+        for (size_t i = 0; i < watcher->heldCount; i++) {
+            if (watcher->held[i].pid == added) {
+                watcher->stats.early++;
+                HIAHChildRegistryExit(watcher->registry, added, watcher->held[i].status);
+                watcher->held[i] = watcher->held[--watcher->heldCount];
+                break;
+            }
+        }
+        HIAHChildWatcherStart(watcher);
+    }
+    // With no spawn left to claim them, held exits belong to children that
+    // were already collected
+    if (watcher->inFlight > 0 && --watcher->inFlight == 0) {
+        watcher->heldCount = 0;
+    }
+    pthread_mutex_unlock(&watcher->lock);
+    return added;
+}
+
+void HIAHChildWatcherGetStats(HIAHChildWatcher *watcher, HIAHChildWatcherStats *stats) {
+    pthread_mutex_lock(&watcher->lock);
+    *stats = watcher->stats;
+    pthread_mutex_unlock(&watcher->lock);
+}
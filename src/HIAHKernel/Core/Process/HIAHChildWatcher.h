@@ -0,0 +1,91 @@
+/**
+ * HIAHChildWatcher.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Reports the exits of forwarded children to a HIAHChildRegistry.
+ *
+ * Children forwarded to the kernel run outside this process, so the
+ * registry cannot see them exit. The kernel keeps its own registry of them,
+ * by the physical PID that asked for each spawn, and answers a wait for any
+ * one of them. While this process has forwarded children, a watcher thread
+ * makes that wait over and over and records each exit in the local
+ * registry, which then treats the children like in-process ones: waits for
+ * any child or a group see them, and SIGCHLD is raised.
+ *
+ * The thread starts with the first forwarded spawn and stops once the
+ * kernel says none are left. If the kernel cannot be asked, it stops
+ * tracking them, so waits fall back to naming the child; the next spawn
+ * tries again.
+ *
+ * The kernel may report an exit before the spawn that started the child has
+ * returned. Exits of unknown children are held while a spawn is in flight
+ * and applied when it is recorded.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_CHILD_WATCHER_H
+#define HIAH_CHILD_WATCHER_H
+
+#include "HIAHChildRegistry.h"
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct HIAHChildWatcher HIAHChildWatcher;
+
+/**
+ * Waits for any forwarded child of this process to exit. Called on the
+ * watcher thread, without its lock.
+ *
+ * @param status Receives the child's status in wait() encoding
+ * @return The child's PID, 0 when this process has no forwarded children
+ *         left, or -1 if the kernel cannot be asked
+ */
+typedef pid_t (*HIAHChildWatcherWait)(int *status, void *context);
+
+typedef struct {
+    uint64_t spawns;      // Forwarded children recorded
+    uint64_t exits;       // Exits reported by the kernel
+    uint64_t early;       // Of those, reported before their spawn returned
+    uint64_t threads;     // Watcher threads started
+    uint64_t failures;    // Times the kernel could not be asked
+} HIAHChildWatcherStats;
+
+HIAHChildWatcher *HIAHChildWatcherCreate(HIAHChildRegistry *registry, HIAHChildWatcherWait wait,
+                                         void *context);
+
+/**
+ * Waits for the watcher thread to stop, then frees the watcher. The wait
+ * callback must be about to report that no children are left.
+ */
+void HIAHChildWatcherDestroy(HIAHChildWatcher *watcher);
+
+/**
+ * Call before asking the kernel for a spawn. Thread-safe.
+ */
+void HIAHChildWatcherWillSpawn(HIAHChildWatcher *watcher);
+
+/**
+ * Call once the spawn returned: records the child in the registry (see
+ * HIAHChildRegistryAdd()) and makes sure its exit is watched for.
+ * Thread-safe.
+ *
+ * @param pid The child's PID, or <= 0 if the spawn failed
+ * @return The result of HIAHChildRegistryAdd(), or -1 if the spawn failed
+ */
+pid_t HIAHChildWatcherDidSpawn(HIAHChildWatcher *watcher, pid_t parent, pid_t group, pid_t pid);
+
+void HIAHChildWatcherGetStats(HIAHChildWatcher *watcher, HIAHChildWatcherStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_CHILD_WATCHER_H */
@@ -0,0 +1,122 @@
+/**
+ * HIAHOutputChannel.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * socketpair-backed guest output channels.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHOutputChannel.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static void HIAHOutputChannelCloseFd(int *fd) {
+    if (*fd >= 0) {
+        close(*fd);
+        *fd = -1;
+    }
+}
+
+bool HIAHOutputChannelOpen(HIAHOutputChannel *channel, int *error) {
+    for (int i = 0; i < HIAHOutputStreamCount; i++) {
+        channel->guestFds[i] = channel->kernelFds[i] = -1;
+    }
+
+    for (int i = 0; i < HIAHOutputStreamCount; i++) {
+        int pair[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0) {
+            if (error) *error = errno;
+            HIAHOutputChannelCloseGuest(channel);
+            HIAHOutputChannelCloseKernel(channel);
+            return false;
+        }
+        channel->kernelFds[i] = pair[0];
+        channel->guestFds[i] = pair[1];
+
+        // One-way: the guest only writes, the kernel only reads
+        shutdown(pair[0], SHUT_WR);
+        shutdown(pair[1], SHUT_RD);
+        fcntl(pair[0], F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+        // A guest writing after the kernel went away gets EPIPE, not a signal
+        int on = 1;
+        setsockopt(pair[1], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+    }
+    return true;
+}
+
+void HIAHOutputChannelCloseGuest(HIAHOutputChannel *channel) {
+    for (int i = 0; i < HIAHOutputStreamCount; i++) {
+        HIAHOutputChannelCloseFd(&channel->guestFds[i]);
+    }
+}
+
+void HIAHOutputChannelCloseKernel(HIAHOutputChannel *channel) {
+    for (int i = 0; i < HIAHOutputStreamCount; i++) {
+        HIAHOutputChannelCloseFd(&channel->kernelFds[i]);
+    }
+}
+
+/**
+ * Moves what is readable on `fd` into the ring.
+ *
+ * @return false once the stream is finished
+ */
+static bool HIAHOutputChannelDrain(int fd, HIAHOutputRing *ring) {
+    struct iovec regions[2];
+    int count = HIAHOutputRingReserve(ring, regions);
+    if (count == 0) {
+        if (HIAHOutputRingWaitWritable(ring)) {
+            return true;
+        }
+        // Consumer gone: discard so the guest never blocks on us
+        char sink[4096];
+        ssize_t n = read(fd, sink, sizeof(sink));
+        return n > 0 || (n < 0 && errno == EINTR);
+    }
+
+    ssize_t n = readv(fd, regions, count);
+    if (n > 0) {
+        HIAHOutputRingCommit(ring, (size_t)n);
+        return true;
+    }
+    return n < 0 && (errno == EINTR || errno == EAGAIN);
+}
+
+void HIAHOutputChannelPump(HIAHOutputChannel *channel, HIAHOutputRing *ring) {
+    struct pollfd fds[HIAHOutputStreamCount];
+    int open = 0;
+    for (int i = 0; i < HIAHOutputStreamCount; i++) {
+        fds[i].fd = channel->kernelFds[i];
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+        if (fds[i].fd >= 0) {
+            open++;
+        }
+    }
+
+    while (open > 0) {
+        if (poll(fds, HIAHOutputStreamCount, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        for (int i = 0; i < HIAHOutputStreamCount; i++) {
+            if (fds[i].fd < 0 || fds[i].revents == 0) {
+                continue;
+            }
+            if (!HIAHOutputChannelDrain(fds[i].fd, ring)) {
+                fds[i].fd = -1;   // poll() skips negative descriptors
+                open--;
+            }
+        }
+    }
+    HIAHOutputRingClose(ring);
+}
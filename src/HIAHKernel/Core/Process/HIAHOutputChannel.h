@@ -0,0 +1,68 @@
+/**
+ * HIAHOutputChannel.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Pre-connected stdout/stderr channels for guest processes.
+ *
+ * A channel is two socketpairs, one per stream. The guest gets the write
+ * ends and the kernel keeps the read ends, so nothing is bound in the file
+ * system and no thread has to wait in accept() for the guest to connect.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_OUTPUT_CHANNEL_H
+#define HIAH_OUTPUT_CHANNEL_H
+
+#include "HIAHOutputRing.h"
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    HIAHOutputStreamStdout = 0,
+    HIAHOutputStreamStderr = 1,
+    HIAHOutputStreamCount  = 2,
+} HIAHOutputStream;
+
+typedef struct {
+    int guestFds[HIAHOutputStreamCount];    // Write ends, handed to the guest
+    int kernelFds[HIAHOutputStreamCount];   // Read ends, close-on-exec
+} HIAHOutputChannel;
+
+/**
+ * Opens both streams. On failure nothing is left open.
+ *
+ * @param error Receives errno on failure (may be NULL)
+ */
+bool HIAHOutputChannelOpen(HIAHOutputChannel *channel, int *error);
+
+/**
+ * Closes the guest's ends. Call once the guest has exited (or has its own
+ * copies), so the kernel side sees EOF.
+ */
+void HIAHOutputChannelCloseGuest(HIAHOutputChannel *channel);
+
+/**
+ * Closes the kernel's ends.
+ */
+void HIAHOutputChannelCloseKernel(HIAHOutputChannel *channel);
+
+/**
+ * Reads both streams into `ring`, in arrival order, until both reach EOF;
+ * then closes the ring. Blocks the calling thread, and blocks on a full ring
+ * so the guest is throttled instead of buffered without bound. If the
+ * ring's consumer cancels, the remaining output is discarded.
+ */
+void HIAHOutputChannelPump(HIAHOutputChannel *channel, HIAHOutputRing *ring);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_OUTPUT_CHANNEL_H */
@@ -0,0 +1,255 @@
+/**
+ * HIAHOutputRing.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * SPSC output ring implementation.
+ *
+ * `head` and `tail` are free-running 64-bit byte counters; only the producer
+ * stores `head` and only the consumer stores `tail`. The two handshakes
+ * (consumer armed / producer waiting) are Dekker-style: each side publishes
+ * its flag and then re-checks the other side's counter with sequentially
+ * consistent ordering, so a wakeup cannot be lost. The mutex is only taken
+ * by a producer that is about to sleep and by the consumer that wakes it.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHOutputRing.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIAH_OUTPUT_RING_CACHE_LINE 64
+
+struct HIAHOutputRing {
+    // Producer-owned
+    _Alignas(HIAH_OUTPUT_RING_CACHE_LINE) _Atomic uint64_t head;
+    _Atomic uint64_t notifications;
+    _Atomic uint64_t stalls;
+
+    // Consumer-owned
+    _Alignas(HIAH_OUTPUT_RING_CACHE_LINE) _Atomic uint64_t tail;
+
+    // Shared handshake state
+    _Alignas(HIAH_OUTPUT_RING_CACHE_LINE) _Atomic bool consumerArmed;
+    _Atomic bool producerWaiting;
+    _Atomic bool closed;
+    _Atomic bool cancelled;
+    _Atomic int refCount;
+
+    uint8_t *data;
+    size_t capacity;
+    size_t mask;
+    HIAHOutputRingNotify notify;
+    void *context;
+    pthread_mutex_t lock;
+    pthread_cond_t writable;
+};
+
+HIAHOutputRing *HIAHOutputRingCreate(size_t capacity, HIAHOutputRingNotify notify, void *context) {
+    if (capacity == 0) {
+        capacity = HIAH_OUTPUT_RING_DEFAULT_CAPACITY;
+    }
+    size_t rounded = 4096;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+
+    HIAHOutputRing *ring = aligned_alloc(HIAH_OUTPUT_RING_CACHE_LINE,
+                                         (sizeof(HIAHOutputRing) + HIAH_OUTPUT_RING_CACHE_LINE - 1) &
+                                             ~(size_t)(HIAH_OUTPUT_RING_CACHE_LINE - 1));
+    if (!ring) {
+        return NULL;
+    }
+    memset(ring, 0, sizeof(*ring));
+    ring->data = malloc(rounded);
+    if (!ring->data) {
+        free(ring);
+        return NULL;
+    }
+    ring->capacity = rounded;
+    ring->mask = rounded - 1;
+    ring->notify = notify;
+    ring->context = context;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->consumerArmed, true);
+    atomic_init(&ring->producerWaiting, false);
+    atomic_init(&ring->closed, false);
+    atomic_init(&ring->cancelled, false);
+    atomic_init(&ring->refCount, 1);
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->writable, NULL);
+    return ring;
+}
+
+HIAHOutputRing *HIAHOutputRingRetain(HIAHOutputRing *ring) {
+    if (ring) {
+        atomic_fetch_add_explicit(&ring->refCount, 1, memory_order_relaxed);
+    }
+    return ring;
+}
+
+void HIAHOutputRingRelease(HIAHOutputRing *ring) {
+    if (!ring || atomic_fetch_sub_explicit(&ring->refCount, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->writable);
+    free(ring->data);
+    free(ring);
+}
+
+/**
+ * Splits [position, position + length) into at most two contiguous regions.
+ */
+static int HIAHOutputRingRegions(HIAHOutputRing *ring, uint64_t position, size_t length,
+                                 struct iovec regions[2]) {
+    if (length == 0) {
+        return 0;
+    }
+    size_t offset = (size_t)(position & ring->mask);
+    size_t first = ring->capacity - offset;
+    regions[0].iov_base = ring->data + offset;
+    if (length <= first) {
+        regions[0].iov_len = length;
+        return 1;
+    }
+    regions[0].iov_len = first;
+    regions[1].iov_base = ring->data;
+    regions[1].iov_len = length - first;
+    return 2;
+}
+
+static void HIAHOutputRingSignalConsumer(HIAHOutputRing *ring) {
+    if (atomic_exchange(&ring->consumerArmed, false)) {
+        atomic_fetch_add_explicit(&ring->notifications, 1, memory_order_relaxed);
+        if (ring->notify) {
+            ring->notify(ring, ring->context);
+        }
+    }
+}
+
+// MARK: - Producer
+
+int HIAHOutputRingReserve(HIAHOutputRing *ring, struct iovec regions[2]) {
+    if (atomic_load_explicit(&ring->cancelled, memory_order_relaxed)) {
+        return 0;
+    }
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return HIAHOutputRingRegions(ring, head, ring->capacity - (size_t)(head - tail), regions);
+}
+
+void HIAHOutputRingCommit(HIAHOutputRing *ring, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store(&ring->head, head + length);   // seq_cst: pairs with Arm()
+    HIAHOutputRingSignalConsumer(ring);
+}
+
+size_t HIAHOutputRingWrite(HIAHOutputRing *ring, const void *data, size_t length) {
+    struct iovec regions[2];
+    int count = HIAHOutputRingReserve(ring, regions);
+    size_t copied = 0;
+    for (int i = 0; i < count && copied < length; i++) {
+        size_t chunk = length - copied < regions[i].iov_len ? length - copied : regions[i].iov_len;
+        memcpy(regions[i].iov_base, (const uint8_t *)data + copied, chunk);
+        copied += chunk;
+    }
+    HIAHOutputRingCommit(ring, copied);
+    return copied;
+}
+
+bool HIAHOutputRingWaitWritable(HIAHOutputRing *ring) {
+    pthread_mutex_lock(&ring->lock);
+    atomic_store(&ring->producerWaiting, true);   // seq_cst: pairs with Consume()
+    bool stalled = false;
+    while (!atomic_load(&ring->cancelled) &&
+           atomic_load(&ring->head) - atomic_load(&ring->tail) == ring->capacity) {
+        stalled = true;
+        pthread_cond_wait(&ring->writable, &ring->lock);
+    }
+    atomic_store_explicit(&ring->producerWaiting, false, memory_order_relaxed);
+    pthread_mutex_unlock(&ring->lock);
+    if (stalled) {
+        atomic_fetch_add_explicit(&ring->stalls, 1, memory_order_relaxed);
+    }
+    return !atomic_load(&ring->cancelled);
+}
+
+void HIAHOutputRingClose(HIAHOutputRing *ring) {
+    atomic_store(&ring->closed, true);
+    HIAHOutputRingSignalConsumer(ring);
+}
+
+// MARK: - Consumer
+
+int HIAHOutputRingPeek(HIAHOutputRing *ring, struct iovec regions[2]) {
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return HIAHOutputRingRegions(ring, tail, (size_t)(head - tail), regions);
+}
+
+void HIAHOutputRingConsume(HIAHOutputRing *ring, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    uint64_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store(&ring->tail, tail + length);   // seq_cst: pairs with WaitWritable()
+    if (atomic_load(&ring->producerWaiting)) {
+        pthread_mutex_lock(&ring->lock);
+        pthread_cond_signal(&ring->writable);
+        pthread_mutex_unlock(&ring->lock);
+    }
+}
+
+bool HIAHOutputRingArm(HIAHOutputRing *ring, size_t unconsumed) {
+    atomic_store(&ring->consumerArmed, true);
+    if (atomic_load(&ring->head) - atomic_load_explicit(&ring->tail, memory_order_relaxed) <= unconsumed &&
+        !atomic_load(&ring->closed)) {
+        return true;
+    }
+    // Data raced in. If the producer already took the flag it will notify;
+    // otherwise take it back and keep draining.
+    return !atomic_exchange(&ring->consumerArmed, false);
+}
+
+bool HIAHOutputRingDisarm(HIAHOutputRing *ring) {
+    return atomic_exchange(&ring->consumerArmed, false);
+}
+
+bool HIAHOutputRingIsClosed(HIAHOutputRing *ring) {
+    return atomic_load(&ring->closed);
+}
+
+bool HIAHOutputRingAtEOF(HIAHOutputRing *ring) {
+    return atomic_load(&ring->closed) &&
+           atomic_load(&ring->head) == atomic_load_explicit(&ring->tail, memory_order_relaxed);
+}
+
+void HIAHOutputRingCancel(HIAHOutputRing *ring) {
+    atomic_store(&ring->cancelled, true);
+    pthread_mutex_lock(&ring->lock);
+    pthread_cond_broadcast(&ring->writable);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+bool HIAHOutputRingIsCancelled(HIAHOutputRing *ring) {
+    return atomic_load_explicit(&ring->cancelled, memory_order_relaxed);
+}
+
+void HIAHOutputRingGetStats(HIAHOutputRing *ring, HIAHOutputRingStats *stats) {
+    uint64_t head = atomic_load(&ring->head);
+    uint64_t tail = atomic_load(&ring->tail);
+    stats->written = head;
+    stats->consumed = tail;
+    stats->notifications = atomic_load_explicit(&ring->notifications, memory_order_relaxed);
+    stats->stalls = atomic_load_explicit(&ring->stalls, memory_order_relaxed);
+    stats->buffered = (size_t)(head - tail);
+    stats->capacity = ring->capacity;
+}
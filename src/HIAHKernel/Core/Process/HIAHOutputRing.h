@@ -0,0 +1,158 @@
+/**
+ * HIAHOutputRing.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Single-producer / single-consumer byte ring for guest output.
+ *
+ * Every virtual process owns one ring. The kernel's output pump is the only
+ * producer and reads from the guest's socket straight into the free space
+ * (readv-style reserve/commit); a single consumer peeks at the buffered bytes
+ * in place and consumes them at its own pace. Neither side takes a lock on
+ * the fast path.
+ *
+ * Wakeups are coalesced: the consumer arms the ring once it has drained it,
+ * and the producer fires the notify callback only for the first commit after
+ * that. When the ring is full the producer blocks until the consumer frees
+ * space, so a guest that floods output ends up blocked in write() instead
+ * of growing memory.
+ *
+ * Plain C11, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_OUTPUT_RING_H
+#define HIAH_OUTPUT_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Default ring size per process.
+ */
+#define HIAH_OUTPUT_RING_DEFAULT_CAPACITY (256u * 1024)
+
+typedef struct HIAHOutputRing HIAHOutputRing;
+
+/**
+ * Called on the producer's thread when an armed ring receives data or is
+ * closed. Should only schedule the consumer, not drain inline.
+ */
+typedef void (*HIAHOutputRingNotify)(HIAHOutputRing *ring, void *context);
+
+typedef struct {
+    uint64_t written;         // Bytes committed by the producer
+    uint64_t consumed;        // Bytes consumed
+    uint64_t notifications;   // Coalesced consumer wakeups
+    uint64_t stalls;          // Times the producer blocked on a full ring
+    size_t buffered;
+    size_t capacity;
+} HIAHOutputRingStats;
+
+/**
+ * Creates a ring with one reference. `capacity` is rounded up to a power of
+ * two (0 = HIAH_OUTPUT_RING_DEFAULT_CAPACITY). The ring starts armed.
+ */
+HIAHOutputRing *HIAHOutputRingCreate(size_t capacity, HIAHOutputRingNotify notify, void *context);
+
+HIAHOutputRing *HIAHOutputRingRetain(HIAHOutputRing *ring);
+void HIAHOutputRingRelease(HIAHOutputRing *ring);
+
+// MARK: - Producer
+
+/**
+ * Describes the free space as up to two regions, ready for readv().
+ *
+ * @return Number of regions filled (0 if the ring is full or cancelled)
+ */
+int HIAHOutputRingReserve(HIAHOutputRing *ring, struct iovec regions[2]);
+
+/**
+ * Publishes `length` bytes written into the reserved regions.
+ */
+void HIAHOutputRingCommit(HIAHOutputRing *ring, size_t length);
+
+/**
+ * Copies as much of `data` as fits.
+ *
+ * @return Bytes copied
+ */
+size_t HIAHOutputRingWrite(HIAHOutputRing *ring, const void *data, size_t length);
+
+/**
+ * Blocks until the ring has free space.
+ *
+ * @return false if the consumer cancelled the ring
+ */
+bool HIAHOutputRingWaitWritable(HIAHOutputRing *ring);
+
+/**
+ * Marks end of output. The consumer sees EOF once it has drained the ring.
+ */
+void HIAHOutputRingClose(HIAHOutputRing *ring);
+
+// MARK: - Consumer
+
+/**
+ * Describes the buffered bytes as up to two regions, oldest first. The bytes
+ * stay valid until they are consumed.
+ *
+ * @return Number of regions filled (0 if empty)
+ */
+int HIAHOutputRingPeek(HIAHOutputRing *ring, struct iovec regions[2]);
+
+/**
+ * Releases `length` peeked bytes back to the producer.
+ */
+void HIAHOutputRingConsume(HIAHOutputRing *ring, size_t length);
+
+/**
+ * Requests a notification for the next data or EOF. Call after draining.
+ *
+ * @param unconsumed Bytes the consumer deliberately left in the ring (e.g. an
+ *                   incomplete UTF-8 sequence); they do not count as new data
+ * @return true if armed; false if new data (or EOF) is already waiting, in
+ *         which case keep draining instead of sleeping
+ */
+bool HIAHOutputRingArm(HIAHOutputRing *ring, size_t unconsumed);
+
+/**
+ * Takes back an armed notification.
+ *
+ * @return true if the ring was armed, in which case the caller is now the
+ *         one responsible for draining it
+ */
+bool HIAHOutputRingDisarm(HIAHOutputRing *ring);
+
+/**
+ * @return true once the producer has closed the ring
+ */
+bool HIAHOutputRingIsClosed(HIAHOutputRing *ring);
+
+/**
+ * @return true once the producer has closed the ring and it is empty
+ */
+bool HIAHOutputRingAtEOF(HIAHOutputRing *ring);
+
+/**
+ * Gives up on the ring. A blocked producer is released and further output
+ * is discarded by the producer.
+ */
+void HIAHOutputRingCancel(HIAHOutputRing *ring);
+
+bool HIAHOutputRingIsCancelled(HIAHOutputRing *ring);
+
+void HIAHOutputRingGetStats(HIAHOutputRing *ring, HIAHOutputRingStats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_OUTPUT_RING_H */
@@ -0,0 +1,807 @@
+/**
+ * HIAHProcessTable.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Sharded, read-mostly virtual process table implementation.
+ *
+ * Layout:
+ * 1. Three indexes (virtual PID, physical PID, request UUID), each split
+ *    into HIAH_PROCESS_TABLE_SHARDS shards
+ * 2. A shard is an immutable open-addressing array of entry pointers,
+ *    replaced wholesale by writers (copy-on-write, one shard per index)
+ * 3. Entries are immutable; changing a key publishes a new entry
+ * 4. The physical PID index holds one group per distinct physical PID, so
+ *    in-process guests that all share getpid() cost one slot, and joining
+ *    or leaving an existing group does not copy a shard
+ * 5. Readers are tracked with striped counters in two phases; writers wait
+ *    for the old phase to drain before freeing what they retired
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHProcessTable.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIAH_PT_INDEX_PID      0
+#define HIAH_PT_INDEX_PHYSICAL 1
+#define HIAH_PT_INDEX_UUID     2
+#define HIAH_PT_INDEX_COUNT    3
+
+#define HIAH_PT_READER_STRIPES 16
+#define HIAH_PT_CACHE_LINE     64
+#define HIAH_PT_MIN_CAPACITY   8
+
+// Old shards per index touched by one write: the old key's shard and the new one's
+#define HIAH_PT_MAX_RETIRED_SHARDS (HIAH_PT_INDEX_COUNT * 2)
+
+typedef struct {
+    HIAHProcessTableKey key;
+    void *value;
+    size_t groupSlot;   // Writer-only: position in its physical group
+} HIAHProcessTableEntry;
+
+/**
+ * Every entry sharing one physical PID. Readers only look at `latest`, the
+ * member with the highest virtual PID; the member array is writer-only.
+ */
+typedef struct {
+    pid_t physicalPid;
+    _Atomic(const HIAHProcessTableEntry *) latest;
+    size_t count;
+    size_t capacity;
+    HIAHProcessTableEntry **members;
+} HIAHProcessTableGroup;
+
+/**
+ * Slots hold entries in the PID and UUID indexes and groups in the
+ * physical PID index.
+ */
+typedef struct {
+    size_t count;
+    size_t mask;
+    const void *slots[];
+} HIAHProcessTableShard;
+
+typedef struct {
+    _Atomic long count;
+    char padding[HIAH_PT_CACHE_LINE - sizeof(long)];
+} HIAHProcessTableReaderStripe;
+
+struct HIAHProcessTable {
+    HIAHProcessTableCallbacks callbacks;
+
+    _Atomic(HIAHProcessTableShard *) shards[HIAH_PT_INDEX_COUNT][HIAH_PROCESS_TABLE_SHARDS];
+
+    _Atomic uint64_t generation;
+    _Atomic size_t count;
+    _Atomic pid_t nextPid;
+
+    pthread_mutex_t writeLock;
+
+    // Grace-period tracking
+    pthread_mutex_t graceLock;
+    _Atomic unsigned phase;
+    HIAHProcessTableReaderStripe readers[2][HIAH_PT_READER_STRIPES];
+};
+
+typedef struct {
+    HIAHProcessTableShard *shards[HIAH_PT_MAX_RETIRED_SHARDS];
+    size_t shardCount;
+    HIAHProcessTableEntry *entry;
+    HIAHProcessTableGroup *group;
+} HIAHProcessTableRetired;
+
+// MARK: - Hashing
+
+static inline uint32_t HIAHProcessTableMix32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+static inline uint32_t HIAHProcessTableHashUUID(const uint8_t *uuid) {
+    uint64_t lo, hi;
+    memcpy(&lo, uuid, sizeof(lo));
+    memcpy(&hi, uuid + sizeof(lo), sizeof(hi));
+    uint64_t x = lo ^ (hi * 0x9e3779b97f4a7c15ULL);
+    return HIAHProcessTableMix32((uint32_t)x ^ (uint32_t)(x >> 32));
+}
+
+/**
+ * Returns false if the key does not participate in the given index.
+ */
+static bool HIAHProcessTableHashKey(const HIAHProcessTableKey *key, int index, uint32_t *hash) {
+    switch (index) {
+        case HIAH_PT_INDEX_PID:
+            *hash = HIAHProcessTableMix32((uint32_t)key->pid);
+            return true;
+        case HIAH_PT_INDEX_PHYSICAL:
+            if (key->physicalPid <= 0) return false;
+            *hash = HIAHProcessTableMix32((uint32_t)key->physicalPid);
+            return true;
+        case HIAH_PT_INDEX_UUID:
+            if (!key->hasRequestIdentifier) return false;
+            *hash = HIAHProcessTableHashUUID(key->requestIdentifier);
+            return true;
+        default:
+            return false;
+    }
+}
+
+static bool HIAHProcessTableHashItem(const void *item, int index, uint32_t *hash) {
+    if (index == HIAH_PT_INDEX_PHYSICAL) {
+        *hash = HIAHProcessTableMix32((uint32_t)((const HIAHProcessTableGroup *)item)->physicalPid);
+        return true;
+    }
+    return HIAHProcessTableHashKey(&((const HIAHProcessTableEntry *)item)->key, index, hash);
+}
+
+static inline size_t HIAHProcessTableShardIndex(uint32_t hash) {
+    // Low bits pick the shard, high bits the slot within it
+    return hash & (HIAH_PROCESS_TABLE_SHARDS - 1);
+}
+
+static inline size_t HIAHProcessTableSlotStart(uint32_t hash, size_t mask) {
+    return (hash >> 4) & mask;
+}
+
+// MARK: - Read-Side Sections
+
+static unsigned HIAHProcessTableReaderStripeIndex(void) {
+    static _Atomic unsigned nextStripe = 0;
+    static _Thread_local unsigned stripe = UINT32_MAX;
+    if (stripe == UINT32_MAX) {
+        stripe = atomic_fetch_add_explicit(&nextStripe, 1, memory_order_relaxed) % HIAH_PT_READER_STRIPES;
+    }
+    return stripe;
+}
+
+static inline _Atomic long *HIAHProcessTableReadLock(HIAHProcessTable *table) {
+    unsigned phase = atomic_load(&table->phase) & 1;
+    _Atomic long *counter = &table->readers[phase][HIAHProcessTableReaderStripeIndex()].count;
+    atomic_fetch_add(counter, 1);
+    return counter;
+}
+
+static inline void HIAHProcessTableReadUnlock(_Atomic long *counter) {
+    atomic_fetch_sub_explicit(counter, 1, memory_order_release);
+}
+
+static void HIAHProcessTableWaitForReaders(HIAHProcessTable *table, unsigned phase) {
+    for (unsigned i = 0; i < HIAH_PT_READER_STRIPES; i++) {
+        while (atomic_load(&table->readers[phase][i].count) != 0) {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * Waits until every reader that could have observed a retired pointer has
+ * left its read-side section. Readers are never blocked by this.
+ */
+static void HIAHProcessTableSynchronize(HIAHProcessTable *table) {
+    pthread_mutex_lock(&table->graceLock);
+    unsigned phase = atomic_load(&table->phase) & 1;
+    // Drain stragglers that entered the other phase before the previous flip
+    HIAHProcessTableWaitForReaders(table, phase ^ 1);
+    atomic_store(&table->phase, phase ^ 1);
+    HIAHProcessTableWaitForReaders(table, phase);
+    pthread_mutex_unlock(&table->graceLock);
+}
+
+// MARK: - Shards
+
+static HIAHProcessTableShard *HIAHProcessTableShardAlloc(size_t count) {
+    size_t capacity = HIAH_PT_MIN_CAPACITY;
+    while (capacity < count * 2) {
+        capacity <<= 1;
+    }
+    HIAHProcessTableShard *shard = calloc(1, sizeof(HIAHProcessTableShard) +
+                                             capacity * sizeof(const void *));
+    if (shard) {
+        shard->mask = capacity - 1;
+    }
+    return shard;
+}
+
+static void HIAHProcessTableShardAdd(HIAHProcessTableShard *shard,
+                                     const void *item,
+                                     uint32_t hash) {
+    size_t slot = HIAHProcessTableSlotStart(hash, shard->mask);
+    while (shard->slots[slot]) {
+        slot = (slot + 1) & shard->mask;
+    }
+    shard->slots[slot] = item;
+    shard->count++;
+}
+
+/**
+ * Builds a replacement for shard `shardIndex` of the given index that omits
+ * `removed` and contains `added` if it hashes there (either may be NULL).
+ */
+static HIAHProcessTableShard *HIAHProcessTableShardRebuild(const HIAHProcessTableShard *old,
+                                                           int index,
+                                                           size_t shardIndex,
+                                                           const void *removed,
+                                                           const void *added) {
+    size_t count = (old ? old->count : 0) + (added ? 1 : 0);
+    HIAHProcessTableShard *shard = HIAHProcessTableShardAlloc(count);
+    if (!shard) {
+        return NULL;
+    }
+
+    uint32_t hash;
+    if (old) {
+        for (size_t i = 0; i <= old->mask; i++) {
+            const void *item = old->slots[i];
+            if (item && item != removed && HIAHProcessTableHashItem(item, index, &hash)) {
+                HIAHProcessTableShardAdd(shard, item, hash);
+            }
+        }
+    }
+    if (added && HIAHProcessTableHashItem(added, index, &hash) &&
+        HIAHProcessTableShardIndex(hash) == shardIndex) {
+        HIAHProcessTableShardAdd(shard, added, hash);
+    }
+    return shard;
+}
+
+static bool HIAHProcessTableItemMatches(const void *item, int index, const void *probe) {
+    if (index == HIAH_PT_INDEX_PHYSICAL) {
+        return ((const HIAHProcessTableGroup *)item)->physicalPid == *(const pid_t *)probe;
+    }
+    const HIAHProcessTableKey *key = &((const HIAHProcessTableEntry *)item)->key;
+    switch (index) {
+        case HIAH_PT_INDEX_PID:
+            return key->pid == *(const pid_t *)probe;
+        case HIAH_PT_INDEX_UUID:
+            return key->hasRequestIdentifier &&
+                   memcmp(key->requestIdentifier, probe, HIAH_PROCESS_TABLE_UUID_SIZE) == 0;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Returns the slot item (entry or group) matching `probe`. Must be called
+ * inside a read-side section (or under the write lock).
+ */
+static const void *HIAHProcessTableFindItem(HIAHProcessTable *table,
+                                            int index,
+                                            uint32_t hash,
+                                            const void *probe) {
+    const HIAHProcessTableShard *shard =
+        atomic_load_explicit(&table->shards[index][HIAHProcessTableShardIndex(hash)], memory_order_acquire);
+    if (!shard) {
+        return NULL;
+    }
+
+    size_t slot = HIAHProcessTableSlotStart(hash, shard->mask);
+    for (size_t probes = 0; probes <= shard->mask; probes++) {
+        const void *item = shard->slots[slot];
+        if (!item) {
+            break;
+        }
+        if (HIAHProcessTableItemMatches(item, index, probe)) {
+            return item;
+        }
+        slot = (slot + 1) & shard->mask;
+    }
+    return NULL;
+}
+
+/**
+ * Entry lookup. For the physical PID index the most recently registered
+ * process (highest virtual PID) sharing that physical PID wins.
+ */
+static const HIAHProcessTableEntry *HIAHProcessTableFind(HIAHProcessTable *table,
+                                                         int index,
+                                                         uint32_t hash,
+                                                         const void *probe) {
+    const void *item = HIAHProcessTableFindItem(table, index, hash, probe);
+    if (item && index == HIAH_PT_INDEX_PHYSICAL) {
+        return atomic_load_explicit(&((const HIAHProcessTableGroup *)item)->latest, memory_order_acquire);
+    }
+    return item;
+}
+
+static HIAHProcessTableGroup *HIAHProcessTableGroupLookupLocked(HIAHProcessTable *table,
+                                                                const HIAHProcessTableEntry *entry) {
+    if (!entry || entry->key.physicalPid <= 0) {
+        return NULL;
+    }
+    pid_t physicalPid = entry->key.physicalPid;
+    return (HIAHProcessTableGroup *)HIAHProcessTableFindItem(table, HIAH_PT_INDEX_PHYSICAL,
+                                                             HIAHProcessTableMix32((uint32_t)physicalPid),
+                                                             &physicalPid);
+}
+
+static void HIAHProcessTableGroupFree(HIAHProcessTableGroup *group) {
+    if (group) {
+        free(group->members);
+        free(group);
+    }
+}
+
+/**
+ * Makes room for one more member. Readers never see the member array, so it
+ * may be reallocated under the write lock before anything is published.
+ */
+static bool HIAHProcessTableGroupReserve(HIAHProcessTableGroup *group) {
+    if (group->count < group->capacity) {
+        return true;
+    }
+    size_t capacity = group->capacity ? group->capacity * 2 : HIAH_PT_MIN_CAPACITY;
+    HIAHProcessTableEntry **members = realloc(group->members, capacity * sizeof(*members));
+    if (!members) {
+        return false;
+    }
+    group->members = members;
+    group->capacity = capacity;
+    return true;
+}
+
+static void HIAHProcessTableGroupAdd(HIAHProcessTableGroup *group, HIAHProcessTableEntry *entry) {
+    entry->groupSlot = group->count;
+    group->members[group->count++] = entry;
+    const HIAHProcessTableEntry *latest = atomic_load_explicit(&group->latest, memory_order_relaxed);
+    if (!latest || entry->key.pid >= latest->key.pid) {
+        atomic_store_explicit(&group->latest, entry, memory_order_release);
+    }
+}
+
+static void HIAHProcessTableGroupRemove(HIAHProcessTableGroup *group, HIAHProcessTableEntry *entry) {
+    size_t slot = entry->groupSlot;
+    HIAHProcessTableEntry *last = group->members[--group->count];
+    group->members[slot] = last;
+    last->groupSlot = slot;
+
+    if (atomic_load_explicit(&group->latest, memory_order_relaxed) != entry) {
+        return;
+    }
+    // Only losing the newest member costs a scan of the group
+    const HIAHProcessTableEntry *latest = NULL;
+    for (size_t i = 0; i < group->count; i++) {
+        if (!latest || group->members[i]->key.pid > latest->key.pid) {
+            latest = group->members[i];
+        }
+    }
+    atomic_store_explicit(&group->latest, latest, memory_order_release);
+}
+
+// MARK: - Writers
+
+static inline void *HIAHProcessTableRetainValue(HIAHProcessTable *table, void *value) {
+    return (value && table->callbacks.retain) ? table->callbacks.retain(value) : value;
+}
+
+static inline void HIAHProcessTableReleaseValue(HIAHProcessTable *table, void *value) {
+    if (value && table->callbacks.release) {
+        table->callbacks.release(value);
+    }
+}
+
+/**
+ * Swaps `removed` for `added` in every index. Called with the write lock
+ * held and the generation odd. On failure nothing is published.
+ *
+ * The physical PID index only changes shape when a group is created or
+ * emptied; otherwise the entry just joins or leaves its group.
+ */
+static bool HIAHProcessTablePublish(HIAHProcessTable *table,
+                                    HIAHProcessTableEntry *removed,
+                                    HIAHProcessTableEntry *added,
+                                    HIAHProcessTableRetired *retired) {
+    struct {
+        int index;
+        size_t shard;
+        HIAHProcessTableShard *replacement;
+    } updates[HIAH_PT_MAX_RETIRED_SHARDS];
+    size_t updateCount = 0;
+
+    HIAHProcessTableGroup *removedGroup = HIAHProcessTableGroupLookupLocked(table, removed);
+    HIAHProcessTableGroup *addedGroup = HIAHProcessTableGroupLookupLocked(table, added);
+    HIAHProcessTableGroup *createdGroup = NULL;
+    if (added && added->key.physicalPid > 0) {
+        if (!addedGroup) {
+            createdGroup = calloc(1, sizeof(HIAHProcessTableGroup));
+            if (!createdGroup) {
+                return false;
+            }
+            createdGroup->physicalPid = added->key.physicalPid;
+            addedGroup = createdGroup;
+        }
+        if (!HIAHProcessTableGroupReserve(addedGroup)) {
+            HIAHProcessTableGroupFree(createdGroup);
+            return false;
+        }
+    }
+    HIAHProcessTableGroup *emptiedGroup =
+        (removedGroup && removedGroup->count == 1 && removedGroup != addedGroup) ? removedGroup : NULL;
+
+    for (int index = 0; index < HIAH_PT_INDEX_COUNT; index++) {
+        const void *removedItem = removed;
+        const void *addedItem = added;
+        if (index == HIAH_PT_INDEX_PHYSICAL) {
+            removedItem = emptiedGroup;
+            addedItem = createdGroup;
+        }
+        const void *candidates[2] = {removedItem, addedItem};
+        for (int c = 0; c < 2; c++) {
+            uint32_t hash;
+            if (!candidates[c] || !HIAHProcessTableHashItem(candidates[c], index, &hash)) {
+                continue;
+            }
+            size_t shardIndex = HIAHProcessTableShardIndex(hash);
+            bool seen = false;
+            for (size_t u = 0; u < updateCount; u++) {
+                if (updates[u].index == index && updates[u].shard == shardIndex) {
+                    seen = true;
+                    break;
+                }
+            }
+            if (seen) {
+                continue;
+            }
+
+            HIAHProcessTableShard *old = atomic_load_explicit(&table->shards[index][shardIndex],
+                                                              memory_order_relaxed);
+            HIAHProcessTableShard *replacement = HIAHProcessTableShardRebuild(old, index, shardIndex,
+                                                                              removedItem, addedItem);
+            if (!replacement) {
+                for (size_t u = 0; u < updateCount; u++) {
+                    free(updates[u].replacement);
+                }
+                HIAHProcessTableGroupFree(createdGroup);
+                return false;
+            }
+            updates[updateCount].index = index;
+            updates[updateCount].shard = shardIndex;
+            updates[updateCount].replacement = replacement;
+            updateCount++;
+        }
+    }
+
+    // A new group must be complete before its shard makes it visible
+    if (createdGroup) {
+        HIAHProcessTableGroupAdd(createdGroup, added);
+    }
+    for (size_t u = 0; u < updateCount; u++) {
+        _Atomic(HIAHProcessTableShard *) *slot = &table->shards[updates[u].index][updates[u].shard];
+        HIAHProcessTableShard *old = atomic_exchange_explicit(slot, updates[u].replacement, memory_order_acq_rel);
+        if (old) {
+            retired->shards[retired->shardCount++] = old;
+        }
+    }
+
+    // Join before leaving so a key update within one group never empties it
+    if (addedGroup && !createdGroup) {
+        HIAHProcessTableGroupAdd(addedGroup, added);
+    }
+    if (removedGroup) {
+        HIAHProcessTableGroupRemove(removedGroup, removed);
+    }
+    retired->group = emptiedGroup;
+    return true;
+}
+
+static inline void HIAHProcessTableBeginWrite(HIAHProcessTable *table) {
+    pthread_mutex_lock(&table->writeLock);
+    atomic_fetch_add_explicit(&table->generation, 1, memory_order_acq_rel);
+}
+
+static inline void HIAHProcessTableEndWrite(HIAHProcessTable *table) {
+    atomic_fetch_add_explicit(&table->generation, 1, memory_order_release);
+    pthread_mutex_unlock(&table->writeLock);
+}
+
+static void HIAHProcessTableReclaim(HIAHProcessTable *table, HIAHProcessTableRetired *retired) {
+    if (retired->shardCount == 0 && !retired->entry && !retired->group) {
+        return;
+    }
+    HIAHProcessTableSynchronize(table);
+    for (size_t i = 0; i < retired->shardCount; i++) {
+        free(retired->shards[i]);
+    }
+    if (retired->entry) {
+        HIAHProcessTableReleaseValue(table, retired->entry->value);
+        free(retired->entry);
+    }
+    HIAHProcessTableGroupFree(retired->group);
+}
+
+static HIAHProcessTableEntry *HIAHProcessTableLookupLocked(HIAHProcessTable *table, pid_t pid) {
+    return (HIAHProcessTableEntry *)HIAHProcessTableFind(table, HIAH_PT_INDEX_PID,
+                                                         HIAHProcessTableMix32((uint32_t)pid), &pid);
+}
+
+// MARK: - Public API
+
+HIAHProcessTable *HIAHProcessTableCreate(const HIAHProcessTableCallbacks *callbacks, pid_t firstPid) {
+    HIAHProcessTable *table = calloc(1, sizeof(HIAHProcessTable));
+    if (!table) {
+        return NULL;
+    }
+    if (callbacks) {
+        table->callbacks = *callbacks;
+    }
+    atomic_init(&table->generation, 0);
+    atomic_init(&table->count, 0);
+    atomic_init(&table->nextPid, firstPid);
+    atomic_init(&table->phase, 0);
+    pthread_mutex_init(&table->writeLock, NULL);
+    pthread_mutex_init(&table->graceLock, NULL);
+    return table;
+}
+
+void HIAHProcessTableDestroy(HIAHProcessTable *table) {
+    if (!table) {
+        return;
+    }
+    for (int index = 0; index < HIAH_PT_INDEX_COUNT; index++) {
+        for (size_t s = 0; s < HIAH_PROCESS_TABLE_SHARDS; s++) {
+            HIAHProcessTableShard *shard = atomic_load(&table->shards[index][s]);
+            if (!shard) {
+                continue;
+            }
+            // Entries are owned by the PID index; the others only reference them
+            if (index == HIAH_PT_INDEX_PHYSICAL) {
+                for (size_t i = 0; i <= shard->mask; i++) {
+                    HIAHProcessTableGroupFree((HIAHProcessTableGroup *)shard->slots[i]);
+                }
+            } else if (index == HIAH_PT_INDEX_PID) {
+                for (size_t i = 0; i <= shard->mask; i++) {
+                    HIAHProcessTableEntry *entry = (HIAHProcessTableEntry *)shard->slots[i];
+                    if (entry) {
+                        HIAHProcessTableReleaseValue(table, entry->value);
+                        free(entry);
+                    }
+                }
+            }
+            free(shard);
+        }
+    }
+    pthread_mutex_destroy(&table->writeLock);
+    pthread_mutex_destroy(&table->graceLock);
+    free(table);
+}
+
+pid_t HIAHProcessTableAllocatePID(HIAHProcessTable *table) {
+    return atomic_fetch_add_explicit(&table->nextPid, 1, memory_order_relaxed);
+}
+
+bool HIAHProcessTableInsert(HIAHProcessTable *table, const HIAHProcessTableKey *key, void *value) {
+    if (!table || !key || key->pid <= 0) {
+        return false;
+    }
+
+    HIAHProcessTableEntry *entry = malloc(sizeof(HIAHProcessTableEntry));
+    if (!entry) {
+        return false;
+    }
+    entry->key = *key;
+    entry->value = HIAHProcessTableRetainValue(table, value);
+
+    HIAHProcessTableRetired retired = {0};
+
+    HIAHProcessTableBeginWrite(table);
+    HIAHProcessTableEntry *old = HIAHProcessTableLookupLocked(table, key->pid);
+    bool ok = HIAHProcessTablePublish(table, old, entry, &retired);
+    if (ok) {
+        retired.entry = old;
+        if (!old) {
+            atomic_fetch_add_explicit(&table->count, 1, memory_order_relaxed);
+        }
+    }
+    HIAHProcessTableEndWrite(table);
+
+    if (!ok) {
+        HIAHProcessTableReleaseValue(table, entry->value);
+        free(entry);
+        return false;
+    }
+    HIAHProcessTableReclaim(table, &retired);
+    return true;
+}
+
+bool HIAHProcessTableUpdateKey(HIAHProcessTable *table, const HIAHProcessTableKey *key) {
+    if (!table || !key) {
+        return false;
+    }
+
+    HIAHProcessTableEntry *entry = malloc(sizeof(HIAHProcessTableEntry));
+    if (!entry) {
+        return false;
+    }
+    entry->key = *key;
+
+    HIAHProcessTableRetired retired = {0};
+
+    HIAHProcessTableBeginWrite(table);
+    HIAHProcessTableEntry *old = HIAHProcessTableLookupLocked(table, key->pid);
+    bool ok = false;
+    if (old) {
+        entry->value = HIAHProcessTableRetainValue(table, old->value);
+        ok = HIAHProcessTablePublish(table, old, entry, &retired);
+        if (ok) {
+            retired.entry = old;
+        } else {
+            HIAHProcessTableReleaseValue(table, entry->value);
+        }
+    }
+    HIAHProcessTableEndWrite(table);
+
+    if (!ok) {
+        free(entry);
+        return false;
+    }
+    HIAHProcessTableReclaim(table, &retired);
+    return true;
+}
+
+void *HIAHProcessTableRemove(HIAHProcessTable *table, pid_t pid) {
+    if (!table) {
+        return NULL;
+    }
+
+    HIAHProcessTableRetired retired = {0};
+    void *value = NULL;
+
+    HIAHProcessTableBeginWrite(table);
+    HIAHProcessTableEntry *old = HIAHProcessTableLookupLocked(table, pid);
+    if (old && HIAHProcessTablePublish(table, old, NULL, &retired)) {
+        retired.entry = old;
+        value = HIAHProcessTableRetainValue(table, old->value);
+        atomic_fetch_sub_explicit(&table->count, 1, memory_order_relaxed);
+    }
+    HIAHProcessTableEndWrite(table);
+
+    HIAHProcessTableReclaim(table, &retired);
+    return value;
+}
+
+static void *HIAHProcessTableCopyValue(HIAHProcessTable *table, int index, uint32_t hash, const void *probe) {
+    if (!table) {
+        return NULL;
+    }
+    _Atomic long *reader = HIAHProcessTableReadLock(table);
+    const HIAHProcessTableEntry *entry = HIAHProcessTableFind(table, index, hash, probe);
+    void *value = entry ? HIAHProcessTableRetainValue(table, entry->value) : NULL;
+    HIAHProcessTableReadUnlock(reader);
+    return value;
+}
+
+void *HIAHProcessTableCopyValueForPID(HIAHProcessTable *table, pid_t pid) {
+    return HIAHProcessTableCopyValue(table, HIAH_PT_INDEX_PID, HIAHProcessTableMix32((uint32_t)pid), &pid);
+}
+
+void *HIAHProcessTableCopyValueForPhysicalPID(HIAHProcessTable *table, pid_t physicalPid) {
+    if (physicalPid <= 0) {
+        return NULL;
+    }
+    return HIAHProcessTableCopyValue(table, HIAH_PT_INDEX_PHYSICAL,
+                                     HIAHProcessTableMix32((uint32_t)physicalPid), &physicalPid);
+}
+
+void *HIAHProcessTableCopyValueForRequestIdentifier(HIAHProcessTable *table,
+                                                    const uint8_t uuid[HIAH_PROCESS_TABLE_UUID_SIZE]) {
+    if (!uuid) {
+        return NULL;
+    }
+    return HIAHProcessTableCopyValue(table, HIAH_PT_INDEX_UUID, HIAHProcessTableHashUUID(uuid), uuid);
+}
+
+size_t HIAHProcessTableCount(HIAHProcessTable *table) {
+    return table ? atomic_load_explicit(&table->count, memory_order_relaxed) : 0;
+}
+
+uint64_t HIAHProcessTableGeneration(HIAHProcessTable *table) {
+    return table ? atomic_load_explicit(&table->generation, memory_order_acquire) : 0;
+}
+
+static int HIAHProcessTableCompareEntries(const void *a, const void *b) {
+    pid_t pa = (*(const HIAHProcessTableEntry *const *)a)->key.pid;
+    pid_t pb = (*(const HIAHProcessTableEntry *const *)b)->key.pid;
+    return (pa > pb) - (pa < pb);
+}
+
+bool HIAHProcessTableCopySnapshot(HIAHProcessTable *table, HIAHProcessTableSnapshot *snapshot) {
+    if (!table || !snapshot) {
+        return false;
+    }
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    size_t capacity = HIAHProcessTableCount(table) + HIAH_PT_MIN_CAPACITY;
+    const HIAHProcessTableEntry **entries = NULL;
+
+    for (;;) {
+        const HIAHProcessTableEntry **grown = realloc(entries, capacity * sizeof(*entries));
+        if (!grown) {
+            free(entries);
+            return false;
+        }
+        entries = grown;
+
+        _Atomic long *reader = HIAHProcessTableReadLock(table);
+        uint64_t generation = atomic_load_explicit(&table->generation, memory_order_acquire);
+        if (generation & 1) {
+            // A writer is mid-publish; let it finish
+            HIAHProcessTableReadUnlock(reader);
+            sched_yield();
+            continue;
+        }
+
+        size_t count = 0;
+        bool overflow = false;
+        for (size_t s = 0; s < HIAH_PROCESS_TABLE_SHARDS && !overflow; s++) {
+            const HIAHProcessTableShard *shard =
+                atomic_load_explicit(&table->shards[HIAH_PT_INDEX_PID][s], memory_order_acquire);
+            if (!shard) {
+                continue;
+            }
+            for (size_t i = 0; i <= shard->mask; i++) {
+                if (!shard->slots[i]) {
+                    continue;
+                }
+                if (count == capacity) {
+                    overflow = true;
+                    break;
+                }
+                entries[count++] = shard->slots[i];
+            }
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if (overflow || atomic_load_explicit(&table->generation, memory_order_relaxed) != generation) {
+            HIAHProcessTableReadUnlock(reader);
+            if (overflow) {
+                capacity *= 2;
+            }
+            continue;
+        }
+
+        HIAHProcessTableKey *keys = malloc((count ? count : 1) * sizeof(HIAHProcessTableKey));
+        void **values = malloc((count ? count : 1) * sizeof(void *));
+        if (!keys || !values) {
+            HIAHProcessTableReadUnlock(reader);
+            free(keys);
+            free(values);
+            free(entries);
+            return false;
+        }
+
+        qsort(entries, count, sizeof(*entries), HIAHProcessTableCompareEntries);
+        for (size_t i = 0; i < count; i++) {
+            keys[i] = entries[i]->key;
+            values[i] = HIAHProcessTableRetainValue(table, entries[i]->value);
+        }
+        HIAHProcessTableReadUnlock(reader);
+
+        snapshot->generation = generation;
+        snapshot->count = count;
+        snapshot->keys = keys;
+        snapshot->values = values;
+        free(entries);
+        return true;
+    }
+}
+
+void HIAHProcessTableSnapshotFree(HIAHProcessTable *table, HIAHProcessTableSnapshot *snapshot) {
+    if (!snapshot) {
+        return;
+    }
+    for (size_t i = 0; i < snapshot->count; i++) {
+        HIAHProcessTableReleaseValue(table, snapshot->values[i]);
+    }
+    free(snapshot->keys);
+    free(snapshot->values);
+    memset(snapshot, 0, sizeof(*snapshot));
+}
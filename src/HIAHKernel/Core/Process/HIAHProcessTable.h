@@ -0,0 +1,161 @@
+/**
+ * HIAHProcessTable.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Sharded, read-mostly virtual process table.
+ *
+ * The table maps virtual PIDs to opaque process objects and keeps two
+ * secondary indexes (physical PID and NSExtension request UUID). Each index
+ * is split into shards; every shard is an immutable open-addressing snapshot
+ * that writers replace copy-on-write. Readers never take a lock: they enter a
+ * lightweight read-side section, look the key up in O(1) and retain the value
+ * before leaving. Retired shards and released values are reclaimed only after
+ * a grace period in which every reader that could still see them has left.
+ *
+ * A global generation counter (even = stable, odd = write in progress) lets
+ * readers take consistent whole-table snapshots without blocking writers.
+ *
+ * This file is plain C11 and has no Apple-only dependencies so it can be
+ * built and exercised on Linux.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_PROCESS_TABLE_H
+#define HIAH_PROCESS_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Number of shards per index. Must be a power of two.
+ */
+#define HIAH_PROCESS_TABLE_SHARDS 16
+
+/**
+ * Size of a request identifier (matches uuid_t / NSUUID bytes).
+ */
+#define HIAH_PROCESS_TABLE_UUID_SIZE 16
+
+typedef struct HIAHProcessTable HIAHProcessTable;
+
+/**
+ * Value ownership callbacks.
+ *
+ * `retain` is called when a value is handed out to a reader or stored in the
+ * table; `release` balances it. Either may be NULL for unmanaged values.
+ */
+typedef struct {
+    void *(*retain)(void *value);
+    void (*release)(void *value);
+} HIAHProcessTableCallbacks;
+
+/**
+ * Identity of a registered process as seen by the indexes.
+ */
+typedef struct {
+    pid_t pid;                                        // Virtual PID (primary key)
+    pid_t physicalPid;                                // -1 if unknown
+    bool hasRequestIdentifier;
+    uint8_t requestIdentifier[HIAH_PROCESS_TABLE_UUID_SIZE];
+} HIAHProcessTableKey;
+
+/**
+ * Creates an empty table. `firstPid` is the first virtual PID handed out by
+ * HIAHProcessTableAllocatePID().
+ */
+HIAHProcessTable *HIAHProcessTableCreate(const HIAHProcessTableCallbacks *callbacks,
+                                         pid_t firstPid);
+
+/**
+ * Destroys the table and releases every stored value.
+ * No readers or writers may be active.
+ */
+void HIAHProcessTableDestroy(HIAHProcessTable *table);
+
+/**
+ * Returns a fresh virtual PID. Lock-free.
+ */
+pid_t HIAHProcessTableAllocatePID(HIAHProcessTable *table);
+
+/**
+ * Inserts or replaces the entry for `key->pid`.
+ * The table retains `value`; a replaced value is released after a grace period.
+ *
+ * @return true on success, false on allocation failure or invalid key
+ */
+bool HIAHProcessTableInsert(HIAHProcessTable *table,
+                            const HIAHProcessTableKey *key,
+                            void *value);
+
+/**
+ * Updates the secondary keys (physical PID, request identifier) of an
+ * existing entry, keeping its value.
+ *
+ * @return false if `key->pid` is not registered
+ */
+bool HIAHProcessTableUpdateKey(HIAHProcessTable *table,
+                               const HIAHProcessTableKey *key);
+
+/**
+ * Removes the entry for `pid`.
+ *
+ * @return The removed value, retained for the caller (+1), or NULL if absent
+ */
+void *HIAHProcessTableRemove(HIAHProcessTable *table, pid_t pid);
+
+/**
+ * Lookups. Each returns the value retained for the caller (+1), or NULL.
+ * None of them block, even while a writer is active.
+ */
+void *HIAHProcessTableCopyValueForPID(HIAHProcessTable *table, pid_t pid);
+void *HIAHProcessTableCopyValueForPhysicalPID(HIAHProcessTable *table, pid_t physicalPid);
+void *HIAHProcessTableCopyValueForRequestIdentifier(HIAHProcessTable *table,
+                                                    const uint8_t uuid[HIAH_PROCESS_TABLE_UUID_SIZE]);
+
+/**
+ * Number of registered processes.
+ */
+size_t HIAHProcessTableCount(HIAHProcessTable *table);
+
+/**
+ * Current generation. Even values denote a stable table; the value advances
+ * by two for every completed write.
+ */
+uint64_t HIAHProcessTableGeneration(HIAHProcessTable *table);
+
+/**
+ * A consistent point-in-time copy of the table.
+ */
+typedef struct {
+    uint64_t generation;
+    size_t count;
+    HIAHProcessTableKey *keys;   // `count` keys, sorted by virtual PID
+    void **values;               // `count` values, each retained (+1)
+} HIAHProcessTableSnapshot;
+
+/**
+ * Copies every entry into `snapshot`. Retries internally if a writer
+ * publishes while the copy is in progress; never blocks writers.
+ *
+ * @return false on allocation failure
+ */
+bool HIAHProcessTableCopySnapshot(HIAHProcessTable *table, HIAHProcessTableSnapshot *snapshot);
+
+/**
+ * Releases the values and storage held by a snapshot.
+ */
+void HIAHProcessTableSnapshotFree(HIAHProcessTable *table, HIAHProcessTableSnapshot *snapshot);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_PROCESS_TABLE_H */
@@ -0,0 +1,100 @@
+/**
+ * HIAHSpawnTrace.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Per-spawn latency trace.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHSpawnTrace.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static const char *const HIAHSpawnStageNames[HIAHSpawnStageCount] = {
+    [HIAHSpawnStageResolve]  = "resolve",
+    [HIAHSpawnStageChannel]  = "channel",
+    [HIAHSpawnStageJITWait]  = "jit-wait",
+    [HIAHSpawnStagePrepare]  = "prepare",
+    [HIAHSpawnStageSign]     = "sign",
+    [HIAHSpawnStageLoad]     = "load",
+    [HIAHSpawnStageEntry]    = "entry",
+    [HIAHSpawnStageRegister] = "register",
+    [HIAHSpawnStageLaunch]   = "launch",
+};
+
+uint64_t HIAHSpawnTraceNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+void HIAHSpawnTraceStart(HIAHSpawnTrace *trace) {
+    memset(trace, 0, sizeof(*trace));
+    trace->failedStage = -1;
+    trace->origin = HIAHSpawnTraceNow();
+}
+
+void HIAHSpawnTraceBegin(HIAHSpawnTrace *trace, HIAHSpawnStage stage) {
+    trace->begin[stage] = HIAHSpawnTraceNow();
+}
+
+void HIAHSpawnTraceEnd(HIAHSpawnTrace *trace, HIAHSpawnStage stage) {
+    trace->end[stage] = HIAHSpawnTraceNow();
+}
+
+void HIAHSpawnTraceFail(HIAHSpawnTrace *trace, HIAHSpawnStage stage) {
+    HIAHSpawnTraceEnd(trace, stage);
+    trace->failedStage = (int)stage;
+}
+
+uint64_t HIAHSpawnTraceDuration(const HIAHSpawnTrace *trace, HIAHSpawnStage stage) {
+    if (trace->begin[stage] == 0 || trace->end[stage] < trace->begin[stage]) {
+        return 0;
+    }
+    return trace->end[stage] - trace->begin[stage];
+}
+
+uint64_t HIAHSpawnTraceTotal(const HIAHSpawnTrace *trace) {
+    uint64_t last = trace->origin;
+    for (int i = 0; i < HIAHSpawnStageCount; i++) {
+        if (trace->end[i] > last) {
+            last = trace->end[i];
+        }
+    }
+    return last - trace->origin;
+}
+
+const char *HIAHSpawnStageName(HIAHSpawnStage stage) {
+    if ((int)stage < 0 || stage >= HIAHSpawnStageCount) {
+        return "unknown";
+    }
+    return HIAHSpawnStageNames[stage];
+}
+
+size_t HIAHSpawnTraceFormat(const HIAHSpawnTrace *trace, char *buffer, size_t size) {
+    size_t used = 0;
+#define HIAH_TRACE_APPEND(...)                                                  \
+    do {                                                                        \
+        int n = snprintf(buffer ? buffer + (used < size ? used : size) : NULL,  \
+                         used < size ? size - used : 0, __VA_ARGS__);           \
+        if (n > 0) used += (size_t)n;                                           \
+    } while (0)
+
+    for (int i = 0; i < HIAHSpawnStageCount; i++) {
+        if (trace->begin[i] == 0) {
+            continue;
+        }
+        double start = (double)(trace->begin[i] - trace->origin) / 1e6;
+        double duration = (double)HIAHSpawnTraceDuration(trace, (HIAHSpawnStage)i) / 1e6;
+        HIAH_TRACE_APPEND("%-9s +%9.3f ms %9.3f ms%s\n",
+                          HIAHSpawnStageNames[i], start, duration,
+                          i == trace->failedStage ? "  FAILED" : "");
+    }
+    HIAH_TRACE_APPEND("%-9s %21.3f ms\n", "total",
+                      (double)HIAHSpawnTraceTotal(trace) / 1e6);
+#undef HIAH_TRACE_APPEND
+    return used;
+}
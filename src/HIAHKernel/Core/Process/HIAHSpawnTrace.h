@@ -0,0 +1,91 @@
+/**
+ * HIAHSpawnTrace.h
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Per-spawn latency trace.
+ *
+ * A spawn runs as a pipeline of named stages, some of them concurrently.
+ * Each stage records monotonic begin/end timestamps into the spawn's trace,
+ * which can be dumped once the spawn has finished (or failed). Every stage
+ * has its own slots, so concurrent stages never write the same field.
+ *
+ * Plain C, no Apple-only dependencies.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#ifndef HIAH_SPAWN_TRACE_H
+#define HIAH_SPAWN_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    HIAHSpawnStageResolve = 0,   // Locate the executable (.app bundle, Info.plist)
+    HIAHSpawnStageChannel,       // Open the output channel, start the pump
+    HIAHSpawnStageJITWait,       // Wait for JIT to be enabled (extension)
+    HIAHSpawnStagePrepare,       // Permissions, copy and patch (or cache hit)
+    HIAHSpawnStageSign,          // Signature removal and signing (extension)
+    HIAHSpawnStageLoad,          // dlopen (or warm pool hit)
+    HIAHSpawnStageEntry,         // Entry point lookup
+    HIAHSpawnStageRegister,      // Process table insertion
+    HIAHSpawnStageLaunch,        // Hand-off to the guest thread
+    HIAHSpawnStageCount
+} HIAHSpawnStage;
+
+typedef struct {
+    uint64_t origin;                        // Trace start (ns, monotonic)
+    uint64_t begin[HIAHSpawnStageCount];    // 0 = stage did not run
+    uint64_t end[HIAHSpawnStageCount];      // 0 = stage did not finish
+    int failedStage;                        // -1 unless a stage failed
+} HIAHSpawnTrace;
+
+/**
+ * @return Monotonic time in nanoseconds
+ */
+uint64_t HIAHSpawnTraceNow(void);
+
+/**
+ * Clears the trace and starts its clock.
+ */
+void HIAHSpawnTraceStart(HIAHSpawnTrace *trace);
+
+void HIAHSpawnTraceBegin(HIAHSpawnTrace *trace, HIAHSpawnStage stage);
+void HIAHSpawnTraceEnd(HIAHSpawnTrace *trace, HIAHSpawnStage stage);
+
+/**
+ * Ends `stage` and marks the spawn as failed there.
+ */
+void HIAHSpawnTraceFail(HIAHSpawnTrace *trace, HIAHSpawnStage stage);
+
+/**
+ * @return Duration of a finished stage in nanoseconds, 0 if it did not run
+ */
+uint64_t HIAHSpawnTraceDuration(const HIAHSpawnTrace *trace, HIAHSpawnStage stage);
+
+/**
+ * @return Time from the trace start to the last recorded stage end
+ */
+uint64_t HIAHSpawnTraceTotal(const HIAHSpawnTrace *trace);
+
+const char *HIAHSpawnStageName(HIAHSpawnStage stage);
+
+/**
+ * Writes one line per stage that ran ("name  +start  duration", in ms) and a
+ * total, like snprintf.
+ *
+ * @return Length the full dump needs, excluding the NUL
+ */
+size_t HIAHSpawnTraceFormat(const HIAHSpawnTrace *trace, char *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIAH_SPAWN_TRACE_H */
@@ -14,6 +14,10 @@
  * binary to MH_BUNDLE, which is dlopen-compatible without requiring
  * LC_ID_DYLIB injection.
  *
+ * Patches edit the binary in place and only write the header bytes they
+ * change (see HIAHMachOTransform.h), so patch a staged copy rather than a
+ * binary that is already loaded.
+ *
  * Copyright (c) 2025 Alex Spaulding
  * Licensed under MIT License
  */
@@ -22,6 +26,11 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
+/// Version of what patchBinaryForJITLessMode: writes. Bump it whenever the
+/// patch changes, so cached patched images built by an older version are
+/// rebuilt instead of reused.
+#define HIAH_JITLESS_PATCH_RECIPE_VERSION 2
+
 @interface HIAHMachOUtils : NSObject
 
 /**
@@ -36,18 +45,43 @@ NS_ASSUME_NONNULL_BEGIN
 + (BOOL)patchBinaryToDylib:(NSString *)path;
 
 /**
- * Checks if a binary is of MH_EXECUTE type.
+ * Checks if a binary is of MH_EXECUTE type. Answered from the Mach-O index
+ * (see HIAHMachOIndex.h), so the binary is only read if it changed since
+ * it was last looked at.
  *
  * @param path Path to the binary to check
  * @return YES if the binary is MH_EXECUTE, NO otherwise
  */
 + (BOOL)isMHExecute:(NSString *)path;
 
+/**
+ * Indexed metadata of a binary's first 64-bit slice: "filetype",
+ * "cputypes" (every valid slice), "signed", "entitlementsHash" (0 if none)
+ * and "dylibs" (install names in load order).
+ *
+ * @return nil if the file cannot be read or has no 64-bit Mach-O slice
+ */
++ (nullable NSDictionary<NSString *, id> *)indexedInfoForBinary:
+    (NSString *)path;
+
+/**
+ * Reads the binary into the Mach-O index now and saves the index, so later
+ * queries never have to open it. Call after installing or patching.
+ */
++ (void)indexBinary:(NSString *)path;
+
+/**
+ * Drops index records of binaries that no longer exist.
+ */
++ (void)pruneIndex;
+
 /**
  * Removes the code signature from a Mach-O binary.
  *
  * This is necessary after patching a binary because modifying the binary
  * invalidates its code signature, causing iOS to reject it during dlopen.
+ * The signature data is cut off the end of __LINKEDIT too, so the binary
+ * gets smaller; fat slices behind a shortened one move down.
  * 
  * CRITICAL: This must be called after patchBinaryToDylib for .ipa apps.
  *
@@ -70,6 +104,18 @@ NS_ASSUME_NONNULL_BEGIN
  */
 + (BOOL)patchBinaryForJITLessMode:(NSString *)path;
 
+/**
+ * Patches for JIT-less mode and, if asked, removes the code signature in
+ * the same pass over the binary. Prefer this to calling
+ * patchBinaryForJITLessMode: and removeCodeSignature: one after the other.
+ *
+ * @param path Path to the binary to patch
+ * @param removeSignature Also drop LC_CODE_SIGNATURE and the signature data
+ * @return YES if patch was successful, NO otherwise
+ */
++ (BOOL)patchBinaryForJITLessMode:(NSString *)path
+                removingSignature:(BOOL)removeSignature;
+
 @end
 
 NS_ASSUME_NONNULL_END
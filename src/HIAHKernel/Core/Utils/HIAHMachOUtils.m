@@ -4,11 +4,14 @@
  *
  * Mach-O binary manipulation implementation.
  *
- * This implementation uses a straightforward approach:
- * 1. Read the binary into memory
- * 2. Parse the Mach-O header (supporting both thin and fat binaries)
- * 3. Change the filetype field to a dlopen-compatible type (MH_BUNDLE)
- * 4. Write the modified binary back
+ * Every patch is a list of header edits handed to HIAHMachOTransform, which
+ * maps the binary once, edits all slices and writes back only the bytes
+ * that changed. Patches that are needed together should be made in one
+ * call, e.g. patchBinaryForJITLessMode:removingSignature:.
+ *
+ * Questions about a binary (is it MH_EXECUTE, which CPUs, is it signed) are
+ * answered from the shared HIAHMachOIndex, which only reads binaries it has
+ * not seen or that changed since.
  *
  * Copyright (c) 2025 Alex Spaulding
  * Licensed under MIT License
@@ -16,422 +19,241 @@
 
 #import "HIAHMachOUtils.h"
 #import "HIAHLogging.h"
-#import <mach-o/fat.h>
+#import "HIAHMachOIndex.h"
+#import "HIAHMachOTransform.h"
 #import <mach-o/loader.h>
+#import <stdatomic.h>
+
+// LiveContainer's __PAGEZERO for JIT-less loading
+static const uint64_t HIAHJITLessPageZeroAddress = 0xFFFFC000ULL;
+static const uint64_t HIAHJITLessPageZeroSize = 0x4000ULL;
+
+// Saves of the shared index are coalesced over this window
+static const int64_t HIAHMachOIndexSaveDelay = NSEC_PER_SEC / 2;
+
+static HIAHMachOIndex *HIAHMachOSharedIndex(void) {
+  static HIAHMachOIndex *index;
+  static dispatch_once_t once;
+  dispatch_once(&once, ^{
+    NSString *caches = NSSearchPathForDirectoriesInDomains(
+                           NSCachesDirectory, NSUserDomainMask, YES)
+                           .firstObject
+                           ?: NSTemporaryDirectory();
+    NSString *directory = [caches stringByAppendingPathComponent:@"HIAHKernel"];
+    [[NSFileManager defaultManager] createDirectoryAtPath:directory
+                              withIntermediateDirectories:YES
+                                               attributes:nil
+                                                    error:nil];
+    index = HIAHMachOIndexCreate(
+        [[directory stringByAppendingPathComponent:@"MachOIndex"]
+            fileSystemRepresentation]);
+  });
+  return index;
+}
 
-@implementation HIAHMachOUtils
-
-+ (BOOL)patchBinaryToDylib:(NSString *)path {
-  // Read binary into memory
-  NSError *readError = nil;
-  NSData *data = [NSData dataWithContentsOfFile:path
-                                        options:NSDataReadingMappedIfSafe
-                                          error:&readError];
-
-  if (!data || data.length < sizeof(struct mach_header_64)) {
-    HIAHLogError(HIAHLogFilesystem, "Failed to read binary: %s",
-                 readError ? [[readError description] UTF8String] : "(null)");
-    return NO;
+static void HIAHMachOSaveSharedIndex(void) {
+  char error[256] = "";
+  if (!HIAHMachOIndexSave(HIAHMachOSharedIndex(), error, sizeof(error))) {
+    HIAHLogError(HIAHLogFilesystem, "Failed to save Mach-O index: %s", error);
   }
+}
 
-  // Create mutable copy for patching
-  NSMutableData *mutableData = [data mutableCopy];
-  uint8_t *bytes = (uint8_t *)mutableData.mutableBytes;
-
-  // Perform the patch
-  BOOL success = [self patchMachOBytes:bytes length:mutableData.length];
-
-  if (success) {
-    // Write patched binary back
-    NSError *writeError = nil;
-    if (![mutableData writeToFile:path
-                          options:NSDataWritingAtomic
-                            error:&writeError]) {
-      HIAHLogError(HIAHLogFilesystem, "Failed to write patched binary: %s",
-                   writeError ? [[writeError description] UTF8String]
-                              : "(null)");
-      return NO;
-    }
-    return YES;
+// Lookups that had to scan a binary leave the index changed; one save
+// covers every change made until it runs
+static void HIAHMachOScheduleIndexSave(void) {
+  static atomic_bool pending;
+  if (atomic_exchange(&pending, true)) {
+    return;
   }
-
-  return NO;
+  dispatch_after(dispatch_time(DISPATCH_TIME_NOW, HIAHMachOIndexSaveDelay),
+                 dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                   atomic_store(&pending, false);
+                   HIAHMachOSaveSharedIndex();
+                 });
 }
 
+@implementation HIAHMachOUtils
+
 /**
- * Internal method to patch Mach-O bytes in memory.
- * Handles both fat (universal) and thin binaries.
+ * Returns the indexed record of `path` (free it with
+ * HIAHMachOImageInfoFree()), or NULL if the file cannot be read.
  */
-+ (BOOL)patchMachOBytes:(uint8_t *)bytes length:(NSUInteger)length {
-  uint32_t magic = *(uint32_t *)bytes;
-
-  // Check if this is a fat (universal) binary
-  BOOL isFatBinary = (magic == FAT_MAGIC || magic == FAT_CIGAM);
-
-  if (isFatBinary) {
-    // Parse fat header and patch each architecture slice
-    struct fat_header *fatHeader = (struct fat_header *)bytes;
-    uint32_t archCount = OSSwapBigToHostInt32(fatHeader->nfat_arch);
-    struct fat_arch *archs =
-        (struct fat_arch *)(bytes + sizeof(struct fat_header));
-
-    BOOL anySlicePatched = NO;
-
-    for (uint32_t i = 0; i < archCount; i++) {
-      uint32_t sliceOffset = OSSwapBigToHostInt32(archs[i].offset);
-
-      if (sliceOffset < length) {
-        uint8_t *sliceBytes = bytes + sliceOffset;
-        NSUInteger sliceLength = length - sliceOffset;
-
-        if ([self patchMachOBytes:sliceBytes length:sliceLength]) {
-          anySlicePatched = YES;
-        }
-      }
-    }
-
-    return anySlicePatched;
++ (HIAHMachOImageInfo *)copyIndexedInfoForBinary:(NSString *)path {
+  HIAHMachOIndex *index = HIAHMachOSharedIndex();
+  char error[256] = "";
+  HIAHMachOImageInfo *info =
+      index ? HIAHMachOIndexLookup(index, [path fileSystemRepresentation],
+                                   error, sizeof(error))
+            : HIAHMachOImageInfoRead([path fileSystemRepresentation], error,
+                                     sizeof(error));
+  if (!info) {
+    HIAHLogDebug(HIAHLogFilesystem, "No Mach-O info for %s: %s",
+                 [path UTF8String], error);
+    return NULL;
   }
-
-  // Handle 64-bit Mach-O
-  if (magic == MH_MAGIC_64 || magic == MH_CIGAM_64) {
-    struct mach_header_64 *header = (struct mach_header_64 *)bytes;
-
-    // Make executable images dlopen-compatible by converting to MH_BUNDLE.
-    // (MH_DYLIB requires LC_ID_DYLIB; we do not rewrite load commands here.)
-    if (header->filetype == MH_EXECUTE || header->filetype == MH_DYLIB) {
-      uint32_t oldType = header->filetype;
-      header->filetype = MH_BUNDLE;
-      HIAHLogDebug(HIAHLogFilesystem,
-                   "Patched Mach-O filetype %u to MH_BUNDLE (64-bit)", oldType);
-      return YES;
-    }
-
-    return NO; // Already MH_BUNDLE or other type
+  if (index) {
+    HIAHMachOScheduleIndexSave();
   }
-
-  // Handle 32-bit Mach-O (legacy support)
-  if (magic == MH_MAGIC || magic == MH_CIGAM) {
-    struct mach_header *header = (struct mach_header *)bytes;
-
-    if (header->filetype == MH_EXECUTE || header->filetype == MH_DYLIB) {
-      uint32_t oldType = header->filetype;
-      header->filetype = MH_BUNDLE;
-      HIAHLogDebug(HIAHLogFilesystem,
-                   "Patched Mach-O filetype %u to MH_BUNDLE (32-bit)", oldType);
-      return YES;
-    }
-
-    return NO; // Already MH_BUNDLE or other type
-  }
-
-  HIAHLogError(HIAHLogFilesystem, "Unknown Mach-O magic: 0x%x", magic);
-  return NO;
+  return info;
 }
 
-+ (BOOL)isMHExecute:(NSString *)path {
-  NSData *data = [NSData dataWithContentsOfFile:path
-                                        options:NSDataReadingMappedIfSafe
-                                          error:nil];
-
-  if (!data || data.length < sizeof(struct mach_header_64)) {
+/**
+ * Applies `edits` to every slice of the binary in one pass.
+ */
++ (BOOL)transformBinary:(NSString *)path
+                  edits:(const HIAHMachOEdit *)edits
+                  count:(size_t)count
+                  stats:(HIAHMachOTransformStats *)stats {
+  char error[256] = "";
+  if (!HIAHMachOTransformFile([path fileSystemRepresentation], edits, count,
+                              stats, error, sizeof(error))) {
+    HIAHLogError(HIAHLogFilesystem, "Failed to patch %s: %s", [path UTF8String],
+                 error);
     return NO;
   }
+  HIAHLogDebug(HIAHLogFilesystem,
+               "Patched %u of %u slices of %s (%llu bytes written)",
+               stats->slicesChanged, stats->slices, [path UTF8String],
+               (unsigned long long)stats->bytesWritten);
+  return YES;
+}
 
-  const uint8_t *bytes = (const uint8_t *)data.bytes;
-  uint32_t magic = *(uint32_t *)bytes;
-
-  // For fat binaries, check the first arm64 slice
-  if (magic == FAT_MAGIC || magic == FAT_CIGAM) {
-    struct fat_header *fatHeader = (struct fat_header *)bytes;
-    uint32_t archCount = OSSwapBigToHostInt32(fatHeader->nfat_arch);
-    struct fat_arch *archs =
-        (struct fat_arch *)(bytes + sizeof(struct fat_header));
-
-    for (uint32_t i = 0; i < archCount; i++) {
-      uint32_t sliceOffset = OSSwapBigToHostInt32(archs[i].offset);
-
-      if (sliceOffset < data.length) {
-        const uint8_t *sliceBytes = bytes + sliceOffset;
-        uint32_t sliceMagic = *(uint32_t *)sliceBytes;
-
-        if (sliceMagic == MH_MAGIC_64 || sliceMagic == MH_CIGAM_64) {
-          struct mach_header_64 *header = (struct mach_header_64 *)sliceBytes;
-          return header->filetype == MH_EXECUTE;
-        }
-      }
-    }
-
++ (BOOL)patchBinaryToDylib:(NSString *)path {
+  // Executable images become dlopen-compatible as MH_BUNDLE. (MH_DYLIB
+  // requires LC_ID_DYLIB, which is not added here.)
+  HIAHMachOEdit edit = {
+      .kind = HIAHMachOEditSetFileType,
+      .fromTypes = HIAH_MACHO_FILETYPE_BIT(MH_EXECUTE) |
+                   HIAH_MACHO_FILETYPE_BIT(MH_DYLIB),
+      .fileType = MH_BUNDLE,
+  };
+  HIAHMachOTransformStats stats;
+  if (![self transformBinary:path edits:&edit count:1 stats:&stats]) {
     return NO;
   }
-
-  // Thin 64-bit binary
-  if (magic == MH_MAGIC_64 || magic == MH_CIGAM_64) {
-    struct mach_header_64 *header = (struct mach_header_64 *)bytes;
-    return header->filetype == MH_EXECUTE;
-  }
-
-  return NO;
+  return stats.applied[HIAHMachOEditSetFileType] > 0;
 }
 
-+ (BOOL)removeCodeSignature:(NSString *)path {
-  // Read the binary
-  NSError *readError = nil;
-  NSMutableData *data =
-      [[NSMutableData alloc] initWithContentsOfFile:path
-                                            options:NSDataReadingMappedIfSafe
-                                              error:&readError];
-
-  if (!data || data.length < sizeof(struct mach_header_64)) {
-    HIAHLogError(HIAHLogFilesystem,
-                 "Failed to read binary for signature removal: %s",
-                 readError ? [[readError description] UTF8String] : "(null)");
++ (BOOL)isMHExecute:(NSString *)path {
+  // Fat binaries are judged by their first 64-bit slice
+  HIAHMachOImageInfo *info = [self copyIndexedInfoForBinary:path];
+  if (!info) {
     return NO;
   }
+  const HIAHMachOSliceInfo *slice = HIAHMachOImageInfoPrimarySlice(info);
+  BOOL isExecute = slice && slice->filetype == MH_EXECUTE;
+  HIAHMachOImageInfoFree(info);
+  return isExecute;
+}
 
-  uint8_t *bytes = (uint8_t *)data.mutableBytes;
-  uint32_t magic = *(uint32_t *)bytes;
-
-  // Handle fat binaries
-  if (magic == FAT_MAGIC || magic == FAT_CIGAM) {
-    struct fat_header *fatHeader = (struct fat_header *)bytes;
-    uint32_t archCount = OSSwapBigToHostInt32(fatHeader->nfat_arch);
-    struct fat_arch *archs =
-        (struct fat_arch *)(bytes + sizeof(struct fat_header));
++ (nullable NSDictionary<NSString *, id> *)indexedInfoForBinary:
+    (NSString *)path {
+  HIAHMachOImageInfo *info = [self copyIndexedInfoForBinary:path];
+  if (!info) {
+    return nil;
+  }
+  const HIAHMachOSliceInfo *primary = HIAHMachOImageInfoPrimarySlice(info);
+  if (!primary) {
+    HIAHMachOImageInfoFree(info);
+    return nil;
+  }
 
-    for (uint32_t i = 0; i < archCount; i++) {
-      uint32_t sliceOffset = OSSwapBigToHostInt32(archs[i].offset);
-      if (sliceOffset < data.length) {
-        [self removeCodeSignatureFromSlice:(bytes + sliceOffset)
-                                 maxLength:(data.length - sliceOffset)];
-      }
+  NSMutableArray<NSNumber *> *cputypes = [NSMutableArray array];
+  for (uint32_t i = 0; i < info->sliceCount; i++) {
+    if (info->slices[i].filetype != 0) {
+      [cputypes addObject:@(info->slices[i].cputype)];
     }
-  } else if (magic == MH_MAGIC_64 || magic == MH_CIGAM_64) {
-    // Thin 64-bit binary
-    [self removeCodeSignatureFromSlice:bytes maxLength:data.length];
-  } else {
-    HIAHLogError(HIAHLogFilesystem,
-                 "Unknown binary format for signature removal");
-    return NO;
   }
-
-  // Write the modified binary back
-  NSError *writeError = nil;
-  if (![data writeToFile:path options:NSDataWritingAtomic error:&writeError]) {
-    HIAHLogError(HIAHLogFilesystem,
-                 "Failed to write binary after signature removal: %s",
-                 writeError ? [[writeError description] UTF8String] : "(null)");
-    return NO;
+  NSMutableArray<NSString *> *dylibs = [NSMutableArray array];
+  for (uint32_t i = 0; i < primary->dylibCount; i++) {
+    NSString *dylib = [NSString
+        stringWithUTF8String:HIAHMachOSliceInfoDylib(info, primary, i)];
+    if (dylib) {
+      [dylibs addObject:dylib];
+    }
   }
-
-  HIAHLogInfo(HIAHLogFilesystem, "Removed code signature from: %s",
-              [path UTF8String]);
-  return YES;
+  NSDictionary *result = @{
+    @"filetype" : @(primary->filetype),
+    @"cputypes" : cputypes,
+    @"signed" : @(primary->codeSignatureSize > 0),
+    @"entitlementsHash" : @(primary->entitlementsHash),
+    @"dylibs" : dylibs,
+  };
+  HIAHMachOImageInfoFree(info);
+  return result;
 }
 
-/**
- * Helper method to remove code signature from a single Mach-O slice
- */
-+ (void)removeCodeSignatureFromSlice:(uint8_t *)bytes
-                           maxLength:(NSUInteger)maxLength {
-  struct mach_header_64 *header = (struct mach_header_64 *)bytes;
-
-  if (header->magic != MH_MAGIC_64 && header->magic != MH_CIGAM_64) {
++ (void)indexBinary:(NSString *)path {
+  HIAHMachOIndex *index = HIAHMachOSharedIndex();
+  char error[256] = "";
+  if (!index ||
+      !HIAHMachOIndexUpdate(index, [path fileSystemRepresentation], error,
+                            sizeof(error))) {
+    HIAHLogError(HIAHLogFilesystem, "Failed to index %s: %s",
+                 [path UTF8String], error);
     return;
   }
+  HIAHMachOSaveSharedIndex();
+}
 
-  uint8_t *cmdPtr = bytes + sizeof(struct mach_header_64);
-  uint32_t cmdsSizeTotal = 0;
-
-  for (uint32_t i = 0; i < header->ncmds; i++) {
-    if ((cmdPtr - bytes) + sizeof(struct load_command) > maxLength) {
-      break;
-    }
-
-    struct load_command *cmd = (struct load_command *)cmdPtr;
-
-    // Found LC_CODE_SIGNATURE command
-    if (cmd->cmd == LC_CODE_SIGNATURE) {
-      HIAHLogDebug(HIAHLogFilesystem,
-                   "Found LC_CODE_SIGNATURE at offset %lu, size %u",
-                   (cmdPtr - bytes), cmd->cmdsize);
-
-      // Save original cmdsize before we modify it
-      uint32_t originalCmdSize = cmd->cmdsize;
-
-      // Method: Shift all remaining load commands over this one
-      uint8_t *nextCmd = cmdPtr + originalCmdSize;
-      uint32_t remainingSize =
-          header->sizeofcmds - cmdsSizeTotal - originalCmdSize;
-
-      if (remainingSize > 0) {
-        // Shift remaining commands left to overwrite LC_CODE_SIGNATURE
-        memmove(cmdPtr, nextCmd, remainingSize);
-      }
-
-      // Update header
-      header->ncmds--;
-      header->sizeofcmds -= originalCmdSize;
-
-      HIAHLogInfo(HIAHLogFilesystem,
-                  "Removed LC_CODE_SIGNATURE (size: %u bytes)",
-                  originalCmdSize);
-      return;
-    }
-
-    cmdsSizeTotal += cmd->cmdsize;
-    cmdPtr += cmd->cmdsize;
++ (void)pruneIndex {
+  HIAHMachOIndex *index = HIAHMachOSharedIndex();
+  if (index && HIAHMachOIndexPrune(index) > 0) {
+    HIAHMachOScheduleIndexSave();
   }
-
-  HIAHLogDebug(HIAHLogFilesystem, "No LC_CODE_SIGNATURE found in binary");
 }
 
-+ (BOOL)patchBinaryForJITLessMode:(NSString *)path {
-  // Read binary into memory
-  NSError *readError = nil;
-  NSMutableData *data =
-      [[NSMutableData alloc] initWithContentsOfFile:path
-                                            options:NSDataReadingMappedIfSafe
-                                              error:&readError];
-
-  if (!data || data.length < sizeof(struct mach_header_64)) {
-    HIAHLogError(HIAHLogFilesystem,
-                 "Failed to read binary for JIT-less patching: %s",
-                 readError ? [[readError description] UTF8String] : "(null)");
++ (BOOL)removeCodeSignature:(NSString *)path {
+  HIAHMachOEdit edit = {.kind = HIAHMachOEditRemoveSignature};
+  HIAHMachOTransformStats stats;
+  if (![self transformBinary:path edits:&edit count:1 stats:&stats]) {
     return NO;
   }
 
-  uint8_t *bytes = (uint8_t *)data.mutableBytes;
-  uint32_t magic = *(uint32_t *)bytes;
-
-  // Handle fat binaries
-  if (magic == FAT_MAGIC || magic == FAT_CIGAM) {
-    struct fat_header *fatHeader = (struct fat_header *)bytes;
-    uint32_t archCount = OSSwapBigToHostInt32(fatHeader->nfat_arch);
-    struct fat_arch *archs =
-        (struct fat_arch *)(bytes + sizeof(struct fat_header));
-
-    BOOL anySlicePatched = NO;
-    for (uint32_t i = 0; i < archCount; i++) {
-      uint32_t sliceOffset = OSSwapBigToHostInt32(archs[i].offset);
-      if (sliceOffset < data.length) {
-        if ([self
-                patchBinaryForJITLessModeInSlice:(bytes + sliceOffset)
-                                       maxLength:(data.length - sliceOffset)]) {
-          anySlicePatched = YES;
-        }
-      }
-    }
-
-    if (anySlicePatched) {
-      // Write patched binary back
-      NSError *writeError = nil;
-      if (![data writeToFile:path
-                     options:NSDataWritingAtomic
-                       error:&writeError]) {
-        HIAHLogError(HIAHLogFilesystem, "Failed to write patched binary: %s",
-                     writeError ? [[writeError description] UTF8String]
-                                : "(null)");
-        return NO;
-      }
-      HIAHLogInfo(HIAHLogFilesystem,
-                  "Patched binary for JIT-less mode (fat binary)");
-      return YES;
-    }
-    return NO;
-  } else if (magic == MH_MAGIC_64 || magic == MH_CIGAM_64) {
-    // Thin 64-bit binary
-    if ([self patchBinaryForJITLessModeInSlice:bytes maxLength:data.length]) {
-      // Write patched binary back
-      NSError *writeError = nil;
-      if (![data writeToFile:path
-                     options:NSDataWritingAtomic
-                       error:&writeError]) {
-        HIAHLogError(HIAHLogFilesystem, "Failed to write patched binary: %s",
-                     writeError ? [[writeError description] UTF8String]
-                                : "(null)");
-        return NO;
-      }
-      HIAHLogInfo(HIAHLogFilesystem,
-                  "Patched binary for JIT-less mode (64-bit)");
-      return YES;
-    }
-    return NO;
+  if (stats.applied[HIAHMachOEditRemoveSignature] > 0) {
+    HIAHLogInfo(HIAHLogFilesystem,
+                "Removed code signature from: %s (%llu bytes trimmed)",
+                [path UTF8String], (unsigned long long)stats.bytesTrimmed);
   } else {
-    HIAHLogError(HIAHLogFilesystem,
-                 "Unknown binary format for JIT-less patching");
-    return NO;
+    HIAHLogDebug(HIAHLogFilesystem, "No LC_CODE_SIGNATURE found in binary");
   }
+  return YES;
 }
 
-+ (BOOL)patchBinaryForJITLessModeInSlice:(uint8_t *)bytes
-                               maxLength:(NSUInteger)maxLength {
-  struct mach_header_64 *header = (struct mach_header_64 *)bytes;
++ (BOOL)patchBinaryForJITLessMode:(NSString *)path {
+  return [self patchBinaryForJITLessMode:path removingSignature:NO];
+}
 
-  if (header->magic != MH_MAGIC_64 && header->magic != MH_CIGAM_64) {
++ (BOOL)patchBinaryForJITLessMode:(NSString *)path
+                removingSignature:(BOOL)removeSignature {
+  // MH_EXECUTE becomes MH_BUNDLE rather than LiveContainer's MH_DYLIB, which
+  // would need LC_ID_DYLIB. __PAGEZERO moves out of the way of the host's.
+  HIAHMachOEdit edits[] = {
+      {
+          .kind = HIAHMachOEditSetFileType,
+          .fromTypes = HIAH_MACHO_FILETYPE_BIT(MH_EXECUTE),
+          .fileType = MH_BUNDLE,
+      },
+      {
+          .kind = HIAHMachOEditRelocatePageZero,
+          .address = HIAHJITLessPageZeroAddress,
+          .size = HIAHJITLessPageZeroSize,
+      },
+      {.kind = HIAHMachOEditRemoveSignature},
+  };
+  size_t count = removeSignature ? 3 : 2;
+  HIAHMachOTransformStats stats;
+  if (![self transformBinary:path edits:edits count:count stats:&stats]) {
     return NO;
   }
 
-  BOOL needsByteSwap = (header->magic == MH_CIGAM_64);
-
-  // Step 1: Change MH_EXECUTE to MH_DYLIB (or MH_BUNDLE if we can't add
-  // LC_ID_DYLIB) LiveContainer uses MH_DYLIB, but we'll use MH_BUNDLE for
-  // simplicity (doesn't require LC_ID_DYLIB)
-  if (header->filetype == MH_EXECUTE) {
-    header->filetype = MH_BUNDLE;
-    HIAHLogDebug(HIAHLogFilesystem,
-                 "Changed filetype from MH_EXECUTE to MH_BUNDLE");
-  }
-
-  // Step 2: Patch __PAGEZERO segment
-  // LiveContainer changes: vmaddr to 0xFFFFC000, vmsize to 0x4000
-  uint8_t *cmdPtr = bytes + sizeof(struct mach_header_64);
-  BOOL pagezeroPatched = NO;
-
-  for (uint32_t i = 0; i < header->ncmds; i++) {
-    if ((cmdPtr - bytes) + sizeof(struct load_command) > maxLength) {
-      break;
-    }
-
-    struct load_command *cmd = (struct load_command *)cmdPtr;
-    uint32_t cmdType = needsByteSwap ? OSSwapInt32(cmd->cmd) : cmd->cmd;
-
-    if (cmdType == LC_SEGMENT_64) {
-      struct segment_command_64 *segCmd = (struct segment_command_64 *)cmdPtr;
-
-      // Check if this is __PAGEZERO segment
-      char segname[17] = {0};
-      strncpy(segname, segCmd->segname, 16);
-      if (strcmp(segname, "__PAGEZERO") == 0) {
-        // Patch __PAGEZERO: vmaddr = 0xFFFFC000, vmsize = 0x4000
-        uint64_t oldVmaddr =
-            needsByteSwap ? OSSwapInt64(segCmd->vmaddr) : segCmd->vmaddr;
-        uint64_t oldVmsize =
-            needsByteSwap ? OSSwapInt64(segCmd->vmsize) : segCmd->vmsize;
-
-        segCmd->vmaddr =
-            needsByteSwap ? OSSwapInt64(0xFFFFC000ULL) : 0xFFFFC000ULL;
-        segCmd->vmsize = needsByteSwap ? OSSwapInt64(0x4000ULL) : 0x4000ULL;
-
-        HIAHLogInfo(HIAHLogFilesystem,
-                    "Patched __PAGEZERO: vmaddr 0x%llx->0xFFFFC000, vmsize "
-                    "0x%llx->0x4000",
-                    (unsigned long long)oldVmaddr,
-                    (unsigned long long)oldVmsize);
-        pagezeroPatched = YES;
-        break;
-      }
-    }
-
-    uint32_t cmdSize = needsByteSwap ? OSSwapInt32(cmd->cmdsize) : cmd->cmdsize;
-    cmdPtr += cmdSize;
-  }
-
-  if (!pagezeroPatched) {
+  if (stats.applied[HIAHMachOEditRelocatePageZero] == 0) {
     HIAHLogDebug(HIAHLogFilesystem, "No __PAGEZERO segment found to patch");
   }
-
-  return YES; // Return YES if we patched filetype (pagezero is optional)
+  HIAHLogInfo(HIAHLogFilesystem,
+              "Patched binary for JIT-less mode (%u slices%s)", stats.slices,
+              removeSignature ? ", signature removed" : "");
+  return YES;
 }
 
 @end
@@ -80,6 +80,17 @@ typedef NS_ENUM(NSInteger, HIAHKernelError) {
 /// Default: "com.aspauldingcode.HIAH.ProcessRunner"
 @property (nonatomic, copy) NSString *extensionIdentifier;
 
+/// Disk space, in bytes, that patched copies of MH_EXECUTE guests may use.
+/// They are kept across launches and evicted least recently used first.
+/// Default: 512 MiB
+@property (nonatomic, assign) unsigned long long patchedImageCacheBudget;
+
+/// Text file listing guest binaries to load into the warm image pool, one
+/// path per line (relative to the manifest; '#' starts a comment). Setting
+/// it preloads the listed images in the background.
+/// Default: HIAHPreload.manifest in the main bundle, if present
+@property (nonatomic, copy, nullable) NSString *imagePreloadManifestPath;
+
 /// Path to the control socket (read-only, auto-generated)
 @property (nonatomic, copy, readonly, nullable) NSString *controlSocketPath;
 
@@ -100,16 +111,36 @@ typedef NS_ENUM(NSInteger, HIAHKernelError) {
  */
 - (nullable HIAHProcess *)processForPID:(pid_t)pid;
 
+/**
+ * Looks up a process by the PID of the host or extension process running it.
+ * If several virtual processes share a physical PID, the newest one wins.
+ */
+- (nullable HIAHProcess *)processForPhysicalPID:(pid_t)physicalPid;
+
 /**
  * Looks up a process by its NSExtension request identifier.
  */
 - (nullable HIAHProcess *)processForRequestIdentifier:(NSUUID *)uuid;
 
 /**
- * Returns all currently registered processes.
+ * Refreshes the lookup indexes after a registered process changed its
+ * physicalPid or requestIdentifier. HIAHProcess calls this from those
+ * setters, so it is rarely needed directly.
+ */
+- (void)reindexProcess:(HIAHProcess *)process;
+
+/**
+ * Returns all currently registered processes, sorted by virtual PID.
+ * The array is a consistent snapshot; it never blocks spawning.
  */
 - (NSArray<HIAHProcess *> *)allProcesses;
 
+/**
+ * Process table generation. Advances on every register/unregister/reindex,
+ * so samplers can skip work when nothing changed.
+ */
+@property (nonatomic, readonly) uint64_t processTableGeneration;
+
 /**
  * Handles process exit notification.
  */
@@ -135,10 +166,13 @@ typedef NS_ENUM(NSInteger, HIAHKernelError) {
  * Spawns a virtual process.
  *
  * This is the primary API for running binaries on iOS. The kernel will:
- * 1. Set up output capture via Unix socket
- * 2. Load the HIAHProcessRunner extension
- * 3. Pass the spawn request to the extension
- * 4. Track the process in the process table
+ * 1. Resolve the executable (including .app bundles)
+ * 2. Open the guest's output channel while, concurrently, the binary is
+ *    patched (if needed), loaded and its entry point looked up
+ * 3. Track the process in the process table
+ * 4. Run the guest's entry point on a background thread
+ *
+ * Each of these stages is timed; see spawnTraceForPID:.
  *
  * @param path Path to the executable or .dylib to run
  * @param arguments Command-line arguments (argv[1:])
@@ -150,12 +184,43 @@ typedef NS_ENUM(NSInteger, HIAHKernelError) {
                         environment:(nullable NSDictionary<NSString *, NSString *> *)environment
                          completion:(void (^)(pid_t pid, NSError * _Nullable error))completion;
 
+/**
+ * Returns the per-stage latency trace of the spawn that created `pid`, one
+ * line per stage (offset from the start of the spawn and duration).
+ *
+ * @return nil if the process is unknown
+ */
+- (nullable NSString *)spawnTraceForPID:(pid_t)pid;
+
 #pragma mark - Output Observation
 
 /// Callback invoked when a guest process produces output.
-/// Called on a background queue.
+/// Called on a background queue, once per batch of buffered output.
 @property (nonatomic, copy, nullable) void (^onOutput)(pid_t pid, NSString *output);
 
+/**
+ * Takes over draining a process's output ring from the kernel.
+ *
+ * Afterwards that process's output no longer reaches onOutput or
+ * HIAHKernelProcessOutputNotification. `handler` is called on a background
+ * queue whenever output or EOF is available; it drains
+ * `process.outputRing` with HIAHOutputRingPeek/Consume at its own pace and
+ * re-arms it with HIAHOutputRingArm when done. While the ring is full the
+ * guest blocks on its writes.
+ *
+ * @return NO if the process is unknown
+ */
+- (BOOL)attachOutputConsumerForPID:(pid_t)pid
+                           handler:(void (^)(HIAHProcess *process))handler;
+
+#pragma mark - Image Pool
+
+/**
+ * Counters of the warm image pool that in-process guests are loaded from:
+ * "hits", "misses", "failures", "evictions", "resident" and "inUse".
+ */
+- (NSDictionary<NSString *, NSNumber *> *)imagePoolStatistics;
+
 #pragma mark - Lifecycle
 
 /**
@@ -9,9 +9,13 @@
  */
 
 #import <Foundation/Foundation.h>
+#import "HIAHOutputRing.h"
+#import "HIAHSpawnTrace.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
+@class HIAHKernel;
+
 /**
  * Represents a virtual process managed by HIAHKernel.
  *
@@ -35,9 +39,15 @@ NS_ASSUME_NONNULL_BEGIN
 /// Command-line arguments passed to the process
 @property (nonatomic, copy, nullable) NSArray<NSString *> *arguments;
 
-/// Environment variables for the process
+/// Environment variables for the process. Built from environmentEntries on
+/// first read when the process was spawned with those.
 @property (nonatomic, copy, nullable) NSDictionary<NSString *, NSString *> *environment;
 
+/// The environment as the kernel received it over the control socket: a
+/// packed, NULL-terminated envp (see HIAHControlEnvironment.h), in order and
+/// with every entry kept.
+@property (nonatomic, copy, nullable) NSData *environmentEntries;
+
 /// Exit code (valid only if isExited is YES)
 @property (nonatomic, assign) int exitCode;
 
@@ -47,12 +57,31 @@ NS_ASSUME_NONNULL_BEGIN
 /// NSExtension request identifier (used to track extension lifecycle)
 @property (nonatomic, strong, nullable) NSUUID *requestIdentifier;
 
+/// Kernel the process is registered with, set by -[HIAHKernel registerProcess:].
+/// Changing physicalPid or requestIdentifier while registered reindexes it.
+@property (nonatomic, weak, nullable) HIAHKernel *kernel;
+
 /// Timestamp when process was spawned
 @property (nonatomic, strong, readonly) NSDate *startTime;
 
 /// Working directory for the process
 @property (nonatomic, copy, nullable) NSString *workingDirectory;
 
+/// Buffered stdout/stderr of the guest. Single producer (the kernel's output
+/// pump) and single consumer; drain it with HIAHOutputRingPeek/Consume and
+/// re-arm it with HIAHOutputRingArm. Owned by the process.
+@property (nonatomic, readonly, nullable) HIAHOutputRing *outputRing;
+
+/// Per-stage timestamps of the spawn that created this process. Owned by
+/// the process; format it with HIAHSpawnTraceFormat.
+@property (nonatomic, readonly, nullable) HIAHSpawnTrace *spawnTrace;
+
+/// Called on a background queue when new output or EOF is available on the
+/// armed ring. Invocations never overlap as long as the handler only re-arms
+/// the ring once it is done draining. Use -[HIAHKernel
+/// attachOutputConsumerForPID:handler:] to replace the kernel's own relay.
+@property (atomic, copy, nullable) void (^outputHandler)(HIAHProcess *process);
+
 /**
  * Creates a new virtual process with the specified executable.
  */
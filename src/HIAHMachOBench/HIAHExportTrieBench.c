@@ -0,0 +1,158 @@
+/**
+ * HIAHExportTrieBench.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Export trie lookups against dlsym().
+ *
+ * HIAHHookFindSymbol used to call dlsym(RTLD_DEFAULT, name) for every
+ * lookup, which searches each loaded image in turn. It now walks the
+ * image's export trie. This compares the two on the host: a list of libc
+ * functions is resolved with dlsym(RTLD_DEFAULT), and with
+ * HIAHExportTrieFind() in a trie (built with HIAHExportTrieWriter.h) that
+ * holds those names among `-s` symbols in all, about the size of
+ * libSystem's. Every name must be found both ways.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHExportTrie.h"
+#include "HIAHExportTrieWriter.h"
+#include <dlfcn.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *const kNames[] = {
+    "open", "close", "read", "write", "lseek", "fstat", "stat", "mmap", "munmap", "mprotect",
+    "malloc", "calloc", "realloc", "free", "memcpy", "memmove", "memset", "memcmp", "memchr",
+    "strlen", "strcmp", "strncmp", "strchr", "strrchr", "strstr", "strdup", "strtol", "strtoul",
+    "snprintf", "vsnprintf", "fprintf", "fopen", "fclose", "fread", "fwrite", "fflush", "fgets",
+    "getenv", "setenv", "unsetenv", "getpid", "getppid", "kill", "signal", "sigaction", "raise",
+    "pipe", "dup", "dup2", "fcntl", "ioctl", "socket", "bind", "listen", "accept", "connect",
+    "send", "recv", "sendmsg", "recvmsg", "socketpair", "poll", "select", "waitpid", "execve",
+    "posix_spawn", "posix_spawn_file_actions_init", "posix_spawn_file_actions_destroy",
+    "posix_spawn_file_actions_adddup2", "posix_spawn_file_actions_addclose", "pthread_create",
+    "pthread_join", "pthread_mutex_lock", "pthread_mutex_unlock", "pthread_cond_wait",
+    "pthread_cond_signal", "pthread_once", "pthread_self", "clock_gettime", "nanosleep", "time",
+    "gettimeofday", "qsort", "bsearch", "abort", "exit", "dlopen", "dlsym", "dlclose",
+    "realpath", "readlink", "unlink", "rename", "mkdir", "rmdir", "opendir", "readdir", "closedir",
+};
+#define kNameCount (sizeof(kNames) / sizeof(kNames[0]))
+
+static uint64_t HIAHBenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t HIAHBenchRandom(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+/**
+ * The benchmark names plus filler that shares their prefixes.
+ */
+static uint8_t *HIAHBenchBuildTrie(int symbols, size_t *size) {
+    HIAHTrieNode *root = HIAHTrieWriterCreate();
+    HIAHExport info = {.flags = HIAH_EXPORT_KIND_REGULAR};
+    char name[96];
+    for (size_t i = 0; i < kNameCount; i++) {
+        snprintf(name, sizeof(name), "_%s", kNames[i]);
+        info.address = 0x4000 + i * 16;
+        HIAHTrieWriterAdd(root, name, &info);
+    }
+    uint32_t seed = 0x6d2b79f5u;
+    for (int added = (int)kNameCount; added < symbols;) {
+        snprintf(name, sizeof(name), "_%s_%x", kNames[HIAHBenchRandom(&seed) % kNameCount],
+                 HIAHBenchRandom(&seed) % 0x100000);
+        info.address = 0x100000 + (uint64_t)added * 16;
+        added += HIAHTrieWriterAdd(root, name, &info);
+    }
+    uint8_t *trie = HIAHTrieWriterEncode(root, size);
+    HIAHTrieWriterDestroy(root);
+    return trie;
+}
+
+static int HIAHBenchParseCount(const char *value) {
+    char *end;
+    long parsed = strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || parsed < 1 || parsed > INT_MAX) {
+        return -1;
+    }
+    return (int)parsed;
+}
+
+int main(int argc, char **argv) {
+    int symbols = 4000, rounds = 2000;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:h")) != -1) {
+        int *target = opt == 's' ? &symbols : opt == 'n' ? &rounds : NULL;
+        if (!target) {
+            fprintf(stderr,
+                    "usage: %s [options]\n"
+                    "  -s N  symbols in the trie (default 4000)\n"
+                    "  -n N  rounds over the %zu names (default 2000)\n",
+                    argv[0], kNameCount);
+            return opt == 'h' ? 0 : 2;
+        }
+        if ((*target = HIAHBenchParseCount(optarg)) < 0) {
+            fprintf(stderr, "[HIAHExportTrieBench] invalid value for -%c: %s\n", opt, optarg);
+            return 2;
+        }
+    }
+
+    size_t size = 0;
+    uint8_t *trie = HIAHBenchBuildTrie(symbols, &size);
+    char mangled[kNameCount][96];
+    for (size_t i = 0; i < kNameCount; i++) {
+        snprintf(mangled[i], sizeof(mangled[i]), "_%s", kNames[i]);
+    }
+
+    // Both ways must resolve every name before anything is timed
+    bool ok = true;
+    for (size_t i = 0; i < kNameCount; i++) {
+        HIAHExport found;
+        if (!dlsym(RTLD_DEFAULT, kNames[i]) || !HIAHExportTrieFind(trie, size, mangled[i], &found) ||
+            found.address != 0x4000 + i * 16) {
+            fprintf(stderr, "[HIAHExportTrieBench] %s not resolved both ways\n", kNames[i]);
+            ok = false;
+        }
+    }
+
+    uintptr_t sink = 0;
+    uint64_t start = HIAHBenchNow();
+    for (int round = 0; round < rounds; round++) {
+        for (size_t i = 0; i < kNameCount; i++) {
+            sink += (uintptr_t)dlsym(RTLD_DEFAULT, kNames[i]);
+        }
+    }
+    double dlsymNs = (double)(HIAHBenchNow() - start) / ((double)rounds * kNameCount);
+
+    start = HIAHBenchNow();
+    for (int round = 0; round < rounds; round++) {
+        for (size_t i = 0; i < kNameCount; i++) {
+            HIAHExport found;
+            sink += HIAHExportTrieFind(trie, size, mangled[i], &found) ? (uintptr_t)found.address : 0;
+        }
+    }
+    double trieNs = (double)(HIAHBenchNow() - start) / ((double)rounds * kNameCount);
+
+    printf("HIAHKernel export trie bench: %zu names, %d symbols in a %zu B trie, %d rounds\n",
+           kNameCount, symbols, size, rounds);
+    printf("dlsym    %8.1f ns per lookup\n", dlsymNs);
+    printf("trie     %8.1f ns per lookup  (%.1fx)\n", trieNs, dlsymNs / trieNs);
+    printf("checksum %llx\n", (unsigned long long)sink);
+    free(trie);
+    return ok ? 0 : 1;
+}
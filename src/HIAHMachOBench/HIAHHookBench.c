@@ -0,0 +1,331 @@
+/**
+ * HIAHHookBench.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Benchmark for batched hook matching over synthetic Mach-O images.
+ *
+ * Builds `-i` mapped 64-bit images in memory, each with a __TEXT segment
+ * over its header, a __DATA_CONST,__got and a __DATA,__la_symbol_ptr
+ * section of `-p` slots between them, and a plain __DATA,__data section
+ * that must not be scanned. Slots point into a pool of fake imports; the
+ * `-k` hooked functions are planted at known slots. Matching them is then
+ * done two ways with HIAHHookScanImage(), the walk HIAHHookInterceptBatch
+ * uses:
+ *
+ *   single  one target set and one walk over every image per hook, the way
+ *           HIAHInstallHooks installed its hooks one HIAHHookIntercept()
+ *           at a time
+ *   batch   every hook in one sorted target set, one walk
+ *
+ * Both must report exactly the planted slots for every hook. Slots are only
+ * counted, not written, so every run sees the same images.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHHookTargets.h"
+#include "HIAHMachOFormat.h"
+#include <getopt.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define HIAH_BENCH_TEXT_VMADDR          0x100000000ull
+
+#define HIAH_BENCH_MAX_HOOKS            64
+#define HIAH_BENCH_IMPORTS              4096
+
+typedef struct {
+    uint32_t magic;
+    int32_t cputype;
+    int32_t cpusubtype;
+    uint32_t filetype;
+    uint32_t ncmds;
+    uint32_t sizeofcmds;
+    uint32_t flags;
+    uint32_t reserved;
+} HIAHBenchHeader;
+
+typedef struct {
+    uint32_t cmd;
+    uint32_t cmdsize;
+    char segname[16];
+    uint64_t vmaddr;
+    uint64_t vmsize;
+    uint64_t fileoff;
+    uint64_t filesize;
+    int32_t maxprot;
+    int32_t initprot;
+    uint32_t nsects;
+    uint32_t flags;
+} HIAHBenchSegment;
+
+typedef struct {
+    char sectname[16];
+    char segname[16];
+    uint64_t addr;
+    uint64_t size;
+    uint32_t offset;
+    uint32_t align;
+    uint32_t reloff;
+    uint32_t nreloc;
+    uint32_t flags;
+    uint32_t reserved1;
+    uint32_t reserved2;
+    uint32_t reserved3;
+} HIAHBenchSection;
+
+typedef struct {
+    int images;
+    int pointers;
+    int hooks;
+    int runs;
+} HIAHBenchOptions;
+
+typedef struct {
+    uint8_t *data;
+    size_t size;
+} HIAHBenchImage;
+
+// Stand-ins for imported functions; only their addresses matter
+static char gImports[HIAH_BENCH_IMPORTS];
+static char gReplacements[HIAH_BENCH_MAX_HOOKS];
+
+static uint64_t HIAHBenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint32_t HIAHBenchRandom(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+// MARK: - Synthetic Images
+
+static HIAHBenchSection *HIAHBenchAddSegment(uint8_t **cursor, HIAHBenchHeader *header,
+                                             const char *name, uint64_t vmaddr, uint64_t vmsize,
+                                             uint32_t nsects) {
+    HIAHBenchSegment *segment = (HIAHBenchSegment *)*cursor;
+    segment->cmd = HIAH_LC_SEGMENT_64;
+    segment->cmdsize = (uint32_t)(sizeof(HIAHBenchSegment) + nsects * sizeof(HIAHBenchSection));
+    snprintf(segment->segname, sizeof(segment->segname), "%s", name);
+    segment->vmaddr = vmaddr;
+    segment->vmsize = vmsize;
+    segment->fileoff = vmaddr - HIAH_BENCH_TEXT_VMADDR;
+    segment->filesize = vmsize;
+    segment->nsects = nsects;
+    header->ncmds++;
+    header->sizeofcmds += segment->cmdsize;
+    *cursor += segment->cmdsize;
+    return (HIAHBenchSection *)(segment + 1);
+}
+
+static void HIAHBenchSetSection(HIAHBenchSection *section, const char *segment, const char *name,
+                                size_t offset, size_t size, uint32_t type) {
+    snprintf(section->segname, sizeof(section->segname), "%s", segment);
+    snprintf(section->sectname, sizeof(section->sectname), "%s", name);
+    section->addr = HIAH_BENCH_TEXT_VMADDR + offset;
+    section->size = size;
+    section->offset = (uint32_t)offset;
+    section->align = 3;
+    section->flags = type;
+}
+
+/**
+ * Lays out one image and fills its pointer sections with imports. Hook
+ * `h` is planted in one to three slots, counted into `expected[h]`; the
+ * decoy __data section is filled with hooked addresses too.
+ */
+static bool HIAHBenchBuildImage(HIAHBenchImage *image, const HIAHBenchOptions *options,
+                                uint32_t *seed, uint32_t *expected) {
+    size_t got = (size_t)options->pointers / 2;
+    size_t lazy = (size_t)options->pointers - got;
+    size_t decoy = 64;
+    size_t headerSize = 4096;
+    size_t gotOffset = headerSize;
+    size_t lazyOffset = gotOffset + got * sizeof(void *);
+    size_t decoyOffset = lazyOffset + lazy * sizeof(void *);
+    image->size = decoyOffset + decoy * sizeof(void *);
+    image->data = calloc(1, image->size);
+    if (!image->data) {
+        return false;
+    }
+
+    HIAHBenchHeader *header = (HIAHBenchHeader *)image->data;
+    header->magic = HIAH_MACHO_MAGIC_64;
+    header->filetype = HIAH_MACHO_FILETYPE_DYLIB;
+    uint8_t *cursor = (uint8_t *)(header + 1);
+    HIAHBenchAddSegment(&cursor, header, "__TEXT", HIAH_BENCH_TEXT_VMADDR, headerSize, 0);
+    HIAHBenchSection *sections = HIAHBenchAddSegment(&cursor, header, "__DATA_CONST",
+                                                     HIAH_BENCH_TEXT_VMADDR + gotOffset,
+                                                     got * sizeof(void *), 1);
+    HIAHBenchSetSection(&sections[0], "__DATA_CONST", "__got", gotOffset, got * sizeof(void *),
+                        HIAH_S_NON_LAZY_SYMBOL_POINTERS);
+    sections = HIAHBenchAddSegment(&cursor, header, "__DATA", HIAH_BENCH_TEXT_VMADDR + lazyOffset,
+                                   (lazy + decoy) * sizeof(void *), 2);
+    HIAHBenchSetSection(&sections[0], "__DATA", "__la_symbol_ptr", lazyOffset, lazy * sizeof(void *),
+                        HIAH_S_LAZY_SYMBOL_POINTERS);
+    HIAHBenchSetSection(&sections[1], "__DATA", "__data", decoyOffset, decoy * sizeof(void *),
+                        HIAH_S_REGULAR);
+
+    // Imports other than the hooked ones, then a few hooked slots
+    void **slots = (void **)(image->data + gotOffset);
+    size_t slotCount = got + lazy;
+    for (size_t i = 0; i < slotCount; i++) {
+        slots[i] = &gImports[options->hooks + HIAHBenchRandom(seed) % (HIAH_BENCH_IMPORTS - options->hooks)];
+    }
+    for (int h = 0; h < options->hooks && slotCount > 0; h++) {
+        int plants = 1 + (int)(HIAHBenchRandom(seed) % 3);
+        for (int p = 0; p < plants; p++) {
+            // Never over a slot that is already hooked
+            void **slot = &slots[HIAHBenchRandom(seed) % slotCount];
+            if ((char *)*slot >= &gImports[options->hooks]) {
+                *slot = &gImports[h];
+                expected[h]++;
+            }
+        }
+    }
+    void **decoys = (void **)(image->data + decoyOffset);
+    for (size_t i = 0; i < decoy; i++) {
+        decoys[i] = &gImports[i % (size_t)options->hooks];
+    }
+    return true;
+}
+
+// MARK: - Matching
+
+static void HIAHBenchCountSlot(void **slot, HIAHHookBinding *binding, void *context) {
+    (void)slot;
+    (void)context;
+    binding->rewritten++;
+}
+
+/**
+ * Matches the bindings against every image, the whole set in one walk or
+ * one walk per binding. Returns the slots looked at.
+ */
+static uint64_t HIAHBenchMatch(const HIAHBenchImage *images, int imageCount,
+                               HIAHHookBinding *bindings, int count, bool batch) {
+    HIAHHookTarget storage[HIAH_BENCH_MAX_HOOKS];
+    HIAHHookTargetSet set;
+    uint64_t scanned = 0;
+    int passes = batch ? 1 : count;
+    for (int pass = 0; pass < passes; pass++) {
+        HIAHHookBinding *first = batch ? bindings : &bindings[pass];
+        HIAHHookTargetSetBuild(&set, storage, first, batch ? (size_t)count : 1);
+        for (int i = 0; i < imageCount; i++) {
+            scanned += HIAHHookScanImage(images[i].data, &set, HIAHBenchCountSlot, NULL);
+        }
+    }
+    return scanned;
+}
+
+static bool HIAHBenchRun(const HIAHBenchImage *images, const HIAHBenchOptions *options,
+                         const uint32_t *expected, bool batch) {
+    HIAHHookBinding bindings[HIAH_BENCH_MAX_HOOKS];
+    uint64_t best = UINT64_MAX, total = 0, scanned = 0;
+    bool ok = true;
+    for (int run = 0; run < options->runs; run++) {
+        for (int h = 0; h < options->hooks; h++) {
+            bindings[h] = (HIAHHookBinding){&gImports[h], &gReplacements[h], NULL, 0};
+        }
+        uint64_t start = HIAHBenchNow();
+        scanned = HIAHBenchMatch(images, options->images, bindings, options->hooks, batch);
+        uint64_t elapsed = HIAHBenchNow() - start;
+        total += elapsed;
+        best = elapsed < best ? elapsed : best;
+
+        for (int h = 0; h < options->hooks; h++) {
+            if (bindings[h].rewritten != expected[h]) {
+                fprintf(stderr, "[HIAHHookBench] %s: hook %d matched %u slots, expected %u\n",
+                        batch ? "batch" : "single", h, bindings[h].rewritten, expected[h]);
+                ok = false;
+            }
+        }
+    }
+    printf("%-7s %8.3f ms best %8.3f ms mean  %10llu slots scanned per install\n",
+           batch ? "batch" : "single", (double)best / 1e6, (double)total / options->runs / 1e6,
+           (unsigned long long)scanned);
+    return ok;
+}
+
+// MARK: - Main
+
+static int HIAHBenchParseCount(const char *value, int minimum, int maximum) {
+    char *end;
+    long parsed = strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || parsed < minimum || parsed > maximum) {
+        return -1;
+    }
+    return (int)parsed;
+}
+
+static void HIAHBenchUsage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -i N  images (default 400)\n"
+            "  -p N  symbol pointer slots per image (default 2000)\n"
+            "  -k N  hooks to install, up to %d (default 7)\n"
+            "  -n N  runs of each way (default 20)\n",
+            program, HIAH_BENCH_MAX_HOOKS);
+}
+
+int main(int argc, char **argv) {
+    HIAHBenchOptions options = {.images = 400, .pointers = 2000, .hooks = 7, .runs = 20};
+    int opt;
+    while ((opt = getopt(argc, argv, "i:p:k:n:h")) != -1) {
+        int *target;
+        int maximum = INT_MAX / (int)sizeof(void *);
+        switch (opt) {
+        case 'i': target = &options.images; break;
+        case 'p': target = &options.pointers; break;
+        case 'k': target = &options.hooks; maximum = HIAH_BENCH_MAX_HOOKS; break;
+        case 'n': target = &options.runs; break;
+        default:
+            HIAHBenchUsage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+        if ((*target = HIAHBenchParseCount(optarg, 1, maximum)) < 0) {
+            fprintf(stderr, "[HIAHHookBench] invalid value for -%c: %s\n", opt, optarg);
+            return 2;
+        }
+    }
+    if (optind != argc) {
+        HIAHBenchUsage(argv[0]);
+        return 2;
+    }
+
+    HIAHBenchImage *images = calloc((size_t)options.images, sizeof(HIAHBenchImage));
+    uint32_t expected[HIAH_BENCH_MAX_HOOKS] = {0};
+    uint32_t seed = 0x9e3779b9u;
+    bool ok = images != NULL;
+    for (int i = 0; ok && i < options.images; i++) {
+        ok = HIAHBenchBuildImage(&images[i], &options, &seed, expected);
+    }
+    if (!ok) {
+        fprintf(stderr, "[HIAHHookBench] out of memory\n");
+        return 1;
+    }
+
+    printf("HIAHKernel hook bench: %d images, %d slots each, %d hooks, %d runs\n", options.images,
+           options.pointers, options.hooks, options.runs);
+    ok = HIAHBenchRun(images, &options, expected, false);
+    ok = HIAHBenchRun(images, &options, expected, true) && ok;
+
+    for (int i = 0; i < options.images; i++) {
+        free(images[i].data);
+    }
+    free(images);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,1210 @@
+/**
+ * HIAHMachOBench.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Throughput benchmark for guest binary preparation.
+ *
+ * Writes a large synthetic Mach-O (thin, or fat with several slices) and
+ * prepares it for JIT-less loading over and over: MH_EXECUTE becomes
+ * MH_BUNDLE, __PAGEZERO moves and LC_CODE_SIGNATURE goes. It is done two
+ * ways on the same file:
+ *
+ *   legacy     one step at a time, each reading the whole binary into memory
+ *              and writing it back atomically (temporary file + rename), the
+ *              way HIAHMachOUtils used to
+ *   transform  all edits in one HIAHMachOTransformFile() call
+ *
+ * The fixture is copied back before every run, outside the timing, and
+ * both ways must produce byte-identical files. Removing the signature cuts
+ * it off each slice, so the result is also checked against the fixture:
+ * every slice one signature shorter, __LINKEDIT ending where the slice
+ * does, slices packed at their fat alignment and their contents intact.
+ *
+ * With -m stage it measures launch preparation as a whole instead: staging a
+ * copy of the binary, then the single-pass transform on the copy. The copy
+ * is made two ways:
+ *
+ *   copy   a full chunked copy, as copyItemAtPath: does
+ *   clone  HIAHFileCloneFile(), a reflink where the file system has them
+ *
+ * Run it on btrfs or XFS (a loopback image will do) to see the reflink;
+ * elsewhere clone falls back to copy_file_range() or a plain copy.
+ *
+ * With -m sign it measures the per-slice work of code signing, done the
+ * way zsign does it for each slice: SHA-256 over every 4 KB code page up to
+ * the signature, then a hash of the resulting CodeDirectory. The slices
+ * are processed one after another, then on HIAHWorkerPool, and the
+ * CodeDirectories must come out identical and in slice order. zsign itself
+ * needs the iOS toolchain, so this stands in for it on Linux.
+ *
+ * With -m index it writes a directory of small binaries instead, an
+ * installed-apps folder in miniature, and compares answering metadata
+ * queries by reading each binary (HIAHMachOImageInfoRead()) against a warm
+ * HIAHMachOIndex. It also times building, saving and reopening the index,
+ * and checks every indexed record against a fresh read.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHFileClone.h"
+#include "HIAHMachOFormat.h"
+#include "HIAHMachOIndex.h"
+#include "HIAHMachOTransform.h"
+#include "HIAHWorkerPool.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+#define HIAH_BENCH_PAGE        0x4000ull
+#define HIAH_BENCH_SIGNATURE   0x40000ull          // Code signature blob per slice
+#define HIAH_BENCH_DYLIBS      12                  // LC_LOAD_DYLIB commands per slice
+#define HIAH_BENCH_CHUNK       (1u << 20)
+#define HIAH_BENCH_MAX_SLICES  HIAH_WORKER_POOL_MAX
+#define HIAH_BENCH_CODE_PAGE   4096u               // CS_PAGE_SIZE
+
+typedef enum {
+    HIAHBenchModePatch = 0,
+    HIAHBenchModeStage,
+    HIAHBenchModeSign,
+    HIAHBenchModeIndex
+} HIAHBenchMode;
+
+typedef struct {
+    HIAHBenchMode mode;
+    uint64_t sizeMB;
+    int slices;
+    int iterations;
+    int workers;       // Sign mode; 0 = one per CPU
+    int fixtures;      // Index mode
+    bool fat64;        // FAT_MAGIC_64 header
+    bool keep;
+    char directory[PATH_MAX - 64];
+} HIAHBenchOptions;
+
+typedef struct {
+    uint64_t offset;
+    uint64_t size;
+} HIAHBenchSlice;
+
+static uint64_t HIAHBenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int HIAHBenchCompare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void HIAHBenchReport(const char *name, uint64_t *samples, int count, uint64_t fileSize,
+                            uint64_t bytes, const char *what) {
+    qsort(samples, (size_t)count, sizeof(*samples), HIAHBenchCompare);
+    double p50 = (double)samples[count / 2] / 1e6;
+    printf("  %-10s p50 %9.3f ms  min %9.3f ms  max %9.3f ms  %10.1f MB/s  %12llu B %s/run\n",
+           name, p50, (double)samples[0] / 1e6, (double)samples[count - 1] / 1e6,
+           p50 > 0 ? (double)fileSize / 1048576.0 / (p50 / 1e3) : 0.0,
+           (unsigned long long)bytes, what);
+}
+
+// MARK: - Fixture
+
+typedef struct {
+    uint8_t *data;
+    size_t length;
+} HIAHBenchBuffer;
+
+static void HIAHBenchPut32(HIAHBenchBuffer *b, uint32_t value) {
+    memcpy(b->data + b->length, &value, 4);
+    b->length += 4;
+}
+
+static void HIAHBenchPut64(HIAHBenchBuffer *b, uint64_t value) {
+    memcpy(b->data + b->length, &value, 8);
+    b->length += 8;
+}
+
+static void HIAHBenchPutName(HIAHBenchBuffer *b, const char *name) {
+    memset(b->data + b->length, 0, 16);
+    memcpy(b->data + b->length, name, strlen(name));
+    b->length += 16;
+}
+
+static void HIAHBenchPutSegment(HIAHBenchBuffer *b, const char *name, uint64_t vmaddr, uint64_t vmsize,
+                                uint64_t fileoff, uint64_t filesize, uint32_t nsects) {
+    HIAHBenchPut32(b, HIAH_LC_SEGMENT_64);
+    HIAHBenchPut32(b, 72 + nsects * 80);
+    HIAHBenchPutName(b, name);
+    HIAHBenchPut64(b, vmaddr);
+    HIAHBenchPut64(b, vmsize);
+    HIAHBenchPut64(b, fileoff);
+    HIAHBenchPut64(b, filesize);
+    HIAHBenchPut32(b, filesize ? 5 : 0);     // maxprot
+    HIAHBenchPut32(b, filesize ? 5 : 0);     // initprot
+    HIAHBenchPut32(b, nsects);
+    HIAHBenchPut32(b, 0);
+}
+
+/**
+ * Builds the header page of one slice: __PAGEZERO, __TEXT with one section
+ * starting on the second page, a run of LC_LOAD_DYLIBs, __LINKEDIT and a
+ * code signature at the end of the slice.
+ */
+static void HIAHBenchBuildHeader(uint8_t *page, uint64_t sliceSize, uint32_t cputype) {
+    uint64_t linkedit = sliceSize - 4 * HIAH_BENCH_SIGNATURE;
+    HIAHBenchBuffer b = {page, 32};
+
+    HIAHBenchPutSegment(&b, "__PAGEZERO", 0, 0x100000000ull, 0, 0, 0);
+    HIAHBenchPutSegment(&b, "__TEXT", 0x100000000ull, linkedit, 0, linkedit, 1);
+    HIAHBenchPutName(&b, "__text");
+    HIAHBenchPutName(&b, "__TEXT");
+    HIAHBenchPut64(&b, 0x100000000ull + HIAH_BENCH_PAGE);
+    HIAHBenchPut64(&b, linkedit - HIAH_BENCH_PAGE);
+    HIAHBenchPut32(&b, (uint32_t)HIAH_BENCH_PAGE);   // offset
+    HIAHBenchPut32(&b, 2);                           // align
+    HIAHBenchPut32(&b, 0);
+    HIAHBenchPut32(&b, 0);
+    HIAHBenchPut32(&b, 0x80000400);                  // S_ATTR_PURE_INSTRUCTIONS | S_ATTR_SOME_INSTRUCTIONS
+    HIAHBenchPut32(&b, 0);
+    HIAHBenchPut32(&b, 0);
+    HIAHBenchPut32(&b, 0);
+    uint32_t ncmds = 2;
+
+    for (int i = 0; i < HIAH_BENCH_DYLIBS; i++) {
+        char name[40];
+        snprintf(name, sizeof(name), "@rpath/Framework%02d.dylib", i);
+        HIAHBenchPut32(&b, HIAH_LC_LOAD_DYLIB);
+        HIAHBenchPut32(&b, 64);
+        HIAHBenchPut32(&b, 24);                      // name offset
+        HIAHBenchPut32(&b, 2);                       // timestamp
+        HIAHBenchPut32(&b, 0x10000);                 // current version
+        HIAHBenchPut32(&b, 0x10000);                 // compatibility version
+        memset(b.data + b.length, 0, 40);
+        memcpy(b.data + b.length, name, strlen(name));
+        b.length += 40;
+        ncmds++;
+    }
+
+    HIAHBenchPutSegment(&b, "__LINKEDIT", 0x100000000ull + linkedit, sliceSize - linkedit,
+                        linkedit, sliceSize - linkedit, 0);
+    HIAHBenchPut32(&b, HIAH_LC_CODE_SIGNATURE);
+    HIAHBenchPut32(&b, 16);
+    HIAHBenchPut32(&b, (uint32_t)(sliceSize - HIAH_BENCH_SIGNATURE));
+    HIAHBenchPut32(&b, (uint32_t)HIAH_BENCH_SIGNATURE);
+    ncmds += 2;
+
+    uint32_t header[8] = {
+        HIAH_MACHO_MAGIC_64, cputype, 0, HIAH_MACHO_FILETYPE_EXECUTE,
+        ncmds, (uint32_t)(b.length - 32), 0x00200085, 0,
+    };
+    memcpy(page, header, sizeof(header));
+}
+
+static bool HIAHBenchWriteAll(int fd, const uint8_t *data, size_t length, uint64_t offset) {
+    while (length > 0) {
+        ssize_t written = pwrite(fd, data, length, (off_t)offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        length -= (size_t)written;
+        offset += (uint64_t)written;
+    }
+    return true;
+}
+
+/**
+ * Writes the fixture and returns its slices.
+ */
+static HIAHBenchSlice *HIAHBenchWriteFixture(const char *path, const HIAHBenchOptions *options,
+                                             uint64_t *fileSize) {
+    static const uint32_t cputypes[] = {0x0100000c, 0x01000007};
+    int count = options->slices;
+    bool fat = count > 1;
+    uint64_t sliceSize = (options->sizeMB << 20) / (uint64_t)count;
+    sliceSize &= ~(HIAH_BENCH_PAGE - 1);
+    if (sliceSize < 8 * HIAH_BENCH_SIGNATURE) {
+        sliceSize = 8 * HIAH_BENCH_SIGNATURE;
+    }
+
+    HIAHBenchSlice *slices = calloc((size_t)count, sizeof(*slices));
+    uint8_t *chunk = malloc(HIAH_BENCH_CHUNK);
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (!slices || !chunk || fd < 0) {
+        free(slices);
+        free(chunk);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    uint64_t offset = fat ? HIAH_BENCH_PAGE : 0;
+    uint8_t fatHeader[HIAH_BENCH_PAGE];
+    memset(fatHeader, 0, sizeof(fatHeader));
+    uint32_t *words = (uint32_t *)fatHeader;
+    words[0] = __builtin_bswap32(options->fat64 ? HIAH_FAT_MAGIC_64 : HIAH_FAT_MAGIC);
+    words[1] = __builtin_bswap32((uint32_t)count);
+
+    uint64_t state = 0x9e3779b97f4a7c15ull;
+    bool ok = true;
+    for (int i = 0; i < count && ok; i++) {
+        slices[i].offset = offset;
+        slices[i].size = sliceSize;
+        // Subtypes keep the architectures distinct, as lipo requires
+        uint32_t cputype = cputypes[i % 2];
+        if (options->fat64) {
+            uint32_t *arch = words + 2 + i * 8;
+            arch[0] = __builtin_bswap32(cputype);
+            arch[1] = __builtin_bswap32((uint32_t)i / 2);
+            arch[2] = __builtin_bswap32((uint32_t)(offset >> 32));
+            arch[3] = __builtin_bswap32((uint32_t)offset);
+            arch[4] = __builtin_bswap32((uint32_t)(sliceSize >> 32));
+            arch[5] = __builtin_bswap32((uint32_t)sliceSize);
+            arch[6] = __builtin_bswap32(14);
+            arch[7] = 0;
+        } else {
+            uint32_t *arch = words + 2 + i * 5;
+            arch[0] = __builtin_bswap32(cputype);
+            arch[1] = __builtin_bswap32((uint32_t)i / 2);
+            arch[2] = __builtin_bswap32((uint32_t)offset);
+            arch[3] = __builtin_bswap32((uint32_t)sliceSize);
+            arch[4] = __builtin_bswap32(14);
+        }
+
+        // Incompressible contents, so nothing below the file system shortcuts
+        for (uint64_t written = 0; written < sliceSize && ok; written += HIAH_BENCH_CHUNK) {
+            uint64_t *fill = (uint64_t *)chunk;
+            for (size_t w = 0; w < HIAH_BENCH_CHUNK / 8; w++) {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+                fill[w] = state;
+            }
+            if (written == 0) {
+                memset(chunk, 0, HIAH_BENCH_PAGE);
+                HIAHBenchBuildHeader(chunk, sliceSize, cputype);
+            }
+            size_t length = sliceSize - written < HIAH_BENCH_CHUNK ? (size_t)(sliceSize - written)
+                                                                   : HIAH_BENCH_CHUNK;
+            ok = HIAHBenchWriteAll(fd, chunk, length, offset + written);
+        }
+        offset += sliceSize;
+    }
+    if (ok && fat) {
+        ok = HIAHBenchWriteAll(fd, fatHeader, sizeof(fatHeader), 0);
+    }
+    close(fd);
+    free(chunk);
+    if (!ok) {
+        free(slices);
+        return NULL;
+    }
+    *fileSize = offset;
+    return slices;
+}
+
+// MARK: - Runs
+
+static const HIAHMachOEdit HIAHBenchEdits[] = {
+    {
+        .kind = HIAHMachOEditSetFileType,
+        .fromTypes = HIAH_MACHO_FILETYPE_BIT(HIAH_MACHO_FILETYPE_EXECUTE),
+        .fileType = HIAH_MACHO_FILETYPE_BUNDLE,
+    },
+    {.kind = HIAHMachOEditRelocatePageZero, .address = 0xFFFFC000ull, .size = 0x4000ull},
+    {.kind = HIAHMachOEditRemoveSignature},
+};
+#define HIAH_BENCH_EDIT_COUNT (sizeof(HIAHBenchEdits) / sizeof(HIAHBenchEdits[0]))
+
+static bool HIAHBenchReadFile(const char *path, uint8_t **data, size_t *length) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return false;
+    }
+    *length = (size_t)st.st_size;
+    *data = malloc(*length);
+    size_t done = 0;
+    while (*data && done < *length) {
+        ssize_t n = read(fd, *data + done, *length - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+    if (!*data || done != *length) {
+        free(*data);
+        *data = NULL;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * One edit per pass, each reading the whole file and replacing it.
+ */
+static bool HIAHBenchRunLegacy(const char *path, uint64_t *bytesWritten) {
+    char temporary[PATH_MAX + 8];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    *bytesWritten = 0;
+    for (size_t e = 0; e < HIAH_BENCH_EDIT_COUNT; e++) {
+        uint8_t *data = NULL;
+        size_t length = 0;
+        char error[256];
+        if (!HIAHBenchReadFile(path, &data, &length) ||
+            !HIAHMachOTransformBuffer(data, &length, &HIAHBenchEdits[e], 1, NULL, error, sizeof(error))) {
+            free(data);
+            return false;
+        }
+        int fd = open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool ok = fd >= 0 && HIAHBenchWriteAll(fd, data, length, 0);
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(data);
+        if (!ok || rename(temporary, path) != 0) {
+            return false;
+        }
+        *bytesWritten += length;
+    }
+    return true;
+}
+
+static bool HIAHBenchRunTransform(const char *path, uint64_t *bytesWritten) {
+    HIAHMachOTransformStats stats;
+    char error[256];
+    if (!HIAHMachOTransformFile(path, HIAHBenchEdits, HIAH_BENCH_EDIT_COUNT, &stats, error, sizeof(error))) {
+        fprintf(stderr, "[HIAHMachOBench] transform failed: %s\n", error);
+        return false;
+    }
+    *bytesWritten = stats.bytesWritten;
+    return stats.slicesChanged == stats.slices;
+}
+
+static bool HIAHBenchRestore(const char *pristine, const char *path) {
+    char error[256];
+    unlink(path);
+    if (!HIAHFileCloneFile(pristine, path, 0, NULL, error, sizeof(error))) {
+        fprintf(stderr, "[HIAHMachOBench] cannot restore %s: %s\n", path, error);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Checks a prepared fixture against the original: each slice lost exactly
+ * its signature, __LINKEDIT ends with the slice, the slices sit back to
+ * back at 16 KB alignment and everything past the header page is unchanged.
+ */
+static bool HIAHBenchCheckTrimmed(const char *path, const char *pristine,
+                                  const HIAHBenchSlice *slices, int count) {
+    uint8_t *data = NULL, *original = NULL;
+    size_t length = 0, originalLength = 0;
+    HIAHMachOSliceRange *ranges = NULL;
+    HIAHMachOImageInfo *info = NULL;
+    uint32_t found = 0;
+    char error[256] = "layout differs";
+    bool ok = HIAHBenchReadFile(path, &data, &length) &&
+              HIAHBenchReadFile(pristine, &original, &originalLength) &&
+              HIAHMachOListSlices(data, length, &ranges, &found, error, sizeof(error)) &&
+              (info = HIAHMachOImageInfoRead(path, error, sizeof(error))) != NULL &&
+              found == (uint32_t)count && info->sliceCount == (uint32_t)count;
+
+    uint64_t end = count > 1 ? HIAH_BENCH_PAGE : 0;
+    for (int i = 0; i < count && ok; i++) {
+        const HIAHMachOSliceInfo *slice = &info->slices[i];
+        const HIAHMachOSegmentInfo *segments = HIAHMachOSliceInfoSegments(info, slice);
+        const HIAHMachOSegmentInfo *linkedit = &segments[slice->segmentCount - 1];
+        uint64_t size = slices[i].size - HIAH_BENCH_SIGNATURE;
+        ok = ranges[i].offset == end && ranges[i].size == size &&
+             slice->codeSignatureSize == 0 && slice->filetype == HIAH_MACHO_FILETYPE_BUNDLE &&
+             slice->segmentCount > 0 && strncmp(linkedit->name, "__LINKEDIT", 16) == 0 &&
+             linkedit->fileoff + linkedit->filesize == size && linkedit->vmsize == linkedit->filesize &&
+             memcmp(data + end + HIAH_BENCH_PAGE, original + slices[i].offset + HIAH_BENCH_PAGE,
+                    (size_t)(size - HIAH_BENCH_PAGE)) == 0;
+        end += size;
+    }
+    ok = ok && length == end;
+    if (!ok) {
+        fprintf(stderr, "[HIAHMachOBench] prepared binary is wrong: %s\n", error);
+    }
+    HIAHMachOImageInfoFree(info);
+    free(ranges);
+    free(original);
+    free(data);
+    return ok;
+}
+
+static uint64_t HIAHBenchDigest(const char *path) {
+    uint8_t *data = NULL;
+    size_t length = 0;
+    if (!HIAHBenchReadFile(path, &data, &length)) {
+        return 0;
+    }
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3ull;
+    }
+    free(data);
+    return hash;
+}
+
+// MARK: - Staging
+
+#if defined(__linux__)
+/**
+ * Bytes of `path` in extents it still shares with another file, or 0 if
+ * the file system does not say.
+ */
+static uint64_t HIAHBenchSharedBytes(const char *path) {
+    enum { HIAHBenchExtents = 256 };
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 0;
+    }
+    struct fiemap *map = calloc(1, sizeof(*map) + HIAHBenchExtents * sizeof(struct fiemap_extent));
+    uint64_t shared = 0, start = 0;
+    while (map) {
+        memset(map, 0, sizeof(*map));
+        map->fm_start = start;
+        map->fm_length = ~0ull - start;
+        map->fm_flags = FIEMAP_FLAG_SYNC;
+        map->fm_extent_count = HIAHBenchExtents;
+        if (ioctl(fd, FS_IOC_FIEMAP, map) != 0 || map->fm_mapped_extents == 0) {
+            break;
+        }
+        const struct fiemap_extent *last = &map->fm_extents[map->fm_mapped_extents - 1];
+        for (uint32_t i = 0; i < map->fm_mapped_extents; i++) {
+            if (map->fm_extents[i].fe_flags & FIEMAP_EXTENT_SHARED) {
+                shared += map->fm_extents[i].fe_length;
+            }
+        }
+        if (last->fe_flags & FIEMAP_EXTENT_LAST) {
+            break;
+        }
+        start = last->fe_logical + last->fe_length;
+    }
+    free(map);
+    close(fd);
+    return shared;
+}
+#else
+static uint64_t HIAHBenchSharedBytes(const char *path) {
+    (void)path;
+    return 0;
+}
+#endif
+
+/**
+ * Stages a copy of `source` and prepares it, as a launch does.
+ */
+static bool HIAHBenchRunStage(const char *source, const char *staged, unsigned flags,
+                              HIAHFileCloneStats *clone, uint64_t *bytesWritten) {
+    char error[256];
+    if (!HIAHFileCloneFile(source, staged, flags, clone, error, sizeof(error))) {
+        fprintf(stderr, "[HIAHMachOBench] staging failed: %s\n", error);
+        return false;
+    }
+    uint64_t patched = 0;
+    if (!HIAHBenchRunTransform(staged, &patched)) {
+        return false;
+    }
+    *bytesWritten = clone->bytesCopied + patched;
+    return true;
+}
+
+static const char *HIAHBenchCloneMethod(const HIAHFileCloneStats *stats) {
+    for (int m = 0; m < HIAHFileCloneMethodCount; m++) {
+        if (stats->methods[m]) {
+            return HIAHFileCloneMethodName((HIAHFileCloneMethod)m);
+        }
+    }
+    return "none";
+}
+
+// MARK: - Signing
+
+static const uint32_t HIAHBenchSHA256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define HIAH_BENCH_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void HIAHBenchSHA256Block(uint32_t state[8], const uint8_t *block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16) |
+               ((uint32_t)block[4 * i + 2] << 8) | block[4 * i + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = HIAH_BENCH_ROR(w[i - 15], 7) ^ HIAH_BENCH_ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = HIAH_BENCH_ROR(w[i - 2], 17) ^ HIAH_BENCH_ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (HIAH_BENCH_ROR(e, 6) ^ HIAH_BENCH_ROR(e, 11) ^ HIAH_BENCH_ROR(e, 25)) +
+                      ((e & f) ^ (~e & g)) + HIAHBenchSHA256K[i] + w[i];
+        uint32_t t2 = (HIAH_BENCH_ROR(a, 2) ^ HIAH_BENCH_ROR(a, 13) ^ HIAH_BENCH_ROR(a, 22)) +
+                      ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+static void HIAHBenchSHA256(const uint8_t *data, size_t length, uint8_t digest[32]) {
+    uint32_t state[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    size_t full = length & ~(size_t)63;
+    for (size_t i = 0; i < full; i += 64) {
+        HIAHBenchSHA256Block(state, data + i);
+    }
+    uint8_t tail[128] = {0};
+    size_t rest = length - full;
+    memcpy(tail, data + full, rest);
+    tail[rest] = 0x80;
+    size_t tailLength = rest < 56 ? 64 : 128;
+    uint64_t bits = (uint64_t)length * 8;
+    for (int i = 0; i < 8; i++) {
+        tail[tailLength - 1 - i] = (uint8_t)(bits >> (8 * i));
+    }
+    for (size_t i = 0; i < tailLength; i += 64) {
+        HIAHBenchSHA256Block(state, tail + i);
+    }
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i] = (uint8_t)(state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t)(state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t)(state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t)state[i];
+    }
+}
+
+typedef struct {
+    const uint8_t *bytes;
+    const HIAHMachOSliceRange *ranges;
+    uint8_t (*directories)[32];    // Per slice: hash of its code page hashes
+    uint8_t *pageHashes;           // Scratch, one region per slice
+    size_t pageHashStride;
+} HIAHBenchSignJob;
+
+/**
+ * What zsign does per slice before building the CMS blob: hash each code
+ * page up to LC_CODE_SIGNATURE's dataoff and hash the resulting slots.
+ */
+static void HIAHBenchSignSlice(size_t index, void *context) {
+    HIAHBenchSignJob *job = context;
+    const uint8_t *slice = job->bytes + job->ranges[index].offset;
+    uint64_t codeLimit = job->ranges[index].size;
+    uint32_t ncmds, cmd[4];
+    memcpy(&ncmds, slice + 16, sizeof(ncmds));
+    const uint8_t *command = slice + 32;
+    for (uint32_t i = 0; i < ncmds; i++) {
+        memcpy(cmd, command, sizeof(cmd));
+        if (cmd[0] == HIAH_LC_CODE_SIGNATURE) {
+            codeLimit = cmd[2];
+        }
+        command += cmd[1];
+    }
+
+    uint8_t *slots = job->pageHashes + index * job->pageHashStride;
+    size_t pages = 0;
+    for (uint64_t offset = 0; offset < codeLimit; offset += HIAH_BENCH_CODE_PAGE, pages++) {
+        uint64_t length = codeLimit - offset < HIAH_BENCH_CODE_PAGE ? codeLimit - offset
+                                                                     : HIAH_BENCH_CODE_PAGE;
+        HIAHBenchSHA256(slice + offset, (size_t)length, slots + pages * 32);
+    }
+    HIAHBenchSHA256(slots, pages * 32, job->directories[index]);
+}
+
+static int HIAHBenchSign(const HIAHBenchOptions *options, const char *path, uint64_t fileSize) {
+    uint8_t *bytes = NULL;
+    size_t length = 0;
+    HIAHMachOSliceRange *ranges = NULL;
+    uint32_t count = 0;
+    char error[256];
+    if (!HIAHBenchReadFile(path, &bytes, &length) ||
+        !HIAHMachOListSlices(bytes, length, &ranges, &count, error, sizeof(error))) {
+        fprintf(stderr, "[HIAHMachOBench] cannot read slices of %s\n", path);
+        free(bytes);
+        return 1;
+    }
+
+    unsigned workers = options->workers ? (unsigned)options->workers : HIAHWorkerPoolDefaultWorkers();
+    printf("[HIAHMachOBench] sign: %.1f MB, %u slice%s (%s), %d runs, pool of %u\n",
+           (double)fileSize / 1048576.0, count, count == 1 ? "" : "s",
+           count == 1 ? "thin" : (options->fat64 ? "FAT_MAGIC_64" : "FAT_MAGIC"),
+           options->iterations, workers);
+
+    size_t stride = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        size_t slots = (size_t)((ranges[i].size + HIAH_BENCH_CODE_PAGE - 1) / HIAH_BENCH_CODE_PAGE) * 32;
+        stride = slots > stride ? slots : stride;
+    }
+    uint8_t (*serialDirectories)[32] = calloc(count, 32);
+    uint8_t (*poolDirectories)[32] = calloc(count, 32);
+    uint8_t *pageHashes = malloc(stride * count);
+    uint64_t *serial = calloc((size_t)options->iterations, sizeof(uint64_t));
+    uint64_t *pool = calloc((size_t)options->iterations, sizeof(uint64_t));
+    int status = 0;
+    if (!serialDirectories || !poolDirectories || !pageHashes || !serial || !pool) {
+        fprintf(stderr, "[HIAHMachOBench] out of memory\n");
+        status = 1;
+    }
+
+    HIAHBenchSignJob job = {bytes, ranges, serialDirectories, pageHashes, stride};
+    for (int i = 0; i < options->iterations && status == 0; i++) {
+        job.directories = serialDirectories;
+        uint64_t start = HIAHBenchNow();
+        HIAHWorkerPoolRun(count, 1, HIAHBenchSignSlice, &job);
+        serial[i] = HIAHBenchNow() - start;
+
+        job.directories = poolDirectories;
+        start = HIAHBenchNow();
+        HIAHWorkerPoolRun(count, workers, HIAHBenchSignSlice, &job);
+        pool[i] = HIAHBenchNow() - start;
+
+        if (memcmp(serialDirectories, poolDirectories, (size_t)count * 32) != 0) {
+            fprintf(stderr, "[HIAHMachOBench] pool produced different CodeDirectories\n");
+            status = 1;
+        }
+    }
+
+    if (status == 0) {
+        HIAHBenchReport("serial", serial, options->iterations, fileSize, fileSize, "hashed");
+        HIAHBenchReport("pool", pool, options->iterations, fileSize, fileSize, "hashed");
+        printf("  CodeDirectories identical and in slice order, pool %.2fx faster at p50\n",
+               (double)serial[options->iterations / 2] / (double)pool[options->iterations / 2]);
+    }
+
+    free(serialDirectories);
+    free(poolDirectories);
+    free(pageHashes);
+    free(serial);
+    free(pool);
+    free(ranges);
+    free(bytes);
+    return status;
+}
+
+// MARK: - Index
+
+#define HIAH_BENCH_INDEX_SLICE (8 * HIAH_BENCH_SIGNATURE)    // Smallest slice the header lays out
+
+/**
+ * Writes a sparse binary: the header page of each slice and a signature
+ * whose entitlements differ per fixture, nothing in between.
+ */
+static bool HIAHBenchWriteSmallFixture(const char *path, int number, bool fat) {
+    static const uint32_t cputypes[] = {0x0100000c, 0x01000007};
+    int count = fat ? 2 : 1;
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+
+    uint8_t page[HIAH_BENCH_PAGE];
+    uint8_t fatHeader[HIAH_BENCH_PAGE];
+    memset(fatHeader, 0, sizeof(fatHeader));
+    HIAHWriteBig32(fatHeader, HIAH_FAT_MAGIC);
+    HIAHWriteBig32(fatHeader + 4, (uint32_t)count);
+
+    uint64_t offset = fat ? HIAH_BENCH_PAGE : 0;
+    bool ok = true;
+    for (int i = 0; i < count && ok; i++) {
+        uint8_t *arch = fatHeader + 8 + i * 20;
+        HIAHWriteBig32(arch, cputypes[i]);
+        HIAHWriteBig32(arch + 8, (uint32_t)offset);
+        HIAHWriteBig32(arch + 12, (uint32_t)HIAH_BENCH_INDEX_SLICE);
+        HIAHWriteBig32(arch + 16, 14);
+
+        memset(page, 0, sizeof(page));
+        HIAHBenchBuildHeader(page, HIAH_BENCH_INDEX_SLICE, cputypes[i]);
+        ok = HIAHBenchWriteAll(fd, page, sizeof(page), offset);
+
+        // SuperBlob with a single slot, the entitlements
+        char plist[160];
+        int length = snprintf(plist, sizeof(plist),
+                              "<plist><dict><key>application-identifier</key>"
+                              "<string>TEAM.com.example.app%05d</string></dict></plist>", number);
+        memset(page, 0, sizeof(page));
+        HIAHWriteBig32(page, 0xfade0cc0);
+        HIAHWriteBig32(page + 4, 28 + (uint32_t)length);
+        HIAHWriteBig32(page + 8, 1);
+        HIAHWriteBig32(page + 12, 5);            // CSSLOT_ENTITLEMENTS
+        HIAHWriteBig32(page + 16, 20);
+        HIAHWriteBig32(page + 20, 0xfade7171);
+        HIAHWriteBig32(page + 24, 8 + (uint32_t)length);
+        memcpy(page + 28, plist, (size_t)length);
+        ok = ok && HIAHBenchWriteAll(fd, page, 28 + (size_t)length,
+                                     offset + HIAH_BENCH_INDEX_SLICE - HIAH_BENCH_SIGNATURE);
+        offset += HIAH_BENCH_INDEX_SLICE;
+    }
+    if (ok && fat) {
+        ok = HIAHBenchWriteAll(fd, fatHeader, sizeof(fatHeader), 0);
+    }
+    ok = ok && ftruncate(fd, (off_t)offset) == 0;
+    close(fd);
+    return ok;
+}
+
+static void HIAHBenchReportQueries(const char *name, uint64_t *samples, int count, int queries) {
+    qsort(samples, (size_t)count, sizeof(*samples), HIAHBenchCompare);
+    printf("  %-10s p50 %9.2f us  min %9.2f us  max %9.2f us  per query\n", name,
+           (double)samples[count / 2] / queries / 1e3, (double)samples[0] / queries / 1e3,
+           (double)samples[count - 1] / queries / 1e3);
+}
+
+/**
+ * Answers "what filetype is this binary" for every fixture, as the
+ * Desktop app list and the launch path do.
+ */
+static bool HIAHBenchQueryAll(HIAHMachOIndex *index, char (*paths)[PATH_MAX], int count,
+                              uint64_t *executables) {
+    char error[256];
+    *executables = 0;
+    for (int i = 0; i < count; i++) {
+        HIAHMachOImageInfo *info = index ? HIAHMachOIndexLookup(index, paths[i], error, sizeof(error))
+                                         : HIAHMachOImageInfoRead(paths[i], error, sizeof(error));
+        if (!info) {
+            fprintf(stderr, "[HIAHMachOBench] %s\n", error);
+            return false;
+        }
+        const HIAHMachOSliceInfo *slice = HIAHMachOImageInfoPrimarySlice(info);
+        *executables += slice && slice->filetype == HIAH_MACHO_FILETYPE_EXECUTE;
+        HIAHMachOImageInfoFree(info);
+    }
+    return true;
+}
+
+static int HIAHBenchIndex(const HIAHBenchOptions *options) {
+    char directory[PATH_MAX - 32];
+    snprintf(directory, sizeof(directory), "%s/hiah-macho-bench.%d.d", options->directory, (int)getpid());
+    int count = options->fixtures;
+    char (*paths)[PATH_MAX] = calloc((size_t)count, PATH_MAX);
+    uint64_t *read = calloc((size_t)options->iterations, sizeof(uint64_t));
+    uint64_t *lookup = calloc((size_t)options->iterations, sizeof(uint64_t));
+    char indexPath[PATH_MAX];
+    snprintf(indexPath, sizeof(indexPath), "%s/MachOIndex", directory);
+    if (!paths || !read || !lookup || mkdir(directory, 0755) != 0) {
+        fprintf(stderr, "[HIAHMachOBench] cannot create %s: %s\n", directory, strerror(errno));
+        free(paths);
+        free(read);
+        free(lookup);
+        return 1;
+    }
+
+    printf("[HIAHMachOBench] index: %d binaries (every 4th fat), %d runs per method\n", count,
+           options->iterations);
+
+    bool ok = true;
+    uint64_t start = HIAHBenchNow();
+    for (int i = 0; i < count && ok; i++) {
+        snprintf(paths[i], PATH_MAX, "%s/App%05d", directory, i);
+        ok = HIAHBenchWriteSmallFixture(paths[i], i, i % 4 == 3);
+    }
+    uint64_t writeTime = HIAHBenchNow() - start;
+
+    // Install time: every binary is scanned once, then the index is saved
+    uint64_t executables = 0, buildTime = 0, saveTime = 0, loadTime = 0;
+    char error[256] = "";
+    HIAHMachOIndex *index = ok ? HIAHMachOIndexCreate(indexPath) : NULL;
+    if (index) {
+        start = HIAHBenchNow();
+        ok = HIAHBenchQueryAll(index, paths, count, &executables);
+        buildTime = HIAHBenchNow() - start;
+        start = HIAHBenchNow();
+        ok = ok && HIAHMachOIndexSave(index, error, sizeof(error));
+        saveTime = HIAHBenchNow() - start;
+        HIAHMachOIndexDestroy(index);
+
+        start = HIAHBenchNow();
+        index = HIAHMachOIndexCreate(indexPath);
+        loadTime = HIAHBenchNow() - start;
+    }
+    struct stat indexStat = {0};
+    HIAHMachOIndexStats stats = {0};
+    ok = ok && index && stat(indexPath, &indexStat) == 0;
+    if (ok) {
+        HIAHMachOIndexGetStats(index, &stats);
+        ok = stats.records == (size_t)count && executables == (uint64_t)count;
+    }
+
+    // Alternate the methods so both see the same page cache state
+    for (int i = 0; i < options->iterations && ok; i++) {
+        start = HIAHBenchNow();
+        ok = HIAHBenchQueryAll(NULL, paths, count, &executables);
+        read[i] = HIAHBenchNow() - start;
+
+        start = HIAHBenchNow();
+        ok = ok && HIAHBenchQueryAll(index, paths, count, &executables);
+        lookup[i] = HIAHBenchNow() - start;
+    }
+
+    // Every record must match a fresh read, and a changed binary must be
+    // rescanned rather than served from its old record
+    for (int i = 0; i < count && ok; i++) {
+        HIAHMachOImageInfo *fresh = HIAHMachOImageInfoRead(paths[i], error, sizeof(error));
+        HIAHMachOImageInfo *indexed = HIAHMachOIndexLookup(index, paths[i], error, sizeof(error));
+        ok = fresh && indexed && fresh->length == indexed->length &&
+             memcmp(fresh, indexed, fresh->length) == 0;
+        HIAHMachOImageInfoFree(fresh);
+        HIAHMachOImageInfoFree(indexed);
+    }
+    bool rescanned = false;
+    if (ok) {
+        HIAHMachOIndexGetStats(index, &stats);
+        HIAHMachOEdit edit = {
+            .kind = HIAHMachOEditSetFileType,
+            .fromTypes = HIAH_MACHO_FILETYPE_BIT(HIAH_MACHO_FILETYPE_EXECUTE),
+            .fileType = HIAH_MACHO_FILETYPE_BUNDLE,
+        };
+        HIAHMachOImageInfo *info = NULL;
+        HIAHMachOIndexStats after;
+        ok = HIAHMachOTransformFile(paths[0], &edit, 1, NULL, error, sizeof(error)) &&
+             (info = HIAHMachOIndexLookup(index, paths[0], error, sizeof(error)));
+        if (ok) {
+            HIAHMachOIndexGetStats(index, &after);
+            const HIAHMachOSliceInfo *slice = HIAHMachOImageInfoPrimarySlice(info);
+            rescanned = slice && slice->filetype == HIAH_MACHO_FILETYPE_BUNDLE && after.stale == stats.stale + 1;
+        }
+        HIAHMachOImageInfoFree(info);
+    }
+
+    int status = 0;
+    if (!ok) {
+        fprintf(stderr, "[HIAHMachOBench] run failed: %s\n", error[0] ? error : strerror(errno));
+        status = 1;
+    } else if (stats.scans != 0 || !rescanned) {
+        fprintf(stderr, "[HIAHMachOBench] index served stale or missing records\n");
+        status = 1;
+    } else {
+        printf("  write      %d binaries in %.1f ms\n", count, (double)writeTime / 1e6);
+        printf("  build      %9.2f us per binary, save %.2f ms, %lld B on disk (%.0f B per binary)\n",
+               (double)buildTime / count / 1e3, (double)saveTime / 1e6, (long long)indexStat.st_size,
+               (double)indexStat.st_size / count);
+        printf("  reopen     %9.2f ms for %zu records\n", (double)loadTime / 1e6, stats.records);
+        HIAHBenchReportQueries("read", read, options->iterations, count);
+        HIAHBenchReportQueries("index", lookup, options->iterations, count);
+        printf("  records identical to fresh reads, changed binary rescanned, index %.1fx faster at p50\n",
+               (double)read[options->iterations / 2] / (double)lookup[options->iterations / 2]);
+    }
+
+    HIAHMachOIndexDestroy(index);
+    if (!options->keep) {
+        for (int i = 0; i < count; i++) {
+            unlink(paths[i]);
+        }
+        unlink(indexPath);
+        rmdir(directory);
+    }
+    free(paths);
+    free(read);
+    free(lookup);
+    return status;
+}
+
+// MARK: - Main
+
+static void HIAHBenchUsage(const char *program) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -m MODE  patch (default): old per-step patching against one pass\n"
+            "           stage: copy + patch against clone + patch\n"
+            "           sign: per-slice code page hashing, serial against the worker pool\n"
+            "           index: metadata queries, reading binaries against HIAHMachOIndex\n"
+            "  -S MB    binary size (default 100)\n"
+            "  -s N     slices; more than one writes a fat binary (default 1, at most 8)\n"
+            "  -6       write a FAT_MAGIC_64 header\n"
+            "  -j N     workers for -m sign (default one per CPU)\n"
+            "  -c N     binaries for -m index (default 2000)\n"
+            "  -n N     runs per method (default 10)\n"
+            "  -d DIR   directory for the fixtures (default /tmp)\n"
+            "  -k       keep the fixtures\n",
+            program);
+}
+
+static int HIAHBenchParseCount(const char *value, int minimum, int maximum) {
+    char *end;
+    long parsed = strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || parsed < minimum || parsed > maximum) {
+        return -1;
+    }
+    return (int)parsed;
+}
+
+static int HIAHBenchPatch(const HIAHBenchOptions *options, const char *path,
+                          const HIAHBenchSlice *slices, uint64_t fileSize) {
+    // What every run starts from
+    char pristine[PATH_MAX + 8];
+    char error[256];
+    snprintf(pristine, sizeof(pristine), "%s.orig", path);
+    unlink(pristine);
+    bool ok = HIAHFileCloneFile(path, pristine, 0, NULL, error, sizeof(error));
+    if (!ok) {
+        fprintf(stderr, "[HIAHMachOBench] cannot copy %s: %s\n", path, error);
+    }
+
+    printf("[HIAHMachOBench] patch: %.1f MB, %d slice%s, %d runs per method\n",
+           (double)fileSize / 1048576.0, options->slices, options->slices == 1 ? "" : "s",
+           options->iterations);
+
+    uint64_t *legacy = calloc((size_t)options->iterations, sizeof(uint64_t));
+    uint64_t *transform = calloc((size_t)options->iterations, sizeof(uint64_t));
+    uint64_t legacyWritten = 0, transformWritten = 0, legacyDigest = 0, transformDigest = 0;
+    bool trimmed = false;
+    ok = ok && legacy && transform;
+
+    // Alternate the methods so both see the same page cache state
+    for (int i = 0; i < options->iterations && ok; i++) {
+        ok = HIAHBenchRestore(pristine, path);
+        uint64_t start = HIAHBenchNow();
+        ok = ok && HIAHBenchRunLegacy(path, &legacyWritten);
+        legacy[i] = HIAHBenchNow() - start;
+        if (ok && i == 0) {
+            legacyDigest = HIAHBenchDigest(path);
+        }
+
+        ok = ok && HIAHBenchRestore(pristine, path);
+        start = HIAHBenchNow();
+        ok = ok && HIAHBenchRunTransform(path, &transformWritten);
+        transform[i] = HIAHBenchNow() - start;
+        if (ok && i == 0) {
+            transformDigest = HIAHBenchDigest(path);
+            trimmed = HIAHBenchCheckTrimmed(path, pristine, slices, options->slices);
+        }
+    }
+    unlink(pristine);
+
+    int status = 0;
+    if (!ok) {
+        fprintf(stderr, "[HIAHMachOBench] run failed: %s\n", strerror(errno));
+        status = 1;
+    } else if (legacyDigest != transformDigest) {
+        fprintf(stderr, "[HIAHMachOBench] methods produced different files\n");
+        status = 1;
+    } else if (!trimmed) {
+        status = 1;
+    } else {
+        HIAHBenchReport("legacy", legacy, options->iterations, fileSize, legacyWritten, "written");
+        HIAHBenchReport("transform", transform, options->iterations, fileSize, transformWritten, "written");
+        printf("  outputs identical and %.1f MB smaller, signatures cut off every slice, "
+               "transform %.0fx faster at p50\n",
+               (double)(options->slices * HIAH_BENCH_SIGNATURE) / 1048576.0,
+               (double)legacy[options->iterations / 2] / (double)transform[options->iterations / 2]);
+    }
+
+    free(legacy);
+    free(transform);
+    return status;
+}
+
+static int HIAHBenchStage(const HIAHBenchOptions *options, const char *path, uint64_t fileSize) {
+    char staged[PATH_MAX + 8];
+    snprintf(staged, sizeof(staged), "%s.staged", path);
+
+    printf("[HIAHMachOBench] stage: %.1f MB, %d slice%s, %d runs per method\n",
+           (double)fileSize / 1048576.0, options->slices, options->slices == 1 ? "" : "s",
+           options->iterations);
+
+    uint64_t *copy = calloc((size_t)options->iterations, sizeof(uint64_t));
+    uint64_t *clone = calloc((size_t)options->iterations, sizeof(uint64_t));
+    uint64_t copyWritten = 0, cloneWritten = 0, copyDigest = 0, cloneDigest = 0, shared = 0;
+    HIAHFileCloneStats copyStats = {0}, cloneStats = {0};
+    bool ok = copy && clone;
+
+    for (int i = 0; i < options->iterations && ok; i++) {
+        unlink(staged);
+        uint64_t start = HIAHBenchNow();
+        ok = HIAHBenchRunStage(path, staged, HIAH_FILE_CLONE_NO_CLONE | HIAH_FILE_CLONE_NO_RANGE,
+                               &copyStats, &copyWritten);
+        copy[i] = HIAHBenchNow() - start;
+        if (ok && i == 0) {
+            copyDigest = HIAHBenchDigest(staged);
+        }
+
+        unlink(staged);
+        start = HIAHBenchNow();
+        ok = ok && HIAHBenchRunStage(path, staged, 0, &cloneStats, &cloneWritten);
+        clone[i] = HIAHBenchNow() - start;
+        if (ok && i == 0) {
+            cloneDigest = HIAHBenchDigest(staged);
+            shared = HIAHBenchSharedBytes(staged);
+        }
+    }
+    unlink(staged);
+
+    int status = 0;
+    if (!ok) {
+        fprintf(stderr, "[HIAHMachOBench] run failed: %s\n", strerror(errno));
+        status = 1;
+    } else if (copyDigest != cloneDigest) {
+        fprintf(stderr, "[HIAHMachOBench] methods produced different files\n");
+        status = 1;
+    } else {
+        HIAHBenchReport("copy", copy, options->iterations, fileSize, copyWritten, "written");
+        HIAHBenchReport("clone", clone, options->iterations, fileSize, cloneWritten, "written");
+        printf("  outputs identical, clone staged by %s, %.1f of %.1f MB still shared after "
+               "patching, %.1fx faster at p50\n",
+               HIAHBenchCloneMethod(&cloneStats), (double)shared / 1048576.0,
+               (double)fileSize / 1048576.0,
+               (double)copy[options->iterations / 2] / (double)clone[options->iterations / 2]);
+    }
+
+    free(copy);
+    free(clone);
+    return status;
+}
+
+int main(int argc, char **argv) {
+    HIAHBenchOptions options = {.sizeMB = 100, .slices = 1, .iterations = 10, .fixtures = 2000};
+    snprintf(options.directory, sizeof(options.directory), "/tmp");
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:S:s:n:j:c:6d:kh")) != -1) {
+        int value;
+        switch (opt) {
+        case 'm':
+            if (strcmp(optarg, "patch") == 0) {
+                options.mode = HIAHBenchModePatch;
+            } else if (strcmp(optarg, "stage") == 0) {
+                options.mode = HIAHBenchModeStage;
+            } else if (strcmp(optarg, "sign") == 0) {
+                options.mode = HIAHBenchModeSign;
+            } else if (strcmp(optarg, "index") == 0) {
+                options.mode = HIAHBenchModeIndex;
+            } else {
+                fprintf(stderr, "[HIAHMachOBench] unknown mode: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'S':
+            if ((value = HIAHBenchParseCount(optarg, 4, 1 << 16)) < 0) {
+                fprintf(stderr, "[HIAHMachOBench] invalid value for -S: %s\n", optarg);
+                return 2;
+            }
+            options.sizeMB = (uint64_t)value;
+            break;
+        case 's':
+            if ((options.slices = HIAHBenchParseCount(optarg, 1, HIAH_BENCH_MAX_SLICES)) < 0) {
+                fprintf(stderr, "[HIAHMachOBench] invalid value for -s: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'n':
+            if ((options.iterations = HIAHBenchParseCount(optarg, 1, 100000)) < 0) {
+                fprintf(stderr, "[HIAHMachOBench] invalid value for -n: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'j':
+            if ((options.workers = HIAHBenchParseCount(optarg, 1, HIAH_WORKER_POOL_MAX)) < 0) {
+                fprintf(stderr, "[HIAHMachOBench] invalid value for -j: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case 'c':
+            if ((options.fixtures = HIAHBenchParseCount(optarg, 1, 100000)) < 0) {
+                fprintf(stderr, "[HIAHMachOBench] invalid value for -c: %s\n", optarg);
+                return 2;
+            }
+            break;
+        case '6':
+            options.fat64 = true;
+            break;
+        case 'd':
+            snprintf(options.directory, sizeof(options.directory), "%s", optarg);
+            break;
+        case 'k':
+            options.keep = true;
+            break;
+        default:
+            HIAHBenchUsage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+    }
+    if (optind != argc) {
+        HIAHBenchUsage(argv[0]);
+        return 2;
+    }
+    if (options.mode == HIAHBenchModeIndex) {
+        return HIAHBenchIndex(&options);
+    }
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/hiah-macho-bench.%d.bin", options.directory, (int)getpid());
+    uint64_t fileSize = 0;
+    HIAHBenchSlice *slices = HIAHBenchWriteFixture(path, &options, &fileSize);
+    if (!slices) {
+        fprintf(stderr, "[HIAHMachOBench] cannot write %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    int status;
+    switch (options.mode) {
+    case HIAHBenchModeStage:
+        status = HIAHBenchStage(&options, path, fileSize);
+        break;
+    case HIAHBenchModeSign:
+        status = HIAHBenchSign(&options, path, fileSize);
+        break;
+    default:
+        status = HIAHBenchPatch(&options, path, slices, fileSize);
+        break;
+    }
+    if (!options.keep) {
+        unlink(path);
+    }
+    free(slices);
+    return status;
+}
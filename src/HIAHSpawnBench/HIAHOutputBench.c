@@ -0,0 +1,479 @@
+/**
+ * HIAHOutputBench.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Spawn-storm benchmark for guest output channels.
+ *
+ * Concurrent spawners start short-lived guests (this binary in `--guest`
+ * mode) that write `-b` bytes to stdout and to stderr and exit. The spawner
+ * collects the output into an HIAHOutputRing and reaps the guest. The
+ * output reaches the spawner one of two ways:
+ *
+ *   socket   the way spawns used to work: bind and listen on a socket file
+ *            in the socket directory, hand the guest its path, block in
+ *            accept() until it connects, then read both streams merged
+ *            from the one connection and unlink the file
+ *   channel  HIAHOutputChannel: two socketpairs made before the spawn, the
+ *            guest inherits the write ends as fds 1 and 2, and
+ *            HIAHOutputChannelPump() reads them into the ring
+ *
+ * Reports spawns per second, spawn-to-EOF latency, and for `socket` the time
+ * spawners spent blocked in accept(). Every spawn must deliver all of its
+ * output and exit 0, or the exit status is non-zero.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHOutputChannel.h"
+#include "HIAHOutputRing.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <mach-o/dyld.h>
+#endif
+
+extern char **environ;
+
+typedef enum {
+    HIAHOutputBenchSocket,
+    HIAHOutputBenchChannel,
+    HIAHOutputBenchModeCount,
+} HIAHOutputBenchMode;
+
+typedef struct {
+    int spawners;
+    int spawns;
+    int bytes;
+    char directory[PATH_MAX];
+    char self[PATH_MAX];
+} HIAHOutputBenchOptions;
+
+typedef struct {
+    const HIAHOutputBenchOptions *options;
+    HIAHOutputBenchMode mode;
+    int index;
+    int spawns;
+    uint64_t *latency;
+    size_t completed;
+    uint64_t acceptWait;
+    uint64_t failures;
+    char firstError[128];
+} HIAHOutputBenchSpawner;
+
+static const char *const kModeNames[] = {"socket", "channel"};
+
+static uint64_t HIAHOutputBenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// MARK: - Guest
+
+static bool HIAHOutputBenchWriteAll(int fd, const char *data, size_t length) {
+    while (length > 0) {
+        ssize_t n = write(fd, data, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+/**
+ * `--guest BYTES [SOCKET]`: with a socket path, connect to it and make it
+ * stdout and stderr first, as guests did with the old socket files.
+ */
+static int HIAHOutputBenchGuestMain(int argc, char **argv) {
+    size_t bytes = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+    if (argc > 3) {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", argv[3]);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+            return 3;
+        }
+        dup2(fd, STDOUT_FILENO);
+        dup2(fd, STDERR_FILENO);
+        close(fd);
+    }
+
+    char chunk[4096];
+    memset(chunk, 'o', sizeof(chunk));
+    for (int stream = STDOUT_FILENO; stream <= STDERR_FILENO; stream++) {
+        for (size_t left = bytes; left > 0;) {
+            size_t n = left < sizeof(chunk) ? left : sizeof(chunk);
+            if (!HIAHOutputBenchWriteAll(stream, chunk, n)) {
+                return 4;
+            }
+            left -= n;
+        }
+    }
+    return 0;
+}
+
+// MARK: - Spawners
+
+static void HIAHOutputBenchFail(HIAHOutputBenchSpawner *spawner, const char *what, int error) {
+    if (spawner->failures++ == 0) {
+        snprintf(spawner->firstError, sizeof(spawner->firstError), "%s: %s", what, strerror(error));
+    }
+}
+
+static bool HIAHOutputBenchReap(HIAHOutputBenchSpawner *spawner, pid_t pid) {
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            HIAHOutputBenchFail(spawner, "waitpid", errno);
+            return false;
+        }
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        HIAHOutputBenchFail(spawner, "guest exit", ECHILD);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Reads one connection into the ring until EOF, as the old per-spawn
+ * dispatch block did.
+ */
+static void HIAHOutputBenchPumpSocket(int fd, HIAHOutputRing *ring) {
+    for (;;) {
+        struct iovec regions[2];
+        int count = HIAHOutputRingReserve(ring, regions);
+        if (count == 0) {
+            break;
+        }
+        ssize_t n = readv(fd, regions, count);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        HIAHOutputRingCommit(ring, (size_t)n);
+    }
+    HIAHOutputRingClose(ring);
+}
+
+static bool HIAHOutputBenchSpawnSocket(HIAHOutputBenchSpawner *spawner, int iteration,
+                                       HIAHOutputRing *ring, char *bytes) {
+    const HIAHOutputBenchOptions *options = spawner->options;
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    int pathLength = snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%d.%d.%d.s", options->directory,
+                              (int)getpid(), spawner->index, iteration);
+    if (pathLength < 0 || (size_t)pathLength >= sizeof(addr.sun_path)) {
+        HIAHOutputBenchFail(spawner, "socket path", ENAMETOOLONG);
+        return false;
+    }
+
+    unlink(addr.sun_path);
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0 || bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(listenFd, 5) != 0) {
+        HIAHOutputBenchFail(spawner, "bind", errno);
+        if (listenFd >= 0) close(listenFd);
+        return false;
+    }
+    fcntl(listenFd, F_SETFD, FD_CLOEXEC);
+
+    char *argv[] = {(char *)options->self, "--guest", bytes, addr.sun_path, NULL};
+    pid_t pid;
+    int error = posix_spawn(&pid, options->self, NULL, NULL, argv, environ);
+    if (error != 0) {
+        HIAHOutputBenchFail(spawner, "posix_spawn", error);
+        close(listenFd);
+        unlink(addr.sun_path);
+        return false;
+    }
+
+    uint64_t waitStart = HIAHOutputBenchNow();
+    int fd;
+    while ((fd = accept(listenFd, NULL, NULL)) < 0 && errno == EINTR) {
+    }
+    spawner->acceptWait += HIAHOutputBenchNow() - waitStart;
+    close(listenFd);
+    unlink(addr.sun_path);
+    if (fd < 0) {
+        HIAHOutputBenchFail(spawner, "accept", errno);
+        HIAHOutputBenchReap(spawner, pid);
+        return false;
+    }
+    HIAHOutputBenchPumpSocket(fd, ring);
+    close(fd);
+    return HIAHOutputBenchReap(spawner, pid);
+}
+
+static bool HIAHOutputBenchSpawnChannel(HIAHOutputBenchSpawner *spawner, HIAHOutputRing *ring,
+                                        char *bytes) {
+    const HIAHOutputBenchOptions *options = spawner->options;
+    HIAHOutputChannel channel;
+    int error = 0;
+    if (!HIAHOutputChannelOpen(&channel, &error)) {
+        HIAHOutputBenchFail(spawner, "socketpair", error);
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, channel.guestFds[HIAHOutputStreamStdout], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, channel.guestFds[HIAHOutputStreamStderr], STDERR_FILENO);
+    char *argv[] = {(char *)options->self, "--guest", bytes, NULL};
+    pid_t pid;
+    error = posix_spawn(&pid, options->self, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    HIAHOutputChannelCloseGuest(&channel);
+    if (error != 0) {
+        HIAHOutputBenchFail(spawner, "posix_spawn", error);
+        HIAHOutputChannelCloseKernel(&channel);
+        return false;
+    }
+
+    HIAHOutputChannelPump(&channel, ring);
+    HIAHOutputChannelCloseKernel(&channel);
+    return HIAHOutputBenchReap(spawner, pid);
+}
+
+static void *HIAHOutputBenchSpawnerMain(void *context) {
+    HIAHOutputBenchSpawner *spawner = context;
+    const HIAHOutputBenchOptions *options = spawner->options;
+    char bytes[24];
+    snprintf(bytes, sizeof(bytes), "%d", options->bytes);
+    size_t expected = 2 * (size_t)options->bytes;
+
+    for (int i = 0; i < spawner->spawns; i++) {
+        // Room for everything, so the pump never waits on a consumer
+        HIAHOutputRing *ring = HIAHOutputRingCreate(expected + 1, NULL, NULL);
+        if (!ring) {
+            HIAHOutputBenchFail(spawner, "ring", ENOMEM);
+            continue;
+        }
+
+        uint64_t start = HIAHOutputBenchNow();
+        bool ok = spawner->mode == HIAHOutputBenchSocket
+                      ? HIAHOutputBenchSpawnSocket(spawner, i, ring, bytes)
+                      : HIAHOutputBenchSpawnChannel(spawner, ring, bytes);
+        uint64_t elapsed = HIAHOutputBenchNow() - start;
+
+        HIAHOutputRingStats stats;
+        HIAHOutputRingGetStats(ring, &stats);
+        HIAHOutputRingRelease(ring);
+        if (ok && stats.written != expected) {
+            HIAHOutputBenchFail(spawner, "short output", EIO);
+            ok = false;
+        }
+        if (ok) {
+            spawner->latency[spawner->completed++] = elapsed;
+        }
+    }
+    return NULL;
+}
+
+// MARK: - Reporting
+
+static int HIAHOutputBenchCompare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double HIAHOutputBenchPercentile(const uint64_t *sorted, size_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    return (double)sorted[(size_t)(percentile / 100.0 * (double)(count - 1) + 0.5)] / 1000.0;
+}
+
+static bool HIAHOutputBenchRun(const HIAHOutputBenchOptions *options, HIAHOutputBenchMode mode) {
+    HIAHOutputBenchSpawner *spawners = calloc((size_t)options->spawners, sizeof(*spawners));
+    pthread_t *threads = calloc((size_t)options->spawners, sizeof(*threads));
+    uint64_t *latency = calloc((size_t)options->spawns + 1, sizeof(uint64_t));
+    if (!spawners || !threads || !latency) {
+        fprintf(stderr, "[HIAHOutputBench] %s\n", strerror(ENOMEM));
+        return false;
+    }
+
+    uint64_t *cursor = latency;
+    for (int i = 0; i < options->spawners; i++) {
+        spawners[i].options = options;
+        spawners[i].mode = mode;
+        spawners[i].index = i;
+        spawners[i].spawns = options->spawns / options->spawners + (i < options->spawns % options->spawners);
+        spawners[i].latency = cursor;
+        cursor += spawners[i].spawns;
+    }
+
+    uint64_t start = HIAHOutputBenchNow();
+    for (int i = 0; i < options->spawners; i++) {
+        pthread_create(&threads[i], NULL, HIAHOutputBenchSpawnerMain, &spawners[i]);
+    }
+    uint64_t failures = 0, acceptWait = 0;
+    size_t completed = 0;
+    const char *firstError = NULL;
+    for (int i = 0; i < options->spawners; i++) {
+        pthread_join(threads[i], NULL);
+        failures += spawners[i].failures;
+        acceptWait += spawners[i].acceptWait;
+        if (!firstError && spawners[i].failures) {
+            firstError = spawners[i].firstError;
+        }
+    }
+    double elapsed = (double)(HIAHOutputBenchNow() - start) / 1e9;
+
+    // Pack the per-spawner runs together before sorting
+    for (int i = 0; i < options->spawners; i++) {
+        memmove(latency + completed, spawners[i].latency, spawners[i].completed * sizeof(uint64_t));
+        completed += spawners[i].completed;
+    }
+    qsort(latency, completed, sizeof(uint64_t), HIAHOutputBenchCompare);
+
+    printf("%-8s %zu ok, %llu failed in %.3f s: %.1f spawns/s\n", kModeNames[mode], completed,
+           (unsigned long long)failures, elapsed, (double)completed / elapsed);
+    printf("  latency  p50 %8.1f us  p99 %8.1f us  max %8.1f us\n",
+           HIAHOutputBenchPercentile(latency, completed, 50),
+           HIAHOutputBenchPercentile(latency, completed, 99),
+           HIAHOutputBenchPercentile(latency, completed, 100));
+    if (mode == HIAHOutputBenchSocket && completed > 0) {
+        printf("  accept   %.1f us blocked per spawn, %.3f s in total\n",
+               (double)acceptWait / 1000.0 / (double)completed, (double)acceptWait / 1e9);
+    }
+    if (firstError) {
+        printf("  first error: %s\n", firstError);
+    }
+
+    free(spawners);
+    free(threads);
+    free(latency);
+    return failures == 0;
+}
+
+// MARK: - Main
+
+static bool HIAHOutputBenchFindSelf(const char *argv0, char *path) {
+#if defined(__APPLE__)
+    char raw[PATH_MAX];
+    uint32_t size = sizeof(raw);
+    if (_NSGetExecutablePath(raw, &size) == 0 && realpath(raw, path)) {
+        return true;
+    }
+#elif defined(__linux__)
+    ssize_t n = readlink("/proc/self/exe", path, PATH_MAX - 1);
+    if (n > 0) {
+        path[n] = '\0';
+        return true;
+    }
+#endif
+    return realpath(argv0, path) != NULL;
+}
+
+static int HIAHOutputBenchParseCount(const char *value, int minimum) {
+    char *end;
+    long parsed = strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || parsed < minimum || parsed > INT_MAX) {
+        return -1;
+    }
+    return (int)parsed;
+}
+
+static void HIAHOutputBenchUsage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -m MODE  socket, channel or both (default both)\n"
+            "  -c N     concurrent spawners (default 8)\n"
+            "  -n N     spawns per mode (default 2000)\n"
+            "  -b N     bytes each guest writes to stdout and to stderr (default 4096)\n"
+            "  -d DIR   directory for socket files (default $TMPDIR or /tmp)\n",
+            program);
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "--guest") == 0) {
+        return HIAHOutputBenchGuestMain(argc, argv);
+    }
+
+    HIAHOutputBenchOptions options = {.spawners = 8, .spawns = 2000, .bytes = 4096};
+    const char *tmp = getenv("TMPDIR");
+    snprintf(options.directory, sizeof(options.directory), "%s", tmp && *tmp ? tmp : "/tmp");
+    int first = HIAHOutputBenchSocket, last = HIAHOutputBenchChannel;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:c:n:b:d:h")) != -1) {
+        int *target = NULL;
+        int minimum = 0;
+        switch (opt) {
+        case 'm':
+            if (strcmp(optarg, "socket") == 0) {
+                first = last = HIAHOutputBenchSocket;
+            } else if (strcmp(optarg, "channel") == 0) {
+                first = last = HIAHOutputBenchChannel;
+            } else if (strcmp(optarg, "both") != 0) {
+                fprintf(stderr, "[HIAHOutputBench] invalid mode: %s\n", optarg);
+                return 2;
+            }
+            continue;
+        case 'c': target = &options.spawners; minimum = 1; break;
+        case 'n': target = &options.spawns; minimum = 1; break;
+        case 'b': target = &options.bytes; break;
+        case 'd':
+            snprintf(options.directory, sizeof(options.directory), "%s", optarg);
+            continue;
+        default:
+            HIAHOutputBenchUsage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+        if ((*target = HIAHOutputBenchParseCount(optarg, minimum)) < 0) {
+            fprintf(stderr, "[HIAHOutputBench] invalid value for -%c: %s\n", opt, optarg);
+            return 2;
+        }
+    }
+    if (optind != argc) {
+        HIAHOutputBenchUsage(argv[0]);
+        return 2;
+    }
+    if (!HIAHOutputBenchFindSelf(argv[0], options.self)) {
+        fprintf(stderr, "[HIAHOutputBench] cannot locate own executable\n");
+        return 2;
+    }
+    if (options.spawners > options.spawns) {
+        options.spawners = options.spawns;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("HIAHKernel output bench: %d spawns, %d spawners, %d B per stream\n",
+           options.spawns, options.spawners, options.bytes);
+    bool ok = true;
+    for (int mode = first; mode <= last; mode++) {
+        ok = HIAHOutputBenchRun(&options, (HIAHOutputBenchMode)mode) && ok;
+    }
+    return ok ? 0 : 1;
+}
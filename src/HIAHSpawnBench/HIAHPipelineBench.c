@@ -0,0 +1,398 @@
+/**
+ * HIAHPipelineBench.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Replays spawns through the kernel's spawn pipeline with stubbed loader
+ * stages and reports per-stage latency.
+ *
+ * Each spawn is laid out as in -spawnVirtualProcessWithPath:. The spawner
+ * resolves, then hands prepare -> load -> entry to a worker while it opens
+ * the output channel itself, joins both branches, and registers and
+ * launches. The channel (HIAHOutputChannel) and register (HIAHProcessTable)
+ * stages are real. Resolve, prepare, load, entry and launch sleep for a
+ * configurable time, standing in for file system work, dlopen and dlsym that
+ * need dyld. Every stage is recorded in an HIAHSpawnTrace. `sequential`
+ * mode runs the same stages one after another for comparison.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHOutputChannel.h"
+#include "HIAHProcessTable.h"
+#include "HIAHSpawnTrace.h"
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef enum {
+    HIAHPipelineBenchPipelined,
+    HIAHPipelineBenchSequential,
+    HIAHPipelineBenchModeCount,
+} HIAHPipelineBenchMode;
+
+typedef struct {
+    int spawners;
+    int spawns;
+    unsigned stubMicros[HIAHSpawnStageCount];   // 0 = stage is real or skipped
+} HIAHPipelineBenchOptions;
+
+static const char *const kModeNames[] = {"pipelined", "sequential"};
+
+/** Stages a kernel-side spawn runs; jit-wait and sign only run in the extension. */
+static const HIAHSpawnStage kKernelStages[] = {
+    HIAHSpawnStageResolve, HIAHSpawnStageChannel, HIAHSpawnStagePrepare,
+    HIAHSpawnStageLoad,    HIAHSpawnStageEntry,   HIAHSpawnStageRegister,
+    HIAHSpawnStageLaunch,
+};
+#define kKernelStageCount (sizeof(kKernelStages) / sizeof(kKernelStages[0]))
+
+typedef struct {
+    const HIAHPipelineBenchOptions *options;
+    HIAHPipelineBenchMode mode;
+    HIAHProcessTable *table;
+    int spawns;
+
+    // Worker standing in for the global queue the load branch runs on
+    pthread_t worker;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    HIAHSpawnTrace *pending;   // Load branch to run, NULL when idle
+    bool loaded;               // Load branch finished
+    bool stop;
+
+    HIAHSpawnTrace *traces;
+    size_t completed;
+    uint64_t failures;
+} HIAHPipelineBenchSpawner;
+
+// MARK: - Stages
+
+static void HIAHPipelineBenchStub(const HIAHPipelineBenchOptions *options, HIAHSpawnTrace *trace,
+                                  HIAHSpawnStage stage) {
+    HIAHSpawnTraceBegin(trace, stage);
+    unsigned micros = options->stubMicros[stage];
+    if (micros > 0) {
+        struct timespec delay = {micros / 1000000, (long)(micros % 1000000) * 1000};
+        while (nanosleep(&delay, &delay) != 0 && errno == EINTR) {
+        }
+    }
+    HIAHSpawnTraceEnd(trace, stage);
+}
+
+static void HIAHPipelineBenchLoadBranch(const HIAHPipelineBenchOptions *options, HIAHSpawnTrace *trace) {
+    HIAHPipelineBenchStub(options, trace, HIAHSpawnStagePrepare);
+    HIAHPipelineBenchStub(options, trace, HIAHSpawnStageLoad);
+    HIAHPipelineBenchStub(options, trace, HIAHSpawnStageEntry);
+}
+
+static void *HIAHPipelineBenchWorkerMain(void *context) {
+    HIAHPipelineBenchSpawner *spawner = context;
+    pthread_mutex_lock(&spawner->lock);
+    for (;;) {
+        while (!spawner->pending && !spawner->stop) {
+            pthread_cond_wait(&spawner->cond, &spawner->lock);
+        }
+        if (spawner->stop) {
+            break;
+        }
+        HIAHSpawnTrace *trace = spawner->pending;
+        pthread_mutex_unlock(&spawner->lock);
+        HIAHPipelineBenchLoadBranch(spawner->options, trace);
+        pthread_mutex_lock(&spawner->lock);
+        spawner->pending = NULL;
+        spawner->loaded = true;
+        pthread_cond_broadcast(&spawner->cond);
+    }
+    pthread_mutex_unlock(&spawner->lock);
+    return NULL;
+}
+
+static bool HIAHPipelineBenchSpawn(HIAHPipelineBenchSpawner *spawner, HIAHSpawnTrace *trace) {
+    const HIAHPipelineBenchOptions *options = spawner->options;
+    bool pipelined = spawner->mode == HIAHPipelineBenchPipelined;
+    HIAHSpawnTraceStart(trace);
+
+    // 1. Resolve
+    HIAHPipelineBenchStub(options, trace, HIAHSpawnStageResolve);
+
+    // 2a. Prepare, load and look up the entry point
+    if (pipelined) {
+        pthread_mutex_lock(&spawner->lock);
+        spawner->pending = trace;
+        spawner->loaded = false;
+        pthread_cond_broadcast(&spawner->cond);
+        pthread_mutex_unlock(&spawner->lock);
+    } else {
+        HIAHPipelineBenchLoadBranch(options, trace);
+    }
+
+    // 2b. Open the output channel
+    HIAHSpawnTraceBegin(trace, HIAHSpawnStageChannel);
+    HIAHOutputChannel channel;
+    int error = 0;
+    bool channelOpen = HIAHOutputChannelOpen(&channel, &error);
+    if (channelOpen) {
+        HIAHSpawnTraceEnd(trace, HIAHSpawnStageChannel);
+    } else {
+        HIAHSpawnTraceFail(trace, HIAHSpawnStageChannel);
+    }
+
+    // 3. Join, then register and launch
+    if (pipelined) {
+        pthread_mutex_lock(&spawner->lock);
+        while (!spawner->loaded) {
+            pthread_cond_wait(&spawner->cond, &spawner->lock);
+        }
+        pthread_mutex_unlock(&spawner->lock);
+    }
+    if (!channelOpen) {
+        return false;
+    }
+
+    HIAHSpawnTraceBegin(trace, HIAHSpawnStageRegister);
+    HIAHProcessTableKey key;
+    memset(&key, 0, sizeof(key));
+    key.pid = HIAHProcessTableAllocatePID(spawner->table);
+    key.physicalPid = getpid();
+    bool registered = HIAHProcessTableInsert(spawner->table, &key, trace);
+    HIAHSpawnTraceEnd(trace, HIAHSpawnStageRegister);
+
+    HIAHPipelineBenchStub(options, trace, HIAHSpawnStageLaunch);
+
+    // The guest has run; tear down outside the trace
+    HIAHOutputChannelCloseGuest(&channel);
+    HIAHOutputChannelCloseKernel(&channel);
+    if (registered) {
+        HIAHProcessTableRemove(spawner->table, key.pid);
+    }
+    return registered;
+}
+
+static void *HIAHPipelineBenchSpawnerMain(void *context) {
+    HIAHPipelineBenchSpawner *spawner = context;
+    for (int i = 0; i < spawner->spawns; i++) {
+        HIAHSpawnTrace *trace = &spawner->traces[spawner->completed];
+        if (HIAHPipelineBenchSpawn(spawner, trace)) {
+            spawner->completed++;
+        } else {
+            spawner->failures++;
+        }
+    }
+    return NULL;
+}
+
+// MARK: - Reporting
+
+static int HIAHPipelineBenchCompare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double HIAHPipelineBenchPercentile(const uint64_t *sorted, size_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    return (double)sorted[(size_t)(percentile / 100.0 * (double)(count - 1) + 0.5)] / 1000.0;
+}
+
+static void HIAHPipelineBenchReportRow(const char *name, uint64_t *samples, size_t count) {
+    qsort(samples, count, sizeof(uint64_t), HIAHPipelineBenchCompare);
+    printf("  %-9s p50 %9.1f us  p99 %9.1f us\n", name, HIAHPipelineBenchPercentile(samples, count, 50),
+           HIAHPipelineBenchPercentile(samples, count, 99));
+}
+
+static void HIAHPipelineBenchReport(HIAHSpawnTrace **traces, size_t count, uint64_t *samples) {
+    for (size_t s = 0; s < kKernelStageCount; s++) {
+        for (size_t i = 0; i < count; i++) {
+            samples[i] = HIAHSpawnTraceDuration(traces[i], kKernelStages[s]);
+        }
+        HIAHPipelineBenchReportRow(HIAHSpawnStageName(kKernelStages[s]), samples, count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = HIAHSpawnTraceTotal(traces[i]);
+    }
+    HIAHPipelineBenchReportRow("total", samples, count);
+}
+
+static bool HIAHPipelineBenchRun(const HIAHPipelineBenchOptions *options, HIAHPipelineBenchMode mode) {
+    // Values are the traces themselves and live until the run ends
+    static const HIAHProcessTableCallbacks callbacks = {NULL, NULL};
+    HIAHProcessTable *table = HIAHProcessTableCreate(&callbacks, 1);
+    HIAHPipelineBenchSpawner *spawners = calloc((size_t)options->spawners, sizeof(*spawners));
+    pthread_t *threads = calloc((size_t)options->spawners, sizeof(*threads));
+    HIAHSpawnTrace *traces = calloc((size_t)options->spawns, sizeof(HIAHSpawnTrace));
+    HIAHSpawnTrace **finished = calloc((size_t)options->spawns, sizeof(HIAHSpawnTrace *));
+    uint64_t *samples = calloc((size_t)options->spawns, sizeof(uint64_t));
+    if (!table || !spawners || !threads || !traces || !finished || !samples) {
+        fprintf(stderr, "[HIAHPipelineBench] %s\n", strerror(ENOMEM));
+        return false;
+    }
+
+    HIAHSpawnTrace *cursor = traces;
+    for (int i = 0; i < options->spawners; i++) {
+        HIAHPipelineBenchSpawner *spawner = &spawners[i];
+        spawner->options = options;
+        spawner->mode = mode;
+        spawner->table = table;
+        spawner->spawns = options->spawns / options->spawners + (i < options->spawns % options->spawners);
+        spawner->traces = cursor;
+        cursor += spawner->spawns;
+        pthread_mutex_init(&spawner->lock, NULL);
+        pthread_cond_init(&spawner->cond, NULL);
+        if (mode == HIAHPipelineBenchPipelined) {
+            pthread_create(&spawner->worker, NULL, HIAHPipelineBenchWorkerMain, spawner);
+        }
+    }
+
+    uint64_t start = HIAHSpawnTraceNow();
+    for (int i = 0; i < options->spawners; i++) {
+        pthread_create(&threads[i], NULL, HIAHPipelineBenchSpawnerMain, &spawners[i]);
+    }
+    uint64_t failures = 0;
+    size_t completed = 0;
+    for (int i = 0; i < options->spawners; i++) {
+        HIAHPipelineBenchSpawner *spawner = &spawners[i];
+        pthread_join(threads[i], NULL);
+        failures += spawner->failures;
+        for (size_t j = 0; j < spawner->completed; j++) {
+            finished[completed++] = &spawner->traces[j];
+        }
+    }
+    double elapsed = (double)(HIAHSpawnTraceNow() - start) / 1e9;
+
+    printf("%-10s %zu ok, %llu failed in %.3f s: %.1f spawns/s\n", kModeNames[mode], completed,
+           (unsigned long long)failures, elapsed, (double)completed / elapsed);
+    HIAHPipelineBenchReport(finished, completed, samples);
+
+    for (int i = 0; i < options->spawners; i++) {
+        HIAHPipelineBenchSpawner *spawner = &spawners[i];
+        if (mode == HIAHPipelineBenchPipelined) {
+            pthread_mutex_lock(&spawner->lock);
+            spawner->stop = true;
+            pthread_cond_broadcast(&spawner->cond);
+            pthread_mutex_unlock(&spawner->lock);
+            pthread_join(spawner->worker, NULL);
+        }
+        pthread_mutex_destroy(&spawner->lock);
+        pthread_cond_destroy(&spawner->cond);
+    }
+    HIAHProcessTableDestroy(table);
+    free(spawners);
+    free(threads);
+    free(traces);
+    free(finished);
+    free(samples);
+    return failures == 0;
+}
+
+// MARK: - Main
+
+static int HIAHPipelineBenchParseCount(const char *value, int minimum) {
+    char *end;
+    long parsed = strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || parsed < minimum || parsed > INT_MAX) {
+        return -1;
+    }
+    return (int)parsed;
+}
+
+/** Parses `stage=us` for one of the stubbed stages. */
+static bool HIAHPipelineBenchParseStub(HIAHPipelineBenchOptions *options, const char *value) {
+    const char *equals = strchr(value, '=');
+    if (!equals) {
+        return false;
+    }
+    for (size_t s = 0; s < kKernelStageCount; s++) {
+        HIAHSpawnStage stage = kKernelStages[s];
+        const char *name = HIAHSpawnStageName(stage);
+        if (stage == HIAHSpawnStageChannel || stage == HIAHSpawnStageRegister ||
+            strlen(name) != (size_t)(equals - value) || strncmp(value, name, strlen(name)) != 0) {
+            continue;
+        }
+        int micros = HIAHPipelineBenchParseCount(equals + 1, 0);
+        if (micros < 0) {
+            return false;
+        }
+        options->stubMicros[stage] = (unsigned)micros;
+        return true;
+    }
+    return false;
+}
+
+static void HIAHPipelineBenchUsage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -m MODE      pipelined, sequential or both (default both)\n"
+            "  -c N         concurrent spawners (default 4)\n"
+            "  -n N         spawns per mode (default 2000)\n"
+            "  -t STAGE=US  stub time for resolve, prepare, load, entry or launch\n"
+            "               (defaults 50, 400, 300, 10, 20)\n",
+            program);
+}
+
+int main(int argc, char **argv) {
+    HIAHPipelineBenchOptions options = {.spawners = 4, .spawns = 2000};
+    options.stubMicros[HIAHSpawnStageResolve] = 50;
+    options.stubMicros[HIAHSpawnStagePrepare] = 400;
+    options.stubMicros[HIAHSpawnStageLoad] = 300;
+    options.stubMicros[HIAHSpawnStageEntry] = 10;
+    options.stubMicros[HIAHSpawnStageLaunch] = 20;
+    int first = HIAHPipelineBenchPipelined, last = HIAHPipelineBenchSequential;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "m:c:n:t:h")) != -1) {
+        int *target = NULL;
+        switch (opt) {
+        case 'm':
+            if (strcmp(optarg, "pipelined") == 0) {
+                first = last = HIAHPipelineBenchPipelined;
+            } else if (strcmp(optarg, "sequential") == 0) {
+                first = last = HIAHPipelineBenchSequential;
+            } else if (strcmp(optarg, "both") != 0) {
+                fprintf(stderr, "[HIAHPipelineBench] invalid mode: %s\n", optarg);
+                return 2;
+            }
+            continue;
+        case 'c': target = &options.spawners; break;
+        case 'n': target = &options.spawns; break;
+        case 't':
+            if (!HIAHPipelineBenchParseStub(&options, optarg)) {
+                fprintf(stderr, "[HIAHPipelineBench] invalid stage time: %s\n", optarg);
+                return 2;
+            }
+            continue;
+        default:
+            HIAHPipelineBenchUsage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+        if ((*target = HIAHPipelineBenchParseCount(optarg, 1)) < 0) {
+            fprintf(stderr, "[HIAHPipelineBench] invalid value for -%c: %s\n", opt, optarg);
+            return 2;
+        }
+    }
+    if (optind != argc) {
+        HIAHPipelineBenchUsage(argv[0]);
+        return 2;
+    }
+    if (options.spawners > options.spawns) {
+        options.spawners = options.spawns;
+    }
+
+    printf("HIAHKernel pipeline bench: %d spawns, %d spawners\n", options.spawns, options.spawners);
+    bool ok = true;
+    for (int mode = first; mode <= last; mode++) {
+        ok = HIAHPipelineBenchRun(&options, (HIAHPipelineBenchMode)mode) && ok;
+    }
+    return ok ? 0 : 1;
+}
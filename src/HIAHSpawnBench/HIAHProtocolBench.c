@@ -0,0 +1,777 @@
+/**
+ * HIAHProtocolBench.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Microbenchmark of the control socket encodings: binary frames against
+ * newline JSON.
+ *
+ * Runs the real HIAHControlServer in-process with a handler that decodes
+ * each request and answers it the way the kernel does. Clients send `spawn`
+ * requests (path, arguments and a full environment) and `list` requests
+ * (answered with a table of processes), one at a time per connection, once
+ * with each encoding:
+ *
+ *   binary  HIAHControlConnect() hello, then HIAHControlWriter frames; the
+ *           handler walks them with HIAHControlReader without copying
+ *   json    one JSON object per line, as the kernel speaks to old guests.
+ *           NSJSONSerialization is not available on Linux, so a small JSON
+ *           parser stands in for it. Like NSJSONSerialization it copies
+ *           every string out of the message.
+ *
+ * For each encoding it reports requests per second, latency, and the bytes
+ * on the wire per request and per reply as counted by the server. It also
+ * times encoding and decoding alone, without the socket.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHControlProtocol.h"
+#include "HIAHControlServer.h"
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef enum {
+    HIAHProtoEncodingBinary,
+    HIAHProtoEncodingJSON,
+} HIAHProtoEncoding;
+
+typedef struct {
+    int clients;
+    int requests;
+    int argumentCount;
+    int argumentSize;
+    int environmentCount;
+    int environmentSize;
+    int listEvery;
+    int listProcesses;
+    char socketPath[104];
+} HIAHProtoOptions;
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    bool failed;
+} HIAHProtoBuffer;
+
+typedef struct {
+    const HIAHProtoOptions *options;
+    HIAHProtoEncoding encoding;
+    int requests;
+    uint64_t *spawnLatency;
+    uint64_t *listLatency;
+    size_t spawnCount;
+    size_t listCount;
+    uint64_t failures;
+} HIAHProtoClient;
+
+static const char *const kEncodingNames[] = {"binary", "json"};
+
+static const HIAHProtoOptions *gOptions;
+static char **gArguments;
+static char **gEnvironment;   // "KEY=VALUE"
+
+static uint64_t HIAHProtoNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// MARK: - Text Buffer
+
+static void HIAHProtoAppend(HIAHProtoBuffer *buffer, const char *data, size_t length) {
+    if (buffer->failed) {
+        return;
+    }
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 256;
+        while (capacity < buffer->length + length + 1) {
+            capacity *= 2;
+        }
+        char *grown = realloc(buffer->data, capacity);
+        if (!grown) {
+            buffer->failed = true;
+            return;
+        }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    buffer->data[buffer->length] = '\0';
+}
+
+static void HIAHProtoAppendText(HIAHProtoBuffer *buffer, const char *text) {
+    HIAHProtoAppend(buffer, text, strlen(text));
+}
+
+static void HIAHProtoAppendJSONString(HIAHProtoBuffer *buffer, const char *string, size_t length) {
+    HIAHProtoAppend(buffer, "\"", 1);
+    size_t start = 0;
+    for (size_t i = 0; i < length; i++) {
+        unsigned char c = (unsigned char)string[i];
+        if (c != '"' && c != '\\' && c >= 0x20) {
+            continue;
+        }
+        HIAHProtoAppend(buffer, string + start, i - start);
+        char escape[8];
+        snprintf(escape, sizeof(escape), c == '"' ? "\\\"" : c == '\\' ? "\\\\" : "\\u%04x", c);
+        HIAHProtoAppendText(buffer, escape);
+        start = i + 1;
+    }
+    HIAHProtoAppend(buffer, string + start, length - start);
+    HIAHProtoAppend(buffer, "\"", 1);
+}
+
+static void HIAHProtoAppendInt(HIAHProtoBuffer *buffer, long long value) {
+    char digits[24];
+    HIAHProtoAppendText(buffer, (snprintf(digits, sizeof(digits), "%lld", value), digits));
+}
+
+// MARK: - JSON Stand-In
+
+typedef struct {
+    const char *cursor;
+    const char *end;
+    size_t strings;
+    size_t numbers;
+    size_t depth;
+} HIAHProtoJSON;
+
+static void HIAHProtoJSONSkipSpace(HIAHProtoJSON *json) {
+    while (json->cursor < json->end &&
+           (*json->cursor == ' ' || *json->cursor == '\t' || *json->cursor == '\r' || *json->cursor == '\n')) {
+        json->cursor++;
+    }
+}
+
+/**
+ * Parses a string and, like NSJSONSerialization, returns an unescaped copy.
+ */
+static char *HIAHProtoJSONString(HIAHProtoJSON *json) {
+    if (json->cursor >= json->end || *json->cursor != '"') {
+        return NULL;
+    }
+    const char *start = ++json->cursor;
+    const char *end = start;
+    while (end < json->end && *end != '"') {
+        end += (*end == '\\') ? 2 : 1;
+    }
+    if (end >= json->end) {
+        return NULL;
+    }
+
+    char *copy = malloc((size_t)(end - start) + 1);
+    if (!copy) {
+        return NULL;
+    }
+    size_t length = 0;
+    for (const char *p = start; p < end; p++) {
+        if (*p != '\\') {
+            copy[length++] = *p;
+            continue;
+        }
+        p++;
+        switch (*p) {
+            case 'n': copy[length++] = '\n'; break;
+            case 't': copy[length++] = '\t'; break;
+            case 'r': copy[length++] = '\r'; break;
+            case 'u':
+                if (end - p < 5) {
+                    free(copy);
+                    return NULL;
+                }
+                copy[length++] = (char)strtol((char[]){p[1], p[2], p[3], p[4], 0}, NULL, 16);
+                p += 4;
+                break;
+            default: copy[length++] = *p; break;
+        }
+    }
+    copy[length] = '\0';
+    json->cursor = end + 1;
+    json->strings++;
+    return copy;
+}
+
+static bool HIAHProtoJSONValue(HIAHProtoJSON *json);
+
+static bool HIAHProtoJSONContainer(HIAHProtoJSON *json, char close, bool keyed) {
+    json->cursor++;
+    if (++json->depth > 64) {
+        return false;
+    }
+    HIAHProtoJSONSkipSpace(json);
+    if (json->cursor < json->end && *json->cursor == close) {
+        json->cursor++;
+        json->depth--;
+        return true;
+    }
+    for (;;) {
+        HIAHProtoJSONSkipSpace(json);
+        if (keyed) {
+            char *key = HIAHProtoJSONString(json);
+            if (!key) {
+                return false;
+            }
+            free(key);
+            HIAHProtoJSONSkipSpace(json);
+            if (json->cursor >= json->end || *json->cursor++ != ':') {
+                return false;
+            }
+        }
+        if (!HIAHProtoJSONValue(json)) {
+            return false;
+        }
+        HIAHProtoJSONSkipSpace(json);
+        if (json->cursor >= json->end) {
+            return false;
+        }
+        char c = *json->cursor++;
+        if (c == close) {
+            json->depth--;
+            return true;
+        }
+        if (c != ',') {
+            return false;
+        }
+    }
+}
+
+static bool HIAHProtoJSONValue(HIAHProtoJSON *json) {
+    HIAHProtoJSONSkipSpace(json);
+    if (json->cursor >= json->end) {
+        return false;
+    }
+    switch (*json->cursor) {
+        case '{':
+            return HIAHProtoJSONContainer(json, '}', true);
+        case '[':
+            return HIAHProtoJSONContainer(json, ']', false);
+        case '"': {
+            char *string = HIAHProtoJSONString(json);
+            free(string);
+            return string != NULL;
+        }
+        case 't':
+        case 'f':
+        case 'n': {
+            static const char *const words[] = {"true", "false", "null"};
+            for (int i = 0; i < 3; i++) {
+                size_t length = strlen(words[i]);
+                if ((size_t)(json->end - json->cursor) >= length &&
+                    memcmp(json->cursor, words[i], length) == 0) {
+                    json->cursor += length;
+                    return true;
+                }
+            }
+            return false;
+        }
+        default: {
+            // Messages are not NUL-terminated, so no strtod()
+            const char *start = json->cursor;
+            while (json->cursor < json->end && *json->cursor && strchr("+-.0123456789eE", *json->cursor)) {
+                json->cursor++;
+            }
+            json->numbers++;
+            return json->cursor > start;
+        }
+    }
+}
+
+static bool HIAHProtoJSONParse(const void *data, size_t length, size_t *strings) {
+    HIAHProtoJSON json = {data, (const char *)data + length, 0, 0, 0};
+    bool ok = HIAHProtoJSONValue(&json);
+    HIAHProtoJSONSkipSpace(&json);
+    if (strings) {
+        *strings = json.strings;
+    }
+    return ok && json.cursor == json.end;
+}
+
+// MARK: - Messages
+
+static void HIAHProtoEncodeSpawnJSON(HIAHProtoBuffer *buffer) {
+    const HIAHProtoOptions *options = gOptions;
+    buffer->length = 0;
+    HIAHProtoAppendText(buffer, "{\"command\":\"spawn\",\"path\":");
+    HIAHProtoAppendJSONString(buffer, "/var/mobile/bin/bench", 21);
+    HIAHProtoAppendText(buffer, ",\"args\":[");
+    for (int i = 0; i < options->argumentCount; i++) {
+        if (i) HIAHProtoAppend(buffer, ",", 1);
+        HIAHProtoAppendJSONString(buffer, gArguments[i], strlen(gArguments[i]));
+    }
+    HIAHProtoAppendText(buffer, "],\"env\":{");
+    for (int i = 0; i < options->environmentCount; i++) {
+        const char *entry = gEnvironment[i];
+        const char *equals = strchr(entry, '=');
+        if (i) HIAHProtoAppend(buffer, ",", 1);
+        HIAHProtoAppendJSONString(buffer, entry, (size_t)(equals - entry));
+        HIAHProtoAppend(buffer, ":", 1);
+        HIAHProtoAppendJSONString(buffer, equals + 1, strlen(equals + 1));
+    }
+    HIAHProtoAppendText(buffer, "}}");
+}
+
+static void HIAHProtoEncodeSpawnBinary(HIAHControlWriter *writer) {
+    HIAHControlWriterInit(writer, HIAHControlMessageSpawn);
+    HIAHControlWriterAddString(writer, HIAHControlFieldPath, "/var/mobile/bin/bench");
+    HIAHControlWriterAddStringArray(writer, HIAHControlFieldArguments,
+                                    (const char *const *)gArguments, (size_t)gOptions->argumentCount);
+    HIAHControlWriterAddStringArray(writer, HIAHControlFieldEnvironment,
+                                    (const char *const *)gEnvironment, (size_t)gOptions->environmentCount);
+}
+
+static void HIAHProtoEncodeReplyJSON(HIAHProtoBuffer *buffer, bool list, int pid) {
+    buffer->length = 0;
+    HIAHProtoAppendText(buffer, "{\"status\":\"ok\"");
+    if (!list) {
+        HIAHProtoAppendText(buffer, ",\"pid\":");
+        HIAHProtoAppendInt(buffer, pid);
+    } else {
+        HIAHProtoAppendText(buffer, ",\"processes\":[");
+        for (int i = 0; i < gOptions->listProcesses; i++) {
+            HIAHProtoAppendText(buffer, i ? ",{\"pid\":" : "{\"pid\":");
+            HIAHProtoAppendInt(buffer, 1000 + i);
+            HIAHProtoAppendText(buffer, ",\"path\":");
+            HIAHProtoAppendJSONString(buffer, "/var/mobile/bin/bench", 21);
+            HIAHProtoAppendText(buffer, ",\"exited\":false,\"exitCode\":0}");
+        }
+        HIAHProtoAppendText(buffer, "]");
+    }
+    HIAHProtoAppendText(buffer, "}");
+}
+
+static void HIAHProtoEncodeReplyBinary(HIAHControlWriter *writer, bool list, int pid) {
+    HIAHControlWriterInit(writer, HIAHControlMessageReply);
+    HIAHControlWriterAddInt(writer, HIAHControlFieldStatus, HIAHControlStatusOK);
+    if (!list) {
+        HIAHControlWriterAddInt(writer, HIAHControlFieldPid, pid);
+        return;
+    }
+    for (int i = 0; i < gOptions->listProcesses; i++) {
+        size_t mark = HIAHControlWriterBeginMessage(writer, HIAHControlFieldProcess);
+        HIAHControlWriterAddInt(writer, HIAHControlFieldPid, 1000 + i);
+        HIAHControlWriterAddString(writer, HIAHControlFieldPath, "/var/mobile/bin/bench");
+        HIAHControlWriterAddInt(writer, HIAHControlFieldExited, 0);
+        HIAHControlWriterAddInt(writer, HIAHControlFieldExitCode, 0);
+        HIAHControlWriterEndMessage(writer, mark);
+    }
+}
+
+/**
+ * Walks a binary payload the way the kernel does: every string is looked
+ * at in place.
+ *
+ * @return The number of strings seen, or -1 if malformed
+ */
+static long HIAHProtoDecodeBinary(const uint8_t *payload, size_t length, HIAHControlMessageType *type) {
+    HIAHControlReader reader;
+    if (!HIAHControlReaderInit(&reader, payload, length, type)) {
+        return -1;
+    }
+    long strings = 0;
+    HIAHControlField field;
+    int result;
+    while ((result = HIAHControlReaderNext(&reader, &field)) == 1) {
+        if (field.kind == HIAHControlKindString) {
+            HIAHControlFieldString(&field, NULL);
+            strings++;
+        } else if (field.kind == HIAHControlKindStringArray) {
+            HIAHControlStringIterator iterator;
+            HIAHControlFieldStrings(&field, &iterator);
+            while (HIAHControlStringIteratorNext(&iterator, NULL)) {
+                strings++;
+            }
+        } else if (field.kind == HIAHControlKindMessage) {
+            HIAHControlReader nested;
+            HIAHControlField inner;
+            HIAHControlReaderInitMessage(&nested, &field);
+            while (HIAHControlReaderNext(&nested, &inner) == 1) {
+                strings += inner.kind == HIAHControlKindString;
+            }
+        }
+    }
+    return result == 0 ? strings : -1;
+}
+
+// MARK: - Server
+
+static void HIAHProtoHandle(HIAHControlServer *server, HIAHControlRequest request,
+                            const uint8_t *message, size_t length, void *context) {
+    _Atomic int *nextPid = context;
+    if (request.protocolVersion > 0) {
+        HIAHControlMessageType type = 0;
+        bool list = HIAHProtoDecodeBinary(message, length, &type) >= 0 && type == HIAHControlMessageList;
+        HIAHControlWriter writer;
+        HIAHProtoEncodeReplyBinary(&writer, list, atomic_fetch_add(nextPid, 1));
+        HIAHControlServerReply(server, request, writer.data, writer.failed ? 0 : writer.length);
+        HIAHControlWriterFree(&writer);
+        return;
+    }
+
+    static const char listRequest[] = "{\"command\":\"list\"}";
+    bool list = HIAHProtoJSONParse(message, length, NULL) && length == sizeof(listRequest) - 1 &&
+                memcmp(message, listRequest, length) == 0;
+    HIAHProtoBuffer reply = {0};
+    HIAHProtoEncodeReplyJSON(&reply, list, atomic_fetch_add(nextPid, 1));
+    HIAHControlServerReply(server, request, reply.data, reply.failed ? 0 : reply.length);
+    free(reply.data);
+}
+
+// MARK: - Clients
+
+static int HIAHProtoConnectJSON(const char *path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+static bool HIAHProtoSendLine(int fd, const HIAHProtoBuffer *line) {
+    struct iovec parts[2] = {{line->data, line->length}, {"\n", 1}};
+    struct msghdr message = {.msg_iov = parts, .msg_iovlen = 2};
+    size_t total = line->length + 1;
+    while (total > 0) {
+        ssize_t n = sendmsg(fd, &message, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        total -= (size_t)n;
+        while (n > 0 && message.msg_iovlen > 0) {
+            size_t step = (size_t)n < message.msg_iov->iov_len ? (size_t)n : message.msg_iov->iov_len;
+            message.msg_iov->iov_base = (char *)message.msg_iov->iov_base + step;
+            message.msg_iov->iov_len -= step;
+            n -= (ssize_t)step;
+            if (message.msg_iov->iov_len == 0) {
+                message.msg_iov++;
+                message.msg_iovlen--;
+            }
+        }
+    }
+    return true;
+}
+
+static void *HIAHProtoClientMain(void *context) {
+    HIAHProtoClient *client = context;
+    const HIAHProtoOptions *options = client->options;
+    bool binary = client->encoding == HIAHProtoEncodingBinary;
+
+    uint8_t version = 0;
+    int fd = binary ? HIAHControlConnect(options->socketPath, &version)
+                    : HIAHProtoConnectJSON(options->socketPath);
+    if (fd < 0 || (binary && version == 0)) {
+        client->failures = (uint64_t)client->requests;
+        if (fd >= 0) close(fd);
+        return NULL;
+    }
+
+    HIAHProtoBuffer line = {0};
+    uint8_t *reply = NULL;
+    size_t replyCapacity = 0;
+    for (int i = 0; i < client->requests; i++) {
+        bool list = options->listEvery > 0 && (i + 1) % options->listEvery == 0;
+        uint64_t start = HIAHProtoNow();
+        bool ok;
+        size_t replyLength = 0;
+
+        // Encoding is part of the cost the guest pays, so it is timed too
+        if (binary) {
+            HIAHControlWriter writer;
+            if (list) {
+                HIAHControlWriterInit(&writer, HIAHControlMessageList);
+            } else {
+                HIAHProtoEncodeSpawnBinary(&writer);
+            }
+            ok = !writer.failed && HIAHControlSendFrame(fd, writer.data, writer.length) &&
+                 HIAHControlReceiveFrame(fd, &reply, &replyCapacity, &replyLength) &&
+                 HIAHProtoDecodeBinary(reply, replyLength, NULL) >= 0;
+            HIAHControlWriterFree(&writer);
+        } else {
+            if (list) {
+                line.length = 0;
+                HIAHProtoAppendText(&line, "{\"command\":\"list\"}");
+            } else {
+                HIAHProtoEncodeSpawnJSON(&line);
+            }
+            ok = !line.failed && HIAHProtoSendLine(fd, &line) &&
+                 HIAHControlReceiveLine(fd, &reply, &replyCapacity, &replyLength) &&
+                 HIAHProtoJSONParse(reply, replyLength, NULL);
+        }
+
+        uint64_t elapsed = HIAHProtoNow() - start;
+        if (!ok) {
+            client->failures += (uint64_t)(client->requests - i);
+            break;
+        }
+        if (list) {
+            client->listLatency[client->listCount++] = elapsed;
+        } else {
+            client->spawnLatency[client->spawnCount++] = elapsed;
+        }
+    }
+
+    free(line.data);
+    free(reply);
+    close(fd);
+    return NULL;
+}
+
+// MARK: - Reporting
+
+static int HIAHProtoCompare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static double HIAHProtoPercentile(const uint64_t *sorted, size_t count, double percentile) {
+    if (count == 0) {
+        return 0;
+    }
+    size_t index = (size_t)(percentile / 100.0 * (double)(count - 1) + 0.5);
+    return (double)sorted[index] / 1000.0;
+}
+
+static void HIAHProtoPrintLatency(const char *label, uint64_t *samples, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    qsort(samples, count, sizeof(*samples), HIAHProtoCompare);
+    printf("  %-6s %7zu  p50 %8.1f us  p99 %8.1f us  max %8.1f us\n", label, count,
+           HIAHProtoPercentile(samples, count, 50), HIAHProtoPercentile(samples, count, 99),
+           HIAHProtoPercentile(samples, count, 100));
+}
+
+/**
+ * Times encoding and decoding alone, `iterations` spawn requests each way.
+ */
+static void HIAHProtoRunCodec(int iterations) {
+    HIAHProtoBuffer line = {0};
+    uint64_t start = HIAHProtoNow();
+    size_t jsonBytes = 0;
+    for (int i = 0; i < iterations; i++) {
+        HIAHProtoEncodeSpawnJSON(&line);
+        jsonBytes = line.length + 1;
+        HIAHProtoJSONParse(line.data, line.length, NULL);
+    }
+    double json = (double)(HIAHProtoNow() - start) / 1e9;
+    free(line.data);
+
+    start = HIAHProtoNow();
+    size_t binaryBytes = 0;
+    for (int i = 0; i < iterations; i++) {
+        HIAHControlWriter writer;
+        HIAHProtoEncodeSpawnBinary(&writer);
+        binaryBytes = writer.length + HIAH_CONTROL_FRAME_HEADER;
+        HIAHProtoDecodeBinary(writer.data, writer.length, NULL);
+        HIAHControlWriterFree(&writer);
+    }
+    double binary = (double)(HIAHProtoNow() - start) / 1e9;
+
+    printf("codec    spawn request, encode + decode, no socket\n");
+    printf("  binary %10.0f per s  %6zu B framed\n", (double)iterations / binary, binaryBytes);
+    printf("  json   %10.0f per s  %6zu B with newline\n", (double)iterations / json, jsonBytes);
+}
+
+static bool HIAHProtoRun(const HIAHProtoOptions *options, HIAHProtoEncoding encoding) {
+    _Atomic int nextPid = 1000;
+    HIAHControlServerConfig config = {0};
+    int error = 0;
+    HIAHControlServer *server = HIAHControlServerCreate(options->socketPath, &config, HIAHProtoHandle,
+                                                        &nextPid, &error);
+    if (!server || !HIAHControlServerStart(server)) {
+        fprintf(stderr, "[HIAHProtocolBench] cannot serve %s: %s\n", options->socketPath, strerror(error));
+        HIAHControlServerDestroy(server);
+        return false;
+    }
+
+    HIAHProtoClient *clients = calloc((size_t)options->clients, sizeof(*clients));
+    pthread_t *threads = calloc((size_t)options->clients, sizeof(*threads));
+    for (int i = 0; i < options->clients; i++) {
+        clients[i].options = options;
+        clients[i].encoding = encoding;
+        clients[i].requests = options->requests / options->clients +
+                              (i < options->requests % options->clients ? 1 : 0);
+        clients[i].spawnLatency = calloc((size_t)clients[i].requests + 1, sizeof(uint64_t));
+        clients[i].listLatency = calloc((size_t)clients[i].requests + 1, sizeof(uint64_t));
+    }
+
+    uint64_t start = HIAHProtoNow();
+    for (int i = 0; i < options->clients; i++) {
+        pthread_create(&threads[i], NULL, HIAHProtoClientMain, &clients[i]);
+    }
+    for (int i = 0; i < options->clients; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = (double)(HIAHProtoNow() - start) / 1e9;
+
+    uint64_t failures = 0;
+    size_t spawns = 0, lists = 0;
+    for (int i = 0; i < options->clients; i++) {
+        failures += clients[i].failures;
+        spawns += clients[i].spawnCount;
+        lists += clients[i].listCount;
+    }
+    uint64_t *spawnLatency = calloc(spawns + 1, sizeof(uint64_t));
+    uint64_t *listLatency = calloc(lists + 1, sizeof(uint64_t));
+    size_t s = 0, l = 0;
+    for (int i = 0; i < options->clients; i++) {
+        memcpy(spawnLatency + s, clients[i].spawnLatency, clients[i].spawnCount * sizeof(uint64_t));
+        memcpy(listLatency + l, clients[i].listLatency, clients[i].listCount * sizeof(uint64_t));
+        s += clients[i].spawnCount;
+        l += clients[i].listCount;
+        free(clients[i].spawnLatency);
+        free(clients[i].listLatency);
+    }
+
+    HIAHControlServerStats stats;
+    HIAHControlServerGetStats(server, &stats);
+    HIAHControlServerDestroy(server);
+
+    size_t answered = spawns + lists;
+    printf("%-8s %zu requests, %llu failed in %.3f s: %.0f requests/s\n", kEncodingNames[encoding],
+           answered, (unsigned long long)failures, elapsed, (double)answered / elapsed);
+    if (answered > 0) {
+        printf("  wire   %.0f B in, %.0f B out per request (incl. framing)\n",
+               (double)stats.bytesIn / (double)answered, (double)stats.bytesOut / (double)answered);
+    }
+    HIAHProtoPrintLatency("spawn", spawnLatency, spawns);
+    HIAHProtoPrintLatency("list", listLatency, lists);
+
+    free(spawnLatency);
+    free(listLatency);
+    free(clients);
+    free(threads);
+    return failures == 0;
+}
+
+// MARK: - Main
+
+static char **HIAHProtoMakeStrings(int count, int size, const char *format) {
+    char **strings = calloc((size_t)count + 1, sizeof(char *));
+    for (int i = 0; strings && i < count; i++) {
+        strings[i] = malloc((size_t)size + 32);
+        if (!strings[i]) {
+            return NULL;
+        }
+        int prefix = snprintf(strings[i], 32, format, i);
+        memset(strings[i] + prefix, 'v', (size_t)size);
+        strings[i][prefix + size] = '\0';
+    }
+    return strings;
+}
+
+static void HIAHProtoUsage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -c N     concurrent clients, one connection each (default 4)\n"
+            "  -n N     requests per encoding (default 20000)\n"
+            "  -a N     arguments per spawn (default 4)\n"
+            "  -A N     bytes per argument (default 32)\n"
+            "  -e N     environment entries per spawn (default 32)\n"
+            "  -E N     bytes per environment value (default 64)\n"
+            "  -l N     every Nth request is a list, 0 = never (default 16)\n"
+            "  -p N     processes in each list reply (default 64)\n"
+            "  -s PATH  control socket path (default /tmp/hiah-protocol-bench.<pid>.sock)\n",
+            program);
+}
+
+static int HIAHProtoParseCount(const char *value, int minimum) {
+    char *end;
+    long parsed = strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || parsed < minimum || parsed > INT_MAX) {
+        return -1;
+    }
+    return (int)parsed;
+}
+
+int main(int argc, char **argv) {
+    HIAHProtoOptions options = {
+        .clients = 4, .requests = 20000,
+        .argumentCount = 4, .argumentSize = 32,
+        .environmentCount = 32, .environmentSize = 64,
+        .listEvery = 16, .listProcesses = 64,
+    };
+    snprintf(options.socketPath, sizeof(options.socketPath),
+             "/tmp/hiah-protocol-bench.%d.sock", (int)getpid());
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:n:a:A:e:E:l:p:s:h")) != -1) {
+        int *target = NULL;
+        int minimum = 0;
+        switch (opt) {
+        case 'c': target = &options.clients; minimum = 1; break;
+        case 'n': target = &options.requests; minimum = 1; break;
+        case 'a': target = &options.argumentCount; break;
+        case 'A': target = &options.argumentSize; break;
+        case 'e': target = &options.environmentCount; break;
+        case 'E': target = &options.environmentSize; break;
+        case 'l': target = &options.listEvery; break;
+        case 'p': target = &options.listProcesses; break;
+        case 's':
+            if (strlen(optarg) >= sizeof(options.socketPath)) {
+                fprintf(stderr, "[HIAHProtocolBench] socket path too long\n");
+                return 2;
+            }
+            snprintf(options.socketPath, sizeof(options.socketPath), "%s", optarg);
+            continue;
+        default:
+            HIAHProtoUsage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+        if ((*target = HIAHProtoParseCount(optarg, minimum)) < 0) {
+            fprintf(stderr, "[HIAHProtocolBench] invalid value for -%c: %s\n", opt, optarg);
+            return 2;
+        }
+    }
+    if (optind != argc) {
+        HIAHProtoUsage(argv[0]);
+        return 2;
+    }
+    if (options.clients > options.requests) {
+        options.clients = options.requests;
+    }
+
+    gOptions = &options;
+    gArguments = HIAHProtoMakeStrings(options.argumentCount, options.argumentSize, "arg%d-");
+    gEnvironment = HIAHProtoMakeStrings(options.environmentCount, options.environmentSize, "HIAH_VAR_%d=");
+    if (!gArguments || !gEnvironment) {
+        fprintf(stderr, "[HIAHProtocolBench] %s\n", strerror(ENOMEM));
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("HIAHKernel protocol bench: %d requests per encoding, %d clients, %d args x %d B, "
+           "%d env x %d B, list every %d with %d processes\n",
+           options.requests, options.clients, options.argumentCount, options.argumentSize,
+           options.environmentCount, options.environmentSize, options.listEvery, options.listProcesses);
+    HIAHProtoRunCodec(options.requests);
+    bool ok = HIAHProtoRun(&options, HIAHProtoEncodingBinary);
+    ok = HIAHProtoRun(&options, HIAHProtoEncodingJSON) && ok;
+    return ok ? 0 : 1;
+}
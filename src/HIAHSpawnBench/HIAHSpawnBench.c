@@ -0,0 +1,1428 @@
+/**
+ * HIAHSpawnBench.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Spawn-storm load generator for the kernel control socket.
+ *
+ * Forks a stand-in kernel that serves the control socket with the real
+ * HIAHControlServer and protocol code, then drives it from concurrent
+ * clients sending `spawn` and `list` requests. The stand-in answers a spawn
+ * the way the kernel does: it starts a process runner (this binary in
+ * `--runner` mode), which dlopens the requested guest image and calls its
+ * entry point, and replies with the runner's pid.
+ *
+ * Clients either keep one blocking connection each (`-m client`), connect
+ * per request like the original guest hook (`-m connect`), or share one
+ * multiplexed HIAHControlChannel across all threads like the guest hook
+ * does now (`-m channel`).
+ *
+ * Reports spawn and list throughput, latency histograms, the time from
+ * spawn to guest exit, and the stand-in kernel's peak memory.
+ *
+ * Plain C, builds on Linux and macOS.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include "HIAHControlChannel.h"
+#include "HIAHControlEnvironment.h"
+#include "HIAHControlProtocol.h"
+#include "HIAHControlServer.h"
+#include <dlfcn.h>
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <mach-o/dyld.h>
+#endif
+
+extern char **environ;
+
+#define HIAH_BENCH_ENTRY            "hiah_bench_main"
+#define HIAH_BENCH_EXITED_RETAIN    256   // Exited processes kept for list replies
+#define HIAH_BENCH_SUB_BUCKETS      8     // Linear buckets per power of two
+#define HIAH_BENCH_BUCKETS          (16 + 40 * HIAH_BENCH_SUB_BUCKETS)
+
+typedef enum {
+    HIAHBenchModeClient,     // One blocking connection per client
+    HIAHBenchModeConnect,    // One connection per request
+    HIAHBenchModeChannel,    // One shared multiplexed channel
+} HIAHBenchMode;
+
+typedef struct {
+    HIAHBenchMode mode;
+    HIAHControlChannel *channel;   // HIAHBenchModeChannel
+    int clients;
+    int spawns;
+    int argumentCount;
+    int argumentSize;
+    int environmentCount;
+    int environmentSize;
+    int listEvery;
+    int workers;
+    int runTime;             // Guest run time (us)
+    bool environmentDeltas;  // Send environments relative to a registered base
+    char socketPath[104];
+    char guestPath[PATH_MAX];
+    char runnerPath[PATH_MAX];
+} HIAHBenchOptions;
+
+// MARK: - Histogram
+
+/**
+ * Log-linear latency histogram in microseconds: exact below 16 us, then
+ * HIAH_BENCH_SUB_BUCKETS linear buckets per power of two (< 12.5% error).
+ */
+typedef struct {
+    uint64_t counts[HIAH_BENCH_BUCKETS];
+    uint64_t count;
+    uint64_t sum;     // ns
+    uint64_t min;     // ns
+    uint64_t max;     // ns
+} HIAHBenchHistogram;
+
+static uint64_t HIAHBenchNow(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int HIAHBenchBucket(uint64_t us) {
+    if (us < 16) {
+        return (int)us;
+    }
+    int exponent = 63 - __builtin_clzll(us);   // >= 4
+    int sub = (int)((us >> (exponent - 3)) & (HIAH_BENCH_SUB_BUCKETS - 1));
+    int bucket = 16 + (exponent - 4) * HIAH_BENCH_SUB_BUCKETS + sub;
+    return bucket < HIAH_BENCH_BUCKETS ? bucket : HIAH_BENCH_BUCKETS - 1;
+}
+
+// Upper bound of a bucket, in microseconds
+static uint64_t HIAHBenchBucketLimit(int bucket) {
+    if (bucket < 16) {
+        return (uint64_t)bucket + 1;
+    }
+    int exponent = (bucket - 16) / HIAH_BENCH_SUB_BUCKETS + 4;
+    uint64_t sub = (uint64_t)((bucket - 16) % HIAH_BENCH_SUB_BUCKETS);
+    return (1ull << exponent) + ((sub + 1) << (exponent - 3));
+}
+
+static void HIAHBenchRecord(HIAHBenchHistogram *histogram, uint64_t ns) {
+    histogram->counts[HIAHBenchBucket(ns / 1000)]++;
+    if (histogram->count == 0 || ns < histogram->min) {
+        histogram->min = ns;
+    }
+    if (ns > histogram->max) {
+        histogram->max = ns;
+    }
+    histogram->count++;
+    histogram->sum += ns;
+}
+
+static void HIAHBenchMerge(HIAHBenchHistogram *into, const HIAHBenchHistogram *from) {
+    if (from->count == 0) {
+        return;
+    }
+    for (int i = 0; i < HIAH_BENCH_BUCKETS; i++) {
+        into->counts[i] += from->counts[i];
+    }
+    if (into->count == 0 || from->min < into->min) {
+        into->min = from->min;
+    }
+    if (from->max > into->max) {
+        into->max = from->max;
+    }
+    into->count += from->count;
+    into->sum += from->sum;
+}
+
+// Percentile in ms, clamped to the observed maximum
+static double HIAHBenchPercentile(const HIAHBenchHistogram *histogram, double percentile) {
+    if (histogram->count == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)((double)histogram->count * percentile / 100.0 + 0.5);
+    if (rank == 0) {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < HIAH_BENCH_BUCKETS; i++) {
+        seen += histogram->counts[i];
+        if (seen >= rank) {
+            double limit = (double)HIAHBenchBucketLimit(i) / 1e3;
+            double max = (double)histogram->max / 1e6;
+            return limit < max ? limit : max;
+        }
+    }
+    return (double)histogram->max / 1e6;
+}
+
+static void HIAHBenchPrintLatency(const char *label, const HIAHBenchHistogram *histogram) {
+    if (histogram->count == 0) {
+        return;
+    }
+    printf("  %-8s min %.3f  p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f  mean %.3f ms\n",
+           label, (double)histogram->min / 1e6,
+           HIAHBenchPercentile(histogram, 50), HIAHBenchPercentile(histogram, 90),
+           HIAHBenchPercentile(histogram, 99), HIAHBenchPercentile(histogram, 99.9),
+           (double)histogram->max / 1e6,
+           (double)histogram->sum / (double)histogram->count / 1e6);
+}
+
+// One row per power of two, so the shape fits on a screen
+static void HIAHBenchPrintHistogram(const HIAHBenchHistogram *histogram) {
+    uint64_t rows[64] = {0};
+    int first = 64, last = -1;
+    for (int i = 0; i < HIAH_BENCH_BUCKETS; i++) {
+        if (histogram->counts[i] == 0) {
+            continue;
+        }
+        uint64_t low = HIAHBenchBucketLimit(i) - 1;
+        int row = low == 0 ? 0 : 64 - __builtin_clzll(low);
+        rows[row] += histogram->counts[i];
+        first = row < first ? row : first;
+        last = row > last ? row : last;
+    }
+    uint64_t peak = 0;
+    for (int row = first; row <= last; row++) {
+        peak = rows[row] > peak ? rows[row] : peak;
+    }
+    for (int row = first; row <= last; row++) {
+        uint64_t low = row == 0 ? 0 : 1ull << (row - 1);
+        uint64_t high = 1ull << row;
+        int width = peak ? (int)(rows[row] * 40 / peak) : 0;
+        printf("    %8llu - %8llu us %8llu %5.1f%% %.*s\n",
+               (unsigned long long)low, (unsigned long long)high,
+               (unsigned long long)rows[row],
+               100.0 * (double)rows[row] / (double)histogram->count,
+               width, "########################################");
+    }
+}
+
+// MARK: - Pipes
+
+static bool HIAHBenchWriteAll(int fd, const void *data, size_t length) {
+    const uint8_t *cursor = data;
+    while (length > 0) {
+        ssize_t n = write(fd, cursor, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        cursor += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool HIAHBenchReadAll(int fd, void *data, size_t length) {
+    uint8_t *cursor = data;
+    while (length > 0) {
+        ssize_t n = read(fd, cursor, length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        cursor += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+// Peak resident set of this process or its reaped children, in bytes
+static uint64_t HIAHBenchPeakRSS(int who) {
+    struct rusage usage;
+    if (getrusage(who, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return (uint64_t)usage.ru_maxrss;
+#else
+    return (uint64_t)usage.ru_maxrss * 1024;
+#endif
+}
+
+// MARK: - Process Runner
+
+/**
+ * Stand-in for the process runner: loads the guest image and calls its
+ * entry point with the remaining arguments as argv.
+ */
+static int HIAHBenchRunnerMain(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "[HIAHSpawnBench] runner: missing guest path\n");
+        return 127;
+    }
+    void *handle = dlopen(argv[2], RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        fprintf(stderr, "[HIAHSpawnBench] runner: %s\n", dlerror());
+        return 127;
+    }
+    int (*entry)(int, char **) = (int (*)(int, char **))dlsym(handle, HIAH_BENCH_ENTRY);
+    if (!entry) {
+        entry = (int (*)(int, char **))dlsym(handle, "main");
+    }
+    if (!entry) {
+        fprintf(stderr, "[HIAHSpawnBench] runner: %s has no entry point\n", argv[2]);
+        return 127;
+    }
+    return entry(argc - 2, argv + 2);
+}
+
+// MARK: - Stand-in Kernel
+
+typedef struct HIAHBenchJob {
+    struct HIAHBenchJob *next;
+    HIAHControlRequest request;
+    size_t length;
+    uint8_t message[];
+} HIAHBenchJob;
+
+typedef struct {
+    pid_t pid;
+    char *path;
+    uint64_t started;
+    bool exited;
+    int exitCode;
+} HIAHBenchProcess;
+
+typedef struct {
+    pid_t pid;
+    int exitCode;
+} HIAHBenchOrphan;
+
+typedef struct {
+    uint64_t spawned;
+    uint64_t spawnFailures;
+    uint64_t exited;
+    uint64_t nonzeroExits;
+    uint64_t lists;
+    uint64_t peakProcesses;
+    uint64_t peakRSS;          // Stand-in kernel
+    uint64_t runnerPeakRSS;    // Largest runner
+    HIAHControlServerStats server;
+    HIAHControlEnvironmentStats environments;
+    HIAHBenchHistogram run;    // Spawn request to guest exit
+} HIAHBenchKernelReport;
+
+typedef struct {
+    HIAHControlServer *server;
+    HIAHControlEnvironmentStore *environments;
+    const HIAHBenchOptions *options;
+    pthread_mutex_t lock;
+    pthread_cond_t jobsReady;
+    pthread_cond_t childrenChanged;
+    HIAHBenchJob *head;
+    HIAHBenchJob *tail;
+    bool stopping;
+
+    HIAHBenchProcess *processes;
+    size_t processCount;
+    size_t processCapacity;
+    size_t retainedExited;
+    HIAHBenchOrphan *orphans;      // Reaped before they were registered
+    size_t orphanCount;
+    size_t orphanCapacity;
+    uint64_t outstanding;          // Started (or starting) and not yet reaped
+
+    HIAHBenchKernelReport report;
+} HIAHBenchKernel;
+
+// Echoes the request ID, sends and frees the reply
+static void HIAHBenchReply(HIAHBenchKernel *kernel, HIAHControlRequest request,
+                           HIAHControlWriter *writer) {
+    if (request.requestID) {
+        HIAHControlWriterAddInt(writer, HIAHControlFieldRequestID, (int64_t)request.requestID);
+    }
+    if (!writer->failed) {
+        HIAHControlServerReply(kernel->server, request, writer->data, writer->length);
+    }
+    HIAHControlWriterFree(writer);
+}
+
+static void HIAHBenchReplyStatus(HIAHBenchKernel *kernel, HIAHControlRequest request,
+                                 HIAHControlStatus status, const char *error) {
+    HIAHControlWriter writer;
+    HIAHControlWriterInit(&writer, HIAHControlMessageReply);
+    HIAHControlWriterAddInt(&writer, HIAHControlFieldStatus, status);
+    HIAHControlWriterAddString(&writer, HIAHControlFieldError, error);
+    HIAHBenchReply(kernel, request, &writer);
+}
+
+static void HIAHBenchReplyError(HIAHBenchKernel *kernel, HIAHControlRequest request,
+                                const char *error) {
+    HIAHBenchReplyStatus(kernel, request, HIAHControlStatusError, error);
+}
+
+// Caller holds the lock
+static void HIAHBenchRemoveProcess(HIAHBenchKernel *kernel, size_t index) {
+    free(kernel->processes[index].path);
+    kernel->processes[index] = kernel->processes[--kernel->processCount];
+}
+
+// Caller holds the lock
+static void HIAHBenchMarkExited(HIAHBenchKernel *kernel, size_t index, int exitCode) {
+    HIAHBenchProcess *process = &kernel->processes[index];
+    HIAHBenchRecord(&kernel->report.run, HIAHBenchNow() - process->started);
+    kernel->report.exited++;
+    if (exitCode != 0) {
+        kernel->report.nonzeroExits++;
+    }
+    if (kernel->retainedExited >= HIAH_BENCH_EXITED_RETAIN) {
+        HIAHBenchRemoveProcess(kernel, index);
+        return;
+    }
+    process->exited = true;
+    process->exitCode = exitCode;
+    kernel->retainedExited++;
+}
+
+static void HIAHBenchSpawn(HIAHBenchKernel *kernel, HIAHBenchJob *job) {
+    HIAHControlReader reader;
+    HIAHControlField field;
+    HIAHControlField arguments = {0};
+    HIAHControlField environment = {0};
+    HIAHControlField removed = {0};
+    uint64_t environmentHandle = 0;
+    const char *path = NULL;
+    int status;
+
+    HIAHControlReaderInit(&reader, job->message, job->length, NULL);
+    while ((status = HIAHControlReaderNext(&reader, &field)) == 1) {
+        if (field.tag == HIAHControlFieldPath) {
+            path = HIAHControlFieldString(&field, NULL);
+        } else if (field.tag == HIAHControlFieldArguments) {
+            arguments = field;
+        } else if (field.tag == HIAHControlFieldEnvironment) {
+            environment = field;
+        } else if (field.tag == HIAHControlFieldEnvRemoved) {
+            removed = field;
+        } else if (field.tag == HIAHControlFieldEnvHandle) {
+            environmentHandle = (uint64_t)HIAHControlFieldInt(&field);
+        }
+    }
+    if (status != 0 || !path) {
+        HIAHBenchReplyError(kernel, job->request, "Malformed request");
+        return;
+    }
+    if (access(path, R_OK) != 0) {
+        HIAHBenchReplyError(kernel, job->request, strerror(errno));
+        return;
+    }
+
+    // argv points straight into the request. The environment takes the
+    // kernel's path: a delta is applied to its base, a full one is copied
+    // out of the frame, and either is packed again at launch with the
+    // kernel's own entries.
+    uint32_t argc = arguments.tag ? HIAHControlFieldStringCount(&arguments) : 0;
+    char **argv = malloc(sizeof(char *) * (argc + 4));
+    char **received = NULL;
+    if (environmentHandle) {
+        size_t changeCount = 0, removedCount = 0;
+        const char **changes = environment.tag ? HIAHControlFieldCopyStrings(&environment, &changeCount)
+                                               : NULL;
+        const char **removedKeys = removed.tag ? HIAHControlFieldCopyStrings(&removed, &removedCount)
+                                               : NULL;
+        bool unknown = false;
+        received = HIAHControlEnvironmentStoreBuild(kernel->environments, environmentHandle,
+                                                    changes, changeCount, removedKeys, removedCount,
+                                                    &unknown);
+        free(changes);
+        free(removedKeys);
+        if (unknown) {
+            free(argv);
+            HIAHBenchReplyStatus(kernel, job->request, HIAHControlStatusUnknownEnvironment,
+                                 "Unknown environment handle");
+            return;
+        }
+    } else {
+        size_t envCount = 0;
+        const char **entries = environment.tag ? HIAHControlFieldCopyStrings(&environment, &envCount)
+                                               : NULL;
+        received = HIAHControlEnvironmentPack(entries, envCount, NULL);
+        free(entries);
+    }
+    char **envp = NULL;
+    if (received) {
+        char socketEntry[sizeof(kernel->options->socketPath) + 32];
+        snprintf(socketEntry, sizeof(socketEntry), "HIAH_KERNEL_SOCKET=%s",
+                 kernel->options->socketPath);
+        const char *extra[] = {"HIAH_STDOUT_FD=1", "HIAH_STDERR_FD=2", socketEntry, NULL};
+        envp = HIAHControlEnvironmentPackReplacing((const char *const *)received, SIZE_MAX, extra);
+        free(received);
+    }
+    if (!argv || !envp) {
+        free(argv);
+        free(envp);
+        HIAHBenchReplyError(kernel, job->request, strerror(ENOMEM));
+        return;
+    }
+    HIAHControlStringIterator it;
+    size_t n = 0;
+    argv[n++] = (char *)kernel->options->runnerPath;
+    argv[n++] = "--runner";
+    argv[n++] = (char *)path;
+    if (argc > 0) {
+        HIAHControlFieldStrings(&arguments, &it);
+        const char *arg;
+        while ((arg = HIAHControlStringIteratorNext(&it, NULL))) {
+            argv[n++] = (char *)arg;
+        }
+    }
+    argv[n] = NULL;
+
+    uint64_t started = HIAHBenchNow();
+    pthread_mutex_lock(&kernel->lock);
+    kernel->outstanding++;
+    pthread_cond_signal(&kernel->childrenChanged);
+    pthread_mutex_unlock(&kernel->lock);
+
+    pid_t pid;
+    int error = posix_spawn(&pid, kernel->options->runnerPath, NULL, NULL, argv, envp);
+    free(argv);
+    free(envp);
+
+    char *pathCopy = error == 0 ? strdup(path) : NULL;
+    pthread_mutex_lock(&kernel->lock);
+    if (error != 0) {
+        kernel->outstanding--;
+        kernel->report.spawnFailures++;
+        pthread_mutex_unlock(&kernel->lock);
+        HIAHBenchReplyError(kernel, job->request, strerror(error));
+        return;
+    }
+    kernel->report.spawned++;
+    if (kernel->processCount == kernel->processCapacity) {
+        size_t capacity = kernel->processCapacity ? kernel->processCapacity * 2 : 64;
+        HIAHBenchProcess *grown = realloc(kernel->processes, capacity * sizeof(*grown));
+        if (grown) {
+            kernel->processes = grown;
+            kernel->processCapacity = capacity;
+        }
+    }
+    if (kernel->processCount < kernel->processCapacity) {
+        size_t index = kernel->processCount++;
+        kernel->processes[index] = (HIAHBenchProcess){
+            .pid = pid, .path = pathCopy, .started = started,
+        };
+        pathCopy = NULL;
+        if (kernel->processCount > kernel->report.peakProcesses) {
+            kernel->report.peakProcesses = kernel->processCount;
+        }
+        for (size_t i = 0; i < kernel->orphanCount; i++) {
+            if (kernel->orphans[i].pid == pid) {
+                int exitCode = kernel->orphans[i].exitCode;
+                kernel->orphans[i] = kernel->orphans[--kernel->orphanCount];
+                HIAHBenchMarkExited(kernel, index, exitCode);
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&kernel->lock);
+    free(pathCopy);
+
+    HIAHControlWriter writer;
+    HIAHControlWriterInit(&writer, HIAHControlMessageReply);
+    HIAHControlWriterAddInt(&writer, HIAHControlFieldStatus, 0);
+    HIAHControlWriterAddInt(&writer, HIAHControlFieldPid, pid);
+    HIAHBenchReply(kernel, job->request, &writer);
+}
+
+// Exited processes are reported by one list reply, then dropped
+static void HIAHBenchList(HIAHBenchKernel *kernel, HIAHControlRequest request) {
+    HIAHControlWriter writer;
+    HIAHControlWriterInit(&writer, HIAHControlMessageReply);
+    HIAHControlWriterAddInt(&writer, HIAHControlFieldStatus, 0);
+
+    pthread_mutex_lock(&kernel->lock);
+    kernel->report.lists++;
+    for (size_t i = 0; i < kernel->processCount;) {
+        HIAHBenchProcess *process = &kernel->processes[i];
+        size_t mark = HIAHControlWriterBeginMessage(&writer, HIAHControlFieldProcess);
+        HIAHControlWriterAddInt(&writer, HIAHControlFieldPid, process->pid);
+        HIAHControlWriterAddString(&writer, HIAHControlFieldPath, process->path);
+        HIAHControlWriterAddInt(&writer, HIAHControlFieldExited, process->exited);
+        HIAHControlWriterAddInt(&writer, HIAHControlFieldExitCode, process->exitCode);
+        HIAHControlWriterEndMessage(&writer, mark);
+        if (process->exited) {
+            HIAHBenchRemoveProcess(kernel, i);
+            kernel->retainedExited--;
+        } else {
+            i++;
+        }
+    }
+    pthread_mutex_unlock(&kernel->lock);
+
+    HIAHBenchReply(kernel, request, &writer);
+}
+
+static void HIAHBenchRegisterEnvironment(HIAHBenchKernel *kernel, HIAHControlRequest request,
+                                         HIAHControlReader *reader) {
+    HIAHControlField field;
+    uint64_t handle = 0;
+    while (HIAHControlReaderNext(reader, &field) == 1) {
+        if (field.tag == HIAHControlFieldEnvironment) {
+            size_t count = 0;
+            const char **entries = HIAHControlFieldCopyStrings(&field, &count);
+            handle = entries ? HIAHControlEnvironmentStoreRegister(kernel->environments,
+                                                                   entries, count) : 0;
+            free(entries);
+        }
+    }
+    if (!handle) {
+        HIAHBenchReplyError(kernel, request, "Cannot register environment");
+        return;
+    }
+    HIAHControlWriter writer;
+    HIAHControlWriterInit(&writer, HIAHControlMessageReply);
+    HIAHControlWriterAddInt(&writer, HIAHControlFieldStatus, 0);
+    HIAHControlWriterAddInt(&writer, HIAHControlFieldEnvHandle, (int64_t)handle);
+    HIAHBenchReply(kernel, request, &writer);
+}
+
+// Reactor thread: lists and environments are answered inline, spawns go to
+// the workers
+static void HIAHBenchHandleMessage(HIAHControlServer *server, HIAHControlRequest request,
+                                   const uint8_t *message, size_t length, void *context) {
+    HIAHBenchKernel *kernel = context;
+    HIAHControlReader reader;
+    HIAHControlMessageType type;
+    (void)server;
+
+    if (request.protocolVersion == 0 ||
+        !HIAHControlReaderInit(&reader, message, length, &type)) {
+        HIAHBenchReplyError(kernel, request, "Malformed request");
+        return;
+    }
+    HIAHControlReader scan = reader;
+    HIAHControlField field;
+    while (HIAHControlReaderNext(&scan, &field) == 1) {
+        if (field.tag == HIAHControlFieldRequestID) {
+            request.requestID = (uint64_t)HIAHControlFieldInt(&field);
+            break;
+        }
+    }
+    if (type == HIAHControlMessageList) {
+        HIAHBenchList(kernel, request);
+        return;
+    }
+    if (type == HIAHControlMessageEnvironment) {
+        HIAHBenchRegisterEnvironment(kernel, request, &reader);
+        return;
+    }
+    if (type != HIAHControlMessageSpawn) {
+        HIAHBenchReplyError(kernel, request, "Unknown command");
+        return;
+    }
+
+    HIAHBenchJob *job = malloc(sizeof(*job) + length);
+    if (!job) {
+        HIAHBenchReplyError(kernel, request, strerror(ENOMEM));
+        return;
+    }
+    job->next = NULL;
+    job->request = request;
+    job->length = length;
+    memcpy(job->message, message, length);
+
+    pthread_mutex_lock(&kernel->lock);
+    if (kernel->tail) {
+        kernel->tail->next = job;
+    } else {
+        kernel->head = job;
+    }
+    kernel->tail = job;
+    pthread_cond_signal(&kernel->jobsReady);
+    pthread_mutex_unlock(&kernel->lock);
+}
+
+static void *HIAHBenchWorker(void *context) {
+    HIAHBenchKernel *kernel = context;
+    for (;;) {
+        pthread_mutex_lock(&kernel->lock);
+        while (!kernel->head && !kernel->stopping) {
+            pthread_cond_wait(&kernel->jobsReady, &kernel->lock);
+        }
+        HIAHBenchJob *job = kernel->head;
+        if (job) {
+            kernel->head = job->next;
+            if (!kernel->head) {
+                kernel->tail = NULL;
+            }
+        }
+        pthread_mutex_unlock(&kernel->lock);
+        if (!job) {
+            return NULL;
+        }
+        HIAHBenchSpawn(kernel, job);
+        free(job);
+    }
+}
+
+static void *HIAHBenchReaper(void *context) {
+    HIAHBenchKernel *kernel = context;
+    for (;;) {
+        pthread_mutex_lock(&kernel->lock);
+        while (kernel->outstanding == 0 && !kernel->stopping) {
+            pthread_cond_wait(&kernel->childrenChanged, &kernel->lock);
+        }
+        bool done = kernel->outstanding == 0;
+        pthread_mutex_unlock(&kernel->lock);
+        if (done) {
+            return NULL;
+        }
+
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            // ECHILD: a worker counted a child that posix_spawn has not forked yet
+            usleep(100);
+            continue;
+        }
+        int exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+        pthread_mutex_lock(&kernel->lock);
+        kernel->outstanding--;
+        bool found = false;
+        for (size_t i = 0; i < kernel->processCount; i++) {
+            if (kernel->processes[i].pid == pid && !kernel->processes[i].exited) {
+                HIAHBenchMarkExited(kernel, i, exitCode);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            if (kernel->orphanCount == kernel->orphanCapacity) {
+                size_t capacity = kernel->orphanCapacity ? kernel->orphanCapacity * 2 : 16;
+                HIAHBenchOrphan *grown = realloc(kernel->orphans, capacity * sizeof(*grown));
+                if (grown) {
+                    kernel->orphans = grown;
+                    kernel->orphanCapacity = capacity;
+                }
+            }
+            if (kernel->orphanCount < kernel->orphanCapacity) {
+                kernel->orphans[kernel->orphanCount++] = (HIAHBenchOrphan){pid, exitCode};
+            }
+        }
+        pthread_mutex_unlock(&kernel->lock);
+    }
+}
+
+/**
+ * Body of the forked stand-in kernel. Writes one byte to `reportFd` once the
+ * socket is listening, serves until `stopFd` reaches EOF, waits for every
+ * runner, then writes its HIAHBenchKernelReport.
+ */
+static int HIAHBenchKernelMain(const HIAHBenchOptions *options, int stopFd, int reportFd) {
+    HIAHBenchKernel kernel = {.options = options};
+    pthread_mutex_init(&kernel.lock, NULL);
+    pthread_cond_init(&kernel.jobsReady, NULL);
+    pthread_cond_init(&kernel.childrenChanged, NULL);
+
+    HIAHControlServerConfig config = {0};
+    int error = 0;
+    kernel.environments = HIAHControlEnvironmentStoreCreate(0);
+    kernel.server = HIAHControlServerCreate(options->socketPath, &config,
+                                            HIAHBenchHandleMessage, &kernel, &error);
+    if (!kernel.environments || !kernel.server || !HIAHControlServerStart(kernel.server)) {
+        fprintf(stderr, "[HIAHSpawnBench] kernel: cannot serve %s: %s\n",
+                options->socketPath, strerror(error ? error : EIO));
+        return 1;
+    }
+
+    pthread_t *workers = calloc((size_t)options->workers, sizeof(pthread_t));
+    pthread_t reaper;
+    for (int i = 0; i < options->workers; i++) {
+        pthread_create(&workers[i], NULL, HIAHBenchWorker, &kernel);
+    }
+    pthread_create(&reaper, NULL, HIAHBenchReaper, &kernel);
+
+    uint8_t ready = 1;
+    HIAHBenchWriteAll(reportFd, &ready, 1);
+    while (read(stopFd, &ready, 1) != 0 && errno == EINTR) {
+    }
+
+    HIAHControlServerGetStats(kernel.server, &kernel.report.server);
+    HIAHControlServerStop(kernel.server);
+    pthread_mutex_lock(&kernel.lock);
+    kernel.stopping = true;
+    pthread_cond_broadcast(&kernel.jobsReady);
+    pthread_mutex_unlock(&kernel.lock);
+    for (int i = 0; i < options->workers; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_mutex_lock(&kernel.lock);
+    pthread_cond_broadcast(&kernel.childrenChanged);
+    pthread_mutex_unlock(&kernel.lock);
+    pthread_join(reaper, NULL);
+
+    kernel.report.peakRSS = HIAHBenchPeakRSS(RUSAGE_SELF);
+    kernel.report.runnerPeakRSS = HIAHBenchPeakRSS(RUSAGE_CHILDREN);
+    HIAHControlEnvironmentStoreGetStats(kernel.environments, &kernel.report.environments);
+    bool sent = HIAHBenchWriteAll(reportFd, &kernel.report, sizeof(kernel.report));
+
+    HIAHControlServerDestroy(kernel.server);
+    HIAHControlEnvironmentStoreDestroy(kernel.environments);
+    for (size_t i = 0; i < kernel.processCount; i++) {
+        free(kernel.processes[i].path);
+    }
+    free(kernel.processes);
+    free(kernel.orphans);
+    free(workers);
+    return sent ? 0 : 1;
+}
+
+// MARK: - Clients
+
+typedef struct {
+    const HIAHBenchOptions *options;
+    int spawns;
+    HIAHBenchHistogram spawnLatency;
+    HIAHBenchHistogram listLatency;
+    uint64_t failures;
+    uint64_t listedProcesses;
+    size_t requestBytes;
+    size_t fullRequestBytes;   // The same spawn with its environment in full
+    char firstError[128];
+} HIAHBenchClient;
+
+static void HIAHBenchFail(HIAHBenchClient *client, const char *error) {
+    if (client->failures++ == 0) {
+        snprintf(client->firstError, sizeof(client->firstError), "%s", error);
+    }
+}
+
+// Fills `count` strings of `size` bytes after a distinct prefix
+static char **HIAHBenchMakeStrings(int count, int size, const char *format) {
+    char **strings = calloc((size_t)count + 1, sizeof(char *));
+    for (int i = 0; strings && i < count; i++) {
+        char prefix[32];
+        int used = snprintf(prefix, sizeof(prefix), format, i);
+        size_t length = (size_t)used + (size_t)size;
+        strings[i] = malloc(length + 1);
+        if (!strings[i]) {
+            continue;
+        }
+        memcpy(strings[i], prefix, (size_t)used);
+        memset(strings[i] + used, 'a' + i % 26, (size_t)size);
+        strings[i][length] = '\0';
+    }
+    return strings;
+}
+
+static void HIAHBenchFreeStrings(char **strings) {
+    for (size_t i = 0; strings && strings[i]; i++) {
+        free(strings[i]);
+    }
+    free(strings);
+}
+
+static int HIAHBenchConnect(HIAHBenchClient *client) {
+    uint8_t version = 0;
+    int fd = HIAHControlConnect(client->options->socketPath, &version);
+    if (fd >= 0 && version == 0) {
+        close(fd);
+        HIAHBenchFail(client, "binary protocol refused");
+        return -1;
+    }
+    if (fd < 0) {
+        HIAHBenchFail(client, "cannot connect");
+    }
+    return fd;
+}
+
+/**
+ * Sends one request and receives its reply the way the client's mode does.
+ * `*fd` is the client's connection in HIAHBenchModeClient.
+ */
+static bool HIAHBenchCall(HIAHBenchClient *client, int *fd, HIAHControlWriter *request,
+                          uint8_t **buffer, size_t *capacity, size_t *length) {
+    const HIAHBenchOptions *options = client->options;
+    switch (options->mode) {
+    case HIAHBenchModeClient:
+        if (HIAHControlSendFrame(*fd, request->data, request->length) &&
+            HIAHControlReceiveFrame(*fd, buffer, capacity, length)) {
+            return true;
+        }
+        HIAHBenchFail(client, "connection lost");
+        return false;
+
+    case HIAHBenchModeConnect: {
+        int connection = HIAHBenchConnect(client);
+        if (connection < 0) {
+            return false;
+        }
+        bool ok = HIAHControlSendFrame(connection, request->data, request->length) &&
+                  HIAHControlReceiveFrame(connection, buffer, capacity, length);
+        close(connection);
+        if (!ok) {
+            HIAHBenchFail(client, "connection lost");
+        }
+        return ok;
+    }
+
+    case HIAHBenchModeChannel: {
+        // The channel appends a RequestID; drop it so the request is reusable
+        size_t mark = request->length;
+        uint8_t *reply;
+        size_t replyLength;
+        HIAHControlChannelResult result = HIAHControlChannelCall(options->channel, request,
+                                                                 &reply, &replyLength);
+        request->length = mark;
+        if (result != HIAHControlChannelOK) {
+            HIAHBenchFail(client, result == HIAHControlChannelUnsupported
+                                      ? "binary protocol refused"
+                                      : result == HIAHControlChannelLost ? "connection lost"
+                                                                         : "cannot connect");
+            return false;
+        }
+        free(*buffer);
+        *buffer = reply;
+        *capacity = *length = replyLength;
+        return true;
+    }
+    }
+    return false;
+}
+
+/**
+ * Registers `base` and rewrites `spawn` to send `envp` relative to it.
+ */
+static bool HIAHBenchUseEnvironmentDelta(HIAHBenchClient *client, int *fd, HIAHControlWriter *spawn,
+                                         const char *const *arguments, const char *const *base,
+                                         const char **envp, uint8_t **buffer, size_t *capacity) {
+    const HIAHBenchOptions *options = client->options;
+    HIAHControlWriter request;
+    HIAHControlWriterInit(&request, HIAHControlMessageEnvironment);
+    HIAHControlWriterAddStringArray(&request, HIAHControlFieldEnvironment, base, SIZE_MAX);
+    size_t length = 0;
+    bool called = !request.failed && HIAHBenchCall(client, fd, &request, buffer, capacity, &length);
+    HIAHControlWriterFree(&request);
+    if (!called) {
+        return false;
+    }
+
+    uint64_t handle = 0;
+    HIAHControlReader reader;
+    HIAHControlField field;
+    if (HIAHControlReaderInit(&reader, *buffer, length, NULL)) {
+        while (HIAHControlReaderNext(&reader, &field) == 1) {
+            if (field.tag == HIAHControlFieldEnvHandle) {
+                handle = (uint64_t)HIAHControlFieldInt(&field);
+            }
+        }
+    }
+    HIAHControlEnvironmentBase *snapshot = HIAHControlEnvironmentBaseCreate(base);
+    HIAHControlEnvironmentDelta delta;
+    if (!handle || !snapshot || !HIAHControlEnvironmentDiff(snapshot, envp, &delta)) {
+        HIAHBenchFail(client, handle ? "environment delta not smaller" : "cannot register environment");
+        HIAHControlEnvironmentBaseFree(snapshot);
+        return false;
+    }
+
+    HIAHControlWriterFree(spawn);
+    HIAHControlWriterInit(spawn, HIAHControlMessageSpawn);
+    HIAHControlWriterAddString(spawn, HIAHControlFieldPath, options->guestPath);
+    HIAHControlWriterAddStringArray(spawn, HIAHControlFieldArguments, arguments, SIZE_MAX);
+    HIAHControlWriterAddInt(spawn, HIAHControlFieldEnvHandle, (int64_t)handle);
+    HIAHControlWriterAddStringArray(spawn, HIAHControlFieldEnvironment, delta.changes, delta.changeCount);
+    HIAHControlWriterAddStringArray(spawn, HIAHControlFieldEnvRemoved, delta.removed, delta.removedCount);
+    HIAHControlEnvironmentDeltaFree(&delta);
+    HIAHControlEnvironmentBaseFree(snapshot);
+    if (spawn->failed) {
+        HIAHBenchFail(client, strerror(ENOMEM));
+        return false;
+    }
+    return true;
+}
+
+static void *HIAHBenchClientMain(void *context) {
+    HIAHBenchClient *client = context;
+    const HIAHBenchOptions *options = client->options;
+
+    int fd = -1;
+    if (options->mode == HIAHBenchModeClient && (fd = HIAHBenchConnect(client)) < 0) {
+        client->failures += (uint64_t)client->spawns - 1;
+        return NULL;
+    }
+
+    // Build the spawn request once; it is the same for every spawn
+    char **arguments = HIAHBenchMakeStrings(options->argumentCount, options->argumentSize, "arg%d=");
+    char **environment = HIAHBenchMakeStrings(options->environmentCount, options->environmentSize,
+                                              "HIAH_BENCH_%d=");
+    char argc[32], runTime[32];
+    snprintf(argc, sizeof(argc), "HIAH_BENCH_ARGC=%d", options->argumentCount);
+    snprintf(runTime, sizeof(runTime), "HIAH_BENCH_RUN_US=%d", options->runTime);
+    const char **envp = calloc((size_t)options->environmentCount + 3, sizeof(char *));
+    if (envp && environment) {
+        memcpy(envp, environment, sizeof(char *) * (size_t)options->environmentCount);
+        envp[options->environmentCount] = argc;
+        envp[options->environmentCount + 1] = runTime;
+    }
+
+    HIAHControlWriter spawn, list;
+    HIAHControlWriterInit(&spawn, HIAHControlMessageSpawn);
+    HIAHControlWriterAddString(&spawn, HIAHControlFieldPath, options->guestPath);
+    HIAHControlWriterAddStringArray(&spawn, HIAHControlFieldArguments,
+                                    (const char *const *)arguments, SIZE_MAX);
+    HIAHControlWriterAddStringArray(&spawn, HIAHControlFieldEnvironment, envp, SIZE_MAX);
+    HIAHControlWriterInit(&list, HIAHControlMessageList);
+    client->requestBytes = client->fullRequestBytes = spawn.length;
+
+    uint8_t *buffer = NULL;
+    size_t capacity = 0, length;
+    bool broken = spawn.failed || list.failed || !arguments || !environment || !envp;
+    if (broken) {
+        HIAHBenchFail(client, strerror(ENOMEM));
+    }
+
+    // The base is this client's own environment; each spawn adds the two
+    // per-guest variables to it
+    if (!broken && options->environmentDeltas) {
+        broken = !HIAHBenchUseEnvironmentDelta(client, &fd, &spawn, (const char *const *)arguments,
+                                               (const char *const *)environment, envp,
+                                               &buffer, &capacity);
+        client->requestBytes = spawn.length;
+    }
+
+    for (int i = 0; i < client->spawns && !broken; i++) {
+        uint64_t start = HIAHBenchNow();
+        if (!HIAHBenchCall(client, &fd, &spawn, &buffer, &capacity, &length)) {
+            broken = true;
+            break;
+        }
+        uint64_t elapsed = HIAHBenchNow() - start;
+
+        HIAHControlReader reader;
+        HIAHControlField field;
+        int64_t status = -1, pid = 0;
+        const char *error = "malformed reply";
+        if (HIAHControlReaderInit(&reader, buffer, length, NULL)) {
+            while (HIAHControlReaderNext(&reader, &field) == 1) {
+                if (field.tag == HIAHControlFieldStatus) {
+                    status = HIAHControlFieldInt(&field);
+                } else if (field.tag == HIAHControlFieldPid) {
+                    pid = HIAHControlFieldInt(&field);
+                } else if (field.tag == HIAHControlFieldError) {
+                    error = HIAHControlFieldString(&field, NULL);
+                }
+            }
+        }
+        if (status == 0 && pid > 0) {
+            HIAHBenchRecord(&client->spawnLatency, elapsed);
+        } else {
+            HIAHBenchFail(client, error);
+        }
+
+        if (options->listEvery > 0 && (i + 1) % options->listEvery == 0) {
+            start = HIAHBenchNow();
+            if (!HIAHBenchCall(client, &fd, &list, &buffer, &capacity, &length)) {
+                broken = true;
+                break;
+            }
+            HIAHBenchRecord(&client->listLatency, HIAHBenchNow() - start);
+            if (HIAHControlReaderInit(&reader, buffer, length, NULL)) {
+                while (HIAHControlReaderNext(&reader, &field) == 1) {
+                    if (field.tag == HIAHControlFieldProcess) {
+                        client->listedProcesses++;
+                    }
+                }
+            }
+        }
+    }
+    if (broken) {
+        uint64_t answered = client->spawnLatency.count + client->failures;
+        if (answered < (uint64_t)client->spawns) {
+            client->failures += (uint64_t)client->spawns - answered;
+        }
+    }
+
+    HIAHControlWriterFree(&spawn);
+    HIAHControlWriterFree(&list);
+    HIAHBenchFreeStrings(arguments);
+    HIAHBenchFreeStrings(environment);
+    free(envp);
+    free(buffer);
+    if (fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
+
+// MARK: - Runs
+
+/**
+ * What a forward comparison keeps of one run.
+ */
+typedef struct {
+    uint64_t spawns;
+    double elapsed;          // s
+    double p50;              // ms
+    double p99;              // ms
+    uint64_t connects;       // Channel runs
+} HIAHBenchSummary;
+
+/**
+ * Runs one benchmark against a freshly forked stand-in kernel. With
+ * `detailed`, prints the full report; `summary` (optional) receives the
+ * headline numbers.
+ *
+ * @return true if every spawn succeeded and every guest exited cleanly
+ */
+static bool HIAHBenchRun(HIAHBenchOptions *options, bool detailed, HIAHBenchSummary *summary) {
+    // Fork the kernel before starting any thread here
+    int stopPipe[2], reportPipe[2];
+    if (pipe(stopPipe) != 0 || pipe(reportPipe) != 0) {
+        perror("[HIAHSpawnBench] pipe");
+        return false;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    fflush(NULL);
+    pid_t kernelPid = fork();
+    if (kernelPid < 0) {
+        perror("[HIAHSpawnBench] fork");
+        return false;
+    }
+    if (kernelPid == 0) {
+        close(stopPipe[1]);
+        close(reportPipe[0]);
+        _exit(HIAHBenchKernelMain(options, stopPipe[0], reportPipe[1]));
+    }
+    close(stopPipe[0]);
+    close(reportPipe[1]);
+
+    uint8_t ready;
+    if (!HIAHBenchReadAll(reportPipe[0], &ready, 1)) {
+        fprintf(stderr, "[HIAHSpawnBench] stand-in kernel failed to start\n");
+        waitpid(kernelPid, NULL, 0);
+        return false;
+    }
+
+    static const char *const modeNames[] = {"client", "connect", "channel"};
+    options->channel = NULL;
+    if (options->mode == HIAHBenchModeChannel) {
+        options->channel = HIAHControlChannelCreate(options->socketPath);
+    }
+    HIAHBenchClient *clients = calloc((size_t)options->clients, sizeof(*clients));
+    pthread_t *threads = calloc((size_t)options->clients, sizeof(*threads));
+    if (!clients || !threads || (options->mode == HIAHBenchModeChannel && !options->channel)) {
+        fprintf(stderr, "[HIAHSpawnBench] %s\n", strerror(ENOMEM));
+        exit(1);
+    }
+    uint64_t start = HIAHBenchNow();
+    for (int i = 0; i < options->clients; i++) {
+        clients[i].options = options;
+        clients[i].spawns = options->spawns / options->clients +
+                            (i < options->spawns % options->clients ? 1 : 0);
+        pthread_create(&threads[i], NULL, HIAHBenchClientMain, &clients[i]);
+    }
+
+    HIAHBenchHistogram spawnLatency = {.count = 0}, listLatency = {.count = 0};
+    uint64_t failures = 0, listed = 0;
+    const char *firstError = NULL;
+    for (int i = 0; i < options->clients; i++) {
+        pthread_join(threads[i], NULL);
+        HIAHBenchMerge(&spawnLatency, &clients[i].spawnLatency);
+        HIAHBenchMerge(&listLatency, &clients[i].listLatency);
+        failures += clients[i].failures;
+        listed += clients[i].listedProcesses;
+        if (!firstError && clients[i].failures) {
+            firstError = clients[i].firstError;
+        }
+    }
+    double elapsed = (double)(HIAHBenchNow() - start) / 1e9;
+
+    close(stopPipe[1]);
+    HIAHBenchKernelReport report;
+    bool reported = HIAHBenchReadAll(reportPipe[0], &report, sizeof(report));
+    close(reportPipe[0]);
+    waitpid(kernelPid, NULL, 0);
+    double drained = (double)(HIAHBenchNow() - start) / 1e9;
+
+    HIAHControlChannelStats channelStats = {0};
+    if (options->channel) {
+        HIAHControlChannelGetStats(options->channel, &channelStats);
+        HIAHControlChannelDestroy(options->channel);
+        options->channel = NULL;
+    }
+    if (summary) {
+        *summary = (HIAHBenchSummary){
+            .spawns = spawnLatency.count,
+            .elapsed = elapsed,
+            .p50 = HIAHBenchPercentile(&spawnLatency, 50),
+            .p99 = HIAHBenchPercentile(&spawnLatency, 99),
+            .connects = channelStats.connects,
+        };
+    }
+    if (!detailed) {
+        if (firstError) {
+            fprintf(stderr, "[HIAHSpawnBench] %s: %llu failed, first error: %s\n",
+                    modeNames[options->mode], (unsigned long long)failures, firstError);
+        }
+        goto done;
+    }
+
+    printf("HIAHKernel spawn bench: %d spawns, %d clients (%s), %d args x %d B, %d env x %d B, "
+           "%zu B requests\n",
+           options->spawns, options->clients, modeNames[options->mode],
+           options->argumentCount, options->argumentSize,
+           options->environmentCount, options->environmentSize, clients[0].requestBytes);
+    if (options->environmentDeltas) {
+        printf("env      deltas: %zu B per spawn saved (%zu B in full)\n",
+               clients[0].fullRequestBytes - clients[0].requestBytes,
+               clients[0].fullRequestBytes);
+    }
+    printf("spawn    %llu ok, %llu failed in %.3f s: %.1f spawns/s\n",
+           (unsigned long long)spawnLatency.count, (unsigned long long)failures,
+           elapsed, (double)spawnLatency.count / elapsed);
+    if (firstError) {
+        printf("  first error: %s\n", firstError);
+    }
+    HIAHBenchPrintLatency("latency", &spawnLatency);
+    HIAHBenchPrintHistogram(&spawnLatency);
+    if (options->mode == HIAHBenchModeChannel) {
+        printf("channel  %llu calls, %llu connects, %llu failed, peak %llu in flight\n",
+               (unsigned long long)channelStats.calls, (unsigned long long)channelStats.connects,
+               (unsigned long long)channelStats.failures,
+               (unsigned long long)channelStats.peakInFlight);
+    }
+    if (listLatency.count > 0) {
+        printf("list     %llu requests, %.1f processes per reply\n",
+               (unsigned long long)listLatency.count,
+               (double)listed / (double)listLatency.count);
+        HIAHBenchPrintLatency("latency", &listLatency);
+        HIAHBenchPrintHistogram(&listLatency);
+    }
+    if (reported) {
+        printf("guests   %llu exited (%llu non-zero), all reaped after %.3f s, "
+               "peak %llu in table\n",
+               (unsigned long long)report.exited, (unsigned long long)report.nonzeroExits,
+               drained, (unsigned long long)report.peakProcesses);
+        HIAHBenchPrintLatency("to exit", &report.run);
+        printf("kernel   peak RSS %.1f MiB, %llu messages, %.1f KiB in, %.1f KiB out, "
+               "%llu protocol errors\n",
+               (double)report.peakRSS / 1048576.0,
+               (unsigned long long)report.server.messages,
+               (double)report.server.bytesIn / 1024.0,
+               (double)report.server.bytesOut / 1024.0,
+               (unsigned long long)report.server.protocolErrors);
+        printf("runners  peak RSS %.1f MiB\n", (double)report.runnerPeakRSS / 1048576.0);
+        if (options->environmentDeltas) {
+            printf("env      %llu registrations (%llu shared), %llu bases, %.1f KiB held, "
+                   "%llu builds, %llu unknown\n",
+                   (unsigned long long)report.environments.registrations,
+                   (unsigned long long)report.environments.shared,
+                   (unsigned long long)report.environments.bases,
+                   (double)report.environments.bytes / 1024.0,
+                   (unsigned long long)report.environments.builds,
+                   (unsigned long long)report.environments.misses);
+        }
+    } else {
+        printf("kernel   no report (stand-in kernel died)\n");
+    }
+
+done:
+    free(clients);
+    free(threads);
+    return failures == 0 && reported && report.nonzeroExits == 0;
+}
+
+static double HIAHBenchRate(const HIAHBenchSummary *summary) {
+    return summary->elapsed > 0 ? (double)summary->spawns / summary->elapsed : 0.0;
+}
+
+/**
+ * Forwarded spawns the old way (a connection per request) and the new
+ * (one shared channel), each sequentially from one client and in parallel
+ * from `options->clients`, as one table.
+ */
+static bool HIAHBenchCompareForwarding(HIAHBenchOptions *options) {
+    int parallel = options->clients;
+    int clientCounts[2] = {1, parallel};
+    HIAHBenchMode modes[2] = {HIAHBenchModeConnect, HIAHBenchModeChannel};
+    HIAHBenchSummary results[2][2] = {{{0}}};
+    bool clean = true;
+
+    printf("HIAHKernel forwarded spawns: %d spawns per run, %d args x %d B, %d env x %d B%s\n",
+           options->spawns, options->argumentCount, options->argumentSize,
+           options->environmentCount, options->environmentSize,
+           options->environmentDeltas ? ", deltas" : "");
+    printf("%-10s %-8s %8s %11s %9s %9s %9s\n",
+           "", "mode", "clients", "spawns/s", "p50 ms", "p99 ms", "connects");
+    for (int c = 0; c < (parallel > 1 ? 2 : 1); c++) {
+        for (int m = 0; m < 2; m++) {
+            options->mode = modes[m];
+            options->clients = clientCounts[c];
+            clean &= HIAHBenchRun(options, false, &results[c][m]);
+            const HIAHBenchSummary *result = &results[c][m];
+            char connects[24] = "-";    // Every request connects
+            if (m == 1) {
+                snprintf(connects, sizeof(connects), "%llu", (unsigned long long)result->connects);
+            }
+            printf("%-10s %-8s %8d %11.1f %9.3f %9.3f %9s\n",
+                   c == 0 ? "sequential" : "parallel", m == 0 ? "connect" : "channel",
+                   clientCounts[c], HIAHBenchRate(result), result->p50, result->p99, connects);
+        }
+    }
+    for (int c = 0; c < (parallel > 1 ? 2 : 1); c++) {
+        const HIAHBenchSummary *connect = &results[c][0], *channel = &results[c][1];
+        printf("channel vs connect, %-11s %.2fx throughput, p50 %+.1f%%\n",
+               c == 0 ? "sequential:" : "parallel:",
+               HIAHBenchRate(connect) > 0 ? HIAHBenchRate(channel) / HIAHBenchRate(connect) : 0.0,
+               connect->p50 > 0 ? (channel->p50 - connect->p50) / connect->p50 * 100.0 : 0.0);
+    }
+    options->clients = parallel;
+    return clean;
+}
+
+// MARK: - Main
+
+static void HIAHBenchUsage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options] <guest.so>\n"
+            "  -m MODE  client: one connection per client (default)\n"
+            "           connect: one connection per request\n"
+            "           channel: all clients share one multiplexed channel\n"
+            "           forward: connect and channel, sequential and with -c clients\n"
+            "  -c N     concurrent clients (default 8)\n"
+            "  -n N     total spawns (default 2000)\n"
+            "  -a N     arguments per spawn (default 4)\n"
+            "  -A N     bytes per argument (default 32)\n"
+            "  -e N     environment entries per spawn (default 32)\n"
+            "  -E N     bytes per environment value (default 64)\n"
+            "  -l N     list after every N spawns per client, 0 = never (default 16)\n"
+            "  -w N     stand-in kernel spawn workers (default 4)\n"
+            "  -r US    guest run time in microseconds (default 0)\n"
+            "  -D       send environments as deltas against a registered base\n"
+            "  -s PATH  control socket path (default /tmp/hiah-spawn-bench.<pid>.sock)\n",
+            program);
+}
+
+static bool HIAHBenchFindSelf(const char *argv0, char *path) {
+#if defined(__APPLE__)
+    char raw[PATH_MAX];
+    uint32_t size = sizeof(raw);
+    if (_NSGetExecutablePath(raw, &size) == 0 && realpath(raw, path)) {
+        return true;
+    }
+#elif defined(__linux__)
+    ssize_t n = readlink("/proc/self/exe", path, PATH_MAX - 1);
+    if (n > 0) {
+        path[n] = '\0';
+        return true;
+    }
+#endif
+    return realpath(argv0, path) != NULL;
+}
+
+static int HIAHBenchParseCount(const char *value, int minimum) {
+    char *end;
+    long parsed = strtol(value, &end, 10);
+    if (*value == '\0' || *end != '\0' || parsed < minimum || parsed > INT_MAX) {
+        return -1;
+    }
+    return (int)parsed;
+}
+
+int main(int argc, char **argv) {
+    if (argc >= 2 && strcmp(argv[1], "--runner") == 0) {
+        return HIAHBenchRunnerMain(argc, argv);
+    }
+
+    HIAHBenchOptions options = {
+        .clients = 8, .spawns = 2000,
+        .argumentCount = 4, .argumentSize = 32,
+        .environmentCount = 32, .environmentSize = 64,
+        .listEvery = 16, .workers = 4,
+    };
+    snprintf(options.socketPath, sizeof(options.socketPath),
+             "/tmp/hiah-spawn-bench.%d.sock", (int)getpid());
+
+    bool compareForwarding = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "m:c:n:a:A:e:E:l:w:r:s:Dh")) != -1) {
+        int *target = NULL;
+        int minimum = 0;
+        switch (opt) {
+        case 'm':
+            compareForwarding = false;
+            if (strcmp(optarg, "client") == 0) {
+                options.mode = HIAHBenchModeClient;
+            } else if (strcmp(optarg, "connect") == 0) {
+                options.mode = HIAHBenchModeConnect;
+            } else if (strcmp(optarg, "channel") == 0) {
+                options.mode = HIAHBenchModeChannel;
+            } else if (strcmp(optarg, "forward") == 0) {
+                compareForwarding = true;
+            } else {
+                fprintf(stderr, "[HIAHSpawnBench] invalid mode: %s\n", optarg);
+                return 2;
+            }
+            continue;
+        case 'c': target = &options.clients; minimum = 1; break;
+        case 'n': target = &options.spawns; minimum = 1; break;
+        case 'a': target = &options.argumentCount; break;
+        case 'A': target = &options.argumentSize; break;
+        case 'e': target = &options.environmentCount; break;
+        case 'E': target = &options.environmentSize; break;
+        case 'l': target = &options.listEvery; break;
+        case 'w': target = &options.workers; minimum = 1; break;
+        case 'r': target = &options.runTime; break;
+        case 'D':
+            options.environmentDeltas = true;
+            continue;
+        case 's':
+            if (strlen(optarg) >= sizeof(options.socketPath)) {
+                fprintf(stderr, "[HIAHSpawnBench] socket path too long\n");
+                return 2;
+            }
+            snprintf(options.socketPath, sizeof(options.socketPath), "%s", optarg);
+            continue;
+        default:
+            HIAHBenchUsage(argv[0]);
+            return opt == 'h' ? 0 : 2;
+        }
+        if ((*target = HIAHBenchParseCount(optarg, minimum)) < 0) {
+            fprintf(stderr, "[HIAHSpawnBench] invalid value for -%c: %s\n", opt, optarg);
+            return 2;
+        }
+    }
+    if (optind != argc - 1) {
+        HIAHBenchUsage(argv[0]);
+        return 2;
+    }
+    if (!realpath(argv[optind], options.guestPath)) {
+        fprintf(stderr, "[HIAHSpawnBench] %s: %s\n", argv[optind], strerror(errno));
+        return 2;
+    }
+    if (!HIAHBenchFindSelf(argv[0], options.runnerPath)) {
+        fprintf(stderr, "[HIAHSpawnBench] cannot locate own executable\n");
+        return 2;
+    }
+    if (options.clients > options.spawns) {
+        options.clients = options.spawns;
+    }
+
+    bool clean = compareForwarding ? HIAHBenchCompareForwarding(&options)
+                                   : HIAHBenchRun(&options, true, NULL);
+    return clean ? 0 : 1;
+}
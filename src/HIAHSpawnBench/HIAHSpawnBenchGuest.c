@@ -0,0 +1,41 @@
+/**
+ * HIAHSpawnBenchGuest.c
+ * HIAHKernel – House in a House Virtual Kernel (for iOS)
+ *
+ * Test guest for hiah-spawn-bench, built as a shared object.
+ *
+ * The bench runner dlopens it and calls hiah_bench_main() like the process
+ * runner calls a guest's entry point. It reads its whole argv and
+ * environment, optionally stays alive for HIAH_BENCH_RUN_US microseconds,
+ * and exits non-zero if argv did not arrive intact.
+ *
+ * Copyright (c) 2025 Alex Spaulding
+ * Licensed under MIT License
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+extern char **environ;
+
+int hiah_bench_main(int argc, char **argv) {
+    volatile size_t bytes = 0;
+    for (int i = 0; i < argc; i++) {
+        bytes += strlen(argv[i]);
+    }
+    for (char **entry = environ; entry && *entry; entry++) {
+        bytes += strlen(*entry);
+    }
+
+    const char *runTime = getenv("HIAH_BENCH_RUN_US");
+    if (runTime && atoi(runTime) > 0) {
+        usleep((useconds_t)atoi(runTime));
+    }
+
+    const char *expected = getenv("HIAH_BENCH_ARGC");
+    if (expected && atoi(expected) != argc - 1) {
+        return 1;
+    }
+    return 0;
+}
@@ -5,6 +5,7 @@
 
 #import "HIAHAppLauncher.h"
 #import "../HIAHDesktop/HIAHFilesystem.h"
+#import "HIAHMachOUtils.h"
 #import <sys/event.h>
 #import <sys/time.h>
 #import <fcntl.h>
@@ -132,18 +133,27 @@ static const CGFloat kDrawerHeight = 320.0;
                 color = [UIColor colorWithRed:0.2 green:0.6 blue:0.9 alpha:1.0];
             }
             
+            // Whether the executable can be loaded comes from the Mach-O
+            // index; the binary is only opened if it changed since install
+            NSString *exec = info[@"CFBundleExecutable"];
+            NSDictionary *binary = exec ? [HIAHMachOUtils indexedInfoForBinary:[appPath stringByAppendingPathComponent:exec]] : nil;
+            
             [apps addObject:@{
                 @"name": name,
                 @"bundleID": bundleID,
                 @"icon": icon,
                 @"color": color,
-                @"path": appPath
+                @"path": appPath,
+                @"loadable": @(binary != nil)
             }];
             
             NSLog(@"[Launcher] Found app: %@ (%@) at %@", name, bundleID, appPath);
         }
     }
     
+    // Forget binaries of apps that were removed
+    [HIAHMachOUtils pruneIndex];
+    
     if (apps.count == 0) {
         NSLog(@"[Launcher] No apps installed - Applications folder is empty");
         NSLog(@"[Launcher] Install apps via Files app or HIAH Installer");
@@ -683,6 +693,9 @@ static const CGFloat kDrawerHeight = 320.0;
     lbl.adjustsFontSizeToFitWidth = YES;
     [cell.contentView addSubview:lbl];
     
+    // An executable the index could not read would fail to launch
+    cell.contentView.alpha = [app[@"loadable"] boolValue] ? 1.0 : 0.4;
+    
     UITapGestureRecognizer *tap = [[UITapGestureRecognizer alloc] initWithTarget:self action:@selector(cellTap:)];
     [cell addGestureRecognizer:tap];
     return cell;
@@ -698,6 +711,15 @@ static const CGFloat kDrawerHeight = 320.0;
     NSDictionary *app = self.apps[ip.item];
     
     UICollectionViewCell *cell = [cv cellForItemAtIndexPath:ip];
+    if (![app[@"loadable"] boolValue]) {
+        NSLog(@"[Launcher] Not launching %@: executable is missing or not a loadable Mach-O", app[@"name"]);
+        CAKeyframeAnimation *shake = [CAKeyframeAnimation animationWithKeyPath:@"transform.translation.x"];
+        shake.values = @[@0, @-6, @6, @-4, @4, @0];
+        shake.duration = 0.3;
+        [cell.layer addAnimation:shake forKey:@"shake"];
+        return;
+    }
+
     [UIView animateWithDuration:0.1 animations:^{ cell.transform = CGAffineTransformMakeScale(0.9, 0.9); } completion:^(BOOL f) {
         [UIView animateWithDuration:0.1 animations:^{ cell.transform = CGAffineTransformIdentity; }];
     }];
@@ -27,6 +27,7 @@
 
 #ifndef HIAH_LIBRARY_MODE
 #import "HIAHSigner.h"
+#import "../HIAHKernel/Core/Process/HIAHSpawnTrace.h"
 #endif
 #import <dlfcn.h>
 #import <mach-o/dyld.h>
@@ -516,7 +517,12 @@ static void continueBinaryLoadingWithBypass(NSString *executablePath,
                                             NSFileManager *fm,
                                             NSArray *arguments);
 
+// Stage timings of this extension's guest launch, dumped to the log right
+// before the guest's main() runs
+static HIAHSpawnTrace gSpawnTrace;
+
 static void ExecuteGuestApplication(NSDictionary *spawnRequest) {
+  HIAHSpawnTraceStart(&gSpawnTrace);
   FILE *logFile = GetExtensionLogFile();
   ExtLog(logFile, "[HIAHExtension] ========================================\n");
   ExtLog(logFile, "[HIAHExtension] ExecuteGuestApplication CALLED\n");
@@ -604,6 +610,7 @@ static void ExecuteGuestApplication(NSDictionary *spawnRequest) {
   // Resolve the actual executable path
   // If we receive a path to a .app bundle, we need to find the executable
   // inside it
+  HIAHSpawnTraceBegin(&gSpawnTrace, HIAHSpawnStageResolve);
   NSFileManager *fm = [NSFileManager defaultManager];
   NSString *actualExecutablePath = executablePath;
 
@@ -663,6 +670,7 @@ static void ExecuteGuestApplication(NSDictionary *spawnRequest) {
 
   // Update executablePath to the actual binary
   executablePath = actualExecutablePath;
+  HIAHSpawnTraceEnd(&gSpawnTrace, HIAHSpawnStageResolve);
   ExtLog(logFile, "[HIAHExtension] Final executable path: %s\n",
          [executablePath UTF8String]);
 
@@ -683,6 +691,8 @@ static void ExecuteGuestApplication(NSDictionary *spawnRequest) {
       logFile,
       "[HIAHExtension] Preparing binary for dlopen with signature bypass...\n");
 
+  HIAHSpawnTraceBegin(&gSpawnTrace, HIAHSpawnStageJITWait);
+
   // CRITICAL: Check JIT status DIRECTLY using csops (most reliable)
   // Don't rely on HIAHBypassStatus which may be stale - JIT enablement happens
   // asynchronously via minimuxer and the status file may not be updated
@@ -782,6 +792,8 @@ static void ExecuteGuestApplication(NSDictionary *spawnRequest) {
          vpnActive ? "YES" : "NO", jitActive ? "YES" : "NO",
          useJITLessMode ? "YES" : "NO", bypassReady ? "YES" : "NO");
 
+  HIAHSpawnTraceEnd(&gSpawnTrace, HIAHSpawnStageJITWait);
+
   // Continue with binary loading
   continueBinaryLoadingWithBypass(executablePath, logFile, vpnActive, jitActive,
                                   useJITLessMode, fm, arguments);
@@ -805,31 +817,29 @@ static void continueBinaryLoadingWithBypass(NSString *executablePath,
     ExtLog(logFile,
            "[HIAHExtension] ========================================\n");
 
-    // Step 1: Patch binary for JIT-less mode (MH_EXECUTE to MH_BUNDLE, patch
-    // __PAGEZERO)
-    ExtLog(logFile,
-           "[HIAHExtension] Step 1: Patching binary for JIT-less mode...\n");
-    if ([HIAHMachOUtils patchBinaryForJITLessMode:executablePath]) {
+    // Steps 1 and 2: Patch binary for JIT-less mode (MH_EXECUTE to
+    // MH_BUNDLE, patch __PAGEZERO) and remove the existing signature
+    // (required before signing), in one pass over the binary
+    ExtLog(logFile, "[HIAHExtension] Steps 1-2: Patching binary for JIT-less "
+                    "mode and removing code signature...\n");
+    HIAHSpawnTraceBegin(&gSpawnTrace, HIAHSpawnStagePrepare);
+    if ([HIAHMachOUtils patchBinaryForJITLessMode:executablePath
+                                removingSignature:YES]) {
       ExtLog(logFile, "[HIAHExtension] ✅ Binary patched for JIT-less mode "
-                      "(MH_BUNDLE + __PAGEZERO)\n");
+                      "(MH_BUNDLE + __PAGEZERO, signature removed)\n");
     } else {
       ExtLog(
           logFile,
           "[HIAHExtension] ⚠️ Binary patching failed - trying basic patch...\n");
       // Fallback to basic patch
       [HIAHMachOUtils patchBinaryToDylib:executablePath];
+      if (![HIAHMachOUtils removeCodeSignature:executablePath]) {
+        ExtLog(logFile, "[HIAHExtension] ⚠️ Code signature removal failed\n");
+      }
     }
 
-    // Step 2: Remove existing signature (required before signing)
-    ExtLog(logFile,
-           "[HIAHExtension] Step 2: Removing existing code signature...\n");
-    BOOL signatureRemoved = [HIAHMachOUtils removeCodeSignature:executablePath];
-    if (signatureRemoved) {
-      ExtLog(logFile, "[HIAHExtension] ✅ Code signature removed\n");
-    } else {
-      ExtLog(logFile,
-             "[HIAHExtension] ⚠️ Code signature removal failed or not found\n");
-    }
+    HIAHSpawnTraceEnd(&gSpawnTrace, HIAHSpawnStagePrepare);
+    HIAHSpawnTraceBegin(&gSpawnTrace, HIAHSpawnStageSign);
 
     // Step 3: Sign with certificate from SideStore (or ad-hoc if certificate
     // not available)
@@ -906,6 +916,7 @@ static void continueBinaryLoadingWithBypass(NSString *executablePath,
     // called
     ExtLog(logFile, "[HIAHExtension] Removing code signature from binary "
                     "(required for dlopen)...\n");
+    HIAHSpawnTraceBegin(&gSpawnTrace, HIAHSpawnStageSign);
     BOOL signatureRemoved = [HIAHMachOUtils removeCodeSignature:executablePath];
     if (signatureRemoved) {
       ExtLog(logFile,
@@ -915,6 +926,8 @@ static void continueBinaryLoadingWithBypass(NSString *executablePath,
              "[HIAHExtension] ⚠️ Code signature removal failed or not found\n");
     }
 
+    HIAHSpawnTraceEnd(&gSpawnTrace, HIAHSpawnStageSign);
+
     ExtLog(logFile, "[HIAHExtension] Signature bypass available (VPN + JIT "
                     "active) - dyld bypass should work\n");
     ExtLog(logFile, "[HIAHExtension] CS_DEBUGGED flag: SET - dyld will skip "
@@ -936,22 +949,25 @@ static void continueBinaryLoadingWithBypass(NSString *executablePath,
         "[HIAHExtension] Signature bypass not available (VPN: %s, JIT: %s)\n",
         vpnActive ? "YES" : "NO", jitActive ? "YES" : "NO");
 
-    // Step 1: Patch binary for JIT-less mode
-    ExtLog(logFile,
-           "[HIAHExtension] Step 1: Patching binary for JIT-less mode...\n");
-    if ([HIAHMachOUtils patchBinaryForJITLessMode:executablePath]) {
+    // Steps 1 and 2: Patch binary for JIT-less mode and remove the
+    // signature, in one pass
+    ExtLog(logFile, "[HIAHExtension] Steps 1-2: Patching binary for JIT-less "
+                    "mode and removing code signature...\n");
+    HIAHSpawnTraceBegin(&gSpawnTrace, HIAHSpawnStagePrepare);
+    if ([HIAHMachOUtils patchBinaryForJITLessMode:executablePath
+                                removingSignature:YES]) {
       ExtLog(logFile, "[HIAHExtension] ✅ Binary patched for JIT-less mode "
-                      "(MH_BUNDLE + __PAGEZERO)\n");
+                      "(MH_BUNDLE + __PAGEZERO, signature removed)\n");
     } else {
       ExtLog(
           logFile,
           "[HIAHExtension] ⚠️ Binary patching failed - trying basic patch...\n");
       [HIAHMachOUtils patchBinaryToDylib:executablePath];
+      [HIAHMachOUtils removeCodeSignature:executablePath];
     }
 
-    // Step 2: Remove signature first
-    ExtLog(logFile, "[HIAHExtension] Step 2: Removing code signature...\n");
-    [HIAHMachOUtils removeCodeSignature:executablePath];
+    HIAHSpawnTraceEnd(&gSpawnTrace, HIAHSpawnStagePrepare);
+    HIAHSpawnTraceBegin(&gSpawnTrace, HIAHSpawnStageSign);
 
     // Step 3: Try to sign
     ExtLog(logFile, "[HIAHExtension] Step 3: Attempting to sign binary...\n");
@@ -1009,6 +1025,11 @@ static void continueBinaryLoadingWithBypass(NSString *executablePath,
     }
   }
 
+  if (gSpawnTrace.begin[HIAHSpawnStageSign] != 0 &&
+      gSpawnTrace.end[HIAHSpawnStageSign] == 0) {
+    HIAHSpawnTraceEnd(&gSpawnTrace, HIAHSpawnStageSign);
+  }
+
   // Set up bundle context for the guest app
   // The executable path might be:
   // 1. Direct path to executable: /path/to/App.app/AppBinary
@@ -1160,9 +1181,11 @@ static void continueBinaryLoadingWithBypass(NSString *executablePath,
          jitActive ? "ENABLED" : "DISABLED", vpnActive ? "ACTIVE" : "INACTIVE");
   HIAHLogInfo(GetExtensionLog, "Loading guest binary as dylib via dlopen");
 
+  HIAHSpawnTraceBegin(&gSpawnTrace, HIAHSpawnStageLoad);
   void *guestHandle = dlopen(executablePath.UTF8String, RTLD_NOW | RTLD_GLOBAL);
 
   if (!guestHandle) {
+    HIAHSpawnTraceFail(&gSpawnTrace, HIAHSpawnStageLoad);
     const char *error = dlerror();
     ExtLog(logFile, "[HIAHExtension] ERROR: dlopen failed: %s\n",
            error ?: "unknown error");
@@ -1171,6 +1194,7 @@ static void continueBinaryLoadingWithBypass(NSString *executablePath,
     return;
   }
 
+  HIAHSpawnTraceEnd(&gSpawnTrace, HIAHSpawnStageLoad);
   fprintf(stdout,
           "[HIAHExtension] Guest binary loaded successfully as dylib at "
           "handle: %p\n",
@@ -1200,6 +1224,7 @@ static void continueBinaryLoadingWithBypass(NSString *executablePath,
   fflush(stdout);
   ExtLog(logFile, "[HIAHExtension] Locating guest entry point...\n");
 
+  HIAHSpawnTraceBegin(&gSpawnTrace, HIAHSpawnStageEntry);
   void *entryPoint = NULL;
   @try {
     entryPoint = FindEntryPoint(guestHandle, executablePath);
@@ -1212,6 +1237,7 @@ static void continueBinaryLoadingWithBypass(NSString *executablePath,
     return;
   }
 
+  HIAHSpawnTraceEnd(&gSpawnTrace, HIAHSpawnStageEntry);
   if (!entryPoint) {
     fprintf(stdout,
             "[HIAHExtension] ERROR: Could not find guest entry point\n");
@@ -1285,7 +1311,13 @@ static void continueBinaryLoadingWithBypass(NSString *executablePath,
 
   // Use dispatch_async to ensure it runs in the next runloop cycle
   // This allows the current function to set up the runloop first
+  HIAHSpawnTraceBegin(&gSpawnTrace, HIAHSpawnStageLaunch);
   dispatch_async(dispatch_get_main_queue(), ^{
+    HIAHSpawnTraceEnd(&gSpawnTrace, HIAHSpawnStageLaunch);
+    char trace[1024];
+    HIAHSpawnTraceFormat(&gSpawnTrace, trace, sizeof(trace));
+    ExtLog(logFile, "[HIAHExtension] Launch trace:\n%s", trace);
+
     @try {
       fprintf(stdout, "[HIAHExtension] *** CALLING GUEST main() NOW ***\n");
       fprintf(stdout, "[HIAHExtension] This will call UIApplicationMain, which "
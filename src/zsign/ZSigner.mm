@@ -8,6 +8,8 @@
 
 #import "ZSigner.h"
 #import <Foundation/Foundation.h>
+#include "HIAHMachOTransform.h"
+#include "HIAHWorkerPool.h"
 
 // Include zsign C++ headers
 // These are staged from Nix build to dependencies/zsign/include/zsign/
@@ -21,6 +23,51 @@
 
 using namespace std;
 
+// Each slice of a fat binary is signed on its own: its code pages are
+// hashed and its CodeDirectory built with nothing shared between slices, so
+// they run on the worker pool. Every slice edits only its own bytes and
+// keeps its own outcome, which is logged in slice order afterwards.
+struct ZSignerSlice {
+    uint8_t *base;
+    uint32_t length;
+    uint32_t cputype;
+    bool initialized;
+    bool isSigned;
+};
+
+struct ZSignerJob {
+    vector<ZSignerSlice> slices;
+    string bundleId;
+    string entitlements;
+};
+
+static void ZSignerSignSlice(size_t index, void *context) {
+    ZSignerJob *job = (ZSignerJob *)context;
+    ZSignerSlice &slice = job->slices[index];
+
+    ZArchO archo;
+    if (!archo.Init(slice.base, slice.length)) {
+        return;
+    }
+
+    // Own asset per slice, so workers share no signing state
+    // Parameters: certFile, pkeyFile, provFile, entitleFile, password, bAdhoc, bSHA256Only, bSingleBinary
+    ZSignAsset signAsset;
+    string emptyStr = "";
+    if (!signAsset.Init(emptyStr, emptyStr, emptyStr, job->entitlements, emptyStr, true, false, false)) {
+        return;
+    }
+    slice.initialized = true;
+
+    // Info.plist hashes and CodeResources are empty for single binary signing
+    // Parameters: pSignAsset, bForce, bundleId, infoSHA1, infoSHA256, codeResourcesData
+    string infoSHA1 = "";
+    string infoSHA256 = "";
+    string codeResourcesData = "";
+    archo.Sign(&signAsset, true, job->bundleId, infoSHA1, infoSHA256, codeResourcesData);
+    slice.isSigned = archo.IsSigned();
+}
+
 @implementation ZSigner
 
 + (BOOL)adhocSignMachOAtPath:(NSString *)path
@@ -41,50 +88,53 @@ using namespace std;
     // Create a mutable copy so we can modify it
     NSMutableData *mutableData = [fileData mutableCopy];
     uint8_t *fileBytes = (uint8_t *)mutableData.mutableBytes;
-    uint32_t fileLength = (uint32_t)mutableData.length;
     
-    // Initialize ZArchO with the file
-    ZArchO archo;
-    if (!archo.Init(fileBytes, fileLength)) {
-        NSLog(@"[ZSigner] Error: Failed to initialize ZArchO with file: %@", path);
+    // Thin binaries are one slice; fat ones (FAT_MAGIC or FAT_MAGIC_64) are
+    // signed slice by slice
+    HIAHMachOSliceRange *ranges = NULL;
+    uint32_t rangeCount = 0;
+    char sliceError[256];
+    if (!HIAHMachOListSlices(fileBytes, mutableData.length, &ranges, &rangeCount, sliceError, sizeof(sliceError))) {
+        NSLog(@"[ZSigner] Error: Not a Mach-O binary (%s): %@", sliceError, path);
         return NO;
     }
     
-    // Create ZSignAsset for ad-hoc signing
-    // For ad-hoc signing, we don't need certificates, so pass empty strings
-    ZSignAsset signAsset;
-    string emptyStr = "";
-    string bundleIdStr = bundleId ? [bundleId UTF8String] : "";
+    ZSignerJob job;
+    job.bundleId = bundleId ? [bundleId UTF8String] : "";
     
     // Convert entitlements data to string if provided
-    string entitlementsStr = "";
     if (entitlementData && entitlementData.length > 0) {
         NSString *entitlementsXML = [[NSString alloc] initWithData:entitlementData encoding:NSUTF8StringEncoding];
         if (entitlementsXML) {
-            entitlementsStr = [entitlementsXML UTF8String];
+            job.entitlements = [entitlementsXML UTF8String];
         }
     }
     
-    // Initialize sign asset in ad-hoc mode
-    // Parameters: certFile, pkeyFile, provFile, entitleFile, password, bAdhoc, bSHA256Only, bSingleBinary
-    if (!signAsset.Init(emptyStr, emptyStr, emptyStr, entitlementsStr, emptyStr, true, false, false)) {
-        NSLog(@"[ZSigner] Error: Failed to initialize ZSignAsset for ad-hoc signing");
-        return NO;
+    for (uint32_t i = 0; i < rangeCount; i++) {
+        if (ranges[i].size > UINT32_MAX) {
+            NSLog(@"[ZSigner] Error: Slice %u is too large to sign: %@", i, path);
+            free(ranges);
+            return NO;
+        }
+        ZSignerSlice slice = {fileBytes + ranges[i].offset, (uint32_t)ranges[i].size, ranges[i].cputype, false, false};
+        job.slices.push_back(slice);
     }
+    free(ranges);
     
-    // Calculate Info.plist hashes (empty for single binary signing)
-    string infoSHA1 = "";
-    string infoSHA256 = "";
-    string codeResourcesData = "";
+    HIAHWorkerPoolRun(job.slices.size(), 0, ZSignerSignSlice, &job);
     
-    // Sign the binary
-    // Parameters: pSignAsset, bForce, bundleId, infoSHA1, infoSHA256, codeResourcesData
-    archo.Sign(&signAsset, true, bundleIdStr, infoSHA1, infoSHA256, codeResourcesData);
-    
-    // Check if signing was successful
-    if (!archo.IsSigned()) {
-        NSLog(@"[ZSigner] Warning: Binary may not be signed (IsSigned() returned false)");
-        // Continue anyway - the signing might have worked but IsSigned() might not detect it
+    for (size_t i = 0; i < job.slices.size(); i++) {
+        const ZSignerSlice &slice = job.slices[i];
+        if (!slice.initialized) {
+            NSLog(@"[ZSigner] Error: Failed to prepare slice %zu (cputype 0x%x) for ad-hoc signing: %@",
+                  i, slice.cputype, path);
+            return NO;
+        }
+        if (!slice.isSigned) {
+            NSLog(@"[ZSigner] Warning: Slice %zu (cputype 0x%x) may not be signed (IsSigned() returned false)",
+                  i, slice.cputype);
+            // Continue anyway - the signing might have worked but IsSigned() might not detect it
+        }
     }
     
     // Write the signed binary back to disk